@@ -3,7 +3,8 @@
 #include <vk_mem_alloc.h>
 #include <glm.hpp>
 #include <logger.h>
-#include <fstream>
+#include <vfs.h>
+#include <string.h>
 
 #define BRDF_LUT_SIZE 512
 #define BRDF_WORK_GROUP_SIZE 8
@@ -21,11 +22,12 @@ BRDFIntegrateLUT::BRDFIntegrateLUT(
     size_t                size = BRDF_LUT_SIZE * BRDF_LUT_SIZE * sizeof(uint16_t) * 2;
     std::vector<uint16_t> buffer(size);
 
-    std::fstream f("textures/brdf_lut.bin", std::ios::in | std::ios::binary);
+    vfs::File file;
 
-    f.seekp(0);
-    f.read((char*)buffer.data(), size);
-    f.close();
+    if (vfs::read("textures/brdf_lut.bin", file) && file.size() >= size)
+        memcpy(buffer.data(), file.data(), size);
+    else
+        DW_LOG_ERROR("Failed to read BRDF LUT: textures/brdf_lut.bin");
 
 #if defined(DWSF_VULKAN)
     m_image = vk::Image::create(backend, VK_IMAGE_TYPE_2D, BRDF_LUT_SIZE, BRDF_LUT_SIZE, 1, 1, 1, VK_FORMAT_R16G16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, size, buffer.data());
@@ -6,6 +6,7 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <logger.h>
+#include <allocators.h>
 
 #define PREFILTER_MAP_SIZE 256
 #define PREFILTER_MIP_LEVELS 5
@@ -2757,27 +2758,7 @@ void CubemapPrefiler::update(
 
     backend->flush_barriers(cmd_buf);
 
-    int32_t start_level = (m_size / PREFILTER_MAP_SIZE) - 1;
-
-    for (int mip = 0; mip < PREFILTER_MIP_LEVELS; mip++)
-    {
-        uint32_t mip_width  = PREFILTER_MAP_SIZE * std::pow(0.5, mip);
-        uint32_t mip_height = PREFILTER_MAP_SIZE * std::pow(0.5, mip);
-
-        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->handle());
-
-        PushConstants push_constants;
-
-        push_constants.roughness       = (float)mip / (float)(PREFILTER_MIP_LEVELS - 1);
-        push_constants.size            = mip_height;
-        push_constants.start_mip_level = start_level;
-        push_constants.sample_count    = m_sample_count;
-
-        vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
-        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout->handle(), 0, 1, &m_ds[mip]->handle(), 0, nullptr);
-
-        vkCmdDispatch(cmd_buf->handle(), mip_width / PREFILTER_WORK_GROUP_SIZE, mip_height / PREFILTER_WORK_GROUP_SIZE, 6);
-    }
+    record(cmd_buf);
 
     backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image, subresource_range);
 
@@ -2815,6 +2796,88 @@ void CubemapPrefiler::update(
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+#if defined(DWSF_VULKAN)
+
+void CubemapPrefiler::update(vk::AsyncCompute::Ptr async_compute)
+{
+    auto cmd_buf = async_compute->command_buffer();
+    auto backend = cmd_buf->backend().lock();
+
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, PREFILTER_MIP_LEVELS, 0, 6 };
+
+    async_compute->begin_pass("Cubemap Prefilter");
+
+    backend->acquire_resource(vk::QUEUE_TYPE_COMPUTE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image, subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+
+    record(cmd_buf);
+
+    // A compute queue cannot name the graphics stages that sample the map, the acquire on graphics does.
+    backend->release_resource(vk::QUEUE_TYPE_COMPUTE, vk::QUEUE_TYPE_GRAPHICS, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image, subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+
+    async_compute->end_pass();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CubemapPrefiler::release(vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto backend = cmd_buf->backend().lock();
+
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, PREFILTER_MIP_LEVELS, 0, 6 };
+
+    backend->release_resource(vk::QUEUE_TYPE_GRAPHICS, vk::QUEUE_TYPE_COMPUTE, VK_IMAGE_LAYOUT_GENERAL, m_image, subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CubemapPrefiler::acquire(vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto backend = cmd_buf->backend().lock();
+
+    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, PREFILTER_MIP_LEVELS, 0, 6 };
+
+    backend->acquire_resource(vk::QUEUE_TYPE_GRAPHICS, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image, subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CubemapPrefiler::record(vk::CommandBuffer::Ptr cmd_buf)
+{
+    int32_t start_level = (m_size / PREFILTER_MAP_SIZE) - 1;
+
+    for (int mip = 0; mip < PREFILTER_MIP_LEVELS; mip++)
+    {
+        uint32_t mip_width  = PREFILTER_MAP_SIZE * std::pow(0.5, mip);
+        uint32_t mip_height = PREFILTER_MAP_SIZE * std::pow(0.5, mip);
+
+        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline->handle());
+
+        PushConstants push_constants;
+
+        push_constants.roughness       = (float)mip / (float)(PREFILTER_MIP_LEVELS - 1);
+        push_constants.size            = mip_height;
+        push_constants.start_mip_level = start_level;
+        push_constants.sample_count    = m_sample_count;
+
+        vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout->handle(), 0, 1, &m_ds[mip]->handle(), 0, nullptr);
+
+        vkCmdDispatch(cmd_buf->handle(), mip_width / PREFILTER_WORK_GROUP_SIZE, mip_height / PREFILTER_WORK_GROUP_SIZE, 6);
+    }
+}
+
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void CubemapPrefiler::set_sample_count(const uint32_t& count)
 {
     if (m_sample_count != count)
@@ -2835,6 +2898,12 @@ uint32_t CubemapPrefiler::sample_count()
 
 void CubemapPrefiler::precompute_prefilter_constants()
 {
+    memory::ScratchScope scratch;
+
+    auto samples = memory::scratch_vector<glm::vec4>(scratch);
+
+    samples.resize(MAX_PREFILTER_SAMPLES);
+
     for (int mip = 0; mip < PREFILTER_MIP_LEVELS; mip++)
     {
         uint32_t mip_width  = PREFILTER_MAP_SIZE * std::pow(0.5, mip);
@@ -2842,10 +2911,6 @@ void CubemapPrefiler::precompute_prefilter_constants()
 
         float roughness = (float)mip / (float)(PREFILTER_MIP_LEVELS - 1);
 
-        std::vector<glm::vec4> samples;
-
-        samples.resize(MAX_PREFILTER_SAMPLES);
-
         for (int i = 0; i < m_sample_count; i++)
         {
             glm::vec2 Xi = hammersley(i, m_sample_count);
@@ -24,6 +24,16 @@ public:
 #endif
     );
 
+#if defined(DWSF_VULKAN)
+    // Records the update on the asynchronous compute queue. The prefiltered map is handed over with the graphics queue
+    // family: release() it on the graphics command buffer submitted before the compute work, and acquire() it on one that
+    // waits for the compute work before sampling it. The source cubemap must have been acquired on the compute queue by
+    // the caller, who may share it with other passes.
+    void update(vk::AsyncCompute::Ptr async_compute);
+    void release(vk::CommandBuffer::Ptr cmd_buf);
+    void acquire(vk::CommandBuffer::Ptr cmd_buf);
+#endif
+
 #if defined(DWSF_VULKAN)
     inline vk::Image::Ptr image()
     {
@@ -39,6 +49,9 @@ public:
 
 private:
     void precompute_prefilter_constants();
+#if defined(DWSF_VULKAN)
+    void record(vk::CommandBuffer::Ptr cmd_buf);
+#endif
 
 private:
     int m_sample_count = 32;
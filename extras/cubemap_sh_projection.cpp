@@ -4854,30 +4854,11 @@ void CubemapSHProjection::update(
 #if defined(DWSF_VULKAN)
     auto backend = cmd_buf->backend().lock();
 
-    VkImageSubresourceRange intermediate_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_intermediate_image, intermediate_subresource_range);
-
-    backend->flush_barriers(cmd_buf);
-
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_projection_pipeline->handle());
-    vkCmdPushConstants(cmd_buf->handle(), m_projection_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float), &m_size);
-    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_projection_pipeline_layout->handle(), 0, 1, &m_projection_ds->handle(), 0, nullptr);
-
-    vkCmdDispatch(cmd_buf->handle(), IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, 6);
-
-    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_intermediate_image, intermediate_subresource_range);
-
     VkImageSubresourceRange sh_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
 
     backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image, sh_subresource_range);
 
-    backend->flush_barriers(cmd_buf);
-
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_add_pipeline->handle());
-    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_add_pipeline_layout->handle(), 0, 1, &m_add_ds->handle(), 0, nullptr);
-
-    vkCmdDispatch(cmd_buf->handle(), 9, 1, 1);
+    record(cmd_buf);
 
     backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image, sh_subresource_range);
 
@@ -4910,5 +4891,89 @@ void CubemapSHProjection::update(
 #endif
 }
 
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_VULKAN)
+
+void CubemapSHProjection::update(vk::AsyncCompute::Ptr async_compute)
+{
+    auto cmd_buf = async_compute->command_buffer();
+    auto backend = cmd_buf->backend().lock();
+
+    VkImageSubresourceRange sh_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    async_compute->begin_pass("Cubemap SH Projection");
+
+    backend->acquire_resource(vk::QUEUE_TYPE_COMPUTE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_image, sh_subresource_range);
+
+    record(cmd_buf);
+
+    backend->release_resource(vk::QUEUE_TYPE_COMPUTE, vk::QUEUE_TYPE_GRAPHICS, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image, sh_subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+
+    async_compute->end_pass();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CubemapSHProjection::release(vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto backend = cmd_buf->backend().lock();
+
+    VkImageSubresourceRange sh_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    backend->release_resource(vk::QUEUE_TYPE_GRAPHICS, vk::QUEUE_TYPE_COMPUTE, VK_IMAGE_LAYOUT_GENERAL, m_image, sh_subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CubemapSHProjection::acquire(vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto backend = cmd_buf->backend().lock();
+
+    VkImageSubresourceRange sh_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+    backend->acquire_resource(vk::QUEUE_TYPE_GRAPHICS, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_image, sh_subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Records both dispatches. The barrier that makes the coefficients writable is left pending for the caller, and is flushed
+// along with the intermediate image's.
+void CubemapSHProjection::record(vk::CommandBuffer::Ptr cmd_buf)
+{
+    auto backend = cmd_buf->backend().lock();
+
+    VkImageSubresourceRange intermediate_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
+
+    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, m_intermediate_image, intermediate_subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_projection_pipeline->handle());
+    vkCmdPushConstants(cmd_buf->handle(), m_projection_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(float), &m_size);
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_projection_pipeline_layout->handle(), 0, 1, &m_projection_ds->handle(), 0, nullptr);
+
+    vkCmdDispatch(cmd_buf->handle(), IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, IRRADIANCE_CUBEMAP_SIZE / IRRADIANCE_WORK_GROUP_SIZE, 6);
+
+    // The intermediate image is only read by the add pass, so the barrier names no graphics stages and is valid on a compute
+    // queue.
+    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_intermediate_image, intermediate_subresource_range);
+
+    backend->flush_barriers(cmd_buf);
+
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_add_pipeline->handle());
+    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_add_pipeline_layout->handle(), 0, 1, &m_add_ds->handle(), 0, nullptr);
+
+    vkCmdDispatch(cmd_buf->handle(), 9, 1, 1);
+}
+
+#endif
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 } // namespace dw
\ No newline at end of file
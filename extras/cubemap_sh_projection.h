@@ -24,6 +24,15 @@ public:
 #endif
     );
 
+#if defined(DWSF_VULKAN)
+    // Records the projection on the asynchronous compute queue, handing the coefficients over with the graphics queue family
+    // in the same way as CubemapPrefiler::update(). The source cubemap must have been acquired on the compute queue by the
+    // caller.
+    void update(vk::AsyncCompute::Ptr async_compute);
+    void release(vk::CommandBuffer::Ptr cmd_buf);
+    void acquire(vk::CommandBuffer::Ptr cmd_buf);
+#endif
+
 #if defined(DWSF_VULKAN)
     inline vk::Image::Ptr image()
     {
@@ -34,6 +43,11 @@ public:
     inline gl::Texture2D::Ptr texture() { return m_texture; }
 #endif
 
+private:
+#if defined(DWSF_VULKAN)
+    void record(vk::CommandBuffer::Ptr cmd_buf);
+#endif
+
 private:
 #if defined(DWSF_VULKAN)
     vk::ImageView::Ptr           m_cubemap_image_view;
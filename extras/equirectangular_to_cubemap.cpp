@@ -1,15 +1,36 @@
 #include "equirectangular_to_cubemap.h"
 #include <glm.hpp>
 #include <algorithm>
+#include <stdexcept>
 #include <macros.h>
 #include <logger.h>
 #include <profiler.h>
+#include <jobs.h>
 #include <gtc/matrix_transform.hpp>
 #include <vk_mem_alloc.h>
 
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define DW_EQUIRECTANGULAR_SSE
+#endif
+
+// Generated from src/shaders/equirectangular_to_cubemap.comp and src/shaders/cubemap_capture.vert at build time.
+#if defined(DWSF_VULKAN)
+#    include <equirectangular_to_cubemap_rgba16f.spv.h>
+#    include <equirectangular_to_cubemap_rgba32f.spv.h>
+#    include <cubemap_capture.spv.h>
+#else
+#    include <equirectangular_to_cubemap.comp.h>
+#endif
+
+// Texels per side of the workgroups of the compute shader.
+#define EQUIRECTANGULAR_WORK_GROUP_SIZE 8
+// One view per face in the multiview pass of the graphics conversion.
+#define EQUIRECTANGULAR_FACE_VIEW_MASK 0x3F
+
 #undef min
 #undef max
 
@@ -18,332 +39,6 @@ namespace dw
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 #if defined(DWSF_VULKAN)
-static const unsigned int kCONVERT_VERT_SPIRV_size           = 1280;
-static const unsigned int kCONVERT_VERT_SPIRV_data[1280 / 4] = {
-    0x07230203,
-    0x00010000,
-    0x000d000a,
-    0x00000026,
-    0x00000000,
-    0x00020011,
-    0x00000001,
-    0x0006000b,
-    0x00000001,
-    0x4c534c47,
-    0x6474732e,
-    0x3035342e,
-    0x00000000,
-    0x0003000e,
-    0x00000000,
-    0x00000001,
-    0x0008000f,
-    0x00000000,
-    0x00000004,
-    0x6e69616d,
-    0x00000000,
-    0x00000009,
-    0x0000000b,
-    0x00000013,
-    0x00030003,
-    0x00000002,
-    0x000001c2,
-    0x000a0004,
-    0x475f4c47,
-    0x4c474f4f,
-    0x70635f45,
-    0x74735f70,
-    0x5f656c79,
-    0x656e696c,
-    0x7269645f,
-    0x69746365,
-    0x00006576,
-    0x00080004,
-    0x475f4c47,
-    0x4c474f4f,
-    0x6e695f45,
-    0x64756c63,
-    0x69645f65,
-    0x74636572,
-    0x00657669,
-    0x00040005,
-    0x00000004,
-    0x6e69616d,
-    0x00000000,
-    0x00060005,
-    0x00000009,
-    0x495f5346,
-    0x6f575f4e,
-    0x50646c72,
-    0x0000736f,
-    0x00060005,
-    0x0000000b,
-    0x495f5356,
-    0x6f505f4e,
-    0x69746973,
-    0x00006e6f,
-    0x00060005,
-    0x00000011,
-    0x505f6c67,
-    0x65567265,
-    0x78657472,
-    0x00000000,
-    0x00060006,
-    0x00000011,
-    0x00000000,
-    0x505f6c67,
-    0x7469736f,
-    0x006e6f69,
-    0x00070006,
-    0x00000011,
-    0x00000001,
-    0x505f6c67,
-    0x746e696f,
-    0x657a6953,
-    0x00000000,
-    0x00070006,
-    0x00000011,
-    0x00000002,
-    0x435f6c67,
-    0x4470696c,
-    0x61747369,
-    0x0065636e,
-    0x00070006,
-    0x00000011,
-    0x00000003,
-    0x435f6c67,
-    0x446c6c75,
-    0x61747369,
-    0x0065636e,
-    0x00030005,
-    0x00000013,
-    0x00000000,
-    0x00060005,
-    0x00000017,
-    0x68737550,
-    0x736e6f43,
-    0x746e6174,
-    0x00000073,
-    0x00060006,
-    0x00000017,
-    0x00000000,
-    0x77656976,
-    0x6f72705f,
-    0x0000006a,
-    0x00060005,
-    0x00000019,
-    0x75505f75,
-    0x6f436873,
-    0x6174736e,
-    0x0073746e,
-    0x00040047,
-    0x00000009,
-    0x0000001e,
-    0x00000000,
-    0x00040047,
-    0x0000000b,
-    0x0000001e,
-    0x00000000,
-    0x00050048,
-    0x00000011,
-    0x00000000,
-    0x0000000b,
-    0x00000000,
-    0x00050048,
-    0x00000011,
-    0x00000001,
-    0x0000000b,
-    0x00000001,
-    0x00050048,
-    0x00000011,
-    0x00000002,
-    0x0000000b,
-    0x00000003,
-    0x00050048,
-    0x00000011,
-    0x00000003,
-    0x0000000b,
-    0x00000004,
-    0x00030047,
-    0x00000011,
-    0x00000002,
-    0x00040048,
-    0x00000017,
-    0x00000000,
-    0x00000005,
-    0x00050048,
-    0x00000017,
-    0x00000000,
-    0x00000023,
-    0x00000000,
-    0x00050048,
-    0x00000017,
-    0x00000000,
-    0x00000007,
-    0x00000010,
-    0x00030047,
-    0x00000017,
-    0x00000002,
-    0x00020013,
-    0x00000002,
-    0x00030021,
-    0x00000003,
-    0x00000002,
-    0x00030016,
-    0x00000006,
-    0x00000020,
-    0x00040017,
-    0x00000007,
-    0x00000006,
-    0x00000003,
-    0x00040020,
-    0x00000008,
-    0x00000003,
-    0x00000007,
-    0x0004003b,
-    0x00000008,
-    0x00000009,
-    0x00000003,
-    0x00040020,
-    0x0000000a,
-    0x00000001,
-    0x00000007,
-    0x0004003b,
-    0x0000000a,
-    0x0000000b,
-    0x00000001,
-    0x00040017,
-    0x0000000d,
-    0x00000006,
-    0x00000004,
-    0x00040015,
-    0x0000000e,
-    0x00000020,
-    0x00000000,
-    0x0004002b,
-    0x0000000e,
-    0x0000000f,
-    0x00000001,
-    0x0004001c,
-    0x00000010,
-    0x00000006,
-    0x0000000f,
-    0x0006001e,
-    0x00000011,
-    0x0000000d,
-    0x00000006,
-    0x00000010,
-    0x00000010,
-    0x00040020,
-    0x00000012,
-    0x00000003,
-    0x00000011,
-    0x0004003b,
-    0x00000012,
-    0x00000013,
-    0x00000003,
-    0x00040015,
-    0x00000014,
-    0x00000020,
-    0x00000001,
-    0x0004002b,
-    0x00000014,
-    0x00000015,
-    0x00000000,
-    0x00040018,
-    0x00000016,
-    0x0000000d,
-    0x00000004,
-    0x0003001e,
-    0x00000017,
-    0x00000016,
-    0x00040020,
-    0x00000018,
-    0x00000009,
-    0x00000017,
-    0x0004003b,
-    0x00000018,
-    0x00000019,
-    0x00000009,
-    0x00040020,
-    0x0000001a,
-    0x00000009,
-    0x00000016,
-    0x0004002b,
-    0x00000006,
-    0x0000001e,
-    0x3f800000,
-    0x00040020,
-    0x00000024,
-    0x00000003,
-    0x0000000d,
-    0x00050036,
-    0x00000002,
-    0x00000004,
-    0x00000000,
-    0x00000003,
-    0x000200f8,
-    0x00000005,
-    0x0004003d,
-    0x00000007,
-    0x0000000c,
-    0x0000000b,
-    0x0003003e,
-    0x00000009,
-    0x0000000c,
-    0x00050041,
-    0x0000001a,
-    0x0000001b,
-    0x00000019,
-    0x00000015,
-    0x0004003d,
-    0x00000016,
-    0x0000001c,
-    0x0000001b,
-    0x0004003d,
-    0x00000007,
-    0x0000001d,
-    0x0000000b,
-    0x00050051,
-    0x00000006,
-    0x0000001f,
-    0x0000001d,
-    0x00000000,
-    0x00050051,
-    0x00000006,
-    0x00000020,
-    0x0000001d,
-    0x00000001,
-    0x00050051,
-    0x00000006,
-    0x00000021,
-    0x0000001d,
-    0x00000002,
-    0x00070050,
-    0x0000000d,
-    0x00000022,
-    0x0000001f,
-    0x00000020,
-    0x00000021,
-    0x0000001e,
-    0x00050091,
-    0x0000000d,
-    0x00000023,
-    0x0000001c,
-    0x00000022,
-    0x00050041,
-    0x00000024,
-    0x00000025,
-    0x00000013,
-    0x00000015,
-    0x0003003e,
-    0x00000025,
-    0x00000023,
-    0x000100fd,
-    0x00010038,
-};
-
-// -----------------------------------------------------------------------------------------------------------------------------------
-
 static const unsigned int kCONVERT_FRAG_SPIRV_size           = 1544;
 static const unsigned int kCONVERT_FRAG_SPIRV_data[1544 / 4] = {
     0x07230203,
@@ -734,264 +429,361 @@ static const unsigned int kCONVERT_FRAG_SPIRV_data[1544 / 4] = {
     0x00010038,
 };
 
-#else
-static const char* g_vs_src = R"(
-layout(location = 0) in vec3 VS_IN_Position;
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Compute shader variants, one per format qualifier of the cubemap.
+enum EquirectangularVariant
+{
+    EQUIRECTANGULAR_VARIANT_RGBA16F = 0,
+    EQUIRECTANGULAR_VARIANT_RGBA32F,
+    EQUIRECTANGULAR_VARIANT_COUNT
+};
 
-// ------------------------------------------------------------------
-// OUTPUT VARIABLES  ------------------------------------------------
-// ------------------------------------------------------------------
+#if defined(DWSF_VULKAN)
+static const VkFormat kEquirectangularFormats[] = { VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
 
-out vec3 FS_IN_WorldPos;
+struct EquirectangularSpirv
+{
+    const uint32_t* data;
+    size_t          size;
+};
 
-// ------------------------------------------------------------------
-// UNIFORMS  --------------------------------------------------------
-// ------------------------------------------------------------------
+static const EquirectangularSpirv kEquirectangularSpirv[] = {
+    { kEQUIRECTANGULAR_TO_CUBEMAP_RGBA16F_SPIRV, sizeof(kEQUIRECTANGULAR_TO_CUBEMAP_RGBA16F_SPIRV) },
+    { kEQUIRECTANGULAR_TO_CUBEMAP_RGBA32F_SPIRV, sizeof(kEQUIRECTANGULAR_TO_CUBEMAP_RGBA32F_SPIRV) }
+};
+#else
+static const GLenum kEquirectangularFormats[] = { GL_RGBA16F, GL_RGBA32F };
 
-uniform mat4 u_ViewProj;
+static const char* kEquirectangularFormatQualifiers[] = { "rgba16f", "rgba32f" };
+#endif
 
-// ------------------------------------------------------------------
-// MAIN  ------------------------------------------------------------
-// ------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-void main(void)
+// Returns EQUIRECTANGULAR_VARIANT_COUNT if the compute shader cannot write the format.
+template <typename Format>
+static uint32_t find_variant(Format format)
 {
-    FS_IN_WorldPos = VS_IN_Position;
-    gl_Position    = u_ViewProj * vec4(VS_IN_Position, 1.0);
+    for (uint32_t i = 0; i < EQUIRECTANGULAR_VARIANT_COUNT; i++)
+    {
+        if (kEquirectangularFormats[i] == format)
+            return i;
+    }
+
+    return EQUIRECTANGULAR_VARIANT_COUNT;
 }
 
-// ------------------------------------------------------------------
-)";
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Lanes of the CPU conversion. Directions and source coordinates are computed four at a time with SSE, and texels are
+// filtered as four-component vectors.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DW_EQUIRECTANGULAR_SSE)
+const uint32_t kLanes = 4;
+
+typedef __m128 FloatLanes;
+typedef __m128 MaskLanes;
+typedef __m128 Color;
+
+inline FloatLanes lanes_load(const float* p) { return _mm_loadu_ps(p); }
+inline FloatLanes lanes_set(float v) { return _mm_set1_ps(v); }
+inline FloatLanes lanes_index() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+inline FloatLanes lanes_add(FloatLanes a, FloatLanes b) { return _mm_add_ps(a, b); }
+inline FloatLanes lanes_sub(FloatLanes a, FloatLanes b) { return _mm_sub_ps(a, b); }
+inline FloatLanes lanes_mul(FloatLanes a, FloatLanes b) { return _mm_mul_ps(a, b); }
+inline FloatLanes lanes_div(FloatLanes a, FloatLanes b) { return _mm_div_ps(a, b); }
+inline FloatLanes lanes_min(FloatLanes a, FloatLanes b) { return _mm_min_ps(a, b); }
+inline FloatLanes lanes_max(FloatLanes a, FloatLanes b) { return _mm_max_ps(a, b); }
+inline FloatLanes lanes_sqrt(FloatLanes a) { return _mm_sqrt_ps(a); }
+inline FloatLanes lanes_abs(FloatLanes a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline MaskLanes  lanes_less(FloatLanes a, FloatLanes b) { return _mm_cmplt_ps(a, b); }
+inline FloatLanes lanes_select(MaskLanes m, FloatLanes a, FloatLanes b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+inline void       lanes_store(float* p, FloatLanes a) { _mm_storeu_ps(p, a); }
+
+// SSE2 has no rounding instructions, so truncate and step down where that rounded up.
+inline FloatLanes lanes_floor(FloatLanes a)
+{
+    FloatLanes t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(a, t), _mm_set1_ps(1.0f)));
+}
 
-static const char* g_fs_src = R"(
-// ------------------------------------------------------------------
-// INPUT VARIABLES  -------------------------------------------------
-// ------------------------------------------------------------------
+inline Color color_zero() { return _mm_setzero_ps(); }
+inline Color color_load(const float* p, uint32_t components) { return components == 4 ? _mm_loadu_ps(p) : _mm_setr_ps(p[0], p[1], p[2], 0.0f); }
+inline Color color_madd(Color acc, Color c, float w) { return _mm_add_ps(acc, _mm_mul_ps(c, _mm_set1_ps(w))); }
+inline void  color_store(float* p, Color c, float scale) { _mm_storeu_ps(p, _mm_mul_ps(c, _mm_set1_ps(scale))); }
+#else
+const uint32_t kLanes = 1;
+
+typedef float     FloatLanes;
+typedef bool      MaskLanes;
+typedef glm::vec4 Color;
+
+inline FloatLanes lanes_load(const float* p) { return *p; }
+inline FloatLanes lanes_set(float v) { return v; }
+inline FloatLanes lanes_index() { return 0.0f; }
+inline FloatLanes lanes_add(FloatLanes a, FloatLanes b) { return a + b; }
+inline FloatLanes lanes_sub(FloatLanes a, FloatLanes b) { return a - b; }
+inline FloatLanes lanes_mul(FloatLanes a, FloatLanes b) { return a * b; }
+inline FloatLanes lanes_div(FloatLanes a, FloatLanes b) { return a / b; }
+inline FloatLanes lanes_min(FloatLanes a, FloatLanes b) { return std::min(a, b); }
+inline FloatLanes lanes_max(FloatLanes a, FloatLanes b) { return std::max(a, b); }
+inline FloatLanes lanes_sqrt(FloatLanes a) { return std::sqrt(a); }
+inline FloatLanes lanes_abs(FloatLanes a) { return std::abs(a); }
+inline MaskLanes  lanes_less(FloatLanes a, FloatLanes b) { return a < b; }
+inline FloatLanes lanes_select(MaskLanes m, FloatLanes a, FloatLanes b) { return m ? a : b; }
+inline void       lanes_store(float* p, FloatLanes a) { *p = a; }
+inline FloatLanes lanes_floor(FloatLanes a) { return std::floor(a); }
+
+inline Color color_zero() { return Color(0.0f); }
+inline Color color_load(const float* p, uint32_t components) { return Color(p[0], p[1], p[2], components == 4 ? p[3] : 0.0f); }
+inline Color color_madd(Color acc, Color c, float w) { return acc + c * w; }
+inline void  color_store(float* p, Color c, float scale)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = c[i] * scale;
+}
+#endif
 
-in vec3 FS_IN_WorldPos;
+// atan2() to within 1e-5 radians, through the polynomial of Abramowitz and Stegun 4.4.49 on the octant and its reflections.
+inline FloatLanes lanes_atan2(FloatLanes y, FloatLanes x)
+{
+    FloatLanes ax = lanes_abs(x);
+    FloatLanes ay = lanes_abs(y);
+    FloatLanes a  = lanes_div(lanes_min(ax, ay), lanes_max(lanes_max(ax, ay), lanes_set(1e-30f)));
+    FloatLanes s  = lanes_mul(a, a);
+    FloatLanes r  = lanes_set(0.0208351f);
+
+    r = lanes_add(lanes_mul(r, s), lanes_set(-0.0851330f));
+    r = lanes_add(lanes_mul(r, s), lanes_set(0.1801410f));
+    r = lanes_add(lanes_mul(r, s), lanes_set(-0.3302995f));
+    r = lanes_add(lanes_mul(r, s), lanes_set(0.9998660f));
+    r = lanes_mul(r, a);
+
+    r = lanes_select(lanes_less(ax, ay), lanes_sub(lanes_set(float(M_PI_2)), r), r);
+    r = lanes_select(lanes_less(x, lanes_set(0.0f)), lanes_sub(lanes_set(float(M_PI)), r), r);
+
+    return lanes_select(lanes_less(y, lanes_set(0.0f)), lanes_sub(lanes_set(0.0f), r), r);
+}
 
-// ------------------------------------------------------------------
-// OUTPUT VARIABLES  ------------------------------------------------
-// ------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-out vec3 FS_OUT_Color;
+// Direction through (s, t) of a face, following the face selection table of the cubemap samplers as the compute shader does.
+inline void lanes_face_direction(uint32_t face, FloatLanes s, FloatLanes t, FloatLanes& x, FloatLanes& y, FloatLanes& z)
+{
+    const FloatLanes one  = lanes_set(1.0f);
+    const FloatLanes zero = lanes_set(0.0f);
 
-// ------------------------------------------------------------------
-// SAMPLERS ---------------------------------------------------------
-// ------------------------------------------------------------------
+    switch (face)
+    {
+        case 0:
+            x = one;
+            y = lanes_sub(zero, t);
+            z = lanes_sub(zero, s);
+            break;
+        case 1:
+            x = lanes_sub(zero, one);
+            y = lanes_sub(zero, t);
+            z = s;
+            break;
+        case 2:
+            x = s;
+            y = one;
+            z = t;
+            break;
+        case 3:
+            x = s;
+            y = lanes_sub(zero, one);
+            z = lanes_sub(zero, t);
+            break;
+        case 4:
+            x = s;
+            y = lanes_sub(zero, t);
+            z = one;
+            break;
+        default:
+            x = lanes_sub(zero, s);
+            y = lanes_sub(zero, t);
+            z = lanes_sub(zero, one);
+            break;
+    }
+}
 
-uniform sampler2D s_EnvMap;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-// ------------------------------------------------------------------
-// FUNCTIONS  -------------------------------------------------------
-// ------------------------------------------------------------------
+struct EquirectangularSource
+{
+    const float* pixels;
+    int32_t      width;
+    int32_t      height;
+    uint32_t     components;
+};
 
-const vec2 kInvATan = vec2(0.1591, 0.3183);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-vec2 sample_spherical_map(vec3 v)
+// Texel coordinates of the source along directions that need not be normalized, with the integer and fractional parts split
+// for bilinear filtering.
+inline void lanes_source_coords(const EquirectangularSource& source, FloatLanes x, FloatLanes y, FloatLanes z, float* x0, float* y0, float* fx, float* fy)
 {
-    vec2 uv = vec2(atan(v.z, v.x), asin(v.y));
-    uv *= kInvATan;
-    uv += 0.5;
-    return uv;
+    FloatLanes longitude = lanes_atan2(z, x);
+    FloatLanes latitude  = lanes_atan2(y, lanes_sqrt(lanes_add(lanes_mul(x, x), lanes_mul(z, z))));
+
+    FloatLanes u = lanes_mul(lanes_add(lanes_mul(longitude, lanes_set(float(0.5 / M_PI))), lanes_set(0.5f)), lanes_set(float(source.width)));
+    FloatLanes v = lanes_mul(lanes_add(lanes_mul(latitude, lanes_set(float(1.0 / M_PI))), lanes_set(0.5f)), lanes_set(float(source.height)));
+
+    u = lanes_sub(u, lanes_set(0.5f));
+    v = lanes_sub(v, lanes_set(0.5f));
+
+    FloatLanes u0 = lanes_floor(u);
+    FloatLanes v0 = lanes_floor(v);
+
+    lanes_store(x0, u0);
+    lanes_store(y0, v0);
+    lanes_store(fx, lanes_sub(u, u0));
+    lanes_store(fy, lanes_sub(v, v0));
 }
 
-// ------------------------------------------------------------------
-// MAIN  ------------------------------------------------------------
-// ------------------------------------------------------------------
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-void main()
+// Columns wrap around the sphere and rows are clamped at the poles, as the GPU conversion samples with repeat and clamp.
+inline Color sample_bilinear(const EquirectangularSource& source, float x0f, float y0f, float fx, float fy)
 {
-    vec2 uv    = sample_spherical_map(normalize(FS_IN_WorldPos));
-    vec3 color = texture(s_EnvMap, uv).rgb;
+    int32_t x0 = int32_t(x0f);
+    int32_t y0 = int32_t(y0f);
+    int32_t x1 = x0 + 1;
+    int32_t y1 = y0 + 1;
+
+    x0 = x0 < 0 ? x0 + source.width : (x0 >= source.width ? x0 - source.width : x0);
+    x1 = x1 < 0 ? x1 + source.width : (x1 >= source.width ? x1 - source.width : x1);
+    y0 = std::min(std::max(y0, 0), source.height - 1);
+    y1 = std::min(std::max(y1, 0), source.height - 1);
+
+    const size_t row_size = size_t(source.width) * source.components;
+    const float* row0     = source.pixels + size_t(y0) * row_size;
+    const float* row1     = source.pixels + size_t(y1) * row_size;
+
+    Color color = color_zero();
 
-    FS_OUT_Color = color;
+    color = color_madd(color, color_load(row0 + x0 * source.components, source.components), (1.0f - fx) * (1.0f - fy));
+    color = color_madd(color, color_load(row0 + x1 * source.components, source.components), fx * (1.0f - fy));
+    color = color_madd(color, color_load(row1 + x0 * source.components, source.components), (1.0f - fx) * fy);
+    color = color_madd(color, color_load(row1 + x1 * source.components, source.components), fx * fy);
+
+    return color;
 }
 
-// ------------------------------------------------------------------
-)";
-#endif
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Samples per axis that take one sample per texel of the source covered by the texel at (s, t), from the angle the texel
+// subtends and how far the source is stretched across at its latitude.
+uint32_t importance_sample_count(const EquirectangularSource& source, uint32_t face, float s, float t, float texel)
+{
+    const float r2           = 1.0f + s * s + t * t;
+    const float angle        = texel * std::sqrt(1.0f + std::max(s * s, t * t)) / r2;
+    const float y            = (face == 2 || face == 3) ? 1.0f : t;
+    const float cos_latitude = std::sqrt(std::max(1.0f - y * y / r2, 0.0f));
+    const float across       = angle * float(source.width) / (2.0f * float(M_PI) * std::max(cos_latitude, 1e-3f));
+    const float down         = angle * float(source.height) / float(M_PI);
+
+    return (uint32_t)std::min(std::max(std::ceil(std::max(across, down)), 1.0f), float(EQUIRECTANGULAR_MAX_SAMPLES));
+}
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-EquirectangularToCubemap::EquirectangularToCubemap(
-#if defined(DWSF_VULKAN)
-    vk::Backend::Ptr backend,
-    VkFormat         image_format
-#endif
-)
+void convert_row_bilinear(const EquirectangularSource& source, uint32_t face, uint32_t row, uint32_t face_size, float* dst)
 {
-    glm::mat4 capture_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-    glm::mat4 capture_views[]    = {
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
-    };
-
-    m_view_projection_mats.resize(6);
-
-    for (int i = 0; i < 6; i++)
-        m_view_projection_mats[i] = capture_projection * capture_views[i];
-
-    float cube_vertices[] = {
-        // back face
-        -1.0f,
-        -1.0f,
-        -1.0f,
-        // bottom-left
-        1.0f,
-        1.0f,
-        -1.0f,
-        // top-right
-        1.0f,
-        -1.0f,
-        -1.0f,
-        // bottom-right
-        1.0f,
-        1.0f,
-        -1.0f,
-        // top-right
-        -1.0f,
-        -1.0f,
-        -1.0f,
-        // bottom-left
-        -1.0f,
-        1.0f,
-        -1.0f,
-        // top-left
-        // front face
-        -1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-left
-        1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-right
-        1.0f,
-        1.0f,
-        1.0f,
-        // top-right
-        1.0f,
-        1.0f,
-        1.0f,
-        // top-right
-        -1.0f,
-        1.0f,
-        1.0f,
-        // top-left
-        -1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-left
-        // left face
-        -1.0f,
-        1.0f,
-        1.0f,
-        // top-right
-        -1.0f,
-        1.0f,
-        -1.0f,
-        // top-left
-        -1.0f,
-        -1.0f,
-        -1.0f,
-        // bottom-left
-        -1.0f,
-        -1.0f,
-        -1.0f,
-        // bottom-left
-        -1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-right
-        -1.0f,
-        1.0f,
-        1.0f,
-        // top-right
-        // right face
-        1.0f,
-        1.0f,
-        1.0f,
-        // top-left
-        1.0f,
-        -1.0f,
-        -1.0f,
-        // bottom-right
-        1.0f,
-        1.0f,
-        -1.0f,
-        // top-right
-        1.0f,
-        -1.0f,
-        -1.0f,
-        // bottom-right
-        1.0f,
-        1.0f,
-        1.0f,
-        // top-left
-        1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-left
-        // bottom face
-        -1.0f,
-        -1.0f,
-        -1.0f,
-        // top-right
-        1.0f,
-        -1.0f,
-        -1.0f,
-        // top-left
-        1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-left
-        1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-left
-        -1.0f,
-        -1.0f,
-        1.0f,
-        // bottom-right
-        -1.0f,
-        -1.0f,
-        -1.0f,
-        // top-right
-        // top face
-        -1.0f,
-        1.0f,
-        -1.0f,
-        // top-left
-        1.0f,
-        1.0f,
-        1.0f,
-        // bottom-right
-        1.0f,
-        1.0f,
-        -1.0f,
-        // top-right
-        1.0f,
-        1.0f,
-        1.0f,
-        // bottom-right
-        -1.0f,
-        1.0f,
-        -1.0f,
-        // top-left
-        -1.0f,
-        1.0f,
-        1.0f // bottom-left
-    };
+    const float      texel = 2.0f / float(face_size);
+    const FloatLanes t     = lanes_set((float(row) + 0.5f) * texel - 1.0f);
+
+    for (uint32_t i = 0; i < face_size; i += kLanes)
+    {
+        FloatLanes s = lanes_sub(lanes_mul(lanes_add(lanes_add(lanes_set(float(i)), lanes_index()), lanes_set(0.5f)), lanes_set(texel)), lanes_set(1.0f));
+        FloatLanes x, y, z;
+
+        lanes_face_direction(face, s, t, x, y, z);
+
+        float x0[kLanes], y0[kLanes], fx[kLanes], fy[kLanes];
+
+        lanes_source_coords(source, x, y, z, x0, y0, fx, fy);
+
+        for (uint32_t lane = 0; lane < kLanes && i + lane < face_size; lane++)
+        {
+            color_store(dst + (i + lane) * 4, sample_bilinear(source, x0[lane], y0[lane], fx[lane], fy[lane]), 1.0f);
+            dst[(i + lane) * 4 + 3] = 1.0f;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void convert_row_importance(const EquirectangularSource& source, uint32_t face, uint32_t row, uint32_t face_size, float* dst)
+{
+    const float texel = 2.0f / float(face_size);
+    const float t     = (float(row) + 0.5f) * texel - 1.0f;
+
+    for (uint32_t i = 0; i < face_size; i++)
+    {
+        const float    s     = (float(i) + 0.5f) * texel - 1.0f;
+        const uint32_t n     = importance_sample_count(source, face, s, t, texel);
+        const uint32_t count = n * n;
+        const float    step  = texel / float(n);
+
+        Color color        = color_zero();
+        float total_weight = 0.0f;
+
+        // Samples are spread over the lanes, the last one repeated where the count does not fill them.
+        for (uint32_t j = 0; j < count; j += kLanes)
+        {
+            float sample_s[kLanes], sample_t[kLanes];
+
+            for (uint32_t lane = 0; lane < kLanes; lane++)
+            {
+                uint32_t k = std::min(j + lane, count - 1);
+
+                sample_s[lane] = s + (float(k % n) + 0.5f) * step - 0.5f * texel;
+                sample_t[lane] = t + (float(k / n) + 0.5f) * step - 0.5f * texel;
+            }
+
+            FloatLanes ls = lanes_load(sample_s);
+            FloatLanes lt = lanes_load(sample_t);
+            FloatLanes x, y, z;
+
+            lanes_face_direction(face, ls, lt, x, y, z);
+
+            float x0[kLanes], y0[kLanes], fx[kLanes], fy[kLanes], weights[kLanes];
+
+            lanes_source_coords(source, x, y, z, x0, y0, fx, fy);
+
+            // The solid angle of a sample falls off with (1 + s^2 + t^2)^(-3/2) towards the corners of the face.
+            FloatLanes r2 = lanes_add(lanes_set(1.0f), lanes_add(lanes_mul(ls, ls), lanes_mul(lt, lt)));
+
+            lanes_store(weights, lanes_div(lanes_set(1.0f), lanes_mul(r2, lanes_sqrt(r2))));
+
+            for (uint32_t lane = 0; lane < kLanes && j + lane < count; lane++)
+            {
+                color = color_madd(color, sample_bilinear(source, x0[lane], y0[lane], fx[lane], fy[lane]), weights[lane]);
+                total_weight += weights[lane];
+            }
+        }
+
+        color_store(dst + i * 4, color, 1.0f / total_weight);
+        dst[i * 4 + 3] = 1.0f;
+    }
+}
+} // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------------------
 
 #if defined(DWSF_VULKAN)
-    m_backend = backend;
 
-    m_cube_vbo = vk::Buffer::create(backend, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(cube_vertices), VMA_MEMORY_USAGE_GPU_ONLY, 0, cube_vertices);
+EquirectangularToCubemap::EquirectangularToCubemap(vk::Backend::Ptr backend, VkFormat image_format)
+{
+    m_backend = backend;
 
     vk::DescriptorSetLayout::Desc ds_layout_desc;
 
@@ -1005,8 +797,8 @@ EquirectangularToCubemap::EquirectangularToCubemap(
 
     std::vector<char> vert_spirv;
 
-    vert_spirv.resize(kCONVERT_VERT_SPIRV_size);
-    memcpy(&vert_spirv[0], &kCONVERT_VERT_SPIRV_data[0], kCONVERT_VERT_SPIRV_size);
+    vert_spirv.resize(sizeof(kCUBEMAP_CAPTURE_VERT_SPIRV));
+    memcpy(&vert_spirv[0], &kCUBEMAP_CAPTURE_VERT_SPIRV[0], sizeof(kCUBEMAP_CAPTURE_VERT_SPIRV));
 
     std::vector<char> frag_spirv;
 
@@ -1025,11 +817,9 @@ EquirectangularToCubemap::EquirectangularToCubemap(
     // Create vertex input state
     // ---------------------------------------------------------------------------
 
+    // The capture shader generates the vertices of the faces, so there are no vertex buffers.
     vk::VertexInputStateDesc vertex_input_state_desc;
 
-    vertex_input_state_desc.add_binding_desc(0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX);
-    vertex_input_state_desc.add_attribute_desc(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
-
     pso_desc.set_vertex_input_state(vertex_input_state_desc);
 
     // ---------------------------------------------------------------------------
@@ -1122,7 +912,6 @@ EquirectangularToCubemap::EquirectangularToCubemap(
     vk::PipelineLayout::Desc pl_desc;
 
     pl_desc.add_descriptor_set_layout(m_ds_layout);
-    pl_desc.add_push_constant_range(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4));
 
     m_cubemap_pipeline_layout = vk::PipelineLayout::create(backend, pl_desc);
 
@@ -1142,6 +931,7 @@ EquirectangularToCubemap::EquirectangularToCubemap(
     pso_desc.add_color_attachment_format(image_format);
     pso_desc.set_depth_attachment_format(VK_FORMAT_UNDEFINED);
     pso_desc.set_stencil_attachment_format(VK_FORMAT_UNDEFINED);
+    pso_desc.set_view_mask(EQUIRECTANGULAR_FACE_VIEW_MASK);
 
     // ---------------------------------------------------------------------------
     // Create line list pipeline
@@ -1153,37 +943,52 @@ EquirectangularToCubemap::EquirectangularToCubemap(
 
     m_cubemap_pipeline = vk::GraphicsPipeline::create(backend, pso_desc);
 
-#else
-    m_vs = gl::Shader::create(GL_VERTEX_SHADER, g_vs_src);
-    m_fs = gl::Shader::create(GL_FRAGMENT_SHADER, g_fs_src);
+    // ---------------------------------------------------------------------------
+    // Create compute pipeline
+    // ---------------------------------------------------------------------------
 
-    if (!m_vs->compiled() || !m_fs->compiled())
-        DW_LOG_FATAL("Failed to create Shaders");
+    uint32_t variant = find_variant(image_format);
 
-    // Create general shader program
-    m_program = gl::Program::create({ m_vs, m_fs });
+    if (variant != EQUIRECTANGULAR_VARIANT_COUNT)
+    {
+        vk::DescriptorSetLayout::Desc compute_ds_layout_desc;
 
-    if (!m_program)
-        DW_LOG_FATAL("Failed to create Shader Program");
+        compute_ds_layout_desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+        compute_ds_layout_desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT);
 
-    m_vbo = gl::VertexBuffer::create(GL_STATIC_DRAW, sizeof(cube_vertices), cube_vertices);
+        m_compute_ds_layout = vk::DescriptorSetLayout::create(backend, compute_ds_layout_desc);
 
-    if (!m_vbo)
-        DW_LOG_ERROR("Failed to create Vertex Buffer");
+        vk::PipelineLayout::Desc compute_pl_desc;
 
-    // Declare vertex attributes.
-    gl::VertexAttrib attribs[] = {
-        { 3, GL_FLOAT, false, 0 },
-        { 3, GL_FLOAT, false, (3 * sizeof(float)) },
-        { 2, GL_FLOAT, false, (6 * sizeof(float)) }
-    };
+        compute_pl_desc.add_descriptor_set_layout(m_compute_ds_layout);
 
-    // Create vertex array.
-    m_vao = gl::VertexArray::create(m_vbo, nullptr, (8 * sizeof(float)), 3, attribs);
+        m_compute_pipeline_layout = vk::PipelineLayout::create(backend, compute_pl_desc);
 
-#endif
+        std::vector<char> comp_spirv;
+
+        comp_spirv.resize(kEquirectangularSpirv[variant].size);
+        memcpy(&comp_spirv[0], kEquirectangularSpirv[variant].data, kEquirectangularSpirv[variant].size);
+
+        vk::ShaderModule::Ptr cs = vk::ShaderModule::create(backend, comp_spirv);
+
+        vk::ComputePipeline::Desc comp_desc;
+
+        comp_desc.set_pipeline_layout(m_compute_pipeline_layout);
+        comp_desc.set_shader_stage(cs, "main");
+
+        m_compute_pipeline = vk::ComputePipeline::create(backend, comp_desc);
+    }
+}
+
+#else
+
+EquirectangularToCubemap::EquirectangularToCubemap() :
+    m_shaders(EQUIRECTANGULAR_VARIANT_COUNT), m_programs(EQUIRECTANGULAR_VARIANT_COUNT)
+{
 }
 
+#endif
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 EquirectangularToCubemap::~EquirectangularToCubemap()
@@ -1192,20 +997,12 @@ EquirectangularToCubemap::~EquirectangularToCubemap()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void EquirectangularToCubemap::convert(
 #if defined(DWSF_VULKAN)
-    vk::Image::Ptr input_image,
-    vk::Image::Ptr output_image
-#else
-    gl::Texture2D::Ptr input_image,
-    gl::Texture2D::Ptr output_image
-#endif
-)
+
+void EquirectangularToCubemap::convert(vk::Image::Ptr input_image, vk::Image::Ptr output_image)
 {
-#if defined(DWSF_VULKAN)
     auto backend = m_backend.lock();
 
-    auto ds               = backend->allocate_descriptor_set(m_ds_layout);
     auto input_image_view = vk::ImageView::create(backend, input_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1);
 
     VkDescriptorImageInfo image_info;
@@ -1215,55 +1012,109 @@ void EquirectangularToCubemap::convert(
     image_info.imageView   = input_image_view->handle();
     image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    VkWriteDescriptorSet write_data;
-    DW_ZERO_MEMORY(write_data);
+    VkImageSubresourceRange input_subresource_range  = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    VkImageSubresourceRange output_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
 
-    write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    write_data.descriptorCount = 1;
-    write_data.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    write_data.pImageInfo      = &image_info;
-    write_data.dstBinding      = 0;
-    write_data.dstSet          = ds->handle();
+    // Views and descriptor sets must outlive the submission below.
+    vk::DescriptorSet::Ptr          ds;
+    vk::ImageView::Ptr              output_image_view;
 
-    vkUpdateDescriptorSets(backend->device(), 1, &write_data, 0, nullptr);
+    auto cmd_buf = backend->allocate_graphics_command_buffer(true);
 
-    std::vector<vk::ImageView::Ptr> face_image_views(6);
+    if (m_compute_pipeline && (output_image->usage() & VK_IMAGE_USAGE_STORAGE_BIT))
+    {
+        ds                = backend->allocate_descriptor_set(m_compute_ds_layout);
+        output_image_view = vk::ImageView::create(backend, output_image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6);
 
-    for (int i = 0; i < 6; i++)
-        face_image_views[i] = vk::ImageView::create(backend, output_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, i, 1);
+        VkDescriptorImageInfo storage_image_info;
+        DW_ZERO_MEMORY(storage_image_info);
 
-    auto cmd_buf = backend->allocate_graphics_command_buffer(true);
+        storage_image_info.sampler     = VK_NULL_HANDLE;
+        storage_image_info.imageView   = output_image_view->handle();
+        storage_image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
-    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_cubemap_pipeline->handle());
+        VkWriteDescriptorSet write_data[2];
+        DW_ZERO_MEMORY(write_data[0]);
+        DW_ZERO_MEMORY(write_data[1]);
 
-    const VkDescriptorSet sets[] = { ds->handle() };
+        write_data[0].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data[0].descriptorCount = 1;
+        write_data[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write_data[0].pImageInfo      = &image_info;
+        write_data[0].dstBinding      = 0;
+        write_data[0].dstSet          = ds->handle();
 
-    vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_cubemap_pipeline_layout->handle(), 0, 1, sets, 0, nullptr);
+        write_data[1].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data[1].descriptorCount = 1;
+        write_data[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write_data[1].pImageInfo      = &storage_image_info;
+        write_data[1].dstBinding      = 1;
+        write_data[1].dstSet          = ds->handle();
 
-    VkImageSubresourceRange input_subresource_range  = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-    VkImageSubresourceRange output_subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
+        vkUpdateDescriptorSets(backend->device(), 2, &write_data[0], 0, nullptr);
+
+        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, input_image, input_subresource_range);
+        backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, output_image, output_subresource_range);
+
+        backend->flush_barriers(cmd_buf);
+
+        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_compute_pipeline->handle());
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, input_image, input_subresource_range);
-    backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, output_image, output_subresource_range);
+        const VkDescriptorSet sets[] = { ds->handle() };
 
-    backend->flush_barriers(cmd_buf);
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_compute_pipeline_layout->handle(), 0, 1, sets, 0, nullptr);
 
-    for (int i = 0; i < 6; i++)
+        uint32_t groups_x = (output_image->width() + EQUIRECTANGULAR_WORK_GROUP_SIZE - 1) / EQUIRECTANGULAR_WORK_GROUP_SIZE;
+        uint32_t groups_y = (output_image->height() + EQUIRECTANGULAR_WORK_GROUP_SIZE - 1) / EQUIRECTANGULAR_WORK_GROUP_SIZE;
+
+        // All six faces in one dispatch, the face being the z coordinate of the workgroup.
+        vkCmdDispatch(cmd_buf->handle(), groups_x, groups_y, 6);
+    }
+    else
     {
+        ds = backend->allocate_descriptor_set(m_ds_layout);
+
+        VkWriteDescriptorSet write_data;
+        DW_ZERO_MEMORY(write_data);
+
+        write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data.descriptorCount = 1;
+        write_data.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write_data.pImageInfo      = &image_info;
+        write_data.dstBinding      = 0;
+        write_data.dstSet          = ds->handle();
+
+        vkUpdateDescriptorSets(backend->device(), 1, &write_data, 0, nullptr);
+
+        // All six faces are the layers of a single view, each rendered by a view of the multiview pass.
+        output_image_view = vk::ImageView::create(backend, output_image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6);
+
+        vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_cubemap_pipeline->handle());
+
+        const VkDescriptorSet sets[] = { ds->handle() };
+
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_cubemap_pipeline_layout->handle(), 0, 1, sets, 0, nullptr);
+
+        backend->use_resource(VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, input_image, input_subresource_range);
+        backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, output_image, output_subresource_range);
+
+        backend->flush_barriers(cmd_buf);
+
         VkRenderingAttachmentInfoKHR color_attachment = {};
 
-        color_attachment.sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-        color_attachment.imageView        = face_image_views[i]->handle();
-        color_attachment.imageLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        color_attachment.loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        color_attachment.storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
-        color_attachment.clearValue.color = { 0.0f, 0.0f, 0.0f, 0.0f };
+        // Every texel of the faces is written, so their previous contents are not loaded.
+        color_attachment.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        color_attachment.imageView   = output_image_view->handle();
+        color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color_attachment.loadOp      = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        color_attachment.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
 
         VkRenderingInfoKHR rendering_info {};
 
         rendering_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
         rendering_info.renderArea           = { 0, 0, output_image->width(), output_image->height() };
         rendering_info.layerCount           = 1;
+        rendering_info.viewMask             = EQUIRECTANGULAR_FACE_VIEW_MASK;
         rendering_info.colorAttachmentCount = 1;
         rendering_info.pColorAttachments    = &color_attachment;
         rendering_info.pDepthAttachment     = nullptr;
@@ -1290,32 +1141,113 @@ void EquirectangularToCubemap::convert(
 
         vkCmdSetScissor(cmd_buf->handle(), 0, 1, &scissor_rect);
 
-        vkCmdPushConstants(cmd_buf->handle(), m_cubemap_pipeline_layout->handle(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(glm::mat4), &m_view_projection_mats[i]);
-
-        const VkBuffer     buffer = m_cube_vbo->handle();
-        const VkDeviceSize size   = 0;
-        vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &buffer, &size);
-
-        vkCmdDraw(cmd_buf->handle(), 36, 1, 0, 0);
+        // A triangle covering the face, drawn once into each of the six views.
+        vkCmdDraw(cmd_buf->handle(), 3, 1, 0, 0);
 
         vkCmdEndRenderingKHR(cmd_buf->handle());
     }
 
-    VkImageSubresourceRange subresource_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6 };
+    // The rest of the chain is generated from the first level in the same submission.
+    if (output_image->mip_levels() > 1)
+        output_image->generate_mipmaps(cmd_buf);
+    else
+    {
+        backend->use_resource(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, output_image, output_subresource_range);
 
-    backend->use_resource(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, output_image, subresource_range);
-    
-    backend->flush_barriers(cmd_buf);
+        backend->flush_barriers(cmd_buf);
+    }
 
     vkEndCommandBuffer(cmd_buf->handle());
 
     backend->flush_graphics({ cmd_buf });
+}
+
 #else
-    
-    // TODO: Implement OpenGL version.
+
+void EquirectangularToCubemap::convert(gl::Texture2D::Ptr input_image, gl::TextureCube::Ptr output_image)
+{
+    uint32_t variant = find_variant(output_image->internal_format());
+
+    if (variant == EQUIRECTANGULAR_VARIANT_COUNT)
+    {
+        DW_LOG_ERROR("OPENGL: Cubemap cannot be written by the equirectangular conversion, it needs to be GL_RGBA16F or GL_RGBA32F.");
+        return;
+    }
+
+    program(variant)->use();
+
+    input_image->bind(1);
+
+    // Bound layered, so that the dispatch writes all six faces.
+    glBindImageTexture(0, output_image->id(), 0, GL_TRUE, 0, GL_WRITE_ONLY, kEquirectangularFormats[variant]);
+
+    uint32_t groups_x = (output_image->width() + EQUIRECTANGULAR_WORK_GROUP_SIZE - 1) / EQUIRECTANGULAR_WORK_GROUP_SIZE;
+    uint32_t groups_y = (output_image->height() + EQUIRECTANGULAR_WORK_GROUP_SIZE - 1) / EQUIRECTANGULAR_WORK_GROUP_SIZE;
+
+    glDispatchCompute(groups_x, groups_y, 6);
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, kEquirectangularFormats[variant]);
+
+    // The rest of the chain is generated from the first level, by the downsampler where it has been initialized.
+    if (output_image->mip_levels() > 1)
+        output_image->generate_mipmaps();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+gl::Program::Ptr EquirectangularToCubemap::program(uint32_t variant)
+{
+    if (!m_programs[variant])
+    {
+        std::string source = "#define FORMAT " + std::string(kEquirectangularFormatQualifiers[variant]) + "\n";
+
+        source += kEQUIRECTANGULAR_TO_CUBEMAP_SOURCE;
+
+        m_shaders[variant] = gl::Shader::create(GL_COMPUTE_SHADER, source);
+
+        if (!m_shaders[variant] || !m_shaders[variant]->compiled())
+        {
+            DW_LOG_FATAL("OPENGL: Failed to compile the equirectangular conversion shader.");
+            throw std::runtime_error("OPENGL: Failed to compile the equirectangular conversion shader.");
+        }
+
+        m_programs[variant] = gl::Program::create({ m_shaders[variant] });
+    }
+
+    return m_programs[variant];
+}
 
 #endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void EquirectangularToCubemap::convert(const float* pixels, uint32_t width, uint32_t height, uint32_t components, uint32_t face_size, float* faces, EquirectangularFilter filter)
+{
+    if (components != 3 && components != 4)
+    {
+        DW_LOG_ERROR("Equirectangular images must have three or four components.");
+        return;
+    }
+
+    const EquirectangularSource source = { pixels, int32_t(width), int32_t(height), components };
+
+    // Rows of all six faces are spread over the workers, each written by one of them.
+    jobs::parallel_for(6 * face_size, EQUIRECTANGULAR_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t face = i / face_size;
+            uint32_t row  = i % face_size;
+            float*   dst  = faces + size_t(i) * face_size * 4;
+
+            if (filter == EQUIRECTANGULAR_FILTER_IMPORTANCE)
+                convert_row_importance(source, face, row, face_size, dst);
+            else
+                convert_row_bilinear(source, face, row, face_size, dst);
+        }
+    });
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
-} // namespace dw
\ No newline at end of file
+} // namespace dw
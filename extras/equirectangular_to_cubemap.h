@@ -4,28 +4,55 @@
 #include <ogl.h>
 #include <glm.hpp>
 
+// Samples per axis the importance filter takes at most out of a texel.
+#define EQUIRECTANGULAR_MAX_SAMPLES 8
+// Rows of a face converted by each job of the CPU conversion.
+#define EQUIRECTANGULAR_GRAIN_SIZE 8
+
 namespace dw
 {
+// How the CPU conversion filters the equirectangular image.
+enum EquirectangularFilter
+{
+    // A bilinear sample through the center of each texel, as the GPU conversion takes.
+    EQUIRECTANGULAR_FILTER_BILINEAR = 0,
+    // Bilinear samples spread over each texel, as many as the texel covers texels of the source, weighted by the solid angle
+    // they subtend. Towards the poles a texel covers a wide span of the source, which a single sample aliases.
+    EQUIRECTANGULAR_FILTER_IMPORTANCE
+};
+
+// Converts equirectangular environment maps into cubemaps. The GPU conversion writes the first level of all six faces in a
+// single compute dispatch, and the rest of the mip chain is generated right behind it in the same submission. Vulkan
+// cubemaps the compute shader cannot write, i.e. formats other than RGBA16F and RGBA32F or images without storage usage,
+// still go through the graphics pipeline, which renders all six faces in a single multiview pass.
+//
+// The CPU conversion needs no device at all, e.g. for offline baking or to check the GPU output on machines without one.
 class EquirectangularToCubemap
 {
 public:
-    EquirectangularToCubemap(
 #if defined(DWSF_VULKAN)
-        vk::Backend::Ptr backend,
-        VkFormat         image_format
-#endif 
-    );
+    EquirectangularToCubemap(vk::Backend::Ptr backend, VkFormat image_format);
+#else
+    EquirectangularToCubemap();
+#endif
     ~EquirectangularToCubemap();
 
-    void convert(
 #if defined(DWSF_VULKAN)
-        vk::Image::Ptr input_image,
-        vk::Image::Ptr output_image
+    void convert(vk::Image::Ptr input_image, vk::Image::Ptr output_image);
 #else
-        gl::Texture2D::Ptr input_image,
-        gl::Texture2D::Ptr output_image
-#endif 
-    );
+    // The cubemap must be GL_RGBA16F or GL_RGBA32F, which compute shaders can write.
+    void convert(gl::Texture2D::Ptr input_image, gl::TextureCube::Ptr output_image);
+#endif
+
+    // Converts linear pixels of three or four components into six faces of RGBA floats, ordered +X, -X, +Y, -Y, +Z, -Z and laid
+    // out as they are uploaded to a cubemap. Rows of the source run from the bottom of the sphere to the top, as they do for
+    // the GPU conversion, and columns wrap around. Rows are spread over the job system.
+    static void convert(const float* pixels, uint32_t width, uint32_t height, uint32_t components, uint32_t face_size, float* faces, EquirectangularFilter filter = EQUIRECTANGULAR_FILTER_BILINEAR);
+
+private:
+#if !defined(DWSF_VULKAN)
+    gl::Program::Ptr program(uint32_t variant);
+#endif
 
 private:
 #if defined(DWSF_VULKAN)
@@ -33,14 +60,13 @@ private:
     vk::GraphicsPipeline::Ptr         m_cubemap_pipeline;
     vk::PipelineLayout::Ptr           m_cubemap_pipeline_layout;
     vk::DescriptorSetLayout::Ptr      m_ds_layout;
-    vk::Buffer::Ptr                   m_cube_vbo;
+    // Null if the format has no compute variant.
+    vk::ComputePipeline::Ptr          m_compute_pipeline;
+    vk::PipelineLayout::Ptr           m_compute_pipeline_layout;
+    vk::DescriptorSetLayout::Ptr      m_compute_ds_layout;
 #else
-    gl::VertexBuffer::Ptr             m_vbo;
-    gl::VertexArray::Ptr              m_vao;
-    gl::Shader::Ptr                   m_vs;
-    gl::Shader::Ptr                   m_fs;
-    gl::Program::Ptr                  m_program;
+    std::vector<gl::Shader::Ptr>      m_shaders;
+    std::vector<gl::Program::Ptr>     m_programs;
 #endif
-    std::vector<glm::mat4>            m_view_projection_mats;
 };
-} // namespace dw
\ No newline at end of file
+} // namespace dw
@@ -10,6 +10,13 @@
 #    include <vk_mem_alloc.h>
 #endif
 
+// Generated from src/shaders/cubemap_capture.vert at build time.
+#if defined(DWSF_VULKAN)
+#    include <cubemap_capture.spv.h>
+#else
+#    include <cubemap_capture.vert.h>
+#endif
+
 #define _USE_MATH_DEFINES
 #include <math.h>
 
@@ -21,494 +28,12 @@
 namespace dw
 {
 #define SKY_CUBEMAP_SIZE 512
+// One view per face in the multiview pass of the capture.
+#define SKY_CUBEMAP_VIEW_MASK 0x3F
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 #if defined(DWSF_VULKAN)
-static const unsigned int kSKY_MODEL_VERT_SPIRV_size           = 1912;
-static const unsigned int kSKY_MODEL_VERT_SPIRV_data[1912 / 4] = {
-    0x07230203,
-    0x00010500,
-    0x0008000a,
-    0x0000002b,
-    0x00000000,
-    0x00020011,
-    0x00000001,
-    0x0006000b,
-    0x00000001,
-    0x4c534c47,
-    0x6474732e,
-    0x3035342e,
-    0x00000000,
-    0x0003000e,
-    0x00000000,
-    0x00000001,
-    0x000c000f,
-    0x00000000,
-    0x00000004,
-    0x6e69616d,
-    0x00000000,
-    0x00000009,
-    0x0000000b,
-    0x00000013,
-    0x00000019,
-    0x00000026,
-    0x00000027,
-    0x0000002a,
-    0x00030003,
-    0x00000002,
-    0x000001cc,
-    0x00040005,
-    0x00000004,
-    0x6e69616d,
-    0x00000000,
-    0x00060005,
-    0x00000009,
-    0x495f5346,
-    0x6f505f4e,
-    0x69746973,
-    0x00006e6f,
-    0x00060005,
-    0x0000000b,
-    0x495f5356,
-    0x6f505f4e,
-    0x69746973,
-    0x00006e6f,
-    0x00060005,
-    0x00000011,
-    0x505f6c67,
-    0x65567265,
-    0x78657472,
-    0x00000000,
-    0x00060006,
-    0x00000011,
-    0x00000000,
-    0x505f6c67,
-    0x7469736f,
-    0x006e6f69,
-    0x00070006,
-    0x00000011,
-    0x00000001,
-    0x505f6c67,
-    0x746e696f,
-    0x657a6953,
-    0x00000000,
-    0x00070006,
-    0x00000011,
-    0x00000002,
-    0x435f6c67,
-    0x4470696c,
-    0x61747369,
-    0x0065636e,
-    0x00070006,
-    0x00000011,
-    0x00000003,
-    0x435f6c67,
-    0x446c6c75,
-    0x61747369,
-    0x0065636e,
-    0x00030005,
-    0x00000013,
-    0x00000000,
-    0x00060005,
-    0x00000017,
-    0x68737550,
-    0x736e6f43,
-    0x746e6174,
-    0x00000073,
-    0x00060006,
-    0x00000017,
-    0x00000000,
-    0x77656976,
-    0x6f72705f,
-    0x0000006a,
-    0x00060006,
-    0x00000017,
-    0x00000001,
-    0x65726964,
-    0x6f697463,
-    0x0000006e,
-    0x00060005,
-    0x00000019,
-    0x75505f75,
-    0x6f436873,
-    0x6174736e,
-    0x0073746e,
-    0x00060005,
-    0x00000026,
-    0x495f5356,
-    0x6f4e5f4e,
-    0x6c616d72,
-    0x00000000,
-    0x00060005,
-    0x00000027,
-    0x495f5356,
-    0x65545f4e,
-    0x6f6f4378,
-    0x00006472,
-    0x00050005,
-    0x00000028,
-    0x46726550,
-    0x656d6172,
-    0x004f4255,
-    0x00040006,
-    0x00000028,
-    0x00000000,
-    0x00000041,
-    0x00040006,
-    0x00000028,
-    0x00000001,
-    0x00000042,
-    0x00040006,
-    0x00000028,
-    0x00000002,
-    0x00000043,
-    0x00040006,
-    0x00000028,
-    0x00000003,
-    0x00000044,
-    0x00040006,
-    0x00000028,
-    0x00000004,
-    0x00000045,
-    0x00040006,
-    0x00000028,
-    0x00000005,
-    0x00000046,
-    0x00040006,
-    0x00000028,
-    0x00000006,
-    0x00000047,
-    0x00040006,
-    0x00000028,
-    0x00000007,
-    0x00000048,
-    0x00040006,
-    0x00000028,
-    0x00000008,
-    0x00000049,
-    0x00040006,
-    0x00000028,
-    0x00000009,
-    0x0000005a,
-    0x00060005,
-    0x0000002a,
-    0x65505f75,
-    0x61724672,
-    0x4255656d,
-    0x0000004f,
-    0x00040047,
-    0x00000009,
-    0x0000001e,
-    0x00000000,
-    0x00040047,
-    0x0000000b,
-    0x0000001e,
-    0x00000000,
-    0x00050048,
-    0x00000011,
-    0x00000000,
-    0x0000000b,
-    0x00000000,
-    0x00050048,
-    0x00000011,
-    0x00000001,
-    0x0000000b,
-    0x00000001,
-    0x00050048,
-    0x00000011,
-    0x00000002,
-    0x0000000b,
-    0x00000003,
-    0x00050048,
-    0x00000011,
-    0x00000003,
-    0x0000000b,
-    0x00000004,
-    0x00030047,
-    0x00000011,
-    0x00000002,
-    0x00040048,
-    0x00000017,
-    0x00000000,
-    0x00000005,
-    0x00050048,
-    0x00000017,
-    0x00000000,
-    0x00000023,
-    0x00000000,
-    0x00050048,
-    0x00000017,
-    0x00000000,
-    0x00000007,
-    0x00000010,
-    0x00050048,
-    0x00000017,
-    0x00000001,
-    0x00000023,
-    0x00000040,
-    0x00030047,
-    0x00000017,
-    0x00000002,
-    0x00040047,
-    0x00000026,
-    0x0000001e,
-    0x00000001,
-    0x00040047,
-    0x00000027,
-    0x0000001e,
-    0x00000002,
-    0x00050048,
-    0x00000028,
-    0x00000000,
-    0x00000023,
-    0x00000000,
-    0x00050048,
-    0x00000028,
-    0x00000001,
-    0x00000023,
-    0x00000010,
-    0x00050048,
-    0x00000028,
-    0x00000002,
-    0x00000023,
-    0x00000020,
-    0x00050048,
-    0x00000028,
-    0x00000003,
-    0x00000023,
-    0x00000030,
-    0x00050048,
-    0x00000028,
-    0x00000004,
-    0x00000023,
-    0x00000040,
-    0x00050048,
-    0x00000028,
-    0x00000005,
-    0x00000023,
-    0x00000050,
-    0x00050048,
-    0x00000028,
-    0x00000006,
-    0x00000023,
-    0x00000060,
-    0x00050048,
-    0x00000028,
-    0x00000007,
-    0x00000023,
-    0x00000070,
-    0x00050048,
-    0x00000028,
-    0x00000008,
-    0x00000023,
-    0x00000080,
-    0x00050048,
-    0x00000028,
-    0x00000009,
-    0x00000023,
-    0x00000090,
-    0x00030047,
-    0x00000028,
-    0x00000002,
-    0x00040047,
-    0x0000002a,
-    0x00000022,
-    0x00000000,
-    0x00040047,
-    0x0000002a,
-    0x00000021,
-    0x00000000,
-    0x00020013,
-    0x00000002,
-    0x00030021,
-    0x00000003,
-    0x00000002,
-    0x00030016,
-    0x00000006,
-    0x00000020,
-    0x00040017,
-    0x00000007,
-    0x00000006,
-    0x00000003,
-    0x00040020,
-    0x00000008,
-    0x00000003,
-    0x00000007,
-    0x0004003b,
-    0x00000008,
-    0x00000009,
-    0x00000003,
-    0x00040020,
-    0x0000000a,
-    0x00000001,
-    0x00000007,
-    0x0004003b,
-    0x0000000a,
-    0x0000000b,
-    0x00000001,
-    0x00040017,
-    0x0000000d,
-    0x00000006,
-    0x00000004,
-    0x00040015,
-    0x0000000e,
-    0x00000020,
-    0x00000000,
-    0x0004002b,
-    0x0000000e,
-    0x0000000f,
-    0x00000001,
-    0x0004001c,
-    0x00000010,
-    0x00000006,
-    0x0000000f,
-    0x0006001e,
-    0x00000011,
-    0x0000000d,
-    0x00000006,
-    0x00000010,
-    0x00000010,
-    0x00040020,
-    0x00000012,
-    0x00000003,
-    0x00000011,
-    0x0004003b,
-    0x00000012,
-    0x00000013,
-    0x00000003,
-    0x00040015,
-    0x00000014,
-    0x00000020,
-    0x00000001,
-    0x0004002b,
-    0x00000014,
-    0x00000015,
-    0x00000000,
-    0x00040018,
-    0x00000016,
-    0x0000000d,
-    0x00000004,
-    0x0004001e,
-    0x00000017,
-    0x00000016,
-    0x00000007,
-    0x00040020,
-    0x00000018,
-    0x00000009,
-    0x00000017,
-    0x0004003b,
-    0x00000018,
-    0x00000019,
-    0x00000009,
-    0x00040020,
-    0x0000001a,
-    0x00000009,
-    0x00000016,
-    0x0004002b,
-    0x00000006,
-    0x0000001e,
-    0x3f800000,
-    0x00040020,
-    0x00000024,
-    0x00000003,
-    0x0000000d,
-    0x0004003b,
-    0x0000000a,
-    0x00000026,
-    0x00000001,
-    0x0004003b,
-    0x0000000a,
-    0x00000027,
-    0x00000001,
-    0x000c001e,
-    0x00000028,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x0000000d,
-    0x00040020,
-    0x00000029,
-    0x00000002,
-    0x00000028,
-    0x0004003b,
-    0x00000029,
-    0x0000002a,
-    0x00000002,
-    0x00050036,
-    0x00000002,
-    0x00000004,
-    0x00000000,
-    0x00000003,
-    0x000200f8,
-    0x00000005,
-    0x0004003d,
-    0x00000007,
-    0x0000000c,
-    0x0000000b,
-    0x0003003e,
-    0x00000009,
-    0x0000000c,
-    0x00050041,
-    0x0000001a,
-    0x0000001b,
-    0x00000019,
-    0x00000015,
-    0x0004003d,
-    0x00000016,
-    0x0000001c,
-    0x0000001b,
-    0x0004003d,
-    0x00000007,
-    0x0000001d,
-    0x0000000b,
-    0x00050051,
-    0x00000006,
-    0x0000001f,
-    0x0000001d,
-    0x00000000,
-    0x00050051,
-    0x00000006,
-    0x00000020,
-    0x0000001d,
-    0x00000001,
-    0x00050051,
-    0x00000006,
-    0x00000021,
-    0x0000001d,
-    0x00000002,
-    0x00070050,
-    0x0000000d,
-    0x00000022,
-    0x0000001f,
-    0x00000020,
-    0x00000021,
-    0x0000001e,
-    0x00050091,
-    0x0000000d,
-    0x00000023,
-    0x0000001c,
-    0x00000022,
-    0x00050041,
-    0x00000024,
-    0x00000025,
-    0x00000013,
-    0x00000015,
-    0x0003003e,
-    0x00000025,
-    0x00000023,
-    0x000100fd,
-    0x00010038,
-};
-
-// -----------------------------------------------------------------------------------------------------------------------------------
-
 static const unsigned int kSKY_MODEL_FRAG_SPIRV_size           = 4500;
 static const unsigned int kSKY_MODEL_FRAG_SPIRV_data[4500 / 4] = {
     0x07230203,
@@ -1639,26 +1164,24 @@ static const unsigned int kSKY_MODEL_FRAG_SPIRV_data[4500 / 4] = {
 };
 
 #else
-static const char* g_update_vs_src = R"(
+// Routes each instance of the capture to its face, where the vertex shader cannot.
+static const char* g_update_gs_src = R"(
 // ------------------------------------------------------------------
 // INPUTS -----------------------------------------------------------
 // ------------------------------------------------------------------
 
-layout (location = 0) in vec3 VS_IN_Position;
-layout (location = 1) in vec3 VS_IN_Normal;
-layout (location = 2) in vec3 VS_IN_TexCoord;
+layout(triangles) in;
+
+in vec3     GS_IN_Position[];
+flat in int GS_IN_Layer[];
 
 // ------------------------------------------------------------------
 // OUTPUTS ----------------------------------------------------------
 // ------------------------------------------------------------------
 
-out vec3 FS_IN_Position;
-
-// ------------------------------------------------------------------
-// UNIFORMS ---------------------------------------------------------
-// ------------------------------------------------------------------
+layout(triangle_strip, max_vertices = 3) out;
 
-uniform mat4 u_ViewProj;
+out vec3 FS_IN_Position;
 
 // ------------------------------------------------------------------
 // MAIN -------------------------------------------------------------
@@ -1666,8 +1189,16 @@ uniform mat4 u_ViewProj;
 
 void main()
 {
-    FS_IN_Position = VS_IN_Position;
-    gl_Position = u_ViewProj * vec4(VS_IN_Position, 1.0f);
+    for (int i = 0; i < 3; i++)
+    {
+        gl_Layer       = GS_IN_Layer[0];
+        gl_Position    = gl_in[i].gl_Position;
+        FS_IN_Position = GS_IN_Position[i];
+
+        EmitVertex();
+    }
+
+    EndPrimitive();
 }
 
 // ------------------------------------------------------------------
@@ -1823,6 +1354,7 @@ struct HosekWilkieUBO
 
 struct HosekWilkiePushConstants
 {
+    // Not read by the capture, but the fragment shader expects the direction behind it.
     glm::mat4 view_projection;
     glm::vec3 direction;
 };
@@ -1873,21 +1405,8 @@ HosekWilkieSkyModel::HosekWilkieSkyModel(
 #endif
 )
 {
-    glm::mat4 capture_projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
-    glm::mat4 capture_views[]    = {
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
-        glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))
-    };
-
-    m_view_projection_mats.resize(6);
-
-    for (int i = 0; i < 6; i++)
-        m_view_projection_mats[i] = capture_projection * capture_views[i];
-
+#if !defined(DWSF_VULKAN)
+    // The sky box rendered by render().
     float cube_vertices[] = {
         // back face
         -1.0f,
@@ -2184,6 +1703,7 @@ HosekWilkieSkyModel::HosekWilkieSkyModel(
         0.0f,
         0.0f // bottom-left
     };
+#endif
 
 #if defined(DWSF_VULKAN)
     m_cubemap_image = vk::Image::create(backend, VK_IMAGE_TYPE_2D, SKY_CUBEMAP_SIZE, SKY_CUBEMAP_SIZE, 1, 5, 6, VK_FORMAT_R16G16B16A16_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, 0, nullptr, VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT);
@@ -2192,15 +1712,8 @@ HosekWilkieSkyModel::HosekWilkieSkyModel(
     m_cubemap_image_view = vk::ImageView::create(backend, m_cubemap_image, VK_IMAGE_VIEW_TYPE_CUBE, VK_IMAGE_ASPECT_COLOR_BIT, 0, 5, 0, 6);
     m_cubemap_image_view->set_name("Procedural Sky Image View");
 
-    m_face_image_views.resize(6);
-
-    for (int i = 0; i < 6; i++)
-    {
-        m_face_image_views[i] = vk::ImageView::create(backend, m_cubemap_image, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, i, 1);
-        m_face_image_views[i]->set_name("Procedural Sky Face " + std::to_string(i) + " Image View");
-    }
-
-    m_cube_vbo = vk::Buffer::create(backend, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(cube_vertices), VMA_MEMORY_USAGE_GPU_ONLY, 0, cube_vertices);
+    m_layered_image_view = vk::ImageView::create(backend, m_cubemap_image, VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 6);
+    m_layered_image_view->set_name("Procedural Sky Layered Image View");
 
     vk::DescriptorSetLayout::Desc buffer_array_ds_layout_desc;
 
@@ -2234,8 +1747,8 @@ HosekWilkieSkyModel::HosekWilkieSkyModel(
 
     std::vector<char> vert_spirv;
 
-    vert_spirv.resize(kSKY_MODEL_VERT_SPIRV_size);
-    memcpy(&vert_spirv[0], &kSKY_MODEL_VERT_SPIRV_data[0], kSKY_MODEL_VERT_SPIRV_size);
+    vert_spirv.resize(sizeof(kCUBEMAP_CAPTURE_VERT_SPIRV));
+    memcpy(&vert_spirv[0], &kCUBEMAP_CAPTURE_VERT_SPIRV[0], sizeof(kCUBEMAP_CAPTURE_VERT_SPIRV));
 
     std::vector<char> frag_spirv;
 
@@ -2254,21 +1767,9 @@ HosekWilkieSkyModel::HosekWilkieSkyModel(
     // Create vertex input state
     // ---------------------------------------------------------------------------
 
+    // The capture shader generates the vertices of the faces, so there are no vertex buffers.
     vk::VertexInputStateDesc vertex_input_state_desc;
 
-    struct SkyboxVertex
-    {
-        glm::vec3 position;
-        glm::vec3 normal;
-        glm::vec2 texcoord;
-    };
-
-    vertex_input_state_desc.add_binding_desc(0, sizeof(SkyboxVertex), VK_VERTEX_INPUT_RATE_VERTEX);
-
-    vertex_input_state_desc.add_attribute_desc(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
-    vertex_input_state_desc.add_attribute_desc(1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(SkyboxVertex, normal));
-    vertex_input_state_desc.add_attribute_desc(2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(SkyboxVertex, texcoord));
-
     pso_desc.set_vertex_input_state(vertex_input_state_desc);
 
     // ---------------------------------------------------------------------------
@@ -2381,6 +1882,7 @@ HosekWilkieSkyModel::HosekWilkieSkyModel(
     pso_desc.add_color_attachment_format(VK_FORMAT_R16G16B16A16_SFLOAT);
     pso_desc.set_depth_attachment_format(VK_FORMAT_UNDEFINED);
     pso_desc.set_stencil_attachment_format(VK_FORMAT_UNDEFINED);
+    pso_desc.set_view_mask(SKY_CUBEMAP_VIEW_MASK);
 
     // ---------------------------------------------------------------------------
     // Create line list pipeline
@@ -2394,23 +1896,30 @@ HosekWilkieSkyModel::HosekWilkieSkyModel(
 
 #else
     m_cubemap = gl::TextureCube::create(SKY_CUBEMAP_SIZE, SKY_CUBEMAP_SIZE, 1, 1, GL_RGB16F, GL_RGB, GL_HALF_FLOAT);
-    m_depth   = gl::Texture2D::create(SKY_CUBEMAP_SIZE, SKY_CUBEMAP_SIZE, 1, 1, 1, GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT);
 
-    for (int i = 0; i < 6; i++)
+    // Attached without selecting a face, which makes all six layers of the framebuffer.
+    m_fbo = gl::Framebuffer::create({ m_cubemap }, nullptr);
+
+    // Each instance of the capture renders a face. Before GL_ARB_shader_viewport_layer_array only geometry shaders could
+    // select the layer.
+    if (GLAD_GL_ARB_shader_viewport_layer_array)
+        m_update_vs = gl::Shader::create(GL_VERTEX_SHADER, std::string("#define VERTEX_SHADER_LAYER\n") + kCUBEMAP_CAPTURE_VERT_SOURCE);
+    else
     {
-        gl::TextureCubeView::Ptr view = gl::TextureCubeView::create(m_cubemap, GL_TEXTURE_2D, 0, 1, i, 1);
-        m_texture_views.push_back(view);
-        m_fbos.push_back(gl::Framebuffer::create({ view }, m_depth));
+        m_update_vs = gl::Shader::create(GL_VERTEX_SHADER, kCUBEMAP_CAPTURE_VERT_SOURCE);
+        m_update_gs = gl::Shader::create(GL_GEOMETRY_SHADER, g_update_gs_src);
     }
 
-    m_update_vs = gl::Shader::create(GL_VERTEX_SHADER, g_update_vs_src);
     m_update_fs = gl::Shader::create(GL_FRAGMENT_SHADER, g_update_fs_src);
 
-    if (!m_update_vs->compiled() || !m_update_fs->compiled())
+    if (!m_update_vs->compiled() || (m_update_gs && !m_update_gs->compiled()) || !m_update_fs->compiled())
         DW_LOG_FATAL("Failed to create Shaders");
 
     // Create general shader program
-    m_update_program = gl::Program::create({ m_update_vs, m_update_fs });
+    if (m_update_gs)
+        m_update_program = gl::Program::create({ m_update_vs, m_update_gs, m_update_fs });
+    else
+        m_update_program = gl::Program::create({ m_update_vs, m_update_fs });
 
     m_render_vs = gl::Shader::create(GL_VERTEX_SHADER, g_render_vs_src);
     m_render_fs = gl::Shader::create(GL_FRAGMENT_SHADER, g_render_fs_src);
@@ -2452,17 +1961,17 @@ HosekWilkieSkyModel::~HosekWilkieSkyModel()
     m_ubo.reset();
     m_cubemap_pipeline.reset();
     m_cubemap_pipeline_layout.reset();
-    m_face_image_views.clear();
+    m_layered_image_view.reset();
     m_cubemap_image_view.reset();
     m_cubemap_image.reset();
 
 #else
     m_update_program.reset();
     m_update_vs.reset();
+    m_update_gs.reset();
     m_update_fs.reset();
-    m_fbos.clear();
+    m_fbo.reset();
     m_cubemap.reset();
-    m_depth.reset();
     m_vao.reset();
     m_vbo.reset();
 #endif
@@ -2538,63 +2047,58 @@ void HosekWilkieSkyModel::update(
 
     backend->flush_barriers(cmd_buf);
 
-    for (int i = 0; i < 6; i++)
-    {
-        VkRenderingAttachmentInfoKHR color_attachment = {};
+    VkRenderingAttachmentInfoKHR color_attachment = {};
 
-        color_attachment.sType            = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
-        color_attachment.imageView        = m_face_image_views[i]->handle();
-        color_attachment.imageLayout      = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        color_attachment.loadOp           = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        color_attachment.storeOp          = VK_ATTACHMENT_STORE_OP_STORE;
-        color_attachment.clearValue.color = { 0.0f, 0.0f, 0.0f, 1.0f };
+    // Every texel of the faces is written, so their previous contents are not loaded.
+    color_attachment.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+    color_attachment.imageView   = m_layered_image_view->handle();
+    color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_attachment.loadOp      = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    color_attachment.storeOp     = VK_ATTACHMENT_STORE_OP_STORE;
 
-        VkRenderingInfoKHR rendering_info {};
+    VkRenderingInfoKHR rendering_info {};
 
-        rendering_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
-        rendering_info.renderArea           = { 0, 0, SKY_CUBEMAP_SIZE, SKY_CUBEMAP_SIZE };
-        rendering_info.layerCount           = 1;
-        rendering_info.colorAttachmentCount = 1;
-        rendering_info.pColorAttachments    = &color_attachment;
-        rendering_info.pDepthAttachment     = nullptr;
+    rendering_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+    rendering_info.renderArea           = { 0, 0, SKY_CUBEMAP_SIZE, SKY_CUBEMAP_SIZE };
+    rendering_info.layerCount           = 1;
+    rendering_info.viewMask             = SKY_CUBEMAP_VIEW_MASK;
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachments    = &color_attachment;
+    rendering_info.pDepthAttachment     = nullptr;
 
-        vkCmdBeginRenderingKHR(cmd_buf->handle(), &rendering_info);
+    vkCmdBeginRenderingKHR(cmd_buf->handle(), &rendering_info);
 
-        VkViewport vp;
+    VkViewport vp;
 
-        vp.x        = 0.0f;
-        vp.y        = 0.0f;
-        vp.width    = (float)SKY_CUBEMAP_SIZE;
-        vp.height   = (float)SKY_CUBEMAP_SIZE;
-        vp.minDepth = 0.0f;
-        vp.maxDepth = 1.0f;
+    vp.x        = 0.0f;
+    vp.y        = 0.0f;
+    vp.width    = (float)SKY_CUBEMAP_SIZE;
+    vp.height   = (float)SKY_CUBEMAP_SIZE;
+    vp.minDepth = 0.0f;
+    vp.maxDepth = 1.0f;
 
-        vkCmdSetViewport(cmd_buf->handle(), 0, 1, &vp);
+    vkCmdSetViewport(cmd_buf->handle(), 0, 1, &vp);
 
-        VkRect2D scissor_rect;
+    VkRect2D scissor_rect;
 
-        scissor_rect.extent.width  = SKY_CUBEMAP_SIZE;
-        scissor_rect.extent.height = SKY_CUBEMAP_SIZE;
-        scissor_rect.offset.x      = 0;
-        scissor_rect.offset.y      = 0;
+    scissor_rect.extent.width  = SKY_CUBEMAP_SIZE;
+    scissor_rect.extent.height = SKY_CUBEMAP_SIZE;
+    scissor_rect.offset.x      = 0;
+    scissor_rect.offset.y      = 0;
 
-        vkCmdSetScissor(cmd_buf->handle(), 0, 1, &scissor_rect);
+    vkCmdSetScissor(cmd_buf->handle(), 0, 1, &scissor_rect);
 
-        HosekWilkiePushConstants push_constants;
+    HosekWilkiePushConstants push_constants;
 
-        push_constants.view_projection = m_view_projection_mats[i];
-        push_constants.direction       = direction;
+    push_constants.view_projection = glm::mat4(1.0f);
+    push_constants.direction       = direction;
 
-        vkCmdPushConstants(cmd_buf->handle(), m_cubemap_pipeline_layout->handle(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(HosekWilkiePushConstants), &push_constants);
+    vkCmdPushConstants(cmd_buf->handle(), m_cubemap_pipeline_layout->handle(), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(HosekWilkiePushConstants), &push_constants);
 
-        const VkBuffer     buffer = m_cube_vbo->handle();
-        const VkDeviceSize size   = 0;
-        vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &buffer, &size);
+    // A triangle covering the face, drawn once into each of the six views.
+    vkCmdDraw(cmd_buf->handle(), 3, 1, 0, 0);
 
-        vkCmdDraw(cmd_buf->handle(), 36, 1, 0, 0);
-
-        vkCmdEndRenderingKHR(cmd_buf->handle());
-    }
+    vkCmdEndRenderingKHR(cmd_buf->handle());
 
     backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_2_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_cubemap_image, output_subresource_range);
     
@@ -2617,21 +2121,14 @@ void HosekWilkieSkyModel::update(
     glDisable(GL_BLEND);
     glDisable(GL_CULL_FACE);
 
-    for (int i = 0; i < 6; i++)
-    {
-        m_update_program->set_uniform("u_ViewProj", m_view_projection_mats[i]);
-
-        m_fbos[i]->bind();
-        glViewport(0, 0, SKY_CUBEMAP_SIZE, SKY_CUBEMAP_SIZE);
+    m_fbo->bind();
+    glViewport(0, 0, SKY_CUBEMAP_SIZE, SKY_CUBEMAP_SIZE);
 
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClearDepth(1.0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        m_vao->bind();
+    // The capture shader generates its vertices, but drawing needs a vertex array bound.
+    m_vao->bind();
 
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-    }
+    // A triangle covering the face for each of the six instances, which select the layer they are rendered into.
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 3, 6);
 #endif
 }
 
@@ -7,6 +7,9 @@
 namespace dw
 {
 // An Analytic Model for Full Spectral Sky-Dome Radiance (Lukas Hosek, Alexander Wilkie)
+//
+// update() renders all six faces of the cubemap in a single draw, as the views of a multiview pass with Vulkan and as
+// instances routed to the layers of the cubemap with OpenGL.
 class HosekWilkieSkyModel
 {
 public:
@@ -35,7 +38,6 @@ public:
 #if defined(DWSF_VULKAN)
     inline vk::Image::Ptr     image() { return m_cubemap_image; }
     inline vk::ImageView::Ptr image_view() { return m_cubemap_image_view; }
-    inline vk::Buffer::Ptr    cube_vbo() { return m_cube_vbo; }
 #else
     inline gl::TextureCube::Ptr texture()
     {
@@ -46,35 +48,35 @@ public:
 
 private:
 #if defined(DWSF_VULKAN)
-    vk::Image::Ptr                  m_cubemap_image;
-    vk::ImageView::Ptr              m_cubemap_image_view;
-    std::vector<vk::ImageView::Ptr> m_face_image_views;
-    vk::GraphicsPipeline::Ptr       m_cubemap_pipeline;
-    vk::PipelineLayout::Ptr         m_cubemap_pipeline_layout;
-    vk::Buffer::Ptr                 m_cube_vbo;
-    vk::DescriptorSetLayout::Ptr    m_ds_layout;
-    vk::DescriptorSet::Ptr          m_ds;
-    vk::Buffer::Ptr                 m_ubo;
+    vk::Image::Ptr               m_cubemap_image;
+    vk::ImageView::Ptr           m_cubemap_image_view;
+    // The first level of the faces as an array, which the capture renders into.
+    vk::ImageView::Ptr           m_layered_image_view;
+    vk::GraphicsPipeline::Ptr    m_cubemap_pipeline;
+    vk::PipelineLayout::Ptr      m_cubemap_pipeline_layout;
+    vk::DescriptorSetLayout::Ptr m_ds_layout;
+    vk::DescriptorSet::Ptr       m_ds;
+    vk::Buffer::Ptr              m_ubo;
 
 #else
-    gl::TextureCube::Ptr                  m_cubemap;
-    std::vector<gl::TextureCubeView::Ptr> m_texture_views;
-    gl::Texture2D::Ptr                    m_depth;
-    std::vector<gl::Framebuffer::Ptr>     m_fbos;
-    gl::Buffer::Ptr                       m_vbo;
-    gl::VertexArray::Ptr                  m_vao;
-    gl::Shader::Ptr                       m_update_vs;
-    gl::Shader::Ptr                       m_update_fs;
-    gl::Program::Ptr                      m_update_program;
-    gl::Shader::Ptr                       m_render_vs;
-    gl::Shader::Ptr                       m_render_fs;
-    gl::Program::Ptr                      m_render_program;
+    gl::TextureCube::Ptr  m_cubemap;
+    // All six faces attached as layers.
+    gl::Framebuffer::Ptr  m_fbo;
+    gl::Buffer::Ptr       m_vbo;
+    gl::VertexArray::Ptr  m_vao;
+    gl::Shader::Ptr       m_update_vs;
+    // Null where the vertex shader selects the layer itself.
+    gl::Shader::Ptr       m_update_gs;
+    gl::Shader::Ptr       m_update_fs;
+    gl::Program::Ptr      m_update_program;
+    gl::Shader::Ptr       m_render_vs;
+    gl::Shader::Ptr       m_render_fs;
+    gl::Program::Ptr      m_render_program;
 #endif
-    std::vector<glm::mat4> m_view_projection_mats;
-    float                  m_normalized_sun_y = 1.15f;
-    float                  m_albedo           = 0.1f;
-    float                  m_turbidity        = 4.0f;
-    glm::vec3              A, B, C, D, E, F, G, H, I;
-    glm::vec3              Z;
+    float     m_normalized_sun_y = 1.15f;
+    float     m_albedo           = 0.1f;
+    float     m_turbidity        = 4.0f;
+    glm::vec3 A, B, C, D, E, F, G, H, I;
+    glm::vec3 Z;
 };
 } // namespace dw
\ No newline at end of file
@@ -48,6 +48,32 @@ RayTracedScene::Ptr RayTracedScene::create(vk::Backend::Ptr backend, std::vector
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+RayTracedScene::Ptr RayTracedScene::create(vk::Backend::Ptr backend, Scene::Ptr scene)
+{
+    std::vector<Instance> instances;
+    std::vector<uint32_t> nodes;
+
+    for (uint32_t node = 0; node < scene->node_count(); node++)
+    {
+        std::weak_ptr<Mesh> mesh = scene->mesh(node);
+
+        if (!mesh.expired())
+        {
+            instances.push_back({ scene->world_transform(node), mesh });
+            nodes.push_back(node);
+        }
+    }
+
+    RayTracedScene::Ptr rt_scene = std::shared_ptr<RayTracedScene>(new RayTracedScene(backend, instances));
+
+    rt_scene->m_scene       = scene;
+    rt_scene->m_scene_nodes = nodes;
+
+    return rt_scene;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> instances) :
     m_backend(backend), m_instances(instances), m_id(g_last_scene_idx++)
 {
@@ -171,9 +197,6 @@ RayTracedScene::RayTracedScene(vk::Backend::Ptr backend, std::vector<Instance> i
                 m_min_extents.z = min_extents.z;
         }
     }
-
-    m_rt_instances.reserve(m_instances.size());
-    m_instance_datas.reserve(m_instances.size());
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -199,6 +222,12 @@ void RayTracedScene::build_tlas(vk::CommandBuffer::Ptr cmd_buf)
 
     auto backend = m_backend.lock();
 
+    if (auto scene = m_scene.lock())
+    {
+        for (uint32_t i = 0; i < m_scene_nodes.size(); i++)
+            m_instances[i].transform = scene->world_transform(m_scene_nodes[i]);
+    }
+
     copy_tlas_data();
 
     backend->use_resource(VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR, m_tlas->buffer());
@@ -279,6 +308,11 @@ void RayTracedScene::create_gpu_resources()
     std::vector<VkDescriptorBufferInfo> material_indices_descriptors;
     std::vector<VkDescriptorImageInfo>  image_descriptors;
 
+    // The views of material images are written into descriptor sets that are never written again, so the images are pinned
+    // below. A defragmentation pass already in flight could still move them, and is completed first.
+    if (backend->memory_manager())
+        backend->memory_manager()->finish();
+
     m_material_indices_buffers.reserve(m_instances.size());
 
     for (auto& instance : m_instances)
@@ -344,6 +378,12 @@ void RayTracedScene::create_gpu_resources()
                     material_data.roughness_metallic = glm::vec4(mat->roughness_value(), mat->metallic_value(), 0.0f, 0.0f);
                     material_data.emissive           = glm::vec4(mat->emissive_value(), 0.0f);
 
+                    for (auto& image : { mat->albedo_image(), mat->normal_image(), mat->roughness_image(), mat->metallic_image(), mat->emissive_image() })
+                    {
+                        if (image)
+                            image->set_movable(false);
+                    }
+
                     if (mat->albedo_image_view())
                     {
                         VkDescriptorImageInfo image_info;
@@ -572,8 +612,9 @@ void RayTracedScene::create_gpu_resources()
 
 void RayTracedScene::copy_tlas_data()
 {
-    m_instance_datas.clear();
-    m_rt_instances.clear();
+    // Both buffers are persistently mapped, so the instances are written in place rather than staged in temporary arrays.
+    InstanceData*                       instance_datas = static_cast<InstanceData*>(m_instance_data_buffer->mapped_ptr());
+    VkAccelerationStructureInstanceKHR* rt_instances   = static_cast<VkAccelerationStructureInstanceKHR*>(m_tlas_instance_buffer->mapped_ptr());
 
     for (uint32_t i = 0; i < m_instances.size(); i++)
     {
@@ -589,7 +630,7 @@ void RayTracedScene::copy_tlas_data()
         instance_data.mesh_index   = m_local_to_global_mesh_idx[mesh->id()];
         instance_data.model_matrix = instance.transform;
 
-        m_instance_datas.emplace_back(instance_data);
+        instance_datas[i] = instance_data;
 
         // ------------------------------------------------------------------------------------------
         // VkAccelerationStructureInstanceKHR
@@ -600,17 +641,14 @@ void RayTracedScene::copy_tlas_data()
 
         memcpy(&rt_instance.transform, &transform, sizeof(rt_instance.transform));
 
-        rt_instance.instanceCustomIndex                    = m_rt_instances.size();
+        rt_instance.instanceCustomIndex                    = i;
         rt_instance.mask                                   = 0xFF;
         rt_instance.instanceShaderBindingTableRecordOffset = 0;
         rt_instance.flags                                  = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR;
         rt_instance.accelerationStructureReference         = mesh->acceleration_structure()->device_address();
 
-        m_rt_instances.emplace_back(rt_instance);
+        rt_instances[i] = rt_instance;
     }
-
-    memcpy(m_instance_data_buffer->mapped_ptr(), m_instance_datas.data(), sizeof(InstanceData) * m_instance_datas.size());
-    memcpy(m_tlas_instance_buffer->mapped_ptr(), m_rt_instances.data(), sizeof(VkAccelerationStructureInstanceKHR) * m_rt_instances.size());
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mesh.h>
+#include <scene.h>
 #include <unordered_set>
 
 #if defined(DWSF_VULKAN)
@@ -19,6 +20,8 @@ public:
     };
 
     static RayTracedScene::Ptr create(vk::Backend::Ptr backend, std::vector<Instance> instances);
+    // Creates an instance for every mesh node in the scene. World transforms are read back from the scene on every TLAS build.
+    static RayTracedScene::Ptr create(vk::Backend::Ptr backend, Scene::Ptr scene);
 
     ~RayTracedScene();
 
@@ -59,8 +62,6 @@ private:
     std::vector<vk::Buffer::Ptr>                    m_material_indices_buffers;
     std::vector<Instance>                           m_instances;
     std::vector<std::weak_ptr<Mesh>>                m_meshes;
-    std::vector<VkAccelerationStructureInstanceKHR> m_rt_instances;
-    std::vector<InstanceData>                       m_instance_datas;
     bool                                            m_tlas_built = false;
     vk::AccelerationStructure::Ptr                  m_tlas;
     vk::Buffer::Ptr                                 m_tlas_instance_buffer;
@@ -68,6 +69,8 @@ private:
     std::unordered_map<uint32_t, uint32_t>          m_local_to_global_mat_idx;
     std::unordered_map<uint32_t, uint32_t>          m_local_to_global_texture_idx;
     std::unordered_map<uint32_t, uint32_t>          m_local_to_global_mesh_idx;
+    std::weak_ptr<Scene>                            m_scene;
+    std::vector<uint32_t>                           m_scene_nodes;
 };
 } // namespace dw
 
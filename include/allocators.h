@@ -0,0 +1,296 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#define FRAME_ARENA_SIZE (4 * 1024 * 1024)
+#define SCRATCH_ARENA_BLOCK_SIZE (256 * 1024)
+#define POOL_BLOCKS_PER_CHUNK 256
+
+namespace dw
+{
+namespace memory
+{
+// Bump allocator over a list of blocks. Individual allocations are never freed; the whole allocator is rewound to a marker
+// or reset instead, and keeps its blocks for reuse. Not thread safe.
+class LinearAllocator
+{
+public:
+    struct Marker
+    {
+        size_t block  = 0;
+        size_t offset = 0;
+    };
+
+    LinearAllocator(size_t block_size = SCRATCH_ARENA_BLOCK_SIZE);
+    ~LinearAllocator();
+
+    void*  allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    Marker marker() const;
+    void   rewind(const Marker& marker);
+    void   reset();
+    size_t used() const;
+    size_t capacity() const;
+
+private:
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+private:
+    struct Block
+    {
+        uint8_t* data;
+        size_t   size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t             m_block_size;
+    size_t             m_current_block = 0;
+    size_t             m_offset        = 0;
+};
+
+// Fixed-capacity linear allocator that is reset at the start of every frame, so anything allocated from it is only valid
+// until the next Application::begin_frame(). Allocation is a single atomic add and may happen from any thread. Requests
+// that do not fit fall back to the heap and the arena grows to the high-water mark at the next reset.
+class FrameArena
+{
+public:
+    FrameArena(size_t capacity = FRAME_ARENA_SIZE);
+    ~FrameArena();
+
+    void*         allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void          reset();
+    inline size_t used() const { return std::min(m_offset.load(std::memory_order_relaxed), m_capacity); }
+    inline size_t capacity() const { return m_capacity; }
+
+private:
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+private:
+    uint8_t*            m_data;
+    size_t              m_capacity;
+    std::atomic<size_t> m_offset        = { 0 };
+    std::atomic<size_t> m_overflow_size = { 0 };
+    std::mutex          m_overflow_mutex;
+    std::vector<void*>  m_overflow;
+};
+
+// Free list of equally sized blocks, carved out of chunks that are only released with the pool. Not thread safe.
+class FixedSizePool
+{
+public:
+    FixedSizePool(size_t block_size, size_t blocks_per_chunk = POOL_BLOCKS_PER_CHUNK);
+    ~FixedSizePool();
+
+    void*         allocate();
+    void          deallocate(void* ptr);
+    inline size_t block_size() const { return m_block_size; }
+    inline size_t allocated_blocks() const { return m_allocated_blocks; }
+
+private:
+    FixedSizePool(const FixedSizePool&) = delete;
+    FixedSizePool& operator=(const FixedSizePool&) = delete;
+
+private:
+    std::vector<uint8_t*> m_chunks;
+    void*                 m_free_list = nullptr;
+    size_t                m_block_size;
+    size_t                m_blocks_per_chunk;
+    size_t                m_allocated_blocks = 0;
+};
+
+// First-fit allocator of ranges within a region it does not own, such as a mapped GPU buffer. It only hands out offsets, and
+// released ranges are merged with their free neighbours. Thread safe.
+class RangeAllocator
+{
+public:
+    RangeAllocator(size_t capacity = 0);
+
+    // Forgets every allocation.
+    void   reset(size_t capacity);
+    // Returns SIZE_MAX if no free range is large enough.
+    size_t allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    void   deallocate(size_t offset);
+    size_t used() const;
+    size_t capacity() const;
+
+private:
+    RangeAllocator(const RangeAllocator&) = delete;
+    RangeAllocator& operator=(const RangeAllocator&) = delete;
+
+private:
+    mutable std::mutex                 m_mutex;
+    // Offset to size of the free ranges and of the allocated ones.
+    std::map<size_t, size_t>           m_free;
+    std::unordered_map<size_t, size_t> m_allocated;
+    size_t                             m_capacity = 0;
+    size_t                             m_used     = 0;
+};
+
+// Typed wrapper around FixedSizePool for objects that are created and destroyed frequently.
+template <typename T>
+class ObjectPool
+{
+public:
+    ObjectPool(size_t objects_per_chunk = POOL_BLOCKS_PER_CHUNK) :
+        m_pool(sizeof(T), objects_per_chunk) {}
+
+    template <typename... Args>
+    T* create(Args&&... args)
+    {
+        return new (m_pool.allocate()) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object)
+    {
+        if (object)
+        {
+            object->~T();
+            m_pool.deallocate(object);
+        }
+    }
+
+    inline size_t size() const { return m_pool.allocated_blocks(); }
+
+private:
+    static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types are not supported by ObjectPool.");
+
+    FixedSizePool m_pool;
+};
+
+// Heap usage of the previous frame. Allocation counts are only tracked when built with DWSF_TRACK_ALLOCATIONS.
+struct FrameStats
+{
+    uint64_t allocations          = 0;
+    uint64_t allocated_bytes      = 0;
+    size_t   frame_arena_used     = 0;
+    size_t   frame_arena_capacity = 0;
+};
+
+// Latches the statistics of the frame that just ended and resets the frame arena. Called by Application::begin_frame().
+extern void       begin_frame();
+extern FrameStats frame_stats();
+
+// Allocator that is reset every frame. See FrameArena.
+extern FrameArena& frame_arena();
+// Per-thread allocator for temporaries. Use ScratchScope to release everything allocated within a scope.
+extern LinearAllocator& scratch_arena();
+
+// Rewinds the calling thread's scratch arena when leaving the scope.
+class ScratchScope
+{
+public:
+    ScratchScope() :
+        m_arena(scratch_arena()), m_marker(m_arena.marker()) {}
+    ~ScratchScope() { m_arena.rewind(m_marker); }
+
+    inline LinearAllocator& arena() { return m_arena; }
+
+private:
+    LinearAllocator&        m_arena;
+    LinearAllocator::Marker m_marker;
+};
+
+// STL allocator over any of the arenas above. Deallocation is a no-op; memory is reclaimed when the arena is reset.
+template <typename T, typename Arena>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U, Arena> other;
+    };
+
+    ArenaAllocator(Arena& arena) :
+        m_arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U, Arena>& other) :
+        m_arena(other.arena()) {}
+
+    inline T*     allocate(size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+    inline void   deallocate(T*, size_t) {}
+    inline Arena* arena() const { return m_arena; }
+
+    template <typename U>
+    inline bool operator==(const ArenaAllocator<U, Arena>& other) const { return m_arena == other.arena(); }
+    template <typename U>
+    inline bool operator!=(const ArenaAllocator<U, Arena>& other) const { return m_arena != other.arena(); }
+
+private:
+    Arena* m_arena;
+};
+
+// STL allocator drawing single elements from a FixedSizePool, meant for node based containers such as std::list and
+// std::map. The pool's block size must fit the container's node type; larger or array requests go to the heap.
+template <typename T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator(FixedSizePool& pool) :
+        m_pool(&pool) {}
+
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>& other) :
+        m_pool(other.pool()) {}
+
+    inline T* allocate(size_t n)
+    {
+        if (n == 1 && sizeof(T) <= m_pool->block_size() && alignof(T) <= alignof(std::max_align_t))
+            return static_cast<T*>(m_pool->allocate());
+
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    inline void deallocate(T* ptr, size_t n)
+    {
+        if (n == 1 && sizeof(T) <= m_pool->block_size() && alignof(T) <= alignof(std::max_align_t))
+            m_pool->deallocate(ptr);
+        else
+            ::operator delete(ptr);
+    }
+
+    inline FixedSizePool* pool() const { return m_pool; }
+
+    template <typename U>
+    inline bool operator==(const PoolAllocator<U>& other) const { return m_pool == other.pool(); }
+    template <typename U>
+    inline bool operator!=(const PoolAllocator<U>& other) const { return m_pool != other.pool(); }
+
+private:
+    FixedSizePool* m_pool;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T, FrameArena>>;
+template <typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T, LinearAllocator>>;
+using FrameString   = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char, FrameArena>>;
+
+template <typename T>
+inline FrameVector<T> frame_vector() { return FrameVector<T>(ArenaAllocator<T, FrameArena>(frame_arena())); }
+template <typename T>
+inline ScratchVector<T> scratch_vector(ScratchScope& scope) { return ScratchVector<T>(ArenaAllocator<T, LinearAllocator>(scope.arena())); }
+} // namespace memory
+} // namespace dw
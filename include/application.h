@@ -12,6 +12,9 @@
 #    include <GLFW/glfw3.h>
 #endif
 #include "vk.h"
+#include "staging_heap.h"
+#include "readback.h"
+#include "profiler.h"
 #include "logger.h"
 #include "timer.h"
 
@@ -27,6 +30,9 @@
 #define MAX_KEYS 1024
 #define MAX_MOUSE_BUTTONS 5
 
+// Maximum number of frames the CPU may record ahead of the GPU.
+#define MAX_FRAMES_IN_FLIGHT 3
+
 namespace dw
 {
 struct AppSettings
@@ -39,6 +45,35 @@ struct AppSettings
     int         height     = 600;
     std::string title      = "dwSampleFramwork";
 
+    // Frame pacing. One frame in flight with late input latching gives the lowest input latency, while
+    // MAX_FRAMES_IN_FLIGHT without latching keeps the GPU busiest. A frame rate limit of zero disables the limiter.
+    uint32_t frames_in_flight    = MAX_FRAMES_IN_FLIGHT;
+    bool     late_input_latching = true;
+    double   frame_rate_limit    = 0.0;
+
+    // Headless runs create no window or swap chain. Vulkan renders into offscreen images owned by the backend, while
+    // OpenGL uses an EGL pbuffer, or an OSMesa context created through GLFW where EGL is not available.
+    bool        headless    = false;
+    // Number of frames to run before exiting. Zero runs until an exit is requested.
+    uint32_t    frame_count = 0;
+    // If set, the last frame of a fixed-length run is saved here. The extension selects PNG or EXR.
+    std::string capture_path;
+
+    // Job system worker threads in addition to the main thread. Zero uses one per remaining hardware thread.
+    uint32_t worker_count = 0;
+
+    // Asset archives written by vfs::write_archive() to mount at startup, in increasing order of precedence. Files missing
+    // from every archive are still read from disk.
+    std::vector<std::string> archives;
+
+    // Bytes of the mapped buffer textures are decoded into and uploaded from. It is only allocated once a texture is loaded,
+    // and zero disables it.
+    size_t staging_heap_size = STAGING_HEAP_SIZE;
+
+    // Bytes of the mapped ring that Readback::common() copies textures into. It is only allocated once something is read
+    // back, and zero disables it.
+    size_t readback_ring_size = READBACK_RING_SIZE;
+
 #if defined(DWSF_VULKAN)
     std::vector<const char*> device_extensions;
     bool                     enable_validation       = false;
@@ -47,6 +82,9 @@ struct AppSettings
 #else
     int  major_ver             = 4;
     bool enable_debug_callback = false;
+    // Bytes of streamed texture uploads, i.e. the textures of materials, written per frame. The rest are queued for the
+    // following frames. Zero writes them as they are loaded and leaves the staging heap unused.
+    size_t upload_budget = STAGING_HEAP_UPLOAD_BUDGET;
 #endif
 };
 
@@ -91,6 +129,18 @@ protected:
     virtual void mouse_released(int code);
     virtual void mouse_move(double x, double y, double deltaX, double deltaY);
 
+    // Frame pacing controls. Frames in flight are clamped to [1, MAX_FRAMES_IN_FLIGHT].
+    void                       set_frames_in_flight(uint32_t count);
+    void                       set_frame_rate_limit(double frames_per_second);
+    inline void                set_late_input_latching(bool enabled) { m_late_input_latching = enabled; }
+    inline uint32_t            frames_in_flight() { return m_frames_in_flight; }
+    // Timings of the last completed frame. Those of the current frame are only known once it has been submitted.
+    inline const FrameTimings& frame_timings() { return m_last_frame_timings; }
+
+    // Saves the current frame to a PNG or EXR file (chosen by extension) once it has been rendered.
+    void        capture_frame(const std::string& path);
+    inline bool is_headless() { return m_headless; }
+
     // Application exit related-methods. Self-explanatory.
     void request_exit() const;
     bool exit_requested() const;
@@ -104,7 +154,8 @@ protected:
 #    if defined(DWSF_IMGUI)
     void render_gui(vk::CommandBuffer::Ptr cmd_buf);
 #    endif
-    void submit_and_present(const std::vector<vk::CommandBuffer::Ptr>& cmd_bufs);
+    // Work on other queues the frame depends on, e.g. AsyncCompute::submit(), is passed as wait points.
+    void submit_and_present(const std::vector<vk::CommandBuffer::Ptr>& cmd_bufs, const std::vector<vk::TimelinePoint>& wait_points = std::vector<vk::TimelinePoint>());
 #endif
 
 private:
@@ -112,6 +163,18 @@ private:
     void begin_frame();
     void end_frame();
 
+    // Blocks until enough earlier frames have completed on the GPU to start recording a new one.
+    void wait_for_frame_slot();
+    void limit_frame_rate();
+
+    // Reads back the final image of the current frame and writes it to disk.
+    bool save_frame(const std::string& path);
+
+#if defined(DWSF_EGL)
+    bool create_egl_context(int major_ver, int minor_ver);
+    void destroy_egl_context();
+#endif
+
     // Internal lifecycle methods
     bool init_base(int argc, const char* argv[]);
     void update_base(double delta);
@@ -139,13 +202,36 @@ protected:
     GLFWwindow*                         m_window;
     Timer                               m_timer;
     DebugDraw                           m_debug_draw;
+    uint32_t                            m_frames_in_flight    = MAX_FRAMES_IN_FLIGHT;
+    bool                                m_late_input_latching = true;
+    double                              m_frame_rate_limit    = 0.0;
+    FrameTimings                        m_frame_timings;
+    FrameTimings                        m_last_frame_timings;
+    // Started when the GPU is known to have drained all submitted work.
+    Timer                               m_gpu_idle_timer;
+    bool                                m_gpu_idle    = false;
+    bool                                m_headless    = false;
+    uint32_t                            m_frame_count = 0;
+    std::string                         m_capture_path;
+    std::string                         m_pending_capture_path;
+    // Headless runs have no window to flag for closing.
+    mutable bool                        m_exit_requested = false;
 
 #if defined(DWSF_VULKAN)
     bool                            m_should_recreate_swap_chain = false;
     vk::Backend::Ptr                m_vk_backend;
-    std::vector<vk::Fence::Ptr>     m_render_complete_fences;
     std::vector<vk::Semaphore::Ptr> m_present_complete_semaphores;
     std::vector<vk::Semaphore::Ptr> m_render_complete_semaphores;
+    // Point on the graphics timeline signaled by the last frame submitted from each frame slot.
+    std::array<vk::TimelinePoint, MAX_FRAMES_IN_FLIGHT> m_frame_timeline_points;
+#elif !defined(__EMSCRIPTEN__)
+    std::array<GLsync, MAX_FRAMES_IN_FLIGHT> m_frame_fences;
+#    if defined(DWSF_EGL)
+    // EGLDisplay, EGLSurface and EGLContext of the headless pbuffer context.
+    void* m_egl_display = nullptr;
+    void* m_egl_surface = nullptr;
+    void* m_egl_context = nullptr;
+#    endif
 #endif
 };
 } // namespace dw
@@ -5,11 +5,16 @@
 #include <macros.h>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <ogl.h>
 #include <vk.h>
 
-// Hard-limit of vertices. Used to reserve space in vertex and draw command vectors.
-#define MAX_VERTICES 100000
+// GPU vertex buffers grow in multiples of this many vertices.
+#define DEBUG_DRAW_VERTEX_CHUNK_SIZE 65536
+
+// GPU instance buffers grow in multiples of this many instances.
+#define DEBUG_DRAW_INSTANCE_CHUNK_SIZE 16384
 
 namespace dw
 {
@@ -26,6 +31,26 @@ struct VertexWorld
     glm::vec3 color;
 };
 
+// Unit wireframe meshes that are uploaded once and drawn through instancing.
+enum DebugPrimitive
+{
+    DEBUG_PRIMITIVE_BOX        = 0, // [-0.5, 0.5] on all axes.
+    DEBUG_PRIMITIVE_SPHERE     = 1, // Three great circles of radius 1.
+    DEBUG_PRIMITIVE_CIRCLE     = 2, // Circle of radius 1 in the XZ plane.
+    DEBUG_PRIMITIVE_HEMISPHERE = 3, // Two arcs of radius 1 above the XZ plane.
+    DEBUG_PRIMITIVE_CYLINDER   = 4, // Radius 1, from Y = 0 to Y = 1.
+    DEBUG_PRIMITIVE_CONE       = 5, // Base of radius 1 at Y = 0, apex at Y = 1.
+    DEBUG_PRIMITIVE_FRUSTUM    = 6, // NDC cube, meant to be transformed by an inverse view-projection matrix.
+    DEBUG_PRIMITIVE_COUNT      = 7
+};
+
+struct InstanceWorld
+{
+    glm::mat4 transform;
+    glm::vec3 color;
+    uint32_t  primitive;
+};
+
 struct DrawCommand
 {
     int   type;
@@ -34,6 +59,11 @@ struct DrawCommand
     bool  distance_fade;
     float fade_start;
     float fade_end;
+
+    inline bool same_state(const DrawCommand& other) const
+    {
+        return depth_test == other.depth_test && distance_fade == other.distance_fade && fade_start == other.fade_start && fade_end == other.fade_end;
+    }
 };
 
 const glm::vec4 kFrustumCorners[] = {
@@ -47,6 +77,12 @@ const glm::vec4 kFrustumCorners[] = {
     glm::vec4(1.0f, -1.0f, -1.0f, 1.0f)   // Near-Bottom-Right
 };
 
+// Shapes may be submitted from any thread. Every thread appends into its own buffer, so no locking takes place
+// on the hot path, and all buffers are merged into a single vertex stream at render(). Rendering must not overlap
+// with shape submission from other threads.
+//
+// Boxes, spheres, circles, capsules, cones and frustums only record a transform per call, and are drawn as instances
+// of unit meshes that are uploaded once.
 class DebugDraw
 {
 public:
@@ -60,26 +96,29 @@ public:
     );
     void shutdown();
 
-    inline void set_depth_test(const bool& depth_test) { m_depth_test = depth_test; }
-    inline bool depth_test() { return m_depth_test; }
-
-    inline void set_distance_fade(const bool& fade) { m_distance_fade = fade; }
-    inline bool distance_fade() { return m_distance_fade; }
-
-    inline void set_fade_start(const float& fade) { m_fade_start = fade; }
-    inline bool fade_start() { return m_fade_start; }
+    // Draw state. These apply to the calling thread only.
+    void  set_depth_test(const bool& depth_test);
+    bool  depth_test();
+    void  set_distance_fade(const bool& fade);
+    bool  distance_fade();
+    void  set_fade_start(const float& fade);
+    float fade_start();
+    void  set_fade_end(const float& fade);
+    float fade_end();
 
-    inline void set_fade_end(const float& fade) { m_fade_end = fade; }
-    inline bool fade_end() { return m_fade_end; }
+    // Kept for existing callers. Shapes sharing the same draw state are always merged into one draw, so these do nothing.
+    inline void begin_batch() {}
+    inline void end_batch() {}
 
     // Debug shape drawing.
-    void begin_batch();
-    void end_batch();
     void capsule(const float& _height, const float& _radius, const glm::vec3& _pos, const glm::vec3& _c);
     void aabb(const glm::vec3& _min, const glm::vec3& _max, const glm::vec3& _c);
     void obb(const glm::vec3& _min, const glm::vec3& _max, const glm::mat4& _model, const glm::vec3& _c);
     void grid(const float& _x, const float& _z, const float& _y_level, const float& spacing, const glm::vec3& _c);
     void grid(const glm::mat4& view_proj, const float& unit_size, const float& highlight_unit_size);
+    void cone(const float& _height, const float& _radius, const glm::vec3& _pos, const glm::vec3& _c);
+    void cylinder(const float& _height, const float& _radius, const glm::vec3& _pos, const glm::vec3& _c);
+    void primitive(const DebugPrimitive& primitive, const glm::mat4& transform, const glm::vec3& c);
     void line(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& c);
     void line_strip(glm::vec3* v, const int& count, const glm::vec3& c);
     void circle_xy(float radius, const glm::vec3& pos, const glm::vec3& c);
@@ -97,57 +136,107 @@ public:
     void                 render(gl::Framebuffer::Ptr fbo, int width, int height, const glm::mat4& view_proj, const glm::vec3& view_pos);
 #endif
 
-#if defined(DWSF_VULKAN)
 private:
+    // A run of line list vertices and primitive instances sharing the same draw state.
+    struct DrawBatch
+    {
+        DrawCommand                cmd;
+        std::vector<VertexWorld>   vertices;
+        std::vector<InstanceWorld> instances;
+    };
+
+    // Instances of a single primitive sharing the same draw state.
+    struct InstanceCommand
+    {
+        DrawCommand cmd;
+        uint32_t    primitive;
+        uint32_t    first_instance;
+        uint32_t    instance_count;
+    };
+
+    // Per-thread append buffer.
+    struct ThreadBuffer
+    {
+        std::thread::id        thread_id;
+        DrawCommand            state;
+        int32_t                current_batch = -1;
+        std::vector<DrawBatch> batches;
+    };
+
+    ThreadBuffer& thread_buffer();
+    DrawBatch&    current_batch(ThreadBuffer& buffer);
+    size_t        merge_draw_commands();
+    size_t        merge_instance_commands();
+    void          copy_vertices(VertexWorld* dst);
+    void          create_primitive_meshes();
+
+#if defined(DWSF_VULKAN)
     void create_descriptor_set_layout(vk::Backend::Ptr backend);
     void create_descriptor_set(vk::Backend::Ptr backend);
     void create_uniform_buffer(vk::Backend::Ptr backend);
-    void create_vertex_buffer(vk::Backend::Ptr backend);
+    void create_vertex_buffer(vk::Backend::Ptr backend, uint32_t frame_idx, size_t vertex_count);
+    void create_instance_buffer(vk::Backend::Ptr backend, uint32_t frame_idx, size_t instance_count);
     void create_pipeline_states(vk::Backend::Ptr backend);
+#else
+    void create_vertex_buffer(size_t vertex_count);
+    void create_instance_buffer(size_t instance_count);
+    // Points the per-instance attributes of the bound vertex array at the given instance.
+    void bind_instance_attributes(uint32_t first_instance);
 #endif
 
 private:
-    // Vertex list to be uploaded to GPU.
-    std::vector<VertexWorld> m_world_vertices;
+    // Unique id used to match thread-local buffer caches to this instance. Renewed whenever the buffers are freed.
+    uint64_t m_id;
 
-    // Draw command list.
-    std::vector<DrawCommand> m_draw_commands;
+    // Append buffers of every thread that has submitted shapes.
+    std::mutex                                 m_thread_buffers_mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> m_thread_buffers;
 
-    // Camera matrix.
-    CameraUniforms m_uniforms;
+    // Merged draw command list, one entry per unique draw state.
+    std::vector<DrawCommand> m_draw_commands;
 
-    // Depth state
-    bool m_depth_test = false;
+    // Merged instance list, sorted by draw state and primitive.
+    std::vector<InstanceCommand> m_instance_commands;
+    std::vector<InstanceWorld>   m_instances;
 
-    // Batching
-    uint32_t m_batch_start  = 0;
-    uint32_t m_batch_end    = 0;
-    bool     m_batched_mode = false;
+    // Line list vertices of all unit primitives, back to back.
+    std::vector<glm::vec3> m_primitive_vertices;
+    uint32_t               m_primitive_first_vertex[DEBUG_PRIMITIVE_COUNT];
+    uint32_t               m_primitive_vertex_count[DEBUG_PRIMITIVE_COUNT];
 
-    // Fading
-    float m_fade_end      = 0.0f;
-    float m_fade_start    = 0.0f;
-    bool  m_distance_fade = false;
+    // Camera matrix.
+    CameraUniforms m_uniforms;
 
     // GPU resources.
 #if defined(DWSF_VULKAN)
     size_t                       m_ubo_size;
-    size_t                       m_vbo_size;
-    vk::Buffer::Ptr              m_line_vbo;
+    size_t                       m_vbo_capacity[vk::Backend::kMaxFramesInFlight]      = {};
+    size_t                       m_instance_capacity[vk::Backend::kMaxFramesInFlight] = {};
+    vk::Buffer::Ptr              m_line_vbos[vk::Backend::kMaxFramesInFlight];
+    vk::Buffer::Ptr              m_instance_vbos[vk::Backend::kMaxFramesInFlight];
+    vk::Buffer::Ptr              m_primitive_vbo;
     vk::Buffer::Ptr              m_ubo;
     vk::PipelineLayout::Ptr      m_pipeline_layout;
     vk::DescriptorSetLayout::Ptr m_ds_layout;
     vk::DescriptorSet::Ptr       m_ds;
     vk::GraphicsPipeline::Ptr    m_line_depth_pipeline;
     vk::GraphicsPipeline::Ptr    m_line_no_depth_pipeline;
-    vk::GraphicsPipeline::Ptr    m_line_strip_depth_pipeline;
-    vk::GraphicsPipeline::Ptr    m_line_strip_no_depth_pipeline;
+    vk::GraphicsPipeline::Ptr    m_instance_depth_pipeline;
+    vk::GraphicsPipeline::Ptr    m_instance_no_depth_pipeline;
 #else
+    size_t               m_vbo_capacity      = 0;
+    size_t               m_instance_capacity = 0;
+    bool                 m_base_instance     = false;
     gl::VertexArray::Ptr m_line_vao;
     gl::Buffer::Ptr      m_line_vbo;
     gl::Shader::Ptr      m_line_vs;
     gl::Shader::Ptr      m_line_fs;
     gl::Program::Ptr     m_line_program;
+    GLuint               m_instance_vao = 0;
+    gl::Buffer::Ptr      m_primitive_vbo;
+    gl::Buffer::Ptr      m_instance_vbo;
+    gl::Shader::Ptr      m_instance_vs;
+    gl::Program::Ptr     m_instance_program;
     gl::Buffer::Ptr      m_ubo;
 #endif
 };
@@ -3,11 +3,96 @@
 #include <camera.h>
 #include <debug_draw.h>
 #include <vector>
+#include <string>
+#include <fstream>
+
+// Camera path files start with a CameraPathHeader followed by any number of track chunks. Each chunk is a
+// CameraPathTrackHeader immediately followed by its keys, so new tracks can be appended without rewriting the file.
+#define CAMERA_PATH_MAGIC 0x50435744 // "DWCP"
+#define CAMERA_PATH_VERSION 1
+#define CAMERA_PATH_TRACK_NAME_SIZE 64
+// Written by the recorder until the track is closed. Such a track can only be the last one in the file, so readers take
+// every remaining key, and the recorder closes it before appending another track.
+#define CAMERA_PATH_KEY_COUNT_UNKNOWN 0xFFFFFFFF
+// Keys carry recorded timestamps and are played back in time rather than at a constant velocity.
+#define CAMERA_PATH_TRACK_TIMED 1
 
 namespace dw
 {
+struct CameraPathHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t key_size;
+    uint32_t reserved;
+};
+
+struct CameraPathTrackHeader
+{
+    char     name[CAMERA_PATH_TRACK_NAME_SIZE];
+    uint32_t key_count;
+    uint32_t flags;
+};
+
+struct CameraPathKey
+{
+    float     time;
+    // Vertical field of view in degrees. Zero leaves the camera projection untouched.
+    float     fov;
+    // Playback speed in units per second. Zero uses the player speed.
+    float     speed;
+    glm::vec3 position;
+    glm::vec3 forward;
+    glm::vec3 right;
+};
+
+struct CameraPathTrack
+{
+    std::string            name;
+    uint32_t               flags = 0;
+    std::vector<float>     times;
+    std::vector<float>     fovs;
+    std::vector<float>     speeds;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> forwards;
+    std::vector<glm::vec3> rights;
+
+    void     add_key(const CameraPathKey& key);
+    void     reserve(uint32_t count);
+    uint32_t key_count();
+};
+
+// Appends a timed track to a camera path file. Keys are buffered and written in blocks so capturing every frame stays cheap.
+class CameraPathRecorder
+{
+private:
+    // Number of keys buffered before they are written to the file.
+    static const uint32_t kFlushKeyCount = 256;
+
+    std::fstream               m_file;
+    std::streamoff             m_track_offset = 0;
+    uint32_t                   m_key_count    = 0;
+    float                      m_time         = 0.0f;
+    glm::vec3                  m_last_position;
+    std::vector<CameraPathKey> m_pending_keys;
+
+public:
+    ~CameraPathRecorder();
+    bool begin(const std::string& path, const std::string& track_name);
+    void record(float dt, Camera* camera);
+    void end();
+    bool is_recording();
+
+private:
+    void flush();
+};
+
+
 struct CubicSpline
 {
+    // Number of cumulative arc-length samples taken per spline segment.
+    static const uint32_t kArcLengthSamplesPerSpline = 32;
+
     struct Coefficient
     {
         glm::vec3 coef[4];
@@ -16,6 +101,8 @@ struct CubicSpline
     std::vector<glm::vec3>   m_points;
     std::vector<Coefficient> m_coeffs;
     std::vector<float>       m_lengths;
+    // Arc-length from the start of the curve up to t = i / kArcLengthSamplesPerSpline.
+    std::vector<float>       m_arc_length_table;
 
     // Spline construction, Burden & Faires - Numerical Analysis 9th, algorithm 3.4
     void      initialize();
@@ -27,9 +114,14 @@ struct CubicSpline
     // Composite Simpson's Rule, Burden & Faires - Numerical Analysis 9th, algorithm 4.1
     float     simpsons_rule_single_spline(int spline, float t);
     float     simpsons_rule(float t0, float t1);
+    // Maps an arc-length distance to a curve parameter using the arc-length table.
+    float     parameter_at_distance(float distance, uint32_t* hint = nullptr);
     glm::vec3 const_velocity_spline_at_time(float t, float speed);
+    // Batched evaluation. Visiting times in increasing order lets consecutive lookups reuse the previous table position.
+    void      const_velocity_spline_at_times(const float* times, uint32_t count, float speed, glm::vec3* positions);
     float     current_distance(float t, float speed);
     float     total_length();
+    void      build_arc_length_table();
 };
 
 class LerpSpline
@@ -45,24 +137,39 @@ public:
 class DemoPlayer
 {
 private:
-    float                  m_time                = 0.0f;
-    bool                   m_is_playing          = false;
-    bool                   m_debug_visualization = false;
-    float                  m_speed               = 10.0f;
-    CubicSpline            m_position_spline;
-    LerpSpline             m_forward_spline;
-    LerpSpline             m_right_spline;
-    glm::vec3              m_current_forward;
-    glm::vec3              m_current_right;
-    glm::vec3              m_current_position;
-    std::vector<glm::vec3> m_debug_spline_segments;
-    const uint32_t         SEGMENTS_PER_POINT = 60;
+    float                        m_time                = 0.0f;
+    float                        m_distance            = 0.0f;
+    uint32_t                     m_key_hint            = 0;
+    bool                         m_is_playing          = false;
+    bool                         m_debug_visualization = false;
+    float                        m_speed               = 10.0f;
+    std::string                  m_path                = "camera_path.bin";
+    std::vector<CameraPathTrack> m_tracks;
+    int32_t                      m_current_track = -1;
+    CameraPathRecorder           m_recorder;
+    CubicSpline                  m_position_spline;
+    LerpSpline                   m_forward_spline;
+    LerpSpline                   m_right_spline;
+    glm::vec3                    m_current_forward;
+    glm::vec3                    m_current_right;
+    glm::vec3                    m_current_position;
+    std::vector<glm::vec3>       m_debug_spline_segments;
+    const uint32_t               SEGMENTS_PER_POINT = 60;
 
 public:
     DemoPlayer();
     DemoPlayer(const std::vector<glm::vec3>& position_frames, const std::vector<glm::vec3>& forward_frames, const std::vector<glm::vec3>& right_frames);
     ~DemoPlayer();
-    bool      load_from_file();
+    // Loads every track from a camera path file and selects the first one. Also accepts the legacy unversioned format.
+    bool      load_from_file(const std::string& path = "camera_path.bin");
+    bool      save_to_file(const std::string& path = "camera_path.bin");
+    bool      select_track(uint32_t index);
+    bool      select_track(const std::string& name);
+    uint32_t  track_count();
+    // Appends a new timed track to the file and captures the camera on every update() until stopped.
+    bool      start_recording(const std::string& path, const std::string& track_name);
+    void      stop_recording();
+    bool      is_recording();
     void      edit_ui(Camera* camera);
     void      debug_visualization(DebugDraw& debug_draw);
     float     speed();
@@ -75,5 +182,10 @@ public:
     glm::vec3 forward();
     glm::vec3 right();
     void      initialize_debug();
+
+private:
+    bool load_legacy(const uint8_t* data, size_t size);
+    void rebuild_splines();
+    void update_timed(float dt, Camera* camera);
 };
 } // namespace dw
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vk.h>
+#include <ogl.h>
+#include <memory>
+#include <atomic>
+#include <vector>
+
+// Levels written by a single dispatch. The first six come out of each workgroup's tile and the next six out of the last
+// workgroup to finish, so images up to 4096x4096 are reduced in one dispatch.
+#define DOWNSAMPLER_MAX_LEVELS 12
+// Layers covered by one dispatch, which is also the number of atomic counters. Larger arrays take several dispatches.
+#define DOWNSAMPLER_MAX_LAYERS 256
+// Descriptor sets in each pool of the downsampler. Another pool is created whenever every set of the existing ones is in use.
+#define DOWNSAMPLER_POOL_DESCRIPTOR_SETS 256
+
+namespace dw
+{
+// How the texels of a level are computed from the level above it.
+enum DownsampleFilter
+{
+    // Average of the 2x2 texels above.
+    DOWNSAMPLE_FILTER_BOX = 0,
+    // Kaiser-windowed sinc over 6x6 texels, which keeps more detail than the box filter. The footprint overlaps neighbouring
+    // tiles, so this takes one dispatch per level.
+    DOWNSAMPLE_FILTER_KAISER,
+    // Minimum or maximum of the 2x2 texels above, e.g. for depth pyramids. Odd sized levels drop their last row or column
+    // instead of folding it into the reduction, so pyramids used for conservative tests should be sized in powers of two.
+    DOWNSAMPLE_FILTER_MIN,
+    DOWNSAMPLE_FILTER_MAX
+};
+
+#if defined(DWSF_VULKAN)
+namespace vk
+{
+// A descriptor pool of the downsampler and the number of sets that can still be allocated from it. Sets are returned to it
+// when the target owning them goes away.
+struct DownsamplePool
+{
+    DescriptorPool::Ptr   pool;
+    std::atomic<uint32_t> free_sets;
+};
+
+// Views and descriptor sets that bind an image to the downsampler. They are created on first use and owned by the image, so
+// images downsampled every frame set them up once.
+struct DownsampleTarget
+{
+    VkDevice                                     device       = nullptr;
+    VkImageView                                  sampled_view = nullptr;
+    std::vector<VkImageView>                     storage_views;
+    // Indexed by the source level of a dispatch.
+    std::vector<DescriptorSet::Ptr>              descriptor_sets;
+    // The pool each descriptor set came from, which is kept alive until the set is freed.
+    std::vector<std::shared_ptr<DownsamplePool>> pools;
+
+    ~DownsampleTarget();
+};
+} // namespace vk
+#endif
+
+// Generates mip chains with a compute shader modelled on AMD's single pass downsampler. Each workgroup reduces a 64x64 tile
+// through six levels in registers and shared memory, and the last workgroup of a layer to finish, found through a global
+// atomic counter, reduces the remaining 64x64 texels through the next six. Where the blit based path issues a barrier and a
+// blit per level and layer, every layer of a 4096x4096 image is reduced in a single dispatch.
+//
+// 2D, array and cube images are supported, each layer being reduced on its own. sRGB images are decoded before filtering and
+// encoded again when stored. A downsampler must not be used from two queues at once, since dispatches share the counters.
+class Downsampler
+{
+public:
+    using Ptr = std::shared_ptr<Downsampler>;
+
+#if defined(DWSF_VULKAN)
+    static Downsampler::Ptr create(vk::Backend::Ptr backend);
+    static void             initialize_common_resources(vk::Backend::Ptr backend);
+#else
+    static Downsampler::Ptr create();
+    static void             initialize_common_resources();
+#endif
+    static void shutdown_common_resources();
+    // The instance used by mipmap generation of images and textures, or null if it has not been initialized.
+    static inline Downsampler* common() { return m_common.get(); }
+
+    ~Downsampler();
+
+#if defined(DWSF_VULKAN)
+    // Adds the usage and create flags an image of this format needs to be downsampled. Returns false if the format is not
+    // supported or the device cannot write it from shaders.
+    bool is_format_supported(VkFormat format, VkImageUsageFlags* usage = nullptr, VkImageCreateFlags* flags = nullptr);
+    bool is_supported(vk::Image* image);
+    // Records the generation of every level below base_level, which is read in whatever layout it was last used in. Leaves
+    // the levels from base_level down in dst_layout.
+    void generate(vk::CommandBuffer::Ptr cmd_buf, vk::Image* image, DownsampleFilter filter = DOWNSAMPLE_FILTER_BOX, VkImageLayout dst_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, uint32_t base_level = 0);
+
+    inline void generate(vk::CommandBuffer::Ptr cmd_buf, vk::Image::Ptr image, DownsampleFilter filter = DOWNSAMPLE_FILTER_BOX, VkImageLayout dst_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, uint32_t base_level = 0)
+    {
+        generate(cmd_buf, image.get(), filter, dst_layout, base_level);
+    }
+#else
+    bool is_supported(gl::Texture* texture);
+    // Generates every level below base_level. Leaves the downsampler's program bound.
+    void generate(gl::Texture* texture, DownsampleFilter filter = DOWNSAMPLE_FILTER_BOX, uint32_t base_level = 0);
+
+    inline void generate(gl::Texture::Ptr texture, DownsampleFilter filter = DOWNSAMPLE_FILTER_BOX, uint32_t base_level = 0)
+    {
+        generate(texture.get(), filter, base_level);
+    }
+#endif
+
+private:
+#if defined(DWSF_VULKAN)
+    Downsampler(vk::Backend::Ptr backend);
+
+    vk::ComputePipeline::Ptr            pipeline(uint32_t variant);
+    vk::DownsampleTarget*               target(vk::Image* image, VkFormat storage_format);
+    vk::DescriptorSet::Ptr              descriptor_set(vk::DownsampleTarget* target, uint32_t source_level);
+    std::shared_ptr<vk::DownsamplePool> descriptor_pool();
+#else
+    Downsampler();
+
+    gl::Program::Ptr program(uint32_t variant);
+#endif
+
+private:
+    static Downsampler::Ptr m_common;
+
+    uint32_t m_max_levels = DOWNSAMPLER_MAX_LEVELS;
+#if defined(DWSF_VULKAN)
+    std::weak_ptr<vk::Backend>                       m_backend;
+    std::vector<bool>                                m_variant_supported;
+    std::vector<vk::ComputePipeline::Ptr>            m_pipelines;
+    vk::PipelineLayout::Ptr                          m_pipeline_layout;
+    vk::DescriptorSetLayout::Ptr                     m_ds_layout;
+    std::vector<std::shared_ptr<vk::DownsamplePool>> m_descriptor_pools;
+    vk::Buffer::Ptr                                  m_counters;
+#else
+    std::vector<gl::Shader::Ptr>  m_shaders;
+    std::vector<gl::Program::Ptr> m_programs;
+    gl::Buffer::Ptr               m_counters;
+#endif
+};
+} // namespace dw
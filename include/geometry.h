@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glm.hpp>
+#include <stdint.h>
 
 namespace dw
 {
@@ -31,6 +32,26 @@ struct AABB
     glm::vec3 max;
 };
 
+// Structure-of-arrays box bounds for batch culling. Extents are half the size of the box along each axis.
+struct AABBBatch
+{
+    const float* center_x;
+    const float* center_y;
+    const float* center_z;
+    const float* extent_x;
+    const float* extent_y;
+    const float* extent_z;
+};
+
+// Structure-of-arrays bounding spheres for batch culling.
+struct SphereBatch
+{
+    const float* center_x;
+    const float* center_y;
+    const float* center_z;
+    const float* radius;
+};
+
 inline void frustum_from_matrix(Frustum& frustum, const glm::mat4& view_proj)
 {
     frustum.planes[FRUSTUM_PLANE_RIGHT].n = glm::vec3(view_proj[0][3] - view_proj[0][0],
@@ -120,4 +141,16 @@ inline bool intersects(const Frustum& frustum, const AABB& aabb)
 
     return true;
 }
+
+// Number of bounds processed per mask word. Ranges passed to the batch culling functions must start on a multiple of this
+// so that ranges culled on different threads never write to the same word.
+#define CULL_MASK_WORD_BITS 32
+
+// Tests `count` boxes starting at `first` against the frustum and writes one visibility bit per box into `mask`, bit
+// (i % 32) of word (i / 32). Bits past the end of the range in its last word are cleared. If `last_plane` is given it holds
+// the index of the plane that last rejected each box, which is tested first and updated on rejection.
+extern void cull_aabbs(const Frustum& frustum, const AABBBatch& boxes, uint32_t first, uint32_t count, uint32_t* mask, uint8_t* last_plane = nullptr);
+
+// Same as cull_aabbs, for bounding spheres.
+extern void cull_spheres(const Frustum& frustum, const SphereBatch& spheres, uint32_t first, uint32_t count, uint32_t* mask, uint8_t* last_plane = nullptr);
 } // namespace dw
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <mesh.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Material index of primitives that do not reference a material.
+#define GLTF_NO_MATERIAL UINT32_MAX
+
+namespace dw
+{
+namespace gltf
+{
+// Metallic-roughness material parameters. Texture paths are resolved relative to the glTF file, and are empty if the material
+// has no such texture or if the image is embedded in a buffer.
+struct MaterialDesc
+{
+    std::string base_color_texture;
+    std::string metallic_roughness_texture;
+    std::string normal_texture;
+    std::string emissive_texture;
+    glm::vec4   base_color_factor = glm::vec4(1.0f);
+    glm::vec3   emissive_factor   = glm::vec3(0.0f);
+    float       metallic_factor   = 1.0f;
+    float       roughness_factor  = 1.0f;
+    bool        alpha_test        = false;
+};
+
+// A node of the default scene that places a mesh. The transform is relative to the scene, and the sub meshes of the mesh
+// are listed contiguously.
+struct Node
+{
+    std::string name;
+    glm::mat4   transform;
+    uint32_t    first_sub_mesh;
+    uint32_t    sub_mesh_count;
+};
+
+// Every triangle primitive of every mesh, once each and in the space of its mesh, like Assimp imports them. Each primitive
+// becomes one SubMesh whose mat_idx is its glTF material index, or GLTF_NO_MATERIAL. Indices are absolute, so base_vertex is
+// always 0. Where the default scene places the meshes is kept in nodes, the way Assimp keeps its node hierarchy apart from
+// the vertices. Quantized positions are brought out of quantized units with the scale, and where possible the translation,
+// of the first node placing their mesh, and the transforms of the nodes placing it are adjusted to match.
+struct Model
+{
+    std::vector<Vertex>       vertices;
+    std::vector<uint32_t>     indices;
+    std::vector<SubMesh>      sub_meshes;
+    std::vector<MaterialDesc> materials;
+    std::vector<Node>         nodes;
+};
+
+// Loads a .gltf or .glb file. The file and its external buffers are memory mapped and accessors are converted straight out of
+// them on the job system. Supports KHR_mesh_quantization and EXT_meshopt_compression. Missing normals and tangents are
+// generated. Returns false and logs the reason if the file is invalid or uses something the loader does not handle, such as
+// sparse accessors or other required extensions.
+extern bool load(const std::string& path, Model& model);
+} // namespace gltf
+} // namespace dw
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <jobs.h>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+// Maximum number of reads the service keeps in flight at once.
+#define IO_QUEUE_DEPTH 64
+// Reads of files up to this size go into buffers registered with the kernel once, which saves pinning pages per request.
+#define IO_REGISTERED_BUFFER_COUNT 16
+#define IO_REGISTERED_BUFFER_SIZE (4 * 1024 * 1024)
+// Threads performing blocking reads where io_uring is not available.
+#define IO_FALLBACK_THREAD_COUNT 4
+// Consecutive failed io_uring_enter calls, each waiting twice as long as the last, after which the service gives up on the
+// ring, fails the reads in it and continues with the fallback threads.
+#define IO_RING_MAX_FAILURES 8
+
+namespace dw
+{
+namespace io
+{
+// A completed read. The data may live in a registered buffer that is reused once the callback returns, so it has to be
+// consumed or copied inside the callback.
+struct Result
+{
+    const std::string& path;
+    const uint8_t*     data;
+    size_t             size;
+    bool               success;
+};
+
+typedef std::function<void(const Result& result)> Callback;
+
+struct Request
+{
+    std::string path;
+    Callback    callback;
+};
+
+// Statistics of the previous frame.
+struct Stats
+{
+    bool     io_uring      = false;
+    uint32_t in_flight     = 0;
+    uint32_t max_in_flight = 0;
+    uint32_t completed     = 0;
+    uint64_t bytes         = 0;
+    // Bytes completed per second, in MB.
+    double   throughput    = 0.0;
+};
+
+// Starts the service. On Linux reads are submitted through io_uring by a single thread; elsewhere, if the kernel refuses
+// to set up a ring, or once submitting to it keeps failing, a small pool of threads performs blocking reads. Until
+// initialize() is called, and after shutdown(), every read completes synchronously on the calling thread. Files in
+// mounted archives never touch the disk and complete straight away.
+extern void initialize();
+// Waits for outstanding reads to complete and for their callbacks to be submitted.
+extern void shutdown();
+// Latches the statistics of the frame that just ended. Call from the main thread.
+extern void begin_frame();
+
+// Reads a whole file asynchronously. The callback runs as a job once the data has arrived, so decoding happens on the job
+// system while other reads are still in flight. The counter is held until the callback has returned and can be waited on
+// with jobs::wait().
+extern void read(const std::string& path, Callback callback, jobs::Counter* counter = nullptr);
+// Queues a batch of reads with a single wake-up of the service. The paths and callbacks are moved out of the requests.
+extern void read(std::vector<Request>& requests, jobs::Counter* counter = nullptr);
+
+extern Stats stats();
+} // namespace io
+} // namespace dw
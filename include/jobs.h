@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+#define JOBS_MAX_WORKERS 64
+
+namespace dw
+{
+namespace jobs
+{
+// Tracks a group of jobs. The value is the number of submitted jobs that have not finished yet, so a counter can be
+// reused once it has been waited on.
+struct Counter
+{
+    std::atomic<uint32_t> value = { 0 };
+
+    inline bool done() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+// Per-worker statistics for the previous frame. Worker 0 is the main thread.
+struct WorkerStats
+{
+    double   busy_ms     = 0.0;
+    float    utilization = 0.0f;
+    uint32_t jobs        = 0;
+    uint32_t steals      = 0;
+};
+
+typedef std::function<void()>                             JobFunction;
+typedef std::function<void(uint32_t begin, uint32_t end)> RangeFunction;
+
+// Starts the given number of worker threads in addition to the calling thread, which becomes the main thread and worker 0.
+// Zero workers is valid: jobs are then executed by the main thread whenever it waits. Until initialize() is called, and after
+// shutdown(), every job runs inline on the submitting thread.
+extern void initialize(uint32_t worker_count);
+extern void shutdown();
+// Latches the worker statistics of the frame that just ended. Call from the main thread.
+extern void begin_frame();
+
+// Number of threads executing jobs, including the main thread.
+extern uint32_t worker_count();
+// Index of the calling thread, or -1 if it is not owned by the job system.
+extern int32_t  worker_index();
+extern bool     is_main_thread();
+
+// Queues a job on the calling worker's deque, from where idle workers steal it. Jobs submitted from threads not owned
+// by the job system go through a shared queue instead.
+extern void submit(JobFunction function, Counter* counter = nullptr);
+// Queues a job that must run on the main thread, e.g. one that touches the graphics context. These run when the main
+// thread pumps them, which happens at the start of every frame and while the main thread waits on a counter.
+extern void submit_main_thread(JobFunction function, Counter* counter = nullptr);
+extern void pump_main_thread();
+// Executes other jobs until the counter reaches zero.
+extern void wait(Counter* counter);
+
+// Splits [0, count) into ranges no larger than grain_size and returns once all of them have been processed. Ranges are
+// split in halves, so thieves always take the largest remaining piece of work.
+extern void parallel_for(uint32_t count, uint32_t grain_size, RangeFunction function);
+
+extern WorkerStats worker_stats(uint32_t worker);
+} // namespace jobs
+} // namespace dw
@@ -3,10 +3,10 @@
 #include <string>
 
 // Macros for quick access. File and line are added through the respective macros.
-#define DW_LOG_INFO(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_INFO)
-#define DW_LOG_WARNING(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_WARNING)
-#define DW_LOG_ERROR(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_ERR)
-#define DW_LOG_FATAL(x) dw::logger::log(x, std::string(__FILE__), __LINE__, dw::logger::LEVEL_FATAL)
+#define DW_LOG_INFO(x) dw::logger::log(x, __FILE__, __LINE__, dw::logger::LEVEL_INFO)
+#define DW_LOG_WARNING(x) dw::logger::log(x, __FILE__, __LINE__, dw::logger::LEVEL_WARNING)
+#define DW_LOG_ERROR(x) dw::logger::log(x, __FILE__, __LINE__, dw::logger::LEVEL_ERR)
+#define DW_LOG_FATAL(x) dw::logger::log(x, __FILE__, __LINE__, dw::logger::LEVEL_FATAL)
 
 namespace dw
 {
@@ -51,13 +51,14 @@ extern void enable_debug_mode();
 extern void disable_debug_mode();
 
 // Main log method. File, line and level are required in addition to log message.
-extern void log(std::string text, std::string file, int line, LogLevel level);
+extern void log(const std::string& text, const char* file, int line, LogLevel level);
+extern void log(const std::string& text, const std::string& file, int line, LogLevel level);
 
 // Simplified API.
-extern void log_info(std::string text);
-extern void log_error(std::string text);
-extern void log_warning(std::string text);
-extern void log_fatal(std::string text);
+extern void log_info(const std::string& text);
+extern void log_error(const std::string& text);
+extern void log_warning(const std::string& text);
+extern void log_fatal(const std::string& text);
 
 // Explicitly flush all streams.
 extern void flush();
@@ -5,10 +5,48 @@
 #include <glm.hpp>
 #include <ogl.h>
 #include <vk.h>
+#include <utility.h>
 #include <memory>
 
 namespace dw
 {
+// Totals over every texture loaded by materials so far.
+struct TextureLoadStats
+{
+    uint32_t textures      = 0;
+    uint64_t decoded_bytes = 0;
+    // Part of decoded_bytes that went straight into the staging heap.
+    uint64_t staged_bytes  = 0;
+    // Wall clock time of the decode batches and of the uploads, in milliseconds.
+    double   decode_time   = 0.0;
+    double   upload_time   = 0.0;
+};
+
+#if !defined(DWSF_VULKAN)
+// A material in the bindless material table, laid out for std430. Texture handles are split into 32-bit halves, which GLSL
+// turns back into samplers with sampler2D(uvec2). A zero handle means the material has no such texture, in which case
+// shaders fall back to the scalar value.
+struct MaterialData
+{
+    glm::uvec2 albedo_handle;
+    glm::uvec2 normal_handle;
+    glm::uvec2 roughness_handle;
+    glm::uvec2 metallic_handle;
+    glm::uvec2 emissive_handle;
+    int32_t    roughness_channel;
+    int32_t    metallic_channel;
+    glm::vec4  albedo_color;
+    // w is unused.
+    glm::vec4  emissive_color;
+    float      roughness;
+    float      metallic;
+    uint32_t   alpha_test;
+    uint32_t   padding;
+};
+
+static_assert(sizeof(MaterialData) == 96, "MaterialData must match its std430 layout.");
+#endif
+
 class Material
 {
 public:
@@ -34,6 +72,8 @@ public:
 
     static bool is_loaded(const std::string& name);
 
+    static inline const TextureLoadStats& texture_load_stats() { return m_texture_load_stats; }
+
     ~Material();
 
     inline uint32_t  id() { return m_id; }
@@ -51,6 +91,9 @@ public:
     inline int32_t roughness_channel() { return m_roughness_channel; }
     inline int32_t metallic_channel() { return m_metallic_channel; }
 
+    // Paths of the loaded textures, indexed by the *_idx getters.
+    inline const std::vector<std::string>& texture_paths() { return m_texture_paths; }
+
     inline void set_albedo_value(const glm::vec4& value) { m_albedo_color = value; }
     inline void set_roughness_value(const float& value) { m_roughness = value; }
     inline void set_metallic_value(const float& value) { m_metallic = value; }
@@ -77,6 +120,18 @@ public:
     static inline vk::Sampler::Ptr             common_sampler() { return m_common_sampler; }
     static inline vk::DescriptorSetLayout::Ptr descriptor_set_layout() { return m_common_ds_layout; }
 #else
+    static void initialize_common_resources();
+    static void shutdown_common_resources();
+
+    // Bindless material table, for drawing without binding textures. The texture handles of every material are made
+    // resident once and written with its scalar values into a shader storage buffer indexed by material id, see
+    // MaterialData. Textures cannot change their sampler state once resident. Requires GL_ARB_bindless_texture.
+    static inline bool            is_bindless_supported() { return m_bindless_supported; }
+    // Writes every live material into the table, growing it as needed. Called after loading materials or changing their
+    // values, before drawing with the table.
+    static void                   update_material_table();
+    static inline gl::Buffer::Ptr material_table() { return m_material_table; }
+
     // Rendering related getters.
     inline gl::Texture2D::Ptr       albedo_texture() { return m_albedo_idx != -1 ? m_textures[m_albedo_idx] : nullptr; }
     inline gl::Texture2D::Ptr       normal_texture() { return m_normal_idx != -1 ? m_textures[m_normal_idx] : nullptr; }
@@ -87,13 +142,22 @@ public:
 #endif
 
 private:
+    typedef std::unordered_map<std::string, utility::DecodedImage> DecodedImages;
+
+    // Reads the referenced textures that are not cached yet through the I/O service and decodes each on the job system as
+    // soon as its data has arrived.
+    static void decode_images(const std::vector<std::string>& textures, const std::vector<int32_t>& indices, DecodedImages& decoded);
+
 #if defined(DWSF_VULKAN)
-    static vk::Image::Ptr     load_image(vk::Backend::Ptr backend, const std::string& path, bool srgb = false);
+    static vk::Image::Ptr     load_image(vk::Backend::Ptr backend, const std::string& path, const DecodedImages& decoded, bool srgb = false);
     static vk::ImageView::Ptr load_image_view(vk::Backend::Ptr backend, const std::string& path, vk::Image::Ptr image);
 
     vk::DescriptorSet::Ptr create_descriptor_set(vk::Backend::Ptr backend);
+    // Writes the descriptor sets of the materials using the image loaded from path again, after it has been moved.
+    static void            image_relocated(vk::Backend::Ptr backend, const std::string& path);
 #else
-    static gl::Texture2D::Ptr       load_texture(const std::string& path, bool srgb = false);
+    static gl::Texture2D::Ptr       load_texture(const std::string& path, const DecodedImages& decoded, bool srgb = false);
+    static glm::uvec2               resident_handle(const gl::Texture2D::Ptr& texture);
 #endif
 
 private:
@@ -113,6 +177,10 @@ private:
 private:
     // Material cache.
     static std::unordered_map<std::string, std::weak_ptr<Material>> m_cache;
+    static TextureLoadStats                                         m_texture_load_stats;
+    // Materials that can be written into the table with OpenGL, or whose descriptor sets are written again when one of their
+    // images is moved with Vulkan, by id.
+    static std::unordered_map<uint32_t, Material*>                  m_live_materials;
 
     int32_t   m_albedo_idx        = -1;
     int32_t   m_normal_idx        = -1;
@@ -129,6 +197,8 @@ private:
 
     uint32_t m_id = 0;
 
+    std::vector<std::string> m_texture_paths;
+
     // Texture list. In the same order as the Assimp texture enums.
 #if defined(DWSF_VULKAN)
     std::vector<vk::Image::Ptr>     m_images;
@@ -148,6 +218,9 @@ private:
 
     // Texture cache.
     static std::unordered_map<std::string, std::weak_ptr<gl::Texture2D>> m_texture_cache;
+
+    static gl::Buffer::Ptr m_material_table;
+    static bool            m_bindless_supported;
 #endif
 };
 } // namespace dw
@@ -8,6 +8,9 @@
 #include <ogl.h>
 #include <vk.h>
 
+// Attributes closer than this are considered equal when welding imported vertices.
+#define MESH_DEFAULT_WELD_EPSILON 1e-5f
+
 namespace dw
 {
 class Material;
@@ -35,12 +38,27 @@ struct SubMesh
     glm::vec3   min_extents;
 };
 
+// Merges vertices whose attributes are equal after quantizing them to the given epsilon, then remaps the indices and
+// updates each submesh's vertex_count. Vertices are only merged within a submesh, and each submesh's vertices are expected
+// to be stored contiguously in submesh order. Hashing and remapping run in parallel on the job system. Returns the number
+// of vertices left.
+uint32_t weld_vertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<SubMesh>& sub_meshes, float epsilon = MESH_DEFAULT_WELD_EPSILON);
+
 class Mesh
 {
 public:
     using Ptr = std::shared_ptr<Mesh>;
 
     static bool is_loaded(const std::string& name);
+    // Epsilon used to weld the vertices of meshes loaded from disk. Zero or less keeps every imported vertex.
+    static void set_weld_epsilon(float epsilon);
+    // Loads .gltf and .glb files with the built-in glTF loader instead of Assimp. Files it cannot handle still fall back to
+    // Assimp. Enabled by default.
+    static void set_native_gltf_loader(bool enabled);
+    // Directory in which meshes loaded from disk are stored compressed after import and welding. Later loads of an unchanged
+    // source file decode the cached copy on the job system instead of importing it again. Empty disables the disk cache,
+    // which is the default.
+    static void set_disk_cache_directory(const std::string& directory);
 
     // Static factory methods.
     static Mesh::Ptr load(
@@ -126,9 +144,41 @@ private:
         bool               load_materials,
         bool               is_orca_mesh);
 
+    void load_with_assimp(
+#if defined(DWSF_VULKAN)
+        vk::Backend::Ptr backend,
+#endif
+        const std::string& path,
+        bool               load_materials,
+        bool               is_orca_mesh);
+
+    bool load_from_gltf(
+#if defined(DWSF_VULKAN)
+        vk::Backend::Ptr backend,
+#endif
+        const std::string& path,
+        bool               load_materials);
+
+    bool load_from_disk_cache(
+#if defined(DWSF_VULKAN)
+        vk::Backend::Ptr backend,
+#endif
+        const std::string& path,
+        const std::string& cache_path,
+        bool               load_materials,
+        bool               is_orca_mesh);
+
+    void write_to_disk_cache(const std::string& path,
+                             const std::string& cache_path,
+                             bool               load_materials,
+                             bool               is_orca_mesh);
+
 private:
     // Mesh cache. Used to prevent multiple loads.
     static std::unordered_map<std::string, std::weak_ptr<Mesh>> m_cache;
+    static float                                                 m_weld_epsilon;
+    static bool                                                  m_native_gltf_loader;
+    static std::string                                           m_disk_cache_directory;
 
     // Mesh geometry.
     uint32_t                               m_id = 0;
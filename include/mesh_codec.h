@@ -0,0 +1,51 @@
+#pragma once
+
+#include <mesh.h>
+#include <vector>
+#include <stdint.h>
+
+namespace dw
+{
+namespace mesh_codec
+{
+// Vertex and index compression for mesh payloads. The bitstreams are the ones EXT_meshopt_compression uses, so the same
+// decoders serve compressed glTF files and the mesh cache.
+//
+// Vertices are split into byte planes that are delta coded against the previous vertex and bit packed in groups of 16.
+// Triangles are coded against FIFOs of recently seen edges and vertices, which takes a few bits per triangle for meshes
+// whose vertices are ordered by first use.
+
+// Appends the encoded vertices to the output. The vertex size must be a multiple of 4 and at most 256 bytes.
+extern void encode_vertex_buffer(const void* vertices, size_t vertex_count, size_t vertex_size, std::vector<uint8_t>& out);
+// Decodes into a buffer of vertex_count * vertex_size bytes. Returns false if the data is malformed.
+extern bool decode_vertex_buffer(void* destination, size_t vertex_count, size_t vertex_size, const uint8_t* buffer, size_t buffer_size);
+
+// Appends the encoded triangle list to the output. The index count must be a multiple of 3.
+extern void encode_index_buffer(const uint32_t* indices, size_t index_count, std::vector<uint8_t>& out);
+// Decodes into 2 or 4 byte indices. Triangles may come back with their vertices rotated, which keeps the winding. Returns
+// false if the data is malformed.
+extern bool decode_index_buffer(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size);
+// Decodes an index sequence that is not a triangle list, such as a list of points.
+extern bool decode_index_sequence(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size);
+
+// Location of one submesh's encoded vertices and indices within a payload. The stream sizes are those of the codec output,
+// which is stored LZ4 compressed when that makes it smaller and as is, with equal sizes, otherwise.
+struct EncodedSubMesh
+{
+    uint64_t vertex_offset;
+    uint64_t vertex_size;
+    uint64_t index_offset;
+    uint64_t index_size;
+    uint64_t vertex_stream_size;
+    uint64_t index_stream_size;
+};
+
+// Encodes every submesh separately so that they can be decoded in parallel. Submesh vertices must be stored contiguously in
+// submesh order with absolute indices, which is how Mesh stores them. Submeshes are encoded on the job system. The codec
+// leaves runs of repeated bytes where attributes repeat between vertices, which LZ4 then removes.
+extern void encode_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<SubMesh>& sub_meshes, std::vector<uint8_t>& payload, std::vector<EncodedSubMesh>& encoded);
+// Decodes a payload written by encode_mesh() into arrays sized for all submeshes, one job per submesh. Returns false if any
+// submesh fails to decode or references data outside the payload.
+extern bool decode_mesh(const uint8_t* payload, size_t payload_size, const std::vector<EncodedSubMesh>& encoded, const std::vector<SubMesh>& sub_meshes, Vertex* vertices, uint32_t* indices);
+} // namespace mesh_codec
+} // namespace dw
@@ -54,6 +54,11 @@
 
 namespace dw
 {
+namespace utility
+{
+struct DecodedImage;
+} // namespace utility
+
 namespace gl
 {
 class Object
@@ -109,6 +114,8 @@ public:
     int      compressed_size(int mip_level);
     GLuint64 make_texture_handle_resident();
     void     make_texture_handle_non_resident();
+    // The resident bindless handle of the texture, or 0 if it has none.
+    inline GLuint64 texture_handle() { return m_texture_handle; }
     GLuint64 make_image_handle_resident(GLenum access, GLint level, GLboolean layered, GLint layer);
     void     make_image_handle_non_resident();
 
@@ -163,6 +170,9 @@ public:
 
     static Texture2D::Ptr create(uint32_t w, uint32_t h, uint32_t array_size, int32_t mip_levels, uint32_t num_samples, GLenum internal_format, GLenum format, GLenum type);
     static Texture2D::Ptr create_from_file(std::string path, bool flip_vertical = true, bool srgb = false);
+    // Streamed images are uploaded within the upload budget of the common staging heap, so their contents may only arrive in
+    // a later frame.
+    static Texture2D::Ptr create_from_image(const utility::DecodedImage& image, bool srgb = false, bool stream = false);
 
     ~Texture2D();
     void     write_data(int array_index, int mip_level, void* data);
@@ -170,6 +180,7 @@ public:
     void     write_compressed_data(int array_index, int mip_level, size_t size, void* data);
     void     write_compressed_sub_data(int array_index, int mip_level, int x_offset, int y_offset, int width, int height, size_t size, void* data);
     void     read_data(int mip_level, std::vector<uint8_t>& buffer);
+    size_t   data_size(int mip_level);
     void     extents(int mip_level, int& width, int& height);
     void     resize(uint32_t w, uint32_t h);
     uint32_t width();
@@ -202,6 +213,7 @@ public:
     void     write_compressed_data(int slice, int mip_level, size_t size, void* data);
     void     write_compressed_sub_data(int slice, int mip_level, int x_offset, int y_offset, int width, int height, size_t size, void* data);
     void     read_data(int mip_level, std::vector<uint8_t>& buffer);
+    size_t   data_size(int mip_level);
     void     extents(int mip_level, int& width, int& height, int& depth);
     void     resize(uint32_t w, uint32_t h, uint32_t d);
     uint32_t width();
@@ -235,6 +247,7 @@ public:
     void     write_compressed_data(int face_index, int array_index, int mip_level, size_t size, void* data);
     void     write_compressed_sub_data(int face_index, int array_index, int mip_level, int x_offset, int y_offset, int width, int height, size_t size, void* data);
     void     read_data(int mip_level, std::vector<uint8_t>& buffer);
+    size_t   data_size(int mip_level);
     void     extents(int mip_level, int& width, int& height);
     void     resize(uint32_t w, uint32_t h);
     uint32_t width();
@@ -19,11 +19,22 @@
 
 namespace dw
 {
+// Per-frame pacing statistics, in milliseconds.
+struct FrameTimings
+{
+    // Time the CPU spent blocked on the GPU before it could start recording the frame.
+    double cpu_wait = 0.0;
+    // Lower bound on the time the GPU sat idle waiting for the CPU to submit the frame.
+    double gpu_wait = 0.0;
+    // Time spent sleeping in the frame limiter.
+    double limiter = 0.0;
+};
+
 namespace profiler
 {
 struct ScopedProfile
 {
-    ScopedProfile(std::string name
+    ScopedProfile(const std::string& name
 #if defined(DWSF_VULKAN)
                   ,
                   vk::CommandBuffer::Ptr cmd_buf
@@ -43,13 +54,13 @@ extern void initialize(
 #endif
 );
 extern void shutdown();
-extern void begin_sample(std::string name
+extern void begin_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                          ,
                          vk::CommandBuffer::Ptr cmd_buf
 #endif
 );
-extern void end_sample(std::string name
+extern void end_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                        ,
                        vk::CommandBuffer::Ptr cmd_buf
@@ -57,6 +68,8 @@ extern void end_sample(std::string name
 );
 extern void begin_frame();
 extern void end_frame();
+// Pacing of the frame that just completed, shown by ui(). Called by the application at the end of every frame.
+extern void report_frame_timings(const FrameTimings& timings, uint32_t frames_in_flight, bool late_input_latching);
 
 #if defined(DWSF_IMGUI)
 extern void ui();
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vk.h>
+#include <ogl.h>
+#include <allocators.h>
+#include <memory>
+#include <vector>
+
+// Default size of the common readback ring, see AppSettings::readback_ring_size. Copies that do not fit while it is full
+// get a buffer of their own.
+#define READBACK_RING_SIZE (64 * 1024 * 1024)
+// Covers the copy offset alignment of every texel format, the largest being four 32-bit floats.
+#define READBACK_RING_ALIGNMENT 16
+
+namespace dw
+{
+class Readback;
+
+// A copy of an image into host visible memory that has been issued but may not have completed yet. Callers keep the request
+// and poll it on later frames, reading the pixels in place once it is ready. The memory goes back to the ring when the last
+// reference is dropped, whether the copy has completed or not.
+class ReadbackRequest
+{
+public:
+    using Ptr = std::shared_ptr<ReadbackRequest>;
+
+    ~ReadbackRequest();
+
+    // Returns true once the copy has completed. Never blocks.
+    bool        is_ready();
+    // Blocks until the copy has completed, which stalls like a synchronous read would.
+    void        wait();
+    // Tightly packed pixels of the level, layers and faces following each other. Null until the request is ready.
+    const void* data();
+
+    inline size_t size() { return m_size; }
+    // Frames between issuing the copy and the first poll that found it complete.
+    inline uint32_t latency() { return m_latency; }
+
+private:
+    friend class Readback;
+
+    ReadbackRequest() = default;
+
+private:
+    std::weak_ptr<Readback> m_readback;
+    size_t                  m_offset     = SIZE_MAX;
+    size_t                  m_size       = 0;
+    uint64_t                m_frame      = 0;
+    uint32_t                m_latency    = 0;
+    bool                    m_ready      = false;
+    uint8_t*                m_mapped_ptr = nullptr;
+#if defined(DWSF_VULKAN)
+    // Set when the copy did not fit into the ring.
+    vk::Buffer::Ptr        m_dedicated;
+    vk::CommandBuffer::Ptr m_cmd_buf;
+    vk::Fence::Ptr         m_fence;
+#else
+    gl::Buffer::Ptr m_dedicated;
+    GLsync          m_fence = nullptr;
+#endif
+};
+
+// Reads textures back without waiting for the GPU. The copy is issued into a persistently mapped ring and a fence is placed
+// behind it, so screenshots, histograms and probe readbacks no longer drain the pipeline the way the synchronous read_data()
+// of the OpenGL textures does.
+//
+// With OpenGL the copy goes through the pixel pack buffer and must be issued on the thread the context is current on. With
+// Vulkan it is submitted to the graphics queue on its own, after the work of the frame that wrote the image, so it must be
+// issued after the frame has been submitted.
+class Readback : public std::enable_shared_from_this<Readback>
+{
+public:
+    using Ptr = std::shared_ptr<Readback>;
+
+#if defined(DWSF_VULKAN)
+    static Readback::Ptr create(vk::Backend::Ptr backend, size_t size = READBACK_RING_SIZE);
+    // A size of 0 disables the common ring.
+    static void          initialize_common_resources(vk::Backend::Ptr backend, size_t size);
+#else
+    static Readback::Ptr create(size_t size = READBACK_RING_SIZE);
+    // A size of 0 disables the common ring.
+    static void          initialize_common_resources(size_t size);
+#endif
+    static void shutdown_common_resources();
+    // The instance used by the framework, created on first use so that applications that never read anything back do not
+    // map a ring. Null if it is disabled. Must be called from the thread that issues reads.
+    static Readback* common();
+    // The common instance if common() has created it, or null.
+    static inline Readback* created_common() { return m_common.get(); }
+
+    ~Readback();
+
+#if defined(DWSF_VULKAN)
+    // Copies every layer of a level of a color or depth image. Compressed formats are not supported. The image is handed back
+    // in the layout it was last used in.
+    ReadbackRequest::Ptr read(vk::Image::Ptr image, uint32_t mip_level = 0, VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT);
+#else
+    // Copies a level in the format and type of the texture, or in its compressed form, as read_data() does.
+    ReadbackRequest::Ptr read(gl::Texture2D* texture, int mip_level = 0);
+    ReadbackRequest::Ptr read(gl::Texture3D* texture, int mip_level = 0);
+    ReadbackRequest::Ptr read(gl::TextureCube* texture, int mip_level = 0);
+#endif
+    // Counts frames for the latency of requests. Called once per frame by the application.
+    inline void end_frame() { m_frame++; }
+
+    inline size_t used() { return m_ranges.used(); }
+    inline size_t size() { return m_ranges.capacity(); }
+
+private:
+#if defined(DWSF_VULKAN)
+    Readback(vk::Backend::Ptr backend, size_t size);
+#else
+    Readback(size_t size);
+
+    ReadbackRequest::Ptr read(gl::Texture* texture, int mip_level, size_t size);
+#endif
+
+    ReadbackRequest::Ptr allocate(size_t size);
+    bool                 poll(ReadbackRequest* request, bool wait);
+    void                 release(ReadbackRequest* request);
+    void                 reclaim();
+
+private:
+    friend class ReadbackRequest;
+
+    // A range whose request was dropped before its copy completed.
+    struct Orphan
+    {
+        size_t offset;
+#if defined(DWSF_VULKAN)
+        vk::CommandBuffer::Ptr cmd_buf;
+        vk::Fence::Ptr         fence;
+        vk::Buffer::Ptr        dedicated;
+#else
+        GLsync fence;
+#endif
+    };
+
+    static Readback::Ptr m_common;
+    static size_t        m_common_size;
+#if defined(DWSF_VULKAN)
+    static vk::Backend::Ptr m_common_backend;
+#endif
+
+    memory::RangeAllocator m_ranges;
+    uint8_t*               m_mapped_ptr = nullptr;
+    uint64_t               m_frame      = 0;
+    std::vector<Orphan>    m_orphans;
+#if defined(DWSF_VULKAN)
+    std::weak_ptr<vk::Backend> m_backend;
+    vk::Buffer::Ptr            m_buffer;
+    vk::CommandPool::Ptr       m_command_pool;
+#else
+    gl::Buffer::Ptr m_buffer;
+#endif
+};
+} // namespace dw
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <mesh.h>
+#include <geometry.h>
+#include <gtc/quaternion.hpp>
+#include <vector>
+#include <memory>
+
+namespace dw
+{
+// Instance of a mesh node that survived culling. Instances are sorted by mesh so consecutive entries can be drawn together.
+struct SceneInstance
+{
+    uint32_t  node;
+    Mesh*     mesh;
+    glm::mat4 transform;
+};
+
+// Transform hierarchy with cached world matrices and a BVH over world-space bounds.
+//
+// Nodes are referred to by stable handles. Internally they are stored structure-of-arrays and ordered by depth, so every
+// parent precedes its children and each depth level is a contiguous range that can be updated in parallel. Changing a
+// local transform only marks the node dirty; update() recomputes the world matrices of dirty nodes and their descendants,
+// then refits the BVH.
+class Scene
+{
+public:
+    using Ptr = std::shared_ptr<Scene>;
+
+    static const uint32_t kInvalidNode = 0xFFFFFFFF;
+
+    static Scene::Ptr create();
+
+    ~Scene();
+
+    // Adds a node under the given parent, which must already exist. Nodes without a mesh or explicit bounds are not culled or picked.
+    uint32_t create_node(uint32_t parent = kInvalidNode, std::shared_ptr<Mesh> mesh = nullptr);
+    void     set_local_transform(uint32_t node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+    void     set_local_position(uint32_t node, const glm::vec3& position);
+    void     set_local_rotation(uint32_t node, const glm::quat& rotation);
+    void     set_local_scale(uint32_t node, const glm::vec3& scale);
+    // Overrides the local-space bounds, which default to the mesh extents.
+    void     set_local_bounds(uint32_t node, const glm::vec3& min_extents, const glm::vec3& max_extents);
+
+    // Recomputes dirty world matrices and bounds, and rebuilds or refits the BVH. Call once per frame before querying.
+    void update();
+
+    // Appends the mesh instances whose world bounds intersect the frustum.
+    void gather_instances(const Frustum& frustum, std::vector<SceneInstance>& instances);
+    // Returns the node whose world bounds are hit first by the ray, or kInvalidNode.
+    uint32_t pick(const glm::vec3& origin, const glm::vec3& direction, float& distance);
+
+    uint32_t              parent(uint32_t node);
+    const glm::mat4&      world_transform(uint32_t node);
+    const AABB&           world_bounds(uint32_t node);
+    std::weak_ptr<Mesh>   mesh(uint32_t node);
+    inline uint32_t       node_count() { return m_parents.size(); }
+    inline const AABB&    bounds() { return m_bounds; }
+
+private:
+    struct BVHNode
+    {
+        AABB     bounds;
+        // Index of the first child for inner nodes, or of the first item in m_bvh_items for leaves.
+        uint32_t first;
+        // Number of items for leaves, zero for inner nodes. The second child of an inner node is always at first + 1.
+        uint32_t count;
+    };
+
+    Scene();
+    void sort_by_depth();
+    bool update_range(uint32_t begin, uint32_t end);
+    void build_bvh();
+    void subdivide_bvh_node(uint32_t idx);
+    void refit_bvh();
+
+private:
+    // Handle to storage index and back. Storage is reordered whenever the hierarchy changes.
+    std::vector<uint32_t> m_node_to_index;
+    std::vector<uint32_t> m_index_to_node;
+
+    // Per-node storage, indexed by storage index.
+    std::vector<uint32_t>            m_parents;
+    std::vector<uint32_t>            m_depths;
+    std::vector<glm::vec3>           m_local_positions;
+    std::vector<glm::quat>           m_local_rotations;
+    std::vector<glm::vec3>           m_local_scales;
+    std::vector<glm::mat4>           m_world_transforms;
+    std::vector<AABB>                m_local_bounds;
+    std::vector<AABB>                m_world_bounds;
+    std::vector<uint8_t>             m_has_bounds;
+    std::vector<uint8_t>             m_dirty;
+    std::vector<std::weak_ptr<Mesh>> m_meshes;
+
+    // Storage ranges of each depth level.
+    std::vector<uint32_t> m_level_offsets;
+
+    std::vector<BVHNode>  m_bvh_nodes;
+    std::vector<uint32_t> m_bvh_items;
+    std::vector<uint32_t> m_traversal_stack;
+    AABB                  m_bounds;
+    bool                  m_hierarchy_changed = false;
+    bool                  m_bounds_changed    = false;
+};
+} // namespace dw
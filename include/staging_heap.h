@@ -0,0 +1,145 @@
+#pragma once
+
+#include <vk.h>
+#include <ogl.h>
+#include <allocators.h>
+#include <utility.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Default size of the common staging heap, see AppSettings::staging_heap_size. Images that do not fit while it is full are
+// decoded into memory of their own and uploaded through a staging buffer of their own, as before.
+#define STAGING_HEAP_SIZE (32 * 1024 * 1024)
+// Default of AppSettings::upload_budget, the bytes of streamed texture uploads written per frame with OpenGL.
+#define STAGING_HEAP_UPLOAD_BUDGET (16 * 1024 * 1024)
+// Covers the copy offset alignment of every texel format, the largest being four 32-bit floats.
+#define STAGING_HEAP_ALIGNMENT 16
+
+namespace dw
+{
+// A persistently mapped upload buffer that image decoders write into directly. Pixels decoded into it are copied to images
+// from where they are, instead of being copied once more into a staging buffer created for each upload. Ranges can be
+// allocated from any thread, e.g. by decode jobs, and are returned to the heap when their last reference is dropped.
+//
+// With OpenGL the buffer is bound as the pixel unpack buffer for the upload. The driver may read from it after the upload
+// call has returned, so released ranges are fenced and only reused once the commands issued before them have completed.
+// Uploads go through upload(), which also copies pixels held elsewhere into the heap so that the driver does not have to.
+// With a per-frame budget set, streamed uploads such as the textures of materials are queued and trickle in over the
+// following frames, so that large scene loads do not hitch the frame they are made in.
+//
+// The common heap is only created once a texture is loaded. With OpenGL it is only used for budgeted uploads: without a
+// budget, uploading from client memory as the driver copies it was no slower than copying into the heap first.
+class StagingHeap : public std::enable_shared_from_this<StagingHeap>
+{
+public:
+    using Ptr = std::shared_ptr<StagingHeap>;
+
+#if defined(DWSF_VULKAN)
+    static StagingHeap::Ptr create(vk::Backend::Ptr backend, size_t size = STAGING_HEAP_SIZE);
+    // A size of 0 disables the common heap.
+    static void             initialize_common_resources(vk::Backend::Ptr backend, size_t size);
+#else
+    static StagingHeap::Ptr create(size_t size = STAGING_HEAP_SIZE);
+    // A size of 0 disables the common heap, as does an upload budget of 0.
+    static void             initialize_common_resources(size_t size, size_t upload_budget = 0);
+#endif
+    static void shutdown_common_resources();
+    // The instance textures are decoded into, created on first use. Null if it is disabled. With OpenGL it must first be
+    // called on the thread the context is current on.
+    static StagingHeap* common();
+    // The common instance if common() has created it, or null.
+    static inline StagingHeap* created_common() { return m_common.get(); }
+
+    ~StagingHeap();
+
+    // Returns null if there is no free range large enough.
+    std::shared_ptr<void>   allocate(size_t size, size_t alignment = STAGING_HEAP_ALIGNMENT);
+    // For utility::decode_image(). The allocator does not keep the heap alive.
+    utility::PixelAllocator pixel_allocator();
+    // Returns true if ptr points into the heap, along with its offset from the start of the buffer.
+    bool                    find(const void* ptr, size_t& offset);
+#if !defined(DWSF_VULKAN)
+    // Fences the ranges released so far and makes those whose fence has been signaled available again. Only waits for the
+    // GPU while more than half of the heap is in use. Must be called on the thread the context is current on, which is done
+    // before each batch of texture decodes and once per frame.
+    void reclaim();
+    // Writes pixels to a texture with the heap bound as the pixel unpack buffer. write_data is handed the offset of the pixels
+    // within the heap, or a pointer to them if they could not be copied into it, and on_complete runs right after it, e.g.
+    // to generate mipmaps. The pixels are kept alive until then. Streamed uploads are queued while a budget is set, and every
+    // other upload is written immediately.
+    void upload(std::shared_ptr<void> pixels, size_t size, std::function<void(void*)> write_data, std::function<void()> on_complete = nullptr, bool stream = false);
+    // Bytes written by the queued uploads per frame, or 0 to write every upload immediately. At least one upload is written
+    // each frame, however large.
+    void set_upload_budget(size_t bytes_per_frame);
+    // Writes the queued uploads that fit into the budget of this frame. Called once per frame by the application.
+    void update();
+    // Writes every queued upload, e.g. before rendering from textures that must be complete.
+    void flush_uploads();
+
+    inline size_t upload_budget() { return m_upload_budget; }
+    inline size_t pending_upload_bytes() { return m_pending_upload_bytes; }
+#endif
+
+#if defined(DWSF_VULKAN)
+    inline vk::Buffer::Ptr buffer() { return m_buffer; }
+#else
+    inline gl::Buffer::Ptr buffer() { return m_buffer; }
+#endif
+    inline size_t used() { return m_ranges.used(); }
+    inline size_t size() { return m_ranges.capacity(); }
+
+private:
+#if defined(DWSF_VULKAN)
+    StagingHeap(vk::Backend::Ptr backend, size_t size);
+#else
+    StagingHeap(size_t size);
+#endif
+
+    void release(size_t offset);
+#if !defined(DWSF_VULKAN)
+    struct Upload
+    {
+        std::shared_ptr<void>      pixels;
+        size_t                     size;
+        std::function<void(void*)> write_data;
+        std::function<void()>      on_complete;
+    };
+
+    // Ranges released before a fence, which are free once it has been signaled.
+    struct FencedRegion
+    {
+        GLsync              fence;
+        std::vector<size_t> offsets;
+    };
+
+    void write(Upload& upload);
+#endif
+
+private:
+    static StagingHeap::Ptr m_common;
+    static std::mutex       m_common_mutex;
+    static size_t           m_common_size;
+#if defined(DWSF_VULKAN)
+    static vk::Backend::Ptr m_common_backend;
+#else
+    static size_t m_common_upload_budget;
+#endif
+
+    memory::RangeAllocator m_ranges;
+    uint8_t*               m_mapped_ptr = nullptr;
+#if defined(DWSF_VULKAN)
+    vk::Buffer::Ptr m_buffer;
+#else
+    gl::Buffer::Ptr          m_buffer;
+    std::mutex               m_retired_mutex;
+    std::vector<size_t>      m_retired;
+    std::deque<FencedRegion> m_fenced;
+    std::deque<Upload>       m_uploads;
+    size_t                   m_upload_budget        = 0;
+    size_t                   m_pending_upload_bytes = 0;
+#endif
+};
+} // namespace dw
@@ -3,7 +3,7 @@
 #if defined(WIN32)
 #    include <windows.h>
 #else
-#    include <sys/time.h>
+#    include <time.h>
 #endif
 
 class Timer
@@ -28,7 +28,7 @@ private:
     LARGE_INTEGER _start_count;
     LARGE_INTEGER _end_count;
 #else
-    timeval _start_count;
-    timeval _end_count;
+    timespec _start_count;
+    timespec _end_count;
 #endif
 };
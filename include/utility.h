@@ -5,7 +5,10 @@
 #include <sstream>
 #include <cassert>
 #include <algorithm>
+#include <memory>
+#include <functional>
 #include <stdio.h>
+#include <stdint.h>
 #include <ogl.h>
 
 namespace dw
@@ -40,6 +43,59 @@ extern std::string current_working_directory();
 // Changes the current working directory.
 extern void change_current_working_directory(std::string path);
 
+// Read-only memory mapping of a whole file. The mapped view stays valid until close() is called or the object is destroyed.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    inline const uint8_t* data() const { return m_data; }
+    inline size_t         size() const { return m_size; }
+    inline bool           is_open() const { return m_data != nullptr; }
+
+private:
+    const uint8_t* m_data = nullptr;
+    size_t         m_size = 0;
+#ifdef WIN32
+    void* m_file    = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+// Pixels decoded from an image file. HDR images hold 32-bit floats per component, everything else 8 bits.
+struct DecodedImage
+{
+    int                   width      = 0;
+    int                   height     = 0;
+    int                   components = 0;
+    bool                  hdr        = false;
+    std::shared_ptr<void> pixels;
+};
+
+// Provides the memory decoded pixels are written to, e.g. a range of a mapped staging buffer. Returning null falls back to the
+// heap. Called from whichever thread decodes the image.
+typedef std::function<std::shared_ptr<void>(size_t size)> PixelAllocator;
+
+// Decodes an image file held in memory. RGB images are expanded to RGBA if expand_rgb is set. Flipping only affects the
+// calling thread, so this is safe to call from any thread. With an allocator, stb_image decodes straight into its memory,
+// or the expansion to RGBA writes there. Pixels the allocator has no room for stay in memory of their own.
+extern bool decode_image(const uint8_t* data, size_t size, bool hdr, bool expand_rgb, bool flip_vertical, DecodedImage& image, const PixelAllocator& allocator = nullptr);
+
+// Largest resident set size the process has reached so far, in bytes. Zero where it cannot be queried.
+extern size_t peak_resident_memory();
+
+// Writes 8-bit RGBA pixels to a PNG file. Rows are expected top to bottom.
+extern bool write_png(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba);
+
+// Writes linear 32-bit float RGBA pixels to an uncompressed OpenEXR file. Rows are expected top to bottom.
+extern bool write_exr(const std::string& path, uint32_t width, uint32_t height, const float* rgba);
+
 #if !defined(DWSF_VULKAN)
 // Create compute program
 extern bool create_compute_program(const std::string& path, gl::Shader::Ptr& shader, gl::Program::Ptr& program, std::vector<std::string> defines = std::vector<std::string>());
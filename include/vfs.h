@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+namespace dw
+{
+namespace utility
+{
+class MappedFile;
+} // namespace utility
+
+namespace vfs
+{
+// Read-only contents of a file. Uncompressed entries of mounted archives point straight into the archive mapping and loose
+// files are memory mapped, so neither is copied. Compressed entries are decompressed into memory owned by the File.
+class File
+{
+public:
+    File();
+    ~File();
+    File(File&& other);
+    File& operator=(File&& other);
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    void close();
+
+    inline const uint8_t* data() const { return m_data; }
+    inline size_t         size() const { return m_size; }
+    inline bool           is_open() const { return m_open; }
+    inline bool           from_archive() const { return m_from_archive; }
+
+private:
+    friend bool read(const std::string& path, File& file);
+    friend bool read_archived(const std::string& path, File& file);
+
+    const uint8_t*                       m_data         = nullptr;
+    size_t                               m_size         = 0;
+    bool                                 m_open         = false;
+    bool                                 m_from_archive = false;
+    std::vector<uint8_t>                 m_buffer;
+    std::unique_ptr<utility::MappedFile> m_mapping;
+};
+
+// Number of files and bytes served since startup, split by where they came from. The read time is in milliseconds and sums
+// up the time spent in read() on all threads.
+struct Stats
+{
+    uint32_t archive_reads;
+    uint32_t loose_reads;
+    uint64_t archive_bytes;
+    uint64_t loose_bytes;
+    uint64_t decompressed_bytes;
+    double   read_time;
+};
+
+// Maps an archive and serves its entries in place of loose files. Entry paths are relative to the directory the archive was
+// packed from, which is matched against relative paths and against absolute paths under the current working directory at
+// the time of mounting. Archives mounted later take precedence. Mounting and unmounting must not overlap with reads.
+extern bool mount(const std::string& archive_path);
+extern void unmount_all();
+
+// Returns true if the path names an archive entry or a loose file.
+extern bool exists(const std::string& path);
+// Reads a whole file, looking in the mounted archives before the file system. Safe to call from any thread.
+extern bool read(const std::string& path, File& file);
+// Reads a file only if a mounted archive holds it, for callers that do their own I/O for loose files.
+extern bool read_archived(const std::string& path, File& file);
+
+extern Stats stats();
+
+// Packs every file below the root directory into an archive. Entries that shrink by at least an eighth are stored LZ4
+// compressed if compression is enabled. Uncompressed entries start on a page boundary.
+extern bool write_archive(const std::string& archive_path, const std::string& root_directory, bool compress = true);
+
+// LZ4 blocks without a frame, as stored in archives and other payloads. Compression appends to the output. Decompression
+// fills exactly size bytes, which the caller has to store next to the block, and returns false if the block is malformed.
+extern void lz4_compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+extern bool lz4_decompress(const uint8_t* data, size_t data_size, uint8_t* destination, size_t size);
+} // namespace vfs
+} // namespace dw
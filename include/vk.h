@@ -10,11 +10,29 @@
 #    include <stack>
 #    include <deque>
 #    include <unordered_map>
+#    include <mutex>
+#    include <atomic>
+#    include <functional>
+
+// Defragmentation looks at one pool every this many frames and starts on it once this fraction of its free memory is
+// outside its largest free range.
+#    define MEMORY_DEFRAGMENTATION_INTERVAL 60
+#    define MEMORY_DEFRAGMENTATION_THRESHOLD 0.25f
+// Limits of a single pass. A pass is copied during one frame, so these bound the cost of defragmentation per frame.
+#    define MEMORY_DEFRAGMENTATION_MAX_BYTES_PER_PASS (32 * 1024 * 1024)
+#    define MEMORY_DEFRAGMENTATION_MAX_MOVES_PER_PASS 64
+// Passes an AsyncCompute scheduler keeps timestamps for in a frame. Later passes still run, untimed.
+#    define ASYNC_COMPUTE_MAX_PASSES 32
 
 struct GLFWwindow;
 
 namespace dw
 {
+namespace utility
+{
+struct DecodedImage;
+} // namespace utility
+
 namespace vk
 {
 class Object;
@@ -31,6 +49,9 @@ class DescriptorSet;
 class DescriptorSetLayout;
 class DescriptorPool;
 class PipelineLayout;
+class MemoryManager;
+class QueryPool;
+struct DownsampleTarget;
 
 struct SwapChainSupportDetails
 {
@@ -60,6 +81,61 @@ struct QueueInfos
     bool transfer();
 };
 
+enum QueueType
+{
+    QUEUE_TYPE_GRAPHICS = 0,
+    QUEUE_TYPE_COMPUTE,
+    QUEUE_TYPE_TRANSFER,
+    QUEUE_TYPE_COUNT
+};
+
+// Pools that images and buffers are allocated from by what they are used for, so that short lived staging memory does not
+// fragment the blocks holding long lived textures and geometry.
+enum MemoryPoolType
+{
+    MEMORY_POOL_RENDER_TARGETS = 0,
+    MEMORY_POOL_STREAMING_TEXTURES,
+    MEMORY_POOL_GEOMETRY,
+    MEMORY_POOL_STAGING,
+    MEMORY_POOL_COUNT,
+    // Allocations that fit none of the pools, or that could not be made from theirs, come from VMA's default heaps.
+    MEMORY_POOL_DEFAULT = MEMORY_POOL_COUNT
+};
+
+struct MemoryPoolStats
+{
+    size_t   block_bytes      = 0;
+    size_t   allocation_bytes = 0;
+    uint32_t allocation_count = 0;
+    // One minus the size of the largest free range over all free bytes, zero when the free memory is in one piece.
+    float    fragmentation    = 0.0f;
+};
+
+struct MemoryStats
+{
+    MemoryPoolStats        pools[MEMORY_POOL_COUNT];
+    // Usage and budget of each memory heap. Exact with VK_EXT_memory_budget and estimated by VMA without it.
+    std::vector<VmaBudget> heap_budgets;
+    // Moved by defragmentation during the last MemoryManager::update().
+    size_t                 bytes_moved             = 0;
+    uint32_t               allocations_moved       = 0;
+    // Allocations that did not fit within the budget and were made anyway, since startup.
+    uint32_t               over_budget_allocations = 0;
+    bool                   memory_budget_extension = false;
+    bool                   defragmenting           = false;
+};
+
+// A value on the timeline semaphore of a queue. Every submission to a queue signals the next value of its timeline, so a
+// point is reached once that submission and every earlier one on the same queue have completed.
+struct TimelinePoint
+{
+    QueueType             queue = QUEUE_TYPE_GRAPHICS;
+    uint64_t              value = 0;
+    // Stages of a submission waiting on the point that are held back until it is reached. Narrowing it lets the work of
+    // the waiting submission that does not depend on the point, e.g. vertex work, start early.
+    VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+};
+
 class Backend : public std::enable_shared_from_this<Backend>
 {
 public:
@@ -68,6 +144,9 @@ public:
     using Ptr = std::shared_ptr<Backend>;
 
     static Backend::Ptr create(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enable_validation_layers = false, bool enable_nsight_aftermath = false, bool require_ray_tracing = false, std::vector<const char*> additional_device_extensions = std::vector<const char*>());
+    // Creates a backend without a surface or swap chain. Frames are rendered into offscreen images owned by the backend,
+    // which are exposed through the same swap chain accessors so application code does not need to distinguish the two.
+    static Backend::Ptr create_headless(uint32_t width, uint32_t height, bool srgb, bool enable_validation_layers = false, bool enable_nsight_aftermath = false, bool require_ray_tracing = false, std::vector<const char*> additional_device_extensions = std::vector<const char*>());
 
     ~Backend();
 
@@ -103,18 +182,50 @@ public:
                                                          uint32_t                      _num_layers,
                                                          uint32_t                      _num_levels);
     void                                    flush_barriers(const std::shared_ptr<CommandBuffer>& _cmd_buf);
-    void                                    submit_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
+    // Returns false if the image has not been used yet, or if its levels and layers were last used in different layouts.
+    bool                                    current_layout(VkImage image, VkImageLayout& layout);
+    // Drops the usage tracked for a handle that has been destroyed, so that a new object given the same handle starts afresh.
+    void                                    forget_resource(VkImage image);
+    void                                    forget_resource(VkBuffer buffer);
+    // Queue family ownership transfers, for images and buffers with exclusive sharing that are handed between queues of
+    // different families. The release is recorded on the queue giving the resource up and the acquire, with the same
+    // layout, on the queue taking it, whose submission must wait on the release's. Both are flushed with flush_barriers()
+    // like any other usage, and the layout changes once across the pair. Only one transfer of a resource can be pending.
+    // Where both queues share a family the release records nothing, and the acquire is the use_resource() it stands for.
+    void                                    release_resource(QueueType src_queue, QueueType dst_queue, VkImageLayout layout, const std::shared_ptr<Image>& image, VkImageSubresourceRange range);
+    void                                    release_resource(QueueType src_queue, QueueType dst_queue, const std::shared_ptr<Buffer>& buffer, size_t offset = 0, size_t size = 0);
+    void                                    acquire_resource(QueueType queue, VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, const std::shared_ptr<Image>& image, VkImageSubresourceRange range);
+    void                                    acquire_resource(QueueType queue, VkPipelineStageFlags2 stage, VkAccessFlags2 access, const std::shared_ptr<Buffer>& buffer, size_t offset = 0, size_t size = 0);
+    uint32_t                                queue_family_index(QueueType queue);
+    // Submissions return the point they signal on the timeline of their queue. Binary semaphores are only needed to
+    // synchronize with the swap chain; work on other queues is waited on through their timeline points, and the fence
+    // may be null.
+    TimelinePoint                           submit_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
                                                             const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
                                                             const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                                                            const std::shared_ptr<Fence>&                      signal_fence);
-    void                                    submit_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
+                                                            const std::shared_ptr<Fence>&                      signal_fence,
+                                                            const std::vector<TimelinePoint>&                  wait_points = std::vector<TimelinePoint>());
+    TimelinePoint                           submit_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
                                                            const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
                                                            const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                                                           const std::shared_ptr<Fence>&                      signal_fence);
-    void                                    submit_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
+                                                           const std::shared_ptr<Fence>&                      signal_fence,
+                                                           const std::vector<TimelinePoint>&                  wait_points = std::vector<TimelinePoint>());
+    TimelinePoint                           submit_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
                                                             const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
                                                             const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                                                            const std::shared_ptr<Fence>&                      signal_fence);
+                                                            const std::shared_ptr<Fence>&                      signal_fence,
+                                                            const std::vector<TimelinePoint>&                  wait_points = std::vector<TimelinePoint>());
+    TimelinePoint                           submit_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs, const std::vector<TimelinePoint>& wait_points = std::vector<TimelinePoint>());
+    TimelinePoint                           submit_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs, const std::vector<TimelinePoint>& wait_points = std::vector<TimelinePoint>());
+    TimelinePoint                           submit_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs, const std::vector<TimelinePoint>& wait_points = std::vector<TimelinePoint>());
+    // The last point submitted to the queue and the last point the GPU has reached on it.
+    TimelinePoint                           last_submitted_point(QueueType queue);
+    TimelinePoint                           last_completed_point(QueueType queue);
+    // Checks a point without blocking. Points already known to be reached are answered without calling into the driver.
+    bool                                    is_complete(const TimelinePoint& point);
+    // Blocks until every point has been reached or the timeout in nanoseconds has expired. Returns false on timeout.
+    bool                                    wait(const TimelinePoint& point, uint64_t timeout = UINT64_MAX);
+    bool                                    wait(const std::vector<TimelinePoint>& points, uint64_t timeout = UINT64_MAX);
     void                                    flush_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs);
     void                                    flush_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs);
     void                                    flush_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs);
@@ -126,6 +237,9 @@ public:
     std::shared_ptr<Image>                  swapchain_depth_image();
     std::shared_ptr<ImageView>              swapchain_depth_image_view();
     void                                    recreate_swapchain(bool vsync);
+    // Copies the current swap chain image into tightly packed RGBA8 pixels, top row first. Must be called after the frame
+    // has been submitted and before it is presented, and blocks until the copy completes.
+    bool                                    read_back_swapchain_image(std::vector<uint8_t>& pixels);
 
     void             wait_idle();
     uint32_t         swap_image_count();
@@ -149,11 +263,14 @@ public:
     inline uint32_t                                           current_frame_idx() { return m_current_frame; }
     inline uint32_t                                           current_image_index() { return m_image_index; }
     inline uint32_t                                           swapchain_size() { return m_swap_chain_images.size(); }
+    inline bool                                               is_headless() { return m_window == nullptr; }
     inline const QueueInfos&                                  queue_infos() { return m_selected_queues; }
     inline std::shared_ptr<Sampler>                           bilinear_sampler() { return m_bilinear_sampler; }
     inline std::shared_ptr<Sampler>                           trilinear_sampler() { return m_trilinear_sampler; }
     inline std::shared_ptr<Sampler>                           nearest_sampler() { return m_nearest_sampler; }
     inline std::shared_ptr<ImageView>                         default_cubemap() { return m_default_cubemap_image_view; }
+    inline MemoryManager*                                     memory_manager() { return m_memory_manager.get(); }
+    inline bool                                               memory_budget_enabled() { return m_memory_budget_enabled; }
 
 private:
     Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enable_validation_layers, bool enable_nsight_aftermath, bool require_ray_tracing, std::vector<const char*> additional_device_extensions);
@@ -172,15 +289,19 @@ private:
     bool                     is_queue_compatible(VkQueueFlags current_queue_flags, int32_t graphics, int32_t compute, int32_t transfer);
     bool                     create_logical_device(std::vector<const char*> extensions, bool require_ray_tracing, bool _use_nsight_aftermath);
     bool                     create_swapchain();
+    bool                     create_offscreen_images();
+    void                     create_swapchain_depth();
     VkSurfaceFormatKHR       choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats);
     VkPresentModeKHR         choose_swap_present_mode(const std::vector<VkPresentModeKHR>& available_modes);
     VkExtent2D               choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities);
-    void                     submit(VkQueue                                            queue,
+    bool                     create_timeline_semaphores();
+    TimelinePoint            submit(QueueType                                          queue,
                                     const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
                                     const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
                                     const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                                    const std::shared_ptr<Fence>&                      signal_fence);
-    void                     flush(VkQueue queue, const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs);
+                                    const std::shared_ptr<Fence>&                      signal_fence,
+                                    const std::vector<TimelinePoint>&                  wait_points);
+    void                     flush(QueueType queue, const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs);
 
 private:
     struct BufferUsageInfo
@@ -197,6 +318,15 @@ private:
         uint32_t              last_frame_idx;
     };
 
+    // A release waiting for its acquire on another queue family.
+    struct OwnershipTransfer
+    {
+        QueueType     src_queue;
+        QueueType     dst_queue;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+    };
+
     GLFWwindow*                                               m_window                = nullptr;
     VkInstance                                                m_vk_instance           = nullptr;
     VkDevice                                                  m_vk_device             = nullptr;
@@ -240,6 +370,16 @@ private:
     std::unordered_map<uint64_t, std::vector<ImageUsageInfo>> m_image_usage_info;
     std::vector<VkBufferMemoryBarrier2>                       m_buffer_memory_barriers;
     std::vector<VkImageMemoryBarrier2>                        m_image_memory_barriers;
+    std::unordered_map<uint64_t, OwnershipTransfer>           m_image_ownership_transfers;
+    std::unordered_map<uint64_t, OwnershipTransfer>           m_buffer_ownership_transfers;
+    // One timeline semaphore per queue type. Queue types sharing a VkQueue still get their own timeline, and the mutex
+    // keeps values signaled in the order they were handed out as well as serializing access to shared queues.
+    VkSemaphore                                               m_vk_timeline_semaphores[QUEUE_TYPE_COUNT] = {};
+    std::atomic<uint64_t>                                     m_timeline_submitted[QUEUE_TYPE_COUNT]     = {};
+    std::atomic<uint64_t>                                     m_timeline_completed[QUEUE_TYPE_COUNT]     = {};
+    std::mutex                                                m_submit_mutex;
+    std::shared_ptr<MemoryManager>                            m_memory_manager;
+    bool                                                      m_memory_budget_enabled = false;
     bool                                                      m_ray_tracing_enabled = false;
     bool                                                      m_vsync               = false;
     bool                                                      m_srgb_swapchain      = false;
@@ -265,6 +405,8 @@ public:
     static Image::Ptr create(Backend::Ptr backend, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VmaMemoryUsage memory_usage, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count, VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED, size_t size = 0, void* data = nullptr, VkImageCreateFlags flags = 0, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
     static Image::Ptr create_from_swapchain(Backend::Ptr backend, VkImage image, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VmaMemoryUsage memory_usage, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count);
     static Image::Ptr create_from_file(Backend::Ptr backend, std::string path, bool flip_vertical = false, bool srgb = false);
+    // Expects RGB images to have been expanded to RGBA, which is what utility::decode_image() does with expand_rgb set.
+    static Image::Ptr create_from_image(Backend::Ptr backend, const utility::DecodedImage& image, bool srgb = false);
 
     ~Image();
 
@@ -285,9 +427,28 @@ public:
     inline VmaMemoryUsage     memory_usage() { return m_memory_usage; }
     inline VkSampleCountFlags sample_count() { return m_sample_count; }
     inline VkImageTiling      tiling() { return m_tiling; }
+    inline VkImageCreateFlags flags() { return m_flags; }
     inline void*              mapped_ptr() { return m_mapped_ptr; }
+    // Views and descriptor sets kept by the Downsampler, see downsampler.h.
+    inline std::shared_ptr<DownsampleTarget>& downsample_target() { return m_downsample_target; }
+    inline MemoryPoolType                     memory_pool() { return m_memory_pool; }
+    inline bool                               is_movable() { return m_movable; }
+
+    // Lets defragmentation move the image to another place in its pool, see MemoryManager. Once it has, handle() and the
+    // views of the image refer to the copy and on_relocated is called from MemoryManager::update(), so that descriptor sets
+    // holding them can be written again. Needs transfer source and destination usage.
+    //
+    // Only images that are no longer written may be movable, since a write made while the image is being copied is lost
+    // when the copy is swapped in. Render targets cannot be made movable, and upload_data(), generate_mipmaps() and the
+    // Downsampler assert that the image they write is not.
+    void set_movable(bool movable, std::function<void()> on_relocated = nullptr);
 
 private:
+    friend class MemoryManager;
+    friend class ImageView;
+
+    void relocate(VkImage image, const VmaAllocationInfo& info, std::vector<VkImageView>& retired_views, std::vector<std::shared_ptr<DownsampleTarget>>& retired_targets);
+
     Image(Backend::Ptr backend, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VmaMemoryUsage memory_usage, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count, VkImageLayout initial_layout, size_t size, void* data, VkImageCreateFlags flags = 0, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
     Image(Backend::Ptr backend, VkImage image, VkImageType type, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip_levels, uint32_t array_size, VkFormat format, VmaMemoryUsage memory_usage, VkImageUsageFlags usage, VkSampleCountFlagBits sample_count);
 
@@ -309,6 +470,13 @@ private:
     VmaAllocator_T*       m_vma_allocator    = nullptr;
     VmaAllocation_T*      m_vma_allocation   = nullptr;
     void*                 m_mapped_ptr       = nullptr;
+    MemoryPoolType        m_memory_pool      = MEMORY_POOL_DEFAULT;
+    bool                  m_movable          = false;
+
+    std::shared_ptr<DownsampleTarget> m_downsample_target;
+    // Views are recreated when the image is moved.
+    std::mutex                        m_views_mutex;
+    std::vector<ImageView*>           m_views;
 };
 
 class ImageView : public Object
@@ -327,8 +495,15 @@ public:
 private:
     ImageView(Backend::Ptr backend, Image::Ptr image, VkImageViewType view_type, VkImageAspectFlags aspect_flags, uint32_t base_mip_level = 0, uint32_t level_count = 1, uint32_t base_array_layer = 0, uint32_t layer_count = 1);
 
+    friend class Image;
+
+    // Creates the view again for the image it was moved to and returns the old one.
+    VkImageView relocate(VkImage image);
+
 private:
-    VkImageView m_vk_image_view;
+    VkImageView           m_vk_image_view;
+    VkImageViewCreateInfo m_vk_info;
+    std::weak_ptr<Image>  m_image;
 };
 
 class Buffer : public Object
@@ -344,15 +519,28 @@ public:
     void set_name(const std::string& name);
 
     void upload_data(void* data, size_t size, size_t offset);
+    // Makes writes from the device to a mapped range visible to the host, for memory that is not host coherent.
+    void invalidate(size_t offset, size_t size);
 
     inline const VkBuffer& handle() { return m_vk_buffer; }
     inline size_t          size() { return m_size; }
     inline void*           mapped_ptr() { return m_mapped_ptr; }
     inline VkDeviceAddress device_address() { return m_device_address; }
+    inline MemoryPoolType  memory_pool() { return m_memory_pool; }
+    inline bool            is_movable() { return m_movable; }
+
+    // Lets defragmentation move the buffer, see Image::set_movable(). The device address changes along with the handle. As
+    // with images only buffers that are no longer written may be movable: mapped buffers cannot be, and upload_data()
+    // asserts that the buffer it writes is not.
+    void set_movable(bool movable, std::function<void()> on_relocated = nullptr);
 
 private:
     Buffer(Backend::Ptr backend, VkBufferUsageFlags usage, size_t size, size_t alignment, VmaMemoryUsage memory_usage, VkFlags create_flags, void* data);
 
+    friend class MemoryManager;
+
+    void relocate(VkBuffer buffer, const VmaAllocationInfo& info);
+
 private:
     size_t                m_size;
     void*                 m_mapped_ptr       = nullptr;
@@ -364,6 +552,212 @@ private:
     VmaMemoryUsage        m_vma_memory_usage;
     VkMemoryPropertyFlags m_vk_memory_property;
     VkBufferUsageFlags    m_vk_usage_flags;
+    MemoryPoolType        m_memory_pool = MEMORY_POOL_DEFAULT;
+    bool                  m_movable     = false;
+};
+
+// Owns the memory pools of a backend, keeps allocations within the memory budget and defragments the pools over several
+// frames.
+//
+// Images and buffers are allocated from the pool their usage falls under. Streaming texture and staging allocations are
+// first made within the budget of their heap; when that fails they are logged, counted and made anyway, since their callers
+// cannot do without them.
+//
+// Defragmentation only moves resources that have been made movable. Handles and device addresses of most resources end
+// up in descriptor sets, acceleration structures and pre-recorded command buffers that the framework cannot patch, so this
+// is opt-in, and is meant for resources written once and then read from the graphics queue, such as loaded textures and
+// meshes. A pass copies what VMA moves on the graphics queue, swaps the copies in once the copy has completed and destroys
+// the old handles once every frame that may still use them has completed. update() never waits on the GPU.
+class MemoryManager
+{
+public:
+    using Ptr = std::shared_ptr<MemoryManager>;
+
+    static MemoryManager::Ptr create(Backend::Ptr backend);
+    static const char*        pool_name(MemoryPoolType type);
+
+    ~MemoryManager();
+
+    // Advances defragmentation. Called by the application once per frame, before the frame is recorded.
+    void        update();
+    // Completes the pass in flight, waiting for the GPU.
+    void        finish();
+    // Keeps an object that frames in flight may still use, e.g. a descriptor set holding the old views of a moved image,
+    // until the old handles of the pass are destroyed. Meant to be called from on_relocated callbacks.
+    void        retire(std::shared_ptr<void> object);
+    MemoryStats stats();
+
+    inline void    set_defragmentation_enabled(bool enabled) { m_defragmentation_enabled = enabled; }
+    inline bool    is_defragmentation_enabled() { return m_defragmentation_enabled; }
+    inline VmaPool pool(MemoryPoolType type) { return type < MEMORY_POOL_COUNT ? m_pools[type] : VK_NULL_HANDLE; }
+
+private:
+    friend class Image;
+    friend class Buffer;
+
+    enum DefragmentationState
+    {
+        DEFRAGMENTATION_IDLE = 0,
+        // The copies of the pass have been submitted.
+        DEFRAGMENTATION_COPYING,
+        // The copies have been swapped in and the old handles wait for the frames using them.
+        DEFRAGMENTATION_RETIRING
+    };
+
+    struct Movable
+    {
+        Image*                image  = nullptr;
+        Buffer*               buffer = nullptr;
+        std::function<void()> on_relocated;
+    };
+
+    // Parallel to the moves of the pass.
+    struct Move
+    {
+        Movable  resource;
+        VkImage  old_image  = VK_NULL_HANDLE;
+        VkImage  new_image  = VK_NULL_HANDLE;
+        VkBuffer old_buffer = VK_NULL_HANDLE;
+        VkBuffer new_buffer = VK_NULL_HANDLE;
+        bool     recorded   = false;
+        // The resource was destroyed while the move was in flight, which leaves both handles to the manager.
+        bool     destroyed  = false;
+    };
+
+    MemoryManager(Backend::Ptr backend);
+
+    MemoryPoolType classify(const VkImageCreateInfo& info, VmaMemoryUsage memory_usage);
+    MemoryPoolType classify(const VkBufferCreateInfo& info, VmaMemoryUsage memory_usage);
+    // Calls create with the allocation moved into the pool, falling back to exceeding the budget and then to the default
+    // heaps. Returns the pool the allocation ended up in.
+    MemoryPoolType allocate(MemoryPoolType type, const VmaAllocationCreateInfo& alloc_create_info, const std::function<VkResult(const VmaAllocationCreateInfo&)>& create, VkResult& result);
+    void            register_movable(VmaAllocation_T* allocation, const Movable& movable);
+    void            unregister_movable(VmaAllocation_T* allocation);
+    // Called when a movable resource is destroyed. Returns true if its allocation is being moved, in which case the manager
+    // takes over its handles and the allocation is freed when the pass ends.
+    bool            release(VmaAllocation_T* allocation);
+    void            begin_pass();
+    bool            record_move(uint32_t index);
+    void            swap_moves(std::vector<std::function<void()>>& callbacks);
+    void            end_pass();
+    void            end_defragmentation();
+    MemoryPoolStats pool_stats(uint32_t pool);
+
+private:
+    // The backend owns the manager, so a plain pointer lets the manager finish its work from the backend's destructor.
+    Backend*                                       m_backend                  = nullptr;
+    VmaAllocator_T*                                m_vma_allocator            = nullptr;
+    VmaPool                                        m_pools[MEMORY_POOL_COUNT] = {};
+    std::shared_ptr<CommandPool>                   m_cmd_pool;
+    std::shared_ptr<CommandBuffer>                 m_cmd_buf;
+    std::mutex                                     m_mutex;
+    std::unordered_map<VmaAllocation_T*, Movable>  m_movables;
+    std::unordered_map<VmaAllocation_T*, uint32_t> m_move_indices;
+    std::vector<Move>                              m_moves;
+    std::vector<VkImageView>                       m_retired_views;
+    std::vector<std::shared_ptr<DownsampleTarget>> m_retired_targets;
+    std::vector<std::shared_ptr<void>>             m_retired_objects;
+    std::vector<TimelinePoint>                     m_retire_points;
+    TimelinePoint                                  m_copy_point;
+    VmaDefragmentationContext                      m_context                 = VK_NULL_HANDLE;
+    VmaDefragmentationPassMoveInfo                 m_pass                    = {};
+    DefragmentationState                           m_state                   = DEFRAGMENTATION_IDLE;
+    uint32_t                                       m_frame                   = 0;
+    uint32_t                                       m_pool_index              = 0;
+    bool                                           m_defragmentation_enabled = true;
+    size_t                                         m_bytes_moved             = 0;
+    uint32_t                                       m_allocations_moved       = 0;
+    std::atomic<uint32_t>                          m_over_budget_allocations = { 0 };
+};
+
+// GPU times of the work an AsyncCompute scheduler submitted in a frame, in milliseconds. Read back a few frames later, once
+// the frame has completed. Timestamps taken on the compute and graphics queues are compared directly, which holds on the
+// drivers that expose several queues, since they share one time domain across the queues of a device.
+struct AsyncComputeStats
+{
+    struct Pass
+    {
+        std::string name;
+        float       ms = 0.0f;
+    };
+
+    std::vector<Pass> passes;
+    // From the first to the last timestamp of the submission on the compute queue.
+    float             compute_ms = 0.0f;
+    // Between begin_graphics_timing() and end_graphics_timing() on the graphics queue.
+    float             graphics_ms = 0.0f;
+    // Time the two ran at once, which is what running the work on its own queue saves over running it inline.
+    float             overlap_ms   = 0.0f;
+    bool              asynchronous = false;
+    bool              valid        = false;
+};
+
+// Schedules compute work on the asynchronous compute queue so that it runs alongside the graphics work of the frame, such
+// as environment map filtering next to the main raster pass. Work is recorded into command buffers owned by the scheduler,
+// one per frame in flight, and submitted once a frame. Devices without a compute family of their own run the submission on
+// the compute queue of the graphics family, where the ownership transfers below reduce to ordinary barriers.
+//
+// Resources shared with graphics change queue family with Backend::release_resource() and acquire_resource(). A frame
+// that filters an environment map rendered by graphics and samples the results in its lighting pass goes:
+//
+//   graphics: render cubemap, release cubemap and results to compute, submit           -> point A
+//   compute:  begin(), acquire, filter, release back to graphics, submit({ A })        -> point C
+//   graphics: raster pass, acquire cubemap and results, lighting, submit({ C })
+//
+// with C.stage narrowed to the stages that read the results, so that the raster work before them overlaps the filtering.
+class AsyncCompute
+{
+public:
+    using Ptr = std::shared_ptr<AsyncCompute>;
+
+    static AsyncCompute::Ptr create(Backend::Ptr backend);
+
+    ~AsyncCompute();
+
+    // Begins the command buffer of the next frame slot, once the GPU is done with it. Called once a frame, before the
+    // compute work or the graphics timing of the frame is recorded.
+    std::shared_ptr<CommandBuffer> begin();
+    // Bracket a pass with timestamps on the compute queue. Passes do not nest.
+    void                           begin_pass(const std::string& name);
+    void                           end_pass();
+    // Ends the command buffer and submits it once the given points have been reached.
+    TimelinePoint                  submit(const std::vector<TimelinePoint>& wait_points = std::vector<TimelinePoint>());
+    // Bracket the graphics work the compute work is meant to overlap, in graphics command buffers of the same frame.
+    void                           begin_graphics_timing(const std::shared_ptr<CommandBuffer>& cmd_buf);
+    void                           end_graphics_timing(const std::shared_ptr<CommandBuffer>& cmd_buf);
+
+    inline bool                           is_asynchronous() { return m_asynchronous; }
+    inline std::shared_ptr<CommandBuffer> command_buffer() { return m_slots[m_slot].cmd_buf; }
+    inline TimelinePoint                  last_point() { return m_last_point; }
+    inline const AsyncComputeStats&       stats() { return m_stats; }
+
+private:
+    struct Slot
+    {
+        std::shared_ptr<CommandPool>   cmd_pool;
+        std::shared_ptr<CommandBuffer> cmd_buf;
+        std::shared_ptr<QueryPool>     compute_queries;
+        std::shared_ptr<QueryPool>     graphics_queries;
+        std::vector<std::string>       pass_names;
+        TimelinePoint                  point;
+        bool                           submitted      = false;
+        bool                           graphics_timed = false;
+    };
+
+    AsyncCompute(Backend::Ptr backend);
+
+    void read_stats(Slot& slot);
+
+private:
+    std::weak_ptr<Backend> m_backend;
+    Slot                   m_slots[Backend::kMaxFramesInFlight];
+    uint32_t               m_slot = 0;
+    TimelinePoint          m_last_point;
+    AsyncComputeStats      m_stats;
+    float                  m_timestamp_period = 0.0f;
+    bool                   m_asynchronous     = false;
+    bool                   m_timestamps       = false;
+    bool                   m_recording        = false;
 };
 
 class CommandPool : public Object
@@ -589,11 +983,15 @@ public:
         VkFormat                         color_attachment_formats[8];
         VkFormat                         depth_attachment_format = VK_FORMAT_UNDEFINED;
         VkFormat                         stencil_attachment_format = VK_FORMAT_UNDEFINED;
+        uint32_t                         view_mask = 0;
 
         Desc();
         Desc& add_color_attachment_format(VkFormat format);
         Desc& set_depth_attachment_format(VkFormat format);
         Desc& set_stencil_attachment_format(VkFormat format);
+        // Renders each view of the mask into the layer of the same index, with gl_ViewIndex telling them apart. Must match the
+        // view mask of the dynamic rendering pass the pipeline is used in.
+        Desc& set_view_mask(uint32_t mask);
         Desc& add_dynamic_state(const VkDynamicState& state);
         Desc& set_viewport_state(ViewportStateDesc& state);
         Desc& add_shader_stage(const VkShaderStageFlagBits& stage, const ShaderModule::Ptr& shader_module, const std::string& name);
@@ -968,6 +1366,8 @@ public:
     ~Fence();
 
     void wait_for_completion();
+    // Returns true if the fence is signaled, without waiting or resetting it.
+    bool is_complete();
 
     void set_name(const std::string& name);
 
@@ -0,0 +1,341 @@
+#include <application.h>
+#include <timer.h>
+#include <cstring>
+
+// Draws 10,000 debug shapes every frame of a headless run and reports the CPU time spent submitting and rendering them,
+// along with the GPU time of the draws on OpenGL. The number of frames can be changed through "frame_count" in
+// config.json.
+//
+// The "expanded" mode is the baseline the instanced primitives are compared against. It draws the same shapes the way
+// DebugDraw did before instancing: every call computes its wireframe with sin/cos on the CPU and emits it as lines, so
+// that every vertex goes through the line stream. Those lines are still merged into a single draw, which the old
+// renderer did not do for strips, so the baseline it gives for render and GPU time is optimistic.
+//
+// Usage: debug_draw_benchmark [instanced|expanded]
+
+#define BENCHMARK_SHAPE_COUNT 10000
+#define BENCHMARK_GRID_SIZE 100
+#define BENCHMARK_FRAME_COUNT 500
+#define BENCHMARK_WARMUP_FRAMES 10
+// Segments of circles in the expanded mode, matching the 20 degree steps DebugDraw used to take.
+#define BENCHMARK_CIRCLE_SEGMENTS 18
+
+class DebugDrawBenchmark : public dw::Application
+{
+protected:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool init(int argc, const char* argv[]) override
+    {
+        m_expanded = argc >= 2 && strcmp(argv[1], "expanded") == 0;
+
+        m_view_pos  = glm::vec3(0.0f, 150.0f, 250.0f);
+        m_view_proj = glm::perspective(glm::radians(60.0f), float(m_width) / float(m_height), 0.1f, 1000.0f) * glm::lookAt(m_view_pos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+#if !defined(DWSF_VULKAN)
+        glGenQueries(1, &m_query);
+#endif
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update(double delta) override
+    {
+        Timer timer;
+
+        timer.start();
+
+        submit_shapes();
+
+        double submit_ms = timer.elapsed_time_milisec();
+        double render_ms = 0.0;
+        double gpu_ms    = 0.0;
+
+#if defined(DWSF_VULKAN)
+        dw::vk::CommandBuffer::Ptr cmd_buf = m_vk_backend->allocate_graphics_command_buffer(true);
+
+        VkImageSubresourceRange color_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        VkImageSubresourceRange depth_range = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+        m_vk_backend->use_resource(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, m_vk_backend->swapchain_image(), color_range);
+        m_vk_backend->use_resource(VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, m_vk_backend->swapchain_depth_image(), depth_range);
+        m_vk_backend->flush_barriers(cmd_buf);
+
+        VkRenderingAttachmentInfoKHR color_attachment = {};
+
+        color_attachment.sType                       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        color_attachment.imageView                   = m_vk_backend->swapchain_image_view()->handle();
+        color_attachment.imageLayout                 = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        color_attachment.loadOp                      = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        color_attachment.storeOp                     = VK_ATTACHMENT_STORE_OP_STORE;
+        color_attachment.clearValue.color.float32[3] = 1.0f;
+
+        VkRenderingAttachmentInfoKHR depth_attachment = {};
+
+        depth_attachment.sType                         = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+        depth_attachment.imageView                     = m_vk_backend->swapchain_depth_image_view()->handle();
+        depth_attachment.imageLayout                   = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+        depth_attachment.loadOp                        = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depth_attachment.storeOp                       = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depth_attachment.clearValue.depthStencil.depth = 1.0f;
+
+        VkRenderingInfoKHR rendering_info {};
+
+        rendering_info.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+        rendering_info.renderArea           = { 0, 0, m_width, m_height };
+        rendering_info.layerCount           = 1;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachments    = &color_attachment;
+        rendering_info.pDepthAttachment     = &depth_attachment;
+
+        vkCmdBeginRenderingKHR(cmd_buf->handle(), &rendering_info);
+
+        VkViewport vp;
+
+        vp.x        = 0.0f;
+        vp.y        = (float)m_height;
+        vp.width    = (float)m_width;
+        vp.height   = -(float)m_height;
+        vp.minDepth = 0.0f;
+        vp.maxDepth = 1.0f;
+
+        vkCmdSetViewport(cmd_buf->handle(), 0, 1, &vp);
+
+        VkRect2D scissor_rect = { { 0, 0 }, { m_width, m_height } };
+
+        vkCmdSetScissor(cmd_buf->handle(), 0, 1, &scissor_rect);
+
+        timer.start();
+
+        m_debug_draw.render(m_vk_backend, cmd_buf, m_width, m_height, m_view_proj, m_view_pos);
+
+        render_ms = timer.elapsed_time_milisec();
+
+        vkCmdEndRenderingKHR(cmd_buf->handle());
+
+        m_vk_backend->use_resource(VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, m_vk_backend->swapchain_image(), color_range);
+        m_vk_backend->flush_barriers(cmd_buf);
+
+        vkEndCommandBuffer(cmd_buf->handle());
+
+        submit_and_present({ cmd_buf });
+#else
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, m_width, m_height);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glBeginQuery(GL_TIME_ELAPSED, m_query);
+
+        timer.start();
+
+        m_debug_draw.render(nullptr, m_width, m_height, m_view_proj, m_view_pos);
+
+        render_ms = timer.elapsed_time_milisec();
+
+        glEndQuery(GL_TIME_ELAPSED);
+
+        // Waiting on the query serializes the frames, which only affects the frame rate, not the timings being measured.
+        GLuint64 gpu_ns = 0;
+        glGetQueryObjectui64v(m_query, GL_QUERY_RESULT, &gpu_ns);
+
+        gpu_ms = double(gpu_ns) / 1000000.0;
+#endif
+
+        if (m_frame_index >= BENCHMARK_WARMUP_FRAMES)
+        {
+            m_submit_ms += submit_ms;
+            m_render_ms += render_ms;
+            m_gpu_ms += gpu_ms;
+            m_measured_frames++;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void shutdown() override
+    {
+#if !defined(DWSF_VULKAN)
+        glDeleteQueries(1, &m_query);
+#endif
+
+        if (m_measured_frames == 0)
+            return;
+
+        double frames = double(m_measured_frames);
+
+        DW_LOG_INFO("Debug draw (" + std::string(m_expanded ? "expanded" : "instanced") + "), " + std::to_string(BENCHMARK_SHAPE_COUNT) + " shapes over " + std::to_string(m_measured_frames) + " frames");
+        DW_LOG_INFO("  submit (CPU): " + std::to_string(m_submit_ms / frames) + " ms");
+        DW_LOG_INFO("  render (CPU): " + std::to_string(m_render_ms / frames) + " ms");
+#if !defined(DWSF_VULKAN)
+        DW_LOG_INFO("  draws  (GPU): " + std::to_string(m_gpu_ms / frames) + " ms");
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    dw::AppSettings intial_app_settings() override
+    {
+        dw::AppSettings settings;
+
+        settings.width       = 1280;
+        settings.height      = 720;
+        settings.title       = "Debug Draw Benchmark";
+        settings.headless    = true;
+        settings.frame_count = BENCHMARK_FRAME_COUNT;
+
+        return settings;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void submit_shapes()
+    {
+        const float     spacing = 4.0f;
+        const glm::vec3 origin  = glm::vec3(-0.5f * spacing * BENCHMARK_GRID_SIZE, 0.0f, -0.5f * spacing * BENCHMARK_GRID_SIZE);
+
+        // Every kind of shape, in equal numbers.
+        for (int i = 0; i < BENCHMARK_SHAPE_COUNT; i++)
+        {
+            glm::vec3 pos   = origin + glm::vec3(spacing * (i % BENCHMARK_GRID_SIZE), 0.0f, spacing * (i / BENCHMARK_GRID_SIZE));
+            glm::vec3 color = glm::vec3(float(i % 7) / 6.0f, float(i % 11) / 10.0f, float(i % 13) / 12.0f);
+
+            if (m_expanded)
+            {
+                submit_expanded_shape(i, pos, color);
+                continue;
+            }
+
+            switch (i % 5)
+            {
+                case 0:
+                    m_debug_draw.aabb(pos - glm::vec3(1.0f), pos + glm::vec3(1.0f), color);
+                    break;
+                case 1:
+                    m_debug_draw.sphere(1.0f, pos, color);
+                    break;
+                case 2:
+                    m_debug_draw.capsule(3.0f, 0.5f, pos, color);
+                    break;
+                case 3:
+                    m_debug_draw.cone(2.0f, 1.0f, pos, color);
+                    break;
+                case 4:
+                    m_debug_draw.obb(glm::vec3(-1.0f), glm::vec3(1.0f), glm::rotate(glm::translate(glm::mat4(1.0f), pos), float(i), glm::vec3(0.0f, 1.0f, 0.0f)), color);
+                    break;
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // The shape submit_shapes() draws for the index, generated on the CPU and emitted as lines.
+    void submit_expanded_shape(int i, const glm::vec3& pos, const glm::vec3& color)
+    {
+        switch (i % 5)
+        {
+            case 0:
+                box_lines(glm::translate(glm::mat4(1.0f), pos), color);
+                break;
+            case 1:
+                arc_lines(pos, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, 0.0f, 360.0f, color);
+                arc_lines(pos, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, 0.0f, 360.0f, color);
+                arc_lines(pos, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, 0.0f, 360.0f, color);
+                break;
+            case 2:
+            {
+                const float     radius = 0.5f;
+                const glm::vec3 bottom = pos + glm::vec3(0.0f, radius, 0.0f);
+                const glm::vec3 top    = pos + glm::vec3(0.0f, 3.0f - radius, 0.0f);
+
+                m_debug_draw.line(bottom + glm::vec3(radius, 0.0f, 0.0f), top + glm::vec3(radius, 0.0f, 0.0f), color);
+                m_debug_draw.line(bottom - glm::vec3(radius, 0.0f, 0.0f), top - glm::vec3(radius, 0.0f, 0.0f), color);
+                m_debug_draw.line(bottom + glm::vec3(0.0f, 0.0f, radius), top + glm::vec3(0.0f, 0.0f, radius), color);
+                m_debug_draw.line(bottom - glm::vec3(0.0f, 0.0f, radius), top - glm::vec3(0.0f, 0.0f, radius), color);
+
+                arc_lines(top, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), radius, 0.0f, 180.0f, color);
+                arc_lines(top, glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), radius, 0.0f, 180.0f, color);
+                arc_lines(bottom, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), radius, 180.0f, 360.0f, color);
+                arc_lines(bottom, glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), radius, 180.0f, 360.0f, color);
+                arc_lines(top, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), radius, 0.0f, 360.0f, color);
+                arc_lines(bottom, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), radius, 0.0f, 360.0f, color);
+                break;
+            }
+            case 3:
+            {
+                const glm::vec3 apex = pos + glm::vec3(0.0f, 2.0f, 0.0f);
+
+                arc_lines(pos, glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, 0.0f, 360.0f, color);
+
+                m_debug_draw.line(pos + glm::vec3(1.0f, 0.0f, 0.0f), apex, color);
+                m_debug_draw.line(pos - glm::vec3(1.0f, 0.0f, 0.0f), apex, color);
+                m_debug_draw.line(pos + glm::vec3(0.0f, 0.0f, 1.0f), apex, color);
+                m_debug_draw.line(pos - glm::vec3(0.0f, 0.0f, 1.0f), apex, color);
+                break;
+            }
+            case 4:
+                box_lines(glm::rotate(glm::translate(glm::mat4(1.0f), pos), float(i), glm::vec3(0.0f, 1.0f, 0.0f)), color);
+                break;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Twelve edges of the box from -1 to 1, transformed on the CPU.
+    void box_lines(const glm::mat4& model, const glm::vec3& color)
+    {
+        glm::vec3 corners[8];
+
+        for (int i = 0; i < 8; i++)
+            corners[i] = glm::vec3(model * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f));
+
+        for (int i = 0; i < 8; i++)
+        {
+            for (int axis = 1; axis < 8; axis <<= 1)
+            {
+                if (!(i & axis))
+                    m_debug_draw.line(corners[i], corners[i | axis], color);
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Arc in the plane of the two axes, in the same 20 degree steps DebugDraw used to take.
+    void arc_lines(const glm::vec3& center, const glm::vec3& axis_x, const glm::vec3& axis_y, float radius, float start_degrees, float end_degrees, const glm::vec3& color)
+    {
+        glm::vec3 verts[BENCHMARK_CIRCLE_SEGMENTS + 1];
+
+        int   count = int((end_degrees - start_degrees) / (360.0f / BENCHMARK_CIRCLE_SEGMENTS)) + 1;
+        float step  = (end_degrees - start_degrees) / float(count - 1);
+
+        for (int i = 0; i < count; i++)
+        {
+            float angle = glm::radians(start_degrees + step * i);
+            verts[i]    = center + (axis_x * cosf(angle) + axis_y * sinf(angle)) * radius;
+        }
+
+        m_debug_draw.line_strip(&verts[0], count, color);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    bool      m_expanded        = false;
+    glm::vec3 m_view_pos;
+    glm::mat4 m_view_proj;
+    double    m_submit_ms       = 0.0;
+    double    m_render_ms       = 0.0;
+    double    m_gpu_ms          = 0.0;
+    uint32_t  m_measured_frames = 0;
+#if !defined(DWSF_VULKAN)
+    GLuint m_query = 0;
+#endif
+};
+
+DW_DECLARE_MAIN(DebugDrawBenchmark)
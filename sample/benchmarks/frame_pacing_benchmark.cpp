@@ -0,0 +1,284 @@
+#include <application.h>
+#include <timer.h>
+#include <algorithm>
+#include <vector>
+
+// Compares the low-latency pacing profile (one frame in flight, input latched after the wait) with the high-throughput
+// one (MAX_FRAMES_IN_FLIGHT frames, input latched at the start of the frame). Every frame spins on the CPU for a fixed
+// time and dispatches a compute shader calibrated to keep the GPU busy for about as long, which is where the two
+// profiles differ the most. For each profile the frame time, the CPU wait on the GPU, the GPU idle time and the latency
+// from input latching to the GPU finishing the frame are reported. Completion is only polled before and after the CPU
+// work of each frame, so the latency is an upper bound.
+//
+// Usage: frame_pacing_benchmark [frames per profile] [CPU ms per frame] [GPU ms per frame] [frame rate limit]
+
+#define BENCHMARK_DEFAULT_FRAME_COUNT 300
+#define BENCHMARK_DEFAULT_CPU_MS 4.0
+#define BENCHMARK_DEFAULT_GPU_MS 4.0
+#define BENCHMARK_WARMUP_FRAMES 30
+#define BENCHMARK_GROUP_COUNT 256
+#define BENCHMARK_CALIBRATION_ITERATIONS 4096
+
+static const char* kWORK_SOURCE = R"(
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) buffer Results
+{
+    uint values[];
+};
+
+uniform uint u_Iterations;
+
+void main()
+{
+    uint x = gl_GlobalInvocationID.x + 1u;
+
+    for (uint i = 0u; i < u_Iterations; i++)
+        x = x * 1664525u + 1013904223u;
+
+    values[gl_GlobalInvocationID.x] = x;
+}
+)";
+
+struct PacingProfile
+{
+    const char* name;
+    uint32_t    frames_in_flight;
+    bool        late_input_latching;
+};
+
+static const PacingProfile kPROFILES[] = {
+    { "low latency", 1, true },
+    { "throughput", MAX_FRAMES_IN_FLIGHT, false }
+};
+
+static const uint32_t kPROFILE_COUNT = sizeof(kPROFILES) / sizeof(kPROFILES[0]);
+
+struct ProfileResults
+{
+    uint32_t            frames   = 0;
+    double              frame_ms = 0.0;
+    dw::FrameTimings    timings;
+    std::vector<double> latencies;
+};
+
+// A frame whose GPU work has been submitted, along with the time its input was latched.
+struct PendingFrame
+{
+    GLsync   fence;
+    double   latch_ms;
+    uint32_t profile;
+};
+
+class FramePacingBenchmark : public dw::Application
+{
+protected:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool init(int argc, const char* argv[]) override
+    {
+        m_frames_per_profile = argc < 2 ? BENCHMARK_DEFAULT_FRAME_COUNT : std::max(atoi(argv[1]), 1);
+        m_cpu_ms             = argc < 3 ? BENCHMARK_DEFAULT_CPU_MS : std::max(atof(argv[2]), 0.0);
+
+        double gpu_ms = argc < 4 ? BENCHMARK_DEFAULT_GPU_MS : std::max(atof(argv[3]), 0.0);
+
+        if (argc >= 5)
+            set_frame_rate_limit(atof(argv[4]));
+
+        m_shader = dw::gl::Shader::create(GL_COMPUTE_SHADER, kWORK_SOURCE);
+
+        if (!m_shader || !m_shader->compiled())
+        {
+            DW_LOG_ERROR("Failed to compile the GPU work shader.");
+            return false;
+        }
+
+        m_program = dw::gl::Program::create({ m_shader });
+        m_results = dw::gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t) * BENCHMARK_GROUP_COUNT * 64);
+
+        // The first dispatch includes driver warm-up, so the second one is timed.
+        double calibration_ms = 0.0;
+
+        for (int i = 0; i < 2; i++)
+        {
+            Timer timer;
+            timer.start();
+
+            dispatch_work(BENCHMARK_CALIBRATION_ITERATIONS);
+            glFinish();
+
+            calibration_ms = timer.elapsed_time_milisec();
+        }
+
+        m_gpu_iterations = uint32_t(BENCHMARK_CALIBRATION_ITERATIONS * gpu_ms / std::max(calibration_ms, 0.001));
+
+        DW_LOG_INFO(std::to_string(BENCHMARK_CALIBRATION_ITERATIONS) + " iterations took " + std::to_string(calibration_ms) + " ms, " + std::to_string(m_gpu_iterations) + " iterations per frame");
+
+        apply_profile(0);
+        m_clock.start();
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update(double delta) override
+    {
+        double now = m_clock.elapsed_time_milisec();
+
+        // The delta and the frame timings both describe the previous frame.
+        if (m_previous_frame_counts)
+        {
+            ProfileResults&         results = m_results_by_profile[m_previous_profile];
+            const dw::FrameTimings& timings = frame_timings();
+
+            results.frames++;
+            results.frame_ms += delta;
+            results.timings.cpu_wait += timings.cpu_wait;
+            results.timings.gpu_wait += timings.gpu_wait;
+            results.timings.limiter += timings.limiter;
+        }
+
+        retire_completed_frames(now);
+
+        uint32_t profile = m_frame_index / (m_frames_per_profile + BENCHMARK_WARMUP_FRAMES);
+
+        if (profile >= kPROFILE_COUNT)
+        {
+            report();
+            request_exit();
+            return;
+        }
+
+        if (profile != m_profile)
+            apply_profile(profile);
+
+        // Late latching polls input right before update. Early latching polls it as the frame starts, which is once the
+        // previous update has returned and the frame limiter has finished.
+        double latch_ms = kPROFILES[profile].late_input_latching ? now : m_update_end_ms + frame_timings().limiter;
+
+        Timer cpu_timer;
+        cpu_timer.start();
+
+        while (cpu_timer.elapsed_time_milisec() < m_cpu_ms)
+            ;
+
+        retire_completed_frames(m_clock.elapsed_time_milisec());
+        dispatch_work(m_gpu_iterations);
+
+        bool counted = (m_frame_index % (m_frames_per_profile + BENCHMARK_WARMUP_FRAMES)) >= BENCHMARK_WARMUP_FRAMES;
+
+        if (counted)
+            m_pending.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), latch_ms, profile });
+
+        m_previous_profile      = profile;
+        m_previous_frame_counts = counted;
+        m_update_end_ms         = m_clock.elapsed_time_milisec();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void shutdown() override
+    {
+        for (auto& frame : m_pending)
+            glDeleteSync(frame.fence);
+
+        m_pending.clear();
+        m_results.reset();
+        m_program.reset();
+        m_shader.reset();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    dw::AppSettings intial_app_settings() override
+    {
+        dw::AppSettings settings;
+
+        settings.title    = "Frame Pacing Benchmark";
+        settings.headless = true;
+        settings.vsync    = false;
+
+        return settings;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    void dispatch_work(uint32_t iterations)
+    {
+        m_program->use();
+        m_program->set_uniform("u_Iterations", iterations);
+        m_results->bind_base(0);
+
+        glDispatchCompute(BENCHMARK_GROUP_COUNT, 1, 1);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void apply_profile(uint32_t profile)
+    {
+        m_profile = profile;
+
+        set_frames_in_flight(kPROFILES[profile].frames_in_flight);
+        set_late_input_latching(kPROFILES[profile].late_input_latching);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void retire_completed_frames(double now)
+    {
+        while (!m_pending.empty() && glClientWaitSync(m_pending.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        {
+            m_results_by_profile[m_pending.front().profile].latencies.push_back(now - m_pending.front().latch_ms);
+
+            glDeleteSync(m_pending.front().fence);
+            m_pending.erase(m_pending.begin());
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void report()
+    {
+        glFinish();
+        retire_completed_frames(m_clock.elapsed_time_milisec());
+
+        DW_LOG_INFO(std::to_string(m_frames_per_profile) + " frames per profile, " + std::to_string(m_cpu_ms) + " ms of CPU work per frame");
+
+        for (uint32_t i = 0; i < kPROFILE_COUNT; i++)
+        {
+            ProfileResults& results = m_results_by_profile[i];
+            double          frames  = std::max(results.frames, 1u);
+
+            std::sort(results.latencies.begin(), results.latencies.end());
+
+            double median_latency = results.latencies.empty() ? 0.0 : results.latencies[results.latencies.size() / 2];
+            double max_latency    = results.latencies.empty() ? 0.0 : results.latencies.back();
+
+            DW_LOG_INFO(std::string(kPROFILES[i].name) + " (" + std::to_string(kPROFILES[i].frames_in_flight) + " frames in flight)");
+            DW_LOG_INFO("  frame:    " + std::to_string(results.frame_ms / frames) + " ms, " + std::to_string(1000.0 * frames / std::max(results.frame_ms, 0.001)) + " fps");
+            DW_LOG_INFO("  CPU wait: " + std::to_string(results.timings.cpu_wait / frames) + " ms, GPU idle: " + std::to_string(results.timings.gpu_wait / frames) + " ms, limiter: " + std::to_string(results.timings.limiter / frames) + " ms");
+            DW_LOG_INFO("  latency:  " + std::to_string(median_latency) + " ms median, " + std::to_string(max_latency) + " ms max");
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    uint32_t                  m_frames_per_profile    = BENCHMARK_DEFAULT_FRAME_COUNT;
+    uint32_t                  m_gpu_iterations        = 0;
+    uint32_t                  m_profile               = 0;
+    uint32_t                  m_previous_profile      = 0;
+    bool                      m_previous_frame_counts = false;
+    double                    m_cpu_ms                = BENCHMARK_DEFAULT_CPU_MS;
+    double                    m_update_end_ms         = 0.0;
+    Timer                     m_clock;
+    dw::gl::Shader::Ptr       m_shader;
+    dw::gl::Program::Ptr      m_program;
+    dw::gl::Buffer::Ptr       m_results;
+    std::vector<PendingFrame> m_pending;
+    ProfileResults            m_results_by_profile[kPROFILE_COUNT];
+};
+
+DW_DECLARE_MAIN(FramePacingBenchmark)
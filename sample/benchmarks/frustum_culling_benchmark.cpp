@@ -0,0 +1,179 @@
+#include <geometry.h>
+#include <jobs.h>
+#include <logger.h>
+#include <timer.h>
+#include <gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Measures how many boxes per second the batch culling functions classify, against the per-box intersects(). One million
+// boxes are scattered around a camera that looks down the negative z axis, so that a fraction of them is visible. The
+// batch path is timed on one thread, with the rejecting planes of the previous frame, and split across the job system.
+// The masks are checked against a scalar test of the same boxes.
+//
+// Usage: frustum_culling_benchmark [box count] [repeat count]
+
+#define BENCHMARK_DEFAULT_BOX_COUNT 1000000
+#define BENCHMARK_DEFAULT_REPEAT_COUNT 10
+#define BENCHMARK_JOB_BOX_COUNT 16384
+
+struct Boxes
+{
+    std::vector<float> center[3];
+    std::vector<float> extent[3];
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static dw::AABBBatch batch_from_boxes(const Boxes& boxes)
+{
+    return { boxes.center[0].data(), boxes.center[1].data(), boxes.center[2].data(), boxes.extent[0].data(), boxes.extent[1].data(), boxes.extent[2].data() };
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The same test as cull_aabbs, one box at a time.
+static bool box_visible(const dw::Frustum& frustum, const Boxes& boxes, uint32_t i)
+{
+    for (int p = 0; p < 6; p++)
+    {
+        const dw::Plane& plane = frustum.planes[p];
+
+        float d = plane.n.x * boxes.center[0][i] + plane.n.y * boxes.center[1][i] + plane.n.z * boxes.center[2][i] + plane.d;
+        float r = fabsf(plane.n.x) * boxes.extent[0][i] + fabsf(plane.n.y) * boxes.extent[1][i] + fabsf(plane.n.z) * boxes.extent[2][i];
+
+        if (d + r < 0.0f)
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename Function>
+static double best_ms(uint32_t repeat, Function function)
+{
+    Timer  timer;
+    double best = 0.0;
+
+    for (uint32_t i = 0; i < repeat; i++)
+    {
+        timer.start();
+        function();
+
+        double ms = timer.elapsed_time_milisec();
+        best      = i == 0 ? ms : std::min(best, ms);
+    }
+
+    return best;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void log_rate(const std::string& name, uint32_t count, double ms)
+{
+    DW_LOG_INFO("  " + name + std::to_string(ms) + " ms, " + std::to_string(count / ms / 1000.0) + " M boxes/s");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    uint32_t count  = argc < 2 ? BENCHMARK_DEFAULT_BOX_COUNT : std::max(atoi(argv[1]), 1);
+    uint32_t repeat = argc < 3 ? BENCHMARK_DEFAULT_REPEAT_COUNT : std::max(atoi(argv[2]), 1);
+
+    Boxes        boxes;
+    std::mt19937 rng(1234);
+
+    std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> extent(0.5f, 20.0f);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        boxes.center[axis].resize(count);
+        boxes.extent[axis].resize(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            boxes.center[axis][i] = position(rng);
+            boxes.extent[axis][i] = extent(rng);
+        }
+    }
+
+    dw::Frustum     frustum;
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    dw::frustum_from_matrix(frustum, glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f) * view);
+
+    const dw::AABBBatch   batch      = batch_from_boxes(boxes);
+    const uint32_t        word_count = (count + CULL_MASK_WORD_BITS - 1) / CULL_MASK_WORD_BITS;
+    std::vector<uint32_t> mask(word_count);
+    std::vector<uint8_t>  last_plane(count, 0);
+    std::vector<uint8_t>  scalar_mask(count);
+
+    double scalar_ms = best_ms(repeat, [&]() {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            dw::AABB aabb;
+
+            aabb.min = glm::vec3(boxes.center[0][i] - boxes.extent[0][i], boxes.center[1][i] - boxes.extent[1][i], boxes.center[2][i] - boxes.extent[2][i]);
+            aabb.max = glm::vec3(boxes.center[0][i] + boxes.extent[0][i], boxes.center[1][i] + boxes.extent[1][i], boxes.center[2][i] + boxes.extent[2][i]);
+
+            scalar_mask[i] = dw::intersects(frustum, aabb);
+        }
+    });
+
+    double batch_ms = best_ms(repeat, [&]() { dw::cull_aabbs(frustum, batch, 0, count, mask.data()); });
+
+    // The first frame fills in the rejecting planes, every later one starts from them.
+    dw::cull_aabbs(frustum, batch, 0, count, mask.data(), last_plane.data());
+
+    double coherent_ms = best_ms(repeat, [&]() { dw::cull_aabbs(frustum, batch, 0, count, mask.data(), last_plane.data()); });
+
+    dw::jobs::initialize(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    const uint32_t job_count = (count + BENCHMARK_JOB_BOX_COUNT - 1) / BENCHMARK_JOB_BOX_COUNT;
+
+    double parallel_ms = best_ms(repeat, [&]() {
+        dw::jobs::parallel_for(job_count, 1, [&](uint32_t begin, uint32_t end) {
+            uint32_t first = begin * BENCHMARK_JOB_BOX_COUNT;
+
+            dw::cull_aabbs(frustum, batch, first, std::min(end * BENCHMARK_JOB_BOX_COUNT, count) - first, mask.data(), last_plane.data());
+        });
+    });
+
+    uint32_t workers = dw::jobs::worker_count();
+
+    dw::jobs::shutdown();
+
+    uint32_t visible    = 0;
+    uint32_t mismatches = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bool culled_visible = (mask[i / CULL_MASK_WORD_BITS] >> (i % CULL_MASK_WORD_BITS)) & 1;
+
+        visible += culled_visible ? 1 : 0;
+        mismatches += culled_visible != box_visible(frustum, boxes, i) ? 1 : 0;
+    }
+
+    DW_LOG_INFO(std::to_string(count) + " boxes, " + std::to_string(visible) + " visible, best of " + std::to_string(repeat));
+    log_rate("intersects(): ", count, scalar_ms);
+    log_rate("cull_aabbs(): ", count, batch_ms);
+    log_rate("coherent:     ", count, coherent_ms);
+    log_rate("parallel:     ", count, parallel_ms);
+    DW_LOG_INFO("  (parallel over " + std::to_string(workers) + " workers, coherent)");
+
+    if (mismatches > 0)
+        DW_LOG_ERROR(std::to_string(mismatches) + " boxes differ from the scalar test");
+
+    dw::logger::close_console_stream();
+
+    return mismatches > 0 ? 1 : 0;
+}
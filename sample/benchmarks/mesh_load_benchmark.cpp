@@ -0,0 +1,100 @@
+#include <application.h>
+#include <mesh.h>
+#include <utility.h>
+#include <timer.h>
+
+// Loads a mesh with the native glTF loader or with Assimp and reports the load time and the peak resident memory of the
+// process. Peak memory never goes down within a process, so each importer is measured by a run of its own. Materials are
+// not loaded, so that texture decoding, which both importers share, does not hide the difference.
+//
+// Usage: mesh_load_benchmark <mesh> [native|assimp] [repeat count]
+
+#define BENCHMARK_DEFAULT_REPEAT_COUNT 5
+
+class MeshLoadBenchmark : public dw::Application
+{
+protected:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool init(int argc, const char* argv[]) override
+    {
+        if (argc < 2)
+        {
+            DW_LOG_ERROR("Usage: mesh_load_benchmark <mesh> [native|assimp] [repeat count]");
+            return false;
+        }
+
+        std::string path     = argv[1];
+        bool        native   = argc < 3 || std::string(argv[2]) != "assimp";
+        int         repeat   = argc < 4 ? BENCHMARK_DEFAULT_REPEAT_COUNT : std::max(atoi(argv[3]), 1);
+        size_t      base_rss = dw::utility::peak_resident_memory();
+
+        dw::Mesh::set_native_gltf_loader(native);
+
+        Timer  timer;
+        double total_ms = 0.0;
+        double best_ms  = 0.0;
+
+        for (int i = 0; i < repeat; i++)
+        {
+            timer.start();
+
+            // Dropped at the end of each iteration, so that the next load does not come from the cache of loaded meshes.
+            dw::Mesh::Ptr mesh = dw::Mesh::load(
+#if defined(DWSF_VULKAN)
+                m_vk_backend,
+#endif
+                path,
+                false);
+
+            double ms = timer.elapsed_time_milisec();
+
+            if (!mesh)
+            {
+                DW_LOG_ERROR("Failed to load " + path);
+                return false;
+            }
+
+            total_ms += ms;
+            best_ms = i == 0 ? ms : std::min(best_ms, ms);
+
+            if (i == 0)
+                DW_LOG_INFO(std::to_string(mesh->vertices().size()) + " vertices, " + std::to_string(mesh->indices().size() / 3) + " triangles, " + std::to_string(mesh->sub_meshes().size()) + " sub meshes");
+        }
+
+        size_t peak_rss = dw::utility::peak_resident_memory();
+
+        DW_LOG_INFO(std::string(native ? "Native glTF loader" : "Assimp") + ", " + path + " loaded " + std::to_string(repeat) + " times");
+        DW_LOG_INFO("  load: " + std::to_string(total_ms / repeat) + " ms average, " + std::to_string(best_ms) + " ms best");
+        DW_LOG_INFO("  peak RSS: " + std::to_string(peak_rss / (1024 * 1024)) + " MB, " + std::to_string((peak_rss - base_rss) / (1024 * 1024)) + " MB above startup");
+
+        // Nothing is rendered.
+        request_exit();
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update(double delta) override {}
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void shutdown() override {}
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    dw::AppSettings intial_app_settings() override
+    {
+        dw::AppSettings settings;
+
+        settings.title    = "Mesh Load Benchmark";
+        settings.headless = true;
+
+        return settings;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+};
+
+DW_DECLARE_MAIN(MeshLoadBenchmark)
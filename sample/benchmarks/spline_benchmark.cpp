@@ -0,0 +1,126 @@
+#include <demo_player.h>
+#include <logger.h>
+#include <timer.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Compares constant-velocity evaluation of a camera path through the arc-length table of CubicSpline against solving for
+// the curve parameter by integrating the arc length from the start of the path, which is what every evaluation did before
+// the table existed. The path winds through a thousand points, and is sampled evenly along its whole length.
+//
+// Usage: spline_benchmark [point count] [sample count]
+
+#define BENCHMARK_DEFAULT_POINT_COUNT 1000
+#define BENCHMARK_DEFAULT_SAMPLE_COUNT 10000
+#define BENCHMARK_SPEED 10.0f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The per-evaluation solve that the table replaced: bisection followed by Newton iterations on simpsons_rule(0, t).
+static glm::vec3 integrated_const_velocity_spline_at_time(dw::CubicSpline& spline, float t, float speed)
+{
+    float desired_distance = fmod(t * speed, spline.total_length());
+    float t_max            = float(spline.m_points.size());
+    float t_min            = -0.1f;
+
+    auto g = [&spline, desired_distance](float t) -> float {
+        return spline.simpsons_rule(0, t) - desired_distance;
+    };
+
+    while (t_max - t_min > 0.5f)
+    {
+        float t_mid = (t_max + t_min) / 2;
+
+        if (g(t_min) * g(t_mid) < 0)
+            t_max = t_mid;
+        else
+            t_min = t_mid;
+    }
+
+    float t_next = (t_max + t_min) / 2;
+    float t_last = t_next;
+
+    do
+    {
+        t_last = t_next;
+        t_next = t_last - g(t_last) / spline.arc_length_integrand(t_last);
+    } while (fabs(t_last - t_next) > 0.001f);
+
+    return spline.spline_at_time(t_next);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    uint32_t point_count  = argc < 2 ? BENCHMARK_DEFAULT_POINT_COUNT : std::max(atoi(argv[1]), 4);
+    uint32_t sample_count = argc < 3 ? BENCHMARK_DEFAULT_SAMPLE_COUNT : std::max(atoi(argv[2]), 1);
+
+    std::vector<glm::vec3> points(point_count);
+
+    // Uneven spacing, so that the curve parameter and the distance travelled are far from proportional.
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        float a   = float(i) * 0.35f;
+        points[i] = glm::vec3(a * 12.0f + sinf(a * 3.1f) * 9.0f, sinf(a * 0.7f) * 25.0f, cosf(a * 1.3f) * 40.0f);
+    }
+
+    dw::CubicSpline spline;
+
+    Timer timer;
+    timer.start();
+
+    spline.add_points(points);
+    spline.initialize();
+
+    double initialize_ms = timer.elapsed_time_milisec();
+    float  length        = spline.total_length();
+
+    std::vector<float> times(sample_count);
+
+    for (uint32_t i = 0; i < sample_count; i++)
+        times[i] = length * float(i) / float(sample_count) / BENCHMARK_SPEED;
+
+    std::vector<glm::vec3> integrated(sample_count);
+    std::vector<glm::vec3> single(sample_count);
+    std::vector<glm::vec3> batched(sample_count);
+
+    timer.start();
+
+    for (uint32_t i = 0; i < sample_count; i++)
+        integrated[i] = integrated_const_velocity_spline_at_time(spline, times[i], BENCHMARK_SPEED);
+
+    double integrated_us = timer.elapsed_time_microsec();
+
+    timer.start();
+
+    for (uint32_t i = 0; i < sample_count; i++)
+        single[i] = spline.const_velocity_spline_at_time(times[i], BENCHMARK_SPEED);
+
+    double single_us = timer.elapsed_time_microsec();
+
+    timer.start();
+
+    spline.const_velocity_spline_at_times(times.data(), sample_count, BENCHMARK_SPEED, batched.data());
+
+    double batched_us = timer.elapsed_time_microsec();
+
+    float max_deviation = 0.0f;
+
+    for (uint32_t i = 0; i < sample_count; i++)
+        max_deviation = std::max(max_deviation, std::max(glm::length(single[i] - integrated[i]), glm::length(batched[i] - integrated[i])));
+
+    DW_LOG_INFO(std::to_string(point_count) + " points, length " + std::to_string(length) + ", table built in " + std::to_string(initialize_ms) + " ms");
+    DW_LOG_INFO("  integrated: " + std::to_string(integrated_us / sample_count) + " us per evaluation");
+    DW_LOG_INFO("  table:      " + std::to_string(single_us / sample_count) + " us per evaluation");
+    DW_LOG_INFO("  batched:    " + std::to_string(batched_us / sample_count) + " us per evaluation");
+    DW_LOG_INFO("  max distance from the integrated positions: " + std::to_string(max_deviation));
+
+    dw::logger::close_console_stream();
+
+    return 0;
+}
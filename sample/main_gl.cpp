@@ -6,59 +6,6 @@
 #include <profiler.h>
 #include <assimp/scene.h>
 
-// Embedded vertex shader source.
-const char* g_sample_vs_src = R"(
-layout (location = 0) in vec4 VS_IN_Position;
-layout (location = 1) in vec4 VS_IN_TexCoord;
-layout (location = 2) in vec4 VS_IN_Normal;
-layout (location = 3) in vec4 VS_IN_Tangent;
-layout (location = 4) in vec4 VS_IN_Bitangent;
-layout (std140) uniform Transforms //#binding 0
-{ 
-	mat4 model;
-	mat4 view;
-	mat4 projection;
-};
-out vec3 PS_IN_FragPos;
-out vec3 PS_IN_Normal;
-out vec2 PS_IN_TexCoord;
-void main()
-{
-    vec4 position = model * vec4(VS_IN_Position.xyz, 1.0);
-	PS_IN_FragPos = position.xyz;
-	PS_IN_Normal = mat3(model) * VS_IN_Normal.xyz;
-	PS_IN_TexCoord = VS_IN_TexCoord.xy;
-    gl_Position = projection * view * position;
-}
-)";
-
-// Embedded fragment shader source.
-const char* g_sample_fs_src = R"(
-precision mediump float;
-out vec4 PS_OUT_Color;
-in vec3 PS_IN_FragPos;
-in vec3 PS_IN_Normal;
-in vec2 PS_IN_TexCoord;
-uniform sampler2D s_Diffuse; //#slot 0
-void main()
-{
-	vec3 light_pos = vec3(-200.0, 200.0, 0.0);
-	vec3 n = normalize(PS_IN_Normal);
-	vec3 l = normalize(light_pos - PS_IN_FragPos);
-	float lambert = max(0.0f, dot(n, l));
-    vec3 diffuse = texture(s_Diffuse, PS_IN_TexCoord).xyz;// + vec3(1.0);
-	vec3 ambient = diffuse * 0.03;
-	vec3 color = diffuse * lambert + ambient;
-
-    // HDR tonemapping
-    color = color / (color + vec3(1.0));
-    // gamma correct
-    color = pow(color, vec3(1.0 / 2.2));
-
-    PS_OUT_Color = vec4(color, 1.0);
-}
-)";
-
 // Uniform buffer data structure.
 struct Transforms
 {
@@ -153,9 +100,17 @@ private:
 
     bool create_shaders()
     {
+        // The material table needs the base instance of each draw in the vertex shader, which carries the material id.
+        m_material_table = dw::Material::is_bindless_supported() && GLAD_GL_ARB_shader_draw_parameters;
+
+        std::vector<std::string> defines;
+
+        if (m_material_table)
+            defines.push_back("MATERIAL_TABLE");
+
         // Create shaders
-        m_vs = dw::gl::Shader::create(GL_VERTEX_SHADER, g_sample_vs_src);
-        m_fs = dw::gl::Shader::create(GL_FRAGMENT_SHADER, g_sample_fs_src);
+        m_vs = dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shaders/mesh.vert", defines);
+        m_fs = dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shaders/mesh.frag", defines);
 
         if (!m_vs || !m_fs)
         {
@@ -172,8 +127,6 @@ private:
             return false;
         }
 
-        m_program->uniform_block_binding("Transforms", 0);
-
         return true;
     }
 
@@ -200,7 +153,14 @@ private:
     bool load_mesh()
     {
         m_mesh = dw::Mesh::load("teapot.obj");
-        return m_mesh != nullptr;
+
+        if (!m_mesh)
+            return false;
+
+        // Makes the texture handles of the new materials resident.
+        dw::Material::update_material_table();
+
+        return true;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -234,8 +194,11 @@ private:
         // Bind vertex array.
         m_mesh->mesh_vertex_array()->bind();
 
-        // Set active texture unit uniform
-        m_program->set_uniform("s_Diffuse", 0);
+        // Bind the material table, or set the active texture unit uniform.
+        if (m_material_table)
+            dw::Material::material_table()->bind_base(GL_SHADER_STORAGE_BUFFER, 1);
+        else
+            m_program->set_uniform("s_Diffuse", 0);
 
         const auto& submeshes = m_mesh->sub_meshes();
 
@@ -244,13 +207,18 @@ private:
             auto& submesh = submeshes[i];
             auto& mat     = m_mesh->material(submesh.mat_idx);
 
-            // Bind texture.
-            if (mat->albedo_texture())
-                mat->albedo_texture()->bind(0);
-
-            // Issue draw call.
-            glDrawElementsBaseVertex(
-                GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
+            // Issue draw call. With the material table, the material id goes in as the base instance and nothing is bound.
+            if (m_material_table)
+                glDrawElementsInstancedBaseVertexBaseInstance(
+                    GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), 1, submesh.base_vertex, mat->id());
+            else
+            {
+                if (mat->albedo_texture())
+                    mat->albedo_texture()->bind(0);
+
+                glDrawElementsBaseVertex(
+                    GL_TRIANGLES, submesh.index_count, GL_UNSIGNED_INT, (void*)(sizeof(unsigned int) * submesh.base_index), submesh.base_vertex);
+            }
         }
     }
 
@@ -280,6 +248,7 @@ private:
     dw::gl::Shader::Ptr  m_fs;
     dw::gl::Program::Ptr m_program;
     dw::gl::Buffer::Ptr  m_ubo;
+    bool                 m_material_table = false;
 
     // Camera.
     std::unique_ptr<dw::Camera> m_main_camera;
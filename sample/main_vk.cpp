@@ -4,9 +4,16 @@
 #include <mesh.h>
 #include <vk.h>
 #include <profiler.h>
+#include <hosek_wilkie_sky_model.h>
+#include <cubemap_prefilter.h>
 #include <assimp/scene.h>
 #include <vk_mem_alloc.h>
 
+// The sky is filtered on the asynchronous compute queue, where the filtering of one frame overlaps the raster pass of the
+// same frame, and sampled by the teapot one frame later. With --inline-compute the same work runs on the graphics queue
+// instead. Either way the time the graphics queue takes per frame is logged on exit, along with the compute time and the
+// overlap of the two queues when asynchronous, so that runs of both modes can be compared.
+
 // Uniform buffer data structure.
 struct Transforms
 {
@@ -25,6 +32,17 @@ protected:
 
     bool init(int argc, const char* argv[]) override
     {
+        bool inline_compute = false;
+
+        for (int i = 1; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--inline-compute")
+                inline_compute = true;
+        }
+
+        if (!inline_compute)
+            m_async_compute = dw::vk::AsyncCompute::create(m_vk_backend);
+
         // Create GPU resources.
         if (!create_shaders())
             return false;
@@ -36,6 +54,7 @@ protected:
         if (!load_mesh())
             return false;
 
+        create_environment();
         create_descriptor_set_layout();
         create_descriptor_set();
         write_descriptor_set();
@@ -51,14 +70,40 @@ protected:
 
     void update(double delta) override
     {
-        dw::vk::CommandBuffer::Ptr cmd_buf = m_vk_backend->allocate_graphics_command_buffer();
+        // Written this frame and sampled by the next one.
+        const uint32_t write_idx = m_environment_frame % 2;
+        const uint32_t read_idx  = 1 - write_idx;
+
+        read_frame_timing();
+
+        dw::vk::CommandBuffer::Ptr environment_cmd_buf = m_vk_backend->allocate_graphics_command_buffer(true);
 
-        VkCommandBufferBeginInfo begin_info;
-        DW_ZERO_MEMORY(begin_info);
+        begin_frame_timing(environment_cmd_buf);
 
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        // The compute work of the last frame, which handed back the map sampled this frame.
+        dw::vk::TimelinePoint environment_point = m_async_compute ? m_async_compute->last_point() : dw::vk::TimelinePoint();
 
-        vkBeginCommandBuffer(cmd_buf->handle(), &begin_info);
+        if (m_async_compute)
+            update_environment_async(environment_cmd_buf, write_idx);
+        else
+            update_environment_inline(environment_cmd_buf, write_idx);
+
+        dw::vk::CommandBuffer::Ptr cmd_buf = m_vk_backend->allocate_graphics_command_buffer(true);
+
+        std::vector<dw::vk::TimelinePoint> wait_points;
+
+        if (m_async_compute)
+        {
+            // Only the fragment shader, which samples the map, waits for it.
+            if (m_environment_frame > 0)
+            {
+                environment_point.stage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+                wait_points.push_back(environment_point);
+            }
+
+            m_prefilter[read_idx]->acquire(cmd_buf);
+            m_async_compute->begin_graphics_timing(cmd_buf);
+        }
 
         {
             DW_SCOPED_SAMPLE("update", cmd_buf);
@@ -73,18 +118,35 @@ protected:
             update_uniforms(cmd_buf);
 
             // Render.
-            render(cmd_buf);
+            render(cmd_buf, read_idx);
         }
 
+        if (m_async_compute)
+            m_async_compute->end_graphics_timing(cmd_buf);
+
+        end_frame_timing(cmd_buf);
+
         vkEndCommandBuffer(cmd_buf->handle());
 
-        submit_and_present({ cmd_buf });
+        submit_and_present({ cmd_buf }, wait_points);
+
+        m_environment_frame++;
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
     void shutdown() override
     {
+        log_timings();
+
+        m_async_compute.reset();
+        m_environment_ds[0].reset();
+        m_environment_ds[1].reset();
+        m_environment_ds_layout.reset();
+        m_prefilter[0].reset();
+        m_prefilter[1].reset();
+        m_sky.reset();
+        m_frame_queries.reset();
         m_mesh.reset();
         m_pso.reset();
         m_pipeline_layout.reset();
@@ -145,6 +207,12 @@ private:
         desc.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_VERTEX_BIT);
 
         m_per_frame_ds_layout = dw::vk::DescriptorSetLayout::create(m_vk_backend, desc);
+
+        dw::vk::DescriptorSetLayout::Desc environment_desc;
+
+        environment_desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+        m_environment_ds_layout = dw::vk::DescriptorSetLayout::create(m_vk_backend, environment_desc);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -152,6 +220,9 @@ private:
     void create_descriptor_set()
     {
         m_per_frame_ds = m_vk_backend->allocate_descriptor_set(m_per_frame_ds_layout);
+
+        for (uint32_t i = 0; i < 2; i++)
+            m_environment_ds[i] = m_vk_backend->allocate_descriptor_set(m_environment_ds_layout);
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -175,6 +246,26 @@ private:
         write_data.dstSet          = m_per_frame_ds->handle();
 
         vkUpdateDescriptorSets(m_vk_backend->device(), 1, &write_data, 0, nullptr);
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            VkDescriptorImageInfo image_info;
+
+            image_info.sampler     = dw::Material::common_sampler()->handle();
+            image_info.imageView   = m_prefilter[i]->image_view()->handle();
+            image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+            DW_ZERO_MEMORY(write_data);
+
+            write_data.sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write_data.descriptorCount = 1;
+            write_data.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            write_data.pImageInfo      = &image_info;
+            write_data.dstBinding      = 0;
+            write_data.dstSet          = m_environment_ds[i]->handle();
+
+            vkUpdateDescriptorSets(m_vk_backend->device(), 1, &write_data, 0, nullptr);
+        }
     }
 
     // -----------------------------------------------------------------------------------------------------------------------------------
@@ -287,7 +378,8 @@ private:
         dw::vk::PipelineLayout::Desc pl_desc;
 
         pl_desc.add_descriptor_set_layout(m_per_frame_ds_layout)
-            .add_descriptor_set_layout(dw::Material::descriptor_set_layout());
+            .add_descriptor_set_layout(dw::Material::descriptor_set_layout())
+            .add_descriptor_set_layout(m_environment_ds_layout);
 
         m_pipeline_layout = dw::vk::PipelineLayout::create(m_vk_backend, pl_desc);
 
@@ -327,7 +419,180 @@ private:
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void render(dw::vk::CommandBuffer::Ptr cmd_buf)
+    void create_environment()
+    {
+        m_sky = std::make_unique<dw::HosekWilkieSkyModel>(m_vk_backend);
+
+        for (uint32_t i = 0; i < 2; i++)
+            m_prefilter[i] = std::make_unique<dw::CubemapPrefiler>(m_vk_backend, m_sky->image());
+
+        m_frame_queries = dw::vk::QueryPool::create(m_vk_backend, VK_QUERY_TYPE_TIMESTAMP, 2 * dw::vk::Backend::kMaxFramesInFlight);
+
+        // Both maps hold the sky before the first frame samples one of them.
+        dw::vk::CommandBuffer::Ptr cmd_buf = m_vk_backend->allocate_graphics_command_buffer(true);
+
+        m_sky->update(cmd_buf, sun_direction());
+        m_sky->image()->generate_mipmaps(cmd_buf);
+
+        for (uint32_t i = 0; i < 2; i++)
+            m_prefilter[i]->update(cmd_buf);
+
+        vkEndCommandBuffer(cmd_buf->handle());
+
+        m_vk_backend->flush_graphics({ cmd_buf });
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    glm::vec3 sun_direction()
+    {
+        float angle = float(glfwGetTime()) * 0.1f;
+
+        return glm::normalize(glm::vec3(cos(angle), 0.5f, sin(angle)));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render_sky(dw::vk::CommandBuffer::Ptr cmd_buf)
+    {
+        DW_SCOPED_SAMPLE("sky", cmd_buf);
+
+        m_sky->update(cmd_buf, sun_direction());
+        m_sky->image()->generate_mipmaps(cmd_buf);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // The sky is rendered on graphics and filtered on compute, which hands it back for the next frame to render into.
+    void update_environment_async(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t write_idx)
+    {
+        VkImageSubresourceRange sky_range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_sky->image()->mip_levels(), 0, 6 };
+
+        m_vk_backend->acquire_resource(dw::vk::QUEUE_TYPE_GRAPHICS, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_sky->image(), sky_range);
+        m_vk_backend->flush_barriers(cmd_buf);
+
+        render_sky(cmd_buf);
+
+        m_vk_backend->release_resource(dw::vk::QUEUE_TYPE_GRAPHICS, dw::vk::QUEUE_TYPE_COMPUTE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_sky->image(), sky_range);
+        m_vk_backend->flush_barriers(cmd_buf);
+
+        m_prefilter[write_idx]->release(cmd_buf);
+
+        vkEndCommandBuffer(cmd_buf->handle());
+
+        std::vector<dw::vk::TimelinePoint> wait_points;
+
+        // Rendering into the sky waits until the last frame's filtering is done reading it.
+        if (m_environment_frame > 0)
+        {
+            dw::vk::TimelinePoint point = m_async_compute->last_point();
+
+            point.stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+            wait_points.push_back(point);
+        }
+
+        dw::vk::TimelinePoint sky_point = m_vk_backend->submit_graphics({ cmd_buf }, wait_points);
+
+        sky_point.stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+
+        dw::vk::CommandBuffer::Ptr compute_cmd_buf = m_async_compute->begin();
+
+        m_vk_backend->acquire_resource(dw::vk::QUEUE_TYPE_COMPUTE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_sky->image(), sky_range);
+        m_vk_backend->flush_barriers(compute_cmd_buf);
+
+        m_prefilter[write_idx]->update(m_async_compute);
+
+        m_vk_backend->release_resource(dw::vk::QUEUE_TYPE_COMPUTE, dw::vk::QUEUE_TYPE_GRAPHICS, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, m_sky->image(), sky_range);
+        m_vk_backend->flush_barriers(compute_cmd_buf);
+
+        m_async_compute->submit({ sky_point });
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update_environment_inline(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t write_idx)
+    {
+        render_sky(cmd_buf);
+
+        {
+            DW_SCOPED_SAMPLE("prefilter", cmd_buf);
+            m_prefilter[write_idx]->update(cmd_buf);
+        }
+
+        vkEndCommandBuffer(cmd_buf->handle());
+
+        m_vk_backend->submit_graphics({ cmd_buf });
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_frame_timing(dw::vk::CommandBuffer::Ptr cmd_buf)
+    {
+        const uint32_t slot = m_environment_frame % dw::vk::Backend::kMaxFramesInFlight;
+
+        vkCmdResetQueryPool(cmd_buf->handle(), m_frame_queries->handle(), 2 * slot, 2);
+        vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_frame_queries->handle(), 2 * slot);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void end_frame_timing(dw::vk::CommandBuffer::Ptr cmd_buf)
+    {
+        const uint32_t slot = m_environment_frame % dw::vk::Backend::kMaxFramesInFlight;
+
+        vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_frame_queries->handle(), 2 * slot + 1);
+
+        m_frame_timed[slot] = true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Reads the timings of the frame that last used the slot this one is about to reuse.
+    void read_frame_timing()
+    {
+        const uint32_t slot = m_environment_frame % dw::vk::Backend::kMaxFramesInFlight;
+
+        uint64_t timestamps[2];
+
+        if (m_frame_timed[slot] && vkGetQueryPoolResults(m_vk_backend->device(), m_frame_queries->handle(), 2 * slot, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+        {
+            m_frame_ms_sum += double(timestamps[1] - timestamps[0]) * m_vk_backend->physical_device_properties().limits.timestampPeriod / 1000000.0;
+            m_frame_ms_count++;
+        }
+
+        m_frame_timed[slot] = false;
+
+        if (m_async_compute && m_async_compute->stats().valid)
+        {
+            m_compute_ms_sum += m_async_compute->stats().compute_ms;
+            m_overlap_ms_sum += m_async_compute->stats().overlap_ms;
+            m_async_stats_count++;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void log_timings()
+    {
+        if (m_frame_ms_count == 0)
+            return;
+
+        DW_LOG_INFO(std::string(m_async_compute ? "Asynchronous" : "Inline") + " environment filtering, " + std::to_string(m_frame_ms_count) + " frames");
+        DW_LOG_INFO("  graphics queue: " + std::to_string(m_frame_ms_sum / m_frame_ms_count) + " ms per frame");
+
+        if (m_async_stats_count > 0)
+        {
+            DW_LOG_INFO("  compute queue: " + std::to_string(m_compute_ms_sum / m_async_stats_count) + " ms per frame, " + std::to_string(m_overlap_ms_sum / m_async_stats_count) + " ms of it alongside the raster pass");
+
+            if (!m_async_compute->is_asynchronous())
+                DW_LOG_INFO("  the device has no separate compute family, so the queues do not run concurrently");
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void render(dw::vk::CommandBuffer::Ptr cmd_buf, uint32_t environment_idx)
     {
         DW_SCOPED_SAMPLE("render", cmd_buf);
 
@@ -379,6 +644,7 @@ private:
         const uint32_t dynamic_offset = m_ubo_size * m_vk_backend->current_frame_idx();
 
         vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout->handle(), 0, 1, &m_per_frame_ds->handle(), 1, &dynamic_offset);
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout->handle(), 2, 1, &m_environment_ds[environment_idx]->handle(), 0, nullptr);
 
         VkDeviceSize offset = 0;
         vkCmdBindVertexBuffers(cmd_buf->handle(), 0, 1, &m_mesh->vertex_buffer()->handle(), &offset);
@@ -430,6 +696,23 @@ private:
     dw::vk::DescriptorSet::Ptr       m_per_frame_ds;
     dw::vk::Buffer::Ptr              m_ubo;
 
+    // Environment.
+    std::unique_ptr<dw::HosekWilkieSkyModel> m_sky;
+    std::unique_ptr<dw::CubemapPrefiler>     m_prefilter[2];
+    dw::vk::DescriptorSetLayout::Ptr         m_environment_ds_layout;
+    dw::vk::DescriptorSet::Ptr               m_environment_ds[2];
+    dw::vk::AsyncCompute::Ptr                m_async_compute;
+    uint32_t                                 m_environment_frame = 0;
+
+    // Time the graphics queue takes per frame, from the start of the environment update to the end of the frame.
+    dw::vk::QueryPool::Ptr m_frame_queries;
+    bool                   m_frame_timed[dw::vk::Backend::kMaxFramesInFlight] = {};
+    double                 m_frame_ms_sum                                     = 0.0;
+    uint32_t               m_frame_ms_count                                   = 0;
+    double                 m_compute_ms_sum                                   = 0.0;
+    double                 m_overlap_ms_sum                                   = 0.0;
+    uint32_t               m_async_stats_count                                = 0;
+
     // Camera.
     std::unique_ptr<dw::Camera> m_main_camera;
 
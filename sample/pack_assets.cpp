@@ -0,0 +1,34 @@
+#include <logger.h>
+#include <vfs.h>
+#include <string.h>
+
+// Packs a directory of assets into an archive that applications mount through the "archives" key of config.json.
+//
+// Usage: pack_assets [--no-compression] <directory> <archive>
+int main(int argc, const char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    bool compress = true;
+    int  arg      = 1;
+
+    if (arg < argc && strcmp(argv[arg], "--no-compression") == 0)
+    {
+        compress = false;
+        arg++;
+    }
+
+    if (argc - arg != 2)
+    {
+        DW_LOG_ERROR("Usage: pack_assets [--no-compression] <directory> <archive>");
+        dw::logger::close_console_stream();
+        return 1;
+    }
+
+    bool result = dw::vfs::write_archive(argv[arg + 1], argv[arg], compress);
+
+    dw::logger::close_console_stream();
+
+    return result ? 0 : 1;
+}
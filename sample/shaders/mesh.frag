@@ -1,15 +1,55 @@
 #version 450
 
+#if !defined(VULKAN) && defined(MATERIAL_TABLE)
+#extension GL_ARB_bindless_texture : require
+#endif
+
 layout (location = 0) in vec3 FS_IN_FragPos;
 layout (location = 1) in vec2 FS_IN_Texcoord;
 layout (location = 2) in vec3 FS_IN_Normal;
+layout (location = 3) in vec3 FS_IN_CameraPos;
 
 layout (location = 0) out vec3 FS_OUT_Color;
 
+#if defined(VULKAN)
 layout (set = 1, binding = 0) uniform sampler2D s_Diffuse;
 layout (set = 1, binding = 1) uniform sampler2D s_Normal;
-layout (set = 1, binding = 2) uniform sampler2D s_Metallic;
-layout (set = 1, binding = 3) uniform sampler2D s_Roughness;
+layout (set = 1, binding = 2) uniform sampler2D s_Roughness;
+layout (set = 1, binding = 3) uniform sampler2D s_Metallic;
+
+// Prefiltered sky, one roughness per mip.
+layout (set = 2, binding = 0) uniform samplerCube s_Prefiltered;
+#elif defined(MATERIAL_TABLE)
+layout (location = 4) flat in uint FS_IN_MaterialID;
+
+// Matches dw::MaterialData. Texture handles are split into 32-bit halves, and a zero handle means there is no texture.
+struct Material
+{
+	uvec2 albedo;
+	uvec2 normal;
+	uvec2 roughness;
+	uvec2 metallic;
+	uvec2 emissive;
+	int   roughness_channel;
+	int   metallic_channel;
+	vec4  albedo_color;
+	vec4  emissive_color;
+	float roughness_value;
+	float metallic_value;
+	uint  alpha_test;
+	uint  padding;
+};
+
+layout (std430, binding = 1) readonly buffer Materials
+{
+	Material u_Materials[];
+};
+#else
+layout (binding = 0) uniform sampler2D s_Diffuse;
+#endif
+
+const float kRoughness       = 0.3;
+const float kMaxPrefilterLod = 4.0;
 
 void main()
 {
@@ -20,10 +60,29 @@ void main()
 
 	float lambert = max(0.0f, dot(n, l));
 
+#if defined(MATERIAL_TABLE)
+    Material material = u_Materials[FS_IN_MaterialID];
+
+    vec3 diffuse = material.albedo_color.xyz;
+
+    if (any(notEqual(material.albedo, uvec2(0))))
+        diffuse = texture(sampler2D(material.albedo), FS_IN_Texcoord).xyz;
+#else
     vec3 diffuse = texture(s_Diffuse, FS_IN_Texcoord).xyz;
+#endif
 	vec3 ambient = diffuse * 0.03;
 
-	vec3 color = diffuse * lambert + ambient;
+#if defined(VULKAN)
+    // Specular reflection of the sky
+    vec3 v        = normalize(FS_IN_CameraPos - FS_IN_FragPos);
+    vec3 r        = reflect(-v, n);
+    vec3 specular = textureLod(s_Prefiltered, r, kRoughness * kMaxPrefilterLod).rgb * 0.04;
+#else
+    // The OpenGL sample has no sky.
+    vec3 specular = vec3(0.0);
+#endif
+
+	vec3 color = diffuse * lambert + ambient + specular;
 
 	// HDR tonemapping
     color = color / (color + vec3(1.0));
@@ -1,5 +1,10 @@
 #version 450
 
+// The OpenGL sample also compiles this shader. MATERIAL_TABLE selects the bindless material table, see dw::MaterialData.
+#if !defined(VULKAN) && defined(MATERIAL_TABLE)
+#extension GL_ARB_shader_draw_parameters : require
+#endif
+
 layout(location = 0) in vec4 VS_IN_Position;
 layout(location = 1) in vec4 VS_IN_Texcoord;
 layout(location = 2) in vec4 VS_IN_Normal;
@@ -9,8 +14,17 @@ layout(location = 4) in vec4 VS_IN_Bitangent;
 layout (location = 0) out vec3 FS_IN_FragPos;
 layout (location = 1) out vec2 FS_IN_Texcoord;
 layout (location = 2) out vec3 FS_IN_Normal;
+layout (location = 3) out vec3 FS_IN_CameraPos;
+
+#if defined(MATERIAL_TABLE)
+layout (location = 4) flat out uint FS_IN_MaterialID;
+#endif
 
+#if defined(VULKAN)
 layout (set = 0, binding = 0) uniform PerFrameUBO 
+#else
+layout (std140, binding = 0) uniform PerFrameUBO
+#endif
 {
 	mat4 model;
 	mat4 view;
@@ -39,4 +53,12 @@ void main()
     mat3 normal_mat = mat3(ubo.model);
 
 	FS_IN_Normal = normal_mat * VS_IN_Normal.xyz;
+
+    // The view matrix is rigid, so its inverse holds the camera position
+    FS_IN_CameraPos = inverse(ubo.view)[3].xyz;
+
+#if defined(MATERIAL_TABLE)
+    // Draws pass their material id as the base instance, so that a multi draw can select one per draw
+    FS_IN_MaterialID = uint(gl_BaseInstanceARB);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "test.h"
+#include <equirectangular_to_cubemap.h>
+#include <jobs.h>
+#include <logger.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// Runs the CPU conversion of EquirectangularToCubemap, which needs no GPU. A smooth analytic environment is converted and
+// every texel is compared against the environment along the direction the cubemap samplers assign to it, which catches
+// faces that are swapped, mirrored or rotated. A source of one-texel stripes then checks that the importance filter
+// averages over the texels it covers, against a supersampled reference, where a single bilinear sample aliases.
+//
+// Usage: equirectangular_to_cubemap_test
+
+#define TEST_SOURCE_WIDTH 512
+#define TEST_SOURCE_HEIGHT 256
+#define TEST_FACE_SIZE 32
+#define TEST_TOLERANCE 1e-3f
+#define TEST_STRIPES_WIDTH 2048
+#define TEST_STRIPES_HEIGHT 1024
+#define TEST_STRIPES_FACE_SIZE 16
+#define TEST_REFERENCE_SAMPLES 32
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Direction through (s, t) of a face, from the face selection table of the cubemap samplers. Written out independently of
+// the conversion, so that both have to agree with the samplers.
+static glm::vec3 face_direction(uint32_t face, float s, float t)
+{
+    switch (face)
+    {
+        case 0: return glm::vec3(1.0f, -t, -s);
+        case 1: return glm::vec3(-1.0f, -t, s);
+        case 2: return glm::vec3(s, 1.0f, t);
+        case 3: return glm::vec3(s, -1.0f, -t);
+        case 4: return glm::vec3(s, -t, 1.0f);
+        default: return glm::vec3(-s, -t, -1.0f);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Different along every axis and in both directions of it, so that no two faces look alike.
+static glm::vec3 environment(const glm::vec3& direction)
+{
+    glm::vec3 d = glm::normalize(direction);
+
+    return glm::vec3(0.5f + 0.5f * d.x, 0.5f + 0.3f * d.y * d.y + 0.2f * d.y, 1.0f + 0.5f * d.z);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Rows run from the bottom of the sphere to the top, as the conversion expects.
+static std::vector<float> analytic_source(uint32_t components)
+{
+    std::vector<float> pixels(TEST_SOURCE_WIDTH * TEST_SOURCE_HEIGHT * components, 1.0f);
+
+    for (uint32_t y = 0; y < TEST_SOURCE_HEIGHT; y++)
+    {
+        for (uint32_t x = 0; x < TEST_SOURCE_WIDTH; x++)
+        {
+            float longitude = ((x + 0.5f) / TEST_SOURCE_WIDTH - 0.5f) * 2.0f * float(M_PI);
+            float latitude  = ((y + 0.5f) / TEST_SOURCE_HEIGHT - 0.5f) * float(M_PI);
+
+            glm::vec3 color = environment(glm::vec3(cosf(latitude) * cosf(longitude), sinf(latitude), cosf(latitude) * sinf(longitude)));
+            float*    dst   = &pixels[(y * TEST_SOURCE_WIDTH + x) * components];
+
+            dst[0] = color.x;
+            dst[1] = color.y;
+            dst[2] = color.z;
+        }
+    }
+
+    return pixels;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool faces_match_environment(const std::vector<float>& faces)
+{
+    float max_error = 0.0f;
+    float alpha     = 1.0f;
+
+    for (uint32_t face = 0; face < 6; face++)
+    {
+        for (uint32_t y = 0; y < TEST_FACE_SIZE; y++)
+        {
+            for (uint32_t x = 0; x < TEST_FACE_SIZE; x++)
+            {
+                float        s        = (x + 0.5f) / TEST_FACE_SIZE * 2.0f - 1.0f;
+                float        t        = (y + 0.5f) / TEST_FACE_SIZE * 2.0f - 1.0f;
+                glm::vec3    expected = environment(face_direction(face, s, t));
+                const float* texel    = &faces[((face * TEST_FACE_SIZE + y) * TEST_FACE_SIZE + x) * 4];
+
+                for (uint32_t c = 0; c < 3; c++)
+                    max_error = std::max(max_error, fabsf(texel[c] - expected[c]));
+
+                alpha = std::min(alpha, texel[3]);
+            }
+        }
+    }
+
+    DW_LOG_INFO("Analytic environment: largest error " + std::to_string(max_error));
+
+    return check(max_error < TEST_TOLERANCE, "A face does not match the environment along its directions") &&
+           check(alpha == 1.0f, "A texel has an alpha other than 1");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float stripe(const std::vector<float>& pixels, int32_t x, int32_t y)
+{
+    x = (x % TEST_STRIPES_WIDTH + TEST_STRIPES_WIDTH) % TEST_STRIPES_WIDTH;
+    y = std::min(std::max(y, 0), TEST_STRIPES_HEIGHT - 1);
+
+    return pixels[(y * TEST_STRIPES_WIDTH + x) * 3];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Mean of the source over a texel, from bilinear samples on a regular grid weighted by their solid angle.
+static float reference_texel(const std::vector<float>& pixels, uint32_t face, uint32_t x, uint32_t y)
+{
+    double sum          = 0.0;
+    double total_weight = 0.0;
+
+    for (uint32_t j = 0; j < TEST_REFERENCE_SAMPLES; j++)
+    {
+        for (uint32_t i = 0; i < TEST_REFERENCE_SAMPLES; i++)
+        {
+            double    s = (x + (i + 0.5) / TEST_REFERENCE_SAMPLES) / TEST_STRIPES_FACE_SIZE * 2.0 - 1.0;
+            double    t = (y + (j + 0.5) / TEST_REFERENCE_SAMPLES) / TEST_STRIPES_FACE_SIZE * 2.0 - 1.0;
+            glm::vec3 d = face_direction(face, float(s), float(t));
+
+            double u = (atan2(d.z, d.x) / (2.0 * M_PI) + 0.5) * TEST_STRIPES_WIDTH - 0.5;
+            double v = (atan2(d.y, sqrt(d.x * d.x + d.z * d.z)) / M_PI + 0.5) * TEST_STRIPES_HEIGHT - 0.5;
+
+            int32_t x0 = int32_t(floor(u));
+            int32_t y0 = int32_t(floor(v));
+            double  fx = u - x0;
+            double  fy = v - y0;
+
+            double value = (1.0 - fx) * (1.0 - fy) * stripe(pixels, x0, y0) + fx * (1.0 - fy) * stripe(pixels, x0 + 1, y0) +
+                           (1.0 - fx) * fy * stripe(pixels, x0, y0 + 1) + fx * fy * stripe(pixels, x0 + 1, y0 + 1);
+
+            double r2     = 1.0 + s * s + t * t;
+            double weight = 1.0 / (r2 * sqrt(r2));
+
+            sum += weight * value;
+            total_weight += weight;
+        }
+    }
+
+    return float(sum / total_weight);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool importance_filter_averages_stripes()
+{
+    // Grey, alternating between 0 and 4 from one column to the next.
+    std::vector<float> pixels(TEST_STRIPES_WIDTH * TEST_STRIPES_HEIGHT * 3);
+
+    for (uint32_t i = 0; i < pixels.size(); i++)
+        pixels[i] = (i / 3 % TEST_STRIPES_WIDTH) % 2 ? 4.0f : 0.0f;
+
+    const uint32_t     texel_count = TEST_STRIPES_FACE_SIZE * TEST_STRIPES_FACE_SIZE * 6;
+    std::vector<float> bilinear(texel_count * 4);
+    std::vector<float> importance(texel_count * 4);
+
+    dw::EquirectangularToCubemap::convert(pixels.data(), TEST_STRIPES_WIDTH, TEST_STRIPES_HEIGHT, 3, TEST_STRIPES_FACE_SIZE, bilinear.data(), dw::EQUIRECTANGULAR_FILTER_BILINEAR);
+    dw::EquirectangularToCubemap::convert(pixels.data(), TEST_STRIPES_WIDTH, TEST_STRIPES_HEIGHT, 3, TEST_STRIPES_FACE_SIZE, importance.data(), dw::EQUIRECTANGULAR_FILTER_IMPORTANCE);
+
+    double bilinear_error   = 0.0;
+    double importance_error = 0.0;
+
+    for (uint32_t face = 0; face < 6; face++)
+    {
+        for (uint32_t y = 0; y < TEST_STRIPES_FACE_SIZE; y++)
+        {
+            for (uint32_t x = 0; x < TEST_STRIPES_FACE_SIZE; x++)
+            {
+                float  reference = reference_texel(pixels, face, x, y);
+                size_t offset    = ((face * TEST_STRIPES_FACE_SIZE + y) * TEST_STRIPES_FACE_SIZE + x) * 4;
+
+                bilinear_error += fabs(bilinear[offset] - reference);
+                importance_error += fabs(importance[offset] - reference);
+            }
+        }
+    }
+
+    bilinear_error /= texel_count;
+    importance_error /= texel_count;
+
+    DW_LOG_INFO("Stripes: mean error " + std::to_string(bilinear_error) + " bilinear, " + std::to_string(importance_error) + " importance");
+
+    return check(importance_error < 0.5 * bilinear_error, "The importance filter does not average the stripes better than a bilinear sample");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    dw::jobs::initialize(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    const uint32_t     face_floats = TEST_FACE_SIZE * TEST_FACE_SIZE * 4;
+    std::vector<float> rgba_source = analytic_source(4);
+    std::vector<float> rgb_source  = analytic_source(3);
+    std::vector<float> rgba_faces(face_floats * 6);
+    std::vector<float> rgb_faces(face_floats * 6);
+    std::vector<float> importance_faces(face_floats * 6);
+
+    dw::EquirectangularToCubemap::convert(rgba_source.data(), TEST_SOURCE_WIDTH, TEST_SOURCE_HEIGHT, 4, TEST_FACE_SIZE, rgba_faces.data());
+    dw::EquirectangularToCubemap::convert(rgb_source.data(), TEST_SOURCE_WIDTH, TEST_SOURCE_HEIGHT, 3, TEST_FACE_SIZE, rgb_faces.data());
+    dw::EquirectangularToCubemap::convert(rgba_source.data(), TEST_SOURCE_WIDTH, TEST_SOURCE_HEIGHT, 4, TEST_FACE_SIZE, importance_faces.data(), dw::EQUIRECTANGULAR_FILTER_IMPORTANCE);
+
+    // A smooth environment looks the same through either filter, so the importance filter must not move or blur it.
+    bool passed = faces_match_environment(rgba_faces) &&
+                  check(rgb_faces == rgba_faces, "Three and four component sources convert differently") &&
+                  faces_match_environment(importance_faces) &&
+                  importance_filter_averages_stripes();
+
+    int result = report(passed);
+
+    dw::jobs::shutdown();
+    dw::logger::close_console_stream();
+
+    return result;
+}
@@ -0,0 +1,148 @@
+#include "test.h"
+#include <gltf.h>
+#include <jobs.h>
+#include <logger.h>
+#include <gtc/matrix_transform.hpp>
+#include <gtc/quaternion.hpp>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Loads tests/data/quantized_box.gltf, which stores its positions the way gltfpack does: KHR_mesh_quantization with
+// unnormalized 16-bit integers, dequantized by the scale and translation of the node placing the mesh. The box, 4 x 3 x 2
+// units, is placed twice and also rotated under a parent as the "wedge" mesh, next to a floor with float positions.
+// Checks that quantized meshes come out of quantized units, that every node still places its vertices where the file
+// does, and that float meshes are left alone.
+//
+// Usage: gltf_test [path to quantized_box.gltf]
+
+#define TEST_DEFAULT_PATH "quantized_box.gltf"
+#define TEST_QUANTIZATION_SCALE (1.0f / 4096.0f)
+#define TEST_TOLERANCE 1e-4f
+
+enum TestSubMesh
+{
+    TEST_SUB_MESH_BOX,
+    TEST_SUB_MESH_PLANE,
+    TEST_SUB_MESH_WEDGE,
+    TEST_SUB_MESH_COUNT
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Quantized position of a corner of the box, as the fixture stores it.
+static glm::vec3 quantized_corner(uint32_t i)
+{
+    return glm::vec3(16384.0f * (i & 1), 12288.0f * ((i >> 1) & 1), 8192.0f * ((i >> 2) & 1));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static glm::mat4 trs(const glm::vec3& translation, const glm::quat& rotation, float scale)
+{
+    return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool close(const glm::vec3& a, const glm::vec3& b)
+{
+    return glm::length(a - b) <= TEST_TOLERANCE * std::max(1.0f, glm::length(b));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every node of the fixture along with the transform the file gives it, which takes quantized positions to the scene.
+static bool nodes_place_vertices_as_the_file_does(const dw::gltf::Model& model, const uint32_t* first_vertex)
+{
+    const glm::quat quarter_turn_y = glm::angleAxis(glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const glm::quat quarter_turn_x = glm::angleAxis(glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+    const glm::quat no_rotation    = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+    struct ExpectedNode
+    {
+        const char* name;
+        uint32_t    sub_mesh;
+        glm::mat4   transform;
+    };
+
+    const ExpectedNode expected[] = {
+        { "box", TEST_SUB_MESH_BOX, trs(glm::vec3(-2.0f, 0.0f, -1.0f), no_rotation, TEST_QUANTIZATION_SCALE) },
+        { "box_instance", TEST_SUB_MESH_BOX, trs(glm::vec3(8.0f, 0.0f, -1.0f), no_rotation, TEST_QUANTIZATION_SCALE) },
+        { "rotated_wedge", TEST_SUB_MESH_WEDGE, glm::mat4_cast(quarter_turn_y) * trs(glm::vec3(1.0f, 2.0f, 3.0f), quarter_turn_x, TEST_QUANTIZATION_SCALE) },
+        { "floor", TEST_SUB_MESH_PLANE, glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f)) }
+    };
+
+    if (!check(model.nodes.size() == sizeof(expected) / sizeof(expected[0]), std::to_string(model.nodes.size()) + " nodes instead of 4"))
+        return false;
+
+    for (uint32_t n = 0; n < model.nodes.size(); n++)
+    {
+        const dw::gltf::Node& node = model.nodes[n];
+
+        if (!check(node.name == expected[n].name && node.first_sub_mesh == expected[n].sub_mesh && node.sub_mesh_count == 1, "Node " + std::to_string(n) + " is " + node.name + " instead of " + expected[n].name))
+            return false;
+
+        for (uint32_t i = 0; i < model.sub_meshes[node.first_sub_mesh].vertex_count; i++)
+        {
+            glm::vec3 position = glm::vec3(model.vertices[first_vertex[node.first_sub_mesh] + i].position);
+            glm::vec3 file     = node.first_sub_mesh == TEST_SUB_MESH_PLANE ? position : quantized_corner(i);
+
+            if (!check(close(glm::vec3(node.transform * glm::vec4(position, 1.0f)), glm::vec3(expected[n].transform * glm::vec4(file, 1.0f))), node.name + " places vertex " + std::to_string(i) + " elsewhere than the file does"))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    dw::jobs::initialize(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    dw::gltf::Model model;
+    std::string     path   = argc < 2 ? TEST_DEFAULT_PATH : argv[1];
+    bool            passed = check(dw::gltf::load(path, model), "Failed to load " + path) &&
+                  check(model.sub_meshes.size() == TEST_SUB_MESH_COUNT, std::to_string(model.sub_meshes.size()) + " sub meshes instead of 3");
+
+    uint32_t first_vertex[TEST_SUB_MESH_COUNT] = {};
+
+    for (uint32_t i = 1; passed && i < TEST_SUB_MESH_COUNT; i++)
+        first_vertex[i] = first_vertex[i - 1] + model.sub_meshes[i - 1].vertex_count;
+
+    if (passed)
+    {
+        const dw::SubMesh& box   = model.sub_meshes[TEST_SUB_MESH_BOX];
+        const dw::SubMesh& plane = model.sub_meshes[TEST_SUB_MESH_PLANE];
+        const dw::SubMesh& wedge = model.sub_meshes[TEST_SUB_MESH_WEDGE];
+
+        // The box node only scales and translates, so the box comes out as it was before quantization. The wedge node also
+        // rotates, which leaves its translation on the node.
+        passed = check(close(box.min_extents, glm::vec3(-2.0f, 0.0f, -1.0f)) && close(box.max_extents, glm::vec3(2.0f, 3.0f, 1.0f)), "The box is not in the units of its node") &&
+                 check(close(wedge.min_extents, glm::vec3(0.0f)) && close(wedge.max_extents, glm::vec3(4.0f, 3.0f, 2.0f)), "The wedge is not scaled by its node") &&
+                 check(close(plane.min_extents, glm::vec3(-5.0f, 0.0f, -5.0f)) && close(plane.max_extents, glm::vec3(5.0f, 0.0f, 5.0f)), "The float positions of the floor changed");
+    }
+
+    // The quantized normals of the box point away from its center.
+    for (uint32_t i = 0; passed && i < model.sub_meshes[TEST_SUB_MESH_BOX].vertex_count; i++)
+    {
+        const dw::Vertex& vertex = model.vertices[first_vertex[TEST_SUB_MESH_BOX] + i];
+        glm::vec3         normal = glm::vec3(vertex.normal);
+
+        passed = check(fabsf(glm::length(normal) - 1.0f) < TEST_TOLERANCE && glm::dot(normal, glm::vec3(vertex.position) - glm::vec3(0.0f, 1.5f, 0.0f)) > 0.0f, "Normal " + std::to_string(i) + " of the box does not point outwards");
+    }
+
+    passed = passed && nodes_place_vertices_as_the_file_does(model, first_vertex);
+
+    int result = report(passed);
+
+    dw::jobs::shutdown();
+    dw::logger::close_console_stream();
+
+    return result;
+}
@@ -0,0 +1,211 @@
+#include "test.h"
+#include <jobs.h>
+#include <logger.h>
+#include <timer.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Runs the job system with 1, 2, 4 ... 64 threads and checks, for each count, that parallel_for visits every index exactly
+// once, that nested fork/join completes, that main-thread jobs only run on the main thread, and that jobs submitted from
+// threads outside the job system complete. A compute-bound parallel_for is timed for every thread count, and its speedup
+// over one thread is reported. The speedup is not checked, since it depends on the cores of the machine.
+//
+// Usage: jobs_test [max thread count]
+
+#define TEST_DEFAULT_MAX_THREADS JOBS_MAX_WORKERS
+#define TEST_COVERAGE_COUNT (1 << 20)
+#define TEST_FORK_DEPTH 12
+#define TEST_MAIN_THREAD_JOB_COUNT 256
+#define TEST_EXTERNAL_THREAD_COUNT 4
+#define TEST_EXTERNAL_JOB_COUNT 1000
+#define TEST_WORK_COUNT 4096
+#define TEST_WORK_ITERATIONS 20000
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool parallel_for_covers_range(uint32_t count, uint32_t grain_size)
+{
+    std::vector<uint32_t> hits(count, 0);
+
+    dw::jobs::parallel_for(count, grain_size, [&hits](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+            hits[i]++;
+    });
+
+    return std::all_of(hits.begin(), hits.end(), [](uint32_t h) { return h == 1; });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every level submits its two halves and waits on them, so waits nest as deep as the tree.
+static uint32_t fork_join(uint32_t depth)
+{
+    if (depth == 0)
+        return 1;
+
+    uint32_t          results[2];
+    dw::jobs::Counter counter;
+
+    for (uint32_t i = 0; i < 2; i++)
+        dw::jobs::submit([&results, i, depth]() { results[i] = fork_join(depth - 1); }, &counter);
+
+    dw::jobs::wait(&counter);
+
+    return results[0] + results[1];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool main_thread_jobs_stay_on_main_thread()
+{
+    std::atomic<uint32_t> on_main_thread(0);
+    dw::jobs::Counter     counter;
+
+    dw::jobs::parallel_for(TEST_MAIN_THREAD_JOB_COUNT, 1, [&on_main_thread, &counter](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            dw::jobs::submit_main_thread(
+                [&on_main_thread]() {
+                    if (dw::jobs::is_main_thread())
+                        on_main_thread++;
+                },
+                &counter);
+        }
+    });
+
+    dw::jobs::wait(&counter);
+
+    return on_main_thread == TEST_MAIN_THREAD_JOB_COUNT;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool external_submissions_complete()
+{
+    std::atomic<uint32_t>    executed(0);
+    std::vector<std::thread> threads;
+
+    for (uint32_t t = 0; t < TEST_EXTERNAL_THREAD_COUNT; t++)
+    {
+        threads.emplace_back([&executed]() {
+            dw::jobs::Counter counter;
+
+            for (uint32_t i = 0; i < TEST_EXTERNAL_JOB_COUNT; i++)
+                dw::jobs::submit([&executed]() { executed++; }, &counter);
+
+            dw::jobs::wait(&counter);
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    return executed == TEST_EXTERNAL_THREAD_COUNT * TEST_EXTERNAL_JOB_COUNT;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Returns the time taken by a compute-bound parallel_for, in milliseconds.
+static double timed_work(uint32_t& checksum)
+{
+    std::vector<uint32_t> results(TEST_WORK_COUNT);
+
+    Timer timer;
+    timer.start();
+
+    dw::jobs::parallel_for(TEST_WORK_COUNT, 16, [&results](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t x = i + 1;
+
+            for (uint32_t j = 0; j < TEST_WORK_ITERATIONS; j++)
+                x = x * 1664525u + 1013904223u;
+
+            results[i] = x;
+        }
+    });
+
+    double ms = timer.elapsed_time_milisec();
+
+    checksum = 0;
+
+    for (uint32_t r : results)
+        checksum ^= r;
+
+    return ms;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    uint32_t max_threads = argc < 2 ? TEST_DEFAULT_MAX_THREADS : std::min(std::max(atoi(argv[1]), 1), JOBS_MAX_WORKERS);
+    bool     passed      = true;
+    double   single_ms   = 0.0;
+    uint32_t expected    = 0;
+
+    DW_LOG_INFO(std::to_string(std::thread::hardware_concurrency()) + " hardware threads");
+
+    std::vector<uint32_t> thread_counts;
+
+    for (uint32_t threads = 1; threads < max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+
+    thread_counts.push_back(max_threads);
+
+    for (uint32_t threads : thread_counts)
+    {
+        if (!passed)
+            break;
+
+        dw::jobs::initialize(threads - 1);
+
+        const std::string prefix = std::to_string(threads) + " threads: ";
+
+        passed = check(dw::jobs::worker_count() == threads, prefix + "wrong worker count") &&
+                 check(parallel_for_covers_range(TEST_COVERAGE_COUNT, 1000), prefix + "parallel_for missed or repeated an index") &&
+                 check(parallel_for_covers_range(10000, 1), prefix + "parallel_for with single-index ranges missed or repeated an index") &&
+                 check(fork_join(TEST_FORK_DEPTH) == (1u << TEST_FORK_DEPTH), prefix + "nested fork/join lost a job") &&
+                 check(main_thread_jobs_stay_on_main_thread(), prefix + "a main-thread job ran elsewhere") &&
+                 check(external_submissions_complete(), prefix + "a job submitted from outside the job system was lost");
+
+        if (passed)
+        {
+            // Latch the statistics of everything above, so the steals of the timed run can be read on their own.
+            dw::jobs::begin_frame();
+
+            uint32_t checksum;
+            double   ms = timed_work(checksum);
+
+            dw::jobs::begin_frame();
+
+            uint32_t steals = 0;
+
+            for (uint32_t i = 0; i < threads; i++)
+                steals += dw::jobs::worker_stats(i).steals;
+
+            if (threads == 1)
+            {
+                single_ms = ms;
+                expected  = checksum;
+            }
+
+            passed = check(checksum == expected, prefix + "the timed work computed a different result");
+
+            DW_LOG_INFO(prefix + std::to_string(ms) + " ms, " + std::to_string(single_ms / ms) + "x over one thread, " + std::to_string(steals) + " steals");
+        }
+
+        dw::jobs::shutdown();
+    }
+
+    int result = report(passed);
+
+    dw::logger::close_console_stream();
+
+    return result;
+}
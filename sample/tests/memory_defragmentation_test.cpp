@@ -0,0 +1,232 @@
+#include "test.h"
+#include <application.h>
+#include <vk_mem_alloc.h>
+
+// Fragments the streaming texture pool and checks that defragmentation compacts it without changing what the moved images
+// hold. The pool is filled with movable images holding a pattern of their own, every other one is destroyed, and the memory
+// manager is then advanced until it has finished. The surviving images are copied back and compared with their pattern.
+//
+// Usage: memory_defragmentation_test
+
+#define TEST_IMAGE_SIZE 512
+#define TEST_MAX_IMAGES 1024
+#define TEST_MAX_UPDATES 20000
+
+class MemoryDefragmentationTest : public dw::Application
+{
+public:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    inline bool passed() { return m_passed; }
+
+protected:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool init(int argc, const char* argv[]) override
+    {
+        dw::vk::MemoryManager* manager = m_vk_backend->memory_manager();
+
+        if (!manager || !manager->pool(dw::vk::MEMORY_POOL_STREAMING_TEXTURES))
+        {
+            DW_LOG_ERROR("The streaming texture pool is not available.");
+            return false;
+        }
+
+        fill_pool();
+
+        // Every other image goes, leaving holes the size of one image and no larger range.
+        for (uint32_t i = 0; i < m_images.size(); i += 2)
+            m_images[i].reset();
+
+        float fragmentation = pool_stats().fragmentation;
+
+        DW_LOG_INFO("Fragmentation before: " + std::to_string(fragmentation));
+
+        if (fragmentation <= MEMORY_DEFRAGMENTATION_THRESHOLD)
+        {
+            DW_LOG_ERROR("The pool was not fragmented enough for defragmentation to start.");
+            request_exit();
+            return true;
+        }
+
+        uint32_t allocations_moved = 0;
+        bool     started           = false;
+
+        // Waiting for the GPU after each update lets every pass complete within a few updates.
+        for (uint32_t i = 0; i < TEST_MAX_UPDATES; i++)
+        {
+            manager->update();
+            m_vk_backend->wait_idle();
+
+            dw::vk::MemoryStats stats = manager->stats();
+
+            allocations_moved += stats.allocations_moved;
+            started = started || stats.defragmenting;
+
+            if (started && !stats.defragmenting)
+                break;
+        }
+
+        manager->finish();
+
+        float compacted = pool_stats().fragmentation;
+
+        DW_LOG_INFO("Fragmentation after: " + std::to_string(compacted) + ", " + std::to_string(allocations_moved) + " allocations moved, " + std::to_string(m_relocated) + " images relocated");
+
+        m_passed = check(allocations_moved > 0, "Nothing was moved.") &&
+                   check(m_relocated > 0, "No relocation callback was called.") &&
+                   check(compacted < fragmentation, "Fragmentation did not go down.") &&
+                   check(contents_preserved(), "A moved image lost its contents.");
+
+        report(m_passed);
+
+        request_exit();
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update(double delta) override {}
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void shutdown() override
+    {
+        m_images.clear();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    dw::AppSettings intial_app_settings() override
+    {
+        dw::AppSettings settings;
+
+        settings.title    = "Memory Defragmentation Test";
+        settings.headless = true;
+
+        return settings;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    dw::vk::MemoryPoolStats pool_stats()
+    {
+        return m_vk_backend->memory_manager()->stats().pools[dw::vk::MEMORY_POOL_STREAMING_TEXTURES];
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Allocates images until the next one would need another block, so that the only free memory is what the test frees.
+    void fill_pool()
+    {
+        std::vector<uint32_t> pixels(TEST_IMAGE_SIZE * TEST_IMAGE_SIZE);
+
+        size_t image_bytes = 0;
+
+        while (m_images.size() < TEST_MAX_IMAGES)
+        {
+            dw::vk::MemoryPoolStats stats = pool_stats();
+
+            if (image_bytes > 0 && stats.allocation_bytes + image_bytes > stats.block_bytes)
+                break;
+
+            std::fill(pixels.begin(), pixels.end(), pattern(uint32_t(m_images.size())));
+
+            dw::vk::Image::Ptr image = dw::vk::Image::create(m_vk_backend,
+                                                             VK_IMAGE_TYPE_2D,
+                                                             TEST_IMAGE_SIZE,
+                                                             TEST_IMAGE_SIZE,
+                                                             1,
+                                                             1,
+                                                             1,
+                                                             VK_FORMAT_R8G8B8A8_UNORM,
+                                                             VMA_MEMORY_USAGE_GPU_ONLY,
+                                                             VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                                             VK_SAMPLE_COUNT_1_BIT,
+                                                             VK_IMAGE_LAYOUT_UNDEFINED,
+                                                             pixels.size() * sizeof(uint32_t),
+                                                             pixels.data());
+
+            image->set_movable(true, [this]() { m_relocated++; });
+
+            if (image_bytes == 0)
+                image_bytes = pool_stats().allocation_bytes - stats.allocation_bytes;
+
+            m_images.push_back(image);
+        }
+
+        DW_LOG_INFO("Filled the pool with " + std::to_string(m_images.size()) + " images");
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool contents_preserved()
+    {
+        const size_t size = TEST_IMAGE_SIZE * TEST_IMAGE_SIZE * sizeof(uint32_t);
+
+        for (uint32_t i = 1; i < m_images.size(); i += 2)
+        {
+            dw::vk::Image::Ptr  image    = m_images[i];
+            dw::vk::Buffer::Ptr readback = dw::vk::Buffer::create(m_vk_backend, VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+            dw::vk::CommandBuffer::Ptr cmd_buf = m_vk_backend->allocate_graphics_command_buffer(true);
+
+            VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            m_vk_backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, range);
+            m_vk_backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT, readback);
+            m_vk_backend->flush_barriers(cmd_buf);
+
+            VkBufferImageCopy region;
+            DW_ZERO_MEMORY(region);
+
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent.width           = TEST_IMAGE_SIZE;
+            region.imageExtent.height          = TEST_IMAGE_SIZE;
+            region.imageExtent.depth           = 1;
+
+            vkCmdCopyImageToBuffer(cmd_buf->handle(), image->handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback->handle(), 1, &region);
+
+            m_vk_backend->use_resource(VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT, readback);
+            m_vk_backend->flush_barriers(cmd_buf);
+
+            vkEndCommandBuffer(cmd_buf->handle());
+
+            m_vk_backend->flush_graphics({ cmd_buf });
+
+            const uint32_t* texels = (const uint32_t*)readback->mapped_ptr();
+
+            for (uint32_t j = 0; j < TEST_IMAGE_SIZE * TEST_IMAGE_SIZE; j++)
+            {
+                if (texels[j] != pattern(i))
+                {
+                    DW_LOG_ERROR("Image " + std::to_string(i) + " differs at texel " + std::to_string(j));
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    static uint32_t pattern(uint32_t index)
+    {
+        return index * 2654435761u;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    std::vector<dw::vk::Image::Ptr> m_images;
+    uint32_t                        m_relocated = 0;
+    bool                            m_passed    = false;
+};
+
+DW_DECLARE_TEST_MAIN(MemoryDefragmentationTest)
@@ -0,0 +1,255 @@
+#include "test.h"
+#include <application.h>
+#include <readback.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Reads textures back through a small readback ring while they are rewritten every frame, and checks that each request
+// holds the contents the texture had when the request was issued. Two mip levels of an RGBA8 texture and an RGBA32F texture
+// are read every frame, and a texture larger than the ring every few frames, so that the ring wraps around and fills up
+// and copies fall back to buffers of their own. Some requests are dropped before they complete. Once everything has been
+// released the whole ring has to be free again.
+//
+// Usage: readback_test [frame count]
+
+#define TEST_DEFAULT_FRAME_COUNT 120
+#define TEST_COLOR_SIZE 256
+#define TEST_FLOAT_SIZE 64
+#define TEST_LARGE_SIZE 1024
+#define TEST_LARGE_INTERVAL 8
+#define TEST_DROP_INTERVAL 5
+// Room for a little more than three level 0 copies of the color texture.
+#define TEST_RING_SIZE (TEST_COLOR_SIZE * TEST_COLOR_SIZE * 4 * 3 + TEST_FLOAT_SIZE * TEST_FLOAT_SIZE * 16)
+
+enum TestTexture
+{
+    TEST_TEXTURE_COLOR,
+    TEST_TEXTURE_FLOAT,
+    TEST_TEXTURE_LARGE,
+    TEST_TEXTURE_COUNT
+};
+
+// A request along with what it has to hold.
+struct PendingRead
+{
+    dw::ReadbackRequest::Ptr request;
+    uint32_t                 texture;
+    int                      mip_level;
+    uint32_t                 frame;
+};
+
+class ReadbackTest : public dw::Application
+{
+public:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    inline bool passed() { return m_passed; }
+
+protected:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool init(int argc, const char* argv[]) override
+    {
+        m_test_frame_count = argc < 2 ? TEST_DEFAULT_FRAME_COUNT : std::max(atoi(argv[1]), TEST_LARGE_INTERVAL);
+
+        m_textures[TEST_TEXTURE_COLOR] = dw::gl::Texture2D::create(TEST_COLOR_SIZE, TEST_COLOR_SIZE, 1, 2, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+        m_textures[TEST_TEXTURE_FLOAT] = dw::gl::Texture2D::create(TEST_FLOAT_SIZE, TEST_FLOAT_SIZE, 1, 1, 1, GL_RGBA32F, GL_RGBA, GL_FLOAT);
+        m_textures[TEST_TEXTURE_LARGE] = dw::gl::Texture2D::create(TEST_LARGE_SIZE, TEST_LARGE_SIZE, 1, 1, 1, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+
+        m_readback = dw::Readback::create(TEST_RING_SIZE);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void update(double delta) override
+    {
+        if (m_passed)
+            m_passed = check_ready_reads();
+
+        if (!m_passed || m_frame_index == m_test_frame_count)
+        {
+            if (m_passed)
+                m_passed = finish();
+
+            DW_LOG_INFO(std::to_string(m_checked) + " reads checked, " + std::to_string(m_dropped) + " dropped, latency up to " + std::to_string(m_max_latency) + " frames");
+            report(m_passed);
+
+            request_exit();
+            return;
+        }
+
+        // Rewriting the textures right after the copies of the previous frame were issued only leaves those copies intact if
+        // they captured the texture as it was when they were issued.
+        issue_read(TEST_TEXTURE_COLOR, 0);
+        issue_read(TEST_TEXTURE_COLOR, 1);
+        issue_read(TEST_TEXTURE_FLOAT, 0);
+
+        if (m_frame_index % TEST_LARGE_INTERVAL == 0)
+            issue_read(TEST_TEXTURE_LARGE, 0);
+
+        if (m_frame_index % TEST_DROP_INTERVAL == 0)
+        {
+            m_pending.pop_back();
+            m_dropped++;
+        }
+
+        m_readback->end_frame();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void shutdown() override
+    {
+        m_pending.clear();
+        m_readback.reset();
+
+        for (auto& texture : m_textures)
+            texture.reset();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    dw::AppSettings intial_app_settings() override
+    {
+        dw::AppSettings settings;
+
+        settings.title    = "Readback Test";
+        settings.headless = true;
+
+        return settings;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void issue_read(uint32_t texture, int mip_level)
+    {
+        std::vector<uint8_t> data;
+
+        expected_data(texture, mip_level, m_frame_index, data);
+        m_textures[texture]->write_data(0, mip_level, data.data());
+
+        PendingRead read;
+
+        read.request   = m_readback->read(m_textures[texture].get(), mip_level);
+        read.texture   = texture;
+        read.mip_level = mip_level;
+        read.frame     = m_frame_index;
+
+        m_pending.push_back(read);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool check_ready_reads()
+    {
+        for (size_t i = 0; i < m_pending.size();)
+        {
+            if (!m_pending[i].request->is_ready())
+            {
+                i++;
+                continue;
+            }
+
+            if (!contents_match(m_pending[i]))
+                return false;
+
+            m_pending.erase(m_pending.begin() + i);
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool finish()
+    {
+        for (auto& read : m_pending)
+        {
+            read.request->wait();
+
+            if (!contents_match(read))
+                return false;
+        }
+
+        m_pending.clear();
+
+        // Dropped requests hand their ranges back once their copies have completed, which is checked on the next read.
+        glFinish();
+
+        dw::ReadbackRequest::Ptr request = m_readback->read(m_textures[TEST_TEXTURE_FLOAT].get(), 0);
+
+        request->wait();
+        request.reset();
+
+        return check(m_readback->used() == 0, std::to_string(m_readback->used()) + " bytes of the ring were never released");
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool contents_match(PendingRead& read)
+    {
+        std::vector<uint8_t> expected;
+
+        expected_data(read.texture, read.mip_level, read.frame, expected);
+
+        const std::string name = "Read of texture " + std::to_string(read.texture) + ", level " + std::to_string(read.mip_level) + " from frame " + std::to_string(read.frame);
+        const void*       data = read.request->data();
+
+        if (!check(data != nullptr, name + " has no data") ||
+            !check(read.request->size() == expected.size(), name + " holds " + std::to_string(read.request->size()) + " bytes instead of " + std::to_string(expected.size())) ||
+            !check(memcmp(data, expected.data(), expected.size()) == 0, name + " does not hold what the texture held when it was issued"))
+            return false;
+
+        m_max_latency = std::max(m_max_latency, read.request->latency());
+        m_checked++;
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Contents written to a level of a texture on a frame. Floats are small integers, which survive the round trip exactly.
+    static void expected_data(uint32_t texture, int mip_level, uint32_t frame, std::vector<uint8_t>& data)
+    {
+        const uint32_t size  = (texture == TEST_TEXTURE_COLOR ? TEST_COLOR_SIZE : texture == TEST_TEXTURE_FLOAT ? TEST_FLOAT_SIZE : TEST_LARGE_SIZE) >> mip_level;
+        const uint32_t count = size * size * 4;
+
+        if (texture == TEST_TEXTURE_FLOAT)
+        {
+            std::vector<float> values(count);
+
+            for (uint32_t i = 0; i < count; i++)
+                values[i] = float((i * 7 + frame * 131) % 4096);
+
+            data.resize(count * sizeof(float));
+            memcpy(data.data(), values.data(), data.size());
+        }
+        else
+        {
+            data.resize(count);
+
+            for (uint32_t i = 0; i < count; i++)
+                data[i] = uint8_t((i * 2654435761u + frame * 40503u + texture * 97u + mip_level * 13u) >> 11);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+private:
+    dw::gl::Texture2D::Ptr   m_textures[TEST_TEXTURE_COUNT];
+    dw::Readback::Ptr        m_readback;
+    std::vector<PendingRead> m_pending;
+    uint32_t                 m_test_frame_count = TEST_DEFAULT_FRAME_COUNT;
+    uint32_t                 m_checked          = 0;
+    uint32_t                 m_dropped          = 0;
+    uint32_t                 m_max_latency      = 0;
+    bool                     m_passed           = true;
+};
+
+DW_DECLARE_TEST_MAIN(ReadbackTest)
@@ -0,0 +1,239 @@
+#include "test.h"
+#include <scene.h>
+#include <jobs.h>
+#include <logger.h>
+#include <timer.h>
+#include <gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Updates a hierarchy of 100k nodes every frame and checks the cached world matrices against a direct recomputation, once
+// with every node moved and once with a few. Picking through the BVH is compared against testing every node's bounds,
+// after the BVH has been built and after it has been refitted.
+//
+// Usage: scene_test [node count] [frame count]
+
+#define TEST_DEFAULT_NODE_COUNT 100000
+#define TEST_DEFAULT_FRAME_COUNT 30
+#define TEST_ROOT_COUNT 64
+#define TEST_PARTIAL_UPDATE_DIVISOR 100
+#define TEST_PICK_COUNT 1000
+#define TEST_TOLERANCE 1e-3f
+
+struct LocalTransform
+{
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static glm::mat4 local_matrix(const LocalTransform& local)
+{
+    return glm::translate(glm::mat4(1.0f), local.position) * glm::mat4_cast(local.rotation) * glm::scale(glm::mat4(1.0f), local.scale);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Nodes are created after their parents, so one pass in creation order recomputes every world matrix.
+static bool world_transforms_match(dw::Scene& scene, const std::vector<LocalTransform>& locals)
+{
+    std::vector<glm::mat4> expected(locals.size());
+
+    for (uint32_t i = 0; i < locals.size(); i++)
+    {
+        uint32_t parent = scene.parent(i);
+
+        expected[i] = parent == dw::Scene::kInvalidNode ? local_matrix(locals[i]) : expected[parent] * local_matrix(locals[i]);
+
+        const glm::mat4& world = scene.world_transform(i);
+
+        for (int c = 0; c < 4; c++)
+        {
+            for (int r = 0; r < 4; r++)
+            {
+                if (fabsf(world[c][r] - expected[i][c][r]) > TEST_TOLERANCE * std::max(1.0f, fabsf(expected[i][c][r])))
+                {
+                    DW_LOG_ERROR("World transform of node " + std::to_string(i) + " differs at [" + std::to_string(c) + "][" + std::to_string(r) + "]");
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool ray_hits(const glm::vec3& origin, const glm::vec3& direction, const dw::AABB& aabb, float& distance)
+{
+    float t_enter = 0.0f;
+    float t_exit  = FLT_MAX;
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float t0 = (aabb.min[axis] - origin[axis]) / direction[axis];
+        float t1 = (aabb.max[axis] - origin[axis]) / direction[axis];
+
+        t_enter = std::max(t_enter, std::min(t0, t1));
+        t_exit  = std::min(t_exit, std::max(t0, t1));
+    }
+
+    distance = t_enter;
+
+    return t_enter <= t_exit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool picks_match(dw::Scene& scene, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    const dw::AABB& bounds = scene.bounds();
+    glm::vec3       center = (bounds.min + bounds.max) * 0.5f;
+    float           radius = glm::length(bounds.max - bounds.min);
+    uint32_t        hits   = 0;
+
+    for (uint32_t i = 0; i < TEST_PICK_COUNT; i++)
+    {
+        // Rays start outside the scene and aim at a point within it.
+        glm::vec3 outside   = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 0.0f, 0.001f));
+        glm::vec3 origin    = center + outside * radius;
+        glm::vec3 target    = center + glm::vec3(unit(rng), unit(rng), unit(rng)) * (bounds.max - bounds.min) * 0.25f;
+        glm::vec3 direction = glm::normalize(target - origin);
+
+        float    expected_distance = FLT_MAX;
+        uint32_t expected_node     = dw::Scene::kInvalidNode;
+
+        for (uint32_t node = 0; node < scene.node_count(); node++)
+        {
+            float distance;
+
+            if (ray_hits(origin, direction, scene.world_bounds(node), distance) && distance < expected_distance)
+            {
+                expected_distance = distance;
+                expected_node     = node;
+            }
+        }
+
+        float    distance;
+        uint32_t node = scene.pick(origin, direction, distance);
+
+        // Boxes can be entered at the same distance, so only the distance has to agree.
+        if ((node == dw::Scene::kInvalidNode) != (expected_node == dw::Scene::kInvalidNode) ||
+            (node != dw::Scene::kInvalidNode && fabsf(distance - expected_distance) > TEST_TOLERANCE * std::max(1.0f, expected_distance)))
+        {
+            DW_LOG_ERROR("Ray " + std::to_string(i) + " picked node " + std::to_string(node) + " instead of " + std::to_string(expected_node));
+            return false;
+        }
+
+        hits += node != dw::Scene::kInvalidNode ? 1 : 0;
+    }
+
+    DW_LOG_INFO(std::to_string(hits) + " of " + std::to_string(TEST_PICK_COUNT) + " rays hit a node");
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static LocalTransform random_transform(std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    std::uniform_real_distribution<float> scale(0.8f, 1.2f);
+
+    LocalTransform local;
+
+    local.position = glm::vec3(offset(rng), offset(rng), offset(rng));
+    local.rotation = glm::angleAxis(angle(rng), glm::normalize(glm::vec3(offset(rng), offset(rng), offset(rng)) + glm::vec3(0.0f, 0.001f, 0.0f)));
+    local.scale    = glm::vec3(scale(rng), scale(rng), scale(rng));
+
+    return local;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    uint32_t node_count  = argc < 2 ? TEST_DEFAULT_NODE_COUNT : std::max(atoi(argv[1]), TEST_ROOT_COUNT);
+    uint32_t frame_count = argc < 3 ? TEST_DEFAULT_FRAME_COUNT : std::max(atoi(argv[2]), 1);
+
+    dw::jobs::initialize(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    std::mt19937                rng(7);
+    std::vector<LocalTransform> locals(node_count);
+    dw::Scene::Ptr              scene = dw::Scene::create();
+
+    // Each node hangs off a random earlier node, which gives a bushy hierarchy a few dozen levels deep.
+    for (uint32_t i = 0; i < node_count; i++)
+    {
+        uint32_t parent = i < TEST_ROOT_COUNT ? dw::Scene::kInvalidNode : rng() % i;
+        uint32_t node   = scene->create_node(parent);
+
+        locals[node] = random_transform(rng);
+
+        scene->set_local_transform(node, locals[node].position, locals[node].rotation, locals[node].scale);
+        scene->set_local_bounds(node, glm::vec3(-0.5f), glm::vec3(0.5f));
+    }
+
+    Timer timer;
+    timer.start();
+
+    scene->update();
+
+    double build_ms = timer.elapsed_time_milisec();
+    bool   passed   = world_transforms_match(*scene, locals) && picks_match(*scene, rng);
+
+    double full_ms    = 0.0;
+    double partial_ms = 0.0;
+
+    for (uint32_t frame = 0; frame < frame_count && passed; frame++)
+    {
+        // Every node moves.
+        for (uint32_t i = 0; i < node_count; i++)
+        {
+            locals[i].position.y += 0.01f;
+            scene->set_local_position(i, locals[i].position);
+        }
+
+        timer.start();
+        scene->update();
+        full_ms += timer.elapsed_time_milisec();
+
+        // A few nodes move, along with their subtrees.
+        for (uint32_t i = 0; i < node_count / TEST_PARTIAL_UPDATE_DIVISOR; i++)
+        {
+            uint32_t node = rng() % node_count;
+
+            locals[node] = random_transform(rng);
+            scene->set_local_transform(node, locals[node].position, locals[node].rotation, locals[node].scale);
+        }
+
+        timer.start();
+        scene->update();
+        partial_ms += timer.elapsed_time_milisec();
+
+        if (frame == 0 || frame == frame_count - 1)
+            passed = world_transforms_match(*scene, locals) && picks_match(*scene, rng);
+    }
+
+    DW_LOG_INFO(std::to_string(node_count) + " nodes over " + std::to_string(dw::jobs::worker_count()) + " workers, first update with BVH build " + std::to_string(build_ms) + " ms");
+    DW_LOG_INFO("  every node moved:  " + std::to_string(full_ms / frame_count) + " ms per update");
+    DW_LOG_INFO("  1% of nodes moved: " + std::to_string(partial_ms / frame_count) + " ms per update");
+    int result = report(passed);
+
+    dw::jobs::shutdown();
+    dw::logger::close_console_stream();
+
+    return result;
+}
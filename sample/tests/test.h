@@ -0,0 +1,39 @@
+#pragma once
+
+#include <logger.h>
+#include <string>
+
+// Helpers shared by the programs under sample/tests. Each test logs why it failed through check(), reports its result
+// once through report(), and returns non-zero from main() when it failed.
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Logs the message unless the condition holds. Returns the condition, so that checks can be chained with &&.
+inline bool check(bool condition, const std::string& message)
+{
+    if (!condition)
+        DW_LOG_ERROR(message);
+
+    return condition;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Logs the result of the test and returns the exit code that goes with it.
+inline int report(bool passed)
+{
+    DW_LOG_INFO(passed ? "PASSED" : "FAILED");
+
+    return passed ? 0 : 1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Declares main() for a test built on dw::Application, which has to provide passed(). Application::run() only reports
+// whether the application could start, so the result of the test is returned on top of it.
+#define DW_DECLARE_TEST_MAIN(class_name)                  \
+    int main(int argc, const char* argv[])                \
+    {                                                     \
+        class_name app;                                   \
+        return app.run(argc, argv) != 0 || !app.passed(); \
+    }
@@ -0,0 +1,169 @@
+#include "test.h"
+#include <mesh.h>
+#include <jobs.h>
+#include <logger.h>
+#include <timer.h>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Welds a face-indexed mesh, as it comes out of OBJ files, and checks the result against the number of unique vertices it
+// was built from. Each of the two submeshes is a grid of quads that stores every triangle corner as its own vertex, with
+// jitter below the weld epsilon. The right half of each grid has its own texture coordinates, so the column along the seam
+// has to stay split. Both submeshes hold the same vertices, which must not be merged across them. Every index has to
+// resolve to a vertex equal to the corner it pointed at before welding.
+//
+// Usage: vertex_weld_test [grid size]
+
+#define TEST_DEFAULT_GRID_SIZE 256
+#define TEST_SUB_MESH_COUNT 2
+#define TEST_EPSILON 1e-3f
+// Grid points lie on multiples of the epsilon, so jitter below half of it never changes their quantized value.
+#define TEST_GRID_SPACING 0.5f
+#define TEST_JITTER 0.25f * TEST_EPSILON
+#define TEST_SEAM_OFFSET 10.0f
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static dw::Vertex grid_vertex(uint32_t x, uint32_t y, bool right_half, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> jitter(-TEST_JITTER, TEST_JITTER);
+
+    dw::Vertex vertex;
+
+    vertex.position  = glm::vec4(x * TEST_GRID_SPACING + jitter(rng), 0.0f, y * TEST_GRID_SPACING + jitter(rng), 0.0f);
+    vertex.tex_coord = glm::vec4(x * TEST_GRID_SPACING + (right_half ? TEST_SEAM_OFFSET : 0.0f), y * TEST_GRID_SPACING + jitter(rng), 0.0f, 0.0f);
+    vertex.normal    = glm::vec4(jitter(rng), 1.0f, 0.0f, 0.0f);
+    vertex.tangent   = glm::vec4(1.0f, 0.0f, jitter(rng), 0.0f);
+    vertex.bitangent = glm::vec4(0.0f, jitter(rng), 1.0f, 0.0f);
+
+    return vertex;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Two triangles per quad, with one vertex per corner and indices that point at them in order.
+static void build_grid(uint32_t grid_size, std::vector<dw::Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<dw::SubMesh>& sub_meshes)
+{
+    const uint32_t corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+    std::mt19937 rng(61);
+
+    sub_meshes.resize(TEST_SUB_MESH_COUNT);
+
+    for (uint32_t i = 0; i < TEST_SUB_MESH_COUNT; i++)
+    {
+        dw::SubMesh& sub_mesh = sub_meshes[i];
+
+        sub_mesh.name         = "grid" + std::to_string(i);
+        sub_mesh.mat_idx      = 0;
+        sub_mesh.base_vertex  = 0;
+        sub_mesh.base_index   = indices.size();
+        sub_mesh.index_count  = grid_size * grid_size * 6;
+        sub_mesh.vertex_count = sub_mesh.index_count;
+        sub_mesh.min_extents  = glm::vec3(0.0f);
+        sub_mesh.max_extents  = glm::vec3(grid_size * TEST_GRID_SPACING, 0.0f, grid_size * TEST_GRID_SPACING);
+
+        for (uint32_t y = 0; y < grid_size; y++)
+        {
+            for (uint32_t x = 0; x < grid_size; x++)
+            {
+                for (uint32_t c = 0; c < 6; c++)
+                {
+                    indices.push_back(vertices.size());
+                    vertices.push_back(grid_vertex(x + corners[c][0], y + corners[c][1], x >= grid_size / 2, rng));
+                }
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool vertices_equal(const dw::Vertex& a, const dw::Vertex& b)
+{
+    const glm::vec4* attributes_a = &a.position;
+    const glm::vec4* attributes_b = &b.position;
+
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            if (fabsf(attributes_a[i][c] - attributes_b[i][c]) > TEST_EPSILON)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    dw::logger::initialize();
+    dw::logger::open_console_stream();
+
+    // Even, so that the seam runs along a grid column.
+    uint32_t grid_size = argc < 2 ? TEST_DEFAULT_GRID_SIZE : std::max(atoi(argv[1]), 2) & ~1;
+
+    dw::jobs::initialize(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+    std::vector<dw::Vertex>  vertices;
+    std::vector<uint32_t>    indices;
+    std::vector<dw::SubMesh> sub_meshes;
+
+    build_grid(grid_size, vertices, indices, sub_meshes);
+
+    // Each half of a grid has (grid_size / 2 + 1) * (grid_size + 1) unique vertices.
+    const std::vector<dw::Vertex> corners           = vertices;
+    const uint32_t                corner_count      = vertices.size();
+    const uint32_t                expected_per_grid = (grid_size + 2) * (grid_size + 1);
+    const uint32_t                expected_count    = expected_per_grid * TEST_SUB_MESH_COUNT;
+
+    Timer timer;
+    timer.start();
+
+    uint32_t welded_count = dw::weld_vertices(vertices, indices, sub_meshes, TEST_EPSILON);
+
+    double weld_ms = timer.elapsed_time_milisec();
+
+    bool passed = check(welded_count == expected_count, "Welded to " + std::to_string(welded_count) + " vertices instead of " + std::to_string(expected_count)) &&
+                  check(vertices.size() == welded_count, "The vertex array does not hold the returned number of vertices");
+
+    uint32_t sub_mesh_begin = 0;
+
+    for (uint32_t i = 0; i < sub_meshes.size() && passed; i++)
+    {
+        const dw::SubMesh& sub_mesh     = sub_meshes[i];
+        const uint32_t     sub_mesh_end = sub_mesh_begin + sub_mesh.vertex_count;
+
+        passed = check(sub_mesh.vertex_count == expected_per_grid, "Submesh " + std::to_string(i) + " kept " + std::to_string(sub_mesh.vertex_count) + " vertices instead of " + std::to_string(expected_per_grid));
+
+        for (uint32_t j = sub_mesh.base_index; j < sub_mesh.base_index + sub_mesh.index_count && passed; j++)
+        {
+            // Indices are absolute, so each submesh has to index only the range its vertices were compacted into.
+            passed = check(indices[j] >= sub_mesh_begin && indices[j] < sub_mesh_end, "Index " + std::to_string(j) + " of submesh " + std::to_string(i) + " points at vertex " + std::to_string(indices[j]) + " of another submesh") &&
+                     check(vertices_equal(vertices[indices[j]], corners[j]), "Index " + std::to_string(j) + " points at a different vertex than before welding");
+        }
+
+        sub_mesh_begin = sub_mesh_end;
+    }
+
+    // Welding an already welded mesh finds nothing more to merge.
+    if (passed)
+    {
+        std::vector<dw::Vertex> rewelded = vertices;
+
+        passed = check(dw::weld_vertices(rewelded, indices, sub_meshes, TEST_EPSILON) == welded_count, "Welding a second time merged more vertices");
+    }
+
+    DW_LOG_INFO(std::to_string(corner_count) + " corners welded to " + std::to_string(welded_count) + " vertices over " + std::to_string(dw::jobs::worker_count()) + " workers in " + std::to_string(weld_ms) + " ms");
+    int result = report(passed);
+
+    dw::jobs::shutdown();
+    dw::logger::close_console_stream();
+
+    return result;
+}
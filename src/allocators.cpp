@@ -0,0 +1,472 @@
+#include <allocators.h>
+#include <logger.h>
+#include <stdlib.h>
+
+namespace dw
+{
+namespace memory
+{
+namespace
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline size_t align_offset(const uint8_t* base, size_t offset, size_t alignment)
+{
+    uintptr_t address = uintptr_t(base) + offset;
+    return ((address + alignment - 1) & ~uintptr_t(alignment - 1)) - uintptr_t(base);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace
+
+#if defined(DWSF_TRACK_ALLOCATIONS)
+std::atomic<uint64_t> g_allocation_count = { 0 };
+std::atomic<uint64_t> g_allocated_bytes  = { 0 };
+#endif
+
+uint64_t   g_frame_start_allocation_count = 0;
+uint64_t   g_frame_start_allocated_bytes  = 0;
+FrameStats g_frame_stats;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+LinearAllocator::LinearAllocator(size_t block_size) :
+    m_block_size(block_size)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+LinearAllocator::~LinearAllocator()
+{
+    for (auto& block : m_blocks)
+        free(block.data);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* LinearAllocator::allocate(size_t size, size_t alignment)
+{
+    while (m_current_block < m_blocks.size())
+    {
+        Block& block  = m_blocks[m_current_block];
+        size_t offset = align_offset(block.data, m_offset, alignment);
+
+        if (offset + size <= block.size)
+        {
+            m_offset = offset + size;
+            return block.data + offset;
+        }
+
+        // Blocks left over from before a rewind are reused before growing.
+        m_current_block++;
+        m_offset = 0;
+    }
+
+    size_t block_size = std::max(m_block_size, size + alignment);
+    Block  block      = { static_cast<uint8_t*>(malloc(block_size)), block_size };
+
+    if (!block.data)
+        throw std::bad_alloc();
+
+    m_blocks.push_back(block);
+
+    m_current_block = m_blocks.size() - 1;
+
+    size_t offset = align_offset(block.data, 0, alignment);
+    m_offset      = offset + size;
+
+    return block.data + offset;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+LinearAllocator::Marker LinearAllocator::marker() const
+{
+    Marker marker;
+
+    marker.block  = m_current_block;
+    marker.offset = m_offset;
+
+    return marker;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void LinearAllocator::rewind(const Marker& marker)
+{
+    m_current_block = marker.block;
+    m_offset        = marker.offset;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void LinearAllocator::reset()
+{
+    m_current_block = 0;
+    m_offset        = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t LinearAllocator::used() const
+{
+    size_t used = 0;
+
+    for (size_t i = 0; i < m_current_block && i < m_blocks.size(); i++)
+        used += m_blocks[i].size;
+
+    return used + m_offset;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t LinearAllocator::capacity() const
+{
+    size_t capacity = 0;
+
+    for (const auto& block : m_blocks)
+        capacity += block.size;
+
+    return capacity;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FrameArena::FrameArena(size_t capacity) :
+    m_data(static_cast<uint8_t*>(malloc(capacity))), m_capacity(capacity)
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FrameArena::~FrameArena()
+{
+    reset();
+    free(m_data);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+    size_t current = m_offset.load(std::memory_order_relaxed);
+
+    while (true)
+    {
+        size_t offset = align_offset(m_data, current, alignment);
+
+        if (offset + size > m_capacity)
+            break;
+
+        if (m_offset.compare_exchange_weak(current, offset + size, std::memory_order_relaxed))
+            return m_data + offset;
+    }
+
+    // Out of space for this frame. Serve the request from the heap and remember how much was missing.
+    uint8_t* data = static_cast<uint8_t*>(malloc(size + alignment));
+
+    if (!data)
+        throw std::bad_alloc();
+
+    m_overflow_size.fetch_add(size + alignment, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    m_overflow.push_back(data);
+
+    return data + align_offset(data, 0, alignment);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void FrameArena::reset()
+{
+    for (auto ptr : m_overflow)
+        free(ptr);
+
+    m_overflow.clear();
+
+    size_t overflow_size = m_overflow_size.exchange(0, std::memory_order_relaxed);
+
+    if (overflow_size > 0)
+    {
+        size_t capacity = m_capacity + overflow_size;
+
+        // Grow in whole multiples of the default size to avoid growing again by a few bytes next frame.
+        capacity = ((capacity + FRAME_ARENA_SIZE - 1) / FRAME_ARENA_SIZE) * FRAME_ARENA_SIZE;
+
+        uint8_t* data = static_cast<uint8_t*>(malloc(capacity));
+
+        if (data)
+        {
+            free(m_data);
+
+            m_data     = data;
+            m_capacity = capacity;
+
+            DW_LOG_INFO("Frame arena grown to " + std::to_string(m_capacity / 1024) + " KB.");
+        }
+    }
+
+    m_offset.store(0, std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FixedSizePool::FixedSizePool(size_t block_size, size_t blocks_per_chunk) :
+    m_blocks_per_chunk(std::max(blocks_per_chunk, size_t(1)))
+{
+    // Every block has to be able to hold the free list link and stay aligned for any type.
+    const size_t alignment = alignof(std::max_align_t);
+
+    m_block_size = std::max(block_size, sizeof(void*));
+    m_block_size = ((m_block_size + alignment - 1) / alignment) * alignment;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FixedSizePool::~FixedSizePool()
+{
+    for (auto chunk : m_chunks)
+        free(chunk);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* FixedSizePool::allocate()
+{
+    if (!m_free_list)
+    {
+        uint8_t* chunk = static_cast<uint8_t*>(malloc(m_block_size * m_blocks_per_chunk));
+
+        if (!chunk)
+            throw std::bad_alloc();
+
+        m_chunks.push_back(chunk);
+
+        // Thread the new blocks onto the free list in address order.
+        for (size_t i = m_blocks_per_chunk; i > 0; i--)
+        {
+            void* block                 = chunk + (i - 1) * m_block_size;
+            *static_cast<void**>(block) = m_free_list;
+            m_free_list                 = block;
+        }
+    }
+
+    void* block = m_free_list;
+    m_free_list = *static_cast<void**>(block);
+
+    m_allocated_blocks++;
+
+    return block;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void FixedSizePool::deallocate(void* ptr)
+{
+    if (!ptr)
+        return;
+
+    *static_cast<void**>(ptr) = m_free_list;
+    m_free_list               = ptr;
+
+    m_allocated_blocks--;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+RangeAllocator::RangeAllocator(size_t capacity)
+{
+    reset(capacity);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RangeAllocator::reset(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_free.clear();
+    m_allocated.clear();
+
+    if (capacity > 0)
+        m_free[0] = capacity;
+
+    m_capacity = capacity;
+    m_used     = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t RangeAllocator::allocate(size_t size, size_t alignment)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size = std::max(size, size_t(1));
+
+    for (auto it = m_free.begin(); it != m_free.end(); it++)
+    {
+        size_t start   = it->first;
+        size_t end     = it->first + it->second;
+        size_t aligned = ((start + alignment - 1) / alignment) * alignment;
+
+        if (aligned + size > end)
+            continue;
+
+        // The padding in front stays free, as does whatever is left behind the allocation.
+        m_free.erase(it);
+
+        if (aligned > start)
+            m_free[start] = aligned - start;
+
+        if (aligned + size < end)
+            m_free[aligned + size] = end - aligned - size;
+
+        m_allocated[aligned] = size;
+        m_used += size;
+
+        return aligned;
+    }
+
+    return SIZE_MAX;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void RangeAllocator::deallocate(size_t offset)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto allocation = m_allocated.find(offset);
+
+    if (allocation == m_allocated.end())
+        return;
+
+    size_t size = allocation->second;
+
+    m_allocated.erase(allocation);
+    m_used -= size;
+
+    auto next = m_free.lower_bound(offset);
+
+    if (next != m_free.end() && next->first == offset + size)
+    {
+        size += next->second;
+        next = m_free.erase(next);
+    }
+
+    if (next != m_free.begin())
+    {
+        auto prev = std::prev(next);
+
+        if (prev->first + prev->second == offset)
+        {
+            prev->second += size;
+            return;
+        }
+    }
+
+    m_free[offset] = size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t RangeAllocator::used() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_used;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t RangeAllocator::capacity() const
+{
+    return m_capacity;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FrameArena& frame_arena()
+{
+    static FrameArena arena;
+    return arena;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+LinearAllocator& scratch_arena()
+{
+    thread_local LinearAllocator arena;
+    return arena;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void begin_frame()
+{
+    FrameArena& arena = frame_arena();
+
+    g_frame_stats.frame_arena_used     = arena.used();
+    g_frame_stats.frame_arena_capacity = arena.capacity();
+
+#if defined(DWSF_TRACK_ALLOCATIONS)
+    uint64_t allocation_count = g_allocation_count.load(std::memory_order_relaxed);
+    uint64_t allocated_bytes  = g_allocated_bytes.load(std::memory_order_relaxed);
+
+    g_frame_stats.allocations     = allocation_count - g_frame_start_allocation_count;
+    g_frame_stats.allocated_bytes = allocated_bytes - g_frame_start_allocated_bytes;
+
+    g_frame_start_allocation_count = allocation_count;
+    g_frame_start_allocated_bytes  = allocated_bytes;
+#endif
+
+    arena.reset();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+FrameStats frame_stats()
+{
+    return g_frame_stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace memory
+} // namespace dw
+
+#if defined(DWSF_TRACK_ALLOCATIONS)
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Counting replacements for the global allocation functions. The array and nothrow forms provided by the standard library
+// forward to these. Over-aligned allocations use their own functions and are not counted.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* operator new(size_t size)
+{
+    dw::memory::g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    dw::memory::g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* ptr = malloc(size > 0 ? size : 1);
+
+    if (!ptr)
+        throw std::bad_alloc();
+
+    return ptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+#endif
@@ -9,13 +9,28 @@
 #    include <backends/imgui_impl_opengl3.h>
 #endif
 #include <profiler.h>
+#include <jobs.h>
+#include <allocators.h>
+#include <vfs.h>
+#include <io.h>
 #include <iostream>
+#include <thread>
+#include <chrono>
 
 #if defined(__EMSCRIPTEN__)
 #    include <emscripten/emscripten.h>
 #endif
 
+#if defined(DWSF_EGL)
+#    define EGL_NO_X11
+#    include <EGL/egl.h>
+#    include <EGL/eglext.h>
+#endif
+
 #include "material.h"
+#include "downsampler.h"
+#include "staging_heap.h"
+#include "readback.h"
 #include "mesh.h"
 #include "utility.h"
 
@@ -110,7 +125,14 @@ void Application::run_frame(void* arg)
 Application::Application() :
     m_mouse_x(0.0), m_mouse_y(0.0), m_last_mouse_x(0.0), m_last_mouse_y(0.0),
     m_mouse_delta_x(0.0), m_mouse_delta_y(0.0), m_delta(0.0),
-    m_delta_seconds(0.0), m_window(nullptr) {}
+    m_delta_seconds(0.0), m_window(nullptr)
+{
+#if defined(DWSF_VULKAN)
+    m_frame_timeline_points.fill(vk::TimelinePoint());
+#elif !defined(__EMSCRIPTEN__)
+    m_frame_fences.fill(nullptr);
+#endif
+}
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
@@ -171,6 +193,26 @@ bool Application::init_base(int argc, const char* argv[])
     m_height        = settings.height;
     m_title         = settings.title;
 
+    m_headless            = settings.headless;
+    m_frame_count         = settings.frame_count;
+    m_capture_path        = settings.capture_path;
+    m_late_input_latching = settings.late_input_latching;
+
+    set_frames_in_flight(settings.frames_in_flight);
+    set_frame_rate_limit(settings.frame_rate_limit);
+
+    uint32_t worker_count = settings.worker_count;
+
+    if (worker_count == 0)
+        worker_count = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+
+    jobs::initialize(worker_count);
+
+    for (const auto& archive : settings.archives)
+        vfs::mount(archive);
+
+    io::initialize();
+
     int major_ver = 4;
 #if defined(__APPLE__)
     int         minor_ver          = 1;
@@ -184,77 +226,134 @@ bool Application::init_base(int argc, const char* argv[])
     const char* imgui_glsl_version = "#version 130";
 #endif
 
-    if (glfwInit() != GLFW_TRUE)
+    bool create_window = !m_headless;
+
+#if !defined(DWSF_VULKAN)
+    // Headless OpenGL prefers a surfaceless EGL pbuffer, and falls back to an invisible GLFW window with an OSMesa context.
+#    if defined(DWSF_EGL)
+    if (m_headless && !create_egl_context(major_ver, minor_ver))
+        create_window = true;
+#    else
+    create_window = true;
+#    endif
+#endif
+
+    if (create_window)
     {
-        DW_LOG_FATAL("Failed to initialize GLFW");
-        return false;
-    }
+#if defined(GLFW_PLATFORM_NULL)
+        // The null platform needs no display server, which is all a headless run has access to.
+        if (m_headless)
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+
+        if (glfwInit() != GLFW_TRUE)
+        {
+            DW_LOG_FATAL("Failed to initialize GLFW");
+            return false;
+        }
 
 #if defined(DWSF_VULKAN)
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 #else
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
 
 #    if !defined(__EMSCRIPTEN__)
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_SAMPLES, 8);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_SAMPLES, 8);
 #    endif
 
 #    if __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #    endif
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major_ver);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor_ver);
-    glfwSwapInterval(m_vsync ? 1 : 0);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major_ver);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor_ver);
+        glfwSwapInterval(m_vsync ? 1 : 0);
 #endif
-    glfwWindowHint(GLFW_RESIZABLE, false);
-    glfwWindowHint(GLFW_MAXIMIZED, maximized);
+        glfwWindowHint(GLFW_RESIZABLE, false);
+        glfwWindowHint(GLFW_MAXIMIZED, maximized);
 
-    m_window = glfwCreateWindow(m_width, m_height, m_title.c_str(), fullscreen ? glfwGetPrimaryMonitor() : nullptr, nullptr);
+        if (m_headless)
+        {
+            glfwWindowHint(GLFW_VISIBLE, false);
+            glfwWindowHint(GLFW_MAXIMIZED, false);
+#if defined(GLFW_PLATFORM_NULL) && !defined(DWSF_VULKAN)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+            glfwWindowHint(GLFW_SAMPLES, 0);
+#endif
+            fullscreen = false;
+        }
 
-    if (!m_window)
-    {
-        DW_LOG_FATAL("Failed to create GLFW window!");
-        return false;
-    }
+        m_window = glfwCreateWindow(m_width, m_height, m_title.c_str(), fullscreen ? glfwGetPrimaryMonitor() : nullptr, nullptr);
+
+        if (!m_window)
+        {
+            DW_LOG_FATAL("Failed to create GLFW window!");
+            return false;
+        }
 
-    glfwSetKeyCallback(m_window, key_callback_glfw);
-    glfwSetCursorPosCallback(m_window, mouse_callback_glfw);
-    glfwSetScrollCallback(m_window, scroll_callback_glfw);
-    glfwSetMouseButtonCallback(m_window, mouse_button_callback_glfw);
-    glfwSetCharCallback(m_window, char_callback_glfw);
-    glfwSetWindowSizeCallback(m_window, window_size_callback_glfw);
-    glfwSetWindowUserPointer(m_window, this);
+        glfwSetKeyCallback(m_window, key_callback_glfw);
+        glfwSetCursorPosCallback(m_window, mouse_callback_glfw);
+        glfwSetScrollCallback(m_window, scroll_callback_glfw);
+        glfwSetMouseButtonCallback(m_window, mouse_button_callback_glfw);
+        glfwSetCharCallback(m_window, char_callback_glfw);
+        glfwSetWindowSizeCallback(m_window, window_size_callback_glfw);
+        glfwSetWindowUserPointer(m_window, this);
 
-    glfwMakeContextCurrent(m_window);
+        glfwMakeContextCurrent(m_window);
+    }
 
     DW_LOG_INFO("Successfully initialized platform!");
 
 #if defined(DWSF_VULKAN)
-    m_vk_backend = vk::Backend::create(m_window,
-                                       m_vsync,
-                                       settings.srgb,
-                                       settings.enable_validation,
-                                       settings.enable_nsight_aftermath,
-                                       settings.ray_tracing,
-                                       settings.device_extensions);
+    if (m_headless)
+    {
+        m_vk_backend = vk::Backend::create_headless(m_width,
+                                                    m_height,
+                                                    settings.srgb,
+                                                    settings.enable_validation,
+                                                    settings.enable_nsight_aftermath,
+                                                    settings.ray_tracing,
+                                                    settings.device_extensions);
+    }
+    else
+    {
+        m_vk_backend = vk::Backend::create(m_window,
+                                           m_vsync,
+                                           settings.srgb,
+                                           settings.enable_validation,
+                                           settings.enable_nsight_aftermath,
+                                           settings.ray_tracing,
+                                           settings.device_extensions);
+    }
 
     m_title += " - " + std::string(m_vk_backend->physical_device_properties().deviceName);
 
-    glfwSetWindowTitle(m_window, m_title.c_str());
+    if (m_window)
+        glfwSetWindowTitle(m_window, m_title.c_str());
 
-    const uint32_t max_frames_in_flights = m_vk_backend->swap_image_count();
+    static_assert(MAX_FRAMES_IN_FLIGHT <= vk::Backend::kMaxFramesInFlight, "The backend must keep per-frame resources for every frame in flight.");
 
-    for (uint32_t i = 0; i < max_frames_in_flights; i++)
-    {
-        m_render_complete_fences.push_back(vk::Fence::create(m_vk_backend));
-        m_render_complete_semaphores.push_back(vk::Semaphore::create(m_vk_backend));
+    // Acquire semaphores follow the frame slot, render complete semaphores follow the swap chain image.
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
         m_present_complete_semaphores.push_back(vk::Semaphore::create(m_vk_backend));
-    }
 
+    for (uint32_t i = 0; i < m_vk_backend->swap_image_count(); i++)
+        m_render_complete_semaphores.push_back(vk::Semaphore::create(m_vk_backend));
+
+    Downsampler::initialize_common_resources(m_vk_backend);
+    StagingHeap::initialize_common_resources(m_vk_backend, settings.staging_heap_size);
+    Readback::initialize_common_resources(m_vk_backend, settings.readback_ring_size);
     Material::initialize_common_resources(m_vk_backend);
 #else
+#    if defined(DWSF_EGL)
+    if (m_egl_context)
+    {
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+            return false;
+    }
+    else
+#    endif
 #    if !defined(__EMSCRIPTEN__)
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
         return false;
@@ -268,13 +367,20 @@ bool Application::init_base(int argc, const char* argv[])
 
     glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
+#    if !defined(__EMSCRIPTEN__)
+    Downsampler::initialize_common_resources();
+    StagingHeap::initialize_common_resources(settings.staging_heap_size, settings.upload_budget);
+    Readback::initialize_common_resources(settings.readback_ring_size);
+    Material::initialize_common_resources();
+#    endif
 #endif
 
 #if defined(DWSF_IMGUI)
     ImGui::CreateContext();
 
 #    if defined(DWSF_VULKAN)
-    ImGui_ImplGlfw_InitForVulkan(m_window, false);
+    if (!m_headless)
+        ImGui_ImplGlfw_InitForVulkan(m_window, false);
 
     VkFormat swapchain_format = m_vk_backend->swap_chain_image_format();
 
@@ -305,17 +411,20 @@ bool Application::init_base(int argc, const char* argv[])
 
     ImGui_ImplVulkan_Init(&init_info);
 #    else
-    ImGui_ImplGlfw_InitForOpenGL(m_window, false);
+    if (!m_headless)
+        ImGui_ImplGlfw_InitForOpenGL(m_window, false);
+
     ImGui_ImplOpenGL3_Init(imgui_glsl_version);
 #    endif
 
     ImGui::StyleColorsDark();
 #endif
 
-    GLFWmonitor* primary = glfwGetPrimaryMonitor();
+    float xscale = 1.0f;
+    float yscale = 1.0f;
 
-    float xscale, yscale;
-    glfwGetMonitorContentScale(primary, &xscale, &yscale);
+    if (!m_headless)
+        glfwGetMonitorContentScale(glfwGetPrimaryMonitor(), &xscale, &yscale);
 
 #if defined(DWSF_IMGUI) && !defined(__APPLE__)
     ImGuiStyle* style = &ImGui::GetStyle();
@@ -326,10 +435,13 @@ bool Application::init_base(int argc, const char* argv[])
     io.FontGlobalScale = xscale > yscale ? xscale : yscale;
 #endif
 
-    int display_w, display_h;
-    glfwGetFramebufferSize(m_window, &display_w, &display_h);
-    m_width  = display_w;
-    m_height = display_h;
+    if (m_window)
+    {
+        int display_w, display_h;
+        glfwGetFramebufferSize(m_window, &display_w, &display_h);
+        m_width  = display_w;
+        m_height = display_h;
+    }
 
     if (!m_debug_draw.init(
 #if defined(DWSF_VULKAN)
@@ -347,6 +459,15 @@ bool Application::init_base(int argc, const char* argv[])
     if (!init(argc, argv))
         return false;
 
+    vfs::Stats stats = vfs::stats();
+
+    DW_LOG_INFO("Startup read " + std::to_string(stats.archive_reads) + " files (" + std::to_string(stats.archive_bytes / (1024 * 1024)) + " MB) from archives and " + std::to_string(stats.loose_reads) + " loose files (" + std::to_string(stats.loose_bytes / (1024 * 1024)) + " MB) in " + std::to_string(stats.read_time) + " ms.");
+
+    const TextureLoadStats& textures = Material::texture_load_stats();
+
+    if (textures.textures > 0)
+        DW_LOG_INFO("Startup loaded " + std::to_string(textures.textures) + " textures (" + std::to_string(textures.decoded_bytes / (1024 * 1024)) + " MB, " + std::to_string(textures.staged_bytes / (1024 * 1024)) + " MB decoded into the staging heap): decoding " + std::to_string(textures.decode_time) + " ms, uploads " + std::to_string(textures.upload_time) + " ms, " + std::to_string((textures.decode_time + textures.upload_time) / textures.textures) + " ms per texture. Peak RSS: " + std::to_string(utility::peak_resident_memory() / (1024 * 1024)) + " MB.");
+
     return true;
 }
 
@@ -366,6 +487,12 @@ void Application::shutdown_base()
     // Execute user-side shutdown method.
     shutdown();
 
+    // Outstanding reads hand their data to jobs, so the I/O service goes first.
+    io::shutdown();
+
+    // Finish outstanding jobs before the resources they may reference go away.
+    jobs::shutdown();
+
 #if defined(DWSF_VULKAN)
     // Shutdown debug draw.
 
@@ -374,13 +501,15 @@ void Application::shutdown_base()
 
     m_debug_draw.shutdown();
     Material::shutdown_common_resources();
+    Readback::shutdown_common_resources();
+    StagingHeap::shutdown_common_resources();
+    Downsampler::shutdown_common_resources();
 
     // Shutdown ImGui.
 #    if defined(DWSF_IMGUI)
     ImGui_ImplVulkan_Shutdown();
 #    endif
 
-    m_render_complete_fences.clear();
     m_render_complete_semaphores.clear();
     m_present_complete_semaphores.clear();
 
@@ -388,21 +517,45 @@ void Application::shutdown_base()
 #else
     // Shutdown debug draw.
     m_debug_draw.shutdown();
+    Material::shutdown_common_resources();
+    Readback::shutdown_common_resources();
+    StagingHeap::shutdown_common_resources();
+    Downsampler::shutdown_common_resources();
+
+#    if !defined(__EMSCRIPTEN__)
+    for (auto& fence : m_frame_fences)
+    {
+        if (fence)
+            glDeleteSync(fence);
+
+        fence = nullptr;
+    }
+#    endif
 
 #    if defined(DWSF_IMGUI)
     ImGui_ImplOpenGL3_Shutdown();
 #    endif
+
+#    if defined(DWSF_EGL)
+    destroy_egl_context();
+#    endif
 #endif
 
 #if defined(DWSF_IMGUI)
-    ImGui_ImplGlfw_Shutdown();
+    if (!m_headless)
+        ImGui_ImplGlfw_Shutdown();
+
     ImGui::DestroyContext();
 #endif
 
     // Shutdown GLFW.
-    glfwDestroyWindow(m_window);
+    if (m_window)
+        glfwDestroyWindow(m_window);
+
     glfwTerminate();
 
+    vfs::unmount_all();
+
     // Close logger streams.
     logger::close_file_stream();
     logger::close_console_stream();
@@ -421,16 +574,26 @@ void Application::render_gui(vk::CommandBuffer::Ptr cmd_buf)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Application::submit_and_present(const std::vector<vk::CommandBuffer::Ptr>& cmd_bufs)
+void Application::submit_and_present(const std::vector<vk::CommandBuffer::Ptr>& cmd_bufs, const std::vector<vk::TimelinePoint>& wait_points)
 {
-    const uint32_t semaphore_idx = m_frame_index % static_cast<uint32_t>(m_present_complete_semaphores.size());
-    const uint32_t fence_idx     = m_frame_index % static_cast<uint32_t>(m_render_complete_fences.size());
-    const uint32_t image_idx     = m_vk_backend->current_image_index();
+    const uint32_t frame_slot = m_frame_index % MAX_FRAMES_IN_FLIGHT;
+    const uint32_t image_idx  = m_vk_backend->current_image_index();
+
+    if (m_gpu_idle)
+        m_frame_timings.gpu_wait = m_gpu_idle_timer.elapsed_time_milisec();
 
-    m_vk_backend->submit_graphics(cmd_bufs,
-                                  { m_present_complete_semaphores[semaphore_idx] },
-                                  { m_render_complete_semaphores[image_idx] },
-                                  m_render_complete_fences[fence_idx]);
+    m_frame_timeline_points[frame_slot] = m_vk_backend->submit_graphics(cmd_bufs,
+                                                                        { m_present_complete_semaphores[frame_slot] },
+                                                                        { m_render_complete_semaphores[image_idx] },
+                                                                        nullptr,
+                                                                        wait_points);
+
+    // The swap chain image is only readable until it is presented.
+    if (!m_pending_capture_path.empty())
+    {
+        save_frame(m_pending_capture_path);
+        m_pending_capture_path.clear();
+    }
 
     m_vk_backend->present({ m_render_complete_semaphores[image_idx] });
 }
@@ -443,23 +606,21 @@ void Application::begin_frame()
 {
     m_timer.start();
 
-    glfwPollEvents();
+    m_frame_timings.gpu_wait = 0.0;
 
-#if defined(DWSF_VULKAN)
-    if (m_should_recreate_swap_chain)
-    {
-        m_vk_backend->recreate_swapchain(m_vsync);
-        m_should_recreate_swap_chain = false;
-    }
+    if (!m_late_input_latching && m_window)
+        glfwPollEvents();
 
-    const uint32_t semaphore_idx = m_frame_index % static_cast<uint32_t>(m_present_complete_semaphores.size());
-    const uint32_t fence_idx     = m_frame_index % static_cast<uint32_t>(m_render_complete_fences.size());
+    wait_for_frame_slot();
 
-    m_render_complete_fences[fence_idx]->wait_for_completion();
+    // Sampling input after the wait keeps it as close as possible to the start of simulation.
+    if (m_late_input_latching && m_window)
+        glfwPollEvents();
 
-    if (!m_vk_backend->acquire_next_swap_chain_image(m_present_complete_semaphores[semaphore_idx]))
-        m_vk_backend->recreate_swapchain(m_vsync);
+    if (m_frame_count > 0 && m_frame_index == m_frame_count - 1 && !m_capture_path.empty())
+        capture_frame(m_capture_path);
 
+#if defined(DWSF_VULKAN)
 #    if defined(DWSF_IMGUI)
     ImGui_ImplVulkan_NewFrame();
 #    endif
@@ -470,7 +631,17 @@ void Application::begin_frame()
 #endif
 
 #if defined(DWSF_IMGUI)
-    ImGui_ImplGlfw_NewFrame();
+    if (m_headless)
+    {
+        // Normally provided by the GLFW backend.
+        ImGuiIO& io = ImGui::GetIO();
+
+        io.DisplaySize = ImVec2(float(m_width), float(m_height));
+        io.DeltaTime   = m_delta_seconds > 0.0 ? float(m_delta_seconds) : 1.0f / 60.0f;
+    }
+    else
+        ImGui_ImplGlfw_NewFrame();
+
     ImGui::NewFrame();
 #endif
 
@@ -480,7 +651,17 @@ void Application::begin_frame()
     m_last_mouse_x = m_mouse_x;
     m_last_mouse_y = m_mouse_y;
 
+    // Runs the main thread jobs queued during the last frame.
+    jobs::begin_frame();
+    io::begin_frame();
+    memory::begin_frame();
     profiler::begin_frame();
+
+#if !defined(DWSF_VULKAN)
+    // Writes the texture uploads queued within the budget of the frame.
+    if (StagingHeap::created_common())
+        StagingHeap::created_common()->update();
+#endif
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -494,28 +675,357 @@ void Application::end_frame()
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 #    endif
-    glfwSwapBuffers(m_window);
+
+    if (m_gpu_idle)
+        m_frame_timings.gpu_wait = m_gpu_idle_timer.elapsed_time_milisec();
+
+    if (!m_pending_capture_path.empty())
+    {
+        save_frame(m_pending_capture_path);
+        m_pending_capture_path.clear();
+    }
+
+    // Headless contexts render into a single buffer that is never presented.
+    if (m_headless)
+        glFlush();
+    else
+        glfwSwapBuffers(m_window);
+
+#    if !defined(__EMSCRIPTEN__)
+    m_frame_fences[m_frame_index % MAX_FRAMES_IN_FLIGHT] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#    endif
+#else
+    if (!m_pending_capture_path.empty())
+    {
+        DW_LOG_WARNING("Frame capture skipped because the frame was never submitted: " + m_pending_capture_path);
+        m_pending_capture_path.clear();
+    }
 #endif
 
+    limit_frame_rate();
+
+    m_last_frame_timings = m_frame_timings;
+
+    profiler::report_frame_timings(m_last_frame_timings, m_frames_in_flight, m_late_input_latching);
+
     m_timer.stop();
     m_delta         = m_timer.elapsed_time_milisec();
     m_delta_seconds = m_timer.elapsed_time_sec();
 
+    if (Readback::created_common())
+        Readback::created_common()->end_frame();
+
     m_frame_index++;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void Application::wait_for_frame_slot()
+{
+    Timer wait_timer;
+
+    wait_timer.start();
+
+    // Frames up to (m_frame_index - m_frames_in_flight) must be complete before this one is recorded. The range always
+    // includes the frame that last used this slot, so its resources are free to be reused.
+    const uint32_t last_slot = (m_frame_index + MAX_FRAMES_IN_FLIGHT - 1) % MAX_FRAMES_IN_FLIGHT;
+
+#if defined(DWSF_VULKAN)
+    if (m_should_recreate_swap_chain)
+    {
+        m_vk_backend->recreate_swapchain(m_vsync);
+        m_should_recreate_swap_chain = false;
+    }
+
+    // Timeline values only grow, so reaching the newest frame of the range implies every older one has finished too.
+    m_vk_backend->wait(m_frame_timeline_points[(m_frame_index + MAX_FRAMES_IN_FLIGHT - m_frames_in_flight) % MAX_FRAMES_IN_FLIGHT]);
+
+    // Once the previous frame has finished the GPU has nothing left to do until this frame is submitted.
+    m_gpu_idle = m_vk_backend->is_complete(m_frame_timeline_points[last_slot]);
+
+    // Resources moved by defragmentation are swapped in before the frame records them.
+    if (m_vk_backend->memory_manager())
+        m_vk_backend->memory_manager()->update();
+
+    if (!m_vk_backend->acquire_next_swap_chain_image(m_present_complete_semaphores[m_frame_index % MAX_FRAMES_IN_FLIGHT]))
+        m_vk_backend->recreate_swapchain(m_vsync);
+#elif !defined(__EMSCRIPTEN__)
+    for (uint32_t distance = MAX_FRAMES_IN_FLIGHT; distance >= m_frames_in_flight; distance--)
+    {
+        GLsync& fence = m_frame_fences[(m_frame_index + MAX_FRAMES_IN_FLIGHT - distance) % MAX_FRAMES_IN_FLIGHT];
+
+        if (fence)
+        {
+            while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+                ;
+
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+
+    GLsync last_fence = m_frame_fences[last_slot];
+
+    m_gpu_idle = !last_fence || glClientWaitSync(last_fence, 0, 0) != GL_TIMEOUT_EXPIRED;
+#else
+    m_gpu_idle = false;
+#endif
+
+    m_frame_timings.cpu_wait = wait_timer.elapsed_time_milisec();
+
+    if (m_gpu_idle)
+        m_gpu_idle_timer.start();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::limit_frame_rate()
+{
+    m_frame_timings.limiter = 0.0;
+
+    if (m_frame_rate_limit <= 0.0)
+        return;
+
+    // Sleeping is only accurate to the scheduler granularity, so the last stretch is spent spinning.
+    const double kSpinThreshold = 2.0;
+    const double target         = 1000.0 / m_frame_rate_limit;
+
+    Timer limiter_timer;
+
+    limiter_timer.start();
+
+    double remaining = target - m_timer.elapsed_time_milisec();
+
+    if (remaining > kSpinThreshold)
+        std::this_thread::sleep_for(std::chrono::microseconds(int64_t((remaining - kSpinThreshold) * 1000.0)));
+
+    while (m_timer.elapsed_time_milisec() < target)
+        std::this_thread::yield();
+
+    m_frame_timings.limiter = limiter_timer.elapsed_time_milisec();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::set_frames_in_flight(uint32_t count)
+{
+    m_frames_in_flight = std::min(std::max(count, 1u), uint32_t(MAX_FRAMES_IN_FLIGHT));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::set_frame_rate_limit(double frames_per_second)
+{
+    m_frame_rate_limit = std::max(frames_per_second, 0.0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::capture_frame(const std::string& path)
+{
+    m_pending_capture_path = path;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Application::save_frame(const std::string& path)
+{
+    const bool           exr = utility::file_extension(path) == "exr";
+    std::vector<uint8_t> ldr_pixels;
+    std::vector<float>   hdr_pixels;
+
+#if defined(DWSF_VULKAN)
+    if (!m_vk_backend->read_back_swapchain_image(ldr_pixels))
+        return false;
+
+    const uint32_t width  = m_vk_backend->swap_chain_extents().width;
+    const uint32_t height = m_vk_backend->swap_chain_extents().height;
+
+    if (exr)
+    {
+        const VkFormat format = m_vk_backend->swap_chain_image_format();
+        const bool     srgb   = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB;
+
+        hdr_pixels.resize(ldr_pixels.size());
+
+        // EXR is expected to hold linear values, so undo the encoding of sRGB swap chains.
+        for (size_t i = 0; i < ldr_pixels.size(); i++)
+        {
+            float value = ldr_pixels[i] / 255.0f;
+
+            if (srgb && i % 4 != 3)
+                value = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+
+            hdr_pixels[i] = value;
+        }
+    }
+#else
+    const uint32_t width  = m_width;
+    const uint32_t height = m_height;
+
+    GLint read_framebuffer  = 0;
+    GLint pixel_pack_buffer = 0;
+
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+    glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pixel_pack_buffer);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if (exr)
+    {
+        hdr_pixels.resize(width * height * 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_FLOAT, hdr_pixels.data());
+    }
+    else
+    {
+        ldr_pixels.resize(width * height * 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, ldr_pixels.data());
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_pack_buffer);
+
+    // OpenGL returns the bottom row first.
+    for (uint32_t y = 0; y < height / 2; y++)
+    {
+        if (exr)
+            std::swap_ranges(hdr_pixels.begin() + y * width * 4, hdr_pixels.begin() + (y + 1) * width * 4, hdr_pixels.begin() + (height - 1 - y) * width * 4);
+        else
+            std::swap_ranges(ldr_pixels.begin() + y * width * 4, ldr_pixels.begin() + (y + 1) * width * 4, ldr_pixels.begin() + (height - 1 - y) * width * 4);
+    }
+#endif
+
+    bool result = exr ? utility::write_exr(path, width, height, hdr_pixels.data()) : utility::write_png(path, width, height, ldr_pixels.data());
+
+    if (result)
+        DW_LOG_INFO("Saved frame " + std::to_string(m_frame_index) + " to " + path);
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_EGL)
+bool Application::create_egl_context(int major_ver, int minor_ver)
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    // A surfaceless display needs no window system at all, which is the common case on CI machines running llvmpipe.
+#    if defined(EGL_PLATFORM_SURFACELESS_MESA)
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (get_platform_display)
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+#    endif
+
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        DW_LOG_WARNING("Failed to initialize EGL display.");
+        return false;
+    }
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+
+    const EGLint surface_attribs[] = {
+        EGL_WIDTH, EGLint(m_width),
+        EGL_HEIGHT, EGLint(m_height),
+        EGL_NONE
+    };
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major_ver,
+        EGL_CONTEXT_MINOR_VERSION, minor_ver,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config      = nullptr;
+    EGLint    num_configs = 0;
+
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs == 0 || !eglBindAPI(EGL_OPENGL_API))
+    {
+        DW_LOG_WARNING("No EGL config supports OpenGL pbuffers.");
+        eglTerminate(display);
+        return false;
+    }
+
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surface_attribs);
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+    {
+        DW_LOG_WARNING("Failed to create EGL pbuffer context.");
+
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+
+        eglTerminate(display);
+        return false;
+    }
+
+    m_egl_display = display;
+    m_egl_surface = surface;
+    m_egl_context = context;
+
+    DW_LOG_INFO("Created headless EGL pbuffer context.");
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Application::destroy_egl_context()
+{
+    if (!m_egl_display)
+        return;
+
+    eglMakeCurrent(m_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(m_egl_display, m_egl_context);
+    eglDestroySurface(m_egl_display, m_egl_surface);
+    eglTerminate(m_egl_display);
+
+    m_egl_display = nullptr;
+    m_egl_surface = nullptr;
+    m_egl_context = nullptr;
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Application::request_exit() const
 {
-    glfwSetWindowShouldClose(m_window, true);
+    if (m_window)
+        glfwSetWindowShouldClose(m_window, true);
+    else
+        m_exit_requested = true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 bool Application::exit_requested() const
 {
-    return glfwWindowShouldClose(m_window);
+    if (m_exit_requested || (m_frame_count > 0 && m_frame_index >= m_frame_count))
+        return true;
+
+    return m_window && glfwWindowShouldClose(m_window);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -548,6 +1058,57 @@ void Application::load_initial_settings_from_file(AppSettings& settings)
 
     if (j.find("vsync") != j.end())
         settings.vsync = j["vsync"];
+
+    // Named pacing profiles set defaults that the individual keys below can still override.
+    if (j.find("pacing_profile") != j.end())
+    {
+        std::string profile = j["pacing_profile"];
+
+        if (profile == "low_latency")
+        {
+            settings.frames_in_flight    = 1;
+            settings.late_input_latching = true;
+        }
+        else if (profile == "throughput")
+        {
+            settings.frames_in_flight    = MAX_FRAMES_IN_FLIGHT;
+            settings.late_input_latching = false;
+        }
+        else
+            DW_LOG_WARNING("Unknown pacing profile: " + profile);
+    }
+
+    if (j.find("frames_in_flight") != j.end())
+        settings.frames_in_flight = j["frames_in_flight"];
+
+    if (j.find("late_input_latching") != j.end())
+        settings.late_input_latching = j["late_input_latching"];
+
+    if (j.find("frame_rate_limit") != j.end())
+        settings.frame_rate_limit = j["frame_rate_limit"];
+
+    if (j.find("headless") != j.end())
+        settings.headless = j["headless"];
+
+    if (j.find("frame_count") != j.end())
+        settings.frame_count = j["frame_count"];
+
+    if (j.find("capture_path") != j.end())
+        settings.capture_path = j["capture_path"].get<std::string>();
+
+    if (j.find("worker_count") != j.end())
+        settings.worker_count = j["worker_count"];
+
+    if (j.find("archives") != j.end())
+        settings.archives = j["archives"].get<std::vector<std::string>>();
+
+    if (j.find("staging_heap_size") != j.end())
+        settings.staging_heap_size = j["staging_heap_size"];
+
+#if !defined(DWSF_VULKAN)
+    if (j.find("upload_budget") != j.end())
+        settings.upload_budget = j["upload_budget"];
+#endif
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
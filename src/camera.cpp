@@ -112,33 +112,15 @@ void Camera::update_from_frame(glm::vec3 position, glm::vec3 forward, glm::vec3
 
 bool Camera::aabb_inside_frustum(glm::vec3 max_v, glm::vec3 min_v)
 {
-    // m_model = glm::mat3(m_right, m_up, m_forward);
+    glm::vec3 center  = (max_v + min_v) * 0.5f;
+    glm::vec3 extents = (max_v - min_v) * 0.5f;
 
-    // m_near_plane.point = m_position - m_forward * m_near;
-    // if (!aabb_inside_plane(m_near_plane, max_v, min_v))
-    //	return false;
-
-    // m_far_plane.point = m_position - m_forward * m_far;
-    // if (!aabb_inside_plane(m_far_plane, max_v, min_v))
-    //	return false;
+    AABBBatch box     = { &center.x, &center.y, &center.z, &extents.x, &extents.y, &extents.z };
+    uint32_t  visible = 0;
 
-    // m_left_plane.point = m_position;
-    // if (!aabb_inside_plane(m_left_plane, max_v, min_v))
-    //	return false;
-
-    // m_right_plane.point = m_position;
-    // if (!aabb_inside_plane(m_right_plane, max_v, min_v))
-    //	return false;
+    cull_aabbs(m_frustum, box, 0, 1, &visible);
 
-    // m_top_plane.point = m_position;
-    // if (!aabb_inside_plane(m_top_plane, max_v, min_v))
-    //	return false;
-
-    // m_bottom_plane.point = m_position;
-    // if (!aabb_inside_plane(m_bottom_plane, max_v, min_v))
-    //	return false;
-
-    return true;
+    return visible != 0;
 }
 
 bool Camera::aabb_inside_plane(Plane plane, glm::vec3 max_v, glm::vec3 min_v)
@@ -1,10 +1,19 @@
 #include <debug_draw.h>
 #include <logger.h>
 #include <utility.h>
+#include <allocators.h>
+#include <atomic>
 #if defined(DWSF_VULKAN)
 #    include <vk_mem_alloc.h>
 #endif
 
+// Generated from src/shaders/debug_draw_instanced.vert at build time.
+#if defined(DWSF_VULKAN)
+#    include <debug_draw_instanced.spv.h>
+#else
+#    include <debug_draw_instanced.vert.h>
+#endif
+
 namespace dw
 {
 #if defined(DWSF_VULKAN)
@@ -934,13 +943,24 @@ const char* g_fs_src = R"(
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-DebugDraw::DebugDraw()
+static std::atomic<uint64_t> g_debug_draw_id(1);
+
+// Last buffer used by the current thread, along with the id of the DebugDraw instance that owns it. Ids are never reused,
+// and an instance takes a new one when its buffers are freed, so a cache is only trusted while its buffer is alive.
+struct ThreadBufferCache
 {
-    m_world_vertices.resize(MAX_VERTICES);
-    m_world_vertices.clear();
+    uint64_t owner_id = 0;
+    void*    buffer   = nullptr;
+};
 
-    m_draw_commands.resize(MAX_VERTICES);
-    m_draw_commands.clear();
+static thread_local ThreadBufferCache t_buffer_cache;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DebugDraw::DebugDraw() :
+    m_id(g_debug_draw_id++)
+{
+    create_primitive_meshes();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -953,7 +973,16 @@ bool DebugDraw::init(
 {
 #if defined(DWSF_VULKAN)
     create_uniform_buffer(backend);
-    create_vertex_buffer(backend);
+
+    for (uint32_t i = 0; i < vk::Backend::kMaxFramesInFlight; i++)
+    {
+        create_vertex_buffer(backend, i, DEBUG_DRAW_VERTEX_CHUNK_SIZE);
+        create_instance_buffer(backend, i, DEBUG_DRAW_INSTANCE_CHUNK_SIZE);
+    }
+
+    // Upload unit primitive meshes once
+    m_primitive_vbo = vk::Buffer::create(backend, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(glm::vec3) * m_primitive_vertices.size(), VMA_MEMORY_USAGE_GPU_ONLY, 0, m_primitive_vertices.data());
+
     create_descriptor_set_layout(backend);
     create_descriptor_set(backend);
     create_pipeline_states(backend);
@@ -976,18 +1005,36 @@ bool DebugDraw::init(
     // Bind uniform block index
     m_line_program->uniform_block_binding("CameraUniforms", 0);
 
-    // Create vertex buffer
-    m_line_vbo = gl::Buffer::create(GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT, sizeof(VertexWorld) * MAX_VERTICES);
+    // Create instanced primitive shader program
+    m_instance_vs = gl::Shader::create(GL_VERTEX_SHADER, kDEBUG_DRAW_INSTANCED_VERT_SOURCE);
 
-    // Declare vertex attributes
-    gl::VertexAttrib attribs[] = { { 3, GL_FLOAT, false, 0 },
-                                   { 2, GL_FLOAT, false, sizeof(float) * 3 },
-                                   { 3, GL_FLOAT, false, sizeof(float) * 5 } };
+    if (!m_instance_vs)
+    {
+        DW_LOG_FATAL("Failed to create Shaders");
+        return false;
+    }
 
-    // Create vertex array
-    m_line_vao = gl::VertexArray::create(m_line_vbo, nullptr, sizeof(float) * 8, 3, attribs);
+    m_instance_program = gl::Program::create({ m_instance_vs, m_line_fs });
+    m_instance_program->uniform_block_binding("CameraUniforms", 0);
+
+    // Instanced attributes start at the base instance of a draw with GL 4.2 or ARB_base_instance. WebGL 2 and older
+    // contexts have neither, so the attributes are pointed at the first instance of every draw instead.
+#    if defined(__EMSCRIPTEN__)
+    m_base_instance = false;
+#    else
+    m_base_instance = GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_base_instance;
+#    endif
+
+    // Create vertex buffer and vertex array
+    create_vertex_buffer(DEBUG_DRAW_VERTEX_CHUNK_SIZE);
 
-    if (!m_line_vao || !m_line_vbo)
+    // Upload unit primitive meshes once
+    m_primitive_vbo = gl::Buffer::create(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * m_primitive_vertices.size(), m_primitive_vertices.data());
+
+    // Create instance buffer and vertex array
+    create_instance_buffer(DEBUG_DRAW_INSTANCE_CHUNK_SIZE);
+
+    if (!m_line_vao || !m_line_vbo || !m_primitive_vbo || !m_instance_vbo)
     {
         DW_LOG_FATAL("Failed to create Vertex Buffers/Arrays");
         return false;
@@ -1005,100 +1052,133 @@ bool DebugDraw::init(
 void DebugDraw::shutdown()
 {
 #if defined(DWSF_VULKAN)
-    m_line_strip_depth_pipeline.reset();
-    m_line_strip_no_depth_pipeline.reset();
     m_line_depth_pipeline.reset();
     m_line_no_depth_pipeline.reset();
+    m_instance_depth_pipeline.reset();
+    m_instance_no_depth_pipeline.reset();
     m_pipeline_layout.reset();
     m_ds.reset();
     m_ds_layout.reset();
-#endif
+    m_primitive_vbo.reset();
+
+    for (uint32_t i = 0; i < vk::Backend::kMaxFramesInFlight; i++)
+    {
+        m_line_vbos[i].reset();
+        m_instance_vbos[i].reset();
+        m_vbo_capacity[i]      = 0;
+        m_instance_capacity[i] = 0;
+    }
+#else
+    if (m_instance_vao != 0)
+    {
+        glDeleteVertexArrays(1, &m_instance_vao);
+        m_instance_vao = 0;
+    }
+
+    m_instance_program.reset();
+    m_instance_vs.reset();
+    m_instance_vbo.reset();
+    m_primitive_vbo.reset();
+    m_instance_capacity = 0;
+    m_line_vao.reset();
     m_line_vbo.reset();
+    m_vbo_capacity = 0;
+#endif
     m_ubo.reset();
+
+    std::lock_guard<std::mutex> lock(m_thread_buffers_mutex);
+    m_thread_buffers.clear();
+
+    // The thread-local caches of every thread still point at the freed buffers, and only the current thread's could be
+    // reached from here. Moving to a new id makes all of them miss instead.
+    m_id = g_debug_draw_id++;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::begin_batch()
+void DebugDraw::set_depth_test(const bool& depth_test)
 {
-    m_batched_mode = true;
-    m_batch_start  = m_world_vertices.size();
-    m_batch_end    = m_world_vertices.size();
+    ThreadBuffer& buffer    = thread_buffer();
+    buffer.state.depth_test = depth_test;
+    buffer.current_batch    = -1;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::end_batch()
+bool DebugDraw::depth_test()
 {
-    m_batched_mode = false;
+    return thread_buffer().state.depth_test;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::capsule(const float& _height, const float& _radius, const glm::vec3& _pos, const glm::vec3& _c)
+void DebugDraw::set_distance_fade(const bool& fade)
 {
-    // Draw four lines
-    line(glm::vec3(_pos.x, _pos.y + _radius, _pos.z - _radius),
-         glm::vec3(_pos.x, _height - _radius, _pos.z - _radius),
-         _c);
-    line(glm::vec3(_pos.x, _pos.y + _radius, _pos.z + _radius),
-         glm::vec3(_pos.x, _height - _radius, _pos.z + _radius),
-         _c);
-    line(glm::vec3(_pos.x - _radius, _pos.y + _radius, _pos.z),
-         glm::vec3(_pos.x - _radius, _height - _radius, _pos.z),
-         _c);
-    line(glm::vec3(_pos.x + _radius, _pos.y + _radius, _pos.z),
-         glm::vec3(_pos.x + _radius, _height - _radius, _pos.z),
-         _c);
-
-    glm::vec3 verts[10];
-
-    int idx = 0;
-
-    for (int i = 0; i <= 180; i += 20)
-    {
-        float degInRad = glm::radians((float)i);
-        verts[idx++]   = glm::vec3(_pos.x + cos(degInRad) * _radius,
-                                 _height - _radius + sin(degInRad) * _radius,
-                                 _pos.z);
-    }
+    ThreadBuffer& buffer       = thread_buffer();
+    buffer.state.distance_fade = fade;
+    buffer.current_batch       = -1;
+}
 
-    line_strip(&verts[0], 10, _c);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    idx = 0;
+bool DebugDraw::distance_fade()
+{
+    return thread_buffer().state.distance_fade;
+}
 
-    for (int i = 0; i <= 180; i += 20)
-    {
-        float degInRad = glm::radians((float)i);
-        verts[idx++]   = glm::vec3(_pos.x, _height - _radius + sin(degInRad) * _radius, _pos.z + cos(degInRad) * _radius);
-    }
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    line_strip(&verts[0], 10, _c);
+void DebugDraw::set_fade_start(const float& fade)
+{
+    ThreadBuffer& buffer    = thread_buffer();
+    buffer.state.fade_start = fade;
+    buffer.current_batch    = -1;
+}
 
-    idx = 0;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    for (int i = 180; i <= 360; i += 20)
-    {
-        float degInRad = glm::radians((float)i);
-        verts[idx++]   = glm::vec3(_pos.x + cos(degInRad) * _radius,
-                                 _radius + sin(degInRad) * _radius,
-                                 _pos.z);
-    }
+float DebugDraw::fade_start()
+{
+    return thread_buffer().state.fade_start;
+}
 
-    line_strip(&verts[0], 10, _c);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    idx = 0;
+void DebugDraw::set_fade_end(const float& fade)
+{
+    ThreadBuffer& buffer  = thread_buffer();
+    buffer.state.fade_end = fade;
+    buffer.current_batch  = -1;
+}
 
-    for (int i = 180; i <= 360; i += 20)
-    {
-        float degInRad = glm::radians((float)i);
-        verts[idx++]   = glm::vec3(_pos.x, _radius + sin(degInRad) * _radius, _pos.z + cos(degInRad) * _radius);
-    }
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+float DebugDraw::fade_end()
+{
+    return thread_buffer().state.fade_end;
+}
 
-    line_strip(&verts[0], 10, _c);
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Builds a transform that scales a unit primitive and moves it to the given position.
+static inline glm::mat4 scale_translate(const glm::vec3& scale, const glm::vec3& pos)
+{
+    return glm::mat4(glm::vec4(scale.x, 0.0f, 0.0f, 0.0f),
+                     glm::vec4(0.0f, scale.y, 0.0f, 0.0f),
+                     glm::vec4(0.0f, 0.0f, scale.z, 0.0f),
+                     glm::vec4(pos, 1.0f));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DebugDraw::capsule(const float& _height, const float& _radius, const glm::vec3& _pos, const glm::vec3& _c)
+{
+    float bottom = _pos.y + _radius;
+    float top    = _height - _radius;
 
-    circle_xz(_radius, glm::vec3(_pos.x, _height - _radius, _pos.z), _c);
-    circle_xz(_radius, glm::vec3(_pos.x, _radius, _pos.z), _c);
+    primitive(DEBUG_PRIMITIVE_CYLINDER, scale_translate(glm::vec3(_radius, top - bottom, _radius), glm::vec3(_pos.x, bottom, _pos.z)), _c);
+    primitive(DEBUG_PRIMITIVE_HEMISPHERE, scale_translate(glm::vec3(_radius), glm::vec3(_pos.x, top, _pos.z)), _c);
+    primitive(DEBUG_PRIMITIVE_HEMISPHERE, scale_translate(glm::vec3(_radius, -_radius, _radius), glm::vec3(_pos.x, bottom, _pos.z)), _c);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -1110,60 +1190,43 @@ void DebugDraw::aabb(const glm::vec3& _min, const glm::vec3& _max, const glm::ve
     glm::vec3 min = _pos + _min;
     glm::vec3 max = _pos + _max;
 
-    begin_batch();
+    primitive(DEBUG_PRIMITIVE_BOX, scale_translate(max - min, (max + min) * 0.5f), _c);
+}
 
-    line(min, glm::vec3(max.x, min.y, min.z), _c);
-    line(glm::vec3(max.x, min.y, min.z), glm::vec3(max.x, min.y, max.z), _c);
-    line(glm::vec3(max.x, min.y, max.z), glm::vec3(min.x, min.y, max.z), _c);
-    line(glm::vec3(min.x, min.y, max.z), min, _c);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    line(glm::vec3(min.x, max.y, min.z), glm::vec3(max.x, max.y, min.z), _c);
-    line(glm::vec3(max.x, max.y, min.z), max, _c);
-    line(max, glm::vec3(min.x, max.y, max.z), _c);
-    line(glm::vec3(min.x, max.y, max.z), glm::vec3(min.x, max.y, min.z), _c);
+void DebugDraw::obb(const glm::vec3& _min, const glm::vec3& _max, const glm::mat4& _model, const glm::vec3& _c)
+{
+    primitive(DEBUG_PRIMITIVE_BOX, _model * scale_translate(_max - _min, (_max + _min) * 0.5f), _c);
+}
 
-    line(min, glm::vec3(min.x, max.y, min.z), _c);
-    line(glm::vec3(max.x, min.y, min.z), glm::vec3(max.x, max.y, min.z), _c);
-    line(glm::vec3(max.x, min.y, max.z), max, _c);
-    line(glm::vec3(min.x, min.y, max.z), glm::vec3(min.x, max.y, max.z), _c);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    end_batch();
+void DebugDraw::cone(const float& _height, const float& _radius, const glm::vec3& _pos, const glm::vec3& _c)
+{
+    primitive(DEBUG_PRIMITIVE_CONE, scale_translate(glm::vec3(_radius, _height, _radius), _pos), _c);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::obb(const glm::vec3& _min, const glm::vec3& _max, const glm::mat4& _model, const glm::vec3& _c)
+void DebugDraw::cylinder(const float& _height, const float& _radius, const glm::vec3& _pos, const glm::vec3& _c)
 {
-    glm::vec3 verts[8];
-    glm::vec3 size = _max - _min;
-    int       idx  = 0;
+    primitive(DEBUG_PRIMITIVE_CYLINDER, scale_translate(glm::vec3(_radius, _height, _radius), _pos), _c);
+}
 
-    for (float x = _min.x; x <= _max.x; x += size.x)
-    {
-        for (float y = _min.y; y <= _max.y; y += size.y)
-        {
-            for (float z = _min.z; z <= _max.z; z += size.z)
-            {
-                glm::vec4 v  = _model * glm::vec4(x, y, z, 1.0f);
-                verts[idx++] = glm::vec3(v.x, v.y, v.z);
-            }
-        }
-    }
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    line(verts[0], verts[1], _c);
-    line(verts[1], verts[5], _c);
-    line(verts[5], verts[4], _c);
-    line(verts[4], verts[0], _c);
+void DebugDraw::primitive(const DebugPrimitive& primitive, const glm::mat4& transform, const glm::vec3& c)
+{
+    DrawBatch& batch = current_batch(thread_buffer());
 
-    line(verts[2], verts[3], _c);
-    line(verts[3], verts[7], _c);
-    line(verts[7], verts[6], _c);
-    line(verts[6], verts[2], _c);
+    InstanceWorld instance;
 
-    line(verts[2], verts[0], _c);
-    line(verts[6], verts[4], _c);
-    line(verts[3], verts[1], _c);
-    line(verts[7], verts[5], _c);
+    instance.transform = transform;
+    instance.color     = c;
+    instance.primitive = primitive;
+
+    batch.instances.push_back(instance);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -1238,8 +1301,6 @@ void DebugDraw::grid(const glm::mat4& view_proj, const float& unit_size, const f
 
     float x = min_mod.x;
 
-    begin_batch();
-
     while (x < max_mod.x)
     {
         glm::vec3 color = glm::vec3(1.0f);
@@ -1280,218 +1341,504 @@ void DebugDraw::grid(const glm::mat4& view_proj, const float& unit_size, const f
 
     // Z-axis = Blue
     line(glm::vec3(min.x, 0.0f, 0.0f), glm::vec3(max.x, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-
-    end_batch();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void DebugDraw::line(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& c)
 {
-    if (m_world_vertices.size() < MAX_VERTICES)
-    {
-        VertexWorld vw0, vw1;
-        vw0.position = v0;
-        vw0.color    = c;
+    DrawBatch& batch = current_batch(thread_buffer());
 
-        vw1.position = v1;
-        vw1.color    = c;
+    VertexWorld vw0, vw1;
+    vw0.position = v0;
+    vw0.color    = c;
 
-        m_world_vertices.push_back(vw0);
-        m_world_vertices.push_back(vw1);
+    vw1.position = v1;
+    vw1.color    = c;
 
-        if (!m_batched_mode || m_batch_start == m_batch_end)
-        {
-            DrawCommand cmd;
+    batch.vertices.push_back(vw0);
+    batch.vertices.push_back(vw1);
+}
 
-            cmd.depth_test    = m_depth_test;
-            cmd.distance_fade = m_distance_fade;
-            cmd.fade_start    = m_fade_start;
-            cmd.fade_end      = m_fade_end;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-#if defined(DWSF_VULKAN)
-            cmd.type = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
-#else
-            cmd.type = GL_LINES;
-#endif
-            cmd.vertices = 2;
+void DebugDraw::line_strip(glm::vec3* v, const int& count, const glm::vec3& c)
+{
+    if (count < 2)
+        return;
 
-            m_draw_commands.push_back(cmd);
-        }
-        else
-        {
-            DrawCommand& cmd = m_draw_commands.back();
-            cmd.vertices += 2;
-        }
+    // Strips are expanded into line lists so that they can share a draw call with every other line.
+    DrawBatch& batch = current_batch(thread_buffer());
 
-        if (m_batched_mode)
-            m_batch_end = m_world_vertices.size();
+    size_t offset = batch.vertices.size();
+    batch.vertices.resize(offset + (count - 1) * 2);
+
+    VertexWorld* dst = &batch.vertices[offset];
+
+    for (int i = 0; i < count - 1; i++)
+    {
+        dst->position = v[i];
+        dst->color    = c;
+        dst++;
+
+        dst->position = v[i + 1];
+        dst->color    = c;
+        dst++;
     }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::line_strip(glm::vec3* v, const int& count, const glm::vec3& c)
+void DebugDraw::circle_xy(float radius, const glm::vec3& pos, const glm::vec3& c)
 {
-    for (int i = 0; i < count; i++)
-    {
-        VertexWorld vert;
-        vert.position = v[i];
-        vert.color    = c;
+    // Map the XZ unit circle onto the XY plane.
+    glm::mat4 transform = glm::mat4(glm::vec4(radius, 0.0f, 0.0f, 0.0f),
+                                    glm::vec4(0.0f, 0.0f, radius, 0.0f),
+                                    glm::vec4(0.0f, radius, 0.0f, 0.0f),
+                                    glm::vec4(pos, 1.0f));
 
-        m_world_vertices.push_back(vert);
-    }
+    primitive(DEBUG_PRIMITIVE_CIRCLE, transform, c);
+}
 
-    DrawCommand cmd;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    cmd.depth_test    = m_depth_test;
-    cmd.distance_fade = m_distance_fade;
-    cmd.fade_start    = m_fade_start;
-    cmd.fade_end      = m_fade_end;
+void DebugDraw::circle_xz(float radius, const glm::vec3& pos, const glm::vec3& c)
+{
+    primitive(DEBUG_PRIMITIVE_CIRCLE, scale_translate(glm::vec3(radius), pos), c);
+}
 
-#if defined(DWSF_VULKAN)
-    cmd.type = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
-#else
-    cmd.type = GL_LINE_STRIP;
-#endif
-    cmd.vertices = count;
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DebugDraw::circle_yz(float radius, const glm::vec3& pos, const glm::vec3& c)
+{
+    // Map the XZ unit circle onto the YZ plane.
+    glm::mat4 transform = glm::mat4(glm::vec4(0.0f, radius, 0.0f, 0.0f),
+                                    glm::vec4(radius, 0.0f, 0.0f, 0.0f),
+                                    glm::vec4(0.0f, 0.0f, radius, 0.0f),
+                                    glm::vec4(pos, 1.0f));
 
-    m_draw_commands.push_back(cmd);
+    primitive(DEBUG_PRIMITIVE_CIRCLE, transform, c);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::circle_xy(float radius, const glm::vec3& pos, const glm::vec3& c)
+void DebugDraw::sphere(const float& radius, const glm::vec3& pos, const glm::vec3& c)
 {
-    glm::vec3 verts[19];
+    primitive(DEBUG_PRIMITIVE_SPHERE, scale_translate(glm::vec3(radius), pos), c);
+}
 
-    int idx = 0;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    for (int i = 0; i <= 360; i += 20)
-    {
-        float degInRad = glm::radians((float)i);
-        verts[idx++]   = pos + glm::vec3(cos(degInRad) * radius, sin(degInRad) * radius, 0.0f);
-    }
+void DebugDraw::frustum(const glm::mat4& view_proj, const glm::vec3& c)
+{
+    primitive(DEBUG_PRIMITIVE_FRUSTUM, glm::inverse(view_proj), c);
+}
 
-    line_strip(&verts[0], 19, c);
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DebugDraw::frustum(const glm::mat4& proj, const glm::mat4& view, const glm::vec3& c)
+{
+    primitive(DEBUG_PRIMITIVE_FRUSTUM, glm::inverse(proj * view), c);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::circle_xz(float radius, const glm::vec3& pos, const glm::vec3& c)
+void DebugDraw::transform(const glm::mat4& trans, const float& axis_length)
 {
-    glm::vec3 verts[19];
+    glm::vec3 p = glm::vec3(trans[3][0], trans[3][1], trans[3][2]);
+    glm::vec3 x = glm::vec3(trans[0][0], trans[0][1], trans[0][2]);
+    glm::vec3 y = glm::vec3(trans[1][0], trans[1][1], trans[1][2]);
+    glm::vec3 z = glm::vec3(trans[2][0], trans[2][1], trans[2][2]);
 
-    int idx = 0;
+    // Draw X axis
+    line(p, p + x * axis_length, glm::vec3(1.0f, 0.0f, 0.0f));
 
-    for (int i = 0; i <= 360; i += 20)
-    {
-        float degInRad = glm::radians((float)i);
-        verts[idx++]   = pos + glm::vec3(cos(degInRad) * radius, 0.0f, sin(degInRad) * radius);
-    }
+    // Draw Y axis
+    line(p, p + y * axis_length, glm::vec3(0.0f, 1.0f, 0.0f));
 
-    line_strip(&verts[0], 19, c);
+    // Draw Z axis
+    line(p, p + z * axis_length, glm::vec3(0.0f, 0.0f, 1.0f));
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::circle_yz(float radius, const glm::vec3& pos, const glm::vec3& c)
+DebugDraw::ThreadBuffer& DebugDraw::thread_buffer()
 {
-    glm::vec3 verts[19];
+    if (t_buffer_cache.owner_id == m_id)
+        return *(ThreadBuffer*)t_buffer_cache.buffer;
+
+    std::thread::id thread_id = std::this_thread::get_id();
 
-    int idx = 0;
+    std::lock_guard<std::mutex> lock(m_thread_buffers_mutex);
 
-    for (int i = 0; i <= 360; i += 20)
+    ThreadBuffer* buffer = nullptr;
+
+    for (auto& b : m_thread_buffers)
     {
-        float degInRad = glm::radians((float)i);
-        verts[idx++]   = pos + glm::vec3(0.0f, cos(degInRad) * radius, sin(degInRad) * radius);
+        if (b->thread_id == thread_id)
+        {
+            buffer = b.get();
+            break;
+        }
+    }
+
+    if (!buffer)
+    {
+        std::unique_ptr<ThreadBuffer> new_buffer = std::make_unique<ThreadBuffer>();
+
+        new_buffer->thread_id           = thread_id;
+        new_buffer->state.depth_test    = false;
+        new_buffer->state.distance_fade = false;
+        new_buffer->state.fade_start    = 0.0f;
+        new_buffer->state.fade_end      = 0.0f;
+#if defined(DWSF_VULKAN)
+        new_buffer->state.type = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+#else
+        new_buffer->state.type = GL_LINES;
+#endif
+        new_buffer->state.vertices = 0;
+
+        buffer = new_buffer.get();
+        m_thread_buffers.push_back(std::move(new_buffer));
     }
 
-    line_strip(&verts[0], 19, c);
+    t_buffer_cache.owner_id = m_id;
+    t_buffer_cache.buffer   = buffer;
+
+    return *buffer;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::sphere(const float& radius, const glm::vec3& pos, const glm::vec3& c)
+DebugDraw::DrawBatch& DebugDraw::current_batch(ThreadBuffer& buffer)
 {
-    circle_xy(radius, pos, c);
-    circle_xz(radius, pos, c);
-    circle_yz(radius, pos, c);
+    if (buffer.current_batch != -1)
+        return buffer.batches[buffer.current_batch];
+
+    for (int32_t i = 0; i < buffer.batches.size(); i++)
+    {
+        if (buffer.batches[i].cmd.same_state(buffer.state))
+        {
+            buffer.current_batch = i;
+            return buffer.batches[i];
+        }
+    }
+
+    DrawBatch batch;
+    batch.cmd = buffer.state;
+
+    buffer.current_batch = buffer.batches.size();
+    buffer.batches.push_back(batch);
+
+    return buffer.batches.back();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::frustum(const glm::mat4& view_proj, const glm::vec3& c)
+size_t DebugDraw::merge_draw_commands()
 {
-    glm::mat4 inverse = glm::inverse(view_proj);
-    glm::vec3 corners[8];
+    m_draw_commands.clear();
 
-    for (int i = 0; i < 8; i++)
+    size_t total_vertices = 0;
+
+    for (auto& buffer : m_thread_buffers)
     {
-        glm::vec4 v = inverse * kFrustumCorners[i];
-        v           = v / v.w;
-        corners[i]  = glm::vec3(v.x, v.y, v.z);
-    }
+        for (auto& batch : buffer->batches)
+        {
+            if (batch.vertices.size() == 0)
+                continue;
 
-    glm::vec3 _far[5] = { corners[0], corners[1], corners[2], corners[3], corners[0] };
+            DrawCommand* merged = nullptr;
+
+            for (auto& cmd : m_draw_commands)
+            {
+                if (cmd.same_state(batch.cmd))
+                {
+                    merged = &cmd;
+                    break;
+                }
+            }
 
-    line_strip(&_far[0], 5, c);
+            if (!merged)
+            {
+                m_draw_commands.push_back(batch.cmd);
+                merged           = &m_draw_commands.back();
+                merged->vertices = 0;
+            }
 
-    glm::vec3 _near[5] = { corners[4], corners[5], corners[6], corners[7], corners[4] };
+            merged->vertices += batch.vertices.size();
+            total_vertices += batch.vertices.size();
+        }
+    }
 
-    line_strip(&_near[0], 5, c);
+    merge_instance_commands();
 
-    line(corners[0], corners[4], c);
-    line(corners[1], corners[5], c);
-    line(corners[2], corners[6], c);
-    line(corners[3], corners[7], c);
+    return total_vertices;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::frustum(const glm::mat4& proj, const glm::mat4& view, const glm::vec3& c)
+size_t DebugDraw::merge_instance_commands()
 {
-    glm::mat4 inverse = glm::inverse(proj * view);
-    glm::vec3 corners[8];
+    m_instance_commands.clear();
 
-    for (int i = 0; i < 8; i++)
+    // Count instances per draw state and primitive.
+    for (auto& buffer : m_thread_buffers)
     {
-        glm::vec4 v = inverse * kFrustumCorners[i];
-        v           = v / v.w;
-        corners[i]  = glm::vec3(v.x, v.y, v.z);
+        for (auto& batch : buffer->batches)
+        {
+            if (batch.instances.size() == 0)
+                continue;
+
+            uint32_t counts[DEBUG_PRIMITIVE_COUNT] = {};
+
+            for (auto& instance : batch.instances)
+                counts[instance.primitive]++;
+
+            for (uint32_t p = 0; p < DEBUG_PRIMITIVE_COUNT; p++)
+            {
+                if (counts[p] == 0)
+                    continue;
+
+                InstanceCommand* merged = nullptr;
+
+                for (auto& cmd : m_instance_commands)
+                {
+                    if (cmd.primitive == p && cmd.cmd.same_state(batch.cmd))
+                    {
+                        merged = &cmd;
+                        break;
+                    }
+                }
+
+                if (!merged)
+                {
+                    InstanceCommand cmd;
+
+                    cmd.cmd            = batch.cmd;
+                    cmd.primitive      = p;
+                    cmd.first_instance = 0;
+                    cmd.instance_count = 0;
+
+                    m_instance_commands.push_back(cmd);
+                    merged = &m_instance_commands.back();
+                }
+
+                merged->instance_count += counts[p];
+            }
+        }
     }
 
-    glm::vec3 _far[5] = { corners[0], corners[1], corners[2], corners[3], corners[0] };
+    // Assign each command its range of the merged instance list.
+    uint32_t total_instances = 0;
+
+    for (auto& cmd : m_instance_commands)
+    {
+        cmd.first_instance = total_instances;
+        total_instances += cmd.instance_count;
+    }
+
+    m_instances.resize(total_instances);
+
+    if (total_instances == 0)
+        return 0;
+
+    // Scatter instances into their ranges. The cursors are only needed during render(), so they live in the frame arena.
+    memory::FrameVector<uint32_t> cursors = memory::frame_vector<uint32_t>();
+
+    cursors.resize(m_instance_commands.size());
+
+    for (int i = 0; i < m_instance_commands.size(); i++)
+        cursors[i] = m_instance_commands[i].first_instance;
+
+    for (auto& buffer : m_thread_buffers)
+    {
+        for (auto& batch : buffer->batches)
+        {
+            if (batch.instances.size() == 0)
+                continue;
 
-    line_strip(&_far[0], 5, c);
+            int32_t command_indices[DEBUG_PRIMITIVE_COUNT];
 
-    glm::vec3 _near[5] = { corners[4], corners[5], corners[6], corners[7], corners[4] };
+            for (uint32_t p = 0; p < DEBUG_PRIMITIVE_COUNT; p++)
+            {
+                command_indices[p] = -1;
+
+                for (int i = 0; i < m_instance_commands.size(); i++)
+                {
+                    if (m_instance_commands[i].primitive == p && m_instance_commands[i].cmd.same_state(batch.cmd))
+                    {
+                        command_indices[p] = i;
+                        break;
+                    }
+                }
+            }
 
-    line_strip(&_near[0], 5, c);
+            for (auto& instance : batch.instances)
+                m_instances[cursors[command_indices[instance.primitive]]++] = instance;
+
+            // Keep the allocation around for the next frame.
+            batch.instances.clear();
+        }
+    }
 
-    line(corners[0], corners[4], c);
-    line(corners[1], corners[5], c);
-    line(corners[2], corners[6], c);
-    line(corners[3], corners[7], c);
+    return total_instances;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::transform(const glm::mat4& trans, const float& axis_length)
+void DebugDraw::copy_vertices(VertexWorld* dst)
 {
-    glm::vec3 p = glm::vec3(trans[3][0], trans[3][1], trans[3][2]);
-    glm::vec3 x = glm::vec3(trans[0][0], trans[0][1], trans[0][2]);
-    glm::vec3 y = glm::vec3(trans[1][0], trans[1][1], trans[1][2]);
-    glm::vec3 z = glm::vec3(trans[2][0], trans[2][1], trans[2][2]);
+    // Write offset of each merged draw command, in the same order as m_draw_commands.
+    memory::FrameVector<size_t> offsets = memory::frame_vector<size_t>();
 
-    // Draw X axis
-    line(p, p + x * axis_length, glm::vec3(1.0f, 0.0f, 0.0f));
+    offsets.resize(m_draw_commands.size());
 
-    // Draw Y axis
-    line(p, p + y * axis_length, glm::vec3(0.0f, 1.0f, 0.0f));
+    size_t offset = 0;
 
-    // Draw Z axis
-    line(p, p + z * axis_length, glm::vec3(0.0f, 0.0f, 1.0f));
+    for (int i = 0; i < m_draw_commands.size(); i++)
+    {
+        offsets[i] = offset;
+        offset += m_draw_commands[i].vertices;
+    }
+
+    for (auto& buffer : m_thread_buffers)
+    {
+        for (auto& batch : buffer->batches)
+        {
+            if (batch.vertices.size() == 0)
+                continue;
+
+            for (int i = 0; i < m_draw_commands.size(); i++)
+            {
+                if (m_draw_commands[i].same_state(batch.cmd))
+                {
+                    memcpy(dst + offsets[i], batch.vertices.data(), sizeof(VertexWorld) * batch.vertices.size());
+                    offsets[i] += batch.vertices.size();
+                    break;
+                }
+            }
+
+            // Keep the allocation around for the next frame.
+            batch.vertices.clear();
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DebugDraw::create_primitive_meshes()
+{
+    const int kCircleSegments = 18;
+
+    std::vector<glm::vec3>& v = m_primitive_vertices;
+
+    // Appends a line list approximating the arc [start_deg, end_deg] in the plane spanned by axis_a and axis_b.
+    auto add_arc = [&](const glm::vec3& center, const glm::vec3& axis_a, const glm::vec3& axis_b, float start_deg, float end_deg, int segments) {
+        for (int i = 0; i < segments; i++)
+        {
+            float t0 = glm::radians(start_deg + (end_deg - start_deg) * float(i) / float(segments));
+            float t1 = glm::radians(start_deg + (end_deg - start_deg) * float(i + 1) / float(segments));
+
+            v.push_back(center + axis_a * cosf(t0) + axis_b * sinf(t0));
+            v.push_back(center + axis_a * cosf(t1) + axis_b * sinf(t1));
+        }
+    };
+
+    // Appends the 12 edges of the box spanned by the 8 corners, ordered as kFrustumCorners.
+    auto add_box = [&](const glm::vec3* c) {
+        for (int i = 0; i < 4; i++)
+        {
+            v.push_back(c[i]);
+            v.push_back(c[(i + 1) % 4]);
+
+            v.push_back(c[4 + i]);
+            v.push_back(c[4 + (i + 1) % 4]);
+
+            v.push_back(c[i]);
+            v.push_back(c[4 + i]);
+        }
+    };
+
+    const glm::vec3 x_axis = glm::vec3(1.0f, 0.0f, 0.0f);
+    const glm::vec3 y_axis = glm::vec3(0.0f, 1.0f, 0.0f);
+    const glm::vec3 z_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+    const glm::vec3 origin = glm::vec3(0.0f);
+
+    glm::vec3 corners[8];
+
+    for (uint32_t p = 0; p < DEBUG_PRIMITIVE_COUNT; p++)
+    {
+        m_primitive_first_vertex[p] = v.size();
+
+        switch (p)
+        {
+            case DEBUG_PRIMITIVE_BOX:
+            {
+                for (int i = 0; i < 8; i++)
+                    corners[i] = glm::vec3(kFrustumCorners[i]) * 0.5f;
+
+                add_box(corners);
+                break;
+            }
+            case DEBUG_PRIMITIVE_SPHERE:
+            {
+                add_arc(origin, x_axis, y_axis, 0.0f, 360.0f, kCircleSegments);
+                add_arc(origin, x_axis, z_axis, 0.0f, 360.0f, kCircleSegments);
+                add_arc(origin, y_axis, z_axis, 0.0f, 360.0f, kCircleSegments);
+                break;
+            }
+            case DEBUG_PRIMITIVE_CIRCLE:
+            {
+                add_arc(origin, x_axis, z_axis, 0.0f, 360.0f, kCircleSegments);
+                break;
+            }
+            case DEBUG_PRIMITIVE_HEMISPHERE:
+            {
+                add_arc(origin, x_axis, y_axis, 0.0f, 180.0f, kCircleSegments / 2);
+                add_arc(origin, z_axis, y_axis, 0.0f, 180.0f, kCircleSegments / 2);
+                break;
+            }
+            case DEBUG_PRIMITIVE_CYLINDER:
+            {
+                add_arc(origin, x_axis, z_axis, 0.0f, 360.0f, kCircleSegments);
+                add_arc(y_axis, x_axis, z_axis, 0.0f, 360.0f, kCircleSegments);
+
+                for (int i = 0; i < 4; i++)
+                {
+                    float     t = glm::radians(90.0f * i);
+                    glm::vec3 b = x_axis * cosf(t) + z_axis * sinf(t);
+
+                    v.push_back(b);
+                    v.push_back(b + y_axis);
+                }
+                break;
+            }
+            case DEBUG_PRIMITIVE_CONE:
+            {
+                add_arc(origin, x_axis, z_axis, 0.0f, 360.0f, kCircleSegments);
+
+                for (int i = 0; i < 4; i++)
+                {
+                    float t = glm::radians(90.0f * i);
+
+                    v.push_back(x_axis * cosf(t) + z_axis * sinf(t));
+                    v.push_back(y_axis);
+                }
+                break;
+            }
+            case DEBUG_PRIMITIVE_FRUSTUM:
+            {
+                for (int i = 0; i < 8; i++)
+                    corners[i] = glm::vec3(kFrustumCorners[i]);
+
+                add_box(corners);
+                break;
+            }
+        }
+
+        m_primitive_vertex_count[p] = v.size() - m_primitive_first_vertex[p];
+    }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -1499,91 +1846,147 @@ void DebugDraw::transform(const glm::mat4& trans, const float& axis_length)
 #if defined(DWSF_VULKAN)
 void DebugDraw::render(vk::Backend::Ptr backend, vk::CommandBuffer::Ptr cmd_buffer, int width, int height, const glm::mat4& view_proj, const glm::vec3& view_pos)
 {
-    if (m_world_vertices.size() > 0)
+    std::lock_guard<std::mutex> lock(m_thread_buffers_mutex);
+
+    size_t vertex_count   = merge_draw_commands();
+    size_t instance_count = m_instances.size();
+
+    if (vertex_count > 0 || instance_count > 0)
     {
+        uint32_t frame_idx = backend->current_frame_idx();
+
+        // The buffers for this frame are no longer in use by the GPU at this point, so they can be safely replaced.
+        if (vertex_count > m_vbo_capacity[frame_idx])
+            create_vertex_buffer(backend, frame_idx, vertex_count);
+
+        if (instance_count > m_instance_capacity[frame_idx])
+            create_instance_buffer(backend, frame_idx, instance_count);
+
         m_uniforms.view_proj = view_proj;
 
         uint8_t* ptr = (uint8_t*)m_ubo->mapped_ptr();
-        memcpy(ptr + m_ubo_size * backend->current_frame_idx(), &m_uniforms, sizeof(CameraUniforms));
+        memcpy(ptr + m_ubo_size * frame_idx, &m_uniforms, sizeof(CameraUniforms));
 
-        ptr = (uint8_t*)m_line_vbo->mapped_ptr();
+        if (vertex_count > 0)
+            copy_vertices((VertexWorld*)m_line_vbos[frame_idx]->mapped_ptr());
 
-        if (m_world_vertices.size() > MAX_VERTICES)
-            DW_LOG_ERROR("Vertex count above allowed limit!");
-        else
-            memcpy(ptr + m_vbo_size * backend->current_frame_idx(), &m_world_vertices[0], sizeof(VertexWorld) * m_world_vertices.size());
+        if (instance_count > 0)
+            memcpy(m_instance_vbos[frame_idx]->mapped_ptr(), m_instances.data(), sizeof(InstanceWorld) * instance_count);
 
-        const uint32_t dynamic_offset = m_ubo_size * backend->current_frame_idx();
+        const uint32_t dynamic_offset = m_ubo_size * frame_idx;
 
         vkCmdBindDescriptorSets(cmd_buffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout->handle(), 0, 1, &m_ds->handle(), 1, &dynamic_offset);
 
-        const VkDeviceSize vbo_offset = m_vbo_size * backend->current_frame_idx();
-        vkCmdBindVertexBuffers(cmd_buffer->handle(), 0, 1, &m_line_vbo->handle(), &vbo_offset);
-
-        int v = 0;
-
-        for (int i = 0; i < m_draw_commands.size(); i++)
+        // Line lists
+        if (vertex_count > 0)
         {
-            DrawCommand& cmd = m_draw_commands[i];
+            const VkDeviceSize vbo_offset = 0;
+            vkCmdBindVertexBuffers(cmd_buffer->handle(), 0, 1, &m_line_vbos[frame_idx]->handle(), &vbo_offset);
 
-            VkPipeline pipeline;
+            int v = 0;
 
-            if (cmd.type == VK_PRIMITIVE_TOPOLOGY_LINE_LIST)
+            for (int i = 0; i < m_draw_commands.size(); i++)
             {
+                DrawCommand& cmd = m_draw_commands[i];
+
                 if (cmd.depth_test)
-                    pipeline = m_line_depth_pipeline->handle();
+                    vkCmdBindPipeline(cmd_buffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_line_depth_pipeline->handle());
                 else
-                    pipeline = m_line_no_depth_pipeline->handle();
+                    vkCmdBindPipeline(cmd_buffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_line_no_depth_pipeline->handle());
+
+                glm::vec4 params[2];
+
+                params[0] = glm::vec4(view_pos, 0.0f);
+                params[1] = glm::vec4(cmd.distance_fade ? cmd.fade_start : -1.0f, cmd.fade_end, 0.0f, 0.0f);
+
+                vkCmdPushConstants(cmd_buffer->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
+
+                vkCmdDraw(cmd_buffer->handle(), cmd.vertices, 1, v, 0);
+                v += cmd.vertices;
             }
-            else
+        }
+
+        // Primitive instances
+        if (instance_count > 0)
+        {
+            const VkBuffer     vbos[]        = { m_primitive_vbo->handle(), m_instance_vbos[frame_idx]->handle() };
+            const VkDeviceSize vbo_offsets[] = { 0, 0 };
+
+            vkCmdBindVertexBuffers(cmd_buffer->handle(), 0, 2, vbos, vbo_offsets);
+
+            for (int i = 0; i < m_instance_commands.size(); i++)
             {
-                if (cmd.depth_test)
-                    pipeline = m_line_strip_depth_pipeline->handle();
-                else
-                    pipeline = m_line_strip_no_depth_pipeline->handle();
-            }
+                InstanceCommand& cmd = m_instance_commands[i];
 
-            vkCmdBindPipeline(cmd_buffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+                if (cmd.cmd.depth_test)
+                    vkCmdBindPipeline(cmd_buffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_instance_depth_pipeline->handle());
+                else
+                    vkCmdBindPipeline(cmd_buffer->handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, m_instance_no_depth_pipeline->handle());
 
-            glm::vec4 params[2];
+                glm::vec4 params[2];
 
-            params[0] = glm::vec4(view_pos, 0.0f);
-            params[1] = glm::vec4(cmd.distance_fade ? cmd.fade_start : -1.0f, cmd.fade_end, 0.0f, 0.0f);
+                params[0] = glm::vec4(view_pos, 0.0f);
+                params[1] = glm::vec4(cmd.cmd.distance_fade ? cmd.cmd.fade_start : -1.0f, cmd.cmd.fade_end, 0.0f, 0.0f);
 
-            vkCmdPushConstants(cmd_buffer->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
+                vkCmdPushConstants(cmd_buffer->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(params), &params);
 
-            vkCmdDraw(cmd_buffer->handle(), cmd.vertices, 1, v, 0);
-            v += cmd.vertices;
+                vkCmdDraw(cmd_buffer->handle(), m_primitive_vertex_count[cmd.primitive], cmd.instance_count, m_primitive_first_vertex[cmd.primitive], cmd.first_instance);
+            }
         }
 
         m_draw_commands.clear();
-        m_world_vertices.clear();
+        m_instance_commands.clear();
+        m_instances.clear();
     }
 }
 #else
 void DebugDraw::render(gl::Framebuffer::Ptr fbo, int width, int height, const glm::mat4& view_proj, const glm::vec3& view_pos)
 {
-    if (m_world_vertices.size() > 0)
+    std::lock_guard<std::mutex> lock(m_thread_buffers_mutex);
+
+    size_t vertex_count   = merge_draw_commands();
+    size_t instance_count = m_instances.size();
+
+    if (vertex_count > 0 || instance_count > 0)
     {
         m_uniforms.view_proj = view_proj;
 
+        if (vertex_count > 0)
+        {
+            if (vertex_count > m_vbo_capacity)
+                create_vertex_buffer(vertex_count);
+
 #    if defined(__EMSCRIPTEN__)
-        void* ptr            = m_line_vbo->map(0);
+            void* ptr = m_line_vbo->map(0);
 #    else
-        void* ptr = m_line_vbo->map(GL_WRITE_ONLY);
+            void* ptr = m_line_vbo->map(GL_WRITE_ONLY);
 #    endif
 
-        if (m_world_vertices.size() > MAX_VERTICES)
-            DW_LOG_ERROR("Vertex count above allowed limit!");
-        else
-            memcpy(ptr, &m_world_vertices[0], sizeof(VertexWorld) * m_world_vertices.size());
+            copy_vertices((VertexWorld*)ptr);
+
+            m_line_vbo->unmap();
+        }
+
+        if (instance_count > 0)
+        {
+            if (instance_count > m_instance_capacity)
+                create_instance_buffer(instance_count);
 
-        m_line_vbo->unmap();
+#    if defined(__EMSCRIPTEN__)
+            void* ptr = m_instance_vbo->map(0);
+#    else
+            void* ptr = m_instance_vbo->map(GL_WRITE_ONLY);
+#    endif
+
+            memcpy(ptr, m_instances.data(), sizeof(InstanceWorld) * instance_count);
+
+            m_instance_vbo->unmap();
+        }
 
 #    if defined(__EMSCRIPTEN__)
-        ptr = m_ubo->map(0);
+        void* ptr = m_ubo->map(0);
 #    else
-        ptr       = m_ubo->map(GL_WRITE_ONLY);
+        void* ptr = m_ubo->map(GL_WRITE_ONLY);
 #    endif
 
         memcpy(ptr, &m_uniforms, sizeof(CameraUniforms));
@@ -1617,40 +2020,90 @@ void DebugDraw::render(gl::Framebuffer::Ptr fbo, int width, int height, const gl
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
         glViewport(0, 0, width, height);
-        m_line_program->use();
         m_ubo->bind_base(0);
-        m_line_vao->bind();
 
-        int v = 0;
+        // Line lists
+        if (vertex_count > 0)
+        {
+            m_line_program->use();
+            m_line_vao->bind();
+
+            int v = 0;
+
+            for (int i = 0; i < m_draw_commands.size(); i++)
+            {
+                DrawCommand& cmd = m_draw_commands[i];
+
+                if (cmd.distance_fade)
+                    glEnable(GL_BLEND);
+                else
+                    glDisable(GL_BLEND);
+
+                if (cmd.depth_test)
+                    glEnable(GL_DEPTH_TEST);
+                else
+                    glDisable(GL_DEPTH_TEST);
+
+                glm::vec4 params[2];
+
+                params[0] = glm::vec4(view_pos, 0.0f);
+                params[1] = glm::vec4(cmd.distance_fade ? cmd.fade_start : -1.0f, cmd.fade_end, 0.0f, 0.0f);
 
-        for (int i = 0; i < m_draw_commands.size(); i++)
+                m_line_program->set_uniform("camera_pos", params[0]);
+                m_line_program->set_uniform("fade_params", params[1]);
+
+                glDrawArrays(cmd.type, v, cmd.vertices);
+                v += cmd.vertices;
+            }
+        }
+
+        // Primitive instances
+        if (instance_count > 0)
         {
-            DrawCommand& cmd = m_draw_commands[i];
+            m_instance_program->use();
+            glBindVertexArray(m_instance_vao);
+
+            for (int i = 0; i < m_instance_commands.size(); i++)
+            {
+                InstanceCommand& cmd = m_instance_commands[i];
 
-            if (cmd.distance_fade)
-                glEnable(GL_BLEND);
-            else
-                glDisable(GL_BLEND);
+                if (cmd.cmd.distance_fade)
+                    glEnable(GL_BLEND);
+                else
+                    glDisable(GL_BLEND);
+
+                if (cmd.cmd.depth_test)
+                    glEnable(GL_DEPTH_TEST);
+                else
+                    glDisable(GL_DEPTH_TEST);
 
-            if (cmd.depth_test)
-                glEnable(GL_DEPTH_TEST);
-            else
-                glDisable(GL_DEPTH_TEST);
+                glm::vec4 params[2];
 
-            glm::vec4 params[2];
+                params[0] = glm::vec4(view_pos, 0.0f);
+                params[1] = glm::vec4(cmd.cmd.distance_fade ? cmd.cmd.fade_start : -1.0f, cmd.cmd.fade_end, 0.0f, 0.0f);
 
-            params[0] = glm::vec4(view_pos, 0.0f);
-            params[1] = glm::vec4(cmd.distance_fade ? cmd.fade_start : -1.0f, cmd.fade_end, 0.0f, 0.0f);
+                m_instance_program->set_uniform("camera_pos", params[0]);
+                m_instance_program->set_uniform("fade_params", params[1]);
 
-            m_line_program->set_uniform("camera_pos", params[0]);
-            m_line_program->set_uniform("fade_params", params[1]);
+                if (m_base_instance)
+                {
+#    if !defined(__EMSCRIPTEN__)
+                    glDrawArraysInstancedBaseInstance(GL_LINES, m_primitive_first_vertex[cmd.primitive], m_primitive_vertex_count[cmd.primitive], cmd.instance_count, cmd.first_instance);
+#    endif
+                }
+                else
+                {
+                    bind_instance_attributes(cmd.first_instance);
+                    glDrawArraysInstanced(GL_LINES, m_primitive_first_vertex[cmd.primitive], m_primitive_vertex_count[cmd.primitive], cmd.instance_count);
+                }
+            }
 
-            glDrawArrays(cmd.type, v, cmd.vertices);
-            v += cmd.vertices;
+            glBindVertexArray(0);
         }
 
         m_draw_commands.clear();
-        m_world_vertices.clear();
+        m_instance_commands.clear();
+        m_instances.clear();
 
         // Restore state
         //glBindBuffer(GL_ARRAY_BUFFER, last_array_buffer);
@@ -1678,6 +2131,74 @@ void DebugDraw::render(gl::Framebuffer::Ptr fbo, int width, int height, const gl
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+#if !defined(DWSF_VULKAN)
+void DebugDraw::create_vertex_buffer(size_t vertex_count)
+{
+    size_t chunks = (vertex_count + DEBUG_DRAW_VERTEX_CHUNK_SIZE - 1) / DEBUG_DRAW_VERTEX_CHUNK_SIZE;
+
+    m_vbo_capacity = chunks * DEBUG_DRAW_VERTEX_CHUNK_SIZE;
+    m_line_vbo     = gl::Buffer::create(GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT, sizeof(VertexWorld) * m_vbo_capacity);
+
+    // Declare vertex attributes
+    gl::VertexAttrib attribs[] = { { 3, GL_FLOAT, false, 0 },
+                                   { 2, GL_FLOAT, false, sizeof(float) * 3 },
+                                   { 3, GL_FLOAT, false, sizeof(float) * 5 } };
+
+    // The vertex array references the buffer, so it has to be recreated along with it.
+    m_line_vao = gl::VertexArray::create(m_line_vbo, nullptr, sizeof(float) * 8, 3, attribs);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DebugDraw::create_instance_buffer(size_t instance_count)
+{
+    size_t chunks = (instance_count + DEBUG_DRAW_INSTANCE_CHUNK_SIZE - 1) / DEBUG_DRAW_INSTANCE_CHUNK_SIZE;
+
+    m_instance_capacity = chunks * DEBUG_DRAW_INSTANCE_CHUNK_SIZE;
+    m_instance_vbo      = gl::Buffer::create(GL_ARRAY_BUFFER, GL_MAP_WRITE_BIT, sizeof(InstanceWorld) * m_instance_capacity);
+
+    if (m_instance_vao == 0)
+        glGenVertexArrays(1, &m_instance_vao);
+
+    glBindVertexArray(m_instance_vao);
+
+    // Per-vertex unit primitive position
+    m_primitive_vbo->bind();
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid*)0);
+
+    // Per-instance transform columns and color
+    bind_instance_attributes(0);
+
+    glBindVertexArray(0);
+
+    m_instance_vbo->unbind();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DebugDraw::bind_instance_attributes(uint32_t first_instance)
+{
+    size_t offset = sizeof(InstanceWorld) * first_instance;
+
+    m_instance_vbo->bind();
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        glEnableVertexAttribArray(1 + i);
+        glVertexAttribPointer(1 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceWorld), (GLvoid*)(offset + offsetof(InstanceWorld, transform) + sizeof(glm::vec4) * i));
+        glVertexAttribDivisor(1 + i, 1);
+    }
+
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceWorld), (GLvoid*)(offset + offsetof(InstanceWorld, color)));
+    glVertexAttribDivisor(5, 1);
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 #if defined(DWSF_VULKAN)
 void DebugDraw::create_descriptor_set_layout(vk::Backend::Ptr backend)
 {
@@ -1723,10 +2244,22 @@ void DebugDraw::create_uniform_buffer(vk::Backend::Ptr backend)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void DebugDraw::create_vertex_buffer(vk::Backend::Ptr backend)
+void DebugDraw::create_vertex_buffer(vk::Backend::Ptr backend, uint32_t frame_idx, size_t vertex_count)
 {
-    m_vbo_size = sizeof(VertexWorld) * MAX_VERTICES;
-    m_line_vbo = vk::Buffer::create(backend, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, m_vbo_size * dw::vk::Backend::kMaxFramesInFlight, VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    size_t chunks = (vertex_count + DEBUG_DRAW_VERTEX_CHUNK_SIZE - 1) / DEBUG_DRAW_VERTEX_CHUNK_SIZE;
+
+    m_vbo_capacity[frame_idx] = chunks * DEBUG_DRAW_VERTEX_CHUNK_SIZE;
+    m_line_vbos[frame_idx]    = vk::Buffer::create(backend, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, sizeof(VertexWorld) * m_vbo_capacity[frame_idx], VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DebugDraw::create_instance_buffer(vk::Backend::Ptr backend, uint32_t frame_idx, size_t instance_count)
+{
+    size_t chunks = (instance_count + DEBUG_DRAW_INSTANCE_CHUNK_SIZE - 1) / DEBUG_DRAW_INSTANCE_CHUNK_SIZE;
+
+    m_instance_capacity[frame_idx] = chunks * DEBUG_DRAW_INSTANCE_CHUNK_SIZE;
+    m_instance_vbos[frame_idx]     = vk::Buffer::create(backend, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, sizeof(InstanceWorld) * m_instance_capacity[frame_idx], VMA_MEMORY_USAGE_CPU_TO_GPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -1901,30 +2434,42 @@ void DebugDraw::create_pipeline_states(vk::Backend::Ptr backend)
     m_line_no_depth_pipeline = dw::vk::GraphicsPipeline::create(backend, pso_desc);
 
     // ---------------------------------------------------------------------------
-    // Create line strip depth test enable pipeline
+    // Create instanced primitive pipelines
     // ---------------------------------------------------------------------------
 
-    ds_state.set_depth_test_enable(VK_TRUE)
-        .set_depth_write_enable(VK_TRUE);
+    spirv.resize(sizeof(kDEBUG_DRAW_INSTANCED_VERT_SPIRV));
+    memcpy(&spirv[0], &kDEBUG_DRAW_INSTANCED_VERT_SPIRV[0], sizeof(kDEBUG_DRAW_INSTANCED_VERT_SPIRV));
 
-    pso_desc.set_depth_stencil_state(ds_state);
+    dw::vk::ShaderModule::Ptr instance_vs = dw::vk::ShaderModule::create(backend, spirv);
 
-    input_assembly_state_desc.set_topology(VK_PRIMITIVE_TOPOLOGY_LINE_STRIP);
+    pso_desc.shader_stage_count = 0;
 
-    pso_desc.set_input_assembly_state(input_assembly_state_desc);
+    pso_desc.add_shader_stage(VK_SHADER_STAGE_VERTEX_BIT, instance_vs, "main")
+        .add_shader_stage(VK_SHADER_STAGE_FRAGMENT_BIT, fs, "main");
 
-    m_line_strip_depth_pipeline = dw::vk::GraphicsPipeline::create(backend, pso_desc);
+    // Per-vertex unit primitive position, per-instance transform columns and color.
+    vk::VertexInputStateDesc instance_input_state_desc;
 
-    // ---------------------------------------------------------------------------
-    // Create depth  list test disabled pipeline
-    // ---------------------------------------------------------------------------
+    instance_input_state_desc.add_binding_desc(0, sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX);
+    instance_input_state_desc.add_binding_desc(1, sizeof(InstanceWorld), VK_VERTEX_INPUT_RATE_INSTANCE);
 
-    ds_state.set_depth_test_enable(VK_FALSE)
-        .set_depth_write_enable(VK_FALSE);
+    instance_input_state_desc.add_attribute_desc(0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0);
+
+    for (uint32_t i = 0; i < 4; i++)
+        instance_input_state_desc.add_attribute_desc(1 + i, 1, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(InstanceWorld, transform) + sizeof(glm::vec4) * i);
+
+    instance_input_state_desc.add_attribute_desc(5, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceWorld, color));
+
+    pso_desc.set_vertex_input_state(instance_input_state_desc);
+
+    m_instance_no_depth_pipeline = dw::vk::GraphicsPipeline::create(backend, pso_desc);
+
+    ds_state.set_depth_test_enable(VK_TRUE)
+        .set_depth_write_enable(VK_TRUE);
 
     pso_desc.set_depth_stencil_state(ds_state);
 
-    m_line_strip_no_depth_pipeline = dw::vk::GraphicsPipeline::create(backend, pso_desc);
+    m_instance_depth_pipeline = dw::vk::GraphicsPipeline::create(backend, pso_desc);
 }
 #endif
 
@@ -1,6 +1,12 @@
 #include <demo_player.h>
+#include <utility.h>
+#include <vfs.h>
+#include <logger.h>
 #include <imgui.h>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
 
 namespace dw
 {
@@ -44,6 +50,31 @@ void CubicSpline::initialize()
 
     for (int k = 0; k < m_points.size() - 1; k++)
         m_lengths[k] = simpsons_rule_single_spline(k, 1);
+
+    build_arc_length_table();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CubicSpline::build_arc_length_table()
+{
+    int num_splines = m_points.size() - 1;
+
+    m_arc_length_table.resize(num_splines * kArcLengthSamplesPerSpline + 1);
+
+    float spline_start = 0.0f;
+
+    for (int k = 0; k < num_splines; k++)
+    {
+        m_arc_length_table[k * kArcLengthSamplesPerSpline] = spline_start;
+
+        for (int j = 1; j < kArcLengthSamplesPerSpline; j++)
+            m_arc_length_table[k * kArcLengthSamplesPerSpline + j] = spline_start + simpsons_rule_single_spline(k, float(j) / float(kArcLengthSamplesPerSpline));
+
+        spline_start += m_lengths[k];
+    }
+
+    m_arc_length_table[num_splines * kArcLengthSamplesPerSpline] = spline_start;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -171,50 +202,70 @@ float CubicSpline::simpsons_rule(float t0, float t1)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-glm::vec3 CubicSpline::const_velocity_spline_at_time(float t, float speed)
+float CubicSpline::parameter_at_distance(float distance, uint32_t* hint)
 {
-    float l                = total_length();
-    float desired_distance = fmod(t * speed, l);
+    const uint32_t last_sample = m_arc_length_table.size() - 1;
 
-    float t_last = m_points.size() * desired_distance / l;
+    if (distance <= 0.0f)
+        return 0.0f;
 
-    if (t_last > (m_points.size() - 1))
-        t_last = 0.0f;
+    if (distance >= m_arc_length_table[last_sample])
+        return float(m_points.size() - 1);
 
-    float t_next = t_last;
+    // Find the table interval containing the distance. Start from the hint if the distance lies ahead of it.
+    auto first = m_arc_length_table.begin();
 
-    auto g = [this, desired_distance](float t) -> float {
-        return simpsons_rule(0, t) - desired_distance;
-    };
+    if (hint && *hint < last_sample && m_arc_length_table[*hint] <= distance)
+        first += *hint;
 
-    auto L = [this](float t) -> float {
-        return arc_length_integrand(t);
-    };
+    uint32_t sample = std::upper_bound(first, m_arc_length_table.end(), distance) - m_arc_length_table.begin() - 1;
 
-    float t_max = m_points.size();
-    float t_min = -0.1f;
+    if (hint)
+        *hint = sample;
 
-    while (t_max - t_min > 0.5f)
+    int   spline      = sample / kArcLengthSamplesPerSpline;
+    float local_start = float(sample % kArcLengthSamplesPerSpline) / float(kArcLengthSamplesPerSpline);
+    float local_end   = local_start + 1.0f / float(kArcLengthSamplesPerSpline);
+
+    // Linear estimate within the interval, refined with Newton iterations on the local arc-length. The interval is
+    // short enough for a three point Simpson's rule to be accurate.
+    float interval_length = m_arc_length_table[sample + 1] - m_arc_length_table[sample];
+    float remaining       = distance - m_arc_length_table[sample];
+    float t               = local_start + (local_end - local_start) * (interval_length > 0.0f ? remaining / interval_length : 0.0f);
+
+    for (int i = 0; i < 2; i++)
     {
-        float t_mid = (t_max + t_min) / 2;
-        if (g(t_min) * g(t_mid) < 0)
-            t_max = t_mid;
-        else
-            t_min = t_mid;
+        float mid    = (local_start + t) * 0.5f;
+        float length = (t - local_start) / 6.0f * (arc_length_integrand_single_spline(spline, local_start) + 4.0f * arc_length_integrand_single_spline(spline, mid) + arc_length_integrand_single_spline(spline, t));
+        float speed  = arc_length_integrand_single_spline(spline, t);
+
+        if (speed <= 0.0f)
+            break;
+
+        t = glm::clamp(t - (length - remaining) / speed, local_start, local_end);
     }
 
-    t_next = (t_max + t_min) / 2;
+    return float(spline) + t;
+}
 
-    do
-    {
-        t_last = t_next;
-        t_next = t_last - g(t_last) / L(t_last);
-    } while (fabs(t_last - t_next) > 0.001f);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    // Because of root finding it may be slightly negative sometimes.
-    assert(t_next >= -0.1f && t_next <= 999999);
+glm::vec3 CubicSpline::const_velocity_spline_at_time(float t, float speed)
+{
+    float desired_distance = fmod(t * speed, total_length());
 
-    return spline_at_time(t_next);
+    return spline_at_time(parameter_at_distance(desired_distance));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CubicSpline::const_velocity_spline_at_times(const float* times, uint32_t count, float speed, glm::vec3* positions)
+{
+    float    l    = total_length();
+    uint32_t hint = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+        positions[i] = spline_at_time(parameter_at_distance(fmod(times[i] * speed, l), &hint));
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -229,6 +280,9 @@ float CubicSpline::current_distance(float t, float speed)
 
 float CubicSpline::total_length()
 {
+    if (m_arc_length_table.size() > 0)
+        return m_arc_length_table.back();
+
     float sum = 0;
 
     for (int k = 0; k < m_lengths.size(); k++)
@@ -264,6 +318,200 @@ glm::vec3 LerpSpline::value_at_time(float t)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void CameraPathTrack::add_key(const CameraPathKey& key)
+{
+    times.push_back(key.time);
+    fovs.push_back(key.fov);
+    speeds.push_back(key.speed);
+    positions.push_back(key.position);
+    forwards.push_back(key.forward);
+    rights.push_back(key.right);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CameraPathTrack::reserve(uint32_t count)
+{
+    times.reserve(count);
+    fovs.reserve(count);
+    speeds.reserve(count);
+    positions.reserve(count);
+    forwards.reserve(count);
+    rights.reserve(count);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t CameraPathTrack::key_count()
+{
+    return positions.size();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+CameraPathRecorder::~CameraPathRecorder()
+{
+    end();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool CameraPathRecorder::begin(const std::string& path, const std::string& track_name)
+{
+    end();
+
+    m_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+
+    if (m_file.is_open())
+    {
+        CameraPathHeader header;
+
+        if (!m_file.read((char*)&header, sizeof(header)) || header.magic != CAMERA_PATH_MAGIC || header.version != CAMERA_PATH_VERSION || header.key_size != sizeof(CameraPathKey))
+        {
+            DW_LOG_ERROR("Cannot append recording to incompatible camera path file: " + path);
+            m_file.close();
+            return false;
+        }
+
+        // Walk the track chunks to find where the last complete one ends.
+        m_file.seekg(0, std::ios::end);
+
+        std::streamoff size   = m_file.tellg();
+        std::streamoff offset = sizeof(header);
+
+        while (size - offset >= std::streamoff(sizeof(CameraPathTrackHeader)))
+        {
+            CameraPathTrackHeader track;
+
+            m_file.seekg(offset);
+            m_file.read((char*)&track, sizeof(track));
+
+            std::streamoff available = (size - offset - sizeof(track)) / header.key_size;
+
+            // A track left open by an interrupted recording owns every key up to the end of the file. Close it with the
+            // keys that were written, so that it does not take in the keys of the track appended after it.
+            if (track.key_count == CAMERA_PATH_KEY_COUNT_UNKNOWN)
+            {
+                DW_LOG_WARNING("Closing camera path track left open by an interrupted recording: " + path);
+
+                uint32_t key_count = uint32_t(available);
+
+                m_file.seekp(offset + std::streamoff(offsetof(CameraPathTrackHeader, key_count)));
+                m_file.write((char*)&key_count, sizeof(uint32_t));
+            }
+            else if (track.key_count > available)
+            {
+                DW_LOG_ERROR("Cannot append recording to truncated camera path file: " + path);
+                m_file.close();
+                return false;
+            }
+            else
+                available = track.key_count;
+
+            offset += sizeof(track) + available * header.key_size;
+        }
+
+        // Anything past the last complete track is a partially written key, which is shorter than the track header
+        // written over it next.
+        m_file.seekp(offset);
+    }
+    else
+    {
+        m_file.clear();
+        m_file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!m_file.is_open())
+        {
+            DW_LOG_ERROR("Failed to create camera path file: " + path);
+            return false;
+        }
+
+        CameraPathHeader header = { CAMERA_PATH_MAGIC, CAMERA_PATH_VERSION, sizeof(CameraPathKey), 0 };
+        m_file.write((char*)&header, sizeof(header));
+    }
+
+    CameraPathTrackHeader track = {};
+
+    strncpy(&track.name[0], track_name.c_str(), CAMERA_PATH_TRACK_NAME_SIZE - 1);
+    track.key_count = CAMERA_PATH_KEY_COUNT_UNKNOWN;
+    track.flags     = CAMERA_PATH_TRACK_TIMED;
+
+    m_track_offset = m_file.tellp();
+    m_file.write((char*)&track, sizeof(track));
+
+    m_key_count = 0;
+    m_time      = 0.0f;
+    m_pending_keys.clear();
+    m_pending_keys.reserve(kFlushKeyCount);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CameraPathRecorder::record(float dt, Camera* camera)
+{
+    if (!m_file.is_open())
+        return;
+
+    CameraPathKey key;
+
+    if (m_key_count + m_pending_keys.size() > 0)
+        m_time += dt / 1000;
+
+    key.time     = m_time;
+    key.fov      = camera->m_fov;
+    key.speed    = 0.0f;
+    key.position = camera->m_position;
+    key.forward  = camera->m_forward;
+    key.right    = camera->m_right;
+
+    if (dt > 0.0f && m_key_count + m_pending_keys.size() > 0)
+        key.speed = glm::length(camera->m_position - m_last_position) / (dt / 1000);
+
+    m_last_position = camera->m_position;
+    m_pending_keys.push_back(key);
+
+    if (m_pending_keys.size() >= kFlushKeyCount)
+        flush();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CameraPathRecorder::end()
+{
+    if (!m_file.is_open())
+        return;
+
+    flush();
+
+    // Patch the key count now that the track is complete.
+    m_file.seekp(m_track_offset + std::streamoff(offsetof(CameraPathTrackHeader, key_count)));
+    m_file.write((char*)&m_key_count, sizeof(uint32_t));
+    m_file.close();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool CameraPathRecorder::is_recording()
+{
+    return m_file.is_open();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void CameraPathRecorder::flush()
+{
+    if (m_pending_keys.size() == 0)
+        return;
+
+    m_file.write((char*)m_pending_keys.data(), sizeof(CameraPathKey) * m_pending_keys.size());
+    m_key_count += m_pending_keys.size();
+    m_pending_keys.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 DemoPlayer::DemoPlayer()
 {
 }
@@ -272,94 +520,336 @@ DemoPlayer::DemoPlayer()
 
 DemoPlayer::DemoPlayer(const std::vector<glm::vec3>& position_frames, const std::vector<glm::vec3>& forward_frames, const std::vector<glm::vec3>& right_frames)
 {
-    m_position_spline.add_points(position_frames);
-    m_forward_spline.add_points(forward_frames);
-    m_right_spline.add_points(right_frames);
+    CameraPathTrack track;
+
+    track.name      = "default";
+    track.positions = position_frames;
+    track.forwards  = forward_frames;
+    track.rights    = right_frames;
+    track.times.resize(position_frames.size(), 0.0f);
+    track.fovs.resize(position_frames.size(), 0.0f);
+    track.speeds.resize(position_frames.size(), 0.0f);
+
+    m_tracks.push_back(track);
+    select_track(0u);
+}
 
-    if (m_position_spline.m_points.size() > 4)
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DemoPlayer::~DemoPlayer()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DemoPlayer::load_from_file(const std::string& path)
+{
+    vfs::File file;
+
+    if (!vfs::read(path, file))
     {
-        m_position_spline.initialize();
-        initialize_debug();
+        DW_LOG_ERROR("Failed to open camera path: " + path);
+        return false;
+    }
+
+    const uint8_t* data = file.data();
+    size_t         size = file.size();
+
+    m_tracks.clear();
+    m_current_track = -1;
+    m_path          = path;
+
+    CameraPathHeader header = {};
+
+    if (size >= sizeof(header))
+        memcpy(&header, data, sizeof(header));
+
+    if (header.magic != CAMERA_PATH_MAGIC)
+    {
+        if (!load_legacy(data, size))
+        {
+            DW_LOG_ERROR("Invalid camera path file: " + path);
+            return false;
+        }
+
+        return select_track(0u);
+    }
+
+    if (header.version != CAMERA_PATH_VERSION)
+    {
+        DW_LOG_ERROR("Unsupported camera path version " + std::to_string(header.version) + ": " + path);
+        return false;
+    }
+
+    // Newer versions may grow the key, so only the prefix known to this build is read.
+    if (header.key_size < sizeof(CameraPathKey))
+    {
+        DW_LOG_ERROR("Invalid camera path key size: " + path);
+        return false;
+    }
+
+    size_t offset = sizeof(header);
+
+    while (size - offset >= sizeof(CameraPathTrackHeader))
+    {
+        CameraPathTrackHeader track_header;
+
+        memcpy(&track_header, data + offset, sizeof(track_header));
+        offset += sizeof(track_header);
+
+        size_t   available = (size - offset) / header.key_size;
+        uint32_t count     = track_header.key_count;
+
+        if (count == CAMERA_PATH_KEY_COUNT_UNKNOWN)
+        {
+            DW_LOG_WARNING("Camera path track was not closed properly, recovering keys: " + path);
+            count = available;
+        }
+        else if (count > available)
+        {
+            DW_LOG_ERROR("Camera path track is truncated: " + path);
+            break;
+        }
+
+        CameraPathTrack track;
+
+        track_header.name[CAMERA_PATH_TRACK_NAME_SIZE - 1] = '\0';
+
+        track.name  = track_header.name;
+        track.flags = track_header.flags;
+        track.reserve(count);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            CameraPathKey key;
+
+            memcpy(&key, data + offset, sizeof(key));
+            offset += header.key_size;
+
+            track.add_key(key);
+        }
+
+        m_tracks.push_back(std::move(track));
+    }
+
+    if (m_tracks.size() == 0)
+    {
+        DW_LOG_ERROR("Camera path contains no tracks: " + path);
+        return false;
     }
+
+    return select_track(0u);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-DemoPlayer::~DemoPlayer()
+bool DemoPlayer::load_legacy(const uint8_t* data, size_t size)
 {
+    // Legacy files are a key count followed by position, forward and right arrays.
+    uint32_t count = 0;
+
+    if (size < sizeof(uint32_t))
+        return false;
+
+    memcpy(&count, data, sizeof(uint32_t));
+
+    size_t array_size = sizeof(glm::vec3) * size_t(count);
+
+    if (size != sizeof(uint32_t) + array_size * 3)
+        return false;
+
+    CameraPathTrack track;
+
+    track.name = "default";
+    track.positions.resize(count);
+    track.forwards.resize(count);
+    track.rights.resize(count);
+    track.times.resize(count, 0.0f);
+    track.fovs.resize(count, 0.0f);
+    track.speeds.resize(count, 0.0f);
+
+    data += sizeof(uint32_t);
+
+    memcpy(track.positions.data(), data, array_size);
+    memcpy(track.forwards.data(), data + array_size, array_size);
+    memcpy(track.rights.data(), data + array_size * 2, array_size);
+
+    m_tracks.push_back(std::move(track));
+
+    return true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-bool DemoPlayer::load_from_file()
+bool DemoPlayer::save_to_file(const std::string& path)
 {
-    std::fstream f("camera_path.bin", std::ios::in | std::ios::binary);
+    std::fstream f(path, std::ios::out | std::ios::binary | std::ios::trunc);
 
     if (!f.is_open())
+    {
+        DW_LOG_ERROR("Failed to open camera path for writing: " + path);
         return false;
+    }
 
-    long offset = 0;
-    f.seekp(offset);
+    CameraPathHeader header = { CAMERA_PATH_MAGIC, CAMERA_PATH_VERSION, sizeof(CameraPathKey), 0 };
 
-    size_t size = sizeof(uint32_t);
+    f.write((char*)&header, sizeof(header));
 
-    uint32_t count = 0;
+    std::vector<CameraPathKey> keys;
+
+    for (auto& track : m_tracks)
+    {
+        CameraPathTrackHeader track_header = {};
+
+        strncpy(&track_header.name[0], track.name.c_str(), CAMERA_PATH_TRACK_NAME_SIZE - 1);
+        track_header.key_count = track.key_count();
+        track_header.flags     = track.flags;
+
+        keys.resize(track.key_count());
+
+        for (uint32_t i = 0; i < keys.size(); i++)
+        {
+            keys[i].time     = track.times[i];
+            keys[i].fov      = track.fovs[i];
+            keys[i].speed    = track.speeds[i];
+            keys[i].position = track.positions[i];
+            keys[i].forward  = track.forwards[i];
+            keys[i].right    = track.rights[i];
+        }
+
+        f.write((char*)&track_header, sizeof(track_header));
+        f.write((char*)keys.data(), sizeof(CameraPathKey) * keys.size());
+    }
+
+    if (!f)
+    {
+        DW_LOG_ERROR("Failed to write camera path: " + path);
+        return false;
+    }
+
+    m_path = path;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DemoPlayer::select_track(uint32_t index)
+{
+    if (index >= m_tracks.size())
+        return false;
+
+    m_current_track = index;
+    rebuild_splines();
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DemoPlayer::select_track(const std::string& name)
+{
+    for (uint32_t i = 0; i < m_tracks.size(); i++)
+    {
+        if (m_tracks[i].name == name)
+            return select_track(i);
+    }
 
-    f.read((char*)&count, size);
-    offset += size;
-    f.seekg(offset);
+    return false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    size = sizeof(glm::vec3) * count;
+uint32_t DemoPlayer::track_count()
+{
+    return m_tracks.size();
+}
 
-    std::vector<glm::vec3> buffer(count);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    f.read((char*)buffer.data(), size);
-    offset += size;
-    f.seekg(offset);
+bool DemoPlayer::start_recording(const std::string& path, const std::string& track_name)
+{
+    return m_recorder.begin(path, track_name);
+}
 
-    for (int i = 0; i < count; i++)
-        m_position_spline.add_point(buffer[i]);
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DemoPlayer::stop_recording()
+{
+    m_recorder.end();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool DemoPlayer::is_recording()
+{
+    return m_recorder.is_recording();
+}
 
-    f.read((char*)buffer.data(), size);
-    offset += size;
-    f.seekg(offset);
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    for (int i = 0; i < count; i++)
-        m_forward_spline.add_point(buffer[i]);
+void DemoPlayer::rebuild_splines()
+{
+    m_position_spline = CubicSpline();
+    m_forward_spline.m_points.clear();
+    m_right_spline.m_points.clear();
+    m_debug_spline_segments.clear();
+    m_key_hint = 0;
 
-    f.read((char*)buffer.data(), size);
-    offset += size;
-    f.seekg(offset);
+    if (m_current_track < 0)
+        return;
 
-    for (int i = 0; i < count; i++)
-        m_right_spline.add_point(buffer[i]);
+    CameraPathTrack& track = m_tracks[m_current_track];
 
-    f.close();
+    m_position_spline.add_points(track.positions);
+    m_forward_spline.add_points(track.forwards);
+    m_right_spline.add_points(track.rights);
 
     if (m_position_spline.m_points.size() > 4)
     {
         m_position_spline.initialize();
         initialize_debug();
     }
-
-    return true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 void DemoPlayer::edit_ui(Camera* camera)
 {
-    if (ImGui::Button("Add Frame"))
+    if (m_tracks.size() > 0)
     {
-        m_position_spline.add_point(camera->m_position);
-        m_forward_spline.add_point(camera->m_forward);
-        m_right_spline.add_point(camera->m_right);
+        if (ImGui::BeginCombo("Track", m_tracks[m_current_track].name.c_str()))
+        {
+            for (uint32_t i = 0; i < m_tracks.size(); i++)
+            {
+                if (ImGui::Selectable(m_tracks[i].name.c_str(), m_current_track == int32_t(i)))
+                    select_track(i);
+            }
 
-        if (m_position_spline.m_points.size() > 4)
+            ImGui::EndCombo();
+        }
+    }
+
+    if (ImGui::Button("Add Frame"))
+    {
+        if (m_current_track < 0)
         {
-            m_position_spline.initialize();
-            initialize_debug();
+            m_tracks.push_back(CameraPathTrack());
+            m_tracks.back().name = "default";
+            m_current_track      = m_tracks.size() - 1;
         }
+
+        CameraPathKey key;
+
+        key.time     = 0.0f;
+        key.fov      = 0.0f;
+        key.speed    = 0.0f;
+        key.position = camera->m_position;
+        key.forward  = camera->m_forward;
+        key.right    = camera->m_right;
+
+        m_tracks[m_current_track].add_key(key);
+        rebuild_splines();
     }
 
     ImGui::SliderFloat("Camera Speed", &m_speed, 0.1f, 200.0f);
@@ -374,36 +864,25 @@ void DemoPlayer::edit_ui(Camera* camera)
             stop();
     }
 
-    if (ImGui::Button("Save"))
-    {
-        std::fstream f("camera_path.bin", std::ios::out | std::ios::binary);
-
-        long offset = 0;
-        f.seekp(offset);
-
-        size_t size = sizeof(uint32_t);
-
-        uint32_t count = m_position_spline.m_points.size();
-
-        f.write((char*)&count, size);
-        offset += size;
-        f.seekg(offset);
-
-        size = sizeof(glm::vec3) * m_position_spline.m_points.size();
+    if (ImGui::Button("Load"))
+        load_from_file(m_path);
 
-        f.write((char*)m_position_spline.m_points.data(), size);
-        offset += size;
-        f.seekg(offset);
+    ImGui::SameLine();
 
-        f.write((char*)m_forward_spline.m_points.data(), size);
-        offset += size;
-        f.seekg(offset);
+    if (ImGui::Button("Save"))
+        save_to_file(m_path);
 
-        f.write((char*)m_right_spline.m_points.data(), size);
-        offset += size;
-        f.seekg(offset);
+    ImGui::SameLine();
 
-        f.close();
+    if (is_recording())
+    {
+        if (ImGui::Button("Stop Recording"))
+            stop_recording();
+    }
+    else
+    {
+        if (ImGui::Button("Record"))
+            start_recording(m_path, "recording_" + std::to_string(m_tracks.size()));
     }
 }
 
@@ -451,6 +930,8 @@ void DemoPlayer::set_speed(float speed)
 void DemoPlayer::play()
 {
     m_time       = 0.0f;
+    m_distance   = 0.0f;
+    m_key_hint   = 0;
     m_is_playing = true;
 }
 
@@ -472,18 +953,79 @@ bool DemoPlayer::is_playing()
 
 void DemoPlayer::update(float dt, Camera* camera)
 {
-    if (m_is_playing)
+    if (m_is_playing && m_position_spline.m_points.size() > 4)
     {
-        m_time += dt / 1000;
-        m_current_position = m_position_spline.const_velocity_spline_at_time(m_time, m_speed);
+        CameraPathTrack& track = m_tracks[m_current_track];
+
+        if (track.flags & CAMERA_PATH_TRACK_TIMED)
+            update_timed(dt, camera);
+        else
+        {
+            float length = m_position_spline.total_length();
+            float t      = m_position_spline.parameter_at_distance(m_distance, &m_key_hint);
+
+            // Speed keys override the player speed where present.
+            uint32_t key       = std::min(uint32_t(t), track.key_count() - 2);
+            float    key_speed = glm::mix(track.speeds[key], track.speeds[key + 1], t - float(key));
+            float    speed     = key_speed > 0.0f ? key_speed : m_speed;
+
+            m_distance += speed * dt / 1000;
+
+            if (m_distance >= length)
+            {
+                m_distance = fmod(m_distance, length);
+                m_key_hint = 0;
+            }
+
+            t = m_position_spline.parameter_at_distance(m_distance, &m_key_hint);
 
-        float t = float(m_position_spline.current_distance(m_time, m_speed)) / float(m_position_spline.total_length());
+            m_current_position = m_position_spline.spline_at_time(t);
+            m_current_forward  = m_forward_spline.value_at_time(m_distance / length);
+            m_current_right    = m_right_spline.value_at_time(m_distance / length);
 
-        m_current_forward = m_forward_spline.value_at_time(t);
-        m_current_right   = m_right_spline.value_at_time(t);
+            camera->update_from_frame(m_current_position, glm::normalize(m_current_forward), glm::normalize(m_current_right));
+        }
+    }
+
+    if (m_recorder.is_recording())
+        m_recorder.record(dt, camera);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void DemoPlayer::update_timed(float dt, Camera* camera)
+{
+    CameraPathTrack& track    = m_tracks[m_current_track];
+    float            duration = track.times.back();
 
-        camera->update_from_frame(m_current_position, glm::normalize(m_current_forward), glm::normalize(m_current_right));
+    m_time += dt / 1000;
+
+    if (m_time >= duration)
+    {
+        m_time     = duration > 0.0f ? fmod(m_time, duration) : 0.0f;
+        m_key_hint = 0;
     }
+
+    // Keys are visited in increasing time order, so the search starts from the previous key.
+    auto     first = track.times.begin() + std::min(m_key_hint, track.key_count() - 1);
+    uint32_t key   = std::upper_bound(first, track.times.end(), m_time) - track.times.begin();
+
+    key        = glm::clamp(key, 1u, track.key_count() - 1) - 1;
+    m_key_hint = key;
+
+    float interval   = track.times[key + 1] - track.times[key];
+    float fractional = interval > 0.0f ? glm::clamp((m_time - track.times[key]) / interval, 0.0f, 1.0f) : 0.0f;
+
+    m_current_position = m_position_spline.spline_at_time(float(key) + fractional);
+    m_current_forward  = glm::mix(track.forwards[key], track.forwards[key + 1], fractional);
+    m_current_right    = glm::mix(track.rights[key], track.rights[key + 1], fractional);
+
+    camera->update_from_frame(m_current_position, glm::normalize(m_current_forward), glm::normalize(m_current_right));
+
+    float fov = glm::mix(track.fovs[key], track.fovs[key + 1], fractional);
+
+    if (fov > 0.0f && fov != camera->m_fov)
+        camera->update_projection(fov, camera->m_near, camera->m_far, camera->m_aspect_ratio);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -515,8 +1057,12 @@ void DemoPlayer::initialize_debug()
 
     m_debug_spline_segments.resize((m_position_spline.m_points.size() + 1) * SEGMENTS_PER_POINT);
 
-    for (int k = 0; k < m_debug_spline_segments.size(); k++)
-        m_debug_spline_segments[k] = m_position_spline.const_velocity_spline_at_time(total_length * k / m_debug_spline_segments.size() / m_speed, m_speed);
+    std::vector<float> times(m_debug_spline_segments.size());
+
+    for (int k = 0; k < times.size(); k++)
+        times[k] = total_length * k / m_debug_spline_segments.size() / m_speed;
+
+    m_position_spline.const_velocity_spline_at_times(times.data(), times.size(), m_speed, m_debug_spline_segments.data());
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,746 @@
+#include <downsampler.h>
+#include <logger.h>
+#include <macros.h>
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+// Generated from src/shaders/downsample.comp at build time.
+#if defined(DWSF_VULKAN)
+#    include <downsample_rgba8.spv.h>
+#    include <downsample_r8.spv.h>
+#    include <downsample_rgba16f.spv.h>
+#    include <downsample_rgba32f.spv.h>
+#    include <downsample_r16f.spv.h>
+#    include <downsample_r32f.spv.h>
+#else
+#    include <downsample.comp.h>
+#endif
+
+// Levels reduced out of a workgroup's tile. Only dispatches whose source fits 64 tiles across reach the second phase.
+#define DOWNSAMPLER_TILE_LEVELS 6
+#define DOWNSAMPLER_TILE_SIZE 64
+#define DOWNSAMPLER_MAX_SINGLE_PASS_SIZE 4096
+// Destination texels per workgroup of the Kaiser filter.
+#define DOWNSAMPLER_KAISER_GROUP_SIZE 16
+
+namespace dw
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Shader variants, one per format qualifier of the levels being written.
+enum DownsampleVariant
+{
+    DOWNSAMPLE_VARIANT_RGBA8 = 0,
+    DOWNSAMPLE_VARIANT_R8,
+    DOWNSAMPLE_VARIANT_RGBA16F,
+    DOWNSAMPLE_VARIANT_RGBA32F,
+    DOWNSAMPLE_VARIANT_R16F,
+    DOWNSAMPLE_VARIANT_R32F,
+    DOWNSAMPLE_VARIANT_COUNT
+};
+
+#if defined(DWSF_VULKAN)
+struct DownsampleFormat
+{
+    VkFormat format;
+    // Format of the views the shader reads and writes through.
+    VkFormat storage_format;
+    uint32_t variant;
+    bool     srgb;
+};
+
+static const DownsampleFormat kDownsampleFormats[] = {
+    { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM, DOWNSAMPLE_VARIANT_RGBA8, false },
+    { VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM, DOWNSAMPLE_VARIANT_RGBA8, true },
+    { VK_FORMAT_R8_UNORM, VK_FORMAT_R8_UNORM, DOWNSAMPLE_VARIANT_R8, false },
+    { VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT, DOWNSAMPLE_VARIANT_RGBA16F, false },
+    { VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT, DOWNSAMPLE_VARIANT_RGBA32F, false },
+    { VK_FORMAT_R16_SFLOAT, VK_FORMAT_R16_SFLOAT, DOWNSAMPLE_VARIANT_R16F, false },
+    { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32_SFLOAT, DOWNSAMPLE_VARIANT_R32F, false }
+};
+
+struct DownsampleSpirv
+{
+    const uint32_t* data;
+    size_t          size;
+};
+
+static const DownsampleSpirv kDownsampleSpirv[] = {
+    { kDOWNSAMPLE_RGBA8_SPIRV, sizeof(kDOWNSAMPLE_RGBA8_SPIRV) },
+    { kDOWNSAMPLE_R8_SPIRV, sizeof(kDOWNSAMPLE_R8_SPIRV) },
+    { kDOWNSAMPLE_RGBA16F_SPIRV, sizeof(kDOWNSAMPLE_RGBA16F_SPIRV) },
+    { kDOWNSAMPLE_RGBA32F_SPIRV, sizeof(kDOWNSAMPLE_RGBA32F_SPIRV) },
+    { kDOWNSAMPLE_R16F_SPIRV, sizeof(kDOWNSAMPLE_R16F_SPIRV) },
+    { kDOWNSAMPLE_R32F_SPIRV, sizeof(kDOWNSAMPLE_R32F_SPIRV) }
+};
+
+struct DownsamplePushConstants
+{
+    int32_t source_width;
+    int32_t source_height;
+    int32_t source_level;
+    int32_t level_count;
+    int32_t filter;
+    int32_t srgb;
+    int32_t layer_offset;
+};
+#else
+struct DownsampleFormat
+{
+    GLenum   format;
+    GLenum   storage_format;
+    uint32_t variant;
+    bool     srgb;
+};
+
+static const DownsampleFormat kDownsampleFormats[] = {
+    { GL_RGBA8, GL_RGBA8, DOWNSAMPLE_VARIANT_RGBA8, false },
+    { GL_SRGB8_ALPHA8, GL_RGBA8, DOWNSAMPLE_VARIANT_RGBA8, true },
+    { GL_R8, GL_R8, DOWNSAMPLE_VARIANT_R8, false },
+    { GL_RGBA16F, GL_RGBA16F, DOWNSAMPLE_VARIANT_RGBA16F, false },
+    { GL_RGBA32F, GL_RGBA32F, DOWNSAMPLE_VARIANT_RGBA32F, false },
+    { GL_R16F, GL_R16F, DOWNSAMPLE_VARIANT_R16F, false },
+    { GL_R32F, GL_R32F, DOWNSAMPLE_VARIANT_R32F, false }
+};
+
+static const char* kDownsampleFormatQualifiers[] = { "rgba8", "r8", "rgba16f", "rgba32f", "r16f", "r32f" };
+#endif
+
+Downsampler::Ptr Downsampler::m_common;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename Format>
+static const DownsampleFormat* find_format(Format format)
+{
+    for (const auto& entry : kDownsampleFormats)
+    {
+        if (entry.format == format)
+            return &entry;
+    }
+
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Returns the number of levels the next dispatch writes below a source level of the given size.
+static uint32_t dispatch_level_count(uint32_t width, uint32_t height, uint32_t remaining_levels, uint32_t max_levels, DownsampleFilter filter)
+{
+    if (filter == DOWNSAMPLE_FILTER_KAISER)
+        return 1;
+
+    uint32_t count = std::max(width, height) <= DOWNSAMPLER_MAX_SINGLE_PASS_SIZE ? max_levels : DOWNSAMPLER_TILE_LEVELS;
+
+    return std::min(count, remaining_levels);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void dispatch_size(uint32_t width, uint32_t height, DownsampleFilter filter, uint32_t& groups_x, uint32_t& groups_y)
+{
+    if (filter == DOWNSAMPLE_FILTER_KAISER)
+    {
+        uint32_t dst_width  = std::max(width / 2, 1u);
+        uint32_t dst_height = std::max(height / 2, 1u);
+
+        groups_x = (dst_width + DOWNSAMPLER_KAISER_GROUP_SIZE - 1) / DOWNSAMPLER_KAISER_GROUP_SIZE;
+        groups_y = (dst_height + DOWNSAMPLER_KAISER_GROUP_SIZE - 1) / DOWNSAMPLER_KAISER_GROUP_SIZE;
+    }
+    else
+    {
+        groups_x = (width + DOWNSAMPLER_TILE_SIZE - 1) / DOWNSAMPLER_TILE_SIZE;
+        groups_y = (height + DOWNSAMPLER_TILE_SIZE - 1) / DOWNSAMPLER_TILE_SIZE;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_VULKAN)
+
+namespace vk
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+DownsampleTarget::~DownsampleTarget()
+{
+    descriptor_sets.clear();
+
+    for (auto& pool : pools)
+    {
+        if (pool)
+            pool->free_sets++;
+    }
+
+    for (auto view : storage_views)
+        vkDestroyImageView(device, view, nullptr);
+
+    if (sampled_view)
+        vkDestroyImageView(device, sampled_view, nullptr);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace vk
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static VkImageView create_view(VkDevice device, vk::Image* image, VkFormat format, uint32_t base_level, uint32_t level_count)
+{
+    VkImageViewCreateInfo info;
+    DW_ZERO_MEMORY(info);
+
+    info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    info.image                           = image->handle();
+    info.viewType                        = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    info.format                          = format;
+    info.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
+    info.subresourceRange.baseMipLevel   = base_level;
+    info.subresourceRange.levelCount     = level_count;
+    info.subresourceRange.baseArrayLayer = 0;
+    info.subresourceRange.layerCount     = image->array_size();
+
+    VkImageView view;
+
+    if (vkCreateImageView(device, &info, nullptr, &view) != VK_SUCCESS)
+    {
+        DW_LOG_FATAL("(Vulkan) Failed to create Downsampler Image View.");
+        throw std::runtime_error("(Vulkan) Failed to create Downsampler Image View.");
+    }
+
+    return view;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Downsampler::Ptr Downsampler::create(vk::Backend::Ptr backend)
+{
+    return std::shared_ptr<Downsampler>(new Downsampler(backend));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Downsampler::initialize_common_resources(vk::Backend::Ptr backend)
+{
+    m_common = create(backend);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Downsampler::Downsampler(vk::Backend::Ptr backend) :
+    m_backend(backend)
+{
+    // R8 and R16F storage images are only available with extended storage formats.
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(backend->physical_device(), &features);
+
+    m_variant_supported.resize(DOWNSAMPLE_VARIANT_COUNT);
+
+    for (const auto& entry : kDownsampleFormats)
+    {
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(backend->physical_device(), entry.storage_format, &properties);
+
+        bool supported = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) && (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+
+        if (entry.variant == DOWNSAMPLE_VARIANT_R8 || entry.variant == DOWNSAMPLE_VARIANT_R16F)
+            supported = supported && features.shaderStorageImageExtendedFormats;
+
+        m_variant_supported[entry.variant] = supported;
+    }
+
+    m_pipelines.resize(DOWNSAMPLE_VARIANT_COUNT);
+
+    vk::DescriptorSetLayout::Desc ds_layout_desc;
+
+    ds_layout_desc.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+    ds_layout_desc.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DOWNSAMPLER_MAX_LEVELS, VK_SHADER_STAGE_COMPUTE_BIT);
+    ds_layout_desc.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    m_ds_layout = vk::DescriptorSetLayout::create(backend, ds_layout_desc);
+    m_ds_layout->set_name("Downsampler DS Layout");
+
+    vk::PipelineLayout::Desc pl_desc;
+
+    pl_desc.add_descriptor_set_layout(m_ds_layout);
+    pl_desc.add_push_constant_range(VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DownsamplePushConstants));
+
+    m_pipeline_layout = vk::PipelineLayout::create(backend, pl_desc);
+    m_pipeline_layout->set_name("Downsampler Pipeline Layout");
+
+    // The last workgroup of each layer resets its counter, so they only need to start out at zero.
+    std::vector<uint32_t> counters(DOWNSAMPLER_MAX_LAYERS, 0);
+
+    m_counters = vk::Buffer::create(backend, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(uint32_t) * counters.size(), VMA_MEMORY_USAGE_GPU_ONLY, 0, counters.data());
+    m_counters->set_name("Downsampler Counters");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Downsampler::~Downsampler()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Downsampler::is_format_supported(VkFormat format, VkImageUsageFlags* usage, VkImageCreateFlags* flags)
+{
+    const DownsampleFormat* entry = find_format(format);
+
+    if (!entry || !m_variant_supported[entry->variant])
+        return false;
+
+    if (usage)
+        *usage |= VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    // sRGB formats cannot be stored to, so the image is written through UNORM views.
+    if (flags && entry->storage_format != format)
+        *flags |= VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Downsampler::is_supported(vk::Image* image)
+{
+    const DownsampleFormat* entry = find_format(image->format());
+
+    if (!entry || !m_variant_supported[entry->variant])
+        return false;
+
+    if (image->type() != VK_IMAGE_TYPE_2D || image->depth() != 1 || image->sample_count() != VK_SAMPLE_COUNT_1_BIT)
+        return false;
+
+    if (!(image->usage() & VK_IMAGE_USAGE_STORAGE_BIT) || !(image->usage() & VK_IMAGE_USAGE_SAMPLED_BIT))
+        return false;
+
+    if (entry->storage_format != image->format() && !(image->flags() & VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT))
+        return false;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Downsampler::generate(vk::CommandBuffer::Ptr cmd_buf, vk::Image* image, DownsampleFilter filter, VkImageLayout dst_layout, uint32_t base_level)
+{
+    // Levels written while defragmentation copies the image would be lost, see vk::Image::set_movable().
+    assert(!image->is_movable());
+
+    uint32_t levels = image->mip_levels();
+    uint32_t layers = image->array_size();
+
+    if (base_level + 1 >= levels)
+        return;
+
+    if (!is_supported(image))
+    {
+        DW_LOG_ERROR("(Vulkan) Image cannot be downsampled, it needs a supported format and storage usage.");
+        return;
+    }
+
+    auto backend = m_backend.lock();
+
+    const DownsampleFormat* entry  = find_format(image->format());
+    vk::DownsampleTarget*   target = this->target(image, entry->storage_format);
+
+    VkImageSubresourceRange source_range = { VK_IMAGE_ASPECT_COLOR_BIT, base_level, 1, 0, layers };
+    VkImageSubresourceRange dst_range    = { VK_IMAGE_ASPECT_COLOR_BIT, base_level + 1, levels - base_level - 1, 0, layers };
+
+    // The source level and the levels below it may have been left in different layouts, so they are moved separately. The
+    // counters are barriered as well since earlier dispatches on other images use them too.
+    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, image->handle(), source_range, layers, levels);
+    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL, image->handle(), dst_range, layers, levels);
+    backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, m_counters);
+
+    backend->flush_barriers(cmd_buf);
+
+    vkCmdBindPipeline(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline(entry->variant)->handle());
+
+    uint32_t source = base_level;
+
+    while (source + 1 < levels)
+    {
+        uint32_t width  = std::max(image->width() >> source, 1u);
+        uint32_t height = std::max(image->height() >> source, 1u);
+        uint32_t count  = dispatch_level_count(width, height, levels - source - 1, m_max_levels, filter);
+
+        uint32_t groups_x, groups_y;
+        dispatch_size(width, height, filter, groups_x, groups_y);
+
+        DownsamplePushConstants push_constants;
+
+        push_constants.source_width  = width;
+        push_constants.source_height = height;
+        push_constants.source_level  = source;
+        push_constants.level_count   = count;
+        push_constants.filter        = filter;
+        push_constants.srgb          = entry->srgb;
+
+        vkCmdBindDescriptorSets(cmd_buf->handle(), VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout->handle(), 0, 1, &descriptor_set(target, source)->handle(), 0, nullptr);
+
+        for (uint32_t layer_offset = 0; layer_offset < layers; layer_offset += DOWNSAMPLER_MAX_LAYERS)
+        {
+            // Consecutive dispatches over the same counters must not overlap.
+            if (layer_offset > 0)
+            {
+                backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, m_counters);
+                backend->flush_barriers(cmd_buf);
+            }
+
+            push_constants.layer_offset = layer_offset;
+
+            vkCmdPushConstants(cmd_buf->handle(), m_pipeline_layout->handle(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push_constants), &push_constants);
+            vkCmdDispatch(cmd_buf->handle(), groups_x, groups_y, std::min(layers - layer_offset, (uint32_t)DOWNSAMPLER_MAX_LAYERS));
+        }
+
+        source += count;
+
+        // The next dispatch reads the last level this one wrote.
+        if (source + 1 < levels)
+        {
+            VkImageSubresourceRange written_range = { VK_IMAGE_ASPECT_COLOR_BIT, source, 1, 0, layers };
+
+            backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, image->handle(), written_range, layers, levels);
+            backend->use_resource(VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT, m_counters);
+            backend->flush_barriers(cmd_buf);
+        }
+    }
+
+    VkImageSubresourceRange chain_range = { VK_IMAGE_ASPECT_COLOR_BIT, base_level, levels - base_level, 0, layers };
+
+    backend->use_resource(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_SHADER_READ_BIT, dst_layout, image->handle(), chain_range, layers, levels);
+
+    backend->flush_barriers(cmd_buf);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+vk::ComputePipeline::Ptr Downsampler::pipeline(uint32_t variant)
+{
+    if (!m_pipelines[variant])
+    {
+        auto backend = m_backend.lock();
+
+        const DownsampleSpirv& spirv = kDownsampleSpirv[variant];
+
+        std::vector<char> code((const char*)spirv.data, (const char*)spirv.data + spirv.size);
+
+        vk::ShaderModule::Ptr module = vk::ShaderModule::create(backend, code);
+
+        vk::ComputePipeline::Desc desc;
+
+        desc.set_shader_stage(module, "main");
+        desc.set_pipeline_layout(m_pipeline_layout);
+
+        m_pipelines[variant] = vk::ComputePipeline::create(backend, desc);
+        m_pipelines[variant]->set_name("Downsampler Pipeline");
+    }
+
+    return m_pipelines[variant];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+vk::DownsampleTarget* Downsampler::target(vk::Image* image, VkFormat storage_format)
+{
+    std::shared_ptr<vk::DownsampleTarget>& target = image->downsample_target();
+
+    if (!target)
+    {
+        auto backend = m_backend.lock();
+
+        target = std::make_shared<vk::DownsampleTarget>();
+
+        target->device       = backend->device();
+        target->sampled_view = create_view(target->device, image, storage_format, 0, image->mip_levels());
+
+        target->storage_views.resize(image->mip_levels());
+        target->descriptor_sets.resize(image->mip_levels());
+        target->pools.resize(image->mip_levels());
+
+        for (uint32_t i = 0; i < image->mip_levels(); i++)
+            target->storage_views[i] = create_view(target->device, image, storage_format, i, 1);
+    }
+
+    return target.get();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+vk::DescriptorSet::Ptr Downsampler::descriptor_set(vk::DownsampleTarget* target, uint32_t source_level)
+{
+    vk::DescriptorSet::Ptr& ds = target->descriptor_sets[source_level];
+
+    if (!ds)
+    {
+        auto backend = m_backend.lock();
+
+        std::shared_ptr<vk::DownsamplePool> pool = descriptor_pool();
+
+        ds = vk::DescriptorSet::create(backend, m_ds_layout, pool->pool);
+
+        pool->free_sets--;
+        target->pools[source_level] = pool;
+
+        VkDescriptorImageInfo source_info;
+
+        source_info.sampler     = backend->nearest_sampler()->handle();
+        source_info.imageView   = target->sampled_view;
+        source_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        // Slots past the end of the chain repeat the last level. The shader never touches them.
+        VkDescriptorImageInfo level_infos[DOWNSAMPLER_MAX_LEVELS];
+
+        for (uint32_t i = 0; i < DOWNSAMPLER_MAX_LEVELS; i++)
+        {
+            uint32_t level = std::min(source_level + 1 + i, uint32_t(target->storage_views.size() - 1));
+
+            level_infos[i].sampler     = VK_NULL_HANDLE;
+            level_infos[i].imageView   = target->storage_views[level];
+            level_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+
+        VkDescriptorBufferInfo counters_info;
+
+        counters_info.buffer = m_counters->handle();
+        counters_info.offset = 0;
+        counters_info.range  = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet write_data[3];
+        DW_ZERO_MEMORY(write_data[0]);
+        DW_ZERO_MEMORY(write_data[1]);
+        DW_ZERO_MEMORY(write_data[2]);
+
+        write_data[0].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data[0].descriptorCount = 1;
+        write_data[0].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write_data[0].pImageInfo      = &source_info;
+        write_data[0].dstBinding      = 0;
+        write_data[0].dstSet          = ds->handle();
+
+        write_data[1].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data[1].descriptorCount = DOWNSAMPLER_MAX_LEVELS;
+        write_data[1].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        write_data[1].pImageInfo      = level_infos;
+        write_data[1].dstBinding      = 1;
+        write_data[1].dstSet          = ds->handle();
+
+        write_data[2].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write_data[2].descriptorCount = 1;
+        write_data[2].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write_data[2].pBufferInfo     = &counters_info;
+        write_data[2].dstBinding      = 2;
+        write_data[2].dstSet          = ds->handle();
+
+        vkUpdateDescriptorSets(backend->device(), 3, &write_data[0], 0, nullptr);
+    }
+
+    return ds;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<vk::DownsamplePool> Downsampler::descriptor_pool()
+{
+    // Sets given back by images that went away are reused before another pool is created.
+    for (auto& pool : m_descriptor_pools)
+    {
+        if (pool->free_sets > 0)
+            return pool;
+    }
+
+    auto backend = m_backend.lock();
+
+    // Sets are freed individually when the image owning them goes away.
+    vk::DescriptorPool::Desc pool_desc;
+
+    pool_desc.set_max_sets(DOWNSAMPLER_POOL_DESCRIPTOR_SETS);
+    pool_desc.set_create_flags(VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+    pool_desc.add_pool_size(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, DOWNSAMPLER_POOL_DESCRIPTOR_SETS);
+    pool_desc.add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, DOWNSAMPLER_POOL_DESCRIPTOR_SETS * DOWNSAMPLER_MAX_LEVELS);
+    pool_desc.add_pool_size(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, DOWNSAMPLER_POOL_DESCRIPTOR_SETS);
+
+    auto pool = std::make_shared<vk::DownsamplePool>();
+
+    pool->pool      = vk::DescriptorPool::create(backend, pool_desc);
+    pool->free_sets = DOWNSAMPLER_POOL_DESCRIPTOR_SETS;
+
+    pool->pool->set_name("Downsampler Descriptor Pool " + std::to_string(m_descriptor_pools.size()));
+
+    m_descriptor_pools.push_back(pool);
+
+    return pool;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#else
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Downsampler::Ptr Downsampler::create()
+{
+    return std::shared_ptr<Downsampler>(new Downsampler());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Downsampler::initialize_common_resources()
+{
+    m_common = create();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Downsampler::Downsampler()
+{
+    // OpenGL only guarantees eight image units to compute shaders.
+    GLint max_images = 0;
+    glGetIntegerv(GL_MAX_COMPUTE_IMAGE_UNIFORMS, &max_images);
+
+    if (max_images < DOWNSAMPLER_MAX_LEVELS)
+        m_max_levels = DOWNSAMPLER_TILE_LEVELS;
+
+    m_shaders.resize(DOWNSAMPLE_VARIANT_COUNT);
+    m_programs.resize(DOWNSAMPLE_VARIANT_COUNT);
+
+    std::vector<uint32_t> counters(DOWNSAMPLER_MAX_LAYERS, 0);
+
+    m_counters = gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, 0, sizeof(uint32_t) * counters.size(), counters.data());
+    m_counters->set_name("Downsampler Counters");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Downsampler::~Downsampler()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Downsampler::is_supported(gl::Texture* texture)
+{
+    GLenum target = texture->target();
+
+    if (target != GL_TEXTURE_2D && target != GL_TEXTURE_2D_ARRAY && target != GL_TEXTURE_CUBE_MAP && target != GL_TEXTURE_CUBE_MAP_ARRAY)
+        return false;
+
+    return find_format(texture->internal_format()) != nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Downsampler::generate(gl::Texture* texture, DownsampleFilter filter, uint32_t base_level)
+{
+    uint32_t levels = texture->mip_levels();
+
+    if (base_level + 1 >= levels)
+        return;
+
+    if (!is_supported(texture))
+    {
+        DW_LOG_ERROR("OPENGL: Texture cannot be downsampled, it needs a supported format and target.");
+        return;
+    }
+
+    const DownsampleFormat* entry = find_format(texture->internal_format());
+
+    GLint width, height;
+    glGetTextureLevelParameteriv(texture->id(), 0, GL_TEXTURE_WIDTH, &width);
+    glGetTextureLevelParameteriv(texture->id(), 0, GL_TEXTURE_HEIGHT, &height);
+
+    GLenum   target = texture->target();
+    uint32_t layers = texture->array_size();
+
+    if (target == GL_TEXTURE_CUBE_MAP || target == GL_TEXTURE_CUBE_MAP_ARRAY)
+        layers *= 6;
+
+    // Every layer and level is read and written through one array view, which also reinterprets sRGB textures as UNORM.
+    GLuint view;
+    glGenTextures(1, &view);
+    glTextureView(view, GL_TEXTURE_2D_ARRAY, texture->id(), entry->storage_format, 0, levels, 0, layers);
+
+    gl::Program::Ptr program = this->program(entry->variant);
+
+    program->use();
+    program->set_uniform("u_Filter", int32_t(filter));
+    program->set_uniform("u_SRGB", int32_t(entry->srgb));
+
+    glBindTextureUnit(0, view);
+    m_counters->bind_base(GL_SHADER_STORAGE_BUFFER, 2);
+
+    uint32_t source = base_level;
+
+    while (source + 1 < levels)
+    {
+        uint32_t source_width  = std::max(uint32_t(width) >> source, 1u);
+        uint32_t source_height = std::max(uint32_t(height) >> source, 1u);
+        uint32_t count         = dispatch_level_count(source_width, source_height, levels - source - 1, m_max_levels, filter);
+
+        uint32_t groups_x, groups_y;
+        dispatch_size(source_width, source_height, filter, groups_x, groups_y);
+
+        for (uint32_t i = 0; i < m_max_levels; i++)
+            glBindImageTexture(i, view, std::min(source + 1 + i, levels - 1), GL_TRUE, 0, GL_READ_WRITE, entry->storage_format);
+
+        program->set_uniform("u_SourceWidth", int32_t(source_width));
+        program->set_uniform("u_SourceHeight", int32_t(source_height));
+        program->set_uniform("u_SourceLevel", int32_t(source));
+        program->set_uniform("u_LevelCount", int32_t(count));
+
+        for (uint32_t layer_offset = 0; layer_offset < layers; layer_offset += DOWNSAMPLER_MAX_LAYERS)
+        {
+            program->set_uniform("u_LayerOffset", int32_t(layer_offset));
+
+            glDispatchCompute(groups_x, groups_y, std::min(layers - layer_offset, (uint32_t)DOWNSAMPLER_MAX_LAYERS));
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        source += count;
+    }
+
+    for (uint32_t i = 0; i < m_max_levels; i++)
+        glBindImageTexture(i, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA8);
+
+    glBindTextureUnit(0, 0);
+    glDeleteTextures(1, &view);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+gl::Program::Ptr Downsampler::program(uint32_t variant)
+{
+    if (!m_programs[variant])
+    {
+        std::string source = "#define FORMAT " + std::string(kDownsampleFormatQualifiers[variant]) + "\n";
+
+        source += "#define MAX_LEVELS " + std::to_string(m_max_levels) + "\n";
+        source += kDOWNSAMPLE_SOURCE;
+
+        m_shaders[variant] = gl::Shader::create(GL_COMPUTE_SHADER, source);
+
+        if (!m_shaders[variant] || !m_shaders[variant]->compiled())
+        {
+            DW_LOG_FATAL("OPENGL: Failed to compile the downsampler shader.");
+            throw std::runtime_error("OPENGL: Failed to compile the downsampler shader.");
+        }
+
+        m_programs[variant] = gl::Program::create({ m_shaders[variant] });
+    }
+
+    return m_programs[variant];
+}
+
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Downsampler::shutdown_common_resources()
+{
+    m_common.reset();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace dw
@@ -0,0 +1,274 @@
+#include <geometry.h>
+
+#if defined(__AVX__)
+#    include <immintrin.h>
+#    define DW_CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define DW_CULL_SSE
+#endif
+
+namespace dw
+{
+namespace
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Minimal lane abstraction so the culling loops are written once for AVX, SSE and scalar builds.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DW_CULL_AVX)
+const uint32_t kLanes = 8;
+
+typedef __m256 FloatLanes;
+
+inline FloatLanes lanes_load(const float* p) { return _mm256_loadu_ps(p); }
+inline FloatLanes lanes_set(float v) { return _mm256_set1_ps(v); }
+inline FloatLanes lanes_add(FloatLanes a, FloatLanes b) { return _mm256_add_ps(a, b); }
+inline FloatLanes lanes_mul(FloatLanes a, FloatLanes b) { return _mm256_mul_ps(a, b); }
+inline uint32_t   lanes_negative(FloatLanes a) { return _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ)); }
+#elif defined(DW_CULL_SSE)
+const uint32_t kLanes = 4;
+
+typedef __m128 FloatLanes;
+
+inline FloatLanes lanes_load(const float* p) { return _mm_loadu_ps(p); }
+inline FloatLanes lanes_set(float v) { return _mm_set1_ps(v); }
+inline FloatLanes lanes_add(FloatLanes a, FloatLanes b) { return _mm_add_ps(a, b); }
+inline FloatLanes lanes_mul(FloatLanes a, FloatLanes b) { return _mm_mul_ps(a, b); }
+inline uint32_t   lanes_negative(FloatLanes a) { return _mm_movemask_ps(_mm_cmplt_ps(a, _mm_setzero_ps())); }
+#else
+const uint32_t kLanes = 1;
+
+typedef float FloatLanes;
+
+inline FloatLanes lanes_load(const float* p) { return *p; }
+inline FloatLanes lanes_set(float v) { return v; }
+inline FloatLanes lanes_add(FloatLanes a, FloatLanes b) { return a + b; }
+inline FloatLanes lanes_mul(FloatLanes a, FloatLanes b) { return a * b; }
+inline uint32_t   lanes_negative(FloatLanes a) { return a < 0.0f ? 1 : 0; }
+#endif
+
+static_assert(CULL_MASK_WORD_BITS % kLanes == 0, "Mask words must hold a whole number of lane groups.");
+
+// Plane coefficients broadcast across lanes, or one plane per lane when testing the cached rejecting planes.
+struct PlaneLanes
+{
+    FloatLanes n[3];
+    FloatLanes abs_n[3];
+    FloatLanes d;
+};
+
+struct BoxLanes
+{
+    FloatLanes center[3];
+    FloatLanes extent[3];
+};
+
+struct SphereLanes
+{
+    FloatLanes center[3];
+    FloatLanes radius;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+PlaneLanes broadcast_plane(const Plane& plane)
+{
+    PlaneLanes lanes;
+
+    for (int i = 0; i < 3; i++)
+    {
+        lanes.n[i]     = lanes_set(plane.n[i]);
+        lanes.abs_n[i] = lanes_set(fabsf(plane.n[i]));
+    }
+
+    lanes.d = lanes_set(plane.d);
+
+    return lanes;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+PlaneLanes gather_planes(const Frustum& frustum, const uint8_t* plane_indices, uint32_t valid)
+{
+    float n[3][kLanes];
+    float abs_n[3][kLanes];
+    float d[kLanes];
+
+    for (uint32_t lane = 0; lane < kLanes; lane++)
+    {
+        uint32_t     idx   = (valid & (1u << lane)) && plane_indices[lane] < 6 ? plane_indices[lane] : 0;
+        const Plane& plane = frustum.planes[idx];
+
+        for (int i = 0; i < 3; i++)
+        {
+            n[i][lane]     = plane.n[i];
+            abs_n[i][lane] = fabsf(plane.n[i]);
+        }
+
+        d[lane] = plane.d;
+    }
+
+    PlaneLanes lanes;
+
+    for (int i = 0; i < 3; i++)
+    {
+        lanes.n[i]     = lanes_load(n[i]);
+        lanes.abs_n[i] = lanes_load(abs_n[i]);
+    }
+
+    lanes.d = lanes_load(d);
+
+    return lanes;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline FloatLanes plane_distance(const PlaneLanes& plane, const FloatLanes* center)
+{
+    FloatLanes d = lanes_add(lanes_mul(plane.n[0], center[0]), plane.d);
+
+    d = lanes_add(d, lanes_mul(plane.n[1], center[1]));
+    d = lanes_add(d, lanes_mul(plane.n[2], center[2]));
+
+    return d;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// A box is outside a plane when its center lies further behind it than the extents projected onto the plane normal.
+inline uint32_t outside(const PlaneLanes& plane, const BoxLanes& box)
+{
+    FloatLanes r = lanes_mul(plane.abs_n[0], box.extent[0]);
+
+    r = lanes_add(r, lanes_mul(plane.abs_n[1], box.extent[1]));
+    r = lanes_add(r, lanes_mul(plane.abs_n[2], box.extent[2]));
+
+    return lanes_negative(lanes_add(plane_distance(plane, box.center), r));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint32_t outside(const PlaneLanes& plane, const SphereLanes& sphere)
+{
+    return lanes_negative(lanes_add(plane_distance(plane, sphere.center), sphere.radius));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Loads a group of lanes starting at idx. Partial groups at the end of a range are padded through a zeroed copy.
+inline void load_lanes(const AABBBatch& boxes, uint32_t idx, uint32_t remaining, BoxLanes& lanes)
+{
+    const float* src[6] = { boxes.center_x, boxes.center_y, boxes.center_z, boxes.extent_x, boxes.extent_y, boxes.extent_z };
+    FloatLanes*  dst[6] = { &lanes.center[0], &lanes.center[1], &lanes.center[2], &lanes.extent[0], &lanes.extent[1], &lanes.extent[2] };
+
+    for (int i = 0; i < 6; i++)
+    {
+        if (remaining >= kLanes)
+            *dst[i] = lanes_load(src[i] + idx);
+        else
+        {
+            float padded[kLanes] = {};
+
+            for (uint32_t lane = 0; lane < remaining; lane++)
+                padded[lane] = src[i][idx + lane];
+
+            *dst[i] = lanes_load(padded);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline void load_lanes(const SphereBatch& spheres, uint32_t idx, uint32_t remaining, SphereLanes& lanes)
+{
+    const float* src[4] = { spheres.center_x, spheres.center_y, spheres.center_z, spheres.radius };
+    FloatLanes*  dst[4] = { &lanes.center[0], &lanes.center[1], &lanes.center[2], &lanes.radius };
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (remaining >= kLanes)
+            *dst[i] = lanes_load(src[i] + idx);
+        else
+        {
+            float padded[kLanes] = {};
+
+            for (uint32_t lane = 0; lane < remaining; lane++)
+                padded[lane] = src[i][idx + lane];
+
+            *dst[i] = lanes_load(padded);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename Batch, typename Lanes>
+void cull(const Frustum& frustum, const Batch& batch, uint32_t first, uint32_t count, uint32_t* mask, uint8_t* last_plane)
+{
+    PlaneLanes planes[6];
+
+    for (int i = 0; i < 6; i++)
+        planes[i] = broadcast_plane(frustum.planes[i]);
+
+    const uint32_t all_lanes = (1u << kLanes) - 1;
+    uint32_t*      word      = mask + first / CULL_MASK_WORD_BITS;
+    uint32_t       bits      = 0;
+
+    for (uint32_t i = 0; i < count; i += kLanes)
+    {
+        uint32_t idx       = first + i;
+        uint32_t remaining = count - i;
+        uint32_t valid     = remaining < kLanes ? (1u << remaining) - 1 : all_lanes;
+        uint32_t culled    = 0;
+        Lanes    lanes;
+
+        load_lanes(batch, idx, remaining, lanes);
+
+        // Bounds rejected last frame are usually rejected by the same plane again.
+        if (last_plane)
+            culled = outside(gather_planes(frustum, last_plane + idx, valid), lanes) & valid;
+
+        for (uint32_t p = 0; p < 6 && culled != valid; p++)
+        {
+            uint32_t rejected = outside(planes[p], lanes) & valid & ~culled;
+
+            if (last_plane && rejected)
+            {
+                for (uint32_t lane = 0; lane < kLanes; lane++)
+                {
+                    if (rejected & (1u << lane))
+                        last_plane[idx + lane] = p;
+                }
+            }
+
+            culled |= rejected;
+        }
+
+        bits |= (valid & ~culled) << (i % CULL_MASK_WORD_BITS);
+
+        if ((i + kLanes) % CULL_MASK_WORD_BITS == 0 || i + kLanes >= count)
+        {
+            *word++ = bits;
+            bits    = 0;
+        }
+    }
+}
+} // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void cull_aabbs(const Frustum& frustum, const AABBBatch& boxes, uint32_t first, uint32_t count, uint32_t* mask, uint8_t* last_plane)
+{
+    cull<AABBBatch, BoxLanes>(frustum, boxes, first, count, mask, last_plane);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void cull_spheres(const Frustum& frustum, const SphereBatch& spheres, uint32_t first, uint32_t count, uint32_t* mask, uint8_t* last_plane)
+{
+    cull<SphereBatch, SphereLanes>(frustum, spheres, first, count, mask, last_plane);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace dw
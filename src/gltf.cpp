@@ -0,0 +1,1458 @@
+#include <gltf.h>
+#include <jobs.h>
+#include <mesh_codec.h>
+#include <logger.h>
+#include <utility.h>
+#include <vfs.h>
+#include <json.hpp>
+#include <gtc/quaternion.hpp>
+#include <atomic>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define DW_GLTF_SSE
+#endif
+
+// Binary glTF container.
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+// Accessor component types.
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+
+#define GLTF_MODE_TRIANGLES 4
+
+namespace dw
+{
+namespace gltf
+{
+namespace
+{
+enum MeshoptMode
+{
+    MESHOPT_MODE_ATTRIBUTES = 0,
+    MESHOPT_MODE_TRIANGLES,
+    MESHOPT_MODE_INDICES
+};
+
+enum MeshoptFilter
+{
+    MESHOPT_FILTER_NONE = 0,
+    MESHOPT_FILTER_OCTAHEDRAL,
+    MESHOPT_FILTER_QUATERNION,
+    MESHOPT_FILTER_EXPONENTIAL
+};
+
+// Contiguous bytes of a buffer or buffer view. Points into a mapped file, the GLB binary chunk or decoded storage owned by the
+// document.
+struct Range
+{
+    const uint8_t* data = nullptr;
+    size_t         size = 0;
+};
+
+struct BufferView
+{
+    Range    range;
+    uint32_t stride = 0;
+};
+
+// A buffer view stored with EXT_meshopt_compression, decoded into its own storage when the document is loaded.
+struct CompressedView
+{
+    uint32_t      view;
+    Range         source;
+    uint32_t      count;
+    uint32_t      stride;
+    MeshoptMode   mode;
+    MeshoptFilter filter;
+    uint8_t*      destination;
+};
+
+struct Accessor
+{
+    const uint8_t* data           = nullptr;
+    uint32_t       count          = 0;
+    uint32_t       stride         = 0;
+    uint32_t       components     = 0;
+    uint32_t       component_type = 0;
+    bool           normalized     = false;
+};
+
+// A triangle primitive of a mesh, and where its data goes in the model. Positions are scaled and offset as they are read,
+// which is how quantized positions are brought out of quantized units.
+struct Primitive
+{
+    const nlohmann::json* primitive;
+    uint32_t              sub_mesh;
+    uint32_t              base_vertex;
+    uint32_t              vertex_count;
+    uint32_t              base_index;
+    uint32_t              index_count;
+    glm::vec3             position_scale  = glm::vec3(1.0f);
+    glm::vec3             position_offset = glm::vec3(0.0f);
+};
+
+// The parsed file along with everything its ranges point into.
+struct Document
+{
+    std::string                       path;
+    nlohmann::json                    json;
+    vfs::File                         file;
+    std::vector<vfs::File>            mapped_buffers;
+    std::vector<std::vector<uint8_t>> decoded;
+    std::vector<Range>                buffers;
+    std::vector<BufferView>           views;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// EXT_meshopt_compression filters. The codecs themselves live in mesh_codec.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename T>
+void decode_filter_octahedral(T* data, size_t count)
+{
+    const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // The third component stores the encoded value of 1.0 at the same precision.
+        float x = float(data[i * 4 + 0]);
+        float y = float(data[i * 4 + 1]);
+        float z = float(data[i * 4 + 2]) - fabsf(x) - fabsf(y);
+
+        // Unfold the lower hemisphere.
+        float t = z >= 0.0f ? 0.0f : z;
+
+        x += x >= 0.0f ? t : -t;
+        y += y >= 0.0f ? t : -t;
+
+        float s = max / sqrtf(x * x + y * y + z * z);
+
+        data[i * 4 + 0] = T(int(x * s + (x >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + 1] = T(int(y * s + (y >= 0.0f ? 0.5f : -0.5f)));
+        data[i * 4 + 2] = T(int(z * s + (z >= 0.0f ? 0.5f : -0.5f)));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void decode_filter_quaternion(int16_t* data, size_t count)
+{
+    const float scale = 1.0f / sqrtf(2.0f);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // The low two bits of the last component select the dropped (largest) component, the rest hold the scale.
+        int   sf = data[i * 4 + 3] | 3;
+        float ss = scale / float(sf);
+
+        float x = float(data[i * 4 + 0]) * ss;
+        float y = float(data[i * 4 + 1]) * ss;
+        float z = float(data[i * 4 + 2]) * ss;
+
+        float ww = 1.0f - x * x - y * y - z * z;
+        float w  = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+        int xf = int(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f));
+        int yf = int(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f));
+        int zf = int(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f));
+        int wf = int(w * 32767.0f + 0.5f);
+        int qc = data[i * 4 + 3] & 3;
+
+        data[i * 4 + ((qc + 1) & 3)] = int16_t(xf);
+        data[i * 4 + ((qc + 2) & 3)] = int16_t(yf);
+        data[i * 4 + ((qc + 3) & 3)] = int16_t(zf);
+        data[i * 4 + ((qc + 0) & 3)] = int16_t(wf);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void decode_filter_exponential(uint32_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        // 8 bit signed exponent and 24 bit signed mantissa.
+        uint32_t v = data[i];
+        int32_t  m = int32_t(v << 8) >> 8;
+        int32_t  e = int32_t(v) >> 24;
+        float    f = ldexpf(float(m), e);
+
+        memcpy(&data[i], &f, sizeof(f));
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool decode_compressed_view(const CompressedView& view)
+{
+    bool result = false;
+
+    if (view.mode == MESHOPT_MODE_ATTRIBUTES)
+        result = mesh_codec::decode_vertex_buffer(view.destination, view.count, view.stride, view.source.data, view.source.size);
+    else if (view.mode == MESHOPT_MODE_TRIANGLES)
+        result = mesh_codec::decode_index_buffer(view.destination, view.count, view.stride, view.source.data, view.source.size);
+    else
+        result = mesh_codec::decode_index_sequence(view.destination, view.count, view.stride, view.source.data, view.source.size);
+
+    if (!result)
+        return false;
+
+    if (view.filter == MESHOPT_FILTER_OCTAHEDRAL)
+    {
+        if (view.stride == 4)
+            decode_filter_octahedral(reinterpret_cast<int8_t*>(view.destination), view.count);
+        else
+            decode_filter_octahedral(reinterpret_cast<int16_t*>(view.destination), view.count);
+    }
+    else if (view.filter == MESHOPT_FILTER_QUATERNION)
+        decode_filter_quaternion(reinterpret_cast<int16_t*>(view.destination), view.count);
+    else if (view.filter == MESHOPT_FILTER_EXPONENTIAL)
+        decode_filter_exponential(reinterpret_cast<uint32_t*>(view.destination), size_t(view.count) * view.stride / 4);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Document loading.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint32_t read_u32(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Undoes the percent encoding of a relative URI.
+std::string decode_uri(const std::string& uri)
+{
+    std::string result;
+
+    result.reserve(uri.size());
+
+    for (size_t i = 0; i < uri.size(); i++)
+    {
+        if (uri[i] == '%' && i + 2 < uri.size() && isxdigit(uri[i + 1]) && isxdigit(uri[i + 2]))
+        {
+            result.push_back(char(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+            i += 2;
+        }
+        else
+            result.push_back(uri[i]);
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool decode_base64(const char* data, size_t size, std::vector<uint8_t>& out)
+{
+    uint32_t bits  = 0;
+    uint32_t count = 0;
+
+    out.clear();
+    out.reserve(size / 4 * 3);
+
+    for (size_t i = 0; i < size && data[i] != '='; i++)
+    {
+        char     c = data[i];
+        uint32_t value;
+
+        if (c >= 'A' && c <= 'Z')
+            value = c - 'A';
+        else if (c >= 'a' && c <= 'z')
+            value = c - 'a' + 26;
+        else if (c >= '0' && c <= '9')
+            value = c - '0' + 52;
+        else if (c == '+')
+            value = 62;
+        else if (c == '/')
+            value = 63;
+        else
+            return false;
+
+        bits = (bits << 6) | value;
+        count += 6;
+
+        if (count >= 8)
+        {
+            count -= 8;
+            out.push_back(uint8_t(bits >> count));
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool is_supported_extension(const std::string& extension)
+{
+    return extension == "KHR_mesh_quantization" || extension == "EXT_meshopt_compression";
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load_buffers(Document& doc, const Range& glb_chunk)
+{
+    if (doc.json.find("buffers") == doc.json.end())
+        return true;
+
+    const nlohmann::json& buffers = doc.json["buffers"];
+
+    doc.buffers.resize(buffers.size());
+
+    for (size_t i = 0; i < buffers.size(); i++)
+    {
+        const nlohmann::json& buffer      = buffers[i];
+        size_t                byte_length = buffer.value("byteLength", size_t(0));
+        Range                 range;
+
+        if (buffer.find("uri") != buffer.end())
+        {
+            std::string uri = buffer["uri"];
+
+            if (uri.compare(0, 5, "data:") == 0)
+            {
+                size_t comma = uri.find(";base64,");
+
+                doc.decoded.emplace_back();
+
+                if (comma == std::string::npos || !decode_base64(uri.c_str() + comma + 8, uri.size() - comma - 8, doc.decoded.back()))
+                {
+                    DW_LOG_ERROR("Unsupported data URI in buffer " + std::to_string(i) + " of " + doc.path);
+                    return false;
+                }
+
+                range.data = doc.decoded.back().data();
+                range.size = doc.decoded.back().size();
+            }
+            else
+            {
+                std::string buffer_path = utility::path_without_file(doc.path) + "/" + decode_uri(uri);
+
+                doc.mapped_buffers.emplace_back();
+
+                if (!vfs::read(buffer_path, doc.mapped_buffers.back()))
+                {
+                    DW_LOG_ERROR("Failed to open glTF buffer: " + buffer_path);
+                    return false;
+                }
+
+                range.data = doc.mapped_buffers.back().data();
+                range.size = doc.mapped_buffers.back().size();
+            }
+        }
+        else if (i == 0 && glb_chunk.data)
+            range = glb_chunk;
+
+        // Buffers without data are fallbacks for EXT_meshopt_compression and only referenced by compressed views.
+        if (range.data)
+        {
+            if (range.size < byte_length)
+            {
+                DW_LOG_ERROR("Buffer " + std::to_string(i) + " of " + doc.path + " is smaller than its byteLength.");
+                return false;
+            }
+
+            range.size = byte_length;
+        }
+
+        doc.buffers[i] = range;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool buffer_range(const Document& doc, const nlohmann::json& object, Range& range)
+{
+    uint32_t buffer      = object["buffer"];
+    size_t   byte_offset = object.value("byteOffset", size_t(0));
+    size_t   byte_length = object["byteLength"];
+
+    if (buffer >= doc.buffers.size())
+        return false;
+
+    const Range& source = doc.buffers[buffer];
+
+    if (!source.data)
+    {
+        range = Range();
+        return true;
+    }
+
+    if (byte_offset > source.size || byte_length > source.size - byte_offset)
+        return false;
+
+    range.data = source.data + byte_offset;
+    range.size = byte_length;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load_buffer_views(Document& doc)
+{
+    if (doc.json.find("bufferViews") == doc.json.end())
+        return true;
+
+    const nlohmann::json& views = doc.json["bufferViews"];
+
+    std::vector<CompressedView> compressed;
+
+    doc.views.resize(views.size());
+
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        const nlohmann::json& view = views[i];
+
+        doc.views[i].stride = view.value("byteStride", 0u);
+
+        if (view.find("extensions") != view.end() && view["extensions"].find("EXT_meshopt_compression") != view["extensions"].end())
+        {
+            const nlohmann::json& extension = view["extensions"]["EXT_meshopt_compression"];
+            std::string           mode      = extension["mode"];
+            std::string           filter    = extension.value("filter", std::string("NONE"));
+            CompressedView        entry;
+
+            entry.view   = i;
+            entry.count  = extension["count"];
+            entry.stride = extension["byteStride"];
+            entry.mode   = mode == "ATTRIBUTES" ? MESHOPT_MODE_ATTRIBUTES : (mode == "TRIANGLES" ? MESHOPT_MODE_TRIANGLES : MESHOPT_MODE_INDICES);
+            entry.filter = filter == "OCTAHEDRAL" ? MESHOPT_FILTER_OCTAHEDRAL : (filter == "QUATERNION" ? MESHOPT_FILTER_QUATERNION : (filter == "EXPONENTIAL" ? MESHOPT_FILTER_EXPONENTIAL : MESHOPT_FILTER_NONE));
+
+            bool valid = buffer_range(doc, extension, entry.source) && entry.source.data;
+
+            if (entry.mode == MESHOPT_MODE_ATTRIBUTES)
+                valid = valid && entry.stride % 4 == 0 && entry.stride <= 256;
+            else
+                valid = valid && (entry.stride == 2 || entry.stride == 4) && entry.filter == MESHOPT_FILTER_NONE;
+
+            if (entry.filter == MESHOPT_FILTER_OCTAHEDRAL)
+                valid = valid && (entry.stride == 4 || entry.stride == 8);
+            else if (entry.filter == MESHOPT_FILTER_QUATERNION)
+                valid = valid && entry.stride == 8;
+
+            if (!valid || (mode != "ATTRIBUTES" && mode != "TRIANGLES" && mode != "INDICES"))
+            {
+                DW_LOG_ERROR("Invalid EXT_meshopt_compression buffer view " + std::to_string(i) + " in " + doc.path);
+                return false;
+            }
+
+            doc.decoded.emplace_back(size_t(entry.count) * entry.stride);
+
+            entry.destination = doc.decoded.back().data();
+
+            doc.views[i].range.data = entry.destination;
+            doc.views[i].range.size = doc.decoded.back().size();
+
+            compressed.push_back(entry);
+        }
+        else if (!buffer_range(doc, view, doc.views[i].range))
+        {
+            DW_LOG_ERROR("Buffer view " + std::to_string(i) + " of " + doc.path + " is out of bounds.");
+            return false;
+        }
+    }
+
+    // Views are independent streams, so they are decoded in parallel.
+    std::atomic<bool> failed = { false };
+
+    jobs::parallel_for(compressed.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            if (!decode_compressed_view(compressed[i]))
+            {
+                DW_LOG_ERROR("Failed to decode EXT_meshopt_compression buffer view " + std::to_string(compressed[i].view) + " in " + doc.path);
+                failed = true;
+            }
+        }
+    });
+
+    return !failed;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load_document(const std::string& path, Document& doc)
+{
+    doc.path = path;
+
+    if (!vfs::read(path, doc.file))
+    {
+        DW_LOG_ERROR("Failed to open glTF file: " + path);
+        return false;
+    }
+
+    const uint8_t* data       = doc.file.data();
+    const uint8_t* json_begin = data;
+    size_t         json_size  = doc.file.size();
+    Range          glb_chunk;
+
+    if (doc.file.size() >= 12 && read_u32(data) == GLB_MAGIC)
+    {
+        size_t length = std::min(size_t(read_u32(data + 8)), doc.file.size());
+        size_t offset = 12;
+
+        json_begin = nullptr;
+
+        if (read_u32(data + 4) != 2)
+        {
+            DW_LOG_ERROR("Unsupported GLB container version: " + path);
+            return false;
+        }
+
+        while (offset + 8 <= length)
+        {
+            size_t   chunk_length = read_u32(data + offset);
+            uint32_t chunk_type   = read_u32(data + offset + 4);
+
+            offset += 8;
+
+            if (chunk_length > length - offset)
+                break;
+
+            if (chunk_type == GLB_CHUNK_JSON && !json_begin)
+            {
+                json_begin = data + offset;
+                json_size  = chunk_length;
+            }
+            else if (chunk_type == GLB_CHUNK_BIN && !glb_chunk.data)
+            {
+                glb_chunk.data = data + offset;
+                glb_chunk.size = chunk_length;
+            }
+
+            offset += chunk_length;
+        }
+
+        if (!json_begin)
+        {
+            DW_LOG_ERROR("GLB file has no JSON chunk: " + path);
+            return false;
+        }
+    }
+
+    doc.json = nlohmann::json::parse(json_begin, json_begin + json_size, nullptr, false);
+
+    if (doc.json.is_discarded() || !doc.json.is_object())
+    {
+        DW_LOG_ERROR("Failed to parse glTF JSON: " + path);
+        return false;
+    }
+
+    std::string version = doc.json["asset"].value("version", std::string());
+
+    if (version.empty() || version[0] != '2')
+    {
+        DW_LOG_ERROR("Unsupported glTF version '" + version + "': " + path);
+        return false;
+    }
+
+    if (doc.json.find("extensionsRequired") != doc.json.end())
+    {
+        for (const auto& extension : doc.json["extensionsRequired"])
+        {
+            if (!is_supported_extension(extension))
+            {
+                DW_LOG_WARNING("glTF file requires unsupported extension " + extension.get<std::string>() + ": " + path);
+                return false;
+            }
+        }
+    }
+
+    return load_buffers(doc, glb_chunk) && load_buffer_views(doc);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Accessors.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t component_size(uint32_t component_type)
+{
+    switch (component_type)
+    {
+        case GLTF_BYTE:
+        case GLTF_UNSIGNED_BYTE:
+            return 1;
+        case GLTF_SHORT:
+        case GLTF_UNSIGNED_SHORT:
+            return 2;
+        case GLTF_UNSIGNED_INT:
+        case GLTF_FLOAT:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool get_accessor(const Document& doc, uint32_t index, Accessor& accessor)
+{
+    if (doc.json.find("accessors") == doc.json.end() || index >= doc.json["accessors"].size())
+        return false;
+
+    const nlohmann::json& json = doc.json["accessors"][index];
+    std::string           type = json["type"];
+
+    if (json.find("sparse") != json.end())
+    {
+        DW_LOG_WARNING("Sparse accessors are not supported: " + doc.path);
+        return false;
+    }
+
+    if (json.find("bufferView") == json.end())
+        return false;
+
+    uint32_t view = json["bufferView"];
+
+    if (view >= doc.views.size() || !doc.views[view].range.data)
+        return false;
+
+    accessor.count          = json["count"];
+    accessor.component_type = json["componentType"];
+    accessor.normalized     = json.value("normalized", false);
+    accessor.components     = type == "SCALAR" ? 1 : (type == "VEC2" ? 2 : (type == "VEC3" ? 3 : (type == "VEC4" ? 4 : 0)));
+
+    size_t element_size = size_t(accessor.components) * component_size(accessor.component_type);
+    size_t offset       = json.value("byteOffset", size_t(0));
+    size_t view_size    = doc.views[view].range.size;
+
+    accessor.stride = doc.views[view].stride ? doc.views[view].stride : uint32_t(element_size);
+    accessor.data   = doc.views[view].range.data + offset;
+
+    if (element_size == 0 || (accessor.count > 0 && (offset > view_size || (accessor.count - 1) * size_t(accessor.stride) + element_size > view_size - offset)))
+        return false;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DW_GLTF_SSE)
+
+// Widens the first four components to 32-bit integers. SSE2 has no sign extending loads, so signed values are duplicated
+// into the upper bits and shifted back down.
+template <typename T>
+__m128i widen(__m128i v);
+
+template <>
+inline __m128i widen<int8_t>(__m128i v)
+{
+    v = _mm_unpacklo_epi8(v, v);
+    return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 24);
+}
+
+template <>
+inline __m128i widen<uint8_t>(__m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+}
+
+template <>
+inline __m128i widen<int16_t>(__m128i v)
+{
+    return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+}
+
+template <>
+inline __m128i widen<uint16_t>(__m128i v)
+{
+    return _mm_unpacklo_epi16(v, _mm_setzero_si128());
+}
+
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Converts every element of N components to four floats, zero filling missing components. Elements are at most 8 bytes,
+// which SSE2 loads, widens and converts in one go; elsewhere the fixed width inner loop is left to the compiler.
+template <typename T, uint32_t N>
+void convert_elements(const Accessor& accessor, float scale, float min_value, uint8_t* dst, size_t dst_stride)
+{
+#if defined(DW_GLTF_SSE)
+    const __m128 scale4     = _mm_set1_ps(scale);
+    const __m128 min_value4 = _mm_set1_ps(min_value);
+
+    for (uint32_t i = 0; i < accessor.count; i++)
+    {
+        uint64_t bits = 0;
+
+        memcpy(&bits, accessor.data + size_t(i) * accessor.stride, N * sizeof(T));
+
+        __m128 result = _mm_cvtepi32_ps(widen<T>(_mm_loadl_epi64((const __m128i*)&bits)));
+
+        _mm_storeu_ps((float*)(dst + size_t(i) * dst_stride), _mm_max_ps(_mm_mul_ps(result, scale4), min_value4));
+    }
+#else
+    for (uint32_t i = 0; i < accessor.count; i++)
+    {
+        T     values[4] = { 0, 0, 0, 0 };
+        float result[4];
+
+        memcpy(values, accessor.data + size_t(i) * accessor.stride, N * sizeof(T));
+
+        for (uint32_t c = 0; c < 4; c++)
+            result[c] = std::max(float(values[c]) * scale, min_value);
+
+        memcpy(dst + size_t(i) * dst_stride, result, sizeof(result));
+    }
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename T>
+void convert_attribute(const Accessor& accessor, float scale, float min_value, uint8_t* dst, size_t dst_stride)
+{
+    switch (accessor.components)
+    {
+        case 1:
+            convert_elements<T, 1>(accessor, scale, min_value, dst, dst_stride);
+            break;
+        case 2:
+            convert_elements<T, 2>(accessor, scale, min_value, dst, dst_stride);
+            break;
+        case 3:
+            convert_elements<T, 3>(accessor, scale, min_value, dst, dst_stride);
+            break;
+        default:
+            convert_elements<T, 4>(accessor, scale, min_value, dst, dst_stride);
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool read_attribute(const Accessor& accessor, glm::vec4* dst)
+{
+    uint8_t* out    = reinterpret_cast<uint8_t*>(dst);
+    size_t   stride = sizeof(Vertex);
+
+    // Normalized signed values are clamped to -1 as the specification requires. KHR_mesh_quantization allows any of these
+    // types for positions, normals, tangents and texture coordinates.
+    switch (accessor.component_type)
+    {
+        case GLTF_FLOAT:
+        {
+            for (uint32_t i = 0; i < accessor.count; i++)
+            {
+                float result[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+                memcpy(result, accessor.data + size_t(i) * accessor.stride, accessor.components * sizeof(float));
+                memcpy(out + size_t(i) * stride, result, sizeof(result));
+            }
+            return true;
+        }
+        case GLTF_BYTE:
+            convert_attribute<int8_t>(accessor, accessor.normalized ? 1.0f / 127.0f : 1.0f, accessor.normalized ? -1.0f : -FLT_MAX, out, stride);
+            return true;
+        case GLTF_UNSIGNED_BYTE:
+            convert_attribute<uint8_t>(accessor, accessor.normalized ? 1.0f / 255.0f : 1.0f, -FLT_MAX, out, stride);
+            return true;
+        case GLTF_SHORT:
+            convert_attribute<int16_t>(accessor, accessor.normalized ? 1.0f / 32767.0f : 1.0f, accessor.normalized ? -1.0f : -FLT_MAX, out, stride);
+            return true;
+        case GLTF_UNSIGNED_SHORT:
+            convert_attribute<uint16_t>(accessor, accessor.normalized ? 1.0f / 65535.0f : 1.0f, -FLT_MAX, out, stride);
+            return true;
+        default:
+            return false;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+template <typename T>
+bool convert_indices(const Accessor& accessor, uint32_t base_vertex, uint32_t vertex_count, uint32_t* dst)
+{
+    uint32_t max_index = 0;
+
+    for (uint32_t i = 0; i < accessor.count; i++)
+    {
+        T index;
+
+        memcpy(&index, accessor.data + size_t(i) * accessor.stride, sizeof(T));
+
+        max_index = std::max(max_index, uint32_t(index));
+        dst[i]    = base_vertex + uint32_t(index);
+    }
+
+    return accessor.count == 0 || max_index < vertex_count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool read_indices(const Accessor& accessor, uint32_t base_vertex, uint32_t vertex_count, uint32_t* dst)
+{
+    if (accessor.components != 1)
+        return false;
+
+    switch (accessor.component_type)
+    {
+        case GLTF_UNSIGNED_BYTE:
+            return convert_indices<uint8_t>(accessor, base_vertex, vertex_count, dst);
+        case GLTF_UNSIGNED_SHORT:
+            return convert_indices<uint16_t>(accessor, base_vertex, vertex_count, dst);
+        case GLTF_UNSIGNED_INT:
+            return convert_indices<uint32_t>(accessor, base_vertex, vertex_count, dst);
+        default:
+            return false;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Materials.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::string texture_path(const Document& doc, const nlohmann::json& texture_info)
+{
+    uint32_t texture = texture_info.value("index", UINT32_MAX);
+
+    if (doc.json.find("textures") == doc.json.end() || texture >= doc.json["textures"].size())
+        return "";
+
+    uint32_t image = doc.json["textures"][texture].value("source", UINT32_MAX);
+
+    if (doc.json.find("images") == doc.json.end() || image >= doc.json["images"].size())
+        return "";
+
+    const nlohmann::json& json = doc.json["images"][image];
+
+    if (json.find("uri") == json.end() || json["uri"].get<std::string>().compare(0, 5, "data:") == 0)
+    {
+        DW_LOG_WARNING("Skipping embedded image " + std::to_string(image) + " in " + doc.path + ", only external images are supported.");
+        return "";
+    }
+
+    std::string path = utility::path_without_file(doc.path) + "/" + decode_uri(json["uri"]);
+
+    std::replace(path.begin(), path.end(), '\\', '/');
+
+    return path;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void load_materials(const Document& doc, std::vector<MaterialDesc>& materials)
+{
+    if (doc.json.find("materials") == doc.json.end())
+        return;
+
+    for (const auto& json : doc.json["materials"])
+    {
+        MaterialDesc desc;
+
+        if (json.find("pbrMetallicRoughness") != json.end())
+        {
+            const nlohmann::json& pbr = json["pbrMetallicRoughness"];
+
+            if (pbr.find("baseColorFactor") != pbr.end())
+                desc.base_color_factor = glm::vec4(pbr["baseColorFactor"][0], pbr["baseColorFactor"][1], pbr["baseColorFactor"][2], pbr["baseColorFactor"][3]);
+
+            desc.metallic_factor  = pbr.value("metallicFactor", 1.0f);
+            desc.roughness_factor = pbr.value("roughnessFactor", 1.0f);
+
+            if (pbr.find("baseColorTexture") != pbr.end())
+                desc.base_color_texture = texture_path(doc, pbr["baseColorTexture"]);
+
+            if (pbr.find("metallicRoughnessTexture") != pbr.end())
+                desc.metallic_roughness_texture = texture_path(doc, pbr["metallicRoughnessTexture"]);
+        }
+
+        if (json.find("normalTexture") != json.end())
+            desc.normal_texture = texture_path(doc, json["normalTexture"]);
+
+        if (json.find("emissiveTexture") != json.end())
+            desc.emissive_texture = texture_path(doc, json["emissiveTexture"]);
+
+        if (json.find("emissiveFactor") != json.end())
+            desc.emissive_factor = glm::vec3(json["emissiveFactor"][0], json["emissiveFactor"][1], json["emissiveFactor"][2]);
+
+        desc.alpha_test = json.value("alphaMode", std::string("OPAQUE")) == "MASK";
+
+        materials.push_back(desc);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Scene traversal.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+glm::mat4 node_transform(const nlohmann::json& node)
+{
+    glm::mat4 transform = glm::mat4(1.0f);
+
+    if (node.find("matrix") != node.end())
+    {
+        const nlohmann::json& matrix = node["matrix"];
+
+        for (int column = 0; column < 4; column++)
+        {
+            for (int row = 0; row < 4; row++)
+                transform[column][row] = matrix[column * 4 + row];
+        }
+
+        return transform;
+    }
+
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::vec3 scale       = glm::vec3(1.0f);
+    glm::quat rotation    = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+    if (node.find("translation") != node.end())
+        translation = glm::vec3(node["translation"][0], node["translation"][1], node["translation"][2]);
+
+    if (node.find("rotation") != node.end())
+        rotation = glm::quat(node["rotation"][3], node["rotation"][0], node["rotation"][1], node["rotation"][2]);
+
+    if (node.find("scale") != node.end())
+        scale = glm::vec3(node["scale"][0], node["scale"][1], node["scale"][2]);
+
+    glm::mat4 r = glm::mat4_cast(rotation);
+
+    transform[0] = r[0] * scale.x;
+    transform[1] = r[1] * scale.y;
+    transform[2] = r[2] * scale.z;
+    transform[3] = glm::vec4(translation, 1.0f);
+
+    return transform;
+}
+
+// Lays out every triangle primitive of a mesh in the model. Vertex and index data is filled in later.
+bool add_mesh(const Document& doc, uint32_t mesh_index, Model& model, std::vector<Primitive>& layouts, uint64_t& vertex_count, uint64_t& index_count)
+{
+    const nlohmann::json& mesh       = doc.json["meshes"][mesh_index];
+    const nlohmann::json& primitives = mesh["primitives"];
+    std::string           name       = mesh.value("name", "mesh_" + std::to_string(mesh_index));
+
+    for (size_t p = 0; p < primitives.size(); p++)
+    {
+        const nlohmann::json& primitive = primitives[p];
+
+        if (primitive.value("mode", GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES)
+        {
+            DW_LOG_WARNING("Skipping non-triangle primitive in " + name + ": " + doc.path);
+            continue;
+        }
+
+        const nlohmann::json& attributes = primitive["attributes"];
+        Accessor              position;
+        Accessor              indices;
+
+        if (attributes.find("POSITION") == attributes.end() || !get_accessor(doc, attributes["POSITION"], position))
+            return false;
+
+        if (primitive.find("indices") != primitive.end())
+        {
+            if (!get_accessor(doc, primitive["indices"], indices))
+                return false;
+        }
+        else
+            indices.count = position.count;
+
+        if (indices.count % 3 != 0)
+            return false;
+
+        if (position.count == 0 || indices.count == 0)
+            continue;
+
+        Primitive layout;
+
+        layout.primitive    = &primitive;
+        layout.sub_mesh     = model.sub_meshes.size();
+        layout.base_vertex  = uint32_t(vertex_count);
+        layout.vertex_count = position.count;
+        layout.base_index   = uint32_t(index_count);
+        layout.index_count  = indices.count;
+
+        SubMesh sub_mesh;
+
+        // Primitives are named like Assimp names them, so set_submesh_material() keeps working.
+        sub_mesh.name         = primitives.size() > 1 ? name + "-" + std::to_string(p) : name;
+        sub_mesh.mat_idx      = primitive.value("material", GLTF_NO_MATERIAL);
+        sub_mesh.index_count  = indices.count;
+        sub_mesh.base_vertex  = 0;
+        sub_mesh.base_index   = layout.base_index;
+        sub_mesh.vertex_count = position.count;
+
+        if (sub_mesh.mat_idx >= model.materials.size())
+            sub_mesh.mat_idx = GLTF_NO_MATERIAL;
+
+        model.sub_meshes.push_back(sub_mesh);
+        layouts.push_back(layout);
+
+        vertex_count += position.count;
+        index_count += indices.count;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every mesh is laid out once, in the order of the file, like Assimp lists them.
+bool layout_meshes(const Document& doc, Model& model, std::vector<Primitive>& layouts, std::vector<std::pair<uint32_t, uint32_t>>& mesh_sub_meshes)
+{
+    uint64_t vertex_count = 0;
+    uint64_t index_count  = 0;
+
+    if (doc.json.find("meshes") == doc.json.end())
+        return false;
+
+    for (uint32_t i = 0; i < doc.json["meshes"].size(); i++)
+    {
+        uint32_t first = uint32_t(model.sub_meshes.size());
+
+        if (!add_mesh(doc, i, model, layouts, vertex_count, index_count))
+            return false;
+
+        mesh_sub_meshes.push_back({ first, uint32_t(model.sub_meshes.size()) - first });
+    }
+
+    return vertex_count <= UINT32_MAX && index_count <= UINT32_MAX;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Collects the nodes of the default scene that place a mesh, along with their transforms relative to the scene. The first
+// node placing each mesh is kept in mesh_nodes, or UINT32_MAX if the scene does not place it.
+bool layout_nodes(const Document& doc, const std::vector<std::pair<uint32_t, uint32_t>>& mesh_sub_meshes, Model& model, std::vector<uint32_t>& mesh_nodes)
+{
+    mesh_nodes.assign(mesh_sub_meshes.size(), UINT32_MAX);
+
+    if (doc.json.find("scenes") == doc.json.end() || doc.json.find("nodes") == doc.json.end())
+        return true;
+
+    const nlohmann::json& nodes = doc.json["nodes"];
+    uint32_t              scene = doc.json.value("scene", 0u);
+
+    if (scene >= doc.json["scenes"].size())
+        return false;
+
+    // Depth first, in the order the nodes are listed. Nodes form a forest, so visiting one twice means the file is malformed.
+    std::vector<std::pair<uint32_t, glm::mat4>> stack;
+    std::vector<bool>                           visited(nodes.size(), false);
+    const nlohmann::json&                       roots = doc.json["scenes"][scene].value("nodes", nlohmann::json::array());
+
+    for (size_t i = roots.size(); i > 0; i--)
+        stack.push_back({ roots[i - 1], glm::mat4(1.0f) });
+
+    while (!stack.empty())
+    {
+        uint32_t  index  = stack.back().first;
+        glm::mat4 parent = stack.back().second;
+
+        stack.pop_back();
+
+        if (index >= nodes.size() || visited[index])
+            return false;
+
+        visited[index] = true;
+
+        const nlohmann::json& node      = nodes[index];
+        glm::mat4             transform = parent * node_transform(node);
+
+        if (node.find("mesh") != node.end())
+        {
+            uint32_t mesh = node["mesh"];
+
+            if (mesh >= mesh_sub_meshes.size())
+                return false;
+
+            Node placed;
+
+            placed.name           = node.value("name", "node_" + std::to_string(index));
+            placed.transform      = transform;
+            placed.first_sub_mesh = mesh_sub_meshes[mesh].first;
+            placed.sub_mesh_count = mesh_sub_meshes[mesh].second;
+
+            model.nodes.push_back(placed);
+
+            if (mesh_nodes[mesh] == UINT32_MAX)
+                mesh_nodes[mesh] = index;
+        }
+
+        if (node.find("children") != node.end())
+        {
+            const nlohmann::json& children = node["children"];
+
+            for (size_t i = children.size(); i > 0; i--)
+                stack.push_back({ children[i - 1], transform });
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// KHR_mesh_quantization leaves the scale and offset of integer positions to the node placing the mesh, so on their own the
+// vertices are in quantized units. For meshes whose positions are all quantized, the scale of the first node placing the
+// mesh is moved into the vertices, along with its translation unless the node also rotates or mirrors. Every node placing
+// the mesh is compensated, so the scene is unchanged. Meshes the scene does not place stay in quantized units.
+void dequantize_meshes(const Document& doc, const std::vector<std::pair<uint32_t, uint32_t>>& mesh_sub_meshes, const std::vector<uint32_t>& mesh_nodes, std::vector<Primitive>& layouts, Model& model)
+{
+    for (uint32_t mesh = 0; mesh < mesh_sub_meshes.size(); mesh++)
+    {
+        uint32_t first = mesh_sub_meshes[mesh].first;
+        uint32_t count = mesh_sub_meshes[mesh].second;
+
+        if (count == 0 || mesh_nodes[mesh] == UINT32_MAX)
+            continue;
+
+        bool quantized = true;
+
+        for (uint32_t i = first; i < first + count && quantized; i++)
+        {
+            Accessor position;
+
+            quantized = get_accessor(doc, (*layouts[i].primitive)["attributes"]["POSITION"], position) && position.component_type != GLTF_FLOAT;
+        }
+
+        if (!quantized)
+            continue;
+
+        glm::mat4 local  = node_transform(doc.json["nodes"][mesh_nodes[mesh]]);
+        glm::vec3 scale  = glm::vec3(glm::length(glm::vec3(local[0])), glm::length(glm::vec3(local[1])), glm::length(glm::vec3(local[2])));
+        glm::vec3 offset = glm::vec3(0.0f);
+
+        if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f)
+            continue;
+
+        if (local[0] == glm::vec4(scale.x, 0.0f, 0.0f, 0.0f) && local[1] == glm::vec4(0.0f, scale.y, 0.0f, 0.0f) && local[2] == glm::vec4(0.0f, 0.0f, scale.z, 0.0f))
+            offset = glm::vec3(local[3]);
+
+        // Undoes the scale and offset the vertices are given.
+        glm::mat4 compensation = glm::mat4(1.0f);
+
+        compensation[0][0] = 1.0f / scale.x;
+        compensation[1][1] = 1.0f / scale.y;
+        compensation[2][2] = 1.0f / scale.z;
+        compensation[3]    = glm::vec4(-offset / scale, 1.0f);
+
+        for (uint32_t i = first; i < first + count; i++)
+        {
+            layouts[i].position_scale  = scale;
+            layouts[i].position_offset = offset;
+        }
+
+        for (auto& node : model.nodes)
+        {
+            if (node.first_sub_mesh == first && node.sub_mesh_count == count)
+                node.transform = node.transform * compensation;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Primitive conversion.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Area weighted smooth normals, matching what aiProcess_GenSmoothNormals produces for the Assimp path.
+void generate_normals(Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, uint32_t base_vertex)
+{
+    for (uint32_t i = 0; i < vertex_count; i++)
+        vertices[i].normal = glm::vec4(0.0f);
+
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        Vertex& v0 = vertices[indices[i + 0] - base_vertex];
+        Vertex& v1 = vertices[indices[i + 1] - base_vertex];
+        Vertex& v2 = vertices[indices[i + 2] - base_vertex];
+
+        glm::vec3 p0 = glm::vec3(v0.position);
+        glm::vec4 n  = glm::vec4(glm::cross(glm::vec3(v1.position) - p0, glm::vec3(v2.position) - p0), 0.0f);
+
+        v0.normal += n;
+        v1.normal += n;
+        v2.normal += n;
+    }
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        float length = glm::length(glm::vec3(vertices[i].normal));
+
+        vertices[i].normal = length > 0.0f ? vertices[i].normal / length : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Per-vertex tangent frames from the texture coordinate gradients. The handedness is stored in tangent.w like glTF does.
+void generate_tangents(Vertex* vertices, uint32_t vertex_count, const uint32_t* indices, uint32_t index_count, uint32_t base_vertex)
+{
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        vertices[i].tangent   = glm::vec4(0.0f);
+        vertices[i].bitangent = glm::vec4(0.0f);
+    }
+
+    for (uint32_t i = 0; i < index_count; i += 3)
+    {
+        Vertex& v0 = vertices[indices[i + 0] - base_vertex];
+        Vertex& v1 = vertices[indices[i + 1] - base_vertex];
+        Vertex& v2 = vertices[indices[i + 2] - base_vertex];
+
+        glm::vec3 e1  = glm::vec3(v1.position) - glm::vec3(v0.position);
+        glm::vec3 e2  = glm::vec3(v2.position) - glm::vec3(v0.position);
+        float     du1 = v1.tex_coord.x - v0.tex_coord.x;
+        float     dv1 = v1.tex_coord.y - v0.tex_coord.y;
+        float     du2 = v2.tex_coord.x - v0.tex_coord.x;
+        float     dv2 = v2.tex_coord.y - v0.tex_coord.y;
+        float     det = du1 * dv2 - du2 * dv1;
+
+        if (fabsf(det) < 1e-20f)
+            continue;
+
+        glm::vec4 t = glm::vec4((e1 * dv2 - e2 * dv1) / det, 0.0f);
+        glm::vec4 b = glm::vec4((e2 * du1 - e1 * du2) / det, 0.0f);
+
+        v0.tangent += t;
+        v1.tangent += t;
+        v2.tangent += t;
+
+        v0.bitangent += b;
+        v1.bitangent += b;
+        v2.bitangent += b;
+    }
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        glm::vec3 n = glm::vec3(vertices[i].normal);
+        glm::vec3 t = glm::vec3(vertices[i].tangent);
+
+        // Gram-Schmidt orthogonalize against the normal.
+        t = t - n * glm::dot(n, t);
+
+        float length = glm::length(t);
+
+        if (length > 0.0f)
+            t = t / length;
+        else
+        {
+            // Degenerate texture mapping. Any tangent perpendicular to the normal will do.
+            t = glm::cross(n, fabsf(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f));
+            t = t / std::max(glm::length(t), FLT_MIN);
+        }
+
+        float w = glm::dot(glm::cross(n, t), glm::vec3(vertices[i].bitangent)) < 0.0f ? -1.0f : 1.0f;
+
+        vertices[i].tangent = glm::vec4(t, w);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load_primitive(const Document& doc, const Primitive& layout, Model& model)
+{
+    const nlohmann::json& primitive  = *layout.primitive;
+    const nlohmann::json& attributes = primitive["attributes"];
+    Vertex*               vertices   = &model.vertices[layout.base_vertex];
+    uint32_t*             indices    = &model.indices[layout.base_index];
+    uint32_t              count      = layout.vertex_count;
+    Accessor              accessor;
+
+    if (!get_accessor(doc, attributes["POSITION"], accessor) || !read_attribute(accessor, &vertices[0].position))
+        return false;
+
+    bool rescaled = layout.position_scale != glm::vec3(1.0f) || layout.position_offset != glm::vec3(0.0f);
+
+    if (rescaled)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            vertices[i].position = glm::vec4(glm::vec3(vertices[i].position) * layout.position_scale + layout.position_offset, 1.0f);
+    }
+
+    bool has_normals    = attributes.find("NORMAL") != attributes.end();
+    bool has_tangents   = attributes.find("TANGENT") != attributes.end();
+    bool has_tex_coords = attributes.find("TEXCOORD_0") != attributes.end();
+
+    if (has_normals && (!get_accessor(doc, attributes["NORMAL"], accessor) || accessor.count != count || !read_attribute(accessor, &vertices[0].normal)))
+        return false;
+
+    if (has_tangents && (!get_accessor(doc, attributes["TANGENT"], accessor) || accessor.count != count || accessor.components != 4 || !read_attribute(accessor, &vertices[0].tangent)))
+        return false;
+
+    // A non-uniform scale turns normals and tangents along with the positions. Normals are normalized further down.
+    if (rescaled)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (has_normals)
+                vertices[i].normal = glm::vec4(glm::vec3(vertices[i].normal) / layout.position_scale, 0.0f);
+
+            if (has_tangents)
+                vertices[i].tangent = glm::vec4(glm::normalize(glm::vec3(vertices[i].tangent) * layout.position_scale), vertices[i].tangent.w);
+        }
+    }
+
+    if (has_tex_coords && (!get_accessor(doc, attributes["TEXCOORD_0"], accessor) || accessor.count != count || !read_attribute(accessor, &vertices[0].tex_coord)))
+        return false;
+
+    if (!has_tex_coords)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            vertices[i].tex_coord = glm::vec4(0.0f);
+    }
+
+    if (primitive.find("indices") != primitive.end())
+    {
+        if (!get_accessor(doc, primitive["indices"], accessor) || !read_indices(accessor, layout.base_vertex, count, indices))
+            return false;
+    }
+    else
+    {
+        for (uint32_t i = 0; i < layout.index_count; i++)
+            indices[i] = layout.base_vertex + i;
+    }
+
+    if (!has_normals)
+        generate_normals(vertices, count, indices, layout.index_count, layout.base_vertex);
+    else
+    {
+        // Quantized normals are not unit length after conversion.
+        for (uint32_t i = 0; i < count; i++)
+        {
+            float length       = glm::length(glm::vec3(vertices[i].normal));
+            vertices[i].normal = length > 0.0f ? glm::vec4(glm::vec3(vertices[i].normal) / length, 0.0f) : glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+        }
+    }
+
+    if (!has_tangents && has_tex_coords)
+        generate_tangents(vertices, count, indices, layout.index_count, layout.base_vertex);
+
+    SubMesh& sub_mesh = model.sub_meshes[layout.sub_mesh];
+
+    sub_mesh.max_extents = glm::vec3(vertices[0].position);
+    sub_mesh.min_extents = glm::vec3(vertices[0].position);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Vertex&   vertex   = vertices[i];
+        glm::vec3 position = glm::vec3(vertex.position);
+
+        sub_mesh.max_extents = glm::max(sub_mesh.max_extents, position);
+        sub_mesh.min_extents = glm::min(sub_mesh.min_extents, position);
+
+        // The material index goes into w once the mesh has resolved its materials.
+        vertex.position.w = 0.0f;
+
+        if (has_tangents || has_tex_coords)
+        {
+            // Same tangent frame convention as the Assimp path: the bitangent follows the handedness and the tangent is
+            // flipped for mirrored frames.
+            glm::vec3 n = glm::vec3(vertex.normal);
+            glm::vec3 t = glm::vec3(vertex.tangent);
+            glm::vec3 b = glm::cross(n, t) * vertex.tangent.w;
+
+            if (glm::dot(glm::cross(n, t), b) < 0.0f)
+                t *= -1.0f;
+
+            vertex.tangent   = glm::vec4(t, 0.0f);
+            vertex.bitangent = glm::vec4(b, 0.0f);
+        }
+        else
+        {
+            vertex.tangent   = glm::vec4(0.0f);
+            vertex.bitangent = glm::vec4(0.0f);
+        }
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool load(const std::string& path, Model& model)
+{
+    model = Model();
+
+    Document                                   doc;
+    std::vector<Primitive>                     layouts;
+    std::vector<std::pair<uint32_t, uint32_t>> mesh_sub_meshes;
+    std::vector<uint32_t>                      mesh_nodes;
+
+    // Type mismatches in the JSON surface as exceptions from the accessors of the parsed document.
+    try
+    {
+        if (!load_document(path, doc))
+            return false;
+
+        load_materials(doc, model.materials);
+
+        if (!layout_meshes(doc, model, layouts, mesh_sub_meshes) || layouts.empty())
+        {
+            DW_LOG_ERROR("glTF file has no valid triangle primitives: " + path);
+            return false;
+        }
+
+        if (!layout_nodes(doc, mesh_sub_meshes, model, mesh_nodes))
+        {
+            DW_LOG_ERROR("glTF file has an invalid scene: " + path);
+            model = Model();
+            return false;
+        }
+
+        dequantize_meshes(doc, mesh_sub_meshes, mesh_nodes, layouts, model);
+
+        uint32_t vertex_count = layouts.back().base_vertex + layouts.back().vertex_count;
+        uint32_t index_count  = layouts.back().base_index + layouts.back().index_count;
+
+        model.vertices.resize(vertex_count);
+        model.indices.resize(index_count);
+
+        std::atomic<bool> failed = { false };
+
+        jobs::parallel_for(layouts.size(), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+            {
+                if (!load_primitive(doc, layouts[i], model))
+                {
+                    DW_LOG_ERROR("Invalid primitive " + model.sub_meshes[layouts[i].sub_mesh].name + " in " + path);
+                    failed = true;
+                }
+            }
+        });
+
+        if (failed)
+        {
+            model = Model();
+            return false;
+        }
+    }
+    catch (const nlohmann::json::exception& e)
+    {
+        DW_LOG_ERROR("Malformed glTF file " + path + ": " + e.what());
+        model = Model();
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace gltf
+} // namespace dw
@@ -0,0 +1,846 @@
+#include <io.h>
+#include <vfs.h>
+#include <logger.h>
+#include <macros.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <string.h>
+
+#if defined(__linux__) && !defined(__EMSCRIPTEN__) && !defined(__ANDROID__)
+#    define DWSF_IO_URING
+#    include <linux/io_uring.h>
+#    include <sys/eventfd.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <poll.h>
+#    include <unistd.h>
+#endif
+
+// Largest read issued by a single submission. Larger files are read in several pieces.
+#define IO_MAX_READ_SIZE (1u << 30)
+// User data of the poll on the wake event. Every other submission carries a pointer to its operation.
+#define IO_WAKE_USER_DATA 0
+
+namespace dw
+{
+namespace io
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct Operation
+{
+    std::string          path;
+    Callback             callback;
+    jobs::Counter*       counter;
+    const uint8_t*       data    = nullptr;
+    uint64_t             size    = 0;
+    bool                 success = false;
+    // Archive entries and reads done by the fallback threads.
+    vfs::File            file;
+    // Reads that do not fit into a registered buffer.
+    std::vector<uint8_t> heap;
+    int32_t              buffer = -1;
+    uint64_t             offset = 0;
+    int                  fd     = -1;
+#if defined(DWSF_IO_URING)
+    iovec                vector;
+#endif
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_IO_URING)
+
+// liburing is not a dependency, so the ring is driven through the raw system calls.
+int ring_setup(uint32_t entries, io_uring_params* params)
+{
+    return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int ring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    return int(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int ring_register(int fd, uint32_t opcode, const void* arg, uint32_t count)
+{
+    return int(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Submission and completion queues shared with the kernel. The kernel reads the submission tail and writes the completion
+// tail, so those are accessed with acquire/release ordering.
+struct Ring
+{
+    int           fd           = -1;
+    void*         sq_ring      = nullptr;
+    void*         cq_ring      = nullptr;
+    size_t        sq_ring_size = 0;
+    size_t        cq_ring_size = 0;
+    io_uring_sqe* sqes         = nullptr;
+    size_t        sqes_size    = 0;
+    uint32_t*     sq_head      = nullptr;
+    uint32_t*     sq_tail      = nullptr;
+    uint32_t*     sq_array     = nullptr;
+    uint32_t      sq_mask      = 0;
+    uint32_t      sq_entries   = 0;
+    uint32_t*     cq_head      = nullptr;
+    uint32_t*     cq_tail      = nullptr;
+    io_uring_cqe* cqes         = nullptr;
+    uint32_t      cq_mask      = 0;
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool create(uint32_t entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        fd = ring_setup(entries, &params);
+
+        if (fd < 0)
+            return false;
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        sqes_size    = params.sq_entries * sizeof(io_uring_sqe);
+
+        bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+
+        if (single_mmap)
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+        if (sq_ring == MAP_FAILED)
+        {
+            sq_ring = nullptr;
+            destroy();
+            return false;
+        }
+
+        if (single_mmap)
+            cq_ring = sq_ring;
+        else
+        {
+            cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+
+            if (cq_ring == MAP_FAILED)
+            {
+                cq_ring = nullptr;
+                destroy();
+                return false;
+            }
+        }
+
+        void* sqe_mapping = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+        if (sqe_mapping == MAP_FAILED)
+        {
+            destroy();
+            return false;
+        }
+
+        sqes = (io_uring_sqe*)sqe_mapping;
+
+        uint8_t* sq = (uint8_t*)sq_ring;
+        uint8_t* cq = (uint8_t*)cq_ring;
+
+        sq_head    = (uint32_t*)(sq + params.sq_off.head);
+        sq_tail    = (uint32_t*)(sq + params.sq_off.tail);
+        sq_array   = (uint32_t*)(sq + params.sq_off.array);
+        sq_mask    = *(uint32_t*)(sq + params.sq_off.ring_mask);
+        sq_entries = *(uint32_t*)(sq + params.sq_off.ring_entries);
+        cq_head    = (uint32_t*)(cq + params.cq_off.head);
+        cq_tail    = (uint32_t*)(cq + params.cq_off.tail);
+        cqes       = (io_uring_cqe*)(cq + params.cq_off.cqes);
+        cq_mask    = *(uint32_t*)(cq + params.cq_off.ring_mask);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void destroy()
+    {
+        if (sqes)
+            munmap(sqes, sqes_size);
+
+        if (cq_ring && cq_ring != sq_ring)
+            munmap(cq_ring, cq_ring_size);
+
+        if (sq_ring)
+            munmap(sq_ring, sq_ring_size);
+
+        if (fd >= 0)
+            close(fd);
+
+        fd      = -1;
+        sqes    = nullptr;
+        sq_ring = nullptr;
+        cq_ring = nullptr;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // The caller never has more submissions outstanding than there are submission entries, so the queue cannot be full.
+    io_uring_sqe* next_sqe()
+    {
+        io_uring_sqe* sqe = &sqes[*sq_tail & sq_mask];
+
+        memset(sqe, 0, sizeof(io_uring_sqe));
+
+        return sqe;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Publishes the entry returned by next_sqe().
+    void push_sqe()
+    {
+        uint32_t tail  = *sq_tail;
+        uint32_t index = tail & sq_mask;
+
+        sq_array[index] = index;
+
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Queues a read of the next piece of the operation's file.
+    void push_read(Operation* op)
+    {
+        io_uring_sqe* sqe  = next_sqe();
+        uint32_t      size = uint32_t(std::min(op->size - op->offset, uint64_t(IO_MAX_READ_SIZE)));
+        uint8_t*      data = const_cast<uint8_t*>(op->data) + op->offset;
+
+        sqe->fd        = op->fd;
+        sqe->off       = op->offset;
+        sqe->user_data = uint64_t(uintptr_t(op));
+
+        if (op->buffer != -1)
+        {
+            sqe->opcode    = IORING_OP_READ_FIXED;
+            sqe->addr      = uint64_t(uintptr_t(data));
+            sqe->len       = size;
+            sqe->buf_index = uint16_t(op->buffer);
+        }
+        else
+        {
+            op->vector.iov_base = data;
+            op->vector.iov_len  = size;
+
+            sqe->opcode = IORING_OP_READV;
+            sqe->addr   = uint64_t(uintptr_t(&op->vector));
+            sqe->len    = 1;
+        }
+
+        push_sqe();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Queues a one-shot poll that completes once the file descriptor becomes readable.
+    void push_poll(int poll_fd)
+    {
+        io_uring_sqe* sqe = next_sqe();
+
+        sqe->opcode      = IORING_OP_POLL_ADD;
+        sqe->fd          = poll_fd;
+        sqe->poll_events = POLLIN;
+        sqe->user_data   = IO_WAKE_USER_DATA;
+
+        push_sqe();
+    }
+};
+
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct Service
+{
+    Service()
+    {
+        m_frame_start = std::chrono::steady_clock::now();
+
+#if defined(DWSF_IO_URING)
+        // Requests arriving while the ring thread waits for completions signal the event, which completes a poll in the ring.
+        m_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+        if (m_wake_fd != -1 && m_ring.create(IO_QUEUE_DEPTH))
+        {
+            m_io_uring = true;
+
+            // Registering buffers pins them, which fails if the memory lock limit is low. Every read then uses its own
+            // buffer instead.
+            size_t buffer_memory = size_t(IO_REGISTERED_BUFFER_COUNT) * IO_REGISTERED_BUFFER_SIZE;
+            void*  buffers       = mmap(nullptr, buffer_memory, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (buffers != MAP_FAILED)
+            {
+                iovec vectors[IO_REGISTERED_BUFFER_COUNT];
+
+                for (uint32_t i = 0; i < IO_REGISTERED_BUFFER_COUNT; i++)
+                {
+                    vectors[i].iov_base = (uint8_t*)buffers + size_t(i) * IO_REGISTERED_BUFFER_SIZE;
+                    vectors[i].iov_len  = IO_REGISTERED_BUFFER_SIZE;
+                }
+
+                if (ring_register(m_ring.fd, IORING_REGISTER_BUFFERS, vectors, IO_REGISTERED_BUFFER_COUNT) == 0)
+                {
+                    m_buffers = (uint8_t*)buffers;
+
+                    for (int32_t i = IO_REGISTERED_BUFFER_COUNT - 1; i >= 0; i--)
+                        m_free_buffers.push_back(i);
+                }
+                else
+                    munmap(buffers, buffer_memory);
+            }
+
+            m_threads.push_back(std::thread(&Service::ring_main, this));
+
+            DW_LOG_INFO("I/O service started with io_uring, queue depth " + std::to_string(IO_QUEUE_DEPTH) + (m_buffers ? ", " + std::to_string(IO_REGISTERED_BUFFER_COUNT) + " registered buffers." : ", no registered buffers."));
+
+            return;
+        }
+
+        if (m_wake_fd != -1)
+            close(m_wake_fd);
+
+        m_wake_fd = -1;
+#endif
+
+        start_fallback_threads(m_threads);
+
+        DW_LOG_INFO("I/O service started with " + std::to_string(IO_FALLBACK_THREAD_COUNT) + " threads.");
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void start_fallback_threads(std::vector<std::thread>& threads)
+    {
+        for (uint32_t i = 0; i < IO_FALLBACK_THREAD_COUNT; i++)
+            threads.push_back(std::thread(&Service::fallback_main, this));
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    ~Service()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_shutdown = true;
+        }
+
+        m_condition.notify_all();
+        wake();
+
+        for (auto& thread : m_threads)
+            thread.join();
+
+#if defined(DWSF_IO_URING)
+        m_ring.destroy();
+
+        if (m_wake_fd != -1)
+            close(m_wake_fd);
+
+        if (m_buffers)
+            munmap(m_buffers, size_t(IO_REGISTERED_BUFFER_COUNT) * IO_REGISTERED_BUFFER_SIZE);
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void enqueue(std::vector<Operation*>& ops)
+    {
+        uint32_t in_flight = m_in_flight.fetch_add(uint32_t(ops.size())) + uint32_t(ops.size());
+        uint32_t peak      = m_max_in_flight.load();
+
+        while (in_flight > peak && !m_max_in_flight.compare_exchange_weak(peak, in_flight))
+            ;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for (auto op : ops)
+                m_queue.push_back(op);
+        }
+
+        m_condition.notify_all();
+        wake();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Interrupts the ring thread if it is waiting for completions.
+    void wake()
+    {
+#if defined(DWSF_IO_URING)
+        if (m_wake_fd != -1)
+        {
+            uint64_t value = 1;
+
+            if (::write(m_wake_fd, &value, sizeof(value)) != sizeof(value))
+                return; // Only fails while the counter is saturated, in which case the thread has been woken already.
+        }
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Hands the data to the callback on the job system. The reference the request holds on the counter is only dropped after
+    // the callback job has taken its own, so waiters never see the counter reach zero early.
+    void complete(Operation* op)
+    {
+        jobs::Counter* counter = op->counter;
+
+        if (!op->success)
+            DW_LOG_ERROR("Failed to read file: " + op->path);
+        else
+            m_bytes += op->size;
+
+        m_completed++;
+        m_in_flight--;
+
+        jobs::JobFunction function = [this, op]() {
+            Result result = { op->path, op->data, size_t(op->size), op->success };
+            op->callback(result);
+
+            release(op);
+        };
+
+        jobs::submit(std::move(function), counter);
+
+        if (counter)
+            counter->value.fetch_sub(1, std::memory_order_release);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void release(Operation* op)
+    {
+        if (op->buffer != -1)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free_buffers.push_back(op->buffer);
+        }
+
+        delete op;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void fallback_main()
+    {
+        while (true)
+        {
+            Operation* op = nullptr;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_condition.wait(lock, [this]() { return !m_queue.empty() || m_shutdown; });
+
+                if (m_queue.empty())
+                    return;
+
+                op = m_queue.front();
+                m_queue.pop_front();
+            }
+
+            op->success = vfs::read(op->path, op->file);
+            op->data    = op->file.data();
+            op->size    = op->file.size();
+
+            complete(op);
+        }
+    }
+
+#if defined(DWSF_IO_URING)
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Opens the file and picks a destination buffer. Returns false if the operation completed right away, which is the case
+    // for archive entries, empty files and files that cannot be opened.
+    bool start(Operation* op)
+    {
+        if (vfs::read_archived(op->path, op->file))
+        {
+            op->data    = op->file.data();
+            op->size    = op->file.size();
+            op->success = true;
+
+            complete(op);
+            return false;
+        }
+
+        struct stat info;
+
+        op->fd = open(op->path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (op->fd == -1 || fstat(op->fd, &info) != 0)
+        {
+            finish(op, false);
+            return false;
+        }
+
+        op->size = uint64_t(info.st_size);
+
+        if (op->size == 0)
+        {
+            finish(op, true);
+            return false;
+        }
+
+        if (op->size <= IO_REGISTERED_BUFFER_SIZE && m_buffers)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (!m_free_buffers.empty())
+            {
+                op->buffer = m_free_buffers.back();
+                m_free_buffers.pop_back();
+            }
+        }
+
+        if (op->buffer != -1)
+            op->data = m_buffers + size_t(op->buffer) * IO_REGISTERED_BUFFER_SIZE;
+        else
+        {
+            op->heap.resize(op->size);
+            op->data = op->heap.data();
+        }
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void finish(Operation* op, bool success)
+    {
+        if (op->fd != -1)
+            close(op->fd);
+
+        op->fd      = -1;
+        op->success = success;
+
+        complete(op);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Owns the ring. New requests are picked up whenever a completion arrives, including the poll on the wake event that every
+    // enqueue() signals, or when the ring runs empty. They are submitted together with any reads that have to continue.
+    void ring_main()
+    {
+        std::vector<Operation*>        incoming;
+        std::unordered_set<Operation*> reading;
+        uint32_t                       to_submit = 0;
+        uint32_t                       failures  = 0;
+
+        // One submission entry stays reserved for the poll, which is rearmed each time it completes.
+        const uint32_t max_reads = m_ring.sq_entries - 1;
+
+        m_ring.push_poll(m_wake_fd);
+        to_submit++;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                if (reading.empty())
+                {
+                    m_condition.wait(lock, [this]() { return !m_queue.empty() || m_shutdown; });
+
+                    if (m_queue.empty())
+                        return;
+                }
+
+                while (!m_queue.empty() && reading.size() + incoming.size() < max_reads)
+                {
+                    incoming.push_back(m_queue.front());
+                    m_queue.pop_front();
+                }
+            }
+
+            for (auto op : incoming)
+            {
+                if (start(op))
+                {
+                    m_ring.push_read(op);
+                    reading.insert(op);
+                    to_submit++;
+                }
+            }
+
+            incoming.clear();
+
+            if (reading.empty())
+                continue;
+
+            int submitted = ring_enter(m_ring.fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+
+            if (submitted < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                // Completions that arrived anyway are still reaped below, which is how a full completion queue (EBUSY)
+                // clears. Only failures that leave nothing to reap count towards giving up.
+                submitted = 0;
+
+                if (*m_ring.cq_head == __atomic_load_n(m_ring.cq_tail, __ATOMIC_ACQUIRE))
+                {
+                    if (++failures == IO_RING_MAX_FAILURES)
+                    {
+                        DW_LOG_ERROR("io_uring_enter failed: " + std::string(strerror(errno)) + ", continuing with " + std::to_string(IO_FALLBACK_THREAD_COUNT) + " threads.");
+                        abandon_ring(reading);
+                        return;
+                    }
+
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1 << failures));
+                    continue;
+                }
+            }
+
+            failures = 0;
+            to_submit -= uint32_t(submitted);
+
+            uint32_t head = *m_ring.cq_head;
+            uint32_t tail = __atomic_load_n(m_ring.cq_tail, __ATOMIC_ACQUIRE);
+
+            for (; head != tail; head++)
+            {
+                const io_uring_cqe& cqe = m_ring.cqes[head & m_ring.cq_mask];
+
+                // New requests are picked up at the top of the loop.
+                if (cqe.user_data == IO_WAKE_USER_DATA)
+                {
+                    uint64_t value;
+
+                    if (::read(m_wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+                        DW_LOG_ERROR("Failed to reset the I/O wake event: " + std::string(strerror(errno)));
+
+                    m_ring.push_poll(m_wake_fd);
+                    to_submit++;
+                    continue;
+                }
+
+                Operation* op = (Operation*)uintptr_t(cqe.user_data);
+
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN)
+                {
+                    m_ring.push_read(op);
+                    to_submit++;
+                    continue;
+                }
+
+                // A read returning nothing before the end means the file was truncated while being read.
+                if (cqe.res <= 0)
+                {
+                    reading.erase(op);
+                    finish(op, false);
+                    continue;
+                }
+
+                op->offset += uint64_t(cqe.res);
+
+                if (op->offset < op->size)
+                {
+                    m_ring.push_read(op);
+                    to_submit++;
+                }
+                else
+                {
+                    reading.erase(op);
+                    finish(op, true);
+                }
+            }
+
+            __atomic_store_n(m_ring.cq_head, head, __ATOMIC_RELEASE);
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Fails the reads still in the ring and serves every later request from fallback threads, which this thread starts and
+    // then joins as one of them.
+    void abandon_ring(std::unordered_set<Operation*>& reading)
+    {
+        // The kernel may still be writing into the buffers of those reads while it cancels them, so they are kept until the
+        // service shuts down. Registered buffers are simply not returned to the free list.
+        for (auto op : reading)
+        {
+            m_abandoned.push_back(std::move(op->heap));
+            op->data   = nullptr;
+            op->size   = 0;
+            op->buffer = -1;
+
+            finish(op, false);
+        }
+
+        reading.clear();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free_buffers.clear();
+        }
+
+        m_io_uring = false;
+
+        std::vector<std::thread> threads;
+
+        start_fallback_threads(threads);
+
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+#endif
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_frame()
+    {
+        auto   now     = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(now - m_frame_start).count();
+
+        m_frame_start = now;
+
+        m_stats.io_uring      = m_io_uring;
+        m_stats.in_flight     = m_in_flight.load();
+        m_stats.max_in_flight = m_max_in_flight.exchange(m_stats.in_flight);
+        m_stats.completed     = m_completed.exchange(0);
+        m_stats.bytes         = m_bytes.exchange(0);
+        m_stats.throughput    = seconds > 0.0 ? double(m_stats.bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    std::mutex                            m_mutex;
+    std::condition_variable               m_condition;
+    std::deque<Operation*>                m_queue;
+    std::vector<std::thread>              m_threads;
+    std::vector<int32_t>                  m_free_buffers;
+    uint8_t*                              m_buffers       = nullptr;
+    bool                                  m_shutdown      = false;
+    std::atomic<bool>                     m_io_uring      = { false };
+    std::atomic<uint32_t>                 m_in_flight     = { 0 };
+    std::atomic<uint32_t>                 m_max_in_flight = { 0 };
+    std::atomic<uint32_t>                 m_completed     = { 0 };
+    std::atomic<uint64_t>                 m_bytes         = { 0 };
+    std::chrono::steady_clock::time_point m_frame_start;
+    Stats                                 m_stats;
+#if defined(DWSF_IO_URING)
+    Ring                              m_ring;
+    int                               m_wake_fd = -1;
+    std::vector<std::vector<uint8_t>> m_abandoned;
+#endif
+};
+
+Service* g_service = nullptr;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void initialize()
+{
+    // Without threads every read stays synchronous.
+#if !defined(__EMSCRIPTEN__)
+    if (!g_service)
+        g_service = new Service();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void shutdown() { DW_SAFE_DELETE(g_service); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void begin_frame()
+{
+    if (g_service)
+        g_service->begin_frame();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void read(const std::string& path, Callback callback, jobs::Counter* counter)
+{
+    std::vector<Request> requests(1);
+
+    requests[0].path     = path;
+    requests[0].callback = std::move(callback);
+
+    read(requests, counter);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void read(std::vector<Request>& requests, jobs::Counter* counter)
+{
+    if (!g_service)
+    {
+        for (auto& request : requests)
+        {
+            vfs::File file;
+            bool      success = vfs::read(request.path, file);
+
+            if (!success)
+                DW_LOG_ERROR("Failed to read file: " + request.path);
+
+            Result result = { request.path, file.data(), file.size(), success };
+            request.callback(result);
+        }
+
+        return;
+    }
+
+    std::vector<Operation*> ops;
+
+    ops.reserve(requests.size());
+
+    for (auto& request : requests)
+    {
+        Operation* op = new Operation();
+
+        op->path     = std::move(request.path);
+        op->callback = std::move(request.callback);
+        op->counter  = counter;
+
+        if (counter)
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+
+        ops.push_back(op);
+    }
+
+    g_service->enqueue(ops);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Stats stats()
+{
+    return g_service ? g_service->m_stats : Stats();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace io
+} // namespace dw
@@ -0,0 +1,564 @@
+#include <jobs.h>
+#include <logger.h>
+#include <macros.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOBS_INITIAL_DEQUE_CAPACITY 1024
+// Number of failed attempts to find work before an idle worker goes to sleep.
+#define JOBS_SPIN_COUNT 64
+
+namespace dw
+{
+namespace jobs
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct Job
+{
+    JobFunction function;
+    Counter*    counter;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Chase-Lev work-stealing deque, using the memory orderings from "Correct and Efficient Work-Stealing for Weak Memory
+// Models" (Le et al. 2013). The owner pushes and takes at the bottom, thieves steal from the top. Arrays replaced while
+// growing stay alive until the deque is destroyed since a thief may still be reading from them.
+class WorkStealingDeque
+{
+public:
+    WorkStealingDeque()
+    {
+        m_arrays.push_back(std::make_unique<Array>(JOBS_INITIAL_DEQUE_CAPACITY));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Owner only.
+    void push(Job* job)
+    {
+        int64_t b     = m_bottom.load(std::memory_order_relaxed);
+        int64_t t     = m_top.load(std::memory_order_acquire);
+        Array*  array = m_array.load(std::memory_order_relaxed);
+
+        if (b - t > array->capacity - 1)
+            array = grow(array, t, b);
+
+        array->put(b, job);
+        m_bottom.store(b + 1, std::memory_order_release);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Owner only.
+    Job* take()
+    {
+        int64_t b     = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array*  array = m_array.load(std::memory_order_relaxed);
+
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int64_t t   = m_top.load(std::memory_order_relaxed);
+        Job*    job = nullptr;
+
+        if (t <= b)
+        {
+            job = array->get(b);
+
+            // Last item, race against thieves for it.
+            if (t == b)
+            {
+                if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+
+        return job;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Any thread.
+    Job* steal()
+    {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return nullptr;
+
+        Array* array = m_array.load(std::memory_order_acquire);
+        Job*   job   = array->get(t);
+
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return job;
+    }
+
+private:
+    struct Array
+    {
+        int64_t                              capacity;
+        std::unique_ptr<std::atomic<Job*>[]> items;
+
+        Array(int64_t c) :
+            capacity(c), items(new std::atomic<Job*>[c]) {}
+
+        inline Job* get(int64_t i) { return items[i & (capacity - 1)].load(std::memory_order_relaxed); }
+        inline void put(int64_t i, Job* job) { items[i & (capacity - 1)].store(job, std::memory_order_relaxed); }
+    };
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    Array* grow(Array* array, int64_t t, int64_t b)
+    {
+        m_arrays.push_back(std::make_unique<Array>(array->capacity * 2));
+
+        Array* grown = m_arrays.back().get();
+
+        for (int64_t i = t; i < b; i++)
+            grown->put(i, array->get(i));
+
+        m_array.store(grown, std::memory_order_release);
+
+        return grown;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t>    m_top    = { 0 };
+    alignas(64) std::atomic<int64_t>    m_bottom = { 0 };
+    std::atomic<Array*>                 m_array;
+    std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct alignas(64) Worker
+{
+    WorkStealingDeque     deque;
+    std::thread           thread;
+    std::atomic<uint64_t> busy_ns = { 0 };
+    std::atomic<uint32_t> jobs    = { 0 };
+    std::atomic<uint32_t> steals  = { 0 };
+    WorkerStats           last_frame;
+};
+
+thread_local int32_t  g_worker_index = -1;
+thread_local uint32_t g_rng_state    = 0x9E3779B9u;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct Scheduler
+{
+    Scheduler(uint32_t worker_count) :
+        m_workers(worker_count + 1)
+    {
+        g_worker_index = 0;
+        m_frame_start  = std::chrono::steady_clock::now();
+
+        for (uint32_t i = 1; i < m_workers.size(); i++)
+            m_workers[i].thread = std::thread(&Scheduler::worker_main, this, i);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    ~Scheduler()
+    {
+        // Let outstanding jobs finish, including those that submit more work.
+        while (m_pending.load() > 0)
+        {
+            if (!execute_one())
+                std::this_thread::yield();
+        }
+
+        pump_main_thread();
+
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_shutdown = true;
+        }
+
+        m_sleep_condition.notify_all();
+
+        for (uint32_t i = 1; i < m_workers.size(); i++)
+            m_workers[i].thread.join();
+
+        g_worker_index = -1;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void submit(Job* job)
+    {
+        if (job->counter)
+            job->counter->value.fetch_add(1, std::memory_order_relaxed);
+
+        m_pending.fetch_add(1);
+
+        if (g_worker_index >= 0)
+            m_workers[g_worker_index].deque.push(job);
+        else
+        {
+            std::lock_guard<std::mutex> lock(m_injection_mutex);
+            m_injection_queue.push_back(job);
+        }
+
+        // Pairs with the check in worker_main(): either the sleeper sees the new job or we see the sleeper.
+        if (m_sleeping.load() > 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            }
+
+            m_sleep_condition.notify_one();
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void submit_main_thread(Job* job)
+    {
+        if (job->counter)
+            job->counter->value.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_main_thread_mutex);
+        m_main_thread_queue.push_back(job);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void pump_main_thread()
+    {
+        std::vector<Job*> jobs;
+
+        {
+            std::lock_guard<std::mutex> lock(m_main_thread_mutex);
+            jobs.swap(m_main_thread_queue);
+        }
+
+        for (auto job : jobs)
+            execute(job, &m_workers[0]);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    Job* find_job(int32_t idx)
+    {
+        Job* job = nullptr;
+
+        if (idx >= 0)
+            job = m_workers[idx].deque.take();
+
+        if (!job)
+        {
+            std::lock_guard<std::mutex> lock(m_injection_mutex);
+
+            if (!m_injection_queue.empty())
+            {
+                job = m_injection_queue.front();
+                m_injection_queue.pop_front();
+            }
+        }
+
+        if (!job && m_workers.size() > 1)
+        {
+            // Start at a random victim so thieves spread out instead of all hitting the same deque.
+            uint32_t count = m_workers.size();
+
+            g_rng_state ^= g_rng_state << 13;
+            g_rng_state ^= g_rng_state >> 17;
+            g_rng_state ^= g_rng_state << 5;
+
+            uint32_t first = g_rng_state % count;
+
+            for (uint32_t i = 0; i < count && !job; i++)
+            {
+                uint32_t victim = (first + i) % count;
+
+                if (victim != uint32_t(idx))
+                    job = m_workers[victim].deque.steal();
+            }
+
+            if (job && idx >= 0)
+                m_workers[idx].steals.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (job)
+            m_pending.fetch_sub(1);
+
+        return job;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    bool execute_one()
+    {
+        int32_t idx = g_worker_index;
+        Job*    job = find_job(idx);
+
+        if (!job)
+            return false;
+
+        execute(job, idx >= 0 ? &m_workers[idx] : nullptr);
+
+        return true;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Threads not owned by the job system may help out while waiting, but are not tracked.
+    void execute(Job* job, Worker* worker)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        job->function();
+
+        Counter* counter = job->counter;
+        delete job;
+
+        auto end = std::chrono::steady_clock::now();
+
+        if (worker)
+        {
+            worker->busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(), std::memory_order_relaxed);
+            worker->jobs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (counter)
+            counter->value.fetch_sub(1, std::memory_order_release);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void wait(Counter* counter)
+    {
+        bool main_thread = g_worker_index == 0;
+
+        while (!counter->done())
+        {
+            if (main_thread)
+                pump_main_thread();
+
+            if (!execute_one())
+                std::this_thread::yield();
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void worker_main(uint32_t idx)
+    {
+        g_worker_index = idx;
+        g_rng_state    = 0x9E3779B9u * (idx + 1);
+
+        uint32_t idle_count = 0;
+
+        while (true)
+        {
+            if (execute_one())
+            {
+                idle_count = 0;
+                continue;
+            }
+
+            if (++idle_count < JOBS_SPIN_COUNT)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+
+            m_sleeping.fetch_add(1);
+            m_sleep_condition.wait(lock, [this]() { return m_shutdown || m_pending.load() > 0; });
+            m_sleeping.fetch_sub(1);
+
+            if (m_shutdown)
+                break;
+
+            idle_count = 0;
+        }
+
+        g_worker_index = -1;
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void begin_frame()
+    {
+        auto   now      = std::chrono::steady_clock::now();
+        double frame_ms = std::chrono::duration<double, std::milli>(now - m_frame_start).count();
+
+        m_frame_start = now;
+
+        for (auto& worker : m_workers)
+        {
+            worker.last_frame.busy_ms     = worker.busy_ns.exchange(0, std::memory_order_relaxed) / 1000000.0;
+            worker.last_frame.jobs        = worker.jobs.exchange(0, std::memory_order_relaxed);
+            worker.last_frame.steals      = worker.steals.exchange(0, std::memory_order_relaxed);
+            worker.last_frame.utilization = frame_ms > 0.0 ? float(std::min(worker.last_frame.busy_ms / frame_ms, 1.0)) : 0.0f;
+        }
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    std::vector<Worker>                   m_workers;
+    std::atomic<uint32_t>                 m_pending  = { 0 };
+    std::atomic<uint32_t>                 m_sleeping = { 0 };
+    bool                                  m_shutdown = false;
+    std::mutex                            m_sleep_mutex;
+    std::condition_variable               m_sleep_condition;
+    std::mutex                            m_injection_mutex;
+    std::deque<Job*>                      m_injection_queue;
+    std::mutex                            m_main_thread_mutex;
+    std::vector<Job*>                     m_main_thread_queue;
+    std::chrono::steady_clock::time_point m_frame_start;
+};
+
+Scheduler* g_scheduler = nullptr;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void split_range(const RangeFunction& function, uint32_t begin, uint32_t end, uint32_t grain_size, Counter* counter)
+{
+    // Hand off the upper half and keep splitting the lower one, so the oldest jobs in the deque are the largest.
+    while (end - begin > grain_size)
+    {
+        uint32_t mid = begin + (end - begin) / 2;
+
+        g_scheduler->submit(new Job { [&function, mid, end, grain_size, counter]() { split_range(function, mid, end, grain_size, counter); }, counter });
+
+        end = mid;
+    }
+
+    function(begin, end);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void initialize(uint32_t worker_count)
+{
+    if (g_scheduler)
+        return;
+
+#if defined(__EMSCRIPTEN__)
+    worker_count = 0;
+#endif
+
+    worker_count = std::min(worker_count, uint32_t(JOBS_MAX_WORKERS - 1));
+    g_scheduler  = new Scheduler(worker_count);
+
+    DW_LOG_INFO("Job system started with " + std::to_string(worker_count) + " worker threads.");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void shutdown() { DW_SAFE_DELETE(g_scheduler); }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void begin_frame()
+{
+    if (g_scheduler)
+    {
+        g_scheduler->pump_main_thread();
+        g_scheduler->begin_frame();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t worker_count() { return g_scheduler ? g_scheduler->m_workers.size() : 1; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+int32_t worker_index() { return g_worker_index; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool is_main_thread() { return g_worker_index == 0; }
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void submit(JobFunction function, Counter* counter)
+{
+    if (g_scheduler)
+        g_scheduler->submit(new Job { std::move(function), counter });
+    else
+        function();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void submit_main_thread(JobFunction function, Counter* counter)
+{
+    if (g_scheduler)
+        g_scheduler->submit_main_thread(new Job { std::move(function), counter });
+    else
+        function();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void pump_main_thread()
+{
+    if (g_scheduler && is_main_thread())
+        g_scheduler->pump_main_thread();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void wait(Counter* counter)
+{
+    if (g_scheduler)
+        g_scheduler->wait(counter);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void parallel_for(uint32_t count, uint32_t grain_size, RangeFunction function)
+{
+    grain_size = std::max(grain_size, 1u);
+
+    if (!g_scheduler || count <= grain_size)
+    {
+        if (count > 0)
+            function(0, count);
+
+        return;
+    }
+
+    Counter counter;
+
+    split_range(function, 0, count, grain_size, &counter);
+    wait(&counter);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+WorkerStats worker_stats(uint32_t worker)
+{
+    if (!g_scheduler || worker >= g_scheduler->m_workers.size())
+        return WorkerStats();
+
+    return g_scheduler->m_workers[worker].last_frame;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace jobs
+} // namespace dw
@@ -28,6 +28,7 @@ struct LoggerState
     std::tm*             _timeinfo;
     int                  _verbosity;
     char                 _temp_buffer[80];
+    std::string          _output;
     CustomStreamCallback _callback;
     bool                 _debug;
 };
@@ -130,72 +131,53 @@ void enable_debug_mode() { g_logger._debug = true; }
 
 void disable_debug_mode() { g_logger._debug = false; }
 
-void log(std::string text, std::string file, int line, LogLevel level)
+const char* level_string(LogLevel level)
 {
-    std::lock_guard<std::mutex> lock(g_logger._log_mutex);
-
-    std::string file_with_extension = file.substr(file.find_last_of("/\\") + 1);
-    std::time(&g_logger._rawtime);
-    g_logger._timeinfo = std::localtime(&g_logger._rawtime);
-    std::strftime(g_logger._temp_buffer, 80, "%H:%M:%S", g_logger._timeinfo);
-
-    std::string log_level_string;
-
     switch (level)
     {
         case LEVEL_INFO:
-        {
-            log_level_string = "INFO   ";
-            break;
-        }
+            return "INFO   ";
         case LEVEL_WARNING:
-        {
-            log_level_string = "WARNING";
-            break;
-        }
+            return "WARNING";
         case LEVEL_ERR:
-        {
-            log_level_string = "ERROR  ";
-            break;
-        }
+            return "ERROR  ";
         case LEVEL_FATAL:
-        {
-            log_level_string = "FATAL  ";
-            break;
-        }
+            return "FATAL  ";
     }
 
-    std::string output;
+    return "";
+}
+
+// Starts a new line in the shared output buffer. Its capacity is kept between calls, so formatting does not allocate once it
+// has grown to the longest message. Must be called with the log mutex held.
+void begin_output(LogLevel level)
+{
+    std::time(&g_logger._rawtime);
+    g_logger._timeinfo = std::localtime(&g_logger._rawtime);
+    std::strftime(g_logger._temp_buffer, 80, "%H:%M:%S", g_logger._timeinfo);
+
+    g_logger._output.clear();
 
     if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) || (g_logger._verbosity & VERBOSITY_LEVEL))
     {
-        output = "[ ";
+        g_logger._output += "[ ";
 
         if (g_logger._verbosity & VERBOSITY_TIMESTAMP)
-            output += g_logger._temp_buffer;
+            g_logger._output += g_logger._temp_buffer;
 
         if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) && (g_logger._verbosity & VERBOSITY_LEVEL))
-            output += " | ";
+            g_logger._output += " | ";
 
         if (g_logger._verbosity & VERBOSITY_LEVEL)
-            output += log_level_string;
-
-        output += " ] : ";
-    }
-
-    output += text;
+            g_logger._output += level_string(level);
 
-    if (g_logger._verbosity & VERBOSITY_FILE)
-    {
-        output += " , FILE : ";
-        output += file_with_extension;
+        g_logger._output += " ] : ";
     }
+}
 
-    if (g_logger._verbosity & VERBOSITY_LINE)
-    {
-        output += " , LINE : ";
-        output += std::to_string(line);
-    }
+void write_output(LogLevel level)
+{
+    const std::string& output = g_logger._output;
 
     if (g_logger._open_streams[FILE_STREAM_INDEX])
     {
@@ -211,89 +193,66 @@ void log(std::string text, std::string file, int line, LogLevel level)
     {
         g_logger._callback(output, level);
     }
-
-    // Flush stream if error
-    if (level == LEVEL_ERR || level == LEVEL_FATAL || g_logger._debug)
-        flush();
 }
 
-void log_simple(std::string text, LogLevel level)
+void log(const std::string& text, const char* file, int line, LogLevel level)
 {
     std::lock_guard<std::mutex> lock(g_logger._log_mutex);
 
-    std::time(&g_logger._rawtime);
-    g_logger._timeinfo = std::localtime(&g_logger._rawtime);
-    std::strftime(g_logger._temp_buffer, 80, "%H:%M:%S", g_logger._timeinfo);
-
-    std::string log_level_string;
+    const char* file_with_extension = file;
 
-    switch (level)
+    for (const char* c = file; *c; c++)
     {
-        case LEVEL_INFO:
-        {
-            log_level_string = "INFO   ";
-            break;
-        }
-        case LEVEL_WARNING:
-        {
-            log_level_string = "WARNING";
-            break;
-        }
-        case LEVEL_ERR:
-        {
-            log_level_string = "ERROR  ";
-            break;
-        }
-        case LEVEL_FATAL:
-        {
-            log_level_string = "FATAL  ";
-            break;
-        }
+        if (*c == '/' || *c == '\\')
+            file_with_extension = c + 1;
     }
 
-    std::string output;
+    begin_output(level);
 
-    if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) || (g_logger._verbosity & VERBOSITY_LEVEL))
+    g_logger._output += text;
+
+    if (g_logger._verbosity & VERBOSITY_FILE)
     {
-        output = "[ ";
+        g_logger._output += " , FILE : ";
+        g_logger._output += file_with_extension;
+    }
 
-        if (g_logger._verbosity & VERBOSITY_TIMESTAMP)
-            output += g_logger._temp_buffer;
+    if (g_logger._verbosity & VERBOSITY_LINE)
+    {
+        char line_buffer[16];
+        snprintf(line_buffer, sizeof(line_buffer), "%d", line);
 
-        if ((g_logger._verbosity & VERBOSITY_TIMESTAMP) && (g_logger._verbosity & VERBOSITY_LEVEL))
-            output += " | ";
+        g_logger._output += " , LINE : ";
+        g_logger._output += line_buffer;
+    }
 
-        if (g_logger._verbosity & VERBOSITY_LEVEL)
-            output += log_level_string;
+    write_output(level);
 
-        output += " ] : ";
-    }
+    // Flush stream if error
+    if (level == LEVEL_ERR || level == LEVEL_FATAL || g_logger._debug)
+        flush();
+}
 
-    output += text;
+void log(const std::string& text, const std::string& file, int line, LogLevel level) { log(text, file.c_str(), line, level); }
 
-    if (g_logger._open_streams[FILE_STREAM_INDEX])
-    {
-        g_logger._stream << output << "\n";
-    }
+void log_simple(const std::string& text, LogLevel level)
+{
+    std::lock_guard<std::mutex> lock(g_logger._log_mutex);
 
-    if (g_logger._open_streams[CONSOLE_STREAM_INDEX])
-    {
-        std::cout << output << "\n";
-    }
+    begin_output(level);
 
-    if (g_logger._open_streams[CUSTOM_STREAM_INDEX] && g_logger._callback)
-    {
-        g_logger._callback(output, level);
-    }
+    g_logger._output += text;
+
+    write_output(level);
 }
 
-void log_info(std::string text) { log_simple(text, LEVEL_INFO); }
+void log_info(const std::string& text) { log_simple(text, LEVEL_INFO); }
 
-void log_error(std::string text) { log_simple(text, LEVEL_ERR); }
+void log_error(const std::string& text) { log_simple(text, LEVEL_ERR); }
 
-void log_warning(std::string text) { log_simple(text, LEVEL_WARNING); }
+void log_warning(const std::string& text) { log_simple(text, LEVEL_WARNING); }
 
-void log_fatal(std::string text) { log_simple(text, LEVEL_FATAL); }
+void log_fatal(const std::string& text) { log_simple(text, LEVEL_FATAL); }
 
 void flush()
 {
@@ -2,6 +2,11 @@
 #include <macros.h>
 #include <material.h>
 #include <utility.h>
+#include <io.h>
+#include <jobs.h>
+#include <timer.h>
+#include <staging_heap.h>
+#include <algorithm>
 #include <assimp/scene.h>
 #if defined(DWSF_VULKAN)
 #    include <vk_mem_alloc.h>
@@ -10,6 +15,8 @@
 namespace dw
 {
 std::unordered_map<std::string, std::weak_ptr<Material>> Material::m_cache;
+TextureLoadStats                                         Material::m_texture_load_stats;
+std::unordered_map<uint32_t, Material*>                  Material::m_live_materials;
 
 #if defined(DWSF_VULKAN)
 std::unordered_map<std::string, std::weak_ptr<vk::Image>>     Material::m_image_cache;
@@ -20,6 +27,8 @@ vk::Image::Ptr                                                Material::m_defaul
 vk::ImageView::Ptr                                            Material::m_default_image_view;
 #else
 std::unordered_map<std::string, std::weak_ptr<gl::Texture2D>> Material::m_texture_cache;
+gl::Buffer::Ptr                                               Material::m_material_table;
+bool                                                          Material::m_bindless_supported = false;
 #endif
 
 static uint32_t g_last_mat_idx = 0;
@@ -85,6 +94,8 @@ Material::Ptr Material::create(glm::vec4 albedo, float roughness, float metallic
 Material::Material()
 {
     m_id = g_last_mat_idx++;
+
+    m_live_materials[m_id] = this;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -98,6 +109,91 @@ bool Material::is_loaded(const std::string& name)
 
 Material::~Material()
 {
+    m_live_materials.erase(m_id);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::decode_images(const std::vector<std::string>& textures, const std::vector<int32_t>& indices, DecodedImages& decoded)
+{
+#if defined(DWSF_VULKAN)
+    // Most Vulkan implementations cannot sample three component formats.
+    const bool expand_rgb = true;
+#else
+    const bool expand_rgb = false;
+#endif
+
+    // Decode jobs write the pixels straight into the staging heap, from which they are then uploaded.
+    StagingHeap*            heap      = StagingHeap::common();
+    utility::PixelAllocator allocator = heap ? heap->pixel_allocator() : nullptr;
+
+#if !defined(DWSF_VULKAN)
+    if (heap)
+        heap->reclaim();
+#endif
+
+    std::vector<io::Request> requests;
+
+    for (auto idx : indices)
+    {
+        if (idx == -1 || textures[idx].empty() || decoded.find(textures[idx]) != decoded.end())
+            continue;
+
+        const std::string& path = textures[idx];
+
+#if defined(DWSF_VULKAN)
+        if (m_image_cache.find(path) != m_image_cache.end() && !m_image_cache[path].expired())
+            continue;
+#else
+        if (m_texture_cache.find(path) != m_texture_cache.end() && !m_texture_cache[path].expired())
+            continue;
+#endif
+
+        // Entries are created up front, so every callback only writes to its own image.
+        utility::DecodedImage* image = &decoded[path];
+        bool                   hdr   = utility::file_extension(path) == "hdr";
+
+        io::Request request;
+
+        request.path     = path;
+        request.callback = [image, hdr, expand_rgb, allocator](const io::Result& result) {
+            if (result.success)
+                utility::decode_image(result.data, result.size, hdr, expand_rgb, false, *image, allocator);
+        };
+
+        requests.push_back(request);
+    }
+
+    if (requests.empty())
+        return;
+
+    Timer timer;
+
+    timer.start();
+
+    jobs::Counter counter;
+
+    io::read(requests, &counter);
+    jobs::wait(&counter);
+
+    m_texture_load_stats.decode_time += timer.elapsed_time_milisec();
+
+    for (const auto& request : requests)
+    {
+        const utility::DecodedImage& image = decoded[request.path];
+
+        if (!image.pixels)
+            continue;
+
+        size_t size   = size_t(image.width) * image.height * image.components * (image.hdr ? sizeof(float) : sizeof(uint8_t));
+        size_t offset = 0;
+
+        m_texture_load_stats.textures++;
+        m_texture_load_stats.decoded_bytes += size;
+
+        if (heap && heap->find(image.pixels.get(), offset))
+            m_texture_load_stats.staged_bytes += size;
+    }
 }
 
 #if defined(DWSF_VULKAN)
@@ -109,12 +205,19 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
 {
     m_id = g_last_mat_idx++;
 
+    m_live_materials[m_id] = this;
+
+    DecodedImages decoded;
+
+    decode_images(textures, { albedo_idx, normal_idx, roughness_idx.x, metallic_idx.x, emissive_idx }, decoded);
+
     if (albedo_idx != -1 && textures[albedo_idx].size() > 0)
     {
-        auto image = load_image(backend, textures[albedo_idx], true);
+        auto image = load_image(backend, textures[albedo_idx], decoded, true);
 
         m_albedo_idx = m_images.size();
         m_images.push_back(image);
+        m_texture_paths.push_back(textures[albedo_idx]);
 
         if (image)
         {
@@ -127,10 +230,11 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
 
     if (normal_idx != -1 && textures[normal_idx].size() > 0)
     {
-        auto image = load_image(backend, textures[normal_idx]);
+        auto image = load_image(backend, textures[normal_idx], decoded);
 
         m_normal_idx = m_images.size();
         m_images.push_back(image);
+        m_texture_paths.push_back(textures[normal_idx]);
 
         if (image)
         {
@@ -143,10 +247,11 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
 
     if (roughness_idx.x != -1 && textures[roughness_idx.x].size() > 0)
     {
-        auto image = load_image(backend, textures[roughness_idx.x]);
+        auto image = load_image(backend, textures[roughness_idx.x], decoded);
 
         m_roughness_idx = m_images.size();
         m_images.push_back(image);
+        m_texture_paths.push_back(textures[roughness_idx.x]);
 
         if (image)
         {
@@ -159,10 +264,11 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
 
     if (metallic_idx.x != -1 && textures[metallic_idx.x].size() > 0)
     {
-        auto image = load_image(backend, textures[metallic_idx.x]);
+        auto image = load_image(backend, textures[metallic_idx.x], decoded);
 
         m_metallic_idx = m_images.size();
         m_images.push_back(image);
+        m_texture_paths.push_back(textures[metallic_idx.x]);
 
         if (image)
         {
@@ -175,10 +281,11 @@ Material::Material(vk::Backend::Ptr backend, const std::vector<std::string>& tex
 
     if (emissive_idx != -1 && textures[emissive_idx].size() > 0)
     {
-        auto image = load_image(backend, textures[emissive_idx]);
+        auto image = load_image(backend, textures[emissive_idx], decoded);
 
         m_emissive_idx = m_images.size();
         m_images.push_back(image);
+        m_texture_paths.push_back(textures[emissive_idx]);
 
         if (image)
         {
@@ -245,11 +352,36 @@ void Material::shutdown_common_resources()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-vk::Image::Ptr Material::load_image(vk::Backend::Ptr backend, const std::string& path, bool srgb)
+vk::Image::Ptr Material::load_image(vk::Backend::Ptr backend, const std::string& path, const DecodedImages& decoded, bool srgb)
 {
     if (m_image_cache.find(path) == m_image_cache.end() || m_image_cache[path].expired())
     {
-        vk::Image::Ptr tex  = vk::Image::create_from_file(backend, path, false, srgb);
+        auto           image = decoded.find(path);
+        vk::Image::Ptr tex;
+
+        Timer timer;
+
+        timer.start();
+
+        if (image != decoded.end())
+            tex = image->second.pixels ? vk::Image::create_from_image(backend, image->second, srgb) : nullptr;
+        else
+            tex = vk::Image::create_from_file(backend, path, false, srgb);
+
+        m_texture_load_stats.upload_time += timer.elapsed_time_milisec();
+
+        // Loaded textures are only read from here on, so defragmentation may move them. The materials using one then write
+        // their descriptor sets again.
+        if (tex)
+        {
+            std::weak_ptr<vk::Backend> weak_backend = backend;
+
+            tex->set_movable(true, [weak_backend, path]() {
+                if (auto backend = weak_backend.lock())
+                    image_relocated(backend, path);
+            });
+        }
+
         m_image_cache[path] = tex;
         return tex;
     }
@@ -353,6 +485,25 @@ vk::DescriptorSet::Ptr Material::create_descriptor_set(vk::Backend::Ptr backend)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void Material::image_relocated(vk::Backend::Ptr backend, const std::string& path)
+{
+    for (auto& pair : m_live_materials)
+    {
+        Material* material = pair.second;
+
+        if (!material->m_descriptor_set || std::find(material->m_texture_paths.begin(), material->m_texture_paths.end(), path) == material->m_texture_paths.end())
+            continue;
+
+        // Sets cannot be written while frames in flight use them, so the material gets a new one. The old set holds the views
+        // of the old image and is kept until those frames have completed.
+        backend->memory_manager()->retire(material->m_descriptor_set);
+
+        material->m_descriptor_set = material->create_descriptor_set(backend);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 #else
 
 Material::Material(const std::vector<std::string>& textures, const int32_t& albedo_idx, const int32_t& normal_idx, const glm::ivec2& roughness_idx, const glm::ivec2& metallic_idx, const int32_t& emissive_idx) :
@@ -360,51 +511,156 @@ Material::Material(const std::vector<std::string>& textures, const int32_t& albe
 {
     m_id = g_last_mat_idx++;
 
+    m_live_materials[m_id] = this;
+
+    DecodedImages decoded;
+
+    decode_images(textures, { albedo_idx, normal_idx, roughness_idx.x, metallic_idx.x, emissive_idx }, decoded);
+
     if (albedo_idx != -1 && textures[albedo_idx].size() > 0)
     {
         m_albedo_idx = m_textures.size();
-        m_textures.push_back(load_texture(textures[albedo_idx], true));
+        m_textures.push_back(load_texture(textures[albedo_idx], decoded, true));
+        m_texture_paths.push_back(textures[albedo_idx]);
     }
 
     if (normal_idx != -1 && textures[normal_idx].size() > 0)
     {
         m_normal_idx = m_textures.size();
-        m_textures.push_back(load_texture(textures[normal_idx], false));
+        m_textures.push_back(load_texture(textures[normal_idx], decoded, false));
+        m_texture_paths.push_back(textures[normal_idx]);
     }
 
     if (roughness_idx.x != -1 && textures[roughness_idx.x].size() > 0)
     {
         m_roughness_idx = m_textures.size();
-        m_textures.push_back(load_texture(textures[roughness_idx.x], false));
+        m_textures.push_back(load_texture(textures[roughness_idx.x], decoded, false));
+        m_texture_paths.push_back(textures[roughness_idx.x]);
     }
 
     if (metallic_idx.x != -1 && textures[metallic_idx.x].size() > 0)
     {
         m_metallic_idx = m_textures.size();
-        m_textures.push_back(load_texture(textures[metallic_idx.x], false));
+        m_textures.push_back(load_texture(textures[metallic_idx.x], decoded, false));
+        m_texture_paths.push_back(textures[metallic_idx.x]);
     }
 
     if (emissive_idx != -1 && textures[emissive_idx].size() > 0)
     {
         m_emissive_idx = m_textures.size();
-        m_textures.push_back(load_texture(textures[emissive_idx], false));
+        m_textures.push_back(load_texture(textures[emissive_idx], decoded, false));
+        m_texture_paths.push_back(textures[emissive_idx]);
     }
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-gl::Texture2D::Ptr Material::load_texture(const std::string& path, bool srgb)
+gl::Texture2D::Ptr Material::load_texture(const std::string& path, const DecodedImages& decoded, bool srgb)
 {
     if (m_texture_cache.find(path) != m_texture_cache.end() && !m_texture_cache[path].expired())
         return m_texture_cache[path].lock();
     else
     {
-        gl::Texture2D::Ptr tex = gl::Texture2D::create_from_file(path, false, srgb);
-        m_texture_cache[path]  = tex;
+        auto               image = decoded.find(path);
+        gl::Texture2D::Ptr tex;
+
+        Timer timer;
+
+        timer.start();
+
+        if (image != decoded.end())
+            tex = image->second.pixels ? gl::Texture2D::create_from_image(image->second, srgb, true) : nullptr;
+        else
+            tex = gl::Texture2D::create_from_file(path, false, srgb);
+
+        m_texture_load_stats.upload_time += timer.elapsed_time_milisec();
+
+        m_texture_cache[path] = tex;
         return tex;
     }
 }
 
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::initialize_common_resources()
+{
+    m_bindless_supported = GLAD_GL_ARB_bindless_texture != 0;
+
+    if (!m_bindless_supported)
+        DW_LOG_INFO("OPENGL: GL_ARB_bindless_texture is not supported, materials are bound per draw.");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::shutdown_common_resources()
+{
+    m_material_table.reset();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+glm::uvec2 Material::resident_handle(const gl::Texture2D::Ptr& texture)
+{
+    if (!texture)
+        return glm::uvec2(0);
+
+    // Textures are shared between materials through the cache, and a handle can only be made resident once.
+    GLuint64 handle = texture->texture_handle();
+
+    if (handle == 0)
+        handle = texture->make_texture_handle_resident();
+
+    return glm::uvec2(uint32_t(handle & 0xFFFFFFFF), uint32_t(handle >> 32));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Material::update_material_table()
+{
+    if (!m_bindless_supported)
+        return;
+
+    // Ids are never reused, so the table covers every id handed out so far and gaps are left zeroed.
+    std::vector<MaterialData> table(std::max(g_last_mat_idx, 1u));
+
+    memset(table.data(), 0, table.size() * sizeof(MaterialData));
+
+    for (auto& pair : m_live_materials)
+    {
+        Material*     mat  = pair.second;
+        MaterialData& data = table[pair.first];
+
+        data.albedo_handle     = resident_handle(mat->albedo_texture());
+        data.normal_handle     = resident_handle(mat->normal_texture());
+        data.roughness_handle  = resident_handle(mat->roughness_texture());
+        data.metallic_handle   = resident_handle(mat->metallic_texture());
+        data.emissive_handle   = resident_handle(mat->emissive_texture());
+        data.roughness_channel = mat->m_roughness_channel;
+        data.metallic_channel  = mat->m_metallic_channel;
+        data.albedo_color      = mat->m_albedo_color;
+        data.emissive_color    = glm::vec4(mat->m_emissive_color, 0.0f);
+        data.roughness         = mat->m_roughness;
+        data.metallic          = mat->m_metallic;
+        data.alpha_test        = mat->m_alpha_test ? 1 : 0;
+    }
+
+    const size_t size = table.size() * sizeof(MaterialData);
+
+    if (!m_material_table || m_material_table->size() < size)
+    {
+        // Grown in powers of two so that loading materials one at a time does not recreate the buffer each time.
+        size_t capacity = sizeof(MaterialData);
+
+        while (capacity < size)
+            capacity *= 2;
+
+        m_material_table = gl::Buffer::create(GL_SHADER_STORAGE_BUFFER, GL_DYNAMIC_STORAGE_BIT, capacity);
+        m_material_table->set_name("Material Table");
+    }
+
+    m_material_table->write_data(0, size, table.data());
+}
+
 #endif
 
 // -----------------------------------------------------------------------------------------------------------------------------------
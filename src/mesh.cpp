@@ -6,17 +6,42 @@
 #include <material.h>
 #include <mesh.h>
 #include <stdio.h>
+#include <string.h>
 #include <ogl.h>
 #include <utility.h>
+#include <vfs.h>
+#include <jobs.h>
+#include <timer.h>
+#include <gltf.h>
+#include <mesh_codec.h>
 #include <filesystem>
 #include <assimp/pbrmaterial.h>
+#include <assimp/IOSystem.hpp>
+#include <assimp/IOStream.hpp>
 #if defined(DWSF_VULKAN)
 #    include <vk_mem_alloc.h>
 #endif
 
+// Vertices per job when hashing and remapping during welding.
+#define WELD_GRAIN_SIZE 16384
+// Number of hash partitions deduplicated in parallel while welding. Must be a power of two.
+#define WELD_PARTITION_COUNT 64
+// Identifies mesh disk cache files. Bump the version whenever the layout or the Vertex structure changes.
+#define MESH_DISK_CACHE_MAGIC 0x48534D44
+#define MESH_DISK_CACHE_VERSION 3
+#define MESH_DISK_CACHE_EXTENSION ".dwmesh"
+
+// Mesh disk cache flags. A cache file is only used if it was written with the same settings.
+#define MESH_DISK_CACHE_LOAD_MATERIALS 1
+#define MESH_DISK_CACHE_ORCA_MESH 2
+#define MESH_DISK_CACHE_NATIVE_GLTF 4
+
 namespace dw
 {
 std::unordered_map<std::string, std::weak_ptr<Mesh>> Mesh::m_cache;
+float                                                Mesh::m_weld_epsilon       = MESH_DEFAULT_WELD_EPSILON;
+bool                                                 Mesh::m_native_gltf_loader = true;
+std::string                                          Mesh::m_disk_cache_directory;
 
 // Assimp texture enum lookup table.
 static const aiTextureType kTextureTypes[] = {
@@ -28,6 +53,104 @@ static std::string kTextureTypeStrings[] = {
     "aiTextureType_DIFFUSE", "aiTextureType_SPECULAR", "aiTextureType_AMBIENT", "aiTextureType_EMISSIVE", "aiTextureType_HEIGHT", "aiTextureType_NORMALS", "aiTextureType_SHININESS", "aiTextureType_OPACITY", "aiTextureType_DISPLACEMENT", "aiTextureType_LIGHTMAP", "aiTextureType_REFLECTION"
 };
 
+// Read-only Assimp stream over a file served by the virtual file system. Importers read straight out of the mapping.
+class VfsIOStream : public Assimp::IOStream
+{
+public:
+    VfsIOStream(vfs::File&& file) :
+        m_file(std::move(file)) {}
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+
+        size_t available = (m_file.size() - m_position) / size;
+        size_t read      = std::min(count, available);
+
+        memcpy(buffer, m_file.data() + m_position, read * size);
+        m_position += read * size;
+
+        return read;
+    }
+
+    size_t Write(const void* buffer, size_t size, size_t count) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t position;
+
+        if (origin == aiOrigin_SET)
+            position = offset;
+        else if (origin == aiOrigin_CUR)
+            position = m_position + offset;
+        else
+            position = m_file.size() - offset;
+
+        if (position > m_file.size())
+            return aiReturn_FAILURE;
+
+        m_position = position;
+
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return m_position;
+    }
+
+    size_t FileSize() const override
+    {
+        return m_file.size();
+    }
+
+    void Flush() override
+    {
+    }
+
+private:
+    vfs::File m_file;
+    size_t    m_position = 0;
+};
+
+// Routes the files an importer opens, including external buffers and material libraries, through the virtual file system.
+class VfsIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* path) const override
+    {
+        return vfs::exists(path);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream* Open(const char* path, const char* mode) override
+    {
+        // Archives are read-only, so only reads are supported.
+        if (strchr(mode, 'w') || strchr(mode, 'a'))
+            return nullptr;
+
+        vfs::File file;
+
+        if (!vfs::read(path, file))
+            return nullptr;
+
+        return new VfsIOStream(std::move(file));
+    }
+
+    void Close(Assimp::IOStream* stream) override
+    {
+        delete stream;
+    }
+};
+
 std::string get_gltf_base_color_texture_path(aiMaterial* material)
 {
     aiString path;
@@ -83,6 +206,358 @@ std::string assimp_get_texture_path(aiMaterial*   material,
 bool        assimp_does_material_exist(std::vector<unsigned int>& materials,
                                        unsigned int&              current_material);
 
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Vertex welding.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Quantized attributes compared when welding: position.xyzw (w holds the material index), tex_coord.xy, and the xyz of the
+// normal, tangent and bitangent.
+static const uint32_t kWeldKeySize = 15;
+
+struct WeldKey
+{
+    int64_t values[kWeldKeySize];
+
+    inline bool operator==(const WeldKey& other) const { return memcmp(values, other.values, sizeof(values)) == 0; }
+};
+
+// Hash of a quantized vertex and its submesh, stored next to the vertex index so that deduplication never has to read the
+// vertices out of order.
+struct WeldItem
+{
+    uint64_t hash;
+    uint32_t vertex;
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline int64_t quantize(float value, double inv_epsilon)
+{
+    double scaled = double(value) * inv_epsilon;
+
+    // Round half away from zero. Truncating avoids a libm floor() call per component.
+    return int64_t(scaled >= 0.0 ? scaled + 0.5 : scaled - 0.5);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static WeldKey weld_key(const Vertex& vertex, double inv_epsilon)
+{
+    const float attributes[kWeldKeySize] = { vertex.position.x, vertex.position.y, vertex.position.z, vertex.position.w, vertex.tex_coord.x, vertex.tex_coord.y, vertex.normal.x, vertex.normal.y, vertex.normal.z, vertex.tangent.x, vertex.tangent.y, vertex.tangent.z, vertex.bitangent.x, vertex.bitangent.y, vertex.bitangent.z };
+
+    WeldKey key;
+
+    for (uint32_t i = 0; i < kWeldKeySize; i++)
+        key.values[i] = quantize(attributes[i], inv_epsilon);
+
+    return key;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint64_t weld_hash(const WeldKey& key, uint32_t sub_mesh)
+{
+    uint64_t hash = 0xCBF29CE484222325ull ^ sub_mesh;
+
+    for (uint32_t i = 0; i < kWeldKeySize; i++)
+    {
+        hash ^= uint64_t(key.values[i]);
+        hash *= 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t weld_vertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<SubMesh>& sub_meshes, float epsilon)
+{
+    uint32_t vertex_count = vertices.size();
+
+    if (vertex_count == 0 || epsilon <= 0.0f)
+        return vertex_count;
+
+    const double inv_epsilon = 1.0 / double(epsilon);
+
+    // Owning submesh of every vertex, so vertices from different submeshes never merge.
+    std::vector<uint32_t> vertex_sub_mesh(vertex_count, 0);
+    uint32_t              sub_mesh_begin = 0;
+
+    for (uint32_t i = 0; i < sub_meshes.size(); i++)
+    {
+        uint32_t sub_mesh_end = std::min(sub_mesh_begin + sub_meshes[i].vertex_count, vertex_count);
+
+        std::fill(vertex_sub_mesh.begin() + sub_mesh_begin, vertex_sub_mesh.begin() + sub_mesh_end, i);
+
+        sub_mesh_begin = sub_mesh_end;
+    }
+
+    // Hash every vertex.
+    std::vector<WeldItem> items(vertex_count);
+
+    jobs::parallel_for(vertex_count, WELD_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            items[i].hash   = weld_hash(weld_key(vertices[i], inv_epsilon), vertex_sub_mesh[i]);
+            items[i].vertex = i;
+        }
+    });
+
+    // Bucket vertices by the top bits of their hash. Equal vertices always land in the same partition, so partitions can be
+    // deduplicated independently. The counting sort is stable, which keeps each partition in ascending vertex order.
+    std::vector<uint32_t> partition_offsets(WELD_PARTITION_COUNT + 1, 0);
+    std::vector<WeldItem> partitioned(vertex_count);
+
+    const uint32_t partition_shift = 64 - 6;
+
+    static_assert(WELD_PARTITION_COUNT == 64, "partition_shift assumes 64 partitions.");
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+        partition_offsets[(items[i].hash >> partition_shift) + 1]++;
+
+    for (uint32_t i = 0; i < WELD_PARTITION_COUNT; i++)
+        partition_offsets[i + 1] += partition_offsets[i];
+
+    {
+        std::vector<uint32_t> cursors(partition_offsets.begin(), partition_offsets.end() - 1);
+
+        for (uint32_t i = 0; i < vertex_count; i++)
+            partitioned[cursors[items[i].hash >> partition_shift]++] = items[i];
+    }
+
+    items.clear();
+    items.shrink_to_fit();
+
+    // Map every vertex to the first vertex with the same hash, using an open addressing table per partition.
+    std::vector<uint32_t> remap(vertex_count);
+
+    jobs::parallel_for(WELD_PARTITION_COUNT, 1, [&](uint32_t begin, uint32_t end) {
+        std::vector<const WeldItem*> table;
+
+        for (uint32_t p = begin; p < end; p++)
+        {
+            uint32_t first = partition_offsets[p];
+            uint32_t count = partition_offsets[p + 1] - first;
+            uint32_t size  = 1;
+
+            while (size < count * 2)
+                size <<= 1;
+
+            table.assign(size, nullptr);
+
+            for (uint32_t i = first; i < first + count; i++)
+            {
+                const WeldItem& item = partitioned[i];
+                uint32_t        slot = uint32_t(item.hash) & (size - 1);
+
+                while (table[slot] && table[slot]->hash != item.hash)
+                    slot = (slot + 1) & (size - 1);
+
+                if (!table[slot])
+                    table[slot] = &item;
+
+                remap[item.vertex] = table[slot]->vertex;
+            }
+        }
+    });
+
+    // Verify every merge against the quantized attributes. Duplicates of a vertex are usually close to it in the stream,
+    // so this pass reads the vertices almost in order. A vertex whose hash collided with a different vertex is kept as
+    // is, which can only miss a weld, never merge two different vertices.
+    jobs::parallel_for(vertex_count, WELD_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t representative = remap[i];
+
+            if (representative != i && (vertex_sub_mesh[representative] != vertex_sub_mesh[i] || !(weld_key(vertices[representative], inv_epsilon) == weld_key(vertices[i], inv_epsilon))))
+                remap[i] = i;
+        }
+    });
+
+    // Compact the unique vertices. Representatives are the lowest index of their group, so they appear in the original
+    // order and every submesh stays contiguous.
+    std::vector<uint32_t> compacted_index(vertex_count);
+    std::vector<Vertex>   welded_vertices;
+    uint32_t              welded_count = 0;
+
+    for (auto& sub_mesh : sub_meshes)
+        sub_mesh.vertex_count = 0;
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        if (remap[i] == i)
+        {
+            compacted_index[i] = welded_count++;
+
+            if (!sub_meshes.empty())
+                sub_meshes[vertex_sub_mesh[i]].vertex_count++;
+        }
+    }
+
+    welded_vertices.resize(welded_count);
+
+    for (uint32_t i = 0; i < vertex_count; i++)
+    {
+        if (remap[i] == i)
+            welded_vertices[compacted_index[i]] = vertices[i];
+    }
+
+    jobs::parallel_for(indices.size(), WELD_GRAIN_SIZE, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+            indices[i] = compacted_index[remap[indices[i]]];
+    });
+
+    vertices.swap(welded_vertices);
+
+    return welded_count;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Fixed-size start of a mesh disk cache file. It is followed by the submesh table, the materials and the payload written by
+// mesh_codec::encode_mesh().
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertex_size;
+    uint32_t flags;
+    uint64_t source_size;
+    int64_t  source_time;
+    float    weld_epsilon;
+    uint32_t sub_mesh_count;
+    uint32_t material_count;
+    uint32_t padding;
+    uint64_t vertex_count;
+    uint64_t index_count;
+    uint64_t payload_size;
+    uint64_t checksum;
+};
+
+// Bounds checked reads out of a mapped mesh disk cache file. Once a read fails every later read fails as well.
+struct MeshCacheReader
+{
+    const uint8_t* data;
+    size_t         size;
+    size_t         offset = 0;
+    bool           failed = false;
+
+    MeshCacheReader(const uint8_t* data, size_t size) :
+        data(data), size(size) {}
+
+    template <typename T>
+    T read()
+    {
+        T value = {};
+
+        if (failed || size - offset < sizeof(T))
+            failed = true;
+        else
+        {
+            memcpy(&value, data + offset, sizeof(T));
+            offset += sizeof(T);
+        }
+
+        return value;
+    }
+
+    std::string read_string()
+    {
+        uint32_t length = read<uint32_t>();
+
+        if (failed || size - offset < length)
+        {
+            failed = true;
+            return "";
+        }
+
+        std::string value(reinterpret_cast<const char*>(data + offset), length);
+        offset += length;
+
+        return value;
+    }
+};
+
+template <typename T>
+static void mesh_cache_write(std::vector<uint8_t>& out, const T& value)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void mesh_cache_write_string(std::vector<uint8_t>& out, const std::string& value)
+{
+    mesh_cache_write(out, uint32_t(value.size()));
+    out.insert(out.end(), value.begin(), value.end());
+}
+
+// Checksum of everything after the header. Flipped bits in the payload would otherwise decode into wrong geometry.
+static uint64_t mesh_cache_checksum(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t   i    = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+
+        hash = (hash ^ word) * 1099511628211ull;
+        hash ^= hash >> 32;
+    }
+
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * 1099511628211ull;
+
+    return hash;
+}
+
+// Size and modification time of the source file, used to detect stale cache files.
+static bool mesh_source_stamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+    std::error_code ec;
+
+    size = std::filesystem::file_size(path, ec);
+
+    if (ec)
+        return false;
+
+    auto write_time = std::filesystem::last_write_time(path, ec);
+
+    if (ec)
+        return false;
+
+    time = int64_t(write_time.time_since_epoch().count());
+
+    return true;
+}
+
+// Cache files are named after the source file plus a hash of its absolute path, so meshes with the same name in different
+// directories do not collide.
+static std::string mesh_cache_path(const std::string& directory, const std::string& path)
+{
+    std::error_code ec;
+    std::string     absolute = std::filesystem::absolute(path, ec).lexically_normal().generic_string();
+
+    if (ec)
+        absolute = path;
+
+    // FNV-1a, which unlike std::hash is stable across standard libraries.
+    uint64_t hash = 14695981039346656037ull;
+
+    for (char c : absolute)
+    {
+        hash ^= uint8_t(c);
+        hash *= 1099511628211ull;
+    }
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%016llx", (unsigned long long)hash);
+
+    return directory + "/" + utility::file_name_from_path(path) + suffix + MESH_DISK_CACHE_EXTENSION;
+}
+
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 Mesh::Ptr Mesh::load(
@@ -241,7 +716,28 @@ bool Mesh::is_loaded(const std::string& name)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Mesh::load_from_disk(
+void Mesh::set_weld_epsilon(float epsilon)
+{
+    m_weld_epsilon = epsilon;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Mesh::set_native_gltf_loader(bool enabled)
+{
+    m_native_gltf_loader = enabled;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Mesh::set_disk_cache_directory(const std::string& directory)
+{
+    m_disk_cache_directory = directory;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Mesh::load_with_assimp(
 #if defined(DWSF_VULKAN)
     vk::Backend::Ptr backend,
 #endif
@@ -251,6 +747,7 @@ void Mesh::load_from_disk(
 {
     const aiScene*   Scene;
     Assimp::Importer importer;
+    importer.SetIOHandler(new VfsIOSystem());
     Scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
     bool        is_gltf   = false;
@@ -603,6 +1100,479 @@ void Mesh::load_from_disk(
 
         submesh.base_vertex = 0;
     }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Mesh::load_from_gltf(
+#if defined(DWSF_VULKAN)
+    vk::Backend::Ptr backend,
+#endif
+    const std::string& path,
+    bool               load_materials)
+{
+    gltf::Model model;
+
+    if (!gltf::load(path, model))
+        return false;
+
+    m_vertices   = std::move(model.vertices);
+    m_indices    = std::move(model.indices);
+    m_sub_meshes = std::move(model.sub_meshes);
+
+    std::unordered_map<uint32_t, uint32_t> local_mat_idx_mapping;
+
+    for (auto& sub_mesh : m_sub_meshes)
+    {
+        if (!load_materials)
+        {
+            sub_mesh.mat_idx = 0;
+            continue;
+        }
+
+        auto it = local_mat_idx_mapping.find(sub_mesh.mat_idx);
+
+        if (it != local_mat_idx_mapping.end())
+        {
+            sub_mesh.mat_idx = it->second;
+            continue;
+        }
+
+        // Same texture layout and factor rules as the Assimp path: roughness and metallic share the metallic-roughness
+        // texture, and factors are only used in place of a missing texture.
+        std::vector<std::string> texture_paths;
+
+        int32_t    albedo_idx    = -1;
+        int32_t    normal_idx    = -1;
+        glm::ivec2 roughness_idx = glm::ivec2(-1);
+        glm::ivec2 metallic_idx  = glm::ivec2(-1);
+        int32_t    emissive_idx  = -1;
+
+        gltf::MaterialDesc desc;
+
+        if (sub_mesh.mat_idx != GLTF_NO_MATERIAL)
+            desc = model.materials[sub_mesh.mat_idx];
+
+        if (!desc.base_color_texture.empty())
+        {
+            albedo_idx = texture_paths.size();
+            texture_paths.push_back(desc.base_color_texture);
+        }
+
+        if (!desc.metallic_roughness_texture.empty())
+        {
+            roughness_idx = glm::ivec2(texture_paths.size(), 1);
+            metallic_idx  = glm::ivec2(texture_paths.size(), 2);
+            texture_paths.push_back(desc.metallic_roughness_texture);
+        }
+
+        if (!desc.emissive_texture.empty())
+        {
+            emissive_idx = texture_paths.size();
+            texture_paths.push_back(desc.emissive_texture);
+        }
+
+        if (!desc.normal_texture.empty())
+        {
+            normal_idx = texture_paths.size();
+            texture_paths.push_back(desc.normal_texture);
+        }
+
+        Material::Ptr mat = Material::load(
+#if defined(DWSF_VULKAN)
+            backend,
+#endif
+            texture_paths,
+            albedo_idx,
+            normal_idx,
+            roughness_idx,
+            metallic_idx,
+            emissive_idx);
+
+        if (albedo_idx == -1)
+            mat->set_albedo_value(desc.base_color_factor);
+
+        if (roughness_idx.x == -1)
+        {
+            mat->set_roughness_value(desc.roughness_factor);
+            mat->set_metallic_value(desc.metallic_factor);
+        }
+
+        if (emissive_idx == -1)
+            mat->set_emissive_value(desc.emissive_factor);
+
+        mat->set_alpha_test(desc.alpha_test);
+
+        local_mat_idx_mapping[sub_mesh.mat_idx] = m_materials.size();
+
+        sub_mesh.mat_idx = m_materials.size();
+
+        m_materials.push_back(mat);
+    }
+
+    // Vertices carry their material index in position.w, like the Assimp path writes them. Submesh vertices are stored
+    // contiguously in submesh order.
+    uint32_t base_vertex = 0;
+
+    for (const auto& sub_mesh : m_sub_meshes)
+    {
+        for (uint32_t i = 0; i < sub_mesh.vertex_count; i++)
+            m_vertices[base_vertex + i].position.w = float(sub_mesh.mat_idx);
+
+        base_vertex += sub_mesh.vertex_count;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Mesh::load_from_disk_cache(
+#if defined(DWSF_VULKAN)
+    vk::Backend::Ptr backend,
+#endif
+    const std::string& path,
+    const std::string& cache_path,
+    bool               load_materials,
+    bool               is_orca_mesh)
+{
+    utility::MappedFile file;
+
+    if (!file.open(cache_path))
+        return false;
+
+    uint64_t source_size = 0;
+    int64_t  source_time = 0;
+
+    if (!mesh_source_stamp(path, source_size, source_time))
+        return false;
+
+    uint32_t flags = (load_materials ? MESH_DISK_CACHE_LOAD_MATERIALS : 0) | (is_orca_mesh ? MESH_DISK_CACHE_ORCA_MESH : 0) | (m_native_gltf_loader ? MESH_DISK_CACHE_NATIVE_GLTF : 0);
+
+    MeshCacheReader reader(file.data(), file.size());
+    MeshCacheHeader header = reader.read<MeshCacheHeader>();
+
+    // A stale or foreign file is silently replaced once the source has been imported again.
+    if (reader.failed || header.magic != MESH_DISK_CACHE_MAGIC || header.version != MESH_DISK_CACHE_VERSION || header.vertex_size != sizeof(Vertex) || header.flags != flags ||
+        header.source_size != source_size || header.source_time != source_time || header.weld_epsilon != m_weld_epsilon || header.sub_mesh_count == 0)
+        return false;
+
+    if (mesh_cache_checksum(file.data() + sizeof(MeshCacheHeader), file.size() - sizeof(MeshCacheHeader)) != header.checksum)
+    {
+        DW_LOG_WARNING("Ignoring corrupt mesh cache: " + cache_path);
+        return false;
+    }
+
+    std::vector<SubMesh>                    sub_meshes(header.sub_mesh_count);
+    std::vector<mesh_codec::EncodedSubMesh> encoded(header.sub_mesh_count);
+    uint64_t                                vertex_count = 0;
+
+    for (uint32_t i = 0; i < header.sub_mesh_count && !reader.failed; i++)
+    {
+        SubMesh& sub_mesh = sub_meshes[i];
+
+        sub_mesh.name         = reader.read_string();
+        sub_mesh.mat_idx      = reader.read<uint32_t>();
+        sub_mesh.index_count  = reader.read<uint32_t>();
+        sub_mesh.base_vertex  = reader.read<uint32_t>();
+        sub_mesh.base_index   = reader.read<uint32_t>();
+        sub_mesh.vertex_count = reader.read<uint32_t>();
+        sub_mesh.max_extents  = reader.read<glm::vec3>();
+        sub_mesh.min_extents  = reader.read<glm::vec3>();
+        encoded[i]            = reader.read<mesh_codec::EncodedSubMesh>();
+
+        vertex_count += sub_mesh.vertex_count;
+
+        if (uint64_t(sub_mesh.base_index) + sub_mesh.index_count > header.index_count || (sub_mesh.mat_idx >= header.material_count && header.material_count > 0))
+            reader.failed = true;
+    }
+
+    if (reader.failed || vertex_count != header.vertex_count)
+    {
+        DW_LOG_WARNING("Ignoring corrupt mesh cache: " + cache_path);
+        return false;
+    }
+
+    struct CachedMaterial
+    {
+        std::vector<std::string> texture_paths;
+        int32_t                  albedo_idx;
+        int32_t                  normal_idx;
+        glm::ivec2               roughness_idx;
+        glm::ivec2               metallic_idx;
+        int32_t                  emissive_idx;
+        glm::vec4                albedo_value;
+        glm::vec3                emissive_value;
+        float                    roughness_value;
+        float                    metallic_value;
+        uint32_t                 alpha_test;
+    };
+
+    std::vector<CachedMaterial> materials(header.material_count);
+
+    for (auto& material : materials)
+    {
+        uint32_t texture_count = reader.read<uint32_t>();
+
+        for (uint32_t i = 0; i < texture_count && !reader.failed; i++)
+            material.texture_paths.push_back(reader.read_string());
+
+        material.albedo_idx      = reader.read<int32_t>();
+        material.normal_idx      = reader.read<int32_t>();
+        material.roughness_idx   = reader.read<glm::ivec2>();
+        material.metallic_idx    = reader.read<glm::ivec2>();
+        material.emissive_idx    = reader.read<int32_t>();
+        material.albedo_value    = reader.read<glm::vec4>();
+        material.emissive_value  = reader.read<glm::vec3>();
+        material.roughness_value = reader.read<float>();
+        material.metallic_value  = reader.read<float>();
+        material.alpha_test      = reader.read<uint32_t>();
+
+        for (int32_t idx : { material.albedo_idx, material.normal_idx, material.roughness_idx.x, material.metallic_idx.x, material.emissive_idx })
+        {
+            if (idx < -1 || idx >= int32_t(material.texture_paths.size()))
+                reader.failed = true;
+        }
+
+        if (reader.failed)
+            break;
+    }
+
+    if (reader.failed || file.size() - reader.offset != header.payload_size)
+    {
+        DW_LOG_WARNING("Ignoring corrupt mesh cache: " + cache_path);
+        return false;
+    }
+
+    Timer timer;
+
+    timer.start();
+
+    std::vector<Vertex>   vertices(header.vertex_count);
+    std::vector<uint32_t> indices(header.index_count);
+
+    if (!mesh_codec::decode_mesh(file.data() + reader.offset, header.payload_size, encoded, sub_meshes, vertices.data(), indices.data()))
+    {
+        DW_LOG_WARNING("Ignoring corrupt mesh cache: " + cache_path);
+        return false;
+    }
+
+    double decode_time = timer.elapsed_time_milisec();
+    double raw_size    = double(vertices.size() * sizeof(Vertex) + indices.size() * sizeof(uint32_t));
+
+    DW_LOG_INFO("Loaded " + path + " from mesh cache: " + std::to_string(raw_size / 1048576.0) + " MB -> " + std::to_string(header.payload_size / 1048576.0) + " MB (" + std::to_string(raw_size / std::max(header.payload_size, uint64_t(1))) + "x), decoded in " + std::to_string(decode_time) + " ms (" + std::to_string(raw_size / (std::max(decode_time, 1e-3) * 1e6)) + " GB/s).");
+
+    m_vertices   = std::move(vertices);
+    m_indices    = std::move(indices);
+    m_sub_meshes = std::move(sub_meshes);
+
+    for (const auto& material : materials)
+    {
+        Material::Ptr mat = Material::load(
+#if defined(DWSF_VULKAN)
+            backend,
+#endif
+            material.texture_paths,
+            material.albedo_idx,
+            material.normal_idx,
+            material.roughness_idx,
+            material.metallic_idx,
+            material.emissive_idx);
+
+        mat->set_albedo_value(material.albedo_value);
+        mat->set_roughness_value(material.roughness_value);
+        mat->set_metallic_value(material.metallic_value);
+        mat->set_emissive_value(material.emissive_value);
+        mat->set_alpha_test(material.alpha_test != 0);
+
+        m_materials.push_back(mat);
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Mesh::write_to_disk_cache(const std::string& path,
+                               const std::string& cache_path,
+                               bool               load_materials,
+                               bool               is_orca_mesh)
+{
+    MeshCacheHeader header = {};
+
+    header.magic          = MESH_DISK_CACHE_MAGIC;
+    header.version        = MESH_DISK_CACHE_VERSION;
+    header.vertex_size    = sizeof(Vertex);
+    header.flags          = (load_materials ? MESH_DISK_CACHE_LOAD_MATERIALS : 0) | (is_orca_mesh ? MESH_DISK_CACHE_ORCA_MESH : 0) | (m_native_gltf_loader ? MESH_DISK_CACHE_NATIVE_GLTF : 0);
+    header.weld_epsilon   = m_weld_epsilon;
+    header.sub_mesh_count = m_sub_meshes.size();
+    header.material_count = m_materials.size();
+    header.vertex_count   = m_vertices.size();
+    header.index_count    = m_indices.size();
+
+    if (!mesh_source_stamp(path, header.source_size, header.source_time))
+        return;
+
+    Timer timer;
+
+    timer.start();
+
+    std::vector<uint8_t>                    payload;
+    std::vector<mesh_codec::EncodedSubMesh> encoded;
+
+    mesh_codec::encode_mesh(m_vertices, m_indices, m_sub_meshes, payload, encoded);
+
+    double encode_time = timer.elapsed_time_milisec();
+
+    header.payload_size = payload.size();
+
+    std::vector<uint8_t> out;
+
+    mesh_cache_write(out, header);
+
+    for (uint32_t i = 0; i < m_sub_meshes.size(); i++)
+    {
+        const SubMesh& sub_mesh = m_sub_meshes[i];
+
+        mesh_cache_write_string(out, sub_mesh.name);
+        mesh_cache_write(out, sub_mesh.mat_idx);
+        mesh_cache_write(out, sub_mesh.index_count);
+        mesh_cache_write(out, sub_mesh.base_vertex);
+        mesh_cache_write(out, sub_mesh.base_index);
+        mesh_cache_write(out, sub_mesh.vertex_count);
+        mesh_cache_write(out, sub_mesh.max_extents);
+        mesh_cache_write(out, sub_mesh.min_extents);
+        mesh_cache_write(out, encoded[i]);
+    }
+
+    for (const auto& material : m_materials)
+    {
+        const auto& texture_paths = material->texture_paths();
+
+        mesh_cache_write(out, uint32_t(texture_paths.size()));
+
+        for (const auto& texture_path : texture_paths)
+            mesh_cache_write_string(out, texture_path);
+
+        mesh_cache_write(out, material->albedo_idx());
+        mesh_cache_write(out, material->normal_idx());
+        mesh_cache_write(out, glm::ivec2(material->roughness_idx(), material->roughness_channel()));
+        mesh_cache_write(out, glm::ivec2(material->metallic_idx(), material->metallic_channel()));
+        mesh_cache_write(out, material->emissive_idx());
+        mesh_cache_write(out, material->albedo_value());
+        mesh_cache_write(out, material->emissive_value());
+        mesh_cache_write(out, material->roughness_value());
+        mesh_cache_write(out, material->metallic_value());
+        mesh_cache_write(out, uint32_t(material->alpha_test()));
+    }
+
+    out.insert(out.end(), payload.begin(), payload.end());
+
+    header.checksum = mesh_cache_checksum(out.data() + sizeof(MeshCacheHeader), out.size() - sizeof(MeshCacheHeader));
+    memcpy(out.data(), &header, sizeof(MeshCacheHeader));
+
+    // Write to a temporary file first so that a concurrent or interrupted load never sees a partial cache file.
+    std::error_code ec;
+    std::string     temp_path = cache_path + ".tmp";
+
+    std::filesystem::create_directories(m_disk_cache_directory, ec);
+
+    FILE* f = fopen(temp_path.c_str(), "wb");
+
+    if (!f)
+    {
+        DW_LOG_WARNING("Failed to write mesh cache: " + cache_path);
+        return;
+    }
+
+    bool written = fwrite(out.data(), 1, out.size(), f) == out.size();
+    written      = fclose(f) == 0 && written;
+
+    if (written)
+        std::filesystem::rename(temp_path, cache_path, ec);
+
+    if (!written || ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        DW_LOG_WARNING("Failed to write mesh cache: " + cache_path);
+        return;
+    }
+
+    double raw_size = double(m_vertices.size() * sizeof(Vertex) + m_indices.size() * sizeof(uint32_t));
+
+    DW_LOG_INFO("Wrote mesh cache " + cache_path + ": " + std::to_string(raw_size / 1048576.0) + " MB -> " + std::to_string(payload.size() / 1048576.0) + " MB (" + std::to_string(raw_size / std::max(payload.size(), size_t(1))) + "x), encoded in " + std::to_string(encode_time) + " ms.");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Mesh::load_from_disk(
+#if defined(DWSF_VULKAN)
+    vk::Backend::Ptr backend,
+#endif
+    const std::string& path,
+    bool               load_materials,
+    bool               is_orca_mesh)
+{
+    std::string cache_path;
+    bool        cached = false;
+
+    if (!m_disk_cache_directory.empty())
+    {
+        cache_path = mesh_cache_path(m_disk_cache_directory, path);
+        cached     = load_from_disk_cache(
+#if defined(DWSF_VULKAN)
+            backend,
+#endif
+            path,
+            cache_path,
+            load_materials,
+            is_orca_mesh);
+    }
+
+    if (!cached)
+    {
+        Timer timer;
+
+        timer.start();
+
+        std::string extension = utility::file_extension(path);
+        bool        native    = false;
+
+        if (m_native_gltf_loader && (extension == "gltf" || extension == "glb"))
+        {
+            native = load_from_gltf(
+#if defined(DWSF_VULKAN)
+                backend,
+#endif
+                path,
+                load_materials);
+
+            if (!native)
+                DW_LOG_WARNING("Falling back to Assimp for " + path);
+        }
+
+        if (!native)
+        {
+            load_with_assimp(
+#if defined(DWSF_VULKAN)
+                backend,
+#endif
+                path,
+                load_materials,
+                is_orca_mesh);
+        }
+
+        // Face-indexed formats such as OBJ come in with one vertex per face corner.
+        double   import_time    = timer.elapsed_time_milisec();
+        uint32_t imported_count = m_vertices.size();
+        uint32_t welded_count   = weld_vertices(m_vertices, m_indices, m_sub_meshes, m_weld_epsilon);
+        double   weld_time      = timer.elapsed_time_milisec() - import_time;
+
+        DW_LOG_INFO("Loaded " + path + ": " + std::to_string(imported_count) + " -> " + std::to_string(welded_count) + " vertices after welding. Import (" + std::string(native ? "glTF" : "Assimp") + "): " + std::to_string(import_time) + " ms, welding: " + std::to_string(weld_time) + " ms.");
+
+        if (!cache_path.empty())
+            write_to_disk_cache(path, cache_path, load_materials, is_orca_mesh);
+    }
 
     m_max_extents = m_sub_meshes[0].max_extents;
     m_min_extents = m_sub_meshes[0].min_extents;
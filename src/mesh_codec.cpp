@@ -0,0 +1,1122 @@
+#include <mesh_codec.h>
+#include <jobs.h>
+#include <vfs.h>
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define DW_CODEC_SSE
+#endif
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+#define VERTEX_HEADER 0xA0
+#define INDEX_HEADER 0xE0
+#define INDEX_VERSION 1
+#define SEQUENCE_HEADER 0xD0
+
+#define BYTE_GROUP_SIZE 16
+// Largest encoded byte group: a 4 bit group with every value escaped. Decoding a group needs this many readable bytes.
+#define BYTE_GROUP_DECODE_LIMIT 24
+#define VERTEX_BLOCK_SIZE_BYTES 8192
+#define VERTEX_BLOCK_MAX_SIZE 256
+#define VERTEX_MAX_SIZE 256
+#define TAIL_MAX_SIZE 32
+// LZ4 is kept for a stream once it saves at least this fraction of it, as for archive entries.
+#define STREAM_MIN_SAVING_DIVISOR 8
+// LZ4 expands each stored byte into at most 255 bytes, which bounds what a damaged stream size can make the decoder allocate.
+#define STREAM_MAX_EXPANSION 255
+
+namespace dw
+{
+namespace mesh_codec
+{
+namespace
+{
+// Escape values of the auxiliary code table used for triangles that do not share an edge with a recent triangle. The
+// last two entries are never encoded.
+const uint8_t kCodeAuxTable[16] = { 0x00, 0x76, 0x87, 0x56, 0x67, 0x78, 0xa9, 0x86, 0x65, 0x89, 0x68, 0x98, 0x01, 0x69, 0x00, 0x00 };
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint32_t count_trailing_zeros(uint32_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return index;
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint8_t zigzag8(uint8_t v)
+{
+    return uint8_t((v << 1) ^ uint8_t(int8_t(v) >> 7));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint8_t unzigzag8(uint8_t v)
+{
+    return uint8_t(-(v & 1) ^ (v >> 1));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Vertex codec.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DW_CODEC_SSE)
+// Replaces every value equal to the sentinel with the next escape byte. Escapes are rare, so they go through memory.
+inline __m128i patch_escapes(__m128i values, uint8_t sentinel, const uint8_t*& escape)
+{
+    uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(values, _mm_set1_epi8(char(sentinel))));
+
+    if (!mask)
+        return values;
+
+    uint8_t buffer[BYTE_GROUP_SIZE];
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(buffer), values);
+
+    while (mask)
+    {
+        buffer[count_trailing_zeros(mask)] = *escape++;
+        mask &= mask - 1;
+    }
+
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Unpacks one group of 16 values, most significant bits first.
+inline __m128i decode_bytes_group(const uint8_t*& data, int bits_log2)
+{
+    switch (bits_log2)
+    {
+        case 0:
+            return _mm_setzero_si128();
+        case 1:
+        {
+            int32_t packed;
+            memcpy(&packed, data, 4);
+
+            __m128i v    = _mm_cvtsi32_si128(packed);
+            __m128i mask = _mm_set1_epi8(3);
+            __m128i v0   = _mm_and_si128(_mm_srli_epi16(v, 6), mask);
+            __m128i v1   = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+            __m128i v2   = _mm_and_si128(_mm_srli_epi16(v, 2), mask);
+            __m128i v3   = _mm_and_si128(v, mask);
+
+            const uint8_t* escape = data + 4;
+            __m128i        result = patch_escapes(_mm_unpacklo_epi16(_mm_unpacklo_epi8(v0, v1), _mm_unpacklo_epi8(v2, v3)), 3, escape);
+
+            data = escape;
+            return result;
+        }
+        case 2:
+        {
+            __m128i v    = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data));
+            __m128i mask = _mm_set1_epi8(15);
+
+            const uint8_t* escape = data + 8;
+            __m128i        result = patch_escapes(_mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), mask), _mm_and_si128(v, mask)), 15, escape);
+
+            data = escape;
+            return result;
+        }
+        default:
+        {
+            __m128i result = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+
+            data += BYTE_GROUP_SIZE;
+            return result;
+        }
+    }
+}
+#else
+inline const uint8_t* decode_bytes_group(const uint8_t* data, uint8_t* buffer, int bits_log2)
+{
+    switch (bits_log2)
+    {
+        case 0:
+        {
+            memset(buffer, 0, BYTE_GROUP_SIZE);
+            return data;
+        }
+        case 1:
+        case 2:
+        {
+            // Packed 2 or 4 bit values, most significant bits first. The all-ones value escapes to a full byte stored after
+            // the packed values.
+            const uint32_t bits     = bits_log2 == 1 ? 2 : 4;
+            const uint32_t sentinel = (1 << bits) - 1;
+            const uint8_t* escape   = data + BYTE_GROUP_SIZE * bits / 8;
+
+            for (uint32_t i = 0; i < BYTE_GROUP_SIZE; i++)
+            {
+                uint32_t shift = 8 - bits - (i * bits) % 8;
+                uint8_t  value = (data[i * bits / 8] >> shift) & sentinel;
+
+                buffer[i] = value == sentinel ? *escape++ : value;
+            }
+
+            return escape;
+        }
+        default:
+        {
+            memcpy(buffer, data, BYTE_GROUP_SIZE);
+            return data + BYTE_GROUP_SIZE;
+        }
+    }
+}
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Decodes one byte plane of a block: bit packed zigzag deltas against the previous vertex. The plane is padded to whole
+// groups.
+const uint8_t* decode_plane(const uint8_t* data, const uint8_t* data_end, uint8_t* plane, size_t count_aligned, uint8_t previous)
+{
+    const uint8_t* header      = data;
+    size_t         header_size = (count_aligned / BYTE_GROUP_SIZE + 3) / 4;
+
+    if (size_t(data_end - data) < header_size)
+        return nullptr;
+
+    data += header_size;
+
+#if defined(DW_CODEC_SSE)
+    const __m128i one  = _mm_set1_epi8(1);
+    const __m128i low7 = _mm_set1_epi8(0x7F);
+    __m128i       last = _mm_set1_epi8(char(previous));
+#endif
+
+    for (size_t i = 0; i < count_aligned; i += BYTE_GROUP_SIZE)
+    {
+        if (size_t(data_end - data) < BYTE_GROUP_DECODE_LIMIT)
+            return nullptr;
+
+        size_t group     = i / BYTE_GROUP_SIZE;
+        int    bits_log2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+
+#if defined(DW_CODEC_SSE)
+        __m128i v = decode_bytes_group(data, bits_log2);
+
+        v = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low7), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, one)));
+
+        // Prefix sum of the 16 deltas in four steps.
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi8(v, last);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(plane + i), v);
+
+        // Broadcast the last byte as the base of the next group.
+        last = _mm_shuffle_epi32(_mm_shufflehi_epi16(_mm_unpackhi_epi8(v, v), 0xFF), 0xFF);
+#else
+        data = decode_bytes_group(data, plane + i, bits_log2);
+
+        for (size_t j = i; j < i + BYTE_GROUP_SIZE; j++)
+        {
+            previous = uint8_t(unzigzag8(plane[j]) + previous);
+            plane[j] = previous;
+        }
+#endif
+    }
+
+    return data;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DW_CODEC_SSE)
+// Interleaves four planes of 16 vertices into four registers holding the 4 bytes of four consecutive vertices each.
+inline void interleave_planes(const uint8_t* planes, size_t stride, __m128i quads[4])
+{
+    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 0 * stride));
+    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 1 * stride));
+    __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 2 * stride));
+    __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 3 * stride));
+
+    __m128i t0 = _mm_unpacklo_epi8(p0, p1);
+    __m128i t1 = _mm_unpackhi_epi8(p0, p1);
+    __m128i t2 = _mm_unpacklo_epi8(p2, p3);
+    __m128i t3 = _mm_unpackhi_epi8(p2, p3);
+
+    quads[0] = _mm_unpacklo_epi16(t0, t2);
+    quads[1] = _mm_unpackhi_epi16(t0, t2);
+    quads[2] = _mm_unpacklo_epi16(t1, t3);
+    quads[3] = _mm_unpackhi_epi16(t1, t3);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+#endif
+
+// Interleaves the byte planes of a block back into vertices.
+inline void transpose_planes(const uint8_t* planes, size_t count, size_t count_aligned, size_t vertex_size, uint8_t* destination)
+{
+    size_t i = 0;
+
+#if defined(DW_CODEC_SSE)
+    for (; i + BYTE_GROUP_SIZE <= count; i += BYTE_GROUP_SIZE)
+    {
+        size_t k = 0;
+
+        // Sixteen planes of 16 vertices at a time: interleave bytes into dwords, then transpose the dwords so that every
+        // vertex gets one 16 byte store.
+        for (; k + 16 <= vertex_size; k += 16)
+        {
+            __m128i quads[4][4];
+
+            for (size_t g = 0; g < 4; g++)
+                interleave_planes(planes + (k + g * 4) * count_aligned + i, count_aligned, quads[g]);
+
+            for (size_t q = 0; q < 4; q++)
+            {
+                __m128i t0 = _mm_unpacklo_epi32(quads[0][q], quads[1][q]);
+                __m128i t1 = _mm_unpacklo_epi32(quads[2][q], quads[3][q]);
+                __m128i t2 = _mm_unpackhi_epi32(quads[0][q], quads[1][q]);
+                __m128i t3 = _mm_unpackhi_epi32(quads[2][q], quads[3][q]);
+
+                uint8_t* out = destination + (i + q * 4) * vertex_size + k;
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 0 * vertex_size), _mm_unpacklo_epi64(t0, t1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 1 * vertex_size), _mm_unpackhi_epi64(t0, t1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * vertex_size), _mm_unpacklo_epi64(t2, t3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3 * vertex_size), _mm_unpackhi_epi64(t2, t3));
+            }
+        }
+
+        // Remaining planes four at a time, one 32 bit store per vertex.
+        for (; k < vertex_size; k += 4)
+        {
+            __m128i quads[4];
+
+            interleave_planes(planes + k * count_aligned + i, count_aligned, quads);
+
+            for (size_t q = 0; q < 4; q++)
+            {
+                uint8_t* out = destination + (i + q * 4) * vertex_size + k;
+
+                for (size_t j = 0; j < 4; j++)
+                {
+                    int32_t value = _mm_cvtsi128_si32(quads[q]);
+
+                    memcpy(out + j * vertex_size, &value, 4);
+
+                    quads[q] = _mm_srli_si128(quads[q], 4);
+                }
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        for (size_t k = 0; k < vertex_size; k++)
+            destination[i * vertex_size + k] = planes[k * count_aligned + i];
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t vertex_block_size(size_t vertex_size)
+{
+    return std::min((VERTEX_BLOCK_SIZE_BYTES / vertex_size) & ~size_t(BYTE_GROUP_SIZE - 1), size_t(VERTEX_BLOCK_MAX_SIZE));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t encoded_group_size(const uint8_t* group, int bits_log2)
+{
+    if (bits_log2 == 0)
+    {
+        for (uint32_t i = 0; i < BYTE_GROUP_SIZE; i++)
+        {
+            if (group[i] != 0)
+                return SIZE_MAX;
+        }
+
+        return 0;
+    }
+
+    if (bits_log2 == 3)
+        return BYTE_GROUP_SIZE;
+
+    uint32_t bits     = 1 << bits_log2;
+    uint32_t sentinel = (1 << bits) - 1;
+    size_t   size     = BYTE_GROUP_SIZE * bits / 8;
+
+    for (uint32_t i = 0; i < BYTE_GROUP_SIZE; i++)
+        size += group[i] >= sentinel ? 1 : 0;
+
+    return size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void encode_bytes_group(const uint8_t* group, int bits_log2, std::vector<uint8_t>& out)
+{
+    if (bits_log2 == 0)
+        return;
+
+    if (bits_log2 == 3)
+    {
+        out.insert(out.end(), group, group + BYTE_GROUP_SIZE);
+        return;
+    }
+
+    uint32_t bits     = 1 << bits_log2;
+    uint32_t sentinel = (1 << bits) - 1;
+    size_t   start    = out.size();
+
+    out.resize(start + BYTE_GROUP_SIZE * bits / 8, 0);
+
+    for (uint32_t i = 0; i < BYTE_GROUP_SIZE; i++)
+    {
+        uint32_t value = std::min(uint32_t(group[i]), sentinel);
+        out[start + i * bits / 8] |= uint8_t(value << (8 - bits - (i * bits) % 8));
+    }
+
+    for (uint32_t i = 0; i < BYTE_GROUP_SIZE; i++)
+    {
+        if (group[i] >= sentinel)
+            out.push_back(group[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void encode_bytes(const uint8_t* buffer, size_t buffer_size, std::vector<uint8_t>& out)
+{
+    size_t groups      = buffer_size / BYTE_GROUP_SIZE;
+    size_t header      = out.size();
+    size_t header_size = (groups + 3) / 4;
+
+    out.resize(header + header_size, 0);
+
+    for (size_t g = 0; g < groups; g++)
+    {
+        const uint8_t* group     = buffer + g * BYTE_GROUP_SIZE;
+        int            best      = 3;
+        size_t         best_size = BYTE_GROUP_SIZE;
+
+        for (int bits_log2 = 0; bits_log2 < 3; bits_log2++)
+        {
+            size_t size = encoded_group_size(group, bits_log2);
+
+            if (size < best_size)
+            {
+                best      = bits_log2;
+                best_size = size;
+            }
+        }
+
+        out[header + g / 4] |= uint8_t(best << ((g % 4) * 2));
+
+        encode_bytes_group(group, best, out);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+// Index codec.
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+struct IndexFifos
+{
+    uint32_t edges[16][2];
+    uint32_t vertices[16];
+    size_t   edge_offset   = 0;
+    size_t   vertex_offset = 0;
+
+    IndexFifos()
+    {
+        memset(edges, -1, sizeof(edges));
+        memset(vertices, -1, sizeof(vertices));
+    }
+
+    inline void push_edge(uint32_t a, uint32_t b)
+    {
+        edges[edge_offset][0] = a;
+        edges[edge_offset][1] = b;
+        edge_offset           = (edge_offset + 1) & 15;
+    }
+
+    inline void push_vertex(uint32_t v, bool condition = true)
+    {
+        vertices[vertex_offset] = v;
+        vertex_offset           = (vertex_offset + (condition ? 1 : 0)) & 15;
+    }
+
+    // Age of the edge (a, b), or -1 if it is not in the FIFO.
+    inline int find_edge(uint32_t a, uint32_t b) const
+    {
+        for (int i = 0; i < 15; i++)
+        {
+            size_t index = (edge_offset - 1 - i) & 15;
+
+            if (edges[index][0] == a && edges[index][1] == b)
+                return i;
+        }
+
+        return -1;
+    }
+
+    // Position of the vertex as addressed by the decoder, counting from the newest entry plus the given bias, or -1.
+    inline int find_vertex(uint32_t v, int first, int last, int bias) const
+    {
+        for (int i = first; i < last; i++)
+        {
+            if (vertices[(vertex_offset - bias - i) & 15] == v)
+                return i;
+        }
+
+        return -1;
+    }
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline void encode_vbyte(std::vector<uint8_t>& out, uint32_t v)
+{
+    do
+    {
+        out.push_back(uint8_t((v & 127) | (v > 127 ? 128 : 0)));
+        v >>= 7;
+    } while (v);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint32_t decode_vbyte(const uint8_t*& data)
+{
+    uint8_t lead = *data++;
+
+    if (lead < 128)
+        return lead;
+
+    uint32_t result = lead & 127;
+    uint32_t shift  = 7;
+
+    for (int i = 0; i < 4; i++)
+    {
+        uint8_t group = *data++;
+
+        result |= uint32_t(group & 127) << shift;
+        shift += 7;
+
+        if (group < 128)
+            break;
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline void encode_index(std::vector<uint8_t>& out, uint32_t index, uint32_t last)
+{
+    uint32_t d = index - last;
+    encode_vbyte(out, (d << 1) ^ uint32_t(int32_t(d) >> 31));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint32_t decode_index(const uint8_t*& data, uint32_t last)
+{
+    uint32_t v = decode_vbyte(data);
+    uint32_t d = (v >> 1) ^ -int32_t(v & 1);
+
+    return last + d;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline void write_index(uint8_t* destination, size_t index_size, size_t i, uint32_t value)
+{
+    if (index_size == 2)
+    {
+        uint16_t value16 = uint16_t(value);
+        memcpy(destination + i * 2, &value16, 2);
+    }
+    else
+        memcpy(destination + i * 4, &value, 4);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Replaces a codec stream with its LZ4 compressed form if that is sufficiently smaller.
+void compress_stream(std::vector<uint8_t>& stream)
+{
+    std::vector<uint8_t> compressed;
+
+    vfs::lz4_compress(stream.data(), stream.size(), compressed);
+
+    if (compressed.size() < stream.size() && compressed.size() <= stream.size() - stream.size() / STREAM_MIN_SAVING_DIVISOR)
+        stream.swap(compressed);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Returns the codec stream stored at data, decompressing it into the scratch buffer if it was compressed.
+const uint8_t* decompress_stream(const uint8_t* data, uint64_t size, uint64_t stream_size, std::vector<uint8_t>& scratch)
+{
+    if (size == stream_size)
+        return data;
+
+    scratch.resize(stream_size);
+
+    return vfs::lz4_decompress(data, size, scratch.data(), stream_size) ? scratch.data() : nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void encode_vertex_buffer(const void* vertices, size_t vertex_count, size_t vertex_size, std::vector<uint8_t>& out)
+{
+    const uint8_t* data = static_cast<const uint8_t*>(vertices);
+
+    out.push_back(VERTEX_HEADER);
+
+    if (vertex_count == 0)
+    {
+        out.resize(out.size() + std::max(vertex_size, size_t(TAIL_MAX_SIZE)), 0);
+        return;
+    }
+
+    uint8_t last_vertex[VERTEX_MAX_SIZE];
+    uint8_t deltas[VERTEX_BLOCK_MAX_SIZE];
+
+    memcpy(last_vertex, data, vertex_size);
+
+    size_t block_size = vertex_block_size(vertex_size);
+
+    for (size_t block_offset = 0; block_offset < vertex_count; block_offset += block_size)
+    {
+        size_t         count         = std::min(block_size, vertex_count - block_offset);
+        size_t         count_aligned = (count + BYTE_GROUP_SIZE - 1) & ~size_t(BYTE_GROUP_SIZE - 1);
+        const uint8_t* block         = data + block_offset * vertex_size;
+
+        for (size_t k = 0; k < vertex_size; k++)
+        {
+            uint8_t previous = last_vertex[k];
+
+            for (size_t i = 0; i < count; i++)
+            {
+                uint8_t value = block[i * vertex_size + k];
+
+                deltas[i] = zigzag8(uint8_t(value - previous));
+                previous  = value;
+            }
+
+            memset(deltas + count, 0, count_aligned - count);
+
+            encode_bytes(deltas, count_aligned, out);
+        }
+
+        memcpy(last_vertex, block + (count - 1) * vertex_size, vertex_size);
+    }
+
+    // The tail holds the first vertex, which predicts the first block, and pads the stream so that group decoding never
+    // reads past the end.
+    out.resize(out.size() + std::max(vertex_size, size_t(TAIL_MAX_SIZE)) - vertex_size, 0);
+    out.insert(out.end(), data, data + vertex_size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool decode_vertex_buffer(void* destination, size_t vertex_count, size_t vertex_size, const uint8_t* buffer, size_t buffer_size)
+{
+    if (vertex_size == 0 || vertex_size > VERTEX_MAX_SIZE || vertex_size % 4 != 0)
+        return false;
+
+    const uint8_t* data     = buffer;
+    const uint8_t* data_end = buffer + buffer_size;
+
+    if (buffer_size < 1 + vertex_size || *data++ != VERTEX_HEADER)
+        return false;
+
+    uint8_t  last_vertex[VERTEX_MAX_SIZE];
+    uint8_t  planes[VERTEX_BLOCK_SIZE_BYTES];
+    uint8_t* output = static_cast<uint8_t*>(destination);
+
+    memcpy(last_vertex, data_end - vertex_size, vertex_size);
+
+    size_t block_size = vertex_block_size(vertex_size);
+
+    for (size_t block_offset = 0; block_offset < vertex_count; block_offset += block_size)
+    {
+        size_t   count         = std::min(block_size, vertex_count - block_offset);
+        size_t   count_aligned = (count + BYTE_GROUP_SIZE - 1) & ~size_t(BYTE_GROUP_SIZE - 1);
+        uint8_t* block         = output + block_offset * vertex_size;
+
+        // Decode every byte plane of the block, then interleave them into vertices.
+        for (size_t k = 0; k < vertex_size; k++)
+        {
+            uint8_t* plane = planes + k * count_aligned;
+
+            data = decode_plane(data, data_end, plane, count_aligned, last_vertex[k]);
+
+            if (!data)
+                return false;
+        }
+
+        transpose_planes(planes, count, count_aligned, vertex_size, block);
+
+        memcpy(last_vertex, block + (count - 1) * vertex_size, vertex_size);
+    }
+
+    return size_t(data_end - data) == std::max(vertex_size, size_t(TAIL_MAX_SIZE));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void encode_index_buffer(const uint32_t* indices, size_t index_count, std::vector<uint8_t>& out)
+{
+    const int fec_max = 13;
+
+    IndexFifos           fifos;
+    uint32_t             next = 0;
+    uint32_t             last = 0;
+    std::vector<uint8_t> codes;
+    std::vector<uint8_t> data;
+
+    codes.reserve(index_count / 3);
+    data.reserve(index_count / 3);
+
+    for (size_t i = 0; i + 2 < index_count; i += 3)
+    {
+        uint32_t triangle[3] = { indices[i], indices[i + 1], indices[i + 2] };
+        int      fe          = -1;
+        int      rotation    = 0;
+
+        // Look for a recent edge in any of the three rotations of the triangle.
+        for (int r = 0; r < 3 && fe < 0; r++)
+        {
+            fe       = fifos.find_edge(triangle[r], triangle[(r + 1) % 3]);
+            rotation = r;
+        }
+
+        if (fe >= 0)
+        {
+            uint32_t a = triangle[rotation];
+            uint32_t b = triangle[(rotation + 1) % 3];
+            uint32_t c = triangle[(rotation + 2) % 3];
+            int      fec;
+
+            if (c == next)
+            {
+                fec = 0;
+                next++;
+            }
+            else
+                fec = fifos.find_vertex(c, 1, fec_max, 1);
+
+            if (fec >= 0)
+                fifos.push_vertex(c, fec == 0);
+            else
+            {
+                // Free index, with short codes for the neighbours of the last one.
+                if (c == last - 1)
+                    fec = 13;
+                else if (c == last + 1)
+                    fec = 14;
+                else
+                {
+                    fec = 15;
+                    encode_index(data, c, last);
+                }
+
+                last = c;
+
+                fifos.push_vertex(c);
+            }
+
+            codes.push_back(uint8_t((fe << 4) | fec));
+
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        }
+        else
+        {
+            // Start with the next new vertex if the triangle has it, so that it does not need to be stored.
+            rotation = 0;
+
+            for (int r = 0; r < 3; r++)
+            {
+                if (triangle[r] == next)
+                {
+                    rotation = r;
+                    break;
+                }
+            }
+
+            uint32_t a = triangle[rotation];
+            uint32_t b = triangle[(rotation + 1) % 3];
+            uint32_t c = triangle[(rotation + 2) % 3];
+
+            int fea = a == next ? 0 : 15;
+
+            if (fea == 0)
+                next++;
+
+            int feb = b == next ? 0 : fifos.find_vertex(b, 1, 15, 0);
+
+            if (feb == 0)
+                next++;
+            else if (feb < 0)
+                feb = 15;
+
+            int fec = c == next ? 0 : fifos.find_vertex(c, 1, 15, 0);
+
+            if (fec == 0)
+                next++;
+            else if (fec < 0)
+                fec = 15;
+
+            uint8_t codeaux = uint8_t((feb << 4) | fec);
+            int     table   = -1;
+
+            for (int t = 0; t < 14; t++)
+            {
+                if (kCodeAuxTable[t] == codeaux)
+                {
+                    table = t;
+                    break;
+                }
+            }
+
+            // A zero auxiliary code after 0xFE restarts the vertex numbering, so it always goes through the table.
+            if (fea == 0 && table >= 0)
+                codes.push_back(uint8_t(0xF0 | table));
+            else
+            {
+                codes.push_back(fea == 0 ? 0xFE : 0xFF);
+                data.push_back(codeaux);
+            }
+
+            if (fea == 15)
+            {
+                encode_index(data, a, last);
+                last = a;
+            }
+
+            if (feb == 15)
+            {
+                encode_index(data, b, last);
+                last = b;
+            }
+
+            if (fec == 15)
+            {
+                encode_index(data, c, last);
+                last = c;
+            }
+
+            fifos.push_vertex(a);
+            fifos.push_vertex(b, feb == 0 || feb == 15);
+            fifos.push_vertex(c, fec == 0 || fec == 15);
+
+            fifos.push_edge(b, a);
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        }
+    }
+
+    out.push_back(INDEX_HEADER | INDEX_VERSION);
+    out.insert(out.end(), codes.begin(), codes.end());
+    out.insert(out.end(), data.begin(), data.end());
+    out.insert(out.end(), kCodeAuxTable, kCodeAuxTable + 16);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool decode_index_buffer(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size)
+{
+    if (index_count % 3 != 0 || (index_size != 2 && index_size != 4))
+        return false;
+
+    // Header, one code byte per triangle and a 16 byte table of auxiliary codes at the end.
+    if (buffer_size < 1 + index_count / 3 + 16 || (buffer[0] & 0xF0) != INDEX_HEADER)
+        return false;
+
+    int version = buffer[0] & 0x0F;
+
+    if (version > INDEX_VERSION)
+        return false;
+
+    IndexFifos fifos;
+    uint32_t   next    = 0;
+    uint32_t   last    = 0;
+    int        fec_max = version >= 1 ? 13 : 15;
+    uint8_t*   output  = static_cast<uint8_t*>(destination);
+
+    const uint8_t* code          = buffer + 1;
+    const uint8_t* data          = code + index_count / 3;
+    const uint8_t* data_safe_end = buffer + buffer_size - 16;
+    const uint8_t* codeaux_table = data_safe_end;
+
+    for (size_t i = 0; i < index_count; i += 3)
+    {
+        // A triangle reads at most 16 bytes of data, which the auxiliary table at the end guarantees to be readable.
+        if (data > data_safe_end)
+            return false;
+
+        uint8_t codetri = *code++;
+
+        if (codetri < 0xF0)
+        {
+            // Triangle sharing an edge from the edge FIFO.
+            int      fe  = codetri >> 4;
+            uint32_t a   = fifos.edges[(fifos.edge_offset - 1 - fe) & 15][0];
+            uint32_t b   = fifos.edges[(fifos.edge_offset - 1 - fe) & 15][1];
+            int      fec = codetri & 15;
+            uint32_t c;
+
+            if (fec < fec_max)
+            {
+                bool fec0 = fec == 0;
+
+                c = fec0 ? next++ : fifos.vertices[(fifos.vertex_offset - 1 - fec) & 15];
+
+                fifos.push_vertex(c, fec0);
+            }
+            else
+            {
+                // 13 and 14 are small deltas from the last free index in version 1.
+                last = c = fec != 15 ? last + (fec - (fec ^ 3)) : decode_index(data, last);
+
+                fifos.push_vertex(c);
+            }
+
+            write_index(output, index_size, i + 0, a);
+            write_index(output, index_size, i + 1, b);
+            write_index(output, index_size, i + 2, c);
+
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        }
+        else
+        {
+            // Triangle without a shared edge. The first vertex is new, or in the slow path possibly a free index.
+            uint8_t codeaux;
+            int     fea;
+
+            if (codetri < 0xFE)
+            {
+                codeaux = codeaux_table[codetri & 15];
+                fea     = 0;
+            }
+            else
+            {
+                codeaux = *data++;
+                fea     = codetri == 0xFE ? 0 : 15;
+
+                if (codeaux == 0)
+                    next = 0;
+            }
+
+            int feb = codeaux >> 4;
+            int fec = codeaux & 15;
+
+            uint32_t a = fea == 0 ? next++ : 0;
+            uint32_t b = feb == 0 ? next++ : fifos.vertices[(fifos.vertex_offset - feb) & 15];
+            uint32_t c = fec == 0 ? next++ : fifos.vertices[(fifos.vertex_offset - fec) & 15];
+
+            if (fea == 15)
+                last = a = decode_index(data, last);
+
+            if (feb == 15)
+                last = b = decode_index(data, last);
+
+            if (fec == 15)
+                last = c = decode_index(data, last);
+
+            write_index(output, index_size, i + 0, a);
+            write_index(output, index_size, i + 1, b);
+            write_index(output, index_size, i + 2, c);
+
+            fifos.push_vertex(a);
+            fifos.push_vertex(b, feb == 0 || feb == 15);
+            fifos.push_vertex(c, fec == 0 || fec == 15);
+
+            fifos.push_edge(b, a);
+            fifos.push_edge(c, b);
+            fifos.push_edge(a, c);
+        }
+    }
+
+    return data == data_safe_end;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool decode_index_sequence(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size)
+{
+    if (index_size != 2 && index_size != 4)
+        return false;
+
+    // Header, at least one byte per index and a 4 byte tail.
+    if (buffer_size < 1 + index_count + 4 || (buffer[0] & 0xF0) != SEQUENCE_HEADER || (buffer[0] & 0x0F) > 1)
+        return false;
+
+    const uint8_t* data          = buffer + 1;
+    const uint8_t* data_safe_end = buffer + buffer_size - 4;
+    uint32_t       last[2]       = { 0, 0 };
+    uint8_t*       output        = static_cast<uint8_t*>(destination);
+
+    for (size_t i = 0; i < index_count; i++)
+    {
+        // An index reads at most 5 bytes, which the tail guarantees to be readable.
+        if (data >= data_safe_end)
+            return false;
+
+        uint32_t v       = decode_vbyte(data);
+        uint32_t current = v & 1;
+
+        v >>= 1;
+
+        uint32_t d     = (v >> 1) ^ -int32_t(v & 1);
+        uint32_t index = last[current] + d;
+
+        last[current] = index;
+
+        write_index(output, index_size, i, index);
+    }
+
+    return data == data_safe_end;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void encode_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const std::vector<SubMesh>& sub_meshes, std::vector<uint8_t>& payload, std::vector<EncodedSubMesh>& encoded)
+{
+    std::vector<uint32_t>             base_vertices(sub_meshes.size());
+    std::vector<std::vector<uint8_t>> streams(sub_meshes.size() * 2);
+    std::vector<uint64_t>             stream_sizes(sub_meshes.size() * 2);
+    uint32_t                          base_vertex = 0;
+
+    for (size_t i = 0; i < sub_meshes.size(); i++)
+    {
+        base_vertices[i] = base_vertex;
+        base_vertex += sub_meshes[i].vertex_count;
+    }
+
+    jobs::parallel_for(sub_meshes.size(), 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const SubMesh& sub_mesh = sub_meshes[i];
+
+            // Indices are coded relative to the submesh, which keeps them small and lets it decode on its own.
+            std::vector<uint32_t> local(indices.begin() + sub_mesh.base_index, indices.begin() + sub_mesh.base_index + sub_mesh.index_count);
+
+            for (auto& index : local)
+                index -= base_vertices[i];
+
+            encode_vertex_buffer(&vertices[base_vertices[i]], sub_mesh.vertex_count, sizeof(Vertex), streams[i * 2]);
+            encode_index_buffer(local.data(), local.size(), streams[i * 2 + 1]);
+
+            stream_sizes[i * 2]     = streams[i * 2].size();
+            stream_sizes[i * 2 + 1] = streams[i * 2 + 1].size();
+
+            compress_stream(streams[i * 2]);
+            compress_stream(streams[i * 2 + 1]);
+        }
+    });
+
+    encoded.resize(sub_meshes.size());
+
+    for (size_t i = 0; i < sub_meshes.size(); i++)
+    {
+        encoded[i].vertex_stream_size = stream_sizes[i * 2];
+        encoded[i].index_stream_size  = stream_sizes[i * 2 + 1];
+
+        encoded[i].vertex_offset = payload.size();
+        encoded[i].vertex_size   = streams[i * 2].size();
+        payload.insert(payload.end(), streams[i * 2].begin(), streams[i * 2].end());
+
+        encoded[i].index_offset = payload.size();
+        encoded[i].index_size   = streams[i * 2 + 1].size();
+        payload.insert(payload.end(), streams[i * 2 + 1].begin(), streams[i * 2 + 1].end());
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool decode_mesh(const uint8_t* payload, size_t payload_size, const std::vector<EncodedSubMesh>& encoded, const std::vector<SubMesh>& sub_meshes, Vertex* vertices, uint32_t* indices)
+{
+    if (encoded.size() != sub_meshes.size())
+        return false;
+
+    std::vector<uint32_t> base_vertices(sub_meshes.size());
+    uint32_t              base_vertex = 0;
+
+    for (size_t i = 0; i < sub_meshes.size(); i++)
+    {
+        const EncodedSubMesh& e = encoded[i];
+
+        if (e.vertex_offset > payload_size || e.vertex_size > payload_size - e.vertex_offset || e.index_offset > payload_size || e.index_size > payload_size - e.index_offset)
+            return false;
+
+        if (e.vertex_stream_size < e.vertex_size || e.vertex_stream_size / STREAM_MAX_EXPANSION > e.vertex_size ||
+            e.index_stream_size < e.index_size || e.index_stream_size / STREAM_MAX_EXPANSION > e.index_size)
+            return false;
+
+        base_vertices[i] = base_vertex;
+        base_vertex += sub_meshes[i].vertex_count;
+    }
+
+    std::atomic<bool> failed = { false };
+
+    jobs::parallel_for(sub_meshes.size(), 1, [&](uint32_t begin, uint32_t end) {
+        std::vector<uint8_t> vertex_scratch;
+        std::vector<uint8_t> index_scratch;
+
+        for (uint32_t i = begin; i < end && !failed; i++)
+        {
+            const SubMesh&        sub_mesh      = sub_meshes[i];
+            const EncodedSubMesh& e             = encoded[i];
+            uint32_t*             out           = indices + sub_mesh.base_index;
+            const uint8_t*        vertex_stream = decompress_stream(payload + e.vertex_offset, e.vertex_size, e.vertex_stream_size, vertex_scratch);
+            const uint8_t*        index_stream  = decompress_stream(payload + e.index_offset, e.index_size, e.index_stream_size, index_scratch);
+
+            if (!vertex_stream || !index_stream ||
+                !decode_vertex_buffer(vertices + base_vertices[i], sub_mesh.vertex_count, sizeof(Vertex), vertex_stream, e.vertex_stream_size) ||
+                !decode_index_buffer(out, sub_mesh.index_count, sizeof(uint32_t), index_stream, e.index_stream_size))
+            {
+                failed = true;
+                break;
+            }
+
+            // Rebase the indices, rejecting any that point outside the submesh.
+            uint32_t max_index = 0;
+
+            for (uint32_t j = 0; j < sub_mesh.index_count; j++)
+            {
+                max_index = std::max(max_index, out[j]);
+                out[j] += base_vertices[i];
+            }
+
+            if (sub_mesh.index_count > 0 && max_index >= sub_mesh.vertex_count)
+                failed = true;
+        }
+    });
+
+    return !failed;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace mesh_codec
+} // namespace dw
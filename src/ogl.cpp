@@ -4,10 +4,10 @@
 #    include <logger.h>
 #    include <ogl.h>
 #    include <utility.h>
-#    define STB_IMAGE_IMPLEMENTATION
+#    include <vfs.h>
+#    include <downsampler.h>
+#    include <staging_heap.h>
 #    include <stb_image.h>
-#    define STB_IMAGE_WRITE_IMPLEMENTATION
-#    include <stb_image_write.h>
 
 namespace dw
 {
@@ -31,6 +31,48 @@ int num_channels_from_internal_format(GLenum fmt)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+// Channels per pixel of a pixel transfer format, as passed to glGetTextureImage() along with the type.
+int num_channels_from_format(GLenum fmt)
+{
+    if (fmt == GL_RED || fmt == GL_RED_INTEGER || fmt == GL_DEPTH_COMPONENT)
+        return 1;
+    else if (fmt == GL_RG || fmt == GL_RG_INTEGER)
+        return 2;
+    else if (fmt == GL_RGB || fmt == GL_RGB_INTEGER)
+        return 3;
+    else if (fmt == GL_RGBA || fmt == GL_RGBA_INTEGER)
+        return 4;
+    else
+        return num_channels_from_internal_format(fmt);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Decode images from files served by the virtual file system, so that textures can come from mounted archives.
+static stbi_uc* load_image(const std::string& path, int* x, int* y, int* n, int components)
+{
+    vfs::File file;
+
+    if (!vfs::read(path, file))
+        return nullptr;
+
+    return stbi_load_from_memory(file.data(), int(file.size()), x, y, n, components);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static float* load_image_hdr(const std::string& path, int* x, int* y, int* n, int components)
+{
+    vfs::File file;
+
+    if (!vfs::read(path, file))
+        return nullptr;
+
+    return stbi_loadf_from_memory(file.data(), int(file.size()), x, y, n, components);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 size_t pixel_size_from_type(GLenum type)
 {
     if (type == GL_UNSIGNED_BYTE || type == GL_BYTE)
@@ -100,7 +142,14 @@ void Texture::unbind(uint32_t unit)
 
 void Texture::generate_mipmaps()
 {
-    glGenerateTextureMipmap(m_gl_tex);
+    Downsampler* downsampler = Downsampler::common();
+
+    // Drivers typically generate mipmaps with a pass per level, so use the single pass downsampler where the format allows.
+    // RGB formats cannot be bound as images and keep going through the driver.
+    if (downsampler && downsampler->is_supported(this))
+        downsampler->generate(this);
+    else
+        glGenerateTextureMipmap(m_gl_tex);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -427,36 +476,60 @@ Texture2D::Ptr Texture2D::create(uint32_t w, uint32_t h, uint32_t array_size, in
 // -----------------------------------------------------------------------------------------------------------------------------------
 Texture2D::Ptr Texture2D::create_from_file(std::string path, bool flip_vertical, bool srgb)
 {
-    int x, y, n;
-    stbi_set_flip_vertically_on_load(flip_vertical);
+    vfs::File file;
 
-    std::string ext = utility::file_extension(path);
+    if (!vfs::read(path, file))
+        return nullptr;
 
-    if (ext == "hdr")
-    {
-        float* data = stbi_loadf(path.c_str(), &x, &y, &n, 0);
+    utility::DecodedImage image;
+    StagingHeap*          heap = StagingHeap::common();
 
-        if (!data)
-            return nullptr;
+    if (heap)
+        heap->reclaim();
 
-        Texture2D::Ptr texture = Texture2D::create(x, y, 1, -1, 1, GL_RGB32F, GL_RGB, GL_FLOAT);
-        texture->write_data(0, 0, data);
-        texture->generate_mipmaps();
+    if (!utility::decode_image(file.data(), file.size(), utility::file_extension(path) == "hdr", false, flip_vertical, image, heap ? heap->pixel_allocator() : nullptr))
+        return nullptr;
 
-        stbi_image_free(data);
+    return create_from_image(image, srgb);
+}
 
-        return texture;
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Uploads level 0 through the staging heap, where decoded pixels already are unless it was full, and generates the rest of the
+// mip chain once it has been written. Streamed images may be written in a later frame.
+static void write_decoded_image(Texture2D::Ptr texture, const utility::DecodedImage& image, bool stream)
+{
+    StagingHeap* heap = StagingHeap::common();
+    size_t       size = size_t(image.width) * image.height * image.components * (image.hdr ? sizeof(float) : sizeof(uint8_t));
+
+    if (heap)
+    {
+        heap->upload(
+            image.pixels, size, [texture](void* data) { texture->write_data(0, 0, data); }, [texture]() { texture->generate_mipmaps(); }, stream);
     }
     else
     {
-        stbi_uc* data = stbi_load(path.c_str(), &x, &y, &n, 0);
+        texture->write_data(0, 0, image.pixels.get());
+        texture->generate_mipmaps();
+    }
+}
 
-        if (!data)
-            return nullptr;
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Texture2D::Ptr Texture2D::create_from_image(const utility::DecodedImage& image, bool srgb, bool stream)
+{
+    if (image.hdr)
+    {
+        Texture2D::Ptr texture = Texture2D::create(image.width, image.height, 1, -1, 1, GL_RGB32F, GL_RGB, GL_FLOAT);
+        write_decoded_image(texture, image, stream);
 
+        return texture;
+    }
+    else
+    {
         GLenum internal_format, format;
 
-        if (n == 1)
+        if (image.components == 1)
         {
             internal_format = GL_R8;
             format          = GL_RED;
@@ -465,7 +538,7 @@ Texture2D::Ptr Texture2D::create_from_file(std::string path, bool flip_vertical,
         {
             if (srgb)
             {
-                if (n == 4)
+                if (image.components == 4)
                 {
                     internal_format = GL_SRGB8_ALPHA8;
                     format          = GL_RGBA;
@@ -478,7 +551,7 @@ Texture2D::Ptr Texture2D::create_from_file(std::string path, bool flip_vertical,
             }
             else
             {
-                if (n == 4)
+                if (image.components == 4)
                 {
                     internal_format = GL_RGBA8;
                     format          = GL_RGBA;
@@ -491,11 +564,8 @@ Texture2D::Ptr Texture2D::create_from_file(std::string path, bool flip_vertical,
             }
         }
 
-        Texture2D::Ptr texture = Texture2D::create(x, y, 1, -1, 1, internal_format, format, GL_UNSIGNED_BYTE);
-        texture->write_data(0, 0, data);
-        texture->generate_mipmaps();
-
-        stbi_image_free(data);
+        Texture2D::Ptr texture = Texture2D::create(image.width, image.height, 1, -1, 1, internal_format, format, GL_UNSIGNED_BYTE);
+        write_decoded_image(texture, image, stream);
 
         return texture;
     }
@@ -667,10 +737,7 @@ void Texture2D::write_compressed_sub_data(int array_index, int mip_level, int x_
 
 void Texture2D::read_data(int mip_level, std::vector<uint8_t>& buffer)
 {
-    int w, h;
-    extents(mip_level, w, h);
-
-    size_t size = is_compressed(mip_level) ? compressed_size(mip_level) : w * h * m_array_size * pixel_size_from_type(m_type) * num_channels_from_internal_format(m_format);
+    size_t size = data_size(mip_level);
     buffer.resize(size);
 
     if (is_compressed(mip_level))
@@ -681,6 +748,19 @@ void Texture2D::read_data(int mip_level, std::vector<uint8_t>& buffer)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+size_t Texture2D::data_size(int mip_level)
+{
+    if (is_compressed(mip_level))
+        return compressed_size(mip_level);
+
+    int w, h;
+    extents(mip_level, w, h);
+
+    return w * h * m_array_size * pixel_size_from_type(m_type) * num_channels_from_format(m_format);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Texture2D::extents(int mip_level, int& width, int& height)
 {
     glGetTextureLevelParameteriv(m_gl_tex, mip_level, GL_TEXTURE_WIDTH, &width);
@@ -864,10 +944,7 @@ void Texture3D::write_compressed_sub_data(int slice, int mip_level, int x_offset
 
 void Texture3D::read_data(int mip_level, std::vector<uint8_t>& buffer)
 {
-    int w, h, d;
-    extents(mip_level, w, h, d);
-
-    size_t size = is_compressed(mip_level) ? compressed_size(mip_level) : w * h * d * pixel_size_from_type(m_type) * num_channels_from_internal_format(m_format);
+    size_t size = data_size(mip_level);
     buffer.resize(size);
 
     if (is_compressed(mip_level))
@@ -878,6 +955,19 @@ void Texture3D::read_data(int mip_level, std::vector<uint8_t>& buffer)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+size_t Texture3D::data_size(int mip_level)
+{
+    if (is_compressed(mip_level))
+        return compressed_size(mip_level);
+
+    int w, h, d;
+    extents(mip_level, w, h, d);
+
+    return w * h * d * pixel_size_from_type(m_type) * num_channels_from_format(m_format);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Texture3D::extents(int mip_level, int& width, int& height, int& depth)
 {
     glGetTextureLevelParameteriv(m_gl_tex, mip_level, GL_TEXTURE_WIDTH, &width);
@@ -950,84 +1040,40 @@ TextureCube::Ptr TextureCube::create(uint32_t w, uint32_t h, uint32_t array_size
 // -----------------------------------------------------------------------------------------------------------------------------------
 TextureCube::Ptr TextureCube::create_from_files(std::string path[], bool srgb)
 {
-    if (utility::file_extension(path[0]) == "hdr")
-    {
-        // Load the first image to determine format and dimensions.
-        std::string tex_path = path[0];
-
-        int    x, y, n;
-        float* data = stbi_loadf(tex_path.c_str(), &x, &y, &n, 3);
-
-        if (!data)
-            return nullptr;
-
-        GLenum internal_format, format;
-
-        internal_format = GL_RGB32F;
-        format          = GL_RGB;
-
-        TextureCube::Ptr cube = TextureCube::create(x, y, 1, -1, internal_format, format, GL_FLOAT);
-
-        cube->write_data(0, 0, 0, data);
-        stbi_image_free(data);
+    const bool       hdr  = utility::file_extension(path[0]) == "hdr";
+    StagingHeap*     heap = StagingHeap::common();
+    TextureCube::Ptr cube;
 
-        for (int i = 1; i < 6; i++)
-        {
-            tex_path = path[i];
-            data     = stbi_loadf(tex_path.c_str(), &x, &y, &n, 3);
-
-            if (!data)
-                return nullptr;
+    if (heap)
+        heap->reclaim();
 
-            cube->write_data(i, 0, 0, data);
-            stbi_image_free(data);
-        }
-
-        return cube;
-    }
-    else
+    for (int i = 0; i < 6; i++)
     {
-        // Load the first image to determine format and dimensions.
-        std::string tex_path = path[0];
-
-        int      x, y, n;
-        stbi_uc* data = stbi_load(tex_path.c_str(), &x, &y, &n, 3);
+        int   x, y, n;
+        void* data = hdr ? (void*)load_image_hdr(path[i], &x, &y, &n, 3) : (void*)load_image(path[i], &x, &y, &n, 3);
 
         if (!data)
             return nullptr;
 
-        GLenum internal_format, format;
+        std::shared_ptr<void> pixels(data, stbi_image_free);
 
-        if (srgb)
-        {
-            internal_format = GL_SRGB8;
-            format          = GL_RGB;
-        }
-        else
+        // The first image determines format and dimensions.
+        if (!cube)
         {
-            internal_format = GL_RGBA8;
-            format          = GL_RGB;
+            if (hdr)
+                cube = TextureCube::create(x, y, 1, -1, GL_RGB32F, GL_RGB, GL_FLOAT);
+            else
+                cube = TextureCube::create(x, y, 1, -1, srgb ? GL_SRGB8 : GL_RGBA8, GL_RGB, GL_UNSIGNED_BYTE);
         }
 
-        TextureCube::Ptr cube = TextureCube::create(x, y, 1, -1, internal_format, format, GL_UNSIGNED_BYTE);
-
-        cube->write_data(0, 0, 0, data);
-        stbi_image_free(data);
-
-        for (int i = 1; i < 6; i++)
-        {
-            tex_path = path[i];
-            data     = stbi_load(tex_path.c_str(), &x, &y, &n, 3);
-
-            if (!data)
-                return nullptr;
-
+        // Faces are copied into the staging heap and read from there by the driver.
+        if (heap)
+            heap->upload(pixels, size_t(x) * y * 3 * (hdr ? sizeof(float) : sizeof(uint8_t)), [cube, i](void* ptr) { cube->write_data(i, 0, 0, ptr); });
+        else
             cube->write_data(i, 0, 0, data);
-            stbi_image_free(data);
-        }
-
-        return cube;
     }
+
+    return cube;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -1156,10 +1202,7 @@ void TextureCube::write_compressed_sub_data(int face_index, int array_index, int
 
 void TextureCube::read_data(int mip_level, std::vector<uint8_t>& buffer)
 {
-    int w, h;
-    extents(mip_level, w, h);
-
-    size_t size = is_compressed(mip_level) ? compressed_size(mip_level) : w * h * 6 * m_array_size * pixel_size_from_type(m_type) * num_channels_from_internal_format(m_format);
+    size_t size = data_size(mip_level);
     buffer.resize(size);
 
     if (is_compressed(mip_level))
@@ -1170,6 +1213,19 @@ void TextureCube::read_data(int mip_level, std::vector<uint8_t>& buffer)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+size_t TextureCube::data_size(int mip_level)
+{
+    if (is_compressed(mip_level))
+        return compressed_size(mip_level);
+
+    int w, h;
+    extents(mip_level, w, h);
+
+    return w * h * 6 * m_array_size * pixel_size_from_type(m_type) * num_channels_from_format(m_format);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void TextureCube::extents(int mip_level, int& width, int& height)
 {
     glGetTextureLevelParameteriv(m_gl_tex, mip_level, GL_TEXTURE_WIDTH, &width);
@@ -1487,7 +1543,9 @@ Shader::Shader(GLenum type, std::string source) :
 {
     m_gl_shader = glCreateShader(type);
 
-    source = "#version 450 core\n" + std::string(source);
+    // Sources shared with the Vulkan backend declare their own version.
+    if (source.compare(0, 8, "#version") != 0)
+        source = "#version 450 core\n" + std::string(source);
 
     GLint  success;
     GLchar log[512];
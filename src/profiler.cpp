@@ -1,5 +1,8 @@
 #include <profiler.h>
 #include <imgui.h>
+#include <jobs.h>
+#include <allocators.h>
+#include <io.h>
 #include <macros.h>
 #include <timer.h>
 #include <stack>
@@ -63,6 +66,8 @@ struct Profiler
 #endif
 
 #if defined(DWSF_VULKAN)
+        m_backend = backend;
+
         for (int i = 0; i < BUFFER_COUNT; i++)
             m_sample_buffers[i].query_pool = vk::QueryPool::create(backend, VK_QUERY_TYPE_TIMESTAMP, MAX_SAMPLES);
 #endif
@@ -80,7 +85,7 @@ struct Profiler
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void begin_sample(std::string name
+    void begin_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                       ,
                       vk::CommandBuffer::Ptr cmd_buf
@@ -149,7 +154,7 @@ struct Profiler
 
     // -----------------------------------------------------------------------------------------------------------------------------------
 
-    void end_sample(std::string name
+    void end_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                     ,
                     vk::CommandBuffer::Ptr cmd_buf
@@ -167,7 +172,7 @@ struct Profiler
 
         auto& sample = m_sample_buffers[m_write_buffer_idx].samples[idx];
 
-        sample->name  = name;
+        // Only start samples are displayed, so end samples skip the name copy.
         sample->start = false;
 #if defined(DWSF_VULKAN)
         sample->query_index = m_sample_buffers[m_write_buffer_idx].query_index++;
@@ -296,6 +301,90 @@ struct Profiler
                 }
             }
         }
+
+        pacing_ui();
+        memory_ui();
+        io_ui();
+        worker_ui();
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void pacing_ui()
+    {
+        ImGui::Text("Pacing | %u in flight | %s latching | %.2f ms CPU wait | %.2f ms GPU idle | %.2f ms limiter", m_frames_in_flight, m_late_input_latching ? "late" : "early", m_frame_timings.cpu_wait, m_frame_timings.gpu_wait, m_frame_timings.limiter);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void memory_ui()
+    {
+        memory::FrameStats stats = memory::frame_stats();
+
+#    if defined(DWSF_TRACK_ALLOCATIONS)
+        ImGui::Text("Heap | %u allocations | %.1f KB", uint32_t(stats.allocations), stats.allocated_bytes / 1024.0f);
+#    endif
+        ImGui::Text("Frame Arena | %.1f / %.1f KB", stats.frame_arena_used / 1024.0f, stats.frame_arena_capacity / 1024.0f);
+
+#if defined(DWSF_VULKAN)
+        auto backend = m_backend.lock();
+
+        if (!backend || !backend->memory_manager())
+            return;
+
+        vk::MemoryStats memory_stats = backend->memory_manager()->stats();
+
+        for (uint32_t i = 0; i < memory_stats.heap_budgets.size(); i++)
+        {
+            const VmaBudget& budget = memory_stats.heap_budgets[i];
+            ImGui::Text("Heap %u | %.1f / %.1f MB%s", i, budget.usage / (1024.0f * 1024.0f), budget.budget / (1024.0f * 1024.0f), memory_stats.memory_budget_extension ? "" : " (estimated)");
+        }
+
+        for (uint32_t i = 0; i < vk::MEMORY_POOL_COUNT; i++)
+        {
+            const vk::MemoryPoolStats& pool = memory_stats.pools[i];
+            ImGui::Text("%s | %u allocations | %.1f / %.1f MB | %.0f%% fragmented", vk::MemoryManager::pool_name((vk::MemoryPoolType)i), pool.allocation_count, pool.allocation_bytes / (1024.0f * 1024.0f), pool.block_bytes / (1024.0f * 1024.0f), pool.fragmentation * 100.0f);
+        }
+
+        ImGui::Text("Defragmentation | %s | %u moved | %.1f KB this frame | %u over budget", memory_stats.defragmenting ? "running" : "idle", memory_stats.allocations_moved, memory_stats.bytes_moved / 1024.0f, memory_stats.over_budget_allocations);
+#endif
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    void io_ui()
+    {
+        io::Stats stats = io::stats();
+
+        ImGui::Text("I/O (%s) | %u in flight | %u peak | %u reads | %.1f MB/s", stats.io_uring ? "io_uring" : "threads", stats.in_flight, stats.max_in_flight, stats.completed, stats.throughput);
+    }
+
+    // -----------------------------------------------------------------------------------------------------------------------------------
+
+    // Samples are only recorded on the main thread, so job system workers are shown as one utilization track each.
+    void worker_ui()
+    {
+        uint32_t worker_count = jobs::worker_count();
+
+        if (worker_count < 2)
+            return;
+
+        if (ImGui::TreeNode("Workers"))
+        {
+            for (uint32_t i = 0; i < worker_count; i++)
+            {
+                jobs::WorkerStats stats = jobs::worker_stats(i);
+
+                std::string label = i == 0 ? "Main" : "Worker " + std::to_string(i);
+                std::string text  = std::to_string(stats.jobs) + " jobs | " + std::to_string(stats.steals) + " steals | " + std::to_string(stats.busy_ms) + " ms";
+
+                ImGui::ProgressBar(stats.utilization, ImVec2(150.0f, 0.0f), text.c_str());
+                ImGui::SameLine();
+                ImGui::Text("%s", label.c_str());
+            }
+
+            ImGui::TreePop();
+        }
     }
 #endif
 
@@ -306,9 +395,13 @@ struct Profiler
     Buffer              m_sample_buffers[BUFFER_COUNT];
     std::stack<Sample*> m_sample_stack;
     std::stack<bool>    m_should_pop_stack;
+    FrameTimings        m_frame_timings;
+    uint32_t            m_frames_in_flight    = 0;
+    bool                m_late_input_latching = false;
 
 #if defined(DWSF_VULKAN)
-    bool m_should_reset = true;
+    bool                       m_should_reset = true;
+    std::weak_ptr<vk::Backend> m_backend;
 #endif
 
 #ifdef WIN32
@@ -320,7 +413,7 @@ Profiler* g_profiler = nullptr;
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-ScopedProfile::ScopedProfile(std::string name
+ScopedProfile::ScopedProfile(const std::string& name
 #if defined(DWSF_VULKAN)
                              ,
                              vk::CommandBuffer::Ptr cmd_buf
@@ -373,7 +466,7 @@ void shutdown() { DW_SAFE_DELETE(g_profiler); }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void begin_sample(std::string name
+void begin_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                   ,
                   vk::CommandBuffer::Ptr cmd_buf
@@ -390,7 +483,7 @@ void begin_sample(std::string name
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void end_sample(std::string name
+void end_sample(const std::string& name
 #if defined(DWSF_VULKAN)
                 ,
                 vk::CommandBuffer::Ptr cmd_buf
@@ -415,6 +508,15 @@ void end_frame() { g_profiler->end_frame(); }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void report_frame_timings(const FrameTimings& timings, uint32_t frames_in_flight, bool late_input_latching)
+{
+    g_profiler->m_frame_timings       = timings;
+    g_profiler->m_frames_in_flight    = frames_in_flight;
+    g_profiler->m_late_input_latching = late_input_latching;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 #if defined(DWSF_IMGUI)
 void ui()
 {
@@ -0,0 +1,505 @@
+#include <readback.h>
+#include <logger.h>
+#include <macros.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace dw
+{
+Readback::Ptr Readback::m_common;
+size_t        Readback::m_common_size = 0;
+#if defined(DWSF_VULKAN)
+vk::Backend::Ptr Readback::m_common_backend;
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ReadbackRequest::~ReadbackRequest()
+{
+    if (auto readback = m_readback.lock())
+        readback->release(this);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool ReadbackRequest::is_ready()
+{
+    if (!m_ready)
+    {
+        if (auto readback = m_readback.lock())
+            readback->poll(this, false);
+    }
+
+    return m_ready;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void ReadbackRequest::wait()
+{
+    if (!m_ready)
+    {
+        if (auto readback = m_readback.lock())
+            readback->poll(this, true);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const void* ReadbackRequest::data()
+{
+    // Ranges of the ring are unmapped along with it.
+    if (!is_ready() || (!m_dedicated && m_readback.expired()))
+        return nullptr;
+
+    return m_mapped_ptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_VULKAN)
+
+// Size of a texel of the formats that can be read back, or 0 for the others.
+static size_t texel_size(VkFormat format, VkImageAspectFlags aspect_flags)
+{
+    if (aspect_flags == VK_IMAGE_ASPECT_STENCIL_BIT)
+        return format == VK_FORMAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT ? 1 : 0;
+
+    switch (format)
+    {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_UINT:
+            return 1;
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R16_SFLOAT:
+        case VK_FORMAT_R16_UNORM:
+        case VK_FORMAT_R16_UINT:
+        case VK_FORMAT_D16_UNORM:
+            return 2;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+        case VK_FORMAT_R16G16_SFLOAT:
+        case VK_FORMAT_R32_SFLOAT:
+        case VK_FORMAT_R32_UINT:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+            return 4;
+        // Copies of the depth aspect of combined formats are packed like their depth only counterparts.
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R16G16B16A16_UNORM:
+        case VK_FORMAT_R32G32_SFLOAT:
+            return 8;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+        case VK_FORMAT_R32G32B32A32_UINT:
+            return 16;
+        default:
+            return 0;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Readback::Ptr Readback::create(vk::Backend::Ptr backend, size_t size)
+{
+    return std::shared_ptr<Readback>(new Readback(backend, size));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Readback::initialize_common_resources(vk::Backend::Ptr backend, size_t size)
+{
+    m_common_backend = backend;
+    m_common_size    = size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Readback::Readback(vk::Backend::Ptr backend, size_t size) :
+    m_ranges(size), m_backend(backend)
+{
+    m_buffer = vk::Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    m_buffer->set_name("Readback Ring");
+
+    m_mapped_ptr = (uint8_t*)m_buffer->mapped_ptr();
+
+    if (!m_mapped_ptr)
+    {
+        DW_LOG_FATAL("(Vulkan) Failed to map readback ring.");
+        throw std::runtime_error("(Vulkan) Failed to map readback ring.");
+    }
+
+    // Command buffers outlive the frame they were recorded in, so they cannot come from the per-frame pools.
+    m_command_pool = vk::CommandPool::create(backend, backend->queue_family_index(vk::QUEUE_TYPE_GRAPHICS));
+    m_command_pool->set_name("Readback Command Pool");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ReadbackRequest::Ptr Readback::read(vk::Image::Ptr image, uint32_t mip_level, VkImageAspectFlags aspect_flags)
+{
+    auto         backend = m_backend.lock();
+    const size_t texel   = texel_size(image->format(), aspect_flags);
+
+    if (texel == 0)
+    {
+        DW_LOG_ERROR("(Vulkan) Readback of this image format is not supported.");
+        return nullptr;
+    }
+
+    const uint32_t width  = std::max(1u, image->width() >> mip_level);
+    const uint32_t height = std::max(1u, image->height() >> mip_level);
+    const uint32_t depth  = std::max(1u, image->depth() >> mip_level);
+
+    ReadbackRequest::Ptr request = allocate(size_t(width) * height * depth * image->array_size() * texel);
+
+    request->m_cmd_buf = vk::CommandBuffer::create(backend, m_command_pool);
+    request->m_fence   = vk::Fence::create(backend);
+
+    // Fences are created signaled.
+    VkFence fence = request->m_fence->handle();
+    vkResetFences(backend->device(), 1, &fence);
+
+    VkCommandBufferBeginInfo begin_info;
+    DW_ZERO_MEMORY(begin_info);
+
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(request->m_cmd_buf->handle(), &begin_info);
+
+    VkImageSubresourceRange subresource_range;
+    DW_ZERO_MEMORY(subresource_range);
+
+    subresource_range.aspectMask   = aspect_flags;
+    subresource_range.baseMipLevel = mip_level;
+    subresource_range.levelCount   = 1;
+    subresource_range.layerCount   = image->array_size();
+
+    VkImageLayout last_layout;
+    const bool    restore = backend->current_layout(image->handle(), last_layout) && last_layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, subresource_range);
+    backend->flush_barriers(request->m_cmd_buf);
+
+    VkBufferImageCopy copy_region;
+    DW_ZERO_MEMORY(copy_region);
+
+    copy_region.bufferOffset                = request->m_dedicated ? 0 : request->m_offset;
+    copy_region.imageSubresource.aspectMask = aspect_flags;
+    copy_region.imageSubresource.mipLevel   = mip_level;
+    copy_region.imageSubresource.layerCount = image->array_size();
+    copy_region.imageExtent.width           = width;
+    copy_region.imageExtent.height          = height;
+    copy_region.imageExtent.depth           = depth;
+
+    VkBuffer dst = request->m_dedicated ? request->m_dedicated->handle() : m_buffer->handle();
+
+    vkCmdCopyImageToBuffer(request->m_cmd_buf->handle(), image->handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, 1, &copy_region);
+
+    // Make the copy visible to the host once the fence is signaled.
+    VkMemoryBarrier2 memory_barrier;
+    DW_ZERO_MEMORY(memory_barrier);
+
+    memory_barrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    memory_barrier.srcStageMask  = VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR;
+    memory_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    memory_barrier.dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+    VkDependencyInfo dependency_info;
+    DW_ZERO_MEMORY(dependency_info);
+
+    dependency_info.sType              = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.memoryBarrierCount = 1;
+    dependency_info.pMemoryBarriers    = &memory_barrier;
+
+    vkCmdPipelineBarrier2(request->m_cmd_buf->handle(), &dependency_info);
+
+    // Hand the image back in the layout the application left it in.
+    if (restore)
+    {
+        backend->use_resource(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT, last_layout, image, subresource_range);
+        backend->flush_barriers(request->m_cmd_buf);
+    }
+
+    vkEndCommandBuffer(request->m_cmd_buf->handle());
+
+    backend->submit_graphics({ request->m_cmd_buf }, {}, {}, request->m_fence);
+
+    return request;
+}
+
+#else
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Host memory is preferred, since the pixels are only ever read by the CPU.
+#    define READBACK_STORAGE_FLAGS (GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_CLIENT_STORAGE_BIT)
+#    define READBACK_MAP_FLAGS (GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT)
+
+Readback::Ptr Readback::create(size_t size)
+{
+    return std::shared_ptr<Readback>(new Readback(size));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Readback::initialize_common_resources(size_t size)
+{
+    m_common_size = size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Readback::Readback(size_t size) :
+    m_ranges(size)
+{
+    // Coherent, so that the copy is visible to the CPU as soon as the fence behind it is signaled.
+    m_buffer = gl::Buffer::create(GL_PIXEL_PACK_BUFFER, READBACK_STORAGE_FLAGS, size);
+    m_buffer->set_name("Readback Ring");
+
+    m_mapped_ptr = (uint8_t*)m_buffer->map_range(READBACK_MAP_FLAGS, 0, size);
+
+    if (!m_mapped_ptr)
+    {
+        DW_LOG_FATAL("OPENGL: Failed to map readback ring.");
+        throw std::runtime_error("OPENGL: Failed to map readback ring.");
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ReadbackRequest::Ptr Readback::read(gl::Texture2D* texture, int mip_level)
+{
+    return read(texture, mip_level, texture->data_size(mip_level));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ReadbackRequest::Ptr Readback::read(gl::Texture3D* texture, int mip_level)
+{
+    return read(texture, mip_level, texture->data_size(mip_level));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ReadbackRequest::Ptr Readback::read(gl::TextureCube* texture, int mip_level)
+{
+    return read(texture, mip_level, texture->data_size(mip_level));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ReadbackRequest::Ptr Readback::read(gl::Texture* texture, int mip_level, size_t size)
+{
+    ReadbackRequest::Ptr request = allocate(size);
+
+    gl::Buffer::Ptr buffer = request->m_dedicated ? request->m_dedicated : m_buffer;
+    const size_t    offset = request->m_dedicated ? 0 : request->m_offset;
+
+    // With a pixel pack buffer bound the pointer is an offset into it, and the copy is queued instead of waited for.
+    buffer->bind(GL_PIXEL_PACK_BUFFER);
+
+    if (texture->is_compressed(mip_level))
+        glGetCompressedTextureImage(texture->id(), mip_level, size, (void*)offset);
+    else
+        glGetTextureImage(texture->id(), mip_level, texture->format(), texture->type(), size, (void*)offset);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    request->m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    return request;
+}
+
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Readback::~Readback()
+{
+    // Requests that outlive the ring return null from data(), except for those with a buffer of their own.
+#if defined(DWSF_VULKAN)
+    for (auto& orphan : m_orphans)
+        orphan.fence->wait_for_completion();
+#else
+    for (auto& orphan : m_orphans)
+        glDeleteSync(orphan.fence);
+
+    m_buffer->unmap();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+ReadbackRequest::Ptr Readback::allocate(size_t size)
+{
+    reclaim();
+
+    ReadbackRequest::Ptr request = std::shared_ptr<ReadbackRequest>(new ReadbackRequest());
+
+    request->m_readback = shared_from_this();
+    request->m_size     = size;
+    request->m_frame    = m_frame;
+    request->m_offset   = m_ranges.allocate(size, READBACK_RING_ALIGNMENT);
+
+    if (request->m_offset != SIZE_MAX)
+    {
+        request->m_mapped_ptr = m_mapped_ptr + request->m_offset;
+        return request;
+    }
+
+    // The ring is full or the copy is larger than it, so it goes through a buffer of its own as it would have without the ring.
+#if defined(DWSF_VULKAN)
+    request->m_dedicated  = vk::Buffer::create(m_backend.lock(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, size, VMA_MEMORY_USAGE_GPU_TO_CPU, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    request->m_mapped_ptr = (uint8_t*)request->m_dedicated->mapped_ptr();
+#else
+    request->m_dedicated  = gl::Buffer::create(GL_PIXEL_PACK_BUFFER, READBACK_STORAGE_FLAGS, size);
+    request->m_mapped_ptr = (uint8_t*)request->m_dedicated->map_range(READBACK_MAP_FLAGS, 0, size);
+#endif
+
+    return request;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Readback::poll(ReadbackRequest* request, bool wait)
+{
+#if defined(DWSF_VULKAN)
+    if (wait)
+        request->m_fence->wait_for_completion();
+    else if (!request->m_fence->is_complete())
+        return false;
+
+    request->m_cmd_buf.reset();
+    request->m_fence.reset();
+
+    if (request->m_dedicated)
+        request->m_dedicated->invalidate(0, request->m_size);
+    else
+        m_buffer->invalidate(request->m_offset, request->m_size);
+#else
+    // Flushing on the first poll makes sure the fence is eventually signaled without flushing when the copy is issued.
+    const uint64_t timeout = wait ? UINT64_MAX : 0;
+    GLenum         result  = glClientWaitSync(request->m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+
+    while (wait && result == GL_TIMEOUT_EXPIRED)
+        result = glClientWaitSync(request->m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        return false;
+
+    glDeleteSync(request->m_fence);
+    request->m_fence = nullptr;
+#endif
+
+    request->m_ready   = true;
+    request->m_latency = uint32_t(m_frame - request->m_frame);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Readback::release(ReadbackRequest* request)
+{
+#if !defined(DWSF_VULKAN)
+    if (request->m_dedicated)
+        request->m_dedicated->unmap();
+#endif
+
+    if (request->m_ready)
+    {
+        if (!request->m_dedicated)
+            m_ranges.deallocate(request->m_offset);
+
+        return;
+    }
+
+    // The copy may still be writing into the range, so it is only reused once its fence has been signaled. A dedicated buffer
+    // can go right away with OpenGL, which keeps it alive for the copy, but has to wait for the fence with Vulkan.
+#if defined(DWSF_VULKAN)
+    Orphan orphan;
+
+    orphan.offset    = request->m_dedicated ? SIZE_MAX : request->m_offset;
+    orphan.cmd_buf   = request->m_cmd_buf;
+    orphan.fence     = request->m_fence;
+    orphan.dedicated = request->m_dedicated;
+
+    m_orphans.push_back(orphan);
+#else
+    if (request->m_dedicated)
+        glDeleteSync(request->m_fence);
+    else
+        m_orphans.push_back({ request->m_offset, request->m_fence });
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Readback::reclaim()
+{
+    for (size_t i = 0; i < m_orphans.size();)
+    {
+        Orphan& orphan = m_orphans[i];
+
+#if defined(DWSF_VULKAN)
+        if (!orphan.fence->is_complete())
+#else
+        GLenum result = glClientWaitSync(orphan.fence, 0, 0);
+
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+#endif
+        {
+            i++;
+            continue;
+        }
+
+#if !defined(DWSF_VULKAN)
+        glDeleteSync(orphan.fence);
+#endif
+
+        if (orphan.offset != SIZE_MAX)
+            m_ranges.deallocate(orphan.offset);
+
+        m_orphans[i] = m_orphans.back();
+        m_orphans.pop_back();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Readback* Readback::common()
+{
+    if (!m_common && m_common_size > 0)
+    {
+#if defined(DWSF_VULKAN)
+        m_common = create(m_common_backend, m_common_size);
+#else
+        m_common = create(m_common_size);
+#endif
+    }
+
+    return m_common.get();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Readback::shutdown_common_resources()
+{
+    m_common.reset();
+    m_common_size = 0;
+#if defined(DWSF_VULKAN)
+    m_common_backend.reset();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace dw
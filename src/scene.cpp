@@ -0,0 +1,576 @@
+#include <scene.h>
+#include <jobs.h>
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+#include <float.h>
+
+// Levels with fewer nodes than this are updated on the calling thread.
+#define SCENE_PARALLEL_UPDATE_THRESHOLD 16384
+#define SCENE_UPDATE_GRAIN_SIZE 4096
+#define SCENE_BVH_LEAF_SIZE 4
+
+namespace dw
+{
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static AABB transform_aabb(const glm::mat4& transform, const AABB& aabb)
+{
+    glm::vec3 center  = (aabb.min + aabb.max) * 0.5f;
+    glm::vec3 extents = (aabb.max - aabb.min) * 0.5f;
+
+    glm::vec3 world_center  = glm::vec3(transform * glm::vec4(center, 1.0f));
+    glm::vec3 world_extents = glm::abs(glm::vec3(transform[0])) * extents.x + glm::abs(glm::vec3(transform[1])) * extents.y + glm::abs(glm::vec3(transform[2])) * extents.z;
+
+    return { world_center - world_extents, world_center + world_extents };
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static void expand_aabb(AABB& aabb, const AABB& other)
+{
+    aabb.min = glm::min(aabb.min, other.min);
+    aabb.max = glm::max(aabb.max, other.max);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static AABB empty_aabb()
+{
+    return { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Returns -1 if the box is outside the frustum, 1 if it is fully inside and 0 if it intersects the boundary.
+static int frustum_test(const Frustum& frustum, const AABB& aabb)
+{
+    glm::vec3 center  = (aabb.min + aabb.max) * 0.5f;
+    glm::vec3 extents = (aabb.max - aabb.min) * 0.5f;
+    int       result  = 1;
+
+    for (int i = 0; i < 6; i++)
+    {
+        const Plane& plane = frustum.planes[i];
+
+        float d = glm::dot(plane.n, center) + plane.d;
+        float r = glm::dot(glm::abs(plane.n), extents);
+
+        if (d + r < 0.0f)
+            return -1;
+
+        if (d - r < 0.0f)
+            result = 0;
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static bool ray_aabb(const glm::vec3& origin, const glm::vec3& inv_direction, const AABB& aabb, float max_distance, float& distance)
+{
+    glm::vec3 t0 = (aabb.min - origin) * inv_direction;
+    glm::vec3 t1 = (aabb.max - origin) * inv_direction;
+
+    glm::vec3 t_near = glm::min(t0, t1);
+    glm::vec3 t_far  = glm::max(t0, t1);
+
+    float t_enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+    float t_exit  = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, max_distance));
+
+    distance = t_enter;
+
+    return t_enter <= t_exit;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Scene::Ptr Scene::create()
+{
+    return std::shared_ptr<Scene>(new Scene());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Scene::Scene()
+{
+    m_bounds = empty_aabb();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Scene::~Scene()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t Scene::create_node(uint32_t parent, std::shared_ptr<Mesh> mesh)
+{
+    uint32_t node  = m_node_to_index.size();
+    uint32_t index = m_parents.size();
+
+    uint32_t parent_index = parent == kInvalidNode ? kInvalidNode : m_node_to_index[parent];
+
+    m_node_to_index.push_back(index);
+    m_index_to_node.push_back(node);
+
+    m_parents.push_back(parent_index);
+    m_depths.push_back(parent_index == kInvalidNode ? 0 : m_depths[parent_index] + 1);
+    m_local_positions.push_back(glm::vec3(0.0f));
+    m_local_rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    m_local_scales.push_back(glm::vec3(1.0f));
+    m_world_transforms.push_back(glm::mat4(1.0f));
+    m_world_bounds.push_back(empty_aabb());
+    m_dirty.push_back(1);
+    m_meshes.push_back(mesh);
+
+    if (mesh)
+    {
+        m_local_bounds.push_back({ mesh->min_extents(), mesh->max_extents() });
+        m_has_bounds.push_back(1);
+    }
+    else
+    {
+        m_local_bounds.push_back(empty_aabb());
+        m_has_bounds.push_back(0);
+    }
+
+    m_hierarchy_changed = true;
+
+    return node;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::set_local_transform(uint32_t node, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+    uint32_t index = m_node_to_index[node];
+
+    m_local_positions[index] = position;
+    m_local_rotations[index] = rotation;
+    m_local_scales[index]    = scale;
+    m_dirty[index]           = 1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::set_local_position(uint32_t node, const glm::vec3& position)
+{
+    uint32_t index = m_node_to_index[node];
+
+    m_local_positions[index] = position;
+    m_dirty[index]           = 1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::set_local_rotation(uint32_t node, const glm::quat& rotation)
+{
+    uint32_t index = m_node_to_index[node];
+
+    m_local_rotations[index] = rotation;
+    m_dirty[index]           = 1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::set_local_scale(uint32_t node, const glm::vec3& scale)
+{
+    uint32_t index = m_node_to_index[node];
+
+    m_local_scales[index] = scale;
+    m_dirty[index]        = 1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::set_local_bounds(uint32_t node, const glm::vec3& min_extents, const glm::vec3& max_extents)
+{
+    uint32_t index = m_node_to_index[node];
+
+    // Gaining or losing bounds changes the set of BVH items.
+    if (!m_has_bounds[index])
+        m_hierarchy_changed = true;
+
+    m_local_bounds[index] = { min_extents, max_extents };
+    m_has_bounds[index]   = 1;
+    m_dirty[index]        = 1;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t Scene::parent(uint32_t node)
+{
+    uint32_t parent_index = m_parents[m_node_to_index[node]];
+
+    return parent_index == kInvalidNode ? kInvalidNode : m_index_to_node[parent_index];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const glm::mat4& Scene::world_transform(uint32_t node)
+{
+    return m_world_transforms[m_node_to_index[node]];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const AABB& Scene::world_bounds(uint32_t node)
+{
+    return m_world_bounds[m_node_to_index[node]];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::weak_ptr<Mesh> Scene::mesh(uint32_t node)
+{
+    return m_meshes[m_node_to_index[node]];
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::update()
+{
+    if (m_hierarchy_changed)
+        sort_by_depth();
+
+    for (uint32_t level = 0; level + 1 < m_level_offsets.size(); level++)
+    {
+        uint32_t begin = m_level_offsets[level];
+        uint32_t end   = m_level_offsets[level + 1];
+        uint32_t count = end - begin;
+
+        if (count < SCENE_PARALLEL_UPDATE_THRESHOLD)
+            m_bounds_changed |= update_range(begin, end);
+        else
+        {
+            // Nodes within a level only read their parent's results, so the level can be split freely.
+            std::atomic<bool> bounds_changed(false);
+
+            jobs::parallel_for(count, SCENE_UPDATE_GRAIN_SIZE, [this, begin, &bounds_changed](uint32_t first, uint32_t last) {
+                if (update_range(begin + first, begin + last))
+                    bounds_changed.store(true, std::memory_order_relaxed);
+            });
+
+            m_bounds_changed |= bounds_changed.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Dirty flags are only cleared once every level has seen its parents' flags.
+    if (m_dirty.size() > 0)
+        memset(m_dirty.data(), 0, m_dirty.size());
+
+    if (m_hierarchy_changed)
+        build_bvh();
+    else if (m_bounds_changed)
+        refit_bvh();
+
+    m_hierarchy_changed = false;
+    m_bounds_changed    = false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Scene::update_range(uint32_t begin, uint32_t end)
+{
+    bool bounds_changed = false;
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        uint32_t parent_index = m_parents[i];
+
+        if (!m_dirty[i] && (parent_index == kInvalidNode || !m_dirty[parent_index]))
+            continue;
+
+        // Propagate to the next level.
+        m_dirty[i] = 1;
+
+        glm::mat4 local = glm::mat4_cast(m_local_rotations[i]);
+
+        local[0] *= m_local_scales[i].x;
+        local[1] *= m_local_scales[i].y;
+        local[2] *= m_local_scales[i].z;
+        local[3] = glm::vec4(m_local_positions[i], 1.0f);
+
+        if (parent_index == kInvalidNode)
+            m_world_transforms[i] = local;
+        else
+            m_world_transforms[i] = m_world_transforms[parent_index] * local;
+
+        if (m_has_bounds[i])
+        {
+            m_world_bounds[i] = transform_aabb(m_world_transforms[i], m_local_bounds[i]);
+            bounds_changed    = true;
+        }
+    }
+
+    return bounds_changed;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::sort_by_depth()
+{
+    uint32_t count     = m_parents.size();
+    uint32_t max_depth = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+        max_depth = std::max(max_depth, m_depths[i]);
+
+    // Counting sort by depth. It is stable, so the relative order within a level is preserved across updates.
+    m_level_offsets.assign(max_depth + 2, 0);
+
+    for (uint32_t i = 0; i < count; i++)
+        m_level_offsets[m_depths[i] + 1]++;
+
+    for (uint32_t level = 1; level < m_level_offsets.size(); level++)
+        m_level_offsets[level] += m_level_offsets[level - 1];
+
+    std::vector<uint32_t> old_to_new(count);
+    std::vector<uint32_t> next(m_level_offsets.begin(), m_level_offsets.end() - 1);
+
+    for (uint32_t i = 0; i < count; i++)
+        old_to_new[i] = next[m_depths[i]]++;
+
+    auto reorder = [&](auto& values) {
+        typename std::remove_reference<decltype(values)>::type sorted(values.size());
+
+        for (uint32_t i = 0; i < count; i++)
+            sorted[old_to_new[i]] = std::move(values[i]);
+
+        values.swap(sorted);
+    };
+
+    reorder(m_parents);
+    reorder(m_depths);
+    reorder(m_local_positions);
+    reorder(m_local_rotations);
+    reorder(m_local_scales);
+    reorder(m_world_transforms);
+    reorder(m_local_bounds);
+    reorder(m_world_bounds);
+    reorder(m_has_bounds);
+    reorder(m_dirty);
+    reorder(m_meshes);
+    reorder(m_index_to_node);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (m_parents[i] != kInvalidNode)
+            m_parents[i] = old_to_new[m_parents[i]];
+
+        m_node_to_index[m_index_to_node[i]] = i;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::build_bvh()
+{
+    m_bvh_nodes.clear();
+    m_bvh_items.clear();
+
+    for (uint32_t i = 0; i < m_parents.size(); i++)
+    {
+        if (m_has_bounds[i])
+            m_bvh_items.push_back(i);
+    }
+
+    m_bounds = empty_aabb();
+
+    if (m_bvh_items.size() == 0)
+        return;
+
+    // A binary tree with single item leaves has at most 2n - 1 nodes, so references into the array stay valid while building.
+    m_bvh_nodes.reserve(m_bvh_items.size() * 2);
+    m_bvh_nodes.push_back({ empty_aabb(), 0, uint32_t(m_bvh_items.size()) });
+
+    subdivide_bvh_node(0);
+
+    m_bounds = m_bvh_nodes[0].bounds;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::subdivide_bvh_node(uint32_t idx)
+{
+    BVHNode& node = m_bvh_nodes[idx];
+
+    AABB centroid_bounds = empty_aabb();
+
+    node.bounds = empty_aabb();
+
+    for (uint32_t i = node.first; i < node.first + node.count; i++)
+    {
+        const AABB& aabb     = m_world_bounds[m_bvh_items[i]];
+        glm::vec3   centroid = (aabb.min + aabb.max) * 0.5f;
+
+        expand_aabb(node.bounds, aabb);
+        expand_aabb(centroid_bounds, { centroid, centroid });
+    }
+
+    if (node.count <= SCENE_BVH_LEAF_SIZE)
+        return;
+
+    // Median split along the axis with the largest centroid spread.
+    glm::vec3 spread = centroid_bounds.max - centroid_bounds.min;
+    int       axis   = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+
+    uint32_t first      = node.first;
+    uint32_t count      = node.count;
+    uint32_t left_count = count / 2;
+
+    std::nth_element(m_bvh_items.begin() + first, m_bvh_items.begin() + first + left_count, m_bvh_items.begin() + first + count, [&](uint32_t a, uint32_t b) {
+        return m_world_bounds[a].min[axis] + m_world_bounds[a].max[axis] < m_world_bounds[b].min[axis] + m_world_bounds[b].max[axis];
+    });
+
+    uint32_t child = m_bvh_nodes.size();
+
+    node.first = child;
+    node.count = 0;
+
+    m_bvh_nodes.push_back({ empty_aabb(), first, left_count });
+    m_bvh_nodes.push_back({ empty_aabb(), first + left_count, count - left_count });
+
+    subdivide_bvh_node(child);
+    subdivide_bvh_node(child + 1);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::refit_bvh()
+{
+    // Children are always allocated after their parent, so a reverse pass sees them first.
+    for (int32_t idx = int32_t(m_bvh_nodes.size()) - 1; idx >= 0; idx--)
+    {
+        BVHNode& node = m_bvh_nodes[idx];
+
+        node.bounds = empty_aabb();
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+                expand_aabb(node.bounds, m_world_bounds[m_bvh_items[i]]);
+        }
+        else
+        {
+            expand_aabb(node.bounds, m_bvh_nodes[node.first].bounds);
+            expand_aabb(node.bounds, m_bvh_nodes[node.first + 1].bounds);
+        }
+    }
+
+    if (m_bvh_nodes.size() > 0)
+        m_bounds = m_bvh_nodes[0].bounds;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Scene::gather_instances(const Frustum& frustum, std::vector<SceneInstance>& instances)
+{
+    if (m_bvh_nodes.size() == 0)
+        return;
+
+    // Entries store the node index in the low bits and whether it is known to be fully inside in the top bit.
+    const uint32_t kInsideBit = 0x80000000;
+
+    size_t first_instance = instances.size();
+
+    m_traversal_stack.clear();
+    m_traversal_stack.push_back(0);
+
+    while (m_traversal_stack.size() > 0)
+    {
+        uint32_t entry = m_traversal_stack.back();
+        m_traversal_stack.pop_back();
+
+        const BVHNode& node   = m_bvh_nodes[entry & ~kInsideBit];
+        bool           inside = (entry & kInsideBit) != 0;
+
+        if (!inside)
+        {
+            int result = frustum_test(frustum, node.bounds);
+
+            if (result < 0)
+                continue;
+
+            inside = result > 0;
+        }
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                uint32_t index = m_bvh_items[i];
+
+                if (!inside && frustum_test(frustum, m_world_bounds[index]) < 0)
+                    continue;
+
+                if (auto mesh = m_meshes[index].lock())
+                    instances.push_back({ m_index_to_node[index], mesh.get(), m_world_transforms[index] });
+            }
+        }
+        else
+        {
+            m_traversal_stack.push_back(node.first | (inside ? kInsideBit : 0));
+            m_traversal_stack.push_back((node.first + 1) | (inside ? kInsideBit : 0));
+        }
+    }
+
+    std::stable_sort(instances.begin() + first_instance, instances.end(), [](const SceneInstance& a, const SceneInstance& b) {
+        return a.mesh < b.mesh;
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t Scene::pick(const glm::vec3& origin, const glm::vec3& direction, float& distance)
+{
+    uint32_t  closest       = kInvalidNode;
+    float     max_distance  = FLT_MAX;
+    glm::vec3 inv_direction = glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    if (m_bvh_nodes.size() == 0)
+        return kInvalidNode;
+
+    m_traversal_stack.clear();
+    m_traversal_stack.push_back(0);
+
+    while (m_traversal_stack.size() > 0)
+    {
+        const BVHNode& node = m_bvh_nodes[m_traversal_stack.back()];
+        m_traversal_stack.pop_back();
+
+        float t;
+
+        if (!ray_aabb(origin, inv_direction, node.bounds, max_distance, t))
+            continue;
+
+        if (node.count > 0)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                uint32_t index = m_bvh_items[i];
+
+                if (ray_aabb(origin, inv_direction, m_world_bounds[index], max_distance, t))
+                {
+                    max_distance = t;
+                    closest      = m_index_to_node[index];
+                }
+            }
+        }
+        else
+        {
+            m_traversal_stack.push_back(node.first);
+            m_traversal_stack.push_back(node.first + 1);
+        }
+    }
+
+    distance = max_distance;
+
+    return closest;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace dw
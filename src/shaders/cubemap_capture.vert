@@ -0,0 +1,93 @@
+#version 450
+
+// ------------------------------------------------------------------
+// Layered cubemap capture, used by HosekWilkieSkyModel and
+// EquirectangularToCubemap in the extras.
+//
+// Draws a triangle covering a face for each of the six faces in a
+// single draw call. Vulkan renders the faces as the views of a
+// multiview pass, OpenGL as instances whose layer is selected in
+// this stage with VERTEX_SHADER_LAYER defined, or by a pass-through
+// geometry shader without it. The fragment shader receives the
+// direction of the fragment, which is linear across a face.
+// ------------------------------------------------------------------
+
+#if defined(VULKAN)
+#extension GL_EXT_multiview : require
+#define CAPTURE_FACE gl_ViewIndex
+#else
+#if defined(VERTEX_SHADER_LAYER)
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+#define CAPTURE_FACE gl_InstanceID
+#endif
+
+// ------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(VULKAN)
+layout(location = 0) out vec3 FS_IN_Position;
+#elif defined(VERTEX_SHADER_LAYER)
+out vec3 FS_IN_Position;
+#else
+out vec3 GS_IN_Position;
+flat out int GS_IN_Layer;
+#define FS_IN_Position GS_IN_Position
+#endif
+
+// ------------------------------------------------------------------
+// FUNCTIONS --------------------------------------------------------
+// ------------------------------------------------------------------
+
+// Direction through a point of a face, following the face selection
+// table of the cubemap samplers.
+vec3 face_direction(int face, vec2 st)
+{
+    switch (face)
+    {
+        case 0:
+            return vec3(1.0, -st.y, -st.x);
+        case 1:
+            return vec3(-1.0, -st.y, st.x);
+        case 2:
+            return vec3(st.x, 1.0, st.y);
+        case 3:
+            return vec3(st.x, -1.0, -st.y);
+        case 4:
+            return vec3(st.x, -st.y, 1.0);
+        default:
+            return vec3(-st.x, -st.y, -1.0);
+    }
+}
+
+// ------------------------------------------------------------------
+// MAIN  ------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+#if defined(VULKAN)
+    int vertex = gl_VertexIndex;
+#else
+    int vertex = gl_VertexID;
+#endif
+
+    // Rows of both APIs start at -1 in normalized device coordinates,
+    // so they map to the rows of the faces the same way.
+    vec2 st = vec2((vertex << 1) & 2, vertex & 2) * 2.0 - 1.0;
+
+    FS_IN_Position = face_direction(int(CAPTURE_FACE), st);
+
+#if !defined(VULKAN)
+#if defined(VERTEX_SHADER_LAYER)
+    gl_Layer = gl_InstanceID;
+#else
+    GS_IN_Layer = gl_InstanceID;
+#endif
+#endif
+
+    gl_Position = vec4(st, 0.0, 1.0);
+}
+
+// ------------------------------------------------------------------
@@ -0,0 +1,62 @@
+#version 450
+
+// ------------------------------------------------------------------
+// Instanced debug draw primitives, used by DebugDraw.
+//
+// Each vertex of a unit primitive mesh is transformed by the matrix
+// of its instance. The outputs match the fragment shader of the line
+// lists, so both share it.
+// ------------------------------------------------------------------
+
+// ------------------------------------------------------------------
+// INPUTS -----------------------------------------------------------
+// ------------------------------------------------------------------
+
+layout(location = 0) in vec3 VS_IN_Position;
+layout(location = 1) in vec4 VS_IN_Transform0;
+layout(location = 2) in vec4 VS_IN_Transform1;
+layout(location = 3) in vec4 VS_IN_Transform2;
+layout(location = 4) in vec4 VS_IN_Transform3;
+layout(location = 5) in vec3 VS_IN_Color;
+
+// ------------------------------------------------------------------
+// OUTPUTS ----------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(VULKAN)
+layout(location = 0) out vec3 FS_IN_Color;
+layout(location = 1) out vec3 FS_IN_FragPos;
+#else
+out vec3 FS_IN_Color;
+out vec3 FS_IN_FragPos;
+#endif
+
+// ------------------------------------------------------------------
+// UNIFORMS ---------------------------------------------------------
+// ------------------------------------------------------------------
+
+#if defined(VULKAN)
+layout(set = 0, binding = 0) uniform CameraUniforms
+#else
+layout(std140) uniform CameraUniforms
+#endif
+{
+    mat4 viewProj;
+};
+
+// ------------------------------------------------------------------
+// MAIN  ------------------------------------------------------------
+// ------------------------------------------------------------------
+
+void main()
+{
+    mat4 transform = mat4(VS_IN_Transform0, VS_IN_Transform1, VS_IN_Transform2, VS_IN_Transform3);
+    vec4 world_pos = transform * vec4(VS_IN_Position, 1.0);
+    world_pos /= world_pos.w;
+
+    FS_IN_Color   = VS_IN_Color;
+    FS_IN_FragPos = world_pos.xyz;
+    gl_Position   = viewProj * world_pos;
+}
+
+// ------------------------------------------------------------------
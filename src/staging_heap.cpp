@@ -0,0 +1,330 @@
+#include <staging_heap.h>
+#include <logger.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace dw
+{
+StagingHeap::Ptr StagingHeap::m_common;
+std::mutex       StagingHeap::m_common_mutex;
+size_t           StagingHeap::m_common_size = 0;
+#if defined(DWSF_VULKAN)
+vk::Backend::Ptr StagingHeap::m_common_backend;
+#else
+size_t StagingHeap::m_common_upload_budget = 0;
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+#if defined(DWSF_VULKAN)
+
+StagingHeap::Ptr StagingHeap::create(vk::Backend::Ptr backend, size_t size)
+{
+    return std::shared_ptr<StagingHeap>(new StagingHeap(backend, size));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::initialize_common_resources(vk::Backend::Ptr backend, size_t size)
+{
+    m_common_backend = backend;
+    m_common_size    = size;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+StagingHeap::StagingHeap(vk::Backend::Ptr backend, size_t size) :
+    m_ranges(size)
+{
+    m_buffer = vk::Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    m_buffer->set_name("Staging Heap");
+
+    m_mapped_ptr = (uint8_t*)m_buffer->mapped_ptr();
+
+    if (!m_mapped_ptr)
+    {
+        DW_LOG_FATAL("(Vulkan) Failed to map staging heap.");
+        throw std::runtime_error("(Vulkan) Failed to map staging heap.");
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::release(size_t offset)
+{
+    // Uploads wait for their copies to complete, so nothing can still be reading from the range.
+    m_ranges.deallocate(offset);
+}
+
+#else
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+StagingHeap::Ptr StagingHeap::create(size_t size)
+{
+    return std::shared_ptr<StagingHeap>(new StagingHeap(size));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::initialize_common_resources(size_t size, size_t upload_budget)
+{
+    // Unbudgeted uploads are written from client memory, which leaves nothing for the heap to do.
+    m_common_size          = upload_budget > 0 ? size : 0;
+    m_common_upload_budget = upload_budget;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+StagingHeap::StagingHeap(size_t size) :
+    m_ranges(size)
+{
+    // Coherent, so that writes from decode jobs are visible to uploads without flushing the ranges they touched.
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    m_buffer = gl::Buffer::create(GL_PIXEL_UNPACK_BUFFER, flags, size);
+    m_buffer->set_name("Staging Heap");
+
+    m_mapped_ptr = (uint8_t*)m_buffer->map_range(flags, 0, size);
+
+    if (!m_mapped_ptr)
+    {
+        DW_LOG_FATAL("OPENGL: Failed to map staging heap.");
+        throw std::runtime_error("OPENGL: Failed to map staging heap.");
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::release(size_t offset)
+{
+    std::lock_guard<std::mutex> lock(m_retired_mutex);
+    m_retired.push_back(offset);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::reclaim()
+{
+    std::vector<size_t> retired;
+
+    {
+        std::lock_guard<std::mutex> lock(m_retired_mutex);
+        retired.swap(m_retired);
+    }
+
+    // Every upload from the retired ranges was issued before the fence.
+    if (!retired.empty())
+        m_fenced.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), retired });
+
+    // Regions are fenced in order, so the first one that is still pending ends the search. Past half of the heap, decode
+    // batches would start falling back to memory of their own, so it is worth waiting for the GPU.
+    while (!m_fenced.empty())
+    {
+        const bool wait   = m_ranges.used() > m_ranges.capacity() / 2;
+        GLenum     result = glClientWaitSync(m_fenced.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+        while (wait && result == GL_TIMEOUT_EXPIRED)
+            result = glClientWaitSync(m_fenced.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, UINT64_MAX);
+
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+            break;
+
+        glDeleteSync(m_fenced.front().fence);
+
+        for (auto offset : m_fenced.front().offsets)
+            m_ranges.deallocate(offset);
+
+        m_fenced.pop_front();
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::upload(std::shared_ptr<void> pixels, size_t size, std::function<void(void*)> write_data, std::function<void()> on_complete, bool stream)
+{
+    Upload upload = { pixels, size, write_data, on_complete };
+
+    // Uploads that are not streamed are expected to be complete on return, e.g. cube maps prefiltered right after loading.
+    if (m_upload_budget == 0 || !stream)
+        write(upload);
+    else
+    {
+        m_pending_upload_bytes += size;
+        m_uploads.push_back(upload);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::set_upload_budget(size_t bytes_per_frame)
+{
+    m_upload_budget = bytes_per_frame;
+
+    if (m_upload_budget == 0)
+        flush_uploads();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::update()
+{
+    size_t written = 0;
+
+    while (!m_uploads.empty() && (written == 0 || written + m_uploads.front().size <= m_upload_budget || m_upload_budget == 0))
+    {
+        Upload upload = std::move(m_uploads.front());
+        m_uploads.pop_front();
+
+        written += upload.size;
+        m_pending_upload_bytes -= upload.size;
+
+        write(upload);
+    }
+
+    reclaim();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::flush_uploads()
+{
+    while (!m_uploads.empty())
+    {
+        Upload upload = std::move(m_uploads.front());
+        m_uploads.pop_front();
+
+        m_pending_upload_bytes -= upload.size;
+
+        write(upload);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::write(Upload& upload)
+{
+    size_t offset = 0;
+
+    // Pixels in client memory are copied by the driver, which often waits for the GPU to do so. Copied into the heap, they
+    // are read from it asynchronously instead.
+    if (!find(upload.pixels.get(), offset))
+    {
+        std::shared_ptr<void> staged = allocate(upload.size);
+
+        if (staged)
+        {
+            memcpy(staged.get(), upload.pixels.get(), upload.size);
+            upload.pixels = staged;
+
+            find(staged.get(), offset);
+        }
+    }
+
+    if (find(upload.pixels.get(), offset))
+    {
+        m_buffer->bind();
+        upload.write_data((void*)offset);
+        m_buffer->unbind();
+    }
+    else
+        upload.write_data(upload.pixels.get());
+
+    if (upload.on_complete)
+        upload.on_complete();
+
+    // Released with the upload, and reused once the fence placed behind it by the next reclaim() has been signaled.
+    upload.pixels.reset();
+}
+
+#endif
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+StagingHeap::~StagingHeap()
+{
+#if !defined(DWSF_VULKAN)
+    for (auto& region : m_fenced)
+        glDeleteSync(region.fence);
+
+    m_buffer->unmap();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<void> StagingHeap::allocate(size_t size, size_t alignment)
+{
+    size_t offset = m_ranges.allocate(size, alignment);
+
+    if (offset == SIZE_MAX)
+        return nullptr;
+
+    std::weak_ptr<StagingHeap> heap = shared_from_this();
+
+    return std::shared_ptr<void>(m_mapped_ptr + offset, [heap, offset](void*) {
+        if (auto ptr = heap.lock())
+            ptr->release(offset);
+    });
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+utility::PixelAllocator StagingHeap::pixel_allocator()
+{
+    std::weak_ptr<StagingHeap> heap = shared_from_this();
+
+    return [heap](size_t size) -> std::shared_ptr<void> {
+        if (auto ptr = heap.lock())
+            return ptr->allocate(size);
+
+        return nullptr;
+    };
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool StagingHeap::find(const void* ptr, size_t& offset)
+{
+    const uint8_t* p = (const uint8_t*)ptr;
+
+    if (!p || p < m_mapped_ptr || p >= m_mapped_ptr + m_ranges.capacity())
+        return false;
+
+    offset = size_t(p - m_mapped_ptr);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+StagingHeap* StagingHeap::common()
+{
+    std::lock_guard<std::mutex> lock(m_common_mutex);
+
+    if (!m_common && m_common_size > 0)
+    {
+#if defined(DWSF_VULKAN)
+        m_common = create(m_common_backend, m_common_size);
+#else
+        m_common = create(m_common_size);
+        m_common->set_upload_budget(m_common_upload_budget);
+#endif
+    }
+
+    return m_common.get();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void StagingHeap::shutdown_common_resources()
+{
+    m_common.reset();
+    m_common_size = 0;
+#if defined(DWSF_VULKAN)
+    m_common_backend.reset();
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace dw
@@ -7,8 +7,8 @@ Timer::Timer()
     _start_count.QuadPart = 0;
     _end_count.QuadPart   = 0;
 #else
-    _start_count.tv_sec = _start_count.tv_usec = 0;
-    _end_count.tv_sec = _end_count.tv_usec = 0;
+    _start_count.tv_sec = _start_count.tv_nsec = 0;
+    _end_count.tv_sec = _end_count.tv_nsec = 0;
 #endif
 
     _stopped             = 0;
@@ -24,7 +24,7 @@ void Timer::start()
 #ifdef WIN32
     QueryPerformanceCounter(&_start_count);
 #else
-    gettimeofday(&_start_count, nullptr);
+    clock_gettime(CLOCK_MONOTONIC, &_start_count);
 #endif
 }
 
@@ -34,7 +34,7 @@ void Timer::stop()
 #ifdef WIN32
     QueryPerformanceCounter(&_end_count);
 #else
-    gettimeofday(&_end_count, nullptr);
+    clock_gettime(CLOCK_MONOTONIC, &_end_count);
 #endif
 }
 
@@ -54,10 +54,10 @@ double Timer::elapsed_time_microsec()
     _end_time_microsec   = _end_count.QuadPart * (1000000.0 / _frequency.QuadPart);
 #else
     if (!_stopped)
-        gettimeofday(&_end_count, nullptr);
+        clock_gettime(CLOCK_MONOTONIC, &_end_count);
 
-    _start_time_microsec = (_start_count.tv_sec * 1000000.0) + _start_count.tv_usec;
-    _end_time_microsec   = (_end_count.tv_sec * 1000000.0) + _end_count.tv_usec;
+    _start_time_microsec = (_start_count.tv_sec * 1000000.0) + _start_count.tv_nsec * 0.001;
+    _end_time_microsec   = (_end_count.tv_sec * 1000000.0) + _end_count.tv_nsec * 0.001;
 #endif
 
     return _end_time_microsec - _start_time_microsec;
@@ -1,17 +1,55 @@
 #include "utility.h"
 #include "logger.h"
+#include "vfs.h"
 
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+namespace dw
+{
+namespace utility
+{
+namespace
+{
+void* stbi_malloc_hook(size_t size);
+void* stbi_realloc_hook(void* ptr, size_t old_size, size_t new_size);
+void  stbi_free_hook(void* ptr);
+} // namespace
+} // namespace utility
+} // namespace dw
+
+// Lets decode_image() hand stb_image the memory of a pixel allocator for the buffer it returns.
+#define STBI_MALLOC(size) dw::utility::stbi_malloc_hook(size)
+#define STBI_REALLOC_SIZED(ptr, old_size, new_size) dw::utility::stbi_realloc_hook(ptr, old_size, new_size)
+#define STBI_FREE(ptr) dw::utility::stbi_free_hook(ptr)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#    include <tmmintrin.h>
+#    define DW_EXPAND_SSSE3
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define DW_EXPAND_SSE
+#endif
 
 #ifdef WIN32
 #    include <Windows.h>
+#    include <psapi.h>
 #    include <direct.h>
 #    define GetCurrentDir _getcwd
 #    define ChangeWorkingDir _chdir
 #else
 #    include <unistd.h>
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <sys/resource.h>
 #    define GetCurrentDir getcwd
 #    define ChangeWorkingDir chdir
 #endif
@@ -148,21 +186,502 @@ std::string file_name_from_path(std::string filepath)
 
 bool read_text(std::string path, std::string& out)
 {
-    std::ifstream file;
-    file.open(path);
+    vfs::File file;
+
+    if (!vfs::read(path, file))
+        return false;
+
+    // Line endings are converted like a text mode stream would on Windows, so the result does not depend on the platform.
+    const char* data  = reinterpret_cast<const char*>(file.data());
+    size_t      begin = 0;
 
-    if (file.is_open())
+    out.clear();
+    out.reserve(file.size());
+
+    for (size_t i = 0; i + 1 < file.size(); i++)
     {
-        file.seekg(0, std::ios::end);
-        out.reserve(file.tellg());
-        file.seekg(0, std::ios::beg);
-        out.assign((std::istreambuf_iterator<char>(file)),
-                   std::istreambuf_iterator<char>());
+        if (data[i] == '\r' && data[i + 1] == '\n')
+        {
+            out.append(data + begin, i - begin);
+            begin = i + 1;
+        }
+    }
 
-        return true;
+    out.append(data + begin, file.size() - begin);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MappedFile::MappedFile()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+#ifdef WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!view)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    m_file    = file;
+    m_mapping = mapping;
+    m_data    = (const uint8_t*)view;
+    m_size    = size_t(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    struct stat info;
+
+    if (fstat(fd, &info) == -1 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps the file alive, so the descriptor is not needed anymore. Holding on to it would run into the
+    // descriptor limit when many files are mapped at once.
+    ::close(fd);
+
+    if (view == MAP_FAILED)
+        return false;
+
+    m_data = (const uint8_t*)view;
+    m_size = size_t(info.st_size);
+#endif
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MappedFile::close()
+{
+#ifdef WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+
+    if (m_mapping)
+        CloseHandle(m_mapping);
+
+    if (m_file)
+        CloseHandle(m_file);
+
+    m_file    = nullptr;
+    m_mapping = nullptr;
+#else
+    if (m_data)
+        munmap((void*)m_data, m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+// Expands packed RGB texels to RGBA with an opaque alpha.
+void expand_rgb_to_rgba(const uint8_t* src, uint8_t* dst, size_t count)
+{
+    size_t i = 0;
+
+#if defined(DW_EXPAND_SSSE3)
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha   = _mm_set1_epi32(int(0xFF000000));
+
+    // Four texels per step. Each load reads 16 bytes for the 12 it uses, so the last few texels are left to the scalar loop.
+    for (; i + 6 <= count; i += 4)
+    {
+        __m128i rgb = _mm_loadu_si128((const __m128i*)(src + i * 3));
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+    }
+#elif defined(DW_EXPAND_SSE)
+    const __m128i alpha = _mm_set1_epi32(int(0xFF000000));
+
+    // Four texels per step, each read with a 32-bit load that also picks up the first byte of the next texel. That byte is
+    // replaced by the alpha, and the last texel is left to the scalar loop.
+    for (; i + 5 <= count; i += 4)
+    {
+        int32_t rgbx[4];
+
+        for (int j = 0; j < 4; j++)
+            memcpy(&rgbx[j], src + (i + j) * 3, sizeof(int32_t));
+
+        _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_loadu_si128((const __m128i*)rgbx), alpha));
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void expand_rgb_to_rgba(const float* src, float* dst, size_t count)
+{
+    size_t i = 0;
+
+#if defined(DW_EXPAND_SSSE3) || defined(DW_EXPAND_SSE)
+    const __m128 mask  = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    const __m128 alpha = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // The load also reads the first component of the next texel, so the last texel is left to the scalar loop.
+    for (; i + 1 < count; i++)
+        _mm_storeu_ps(dst + i * 4, _mm_or_ps(_mm_and_ps(_mm_loadu_ps(src + i * 3), mask), alpha));
+#endif
+
+    for (; i < count; i++)
+    {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = 1.0f;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The buffer stb_image is expected to return for the image decode_image() is decoding on this thread. The first allocation of
+// exactly that size is served by the pixel allocator, and given up again if stb_image frees or resizes it, e.g. because it was
+// an intermediate buffer after all.
+struct DecodeTarget
+{
+    size_t                size      = 0;
+    const PixelAllocator* allocator = nullptr;
+    std::shared_ptr<void> pixels;
+};
+
+thread_local DecodeTarget* g_decode_target = nullptr;
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* stbi_malloc_hook(size_t size)
+{
+    DecodeTarget* target = g_decode_target;
+
+    if (target && !target->pixels && size == target->size)
+    {
+        target->pixels = (*target->allocator)(size);
+
+        if (target->pixels)
+            return target->pixels.get();
+    }
+
+    return malloc(size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void* stbi_realloc_hook(void* ptr, size_t old_size, size_t new_size)
+{
+    DecodeTarget* target = g_decode_target;
+
+    if (!ptr)
+        return stbi_malloc_hook(new_size);
+
+    if (target && target->pixels && ptr == target->pixels.get())
+    {
+        void* moved = malloc(new_size);
+
+        if (moved)
+            memcpy(moved, ptr, std::min(old_size, new_size));
+
+        target->pixels.reset();
+
+        return moved;
     }
+
+    return realloc(ptr, new_size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void stbi_free_hook(void* ptr)
+{
+    DecodeTarget* target = g_decode_target;
+
+    if (target && target->pixels && ptr == target->pixels.get())
+        target->pixels.reset();
     else
+        free(ptr);
+}
+} // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool decode_image(const uint8_t* data, size_t size, bool hdr, bool expand_rgb, bool flip_vertical, DecodedImage& image, const PixelAllocator& allocator)
+{
+    int x, y, n;
+
+    if (!stbi_info_from_memory(data, int(size), &x, &y, &n))
+        return false;
+
+    size_t texel_count    = size_t(x) * y;
+    size_t component_size = hdr ? sizeof(float) : sizeof(uint8_t);
+    int    components     = (expand_rgb && n == 3) ? 4 : n;
+
+    // Decoded with the components of the file, into the allocator's memory when they are kept as they are. Asked for RGBA,
+    // stb_image would convert into a buffer of its own, so RGB images are expanded below instead.
+    DecodeTarget target;
+
+    if (allocator && components == n)
+    {
+        target.size      = texel_count * n * component_size;
+        target.allocator = &allocator;
+    }
+
+    stbi_set_flip_vertically_on_load_thread(flip_vertical);
+
+    g_decode_target = &target;
+
+    void* pixels;
+
+    if (hdr)
+        pixels = stbi_loadf_from_memory(data, int(size), &x, &y, &n, 0);
+    else
+        pixels = stbi_load_from_memory(data, int(size), &x, &y, &n, 0);
+
+    g_decode_target = nullptr;
+
+    if (!pixels)
         return false;
+
+    std::shared_ptr<void> decoded;
+
+    // Otherwise the pixels stay in the buffer of stb_image, e.g. when the allocator had no room left.
+    if (target.pixels && target.pixels.get() == pixels)
+        decoded = target.pixels;
+    else
+        decoded = std::shared_ptr<void>(pixels, stbi_image_free);
+
+    if (components != n)
+    {
+        size_t                dst_size = texel_count * components * component_size;
+        std::shared_ptr<void> dst      = allocator ? allocator(dst_size) : nullptr;
+
+        if (!dst)
+            dst = std::shared_ptr<void>(malloc(dst_size), free);
+
+        if (!dst)
+            return false;
+
+        if (hdr)
+            expand_rgb_to_rgba((const float*)pixels, (float*)dst.get(), texel_count);
+        else
+            expand_rgb_to_rgba((const uint8_t*)pixels, (uint8_t*)dst.get(), texel_count);
+
+        decoded = dst;
+    }
+
+    image.width      = x;
+    image.height     = y;
+    image.components = components;
+    image.hdr        = hdr;
+    image.pixels     = decoded;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+size_t peak_resident_memory()
+{
+#if defined(WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+
+    return 0;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+
+#    if defined(__APPLE__)
+    return size_t(usage.ru_maxrss);
+#    else
+    // Reported in kilobytes everywhere but macOS.
+    return size_t(usage.ru_maxrss) * 1024;
+#    endif
+#endif
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool write_png(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba)
+{
+    if (!stbi_write_png(path.c_str(), width, height, 4, rgba, width * 4))
+    {
+        DW_LOG_ERROR("Failed to write PNG: " + path);
+        return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+namespace
+{
+template <typename T>
+void write_value(std::ofstream& f, const T& value)
+{
+    f.write((const char*)&value, sizeof(T));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void write_attribute_header(std::ofstream& f, const char* name, const char* type, int32_t size)
+{
+    f.write(name, strlen(name) + 1);
+    f.write(type, strlen(type) + 1);
+    write_value(f, size);
+}
+} // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool write_exr(const std::string& path, uint32_t width, uint32_t height, const float* rgba)
+{
+    std::ofstream f(path, std::ios::binary);
+
+    if (!f.is_open())
+    {
+        DW_LOG_ERROR("Failed to open EXR for writing: " + path);
+        return false;
+    }
+
+    // Channels must be listed in alphabetical order, and pixel data is stored channel by channel within each scanline.
+    const char*    channel_names[]   = { "A", "B", "G", "R" };
+    const uint32_t channel_offsets[] = { 3, 2, 1, 0 };
+    const int32_t  kPixelTypeFloat   = 2;
+
+    write_value(f, uint32_t(20000630));
+    write_value(f, uint32_t(2));
+
+    write_attribute_header(f, "channels", "chlist", 4 * (2 + 16) + 1);
+
+    for (auto name : channel_names)
+    {
+        f.write(name, 2);
+        write_value(f, kPixelTypeFloat);
+        write_value(f, uint32_t(0));
+        write_value(f, int32_t(1));
+        write_value(f, int32_t(1));
+    }
+
+    f.put(0);
+
+    write_attribute_header(f, "compression", "compression", 1);
+    f.put(0);
+
+    int32_t window[4] = { 0, 0, int32_t(width) - 1, int32_t(height) - 1 };
+
+    write_attribute_header(f, "dataWindow", "box2i", sizeof(window));
+    f.write((const char*)window, sizeof(window));
+
+    write_attribute_header(f, "displayWindow", "box2i", sizeof(window));
+    f.write((const char*)window, sizeof(window));
+
+    write_attribute_header(f, "lineOrder", "lineOrder", 1);
+    f.put(0);
+
+    write_attribute_header(f, "pixelAspectRatio", "float", 4);
+    write_value(f, 1.0f);
+
+    write_attribute_header(f, "screenWindowCenter", "v2f", 8);
+    write_value(f, 0.0f);
+    write_value(f, 0.0f);
+
+    write_attribute_header(f, "screenWindowWidth", "float", 4);
+    write_value(f, 1.0f);
+
+    f.put(0);
+
+    // Uncompressed files store one scanline per block, preceded by a table of absolute block offsets.
+    const uint32_t line_size  = width * 4 * sizeof(float);
+    const uint64_t table_end  = uint64_t(f.tellp()) + uint64_t(height) * sizeof(uint64_t);
+    const uint64_t block_size = 2 * sizeof(int32_t) + line_size;
+
+    for (uint32_t y = 0; y < height; y++)
+        write_value(f, table_end + y * block_size);
+
+    std::vector<float> line(width * 4);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const float* src = rgba + size_t(y) * width * 4;
+
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            for (uint32_t x = 0; x < width; x++)
+                line[c * width + x] = src[x * 4 + channel_offsets[c]];
+        }
+
+        write_value(f, int32_t(y));
+        write_value(f, int32_t(line_size));
+        f.write((const char*)line.data(), line_size);
+    }
+
+    if (!f.good())
+    {
+        DW_LOG_ERROR("Failed to write EXR: " + path);
+        return false;
+    }
+
+    return true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -188,6 +707,20 @@ bool read_shader(const std::string& path, std::string& out, std::vector<std::str
     if (!utility::read_text(path, og_source))
         return false;
 
+    std::string source;
+
+    if (!preprocess_shader(path, og_source, source))
+        return false;
+
+    // A #version directive has to come first, so the defines go after it.
+    if (source.compare(0, 8, "#version") == 0)
+    {
+        size_t end = source.find('\n') + 1;
+
+        out += source.substr(0, end);
+        source.erase(0, end);
+    }
+
     if (defines.size() > 0)
     {
         for (auto define : defines)
@@ -196,7 +729,9 @@ bool read_shader(const std::string& path, std::string& out, std::vector<std::str
         out += "\n";
     }
 
-    return preprocess_shader(path, og_source, out);
+    out += source;
+
+    return true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,827 @@
+#include <vfs.h>
+#include <utility.h>
+#include <logger.h>
+#include <timer.h>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <string.h>
+
+// Identifies archive files. Bump the version whenever the layout changes.
+#define VFS_ARCHIVE_MAGIC 0x4B505744
+#define VFS_ARCHIVE_VERSION 1
+
+// Uncompressed entries start on a page boundary so that they can be handed out, and uploaded, straight from the mapping.
+#define VFS_PAGE_ALIGNMENT 4096
+#define VFS_COMPRESSED_ALIGNMENT 16
+
+#define VFS_COMPRESSION_NONE 0
+#define VFS_COMPRESSION_LZ4 1
+
+// LZ4 block format parameters. Matches need at least 4 bytes, the last 5 bytes of a block are always literals and the last
+// match has to start at least 12 bytes before the end.
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MATCH_FIND_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_BITS 16
+
+namespace dw
+{
+namespace vfs
+{
+namespace
+{
+// Fixed-size start of an archive. It is followed by the entry table, the hashed path table and the path strings, and then by
+// the entry data.
+struct ArchiveHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t slot_count;
+    uint64_t entries_offset;
+    uint64_t slots_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+};
+
+struct ArchiveEntry
+{
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t stored_size;
+    uint32_t name_offset;
+    uint32_t name_size;
+    uint32_t compression;
+    uint32_t padding;
+};
+
+struct Archive
+{
+    std::string         path;
+    std::string         root;
+    utility::MappedFile file;
+    const ArchiveEntry* entries = nullptr;
+    const uint32_t*     slots   = nullptr;
+    const char*         names   = nullptr;
+    uint32_t            entry_count;
+    uint32_t            slot_mask;
+};
+
+std::vector<std::unique_ptr<Archive>> g_archives;
+
+std::atomic<uint32_t> g_archive_reads      = { 0 };
+std::atomic<uint32_t> g_loose_reads        = { 0 };
+std::atomic<uint64_t> g_archive_bytes      = { 0 };
+std::atomic<uint64_t> g_loose_bytes        = { 0 };
+std::atomic<uint64_t> g_decompressed_bytes = { 0 };
+std::atomic<uint64_t> g_read_time          = { 0 };
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// FNV-1a, which unlike std::hash is stable across standard libraries.
+uint64_t hash_path(const std::string& path)
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    for (char c : path)
+    {
+        hash ^= uint8_t(c);
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Lexically normalizes a path: forward slashes only, no empty or '.' components, and '..' resolved where possible.
+std::string normalize_path(const std::string& path)
+{
+    std::vector<std::string> components;
+    std::string              component;
+    bool                     absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+
+    for (size_t i = 0; i <= path.size(); i++)
+    {
+        char c = i < path.size() ? path[i] : '/';
+
+        if (c != '/' && c != '\\')
+        {
+            component += c;
+            continue;
+        }
+
+        if (component == "..")
+        {
+            if (!components.empty() && components.back() != "..")
+                components.pop_back();
+            else if (!absolute)
+                components.push_back(component);
+        }
+        else if (!component.empty() && component != ".")
+            components.push_back(component);
+
+        component.clear();
+    }
+
+    std::string out = absolute ? "/" : "";
+
+    for (size_t i = 0; i < components.size(); i++)
+    {
+        if (i > 0)
+            out += "/";
+
+        out += components[i];
+    }
+
+    return out;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const ArchiveEntry* find_entry(const Archive& archive, const std::string& name, uint64_t hash)
+{
+    for (uint32_t i = uint32_t(hash) & archive.slot_mask;; i = (i + 1) & archive.slot_mask)
+    {
+        uint32_t slot = archive.slots[i];
+
+        if (slot == 0)
+            return nullptr;
+
+        const ArchiveEntry& entry = archive.entries[slot - 1];
+
+        if (entry.hash == hash && entry.name_size == name.size() && memcmp(archive.names + entry.name_offset, name.data(), name.size()) == 0)
+            return &entry;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Finds the newest mounted entry for a path, which may be relative or absolute.
+const ArchiveEntry* find_entry(const std::string& path, const Archive** owner)
+{
+    if (g_archives.empty())
+        return nullptr;
+
+    std::string normalized = normalize_path(path);
+
+    for (auto it = g_archives.rbegin(); it != g_archives.rend(); it++)
+    {
+        const Archive& archive = **it;
+        std::string    name    = normalized;
+
+        if (!name.empty() && name[0] == '/')
+        {
+            if (name.size() <= archive.root.size() || name.compare(0, archive.root.size(), archive.root) != 0 || name[archive.root.size()] != '/')
+                continue;
+
+            name = name.substr(archive.root.size() + 1);
+        }
+
+        const ArchiveEntry* entry = find_entry(archive, name, hash_path(name));
+
+        if (entry)
+        {
+            *owner = &archive;
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+inline uint32_t read_u32(const uint8_t* data)
+{
+    uint32_t value;
+    memcpy(&value, data, 4);
+    return value;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void lz4_write_length(std::vector<uint8_t>& out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        out.push_back(255);
+
+    out.push_back(uint8_t(length));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void lz4_write_sequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literal_count, size_t offset, size_t match_length)
+{
+    // The last sequence of a block only carries literals and has no match.
+    size_t match_code = match_length > 0 ? match_length - LZ4_MIN_MATCH : 0;
+
+    out.push_back(uint8_t((std::min(literal_count, size_t(15)) << 4) | std::min(match_code, size_t(15))));
+
+    if (literal_count >= 15)
+        lz4_write_length(out, literal_count - 15);
+
+    out.insert(out.end(), literals, literals + literal_count);
+
+    if (match_length == 0)
+        return;
+
+    out.push_back(uint8_t(offset));
+    out.push_back(uint8_t(offset >> 8));
+
+    if (match_code >= 15)
+        lz4_write_length(out, match_code - 15);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool lz4_read_length(const uint8_t*& data, const uint8_t* end, size_t& length)
+{
+    uint8_t value;
+
+    do
+    {
+        if (data == end)
+            return false;
+
+        value = *data++;
+        length += value;
+    } while (value == 255);
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool validate_archive(Archive& archive)
+{
+    const uint8_t* data = archive.file.data();
+    size_t         size = archive.file.size();
+
+    if (size < sizeof(ArchiveHeader))
+        return false;
+
+    ArchiveHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != VFS_ARCHIVE_MAGIC || header.version != VFS_ARCHIVE_VERSION)
+        return false;
+
+    // The slot table is a power of two with at least one free slot, so lookups of missing paths terminate.
+    if (header.slot_count == 0 || (header.slot_count & (header.slot_count - 1)) != 0 || header.slot_count <= header.entry_count)
+        return false;
+
+    if (header.entries_offset % alignof(ArchiveEntry) != 0 || header.slots_offset % alignof(uint32_t) != 0)
+        return false;
+
+    if (header.entries_offset > size || uint64_t(header.entry_count) * sizeof(ArchiveEntry) > size - header.entries_offset ||
+        header.slots_offset > size || uint64_t(header.slot_count) * sizeof(uint32_t) > size - header.slots_offset ||
+        header.names_offset > size || header.names_size > size - header.names_offset)
+        return false;
+
+    archive.entries     = reinterpret_cast<const ArchiveEntry*>(data + header.entries_offset);
+    archive.slots       = reinterpret_cast<const uint32_t*>(data + header.slots_offset);
+    archive.names       = reinterpret_cast<const char*>(data + header.names_offset);
+    archive.entry_count = header.entry_count;
+    archive.slot_mask   = header.slot_count - 1;
+
+    for (uint32_t i = 0; i < header.slot_count; i++)
+    {
+        if (archive.slots[i] > header.entry_count)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header.entry_count; i++)
+    {
+        const ArchiveEntry& entry = archive.entries[i];
+
+        if (entry.offset > size || entry.stored_size > size - entry.offset || entry.name_offset > header.names_size || entry.name_size > header.names_size - entry.name_offset)
+            return false;
+
+        if (entry.compression == VFS_COMPRESSION_NONE ? entry.stored_size != entry.size : entry.compression != VFS_COMPRESSION_LZ4)
+            return false;
+
+        // LZ4 expands each stored byte into at most 255 bytes, which bounds what a damaged entry can make read() allocate.
+        if (entry.compression == VFS_COMPRESSION_LZ4 && entry.size / 255 > entry.stored_size)
+            return false;
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool read_loose(const std::string& path, utility::MappedFile& mapping, bool& empty)
+{
+    empty = false;
+
+    if (mapping.open(path))
+        return true;
+
+    // Empty files cannot be mapped.
+    std::error_code ec;
+
+    empty = std::filesystem::is_regular_file(path, ec) && std::filesystem::file_size(path, ec) == 0 && !ec;
+
+    return empty;
+}
+} // namespace
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Greedy LZ4 block compression with a single hash table of recent positions. Ratio is close to LZ4's default level, which is
+// all an offline packer needs since decompression speed does not depend on it.
+void lz4_compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+    size_t anchor = 0;
+
+    if (size > LZ4_MATCH_FIND_LIMIT)
+    {
+        std::vector<uint32_t> table(size_t(1) << LZ4_HASH_BITS, UINT32_MAX);
+
+        size_t match_end_limit   = size - LZ4_LAST_LITERALS;
+        size_t match_start_limit = size - LZ4_MATCH_FIND_LIMIT;
+        size_t i                 = 0;
+
+        while (i <= match_start_limit)
+        {
+            uint32_t sequence  = read_u32(data + i);
+            uint32_t hash      = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+            size_t   candidate = table[hash];
+
+            table[hash] = uint32_t(i);
+
+            if (candidate == UINT32_MAX || i - candidate > LZ4_MAX_OFFSET || read_u32(data + candidate) != sequence)
+            {
+                // Skip ahead faster the longer nothing matched, which keeps incompressible data cheap.
+                i += 1 + ((i - anchor) >> 6);
+                continue;
+            }
+
+            while (i > anchor && candidate > 0 && data[i - 1] == data[candidate - 1])
+            {
+                i--;
+                candidate--;
+            }
+
+            size_t length = LZ4_MIN_MATCH;
+
+            while (i + length < match_end_limit && data[i + length] == data[candidate + length])
+                length++;
+
+            lz4_write_sequence(out, data + anchor, i - anchor, i - candidate, length);
+
+            i += length;
+            anchor = i;
+        }
+    }
+
+    lz4_write_sequence(out, data + anchor, size - anchor, 0, 0);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// Every read and write is bounds checked, so a damaged archive or cache fails instead of overrunning the output.
+bool lz4_decompress(const uint8_t* data, size_t data_size, uint8_t* destination, size_t size)
+{
+    const uint8_t* end        = data + data_size;
+    uint8_t*       out        = destination;
+    uint8_t*       output_end = destination + size;
+
+    while (data < end)
+    {
+        uint8_t token         = *data++;
+        size_t  literal_count = token >> 4;
+
+        if (literal_count == 15 && !lz4_read_length(data, end, literal_count))
+            return false;
+
+        if (literal_count > size_t(end - data) || literal_count > size_t(output_end - out))
+            return false;
+
+        memcpy(out, data, literal_count);
+        out += literal_count;
+        data += literal_count;
+
+        if (data == end)
+            break;
+
+        if (end - data < 2)
+            return false;
+
+        size_t offset = size_t(data[0]) | (size_t(data[1]) << 8);
+        data += 2;
+
+        if (offset == 0 || offset > size_t(out - destination))
+            return false;
+
+        size_t match_length = token & 15;
+
+        if (match_length == 15 && !lz4_read_length(data, end, match_length))
+            return false;
+
+        match_length += LZ4_MIN_MATCH;
+
+        if (match_length > size_t(output_end - out))
+            return false;
+
+        const uint8_t* match = out - offset;
+
+        if (offset >= match_length)
+            memcpy(out, match, match_length);
+        else
+        {
+            // Overlapping matches repeat the last offset bytes.
+            for (size_t i = 0; i < match_length; i++)
+                out[i] = match[i];
+        }
+
+        out += match_length;
+    }
+
+    return out == output_end;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+File::File()
+{
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+File::~File()
+{
+    close();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+File::File(File&& other)
+{
+    *this = std::move(other);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+File& File::operator=(File&& other)
+{
+    if (this != &other)
+    {
+        close();
+
+        // Moving the buffer keeps its storage, so m_data stays valid for every kind of file.
+        m_data         = other.m_data;
+        m_size         = other.m_size;
+        m_open         = other.m_open;
+        m_from_archive = other.m_from_archive;
+        m_buffer       = std::move(other.m_buffer);
+        m_mapping      = std::move(other.m_mapping);
+
+        other.m_data         = nullptr;
+        other.m_size         = 0;
+        other.m_open         = false;
+        other.m_from_archive = false;
+    }
+
+    return *this;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void File::close()
+{
+    m_mapping.reset();
+    m_buffer.clear();
+    m_buffer.shrink_to_fit();
+
+    m_data         = nullptr;
+    m_size         = 0;
+    m_open         = false;
+    m_from_archive = false;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool mount(const std::string& archive_path)
+{
+    std::unique_ptr<Archive> archive(new Archive());
+
+    if (!archive->file.open(archive_path))
+    {
+        DW_LOG_ERROR("Failed to open archive: " + archive_path);
+        return false;
+    }
+
+    if (!validate_archive(*archive))
+    {
+        DW_LOG_ERROR("Invalid archive: " + archive_path);
+        return false;
+    }
+
+    archive->path = archive_path;
+    archive->root = normalize_path(utility::current_working_directory());
+
+    DW_LOG_INFO("Mounted archive " + archive_path + " with " + std::to_string(archive->entry_count) + " entries.");
+
+    g_archives.push_back(std::move(archive));
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void unmount_all()
+{
+    g_archives.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool exists(const std::string& path)
+{
+    const Archive* archive = nullptr;
+
+    if (find_entry(path, &archive))
+        return true;
+
+    std::error_code ec;
+
+    return std::filesystem::is_regular_file(path, ec);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool read_archived(const std::string& path, File& file)
+{
+    Timer timer;
+
+    timer.start();
+
+    file.close();
+
+    const Archive*      archive = nullptr;
+    const ArchiveEntry* entry   = find_entry(path, &archive);
+
+    if (!entry)
+        return false;
+
+    const uint8_t* stored = archive->file.data() + entry->offset;
+
+    if (entry->compression == VFS_COMPRESSION_NONE)
+        file.m_data = stored;
+    else
+    {
+        file.m_buffer.resize(entry->size);
+
+        if (!lz4_decompress(stored, entry->stored_size, file.m_buffer.data(), entry->size))
+        {
+            DW_LOG_ERROR("Corrupt archive entry " + path + " in " + archive->path);
+            file.close();
+            return false;
+        }
+
+        file.m_data = file.m_buffer.data();
+        g_decompressed_bytes += entry->size;
+    }
+
+    file.m_size         = entry->size;
+    file.m_open         = true;
+    file.m_from_archive = true;
+
+    g_archive_reads++;
+    g_archive_bytes += entry->size;
+    g_read_time += uint64_t(timer.elapsed_time_microsec());
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool read(const std::string& path, File& file)
+{
+    if (read_archived(path, file))
+        return true;
+
+    Timer timer;
+
+    timer.start();
+
+    std::unique_ptr<utility::MappedFile> mapping(new utility::MappedFile());
+    bool                                 empty = false;
+
+    if (!read_loose(path, *mapping, empty))
+        return false;
+
+    if (!empty)
+    {
+        file.m_data    = mapping->data();
+        file.m_size    = mapping->size();
+        file.m_mapping = std::move(mapping);
+    }
+
+    file.m_open = true;
+
+    g_loose_reads++;
+    g_loose_bytes += file.m_size;
+    g_read_time += uint64_t(timer.elapsed_time_microsec());
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Stats stats()
+{
+    Stats stats;
+
+    stats.archive_reads      = g_archive_reads;
+    stats.loose_reads        = g_loose_reads;
+    stats.archive_bytes      = g_archive_bytes;
+    stats.loose_bytes        = g_loose_bytes;
+    stats.decompressed_bytes = g_decompressed_bytes;
+    stats.read_time          = double(g_read_time) / 1000.0;
+
+    return stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool write_archive(const std::string& archive_path, const std::string& root_directory, bool compress)
+{
+    struct PackedFile
+    {
+        std::string  name;
+        std::string  path;
+        ArchiveEntry entry;
+    };
+
+    std::error_code         ec;
+    std::vector<PackedFile> files;
+
+    for (auto it = std::filesystem::recursive_directory_iterator(root_directory, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+    {
+        std::error_code entry_ec;
+
+        // Skip the archive itself when it is written into the directory being packed.
+        if (!it->is_regular_file(entry_ec) || std::filesystem::equivalent(it->path(), archive_path, entry_ec))
+            continue;
+
+        PackedFile file;
+
+        file.path = it->path().string();
+        file.name = normalize_path(it->path().lexically_relative(root_directory).generic_string());
+
+        files.push_back(std::move(file));
+    }
+
+    if (ec)
+    {
+        DW_LOG_ERROR("Failed to list files in " + root_directory + ": " + ec.message());
+        return false;
+    }
+
+    // Sorted so that the same directory always packs into the same archive.
+    std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) { return a.name < b.name; });
+
+    uint32_t slot_count = 1;
+
+    while (slot_count <= files.size() * 2)
+        slot_count *= 2;
+
+    ArchiveHeader header = {};
+
+    header.magic          = VFS_ARCHIVE_MAGIC;
+    header.version        = VFS_ARCHIVE_VERSION;
+    header.entry_count    = uint32_t(files.size());
+    header.slot_count     = slot_count;
+    header.entries_offset = sizeof(ArchiveHeader);
+    header.slots_offset   = header.entries_offset + files.size() * sizeof(ArchiveEntry);
+    header.names_offset   = header.slots_offset + slot_count * sizeof(uint32_t);
+
+    std::vector<uint32_t> slots(slot_count, 0);
+    std::string           names;
+
+    for (uint32_t i = 0; i < files.size(); i++)
+    {
+        ArchiveEntry& entry = files[i].entry;
+
+        entry             = {};
+        entry.hash        = hash_path(files[i].name);
+        entry.name_offset = uint32_t(names.size());
+        entry.name_size   = uint32_t(files[i].name.size());
+
+        names += files[i].name;
+
+        uint32_t slot = uint32_t(entry.hash) & (slot_count - 1);
+
+        while (slots[slot] != 0)
+            slot = (slot + 1) & (slot_count - 1);
+
+        slots[slot] = i + 1;
+    }
+
+    header.names_size = names.size();
+
+    std::string temp_path = archive_path + ".tmp";
+    FILE*       f         = fopen(temp_path.c_str(), "wb");
+
+    if (!f)
+    {
+        DW_LOG_ERROR("Failed to create archive: " + archive_path);
+        return false;
+    }
+
+    // The entry table is only known once every file has been compressed, so it is written last, over this placeholder.
+    std::vector<ArchiveEntry> placeholder(files.size());
+
+    bool     written  = fwrite(&header, sizeof(header), 1, f) == 1;
+    uint64_t position = sizeof(header);
+
+    written = written && fwrite(placeholder.data(), sizeof(ArchiveEntry), placeholder.size(), f) == placeholder.size();
+    written = written && fwrite(slots.data(), sizeof(uint32_t), slots.size(), f) == slots.size();
+    written = written && fwrite(names.data(), 1, names.size(), f) == names.size();
+    position += files.size() * sizeof(ArchiveEntry) + slots.size() * sizeof(uint32_t) + names.size();
+
+    // Files are mapped, compressed and written one at a time, so packing only holds a single file in memory.
+    std::vector<uint8_t> padding(VFS_PAGE_ALIGNMENT, 0);
+    std::vector<uint8_t> compressed;
+    uint64_t             raw_size = 0;
+
+    for (auto& file : files)
+    {
+        if (!written)
+            break;
+
+        utility::MappedFile mapping;
+        bool                empty = false;
+
+        if (!read_loose(file.path, mapping, empty))
+        {
+            DW_LOG_ERROR("Failed to read " + file.path);
+            written = false;
+            break;
+        }
+
+        file.entry.size        = mapping.size();
+        file.entry.stored_size = mapping.size();
+        file.entry.compression = VFS_COMPRESSION_NONE;
+
+        const uint8_t* stored = mapping.data();
+
+        if (compress && mapping.size() > 0 && mapping.size() < UINT32_MAX)
+        {
+            // The compressor appends, and the buffer is reused across files.
+            compressed.clear();
+            lz4_compress(mapping.data(), mapping.size(), compressed);
+
+            if (compressed.size() <= mapping.size() - mapping.size() / 8)
+            {
+                file.entry.stored_size = compressed.size();
+                file.entry.compression = VFS_COMPRESSION_LZ4;
+                stored                 = compressed.data();
+            }
+        }
+
+        uint64_t alignment = file.entry.compression == VFS_COMPRESSION_NONE ? VFS_PAGE_ALIGNMENT : VFS_COMPRESSED_ALIGNMENT;
+
+        file.entry.offset = (position + alignment - 1) / alignment * alignment;
+
+        written = fwrite(padding.data(), 1, size_t(file.entry.offset - position), f) == file.entry.offset - position;
+        written = written && (file.entry.stored_size == 0 || fwrite(stored, 1, size_t(file.entry.stored_size), f) == file.entry.stored_size);
+
+        position = file.entry.offset + file.entry.stored_size;
+        raw_size += file.entry.size;
+    }
+
+    if (written && fseek(f, long(header.entries_offset), SEEK_SET) == 0)
+    {
+        for (const auto& file : files)
+            written = written && fwrite(&file.entry, sizeof(ArchiveEntry), 1, f) == 1;
+    }
+    else
+        written = false;
+
+    written = fclose(f) == 0 && written;
+
+    if (written)
+        std::filesystem::rename(temp_path, archive_path, ec);
+
+    if (!written || ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        DW_LOG_ERROR("Failed to write archive: " + archive_path);
+        return false;
+    }
+
+    DW_LOG_INFO("Packed " + std::to_string(files.size()) + " files from " + root_directory + " into " + archive_path + ": " + std::to_string(raw_size / 1048576.0) + " MB -> " + std::to_string(position / 1048576.0) + " MB.");
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+} // namespace vfs
+} // namespace dw
@@ -1,9 +1,13 @@
 #include <vk.h>
 #include <logger.h>
+#include <allocators.h>
 #include <macros.h>
 #include <fstream>
 #include <glm.hpp>
 #include <utility.h>
+#include <vfs.h>
+#include <downsampler.h>
+#include <staging_heap.h>
 #include "aftermath_callbacks.h"
 
 #define VMA_IMPLEMENTATION
@@ -15,7 +19,6 @@
 #include <GLFW/glfw3.h>
 #include <algorithm>
 
-#define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 #include <GFSDK_Aftermath_GpuCrashDump.h>
@@ -136,56 +139,51 @@ Object::Object(Backend::Ptr backend) :
 
 Image::Ptr Image::create_from_file(Backend::Ptr backend, std::string path, bool flip_vertical, bool srgb)
 {
-    int x, y, n;
-    stbi_set_flip_vertically_on_load(flip_vertical);
+    vfs::File file;
 
-    std::string ext = utility::file_extension(path);
+    if (!vfs::read(path, file))
+        return nullptr;
 
-    if (ext == "hdr")
-    {
-        float* data = stbi_loadf(path.c_str(), &x, &y, &n, 4);
+    utility::DecodedImage image;
+    StagingHeap*          heap = StagingHeap::common();
+
+    if (!utility::decode_image(file.data(), file.size(), utility::file_extension(path) == "hdr", true, flip_vertical, image, heap ? heap->pixel_allocator() : nullptr))
+        return nullptr;
 
-        if (!data)
-            return nullptr;
+    return create_from_image(backend, image, srgb);
+}
 
-        Image::Ptr image = std::shared_ptr<Image>(new Image(backend, VK_IMAGE_TYPE_2D, (uint32_t)x, (uint32_t)y, 1, 0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, x * y * sizeof(float) * 4, data));
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        stbi_image_free(data);
+Image::Ptr Image::create_from_image(Backend::Ptr backend, const utility::DecodedImage& image, bool srgb)
+{
+    VkFormat format;
+    size_t   size = size_t(image.width) * image.height * image.components;
 
-        return image;
+    if (image.hdr)
+    {
+        format = VK_FORMAT_R32G32B32A32_SFLOAT;
+        size *= sizeof(float);
     }
+    else if (image.components == 1)
+        format = VK_FORMAT_R8_UNORM;
     else
     {
-        stbi_uc* data = stbi_load(path.c_str(), &x, &y, &n, 0);
-
-        if (!data)
-            return nullptr;
-
-        if (n == 3)
-        {
-            stbi_image_free(data);
-            data = stbi_load(path.c_str(), &x, &y, &n, 4);
-            n    = 4;
-        }
-
-        VkFormat format;
-
-        if (n == 1)
-            format = VK_FORMAT_R8_UNORM;
+        if (srgb)
+            format = VK_FORMAT_R8G8B8A8_SRGB;
         else
-        {
-            if (srgb)
-                format = VK_FORMAT_R8G8B8A8_SRGB;
-            else
-                format = VK_FORMAT_R8G8B8A8_UNORM;
-        }
+            format = VK_FORMAT_R8G8B8A8_UNORM;
+    }
 
-        Image::Ptr image = std::shared_ptr<Image>(new Image(backend, VK_IMAGE_TYPE_2D, (uint32_t)x, (uint32_t)y, 1, 0, 1, format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, x * y * n, data));
+    VkImageUsageFlags  usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    VkImageCreateFlags flags = 0;
 
-        stbi_image_free(data);
+    // Let the mip chain be generated in a single compute dispatch rather than with a blit per level. Images without a chain
+    // and formats the downsampler cannot write keep their plain usage.
+    if (Downsampler::common() && std::max(image.width, image.height) > 1)
+        Downsampler::common()->is_format_supported(format, &usage, &flags);
 
-        return image;
-    }
+    return std::shared_ptr<Image>(new Image(backend, VK_IMAGE_TYPE_2D, (uint32_t)image.width, (uint32_t)image.height, 1, 0, 1, format, VMA_MEMORY_USAGE_GPU_ONLY, usage, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_UNDEFINED, size, image.pixels.get(), flags));
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -237,7 +235,19 @@ Image::Image(Backend::Ptr backend, VkImageType type, uint32_t width, uint32_t he
     alloc_create_info.usage = memory_usage;
     alloc_create_info.flags = (memory_usage == VMA_MEMORY_USAGE_CPU_ONLY || memory_usage == VMA_MEMORY_USAGE_GPU_TO_CPU) ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0;
 
-    if (vmaCreateImage(m_vma_allocator, &image_info, &alloc_create_info, &m_vk_image, &m_vma_allocation, &alloc_info) != VK_SUCCESS)
+    MemoryManager* manager = backend->memory_manager();
+    VkResult       result;
+
+    auto create_image = [&](const VmaAllocationCreateInfo& info) {
+        return vmaCreateImage(m_vma_allocator, &image_info, &info, &m_vk_image, &m_vma_allocation, &alloc_info);
+    };
+
+    if (manager)
+        m_memory_pool = manager->allocate(manager->classify(image_info, memory_usage), alloc_create_info, create_image, result);
+    else
+        result = create_image(alloc_create_info);
+
+    if (result != VK_SUCCESS)
     {
         DW_LOG_FATAL("(Vulkan) Failed to create Image.");
         throw std::runtime_error("(Vulkan) Failed to create Image.");
@@ -266,17 +276,89 @@ Image::Image(Backend::Ptr backend, VkImage image, VkImageType type, uint32_t wid
 
 Image::~Image()
 {
+    // The downsampler's views have to go before the image.
+    m_downsample_target.reset();
+
+    // Only allocations in the pools are defragmented.
+    if (m_memory_pool != MEMORY_POOL_DEFAULT)
+    {
+        auto backend = m_vk_backend.lock();
+
+        // A move in flight frees the allocation when its pass ends.
+        if (backend && backend->memory_manager() && backend->memory_manager()->release(m_vma_allocation))
+            return;
+    }
+
     if (m_vma_allocator && m_vma_allocation)
         vmaDestroyImage(m_vma_allocator, m_vk_image, m_vma_allocation);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+void Image::set_movable(bool movable, std::function<void()> on_relocated)
+{
+    auto backend = m_vk_backend.lock();
+
+    MemoryManager* manager = backend->memory_manager();
+
+    if (!manager || !m_vma_allocation)
+        return;
+
+    // Render targets are written every frame.
+    assert(!movable || !(m_usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)));
+
+    if (movable)
+    {
+        MemoryManager::Movable resource;
+
+        resource.image        = this;
+        resource.on_relocated = on_relocated;
+
+        manager->register_movable(m_vma_allocation, resource);
+    }
+    else
+        manager->unregister_movable(m_vma_allocation);
+
+    m_movable = movable;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Image::relocate(VkImage image, const VmaAllocationInfo& info, std::vector<VkImageView>& retired_views, std::vector<std::shared_ptr<DownsampleTarget>>& retired_targets)
+{
+    m_vk_image         = image;
+    m_vk_device_memory = info.deviceMemory;
+
+    if (m_mapped_ptr)
+        m_mapped_ptr = info.pMappedData;
+
+    // Created again on the next mip generation.
+    if (m_downsample_target)
+        retired_targets.push_back(std::move(m_downsample_target));
+
+    std::lock_guard<std::mutex> lock(m_views_mutex);
+
+    for (auto view : m_views)
+        retired_views.push_back(view->relocate(image));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Image::upload_data(int array_index, int mip_level, void* data, size_t size, VkImageLayout dst_layout)
 {
+    assert(!m_movable);
+
     auto backend = m_vk_backend.lock();
 
-    Buffer::Ptr staging = Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT, data);
+    StagingHeap* heap          = StagingHeap::created_common();
+    size_t       buffer_offset = 0;
+    Buffer::Ptr  staging;
+
+    // Pixels decoded straight into the staging heap are copied from where they are.
+    if (heap && heap->find(data, buffer_offset))
+        staging = heap->buffer();
+    else
+        staging = Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT, data);
 
     VkBufferImageCopy buffer_copy_region;
     DW_ZERO_MEMORY(buffer_copy_region);
@@ -288,7 +370,7 @@ void Image::upload_data(int array_index, int mip_level, void* data, size_t size,
     buffer_copy_region.imageExtent.width               = m_width;
     buffer_copy_region.imageExtent.height              = m_height;
     buffer_copy_region.imageExtent.depth               = 1;
-    buffer_copy_region.bufferOffset                    = 0;
+    buffer_copy_region.bufferOffset                    = buffer_offset;
 
     VkImageSubresourceRange subresource_range;
     DW_ZERO_MEMORY(subresource_range);
@@ -326,6 +408,17 @@ void Image::upload_data(int array_index, int mip_level, void* data, size_t size,
 
 void Image::generate_mipmaps(std::shared_ptr<CommandBuffer> cmd_buf, VkImageLayout dst_layout, VkImageAspectFlags aspect_flags, VkFilter filter)
 {
+    assert(!m_movable);
+
+    Downsampler* downsampler = Downsampler::common();
+
+    // Images the downsampler can write are reduced in a single dispatch instead of a barrier and blit per level and layer.
+    if (downsampler && aspect_flags == VK_IMAGE_ASPECT_COLOR_BIT && filter == VK_FILTER_LINEAR && downsampler->is_supported(this))
+    {
+        downsampler->generate(cmd_buf, this, DOWNSAMPLE_FILTER_BOX, dst_layout);
+        return;
+    }
+
     auto backend = m_vk_backend.lock();
 
     VkImageSubresourceRange initial_subresource_range;
@@ -409,11 +502,17 @@ void Image::generate_mipmaps(VkImageLayout dst_layout, VkImageAspectFlags aspect
 
     CommandBuffer::Ptr cmd_buf = backend->allocate_graphics_command_buffer(true);
 
+    bool had_downsample_target = m_downsample_target != nullptr;
+
     generate_mipmaps(cmd_buf, dst_layout, aspect_flags, filter);
 
     vkEndCommandBuffer(cmd_buf->handle());
 
     backend->flush_graphics({ cmd_buf });
+
+    // Views set up for a one-off generation are not worth keeping for the lifetime of the image.
+    if (!had_downsample_target)
+        m_downsample_target.reset();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -434,9 +533,9 @@ ImageView::Ptr ImageView::create(Backend::Ptr backend, Image::Ptr image, VkImage
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 ImageView::ImageView(Backend::Ptr backend, Image::Ptr image, VkImageViewType view_type, VkImageAspectFlags aspect_flags, uint32_t base_mip_level, uint32_t level_count, uint32_t base_array_layer, uint32_t layer_count) :
-    Object(backend)
+    Object(backend), m_image(image)
 {
-    VkImageViewCreateInfo info;
+    VkImageViewCreateInfo& info = m_vk_info;
     DW_ZERO_MEMORY(info);
 
     info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -454,17 +553,43 @@ ImageView::ImageView(Backend::Ptr backend, Image::Ptr image, VkImageViewType vie
         DW_LOG_FATAL("(Vulkan) Failed to create Image View.");
         throw std::runtime_error("(Vulkan) Failed to create Image View.");
     }
+
+    std::lock_guard<std::mutex> lock(image->m_views_mutex);
+    image->m_views.push_back(this);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 ImageView::~ImageView()
 {
+    if (auto image = m_image.lock())
+    {
+        std::lock_guard<std::mutex> lock(image->m_views_mutex);
+        image->m_views.erase(std::remove(image->m_views.begin(), image->m_views.end(), this), image->m_views.end());
+    }
+
     vkDestroyImageView(m_vk_device, m_vk_image_view, nullptr);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+VkImageView ImageView::relocate(VkImage image)
+{
+    VkImageView old_view = m_vk_image_view;
+
+    m_vk_info.image = image;
+
+    if (vkCreateImageView(m_vk_device, &m_vk_info, nullptr, &m_vk_image_view) != VK_SUCCESS)
+    {
+        DW_LOG_FATAL("(Vulkan) Failed to create Image View.");
+        throw std::runtime_error("(Vulkan) Failed to create Image View.");
+    }
+
+    return old_view;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void ImageView::set_name(const std::string& name)
 {
     auto backend = m_vk_backend.lock();
@@ -543,109 +668,1142 @@ Buffer::Buffer(Backend::Ptr backend, VkBufferUsageFlags usage, size_t size, size
     alloc_create_info.memoryTypeBits = 0;
     alloc_create_info.pool           = VK_NULL_HANDLE;
 
-    if (alignment == 0)
+    MemoryManager* manager = backend->memory_manager();
+    VkResult       result;
+
+    auto create_buffer = [&](const VmaAllocationCreateInfo& info) {
+        if (alignment == 0)
+            return vmaCreateBuffer(m_vma_allocator, &buffer_info, &info, &m_vk_buffer, &m_vma_allocation, &vma_alloc_info);
+        else
+            return vmaCreateBufferWithAlignment(m_vma_allocator, &buffer_info, &info, alignment, &m_vk_buffer, &m_vma_allocation, &vma_alloc_info);
+    };
+
+    if (manager)
+        m_memory_pool = manager->allocate(manager->classify(buffer_info, memory_usage), alloc_create_info, create_buffer, result);
+    else
+        result = create_buffer(alloc_create_info);
+
+    if (result != VK_SUCCESS)
     {
-        if (vmaCreateBuffer(m_vma_allocator, &buffer_info, &alloc_create_info, &m_vk_buffer, &m_vma_allocation, &vma_alloc_info) != VK_SUCCESS)
-        {
-            DW_LOG_FATAL("(Vulkan) Failed to create Buffer.");
-            throw std::runtime_error("(Vulkan) Failed to create Buffer.");
-        }
+        DW_LOG_FATAL("(Vulkan) Failed to create Buffer.");
+        throw std::runtime_error("(Vulkan) Failed to create Buffer.");
+    }
+
+    m_vk_device_memory = vma_alloc_info.deviceMemory;
+
+    if (create_flags & VMA_ALLOCATION_CREATE_MAPPED_BIT)
+        m_mapped_ptr = vma_alloc_info.pMappedData;
+
+    if (data)
+        upload_data(data, size, 0);
+
+    VkBufferDeviceAddressInfoKHR address_info;
+    DW_ZERO_MEMORY(address_info);
+
+    address_info.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR;
+    address_info.buffer = m_vk_buffer;
+
+    if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) == VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
+        m_device_address = vkGetBufferDeviceAddress(backend->device(), &address_info);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+Buffer::~Buffer()
+{
+    // Only allocations in the pools are defragmented.
+    if (m_memory_pool != MEMORY_POOL_DEFAULT)
+    {
+        auto backend = m_vk_backend.lock();
+
+        // A move in flight frees the allocation when its pass ends.
+        if (backend && backend->memory_manager() && backend->memory_manager()->release(m_vma_allocation))
+            return;
+    }
+
+    vmaDestroyBuffer(m_vma_allocator, m_vk_buffer, m_vma_allocation);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Buffer::set_movable(bool movable, std::function<void()> on_relocated)
+{
+    auto backend = m_vk_backend.lock();
+
+    MemoryManager* manager = backend->memory_manager();
+
+    if (!manager || !m_vma_allocation)
+        return;
+
+    // Mapped buffers can be written from the CPU at any time.
+    assert(!movable || !m_mapped_ptr);
+
+    if (movable)
+    {
+        MemoryManager::Movable resource;
+
+        resource.buffer       = this;
+        resource.on_relocated = on_relocated;
+
+        manager->register_movable(m_vma_allocation, resource);
+    }
+    else
+        manager->unregister_movable(m_vma_allocation);
+
+    m_movable = movable;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Buffer::relocate(VkBuffer buffer, const VmaAllocationInfo& info)
+{
+    m_vk_buffer        = buffer;
+    m_vk_device_memory = info.deviceMemory;
+
+    if (m_mapped_ptr)
+        m_mapped_ptr = info.pMappedData;
+
+    if (m_device_address)
+    {
+        VkBufferDeviceAddressInfoKHR address_info;
+        DW_ZERO_MEMORY(address_info);
+
+        address_info.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR;
+        address_info.buffer = m_vk_buffer;
+
+        m_device_address = vkGetBufferDeviceAddress(m_vk_device, &address_info);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Buffer::set_name(const std::string& name)
+{
+    auto backend = m_vk_backend.lock();
+    utilities::set_object_name(backend->device(), (uint64_t)m_vk_buffer, name, VK_OBJECT_TYPE_BUFFER);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Buffer::upload_data(void* data, size_t size, size_t offset)
+{
+    assert(!m_movable);
+
+    auto backend = m_vk_backend.lock();
+
+    if (m_vma_memory_usage == VMA_MEMORY_USAGE_GPU_ONLY)
+    {
+        // Create VMA_MEMORY_USAGE_CPU_ONLY staging buffer and perfom Buffer-to-Buffer copy
+        Buffer::Ptr staging = Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT, data);
+
+        CommandBuffer::Ptr cmd_buf = backend->allocate_graphics_command_buffer();
+
+        VkCommandBufferBeginInfo begin_info;
+        DW_ZERO_MEMORY(begin_info);
+
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        vkBeginCommandBuffer(cmd_buf->handle(), &begin_info);
+
+        VkBufferCopy copy_region;
+        DW_ZERO_MEMORY(copy_region);
+
+        copy_region.dstOffset = offset;
+        copy_region.size      = size;
+
+        vkCmdCopyBuffer(cmd_buf->handle(), staging->handle(), m_vk_buffer, 1, &copy_region);
+
+        vkEndCommandBuffer(cmd_buf->handle());
+
+        backend->flush_graphics({ cmd_buf });
     }
     else
     {
-        if (vmaCreateBufferWithAlignment(m_vma_allocator, &buffer_info, &alloc_create_info, alignment, &m_vk_buffer, &m_vma_allocation, &vma_alloc_info) != VK_SUCCESS)
+        if (!m_mapped_ptr)
+            vkMapMemory(backend->device(), m_vk_device_memory, 0, size, 0, &m_mapped_ptr);
+
+        memcpy(m_mapped_ptr, data, size);
+
+        // If host coherency hasn't been requested, do a manual flush to make writes visible
+        if ((m_vk_memory_property & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
         {
-            DW_LOG_FATAL("(Vulkan) Failed to create Buffer.");
-            throw std::runtime_error("(Vulkan) Failed to create Buffer.");
+            VkMappedMemoryRange mapped_range;
+            DW_ZERO_MEMORY(mapped_range);
+
+            mapped_range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            mapped_range.memory = m_vk_device_memory;
+            mapped_range.offset = 0;
+            mapped_range.size   = VK_WHOLE_SIZE;
+
+            vkFlushMappedMemoryRanges(backend->device(), 1, &mapped_range);
         }
     }
+}
 
-    m_vk_device_memory = vma_alloc_info.deviceMemory;
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Buffer::invalidate(size_t offset, size_t size)
+{
+    if (m_vk_memory_property & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+        return;
+
+    vmaInvalidateAllocation(m_vma_allocator, m_vma_allocation, offset, size);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const char* kMemoryPoolNames[] = {
+    "Render Targets",
+    "Streaming Textures",
+    "Geometry",
+    "Staging"
+};
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+static VkImageAspectFlags aspect_flags_for_format(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryManager::Ptr MemoryManager::create(Backend::Ptr backend)
+{
+    return std::shared_ptr<MemoryManager>(new MemoryManager(backend));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+const char* MemoryManager::pool_name(MemoryPoolType type)
+{
+    return type < MEMORY_POOL_COUNT ? kMemoryPoolNames[type] : "Default";
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryManager::MemoryManager(Backend::Ptr backend) :
+    m_backend(backend.get()), m_vma_allocator(backend->allocator())
+{
+    // Each pool takes its memory type from a resource representative of what it holds.
+    VkImageCreateInfo image_info;
+    DW_ZERO_MEMORY(image_info);
+
+    image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType     = VK_IMAGE_TYPE_2D;
+    image_info.extent.width  = 1024;
+    image_info.extent.height = 1024;
+    image_info.extent.depth  = 1;
+    image_info.mipLevels     = 1;
+    image_info.arrayLayers   = 1;
+    image_info.format        = VK_FORMAT_R16G16B16A16_SFLOAT;
+    image_info.tiling        = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    image_info.samples       = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBufferCreateInfo buffer_info;
+    DW_ZERO_MEMORY(buffer_info);
+
+    buffer_info.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size        = 65536;
+    buffer_info.usage       = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo alloc_create_info;
+    DW_ZERO_MEMORY(alloc_create_info);
+
+    alloc_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    uint32_t memory_type_indices[MEMORY_POOL_COUNT];
+    VkResult results[MEMORY_POOL_COUNT];
+
+    results[MEMORY_POOL_RENDER_TARGETS] = vmaFindMemoryTypeIndexForImageInfo(m_vma_allocator, &image_info, &alloc_create_info, &memory_type_indices[MEMORY_POOL_RENDER_TARGETS]);
+
+    image_info.format = VK_FORMAT_R8G8B8A8_UNORM;
+    image_info.usage  = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    results[MEMORY_POOL_STREAMING_TEXTURES] = vmaFindMemoryTypeIndexForImageInfo(m_vma_allocator, &image_info, &alloc_create_info, &memory_type_indices[MEMORY_POOL_STREAMING_TEXTURES]);
+    results[MEMORY_POOL_GEOMETRY]           = vmaFindMemoryTypeIndexForBufferInfo(m_vma_allocator, &buffer_info, &alloc_create_info, &memory_type_indices[MEMORY_POOL_GEOMETRY]);
+
+    buffer_info.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    results[MEMORY_POOL_STAGING] = vmaFindMemoryTypeIndexForBufferInfo(m_vma_allocator, &buffer_info, &alloc_create_info, &memory_type_indices[MEMORY_POOL_STAGING]);
+
+    for (uint32_t i = 0; i < MEMORY_POOL_COUNT; i++)
+    {
+        if (results[i] != VK_SUCCESS)
+        {
+            DW_LOG_WARNING(std::string("(Vulkan) No memory type found for the ") + kMemoryPoolNames[i] + " pool, its resources will use the default heaps.");
+            continue;
+        }
+
+        VmaPoolCreateInfo pool_info;
+        DW_ZERO_MEMORY(pool_info);
+
+        pool_info.memoryTypeIndex = memory_type_indices[i];
+
+        if (vmaCreatePool(m_vma_allocator, &pool_info, &m_pools[i]) != VK_SUCCESS)
+        {
+            DW_LOG_FATAL("(Vulkan) Failed to create Memory Pool.");
+            throw std::runtime_error("(Vulkan) Failed to create Memory Pool.");
+        }
+
+        vmaSetPoolName(m_vma_allocator, m_pools[i], kMemoryPoolNames[i]);
+    }
+
+    m_cmd_pool = CommandPool::create(backend, backend->queue_infos().graphics_queue_index);
+    m_cmd_buf  = CommandBuffer::create(backend, m_cmd_pool);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryManager::~MemoryManager()
+{
+    finish();
+
+    m_cmd_buf.reset();
+    m_cmd_pool.reset();
+
+    for (uint32_t i = 0; i < MEMORY_POOL_COUNT; i++)
+    {
+        if (m_pools[i])
+            vmaDestroyPool(m_vma_allocator, m_pools[i]);
+    }
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::update()
+{
+    std::vector<std::function<void()>> callbacks;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_bytes_moved       = 0;
+        m_allocations_moved = 0;
+
+        // Lets VMA refresh the budget it allocates against.
+        vmaSetCurrentFrameIndex(m_vma_allocator, ++m_frame);
+
+        if (m_state == DEFRAGMENTATION_COPYING && m_backend->is_complete(m_copy_point))
+            swap_moves(callbacks);
+
+        if (m_state == DEFRAGMENTATION_RETIRING)
+        {
+            bool retired = true;
+
+            for (const auto& point : m_retire_points)
+                retired = retired && m_backend->is_complete(point);
+
+            if (retired)
+                end_pass();
+        }
+
+        if (m_state == DEFRAGMENTATION_IDLE && !m_context && m_defragmentation_enabled && !m_movables.empty() && m_frame % MEMORY_DEFRAGMENTATION_INTERVAL == 0)
+        {
+            m_pool_index = (m_pool_index + 1) % MEMORY_POOL_COUNT;
+
+            if (m_pools[m_pool_index] && pool_stats(m_pool_index).fragmentation > MEMORY_DEFRAGMENTATION_THRESHOLD)
+            {
+                VmaDefragmentationInfo info;
+                DW_ZERO_MEMORY(info);
+
+                info.flags                 = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+                info.pool                  = m_pools[m_pool_index];
+                info.maxBytesPerPass       = MEMORY_DEFRAGMENTATION_MAX_BYTES_PER_PASS;
+                info.maxAllocationsPerPass = MEMORY_DEFRAGMENTATION_MAX_MOVES_PER_PASS;
+
+                if (vmaBeginDefragmentation(m_vma_allocator, &info, &m_context) != VK_SUCCESS)
+                {
+                    DW_LOG_ERROR("(Vulkan) Failed to begin defragmentation.");
+                    m_context = VK_NULL_HANDLE;
+                }
+            }
+        }
+
+        if (m_state == DEFRAGMENTATION_IDLE && m_context)
+            begin_pass();
+    }
+
+    for (auto& callback : callbacks)
+        callback();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::finish()
+{
+    std::vector<std::function<void()>> callbacks;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_state == DEFRAGMENTATION_COPYING)
+        {
+            m_backend->wait(m_copy_point);
+            swap_moves(callbacks);
+        }
+
+        if (m_state == DEFRAGMENTATION_RETIRING)
+        {
+            m_backend->wait(m_retire_points);
+            end_pass();
+        }
+
+        if (m_context)
+            end_defragmentation();
+    }
+
+    for (auto& callback : callbacks)
+        callback();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::retire(std::shared_ptr<void> object)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Outside of a pass the frames that used the old handles have completed, and the object can go right away.
+    if (m_state == DEFRAGMENTATION_RETIRING)
+        m_retired_objects.push_back(object);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryStats MemoryManager::stats()
+{
+    MemoryStats stats;
+
+    for (uint32_t i = 0; i < MEMORY_POOL_COUNT; i++)
+        stats.pools[i] = pool_stats(i);
+
+    const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+
+    vmaGetMemoryProperties(m_vma_allocator, &memory_properties);
+
+    stats.heap_budgets.resize(memory_properties->memoryHeapCount);
+
+    vmaGetHeapBudgets(m_vma_allocator, stats.heap_budgets.data());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    stats.bytes_moved             = m_bytes_moved;
+    stats.allocations_moved       = m_allocations_moved;
+    stats.over_budget_allocations = m_over_budget_allocations;
+    stats.memory_budget_extension = m_backend->memory_budget_enabled();
+    stats.defragmenting           = m_context != VK_NULL_HANDLE;
+
+    return stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryPoolType MemoryManager::classify(const VkImageCreateInfo& info, VmaMemoryUsage memory_usage)
+{
+    if (memory_usage != VMA_MEMORY_USAGE_GPU_ONLY || info.tiling != VK_IMAGE_TILING_OPTIMAL)
+        return MEMORY_POOL_DEFAULT;
+
+    if (info.usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+        return MEMORY_POOL_RENDER_TARGETS;
+
+    return MEMORY_POOL_STREAMING_TEXTURES;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryPoolType MemoryManager::classify(const VkBufferCreateInfo& info, VmaMemoryUsage memory_usage)
+{
+    if (memory_usage == VMA_MEMORY_USAGE_CPU_ONLY)
+        return MEMORY_POOL_STAGING;
+
+    if (memory_usage == VMA_MEMORY_USAGE_GPU_ONLY && (info.usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT)))
+        return MEMORY_POOL_GEOMETRY;
+
+    return MEMORY_POOL_DEFAULT;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryPoolType MemoryManager::allocate(MemoryPoolType type, const VmaAllocationCreateInfo& alloc_create_info, const std::function<VkResult(const VmaAllocationCreateInfo&)>& create, VkResult& result)
+{
+    if (type < MEMORY_POOL_COUNT && m_pools[type])
+    {
+        VmaAllocationCreateInfo info = alloc_create_info;
+
+        info.pool = m_pools[type];
+
+        // Streaming textures and staging memory are what an application is most likely to ask too much of.
+        if (type == MEMORY_POOL_STREAMING_TEXTURES || type == MEMORY_POOL_STAGING)
+        {
+            info.flags |= VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+
+            result = create(info);
+
+            if (result == VK_SUCCESS)
+                return type;
+
+            info.flags &= ~VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+
+            if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+            {
+                m_over_budget_allocations++;
+                DW_LOG_WARNING(std::string("(Vulkan) Allocation from the ") + kMemoryPoolNames[type] + " pool exceeds the memory budget.");
+            }
+        }
+
+        result = create(info);
+
+        if (result == VK_SUCCESS)
+            return type;
+    }
+
+    // The memory type of the pool may not be one the resource can be bound to.
+    result = create(alloc_create_info);
+
+    return MEMORY_POOL_DEFAULT;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::register_movable(VmaAllocation_T* allocation, const Movable& movable)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_movables[allocation] = movable;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::unregister_movable(VmaAllocation_T* allocation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // A move already in flight still completes.
+    m_movables.erase(allocation);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MemoryManager::release(VmaAllocation_T* allocation)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_movables.erase(allocation);
+
+    auto it = m_move_indices.find(allocation);
+
+    if (it == m_move_indices.end())
+        return false;
+
+    // VMA frees both places when the pass ends, and the handles bound to them are destroyed along with the old ones.
+    m_moves[it->second].destroyed       = true;
+    m_pass.pMoves[it->second].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::begin_pass()
+{
+    VkResult result = vmaBeginDefragmentationPass(m_vma_allocator, m_context, &m_pass);
+
+    // VK_SUCCESS means there is nothing left to move.
+    if (result != VK_INCOMPLETE)
+    {
+        if (result != VK_SUCCESS)
+            DW_LOG_ERROR("(Vulkan) Failed to begin defragmentation pass.");
+
+        end_defragmentation();
+        return;
+    }
+
+    m_moves.resize(m_pass.moveCount);
+
+    VkCommandBufferBeginInfo begin_info;
+    DW_ZERO_MEMORY(begin_info);
+
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(m_cmd_buf->handle(), &begin_info);
+
+    uint32_t recorded = 0;
+
+    for (uint32_t i = 0; i < m_pass.moveCount; i++)
+    {
+        if (record_move(i))
+            recorded++;
+    }
+
+    vkEndCommandBuffer(m_cmd_buf->handle());
+
+    if (recorded == 0)
+    {
+        // None of the allocations VMA picked can be moved, and it would keep picking them.
+        end_pass();
+
+        if (m_context)
+            end_defragmentation();
+
+        return;
+    }
+
+    m_copy_point = m_backend->submit_graphics({ m_cmd_buf });
+    m_state      = DEFRAGMENTATION_COPYING;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool MemoryManager::record_move(uint32_t index)
+{
+    VmaDefragmentationMove& vma_move = m_pass.pMoves[index];
+    Move&                   move     = m_moves[index];
+
+    vma_move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+
+    auto it = m_movables.find(vma_move.srcAllocation);
+
+    if (it == m_movables.end())
+        return false;
+
+    move.resource = it->second;
+
+    VkDevice device = m_backend->device();
+
+    if (Image* image = move.resource.image)
+    {
+        const VkImageUsageFlags transfer_usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+        VkImageLayout layout;
+
+        // The copy is made from and left in the layout every subresource was last used in.
+        if ((image->usage() & transfer_usage) != transfer_usage || !m_backend->current_layout(image->handle(), layout))
+            return false;
+
+        VkImageCreateInfo image_info;
+        DW_ZERO_MEMORY(image_info);
+
+        image_info.sType         = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType     = image->type();
+        image_info.extent.width  = image->width();
+        image_info.extent.height = image->height();
+        image_info.extent.depth  = image->depth();
+        image_info.mipLevels     = image->mip_levels();
+        image_info.arrayLayers   = image->array_size();
+        image_info.format        = image->format();
+        image_info.tiling        = image->tiling();
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.usage         = image->usage();
+        image_info.samples       = (VkSampleCountFlagBits)image->sample_count();
+        image_info.sharingMode   = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.flags         = image->flags();
+
+        if (vkCreateImage(device, &image_info, nullptr, &move.new_image) != VK_SUCCESS)
+            return false;
+
+        if (vmaBindImageMemory(m_vma_allocator, vma_move.dstTmpAllocation, move.new_image) != VK_SUCCESS)
+        {
+            vkDestroyImage(device, move.new_image, nullptr);
+            move.new_image = VK_NULL_HANDLE;
+            return false;
+        }
+
+        move.old_image = image->handle();
+
+        VkImageSubresourceRange range;
+        DW_ZERO_MEMORY(range);
+
+        range.aspectMask = aspect_flags_for_format(image->format());
+        range.levelCount = image->mip_levels();
+        range.layerCount = image->array_size();
+
+        m_backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, move.old_image, range, image->array_size(), image->mip_levels());
+        m_backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, move.new_image, range, image->array_size(), image->mip_levels());
+
+        m_backend->flush_barriers(m_cmd_buf);
+
+        std::vector<VkImageCopy> regions(image->mip_levels());
+
+        for (uint32_t i = 0; i < image->mip_levels(); i++)
+        {
+            VkImageCopy& region = regions[i];
+            DW_ZERO_MEMORY(region);
+
+            region.srcSubresource.aspectMask = range.aspectMask;
+            region.srcSubresource.mipLevel   = i;
+            region.srcSubresource.layerCount = image->array_size();
+            region.dstSubresource            = region.srcSubresource;
+            region.extent.width              = std::max(1u, image->width() >> i);
+            region.extent.height             = std::max(1u, image->height() >> i);
+            region.extent.depth              = std::max(1u, image->depth() >> i);
+        }
+
+        vkCmdCopyImage(m_cmd_buf->handle(), move.old_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, move.new_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+
+        // Frames recorded until the copy is swapped in keep using the old image.
+        m_backend->use_resource(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT, layout, move.old_image, range, image->array_size(), image->mip_levels());
+        m_backend->use_resource(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT, layout, move.new_image, range, image->array_size(), image->mip_levels());
+
+        m_backend->flush_barriers(m_cmd_buf);
+    }
+    else
+    {
+        Buffer* buffer = move.resource.buffer;
+
+        const VkBufferUsageFlags transfer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        if ((buffer->m_vk_usage_flags & transfer_usage) != transfer_usage)
+            return false;
+
+        VkBufferCreateInfo buffer_info;
+        DW_ZERO_MEMORY(buffer_info);
+
+        buffer_info.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size        = buffer->size();
+        buffer_info.usage       = buffer->m_vk_usage_flags;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &buffer_info, nullptr, &move.new_buffer) != VK_SUCCESS)
+            return false;
+
+        if (vmaBindBufferMemory(m_vma_allocator, vma_move.dstTmpAllocation, move.new_buffer) != VK_SUCCESS)
+        {
+            vkDestroyBuffer(device, move.new_buffer, nullptr);
+            move.new_buffer = VK_NULL_HANDLE;
+            return false;
+        }
+
+        move.old_buffer = buffer->handle();
+
+        m_backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT, move.old_buffer);
+        m_backend->use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT, move.new_buffer);
+
+        m_backend->flush_barriers(m_cmd_buf);
+
+        VkBufferCopy region;
+        DW_ZERO_MEMORY(region);
+
+        region.size = buffer->size();
+
+        vkCmdCopyBuffer(m_cmd_buf->handle(), move.old_buffer, move.new_buffer, 1, &region);
+
+        m_backend->use_resource(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT, move.new_buffer);
+
+        m_backend->flush_barriers(m_cmd_buf);
+    }
+
+    VmaAllocationInfo info;
+
+    vmaGetAllocationInfo(m_vma_allocator, vma_move.srcAllocation, &info);
+
+    vma_move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+    move.recorded      = true;
+
+    m_move_indices[vma_move.srcAllocation] = index;
+
+    m_bytes_moved += info.size;
+    m_allocations_moved++;
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::swap_moves(std::vector<std::function<void()>>& callbacks)
+{
+    for (uint32_t i = 0; i < m_moves.size(); i++)
+    {
+        Move& move = m_moves[i];
+
+        if (!move.recorded || move.destroyed)
+            continue;
+
+        VmaAllocationInfo info;
+
+        vmaGetAllocationInfo(m_vma_allocator, m_pass.pMoves[i].dstTmpAllocation, &info);
+
+        if (move.resource.image)
+            move.resource.image->relocate(move.new_image, info, m_retired_views, m_retired_targets);
+        else
+            move.resource.buffer->relocate(move.new_buffer, info);
+
+        if (move.resource.on_relocated)
+            callbacks.push_back(move.resource.on_relocated);
+    }
+
+    // Every frame submitted so far may still use the old handles.
+    m_retire_points.clear();
+
+    for (uint32_t i = 0; i < QUEUE_TYPE_COUNT; i++)
+        m_retire_points.push_back(m_backend->last_submitted_point((QueueType)i));
+
+    m_state = DEFRAGMENTATION_RETIRING;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::end_pass()
+{
+    VkDevice device = m_backend->device();
+
+    for (auto& move : m_moves)
+    {
+        if (!move.recorded)
+            continue;
+
+        // Resources hold on to the new handles, unless they were destroyed while being moved.
+        if (move.old_image)
+        {
+            vkDestroyImage(device, move.old_image, nullptr);
+            m_backend->forget_resource(move.old_image);
+        }
+
+        if (move.old_buffer)
+        {
+            vkDestroyBuffer(device, move.old_buffer, nullptr);
+            m_backend->forget_resource(move.old_buffer);
+        }
+
+        if (move.destroyed)
+        {
+            if (move.new_image)
+            {
+                vkDestroyImage(device, move.new_image, nullptr);
+                m_backend->forget_resource(move.new_image);
+            }
+
+            if (move.new_buffer)
+            {
+                vkDestroyBuffer(device, move.new_buffer, nullptr);
+                m_backend->forget_resource(move.new_buffer);
+            }
+        }
+    }
+
+    for (auto view : m_retired_views)
+        vkDestroyImageView(device, view, nullptr);
+
+    m_retired_views.clear();
+    m_retired_targets.clear();
+    m_retired_objects.clear();
+    m_retire_points.clear();
+    m_move_indices.clear();
+    m_moves.clear();
+
+    m_cmd_pool->reset();
+
+    m_state = DEFRAGMENTATION_IDLE;
+
+    if (vmaEndDefragmentationPass(m_vma_allocator, m_context, &m_pass) == VK_SUCCESS)
+        end_defragmentation();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void MemoryManager::end_defragmentation()
+{
+    VmaDefragmentationStats stats;
+
+    vmaEndDefragmentation(m_vma_allocator, m_context, &stats);
+
+    m_context = VK_NULL_HANDLE;
+
+    if (stats.allocationsMoved > 0)
+        DW_LOG_INFO("(Vulkan) Defragmented the " + std::string(kMemoryPoolNames[m_pool_index]) + " pool: moved " + std::to_string(stats.allocationsMoved) + " allocations (" + std::to_string(stats.bytesMoved / 1024) + " KB), freed " + std::to_string(stats.bytesFreed / 1024) + " KB.");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+MemoryPoolStats MemoryManager::pool_stats(uint32_t pool)
+{
+    MemoryPoolStats stats;
+
+    if (!m_pools[pool])
+        return stats;
+
+    VmaDetailedStatistics detailed;
+
+    vmaCalculatePoolStatistics(m_vma_allocator, m_pools[pool], &detailed);
+
+    stats.block_bytes      = detailed.statistics.blockBytes;
+    stats.allocation_bytes = detailed.statistics.allocationBytes;
+    stats.allocation_count = detailed.statistics.allocationCount;
+
+    VkDeviceSize free_bytes = detailed.statistics.blockBytes - detailed.statistics.allocationBytes;
+
+    if (free_bytes > 0)
+        stats.fragmentation = 1.0f - float(detailed.unusedRangeSizeMax) / float(free_bytes);
+
+    return stats;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+// The first two timestamps of a slot bracket its whole submission, followed by a pair per pass.
+#define ASYNC_COMPUTE_QUERY_COUNT (2 + 2 * ASYNC_COMPUTE_MAX_PASSES)
+
+AsyncCompute::Ptr AsyncCompute::create(Backend::Ptr backend)
+{
+    return std::shared_ptr<AsyncCompute>(new AsyncCompute(backend));
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+AsyncCompute::AsyncCompute(Backend::Ptr backend) :
+    m_backend(backend)
+{
+    QueueInfos queues = backend->queue_infos();
+
+    m_asynchronous = queues.asynchronous_compute();
+
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(backend->physical_device(), &family_count, nullptr);
+
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(backend->physical_device(), &family_count, families.data());
+
+    m_timestamps       = families[queues.compute_queue_index].timestampValidBits > 0 && families[queues.graphics_queue_index].timestampValidBits > 0;
+    m_timestamp_period = backend->physical_device_properties().limits.timestampPeriod;
+
+    if (!m_timestamps)
+        DW_LOG_WARNING("(Vulkan) The compute or graphics queue does not support timestamps, asynchronous compute will not be timed.");
+
+    for (uint32_t i = 0; i < Backend::kMaxFramesInFlight; i++)
+    {
+        Slot& slot = m_slots[i];
+
+        slot.cmd_pool = CommandPool::create(backend, queues.compute_queue_index);
+        slot.cmd_buf  = CommandBuffer::create(backend, slot.cmd_pool);
+        slot.cmd_buf->set_name("Async Compute " + std::to_string(i));
+
+        if (m_timestamps)
+        {
+            slot.compute_queries  = QueryPool::create(backend, VK_QUERY_TYPE_TIMESTAMP, ASYNC_COMPUTE_QUERY_COUNT);
+            slot.graphics_queries = QueryPool::create(backend, VK_QUERY_TYPE_TIMESTAMP, 2);
+        }
+    }
+
+    m_stats.asynchronous = m_asynchronous;
+
+    if (m_asynchronous)
+        DW_LOG_INFO("(Vulkan) Compute work is scheduled on queue family " + std::to_string(queues.compute_queue_index) + ", next to graphics on " + std::to_string(queues.graphics_queue_index) + ".");
+    else
+        DW_LOG_INFO("(Vulkan) No separate compute queue family, compute work is scheduled on the graphics family.");
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+AsyncCompute::~AsyncCompute()
+{
+    auto backend = m_backend.lock();
+
+    if (!backend)
+        return;
+
+    std::vector<TimelinePoint> points;
+
+    for (auto& slot : m_slots)
+    {
+        if (slot.submitted)
+            points.push_back(slot.point);
+    }
+
+    backend->wait(points);
+
+    if (m_recording)
+        vkEndCommandBuffer(m_slots[m_slot].cmd_buf->handle());
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+std::shared_ptr<CommandBuffer> AsyncCompute::begin()
+{
+    auto backend = m_backend.lock();
+
+    if (m_recording)
+    {
+        DW_LOG_WARNING("(Vulkan) Asynchronous compute work recorded last frame was never submitted and is dropped.");
+        vkEndCommandBuffer(m_slots[m_slot].cmd_buf->handle());
+    }
+
+    m_slot = (m_slot + 1) % Backend::kMaxFramesInFlight;
+
+    Slot& slot = m_slots[m_slot];
+
+    // Frames are paced by the application, so this rarely blocks.
+    if (slot.submitted)
+    {
+        backend->wait(slot.point);
+        read_stats(slot);
+    }
+
+    slot.submitted      = false;
+    slot.graphics_timed = false;
+    slot.pass_names.clear();
+
+    VkCommandBufferBeginInfo begin_info;
+    DW_ZERO_MEMORY(begin_info);
+
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(slot.cmd_buf->handle(), &begin_info);
+
+    if (m_timestamps)
+    {
+        vkCmdResetQueryPool(slot.cmd_buf->handle(), slot.compute_queries->handle(), 0, ASYNC_COMPUTE_QUERY_COUNT);
+        vkCmdWriteTimestamp(slot.cmd_buf->handle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.compute_queries->handle(), 0);
+    }
+
+    m_recording = true;
+
+    return slot.cmd_buf;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AsyncCompute::begin_pass(const std::string& name)
+{
+    Slot& slot = m_slots[m_slot];
+
+    uint32_t index = slot.pass_names.size();
+
+    slot.pass_names.push_back(name);
+
+    if (m_timestamps && index < ASYNC_COMPUTE_MAX_PASSES)
+        vkCmdWriteTimestamp(slot.cmd_buf->handle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.compute_queries->handle(), 2 + 2 * index);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void AsyncCompute::end_pass()
+{
+    Slot& slot = m_slots[m_slot];
+
+    uint32_t index = slot.pass_names.size() - 1;
+
+    if (m_timestamps && index < ASYNC_COMPUTE_MAX_PASSES)
+        vkCmdWriteTimestamp(slot.cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.compute_queries->handle(), 3 + 2 * index);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TimelinePoint AsyncCompute::submit(const std::vector<TimelinePoint>& wait_points)
+{
+    auto backend = m_backend.lock();
+
+    Slot& slot = m_slots[m_slot];
+
+    if (!m_recording)
+    {
+        DW_LOG_ERROR("(Vulkan) Asynchronous compute submitted without begin().");
+        return m_last_point;
+    }
 
-    if (create_flags & VMA_ALLOCATION_CREATE_MAPPED_BIT)
-        m_mapped_ptr = vma_alloc_info.pMappedData;
+    if (m_timestamps)
+        vkCmdWriteTimestamp(slot.cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.compute_queries->handle(), 1);
 
-    if (data)
-        upload_data(data, size, 0);
+    vkEndCommandBuffer(slot.cmd_buf->handle());
 
-    VkBufferDeviceAddressInfoKHR address_info;
-    DW_ZERO_MEMORY(address_info);
+    m_recording = false;
 
-    address_info.sType  = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR;
-    address_info.buffer = m_vk_buffer;
+    slot.point     = backend->submit_compute({ slot.cmd_buf }, wait_points);
+    slot.submitted = true;
+    m_last_point   = slot.point;
 
-    if ((usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) == VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT)
-        m_device_address = vkGetBufferDeviceAddress(backend->device(), &address_info);
+    return slot.point;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-Buffer::~Buffer()
+void AsyncCompute::begin_graphics_timing(const std::shared_ptr<CommandBuffer>& cmd_buf)
 {
-    vmaDestroyBuffer(m_vma_allocator, m_vk_buffer, m_vma_allocation);
-}
+    Slot& slot = m_slots[m_slot];
 
-// -----------------------------------------------------------------------------------------------------------------------------------
+    if (!m_timestamps)
+        return;
 
-void Buffer::set_name(const std::string& name)
-{
-    auto backend = m_vk_backend.lock();
-    utilities::set_object_name(backend->device(), (uint64_t)m_vk_buffer, name, VK_OBJECT_TYPE_BUFFER);
+    vkCmdResetQueryPool(cmd_buf->handle(), slot.graphics_queries->handle(), 0, 2);
+    vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.graphics_queries->handle(), 0);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Buffer::upload_data(void* data, size_t size, size_t offset)
+void AsyncCompute::end_graphics_timing(const std::shared_ptr<CommandBuffer>& cmd_buf)
 {
-    auto backend = m_vk_backend.lock();
+    Slot& slot = m_slots[m_slot];
 
-    if (m_vma_memory_usage == VMA_MEMORY_USAGE_GPU_ONLY)
-    {
-        // Create VMA_MEMORY_USAGE_CPU_ONLY staging buffer and perfom Buffer-to-Buffer copy
-        Buffer::Ptr staging = Buffer::create(backend, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT, data);
+    if (!m_timestamps)
+        return;
 
-        CommandBuffer::Ptr cmd_buf = backend->allocate_graphics_command_buffer();
+    vkCmdWriteTimestamp(cmd_buf->handle(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.graphics_queries->handle(), 1);
 
-        VkCommandBufferBeginInfo begin_info;
-        DW_ZERO_MEMORY(begin_info);
+    slot.graphics_timed = true;
+}
 
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-        vkBeginCommandBuffer(cmd_buf->handle(), &begin_info);
+void AsyncCompute::read_stats(Slot& slot)
+{
+    if (!m_timestamps)
+        return;
 
-        VkBufferCopy copy_region;
-        DW_ZERO_MEMORY(copy_region);
+    auto backend = m_backend.lock();
 
-        copy_region.dstOffset = offset;
-        copy_region.size      = size;
+    const uint32_t pass_count  = std::min(uint32_t(slot.pass_names.size()), uint32_t(ASYNC_COMPUTE_MAX_PASSES));
+    const uint32_t query_count = 2 + 2 * pass_count;
+    const double   to_ms       = m_timestamp_period / 1000000.0;
 
-        vkCmdCopyBuffer(cmd_buf->handle(), staging->handle(), m_vk_buffer, 1, &copy_region);
+    uint64_t timestamps[ASYNC_COMPUTE_QUERY_COUNT];
 
-        vkEndCommandBuffer(cmd_buf->handle());
+    if (vkGetQueryPoolResults(backend->device(), slot.compute_queries->handle(), 0, query_count, sizeof(uint64_t) * query_count, timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
 
-        backend->flush_graphics({ cmd_buf });
-    }
-    else
+    m_stats.passes.resize(pass_count);
+
+    for (uint32_t i = 0; i < pass_count; i++)
     {
-        if (!m_mapped_ptr)
-            vkMapMemory(backend->device(), m_vk_device_memory, 0, size, 0, &m_mapped_ptr);
+        m_stats.passes[i].name = slot.pass_names[i];
+        m_stats.passes[i].ms   = float((timestamps[3 + 2 * i] - timestamps[2 + 2 * i]) * to_ms);
+    }
 
-        memcpy(m_mapped_ptr, data, size);
+    m_stats.compute_ms  = float((timestamps[1] - timestamps[0]) * to_ms);
+    m_stats.graphics_ms = 0.0f;
+    m_stats.overlap_ms  = 0.0f;
+    m_stats.valid       = true;
 
-        // If host coherency hasn't been requested, do a manual flush to make writes visible
-        if ((m_vk_memory_property & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
-        {
-            VkMappedMemoryRange mapped_range;
-            DW_ZERO_MEMORY(mapped_range);
+    uint64_t graphics_timestamps[2];
 
-            mapped_range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-            mapped_range.memory = m_vk_device_memory;
-            mapped_range.offset = 0;
-            mapped_range.size   = VK_WHOLE_SIZE;
+    // The graphics work of the frame may be recorded without timing, or still be running.
+    if (!slot.graphics_timed || vkGetQueryPoolResults(backend->device(), slot.graphics_queries->handle(), 0, 2, sizeof(graphics_timestamps), graphics_timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+        return;
 
-            vkFlushMappedMemoryRanges(backend->device(), 1, &mapped_range);
-        }
-    }
+    const uint64_t overlap_start = std::max(timestamps[0], graphics_timestamps[0]);
+    const uint64_t overlap_end   = std::min(timestamps[1], graphics_timestamps[1]);
+
+    m_stats.graphics_ms = float((graphics_timestamps[1] - graphics_timestamps[0]) * to_ms);
+    m_stats.overlap_ms  = overlap_end > overlap_start ? float((overlap_end - overlap_start) * to_ms) : 0.0f;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -751,18 +1909,12 @@ void CommandBuffer::set_name(const std::string& name)
 
 ShaderModule::Ptr ShaderModule::create_from_file(Backend::Ptr backend, std::string path)
 {
-    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    vfs::File file;
 
-    if (!file.is_open())
+    if (!vfs::read(path, file))
         throw std::runtime_error("Failed to open SPIRV shader!");
 
-    size_t            file_size = (size_t)file.tellg();
-    std::vector<char> buffer(file_size);
-
-    file.seekg(0);
-    file.read(buffer.data(), file_size);
-
-    file.close();
+    std::vector<char> buffer(file.data(), file.data() + file.size());
 
     return std::shared_ptr<ShaderModule>(new ShaderModule(backend, buffer));
 }
@@ -1439,6 +2591,15 @@ GraphicsPipeline::Desc& GraphicsPipeline::Desc::set_stencil_attachment_format(Vk
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+GraphicsPipeline::Desc& GraphicsPipeline::Desc::set_view_mask(uint32_t mask)
+{
+    view_mask = mask;
+
+    return *this;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 GraphicsPipeline::Desc& GraphicsPipeline::Desc::add_dynamic_state(const VkDynamicState& state)
 {
     if (dynamic_state_count == 32)
@@ -1726,6 +2887,7 @@ GraphicsPipeline::GraphicsPipeline(Backend::Ptr backend, Desc desc) :
         rendering_create_info.pColorAttachmentFormats = &desc.color_attachment_formats[0];
         rendering_create_info.depthAttachmentFormat   = desc.depth_attachment_format;
         rendering_create_info.stencilAttachmentFormat = desc.stencil_attachment_format;
+        rendering_create_info.viewMask                = desc.view_mask;
 
         desc.create_info.pNext = &rendering_create_info;
     }
@@ -2689,6 +3851,15 @@ void Fence::wait_for_completion()
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+bool Fence::is_complete()
+{
+    auto backend = m_vk_backend.lock();
+
+    return vkGetFenceStatus(backend->device(), m_vk_fence) == VK_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 void Fence::set_name(const std::string& name)
 {
     auto backend = m_vk_backend.lock();
@@ -2906,9 +4077,13 @@ void BatchUploader::upload_image_data(Image::Ptr image, void* data, const std::v
 
         auto buffer = insert_data(data, size);
 
-        std::vector<VkBufferImageCopy> copy_regions;
-        size_t                         offset     = 0;
-        uint32_t                       region_idx = 0;
+        memory::ScratchScope scratch;
+
+        auto     copy_regions = memory::scratch_vector<VkBufferImageCopy>(scratch);
+        size_t   offset       = 0;
+        uint32_t region_idx   = 0;
+
+        copy_regions.reserve(image->array_size() * image->mip_levels());
 
         for (int array_idx = 0; array_idx < image->array_size(); array_idx++)
         {
@@ -3068,6 +4243,20 @@ Backend::Ptr Backend::create(GLFWwindow* window, bool vsync, bool srgb_swapchain
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+Backend::Ptr Backend::create_headless(uint32_t width, uint32_t height, bool srgb, bool enable_validation_layers, bool enable_nsight_aftermath, bool require_ray_tracing, std::vector<const char*> additional_device_extensions)
+{
+    std::shared_ptr<Backend> backend = std::shared_ptr<Backend>(new Backend(nullptr, false, srgb, enable_validation_layers, enable_nsight_aftermath, require_ray_tracing, additional_device_extensions));
+
+    backend->m_swap_chain_extent.width  = width;
+    backend->m_swap_chain_extent.height = height;
+
+    backend->initialize();
+
+    return backend;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 Backend::Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enable_validation_layers, bool enable_nsight_aftermath, bool require_ray_tracing, std::vector<const char*> additional_device_extensions) :
     m_vsync(vsync), m_srgb_swapchain(srgb_swapchain), m_window(window)
 {
@@ -3147,12 +4336,13 @@ Backend::Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enabl
     if (enable_validation_layers && create_debug_utils_messenger(m_vk_instance, &debug_create_info, nullptr, &m_vk_debug_messenger) != VK_SUCCESS)
         DW_LOG_FATAL("(Vulkan) Failed to create Vulkan debug messenger.");
 
-    if (!create_surface(window))
+    if (window && !create_surface(window))
     {
         DW_LOG_FATAL("(Vulkan) Failed to create Vulkan surface.");
         throw std::runtime_error("(Vulkan) Failed to create Vulkan surface.");
     }
 
+    // The swap chain extension is still enabled when headless so that applications can transition to the present layout unconditionally.
     std::vector<const char*> device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
     if (require_ray_tracing)
@@ -3184,6 +4374,13 @@ Backend::Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enabl
         throw std::runtime_error("(Vulkan) Failed to find a suitable GPU.");
     }
 
+    // Without it VMA estimates the budget from the heap sizes.
+    if (check_device_extension_support(m_vk_physical_device, { VK_EXT_MEMORY_BUDGET_EXTENSION_NAME }))
+    {
+        device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        m_memory_budget_enabled = true;
+    }
+
     if (!create_logical_device(device_extensions, require_ray_tracing, enable_nsight_aftermath))
     {
         DW_LOG_FATAL("(Vulkan) Failed to create logical device.");
@@ -3196,7 +4393,7 @@ Backend::Backend(GLFWwindow* window, bool vsync, bool srgb_swapchain, bool enabl
     vulkan_functions.vkGetDeviceProcAddr   = vkGetDeviceProcAddr;
 
     VmaAllocatorCreateInfo allocator_info = {};
-    allocator_info.flags                  = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+    allocator_info.flags                  = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT | (m_memory_budget_enabled ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0);
     allocator_info.physicalDevice         = m_vk_physical_device;
     allocator_info.device                 = m_vk_device;
     allocator_info.instance               = m_vk_instance;
@@ -3236,11 +4433,17 @@ Backend::~Backend()
     m_descriptor_pool.reset();
 
     for (int i = 0; i < m_swap_chain_images.size(); i++)
+    {
         m_swap_chain_image_views[i].reset();
+        m_swap_chain_images[i].reset();
+    }
 
     m_swap_chain_depth_view.reset();
     m_swap_chain_depth.reset();
 
+    // Finishes the defragmentation pass in flight, which needs the timeline semaphores.
+    m_memory_manager.reset();
+
     if (m_vk_debug_messenger)
     {
         destroy_debug_utils_messenger(m_vk_instance, m_vk_debug_messenger, nullptr);
@@ -3259,6 +4462,15 @@ Backend::~Backend()
         m_vk_surface = nullptr;
     }
 
+    for (uint32_t i = 0; i < QUEUE_TYPE_COUNT; i++)
+    {
+        if (m_vk_timeline_semaphores[i])
+        {
+            vkDestroySemaphore(m_vk_device, m_vk_timeline_semaphores[i], nullptr);
+            m_vk_timeline_semaphores[i] = nullptr;
+        }
+    }
+
     if (m_vma_allocator)
     {
         vmaDestroyAllocator(m_vma_allocator);
@@ -3282,6 +4494,9 @@ Backend::~Backend()
 
 void Backend::initialize()
 {
+    // Before any image or buffer, so that they are all allocated from the pools.
+    m_memory_manager = MemoryManager::create(shared_from_this());
+
     create_swapchain();
 
     // Create Descriptor Pools
@@ -3664,99 +4879,432 @@ void Backend::use_resource(VkPipelineStageFlags2 _stage,
     else
         m_buffer_usage_info[(uint64_t)_buffer] = new_usage;
 
-    m_buffer_memory_barriers.emplace_back(barrier);
+    m_buffer_memory_barriers.emplace_back(barrier);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::flush_barriers(const std::shared_ptr<CommandBuffer>& _cmd_buf)
+{
+    if (m_buffer_memory_barriers.size() > 0 || m_image_memory_barriers.size() > 0)
+    {
+        VkDependencyInfo dependency_info = {};
+
+        dependency_info.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.dependencyFlags          = VK_DEPENDENCY_BY_REGION_BIT;
+        dependency_info.memoryBarrierCount       = 0;
+        dependency_info.pMemoryBarriers          = nullptr;
+        dependency_info.bufferMemoryBarrierCount = m_buffer_memory_barriers.size();
+        dependency_info.pBufferMemoryBarriers    = m_buffer_memory_barriers.data();
+        dependency_info.imageMemoryBarrierCount  = m_image_memory_barriers.size();
+        dependency_info.pImageMemoryBarriers     = m_image_memory_barriers.data();
+
+        vkCmdPipelineBarrier2(_cmd_buf->handle(), &dependency_info);
+    }
+
+    m_buffer_memory_barriers.clear();
+    m_image_memory_barriers.clear();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Backend::current_layout(VkImage image, VkImageLayout& layout)
+{
+    auto it = m_image_usage_info.find((uint64_t)image);
+
+    if (it == m_image_usage_info.end() || it->second.empty())
+        return false;
+
+    layout = it->second[0].layout;
+
+    for (const auto& usage : it->second)
+    {
+        if (usage.layout != layout)
+            return false;
+    }
+
+    return layout != VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::forget_resource(VkImage image)
+{
+    m_image_usage_info.erase((uint64_t)image);
+    m_image_ownership_transfers.erase((uint64_t)image);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::forget_resource(VkBuffer buffer)
+{
+    m_buffer_usage_info.erase((uint64_t)buffer);
+    m_buffer_ownership_transfers.erase((uint64_t)buffer);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::release_resource(QueueType src_queue, QueueType dst_queue, VkImageLayout layout, const std::shared_ptr<Image>& image, VkImageSubresourceRange range)
+{
+    const uint32_t src_family = queue_family_index(src_queue);
+    const uint32_t dst_family = queue_family_index(dst_queue);
+
+    if (src_family == dst_family)
+        return;
+
+    // The release only makes the writes of the source queue available, its destination scope is the acquire's.
+    use_resource(VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, layout, image, range);
+
+    VkImageMemoryBarrier2& barrier = m_image_memory_barriers.back();
+
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+
+    OwnershipTransfer transfer;
+
+    transfer.src_queue  = src_queue;
+    transfer.dst_queue  = dst_queue;
+    transfer.old_layout = barrier.oldLayout;
+    transfer.new_layout = layout;
+
+    m_image_ownership_transfers[(uint64_t)image->handle()] = transfer;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::release_resource(QueueType src_queue, QueueType dst_queue, const std::shared_ptr<Buffer>& buffer, size_t offset, size_t size)
+{
+    const uint32_t src_family = queue_family_index(src_queue);
+    const uint32_t dst_family = queue_family_index(dst_queue);
+
+    if (src_family == dst_family)
+        return;
+
+    use_resource(VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, buffer, offset, size);
+
+    VkBufferMemoryBarrier2& barrier = m_buffer_memory_barriers.back();
+
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+
+    OwnershipTransfer transfer;
+
+    transfer.src_queue  = src_queue;
+    transfer.dst_queue  = dst_queue;
+    transfer.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    transfer.new_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    m_buffer_ownership_transfers[(uint64_t)buffer->handle()] = transfer;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::acquire_resource(QueueType queue, VkPipelineStageFlags2 stage, VkAccessFlags2 access, VkImageLayout layout, const std::shared_ptr<Image>& image, VkImageSubresourceRange range)
+{
+    use_resource(stage, access, layout, image, range);
+
+    auto it = m_image_ownership_transfers.find((uint64_t)image->handle());
+
+    if (it == m_image_ownership_transfers.end())
+        return;
+
+    const OwnershipTransfer transfer = it->second;
+
+    m_image_ownership_transfers.erase(it);
+
+    if (queue_family_index(transfer.dst_queue) != queue_family_index(queue))
+        DW_LOG_ERROR("(Vulkan) Acquiring an image on a queue family it was not released to.");
+
+    if (transfer.new_layout != layout)
+        DW_LOG_ERROR("(Vulkan) Acquiring an image in a different layout from the one it was released in.");
+
+    VkImageMemoryBarrier2& barrier = m_image_memory_barriers.back();
+
+    // Repeats the layout change of the release. The source stages chain with the semaphore wait that orders the acquire
+    // after the release.
+    barrier.srcStageMask        = stage;
+    barrier.srcAccessMask       = VK_ACCESS_2_NONE;
+    barrier.oldLayout           = transfer.old_layout;
+    barrier.newLayout           = transfer.new_layout;
+    barrier.srcQueueFamilyIndex = queue_family_index(transfer.src_queue);
+    barrier.dstQueueFamilyIndex = queue_family_index(queue);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::acquire_resource(QueueType queue, VkPipelineStageFlags2 stage, VkAccessFlags2 access, const std::shared_ptr<Buffer>& buffer, size_t offset, size_t size)
+{
+    use_resource(stage, access, buffer, offset, size);
+
+    auto it = m_buffer_ownership_transfers.find((uint64_t)buffer->handle());
+
+    if (it == m_buffer_ownership_transfers.end())
+        return;
+
+    const OwnershipTransfer transfer = it->second;
+
+    m_buffer_ownership_transfers.erase(it);
+
+    if (queue_family_index(transfer.dst_queue) != queue_family_index(queue))
+        DW_LOG_ERROR("(Vulkan) Acquiring a buffer on a queue family it was not released to.");
+
+    VkBufferMemoryBarrier2& barrier = m_buffer_memory_barriers.back();
+
+    barrier.srcStageMask        = stage;
+    barrier.srcAccessMask       = VK_ACCESS_2_NONE;
+    barrier.srcQueueFamilyIndex = queue_family_index(transfer.src_queue);
+    barrier.dstQueueFamilyIndex = queue_family_index(queue);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+uint32_t Backend::queue_family_index(QueueType queue)
+{
+    if (queue == QUEUE_TYPE_COMPUTE)
+        return m_selected_queues.compute_queue_index;
+    else if (queue == QUEUE_TYPE_TRANSFER)
+        return m_selected_queues.transfer_queue_index;
+    else
+        return m_selected_queues.graphics_queue_index;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TimelinePoint Backend::submit_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
+                                       const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
+                                       const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
+                                       const std::shared_ptr<Fence>&                      signal_fence,
+                                       const std::vector<TimelinePoint>&                  wait_points)
+{
+    return submit(QUEUE_TYPE_GRAPHICS, cmd_bufs, wait_semaphores, signal_semaphores, signal_fence, wait_points);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TimelinePoint Backend::submit_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
+                                      const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
+                                      const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
+                                      const std::shared_ptr<Fence>&                      signal_fence,
+                                      const std::vector<TimelinePoint>&                  wait_points)
+{
+    return submit(QUEUE_TYPE_COMPUTE, cmd_bufs, wait_semaphores, signal_semaphores, signal_fence, wait_points);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TimelinePoint Backend::submit_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
+                                       const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
+                                       const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
+                                       const std::shared_ptr<Fence>&                      signal_fence,
+                                       const std::vector<TimelinePoint>&                  wait_points)
+{
+    return submit(QUEUE_TYPE_TRANSFER, cmd_bufs, wait_semaphores, signal_semaphores, signal_fence, wait_points);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TimelinePoint Backend::submit_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs, const std::vector<TimelinePoint>& wait_points)
+{
+    return submit(QUEUE_TYPE_GRAPHICS, cmd_bufs, {}, {}, nullptr, wait_points);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TimelinePoint Backend::submit_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs, const std::vector<TimelinePoint>& wait_points)
+{
+    return submit(QUEUE_TYPE_COMPUTE, cmd_bufs, {}, {}, nullptr, wait_points);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+TimelinePoint Backend::submit_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs, const std::vector<TimelinePoint>& wait_points)
+{
+    return submit(QUEUE_TYPE_TRANSFER, cmd_bufs, {}, {}, nullptr, wait_points);
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::flush_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
+{
+    flush(QUEUE_TYPE_GRAPHICS, cmd_bufs);
+
+    m_graphics_command_pools[m_frame_idx % m_graphics_command_pools.size()]->reset();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::flush_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
+{
+    flush(QUEUE_TYPE_COMPUTE, cmd_bufs);
+
+    m_compute_command_pools[m_frame_idx % m_compute_command_pools.size()]->reset();
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::flush_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
+{
+    flush(QUEUE_TYPE_TRANSFER, cmd_bufs);
+
+    m_transfer_command_pools[m_frame_idx % m_transfer_command_pools.size()]->reset();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::flush_barriers(const std::shared_ptr<CommandBuffer>& _cmd_buf)
+TimelinePoint Backend::last_submitted_point(QueueType queue)
 {
-    if (m_buffer_memory_barriers.size() > 0 || m_image_memory_barriers.size() > 0)
-    {
-        VkDependencyInfo dependency_info = {};
-
-        dependency_info.sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
-        dependency_info.dependencyFlags          = VK_DEPENDENCY_BY_REGION_BIT;
-        dependency_info.memoryBarrierCount       = 0;
-        dependency_info.pMemoryBarriers          = nullptr;
-        dependency_info.bufferMemoryBarrierCount = m_buffer_memory_barriers.size();
-        dependency_info.pBufferMemoryBarriers    = m_buffer_memory_barriers.data();
-        dependency_info.imageMemoryBarrierCount  = m_image_memory_barriers.size();
-        dependency_info.pImageMemoryBarriers     = m_image_memory_barriers.data();
+    TimelinePoint point;
 
-        vkCmdPipelineBarrier2(_cmd_buf->handle(), &dependency_info);
-    }
+    point.queue = queue;
+    point.value = m_timeline_submitted[queue].load(std::memory_order_acquire);
 
-    m_buffer_memory_barriers.clear();
-    m_image_memory_barriers.clear();
+    return point;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::submit_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
-                              const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
-                              const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                              const std::shared_ptr<Fence>&                      signal_fence)
+TimelinePoint Backend::last_completed_point(QueueType queue)
 {
-    submit(m_vk_graphics_queue, cmd_bufs, wait_semaphores, signal_semaphores, signal_fence);
-}
+    uint64_t value = 0;
 
-// -----------------------------------------------------------------------------------------------------------------------------------
+    if (vkGetSemaphoreCounterValue(m_vk_device, m_vk_timeline_semaphores[queue], &value) != VK_SUCCESS)
+    {
+        DW_LOG_FATAL("(Vulkan) Failed to query timeline semaphore value!");
+        throw std::runtime_error("(Vulkan) Failed to query timeline semaphore value!");
+    }
 
-void Backend::submit_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
-                             const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
-                             const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                             const std::shared_ptr<Fence>&                      signal_fence)
-{
-    submit(m_vk_compute_queue, cmd_bufs, wait_semaphores, signal_semaphores, signal_fence);
+    // Other threads may have observed a later value in the meantime, so the cache only ever moves forward.
+    uint64_t cached = m_timeline_completed[queue].load(std::memory_order_relaxed);
+
+    while (cached < value && !m_timeline_completed[queue].compare_exchange_weak(cached, value, std::memory_order_relaxed))
+        ;
+
+    TimelinePoint point;
+
+    point.queue = queue;
+    point.value = value;
+
+    return point;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::submit_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
-                              const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
-                              const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                              const std::shared_ptr<Fence>&                      signal_fence)
+bool Backend::is_complete(const TimelinePoint& point)
 {
-    submit(m_vk_transfer_queue, cmd_bufs, wait_semaphores, signal_semaphores, signal_fence);
+    if (point.value <= m_timeline_completed[point.queue].load(std::memory_order_relaxed))
+        return true;
+
+    return point.value <= last_completed_point(point.queue).value;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::flush_graphics(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
+bool Backend::wait(const TimelinePoint& point, uint64_t timeout)
 {
-    flush(m_vk_graphics_queue, cmd_bufs);
+    if (point.value <= m_timeline_completed[point.queue].load(std::memory_order_relaxed))
+        return true;
 
-    m_graphics_command_pools[m_frame_idx % m_graphics_command_pools.size()]->reset();
+    return wait(std::vector<TimelinePoint>{ point }, timeout);
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::flush_compute(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
+bool Backend::wait(const std::vector<TimelinePoint>& points, uint64_t timeout)
 {
-    flush(m_vk_compute_queue, cmd_bufs);
+    // Only the latest point of each queue matters, and queues that already got there are left out of the wait.
+    uint64_t values[QUEUE_TYPE_COUNT] = {};
 
-    m_compute_command_pools[m_frame_idx % m_compute_command_pools.size()]->reset();
+    for (const auto& point : points)
+        values[point.queue] = std::max(values[point.queue], point.value);
+
+    VkSemaphore semaphores[QUEUE_TYPE_COUNT];
+    uint64_t    wait_values[QUEUE_TYPE_COUNT];
+    uint32_t    count = 0;
+
+    for (uint32_t i = 0; i < QUEUE_TYPE_COUNT; i++)
+    {
+        if (values[i] > m_timeline_completed[i].load(std::memory_order_relaxed))
+        {
+            semaphores[count]  = m_vk_timeline_semaphores[i];
+            wait_values[count] = values[i];
+            count++;
+        }
+    }
+
+    if (count == 0)
+        return true;
+
+    VkSemaphoreWaitInfo wait_info;
+    DW_ZERO_MEMORY(wait_info);
+
+    wait_info.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = count;
+    wait_info.pSemaphores    = semaphores;
+    wait_info.pValues        = wait_values;
+
+    VkResult result = vkWaitSemaphores(m_vk_device, &wait_info, timeout);
+
+    if (result == VK_TIMEOUT)
+        return false;
+
+    if (result != VK_SUCCESS)
+    {
+        DW_LOG_FATAL("(Vulkan) Failed to wait for timeline semaphores!");
+        throw std::runtime_error("(Vulkan) Failed to wait for timeline semaphores!");
+    }
+
+    for (uint32_t i = 0; i < QUEUE_TYPE_COUNT; i++)
+    {
+        uint64_t cached = m_timeline_completed[i].load(std::memory_order_relaxed);
+
+        while (cached < values[i] && !m_timeline_completed[i].compare_exchange_weak(cached, values[i], std::memory_order_relaxed))
+            ;
+    }
+
+    return true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::flush_transfer(const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
+bool Backend::create_timeline_semaphores()
 {
-    flush(m_vk_transfer_queue, cmd_bufs);
+    VkSemaphoreTypeCreateInfo type_info;
+    DW_ZERO_MEMORY(type_info);
 
-    m_transfer_command_pools[m_frame_idx % m_transfer_command_pools.size()]->reset();
+    type_info.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue  = 0;
+
+    VkSemaphoreCreateInfo semaphore_info;
+    DW_ZERO_MEMORY(semaphore_info);
+
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+
+    const char* names[] = { "Graphics Timeline", "Compute Timeline", "Transfer Timeline" };
+
+    for (uint32_t i = 0; i < QUEUE_TYPE_COUNT; i++)
+    {
+        if (vkCreateSemaphore(m_vk_device, &semaphore_info, nullptr, &m_vk_timeline_semaphores[i]) != VK_SUCCESS)
+            return false;
+
+        if (m_vk_debug_messenger)
+            utilities::set_object_name(m_vk_device, (uint64_t)m_vk_timeline_semaphores[i], names[i], VK_OBJECT_TYPE_SEMAPHORE);
+    }
+
+    return true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::submit(VkQueue                                            queue,
-                     const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
-                     const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
-                     const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
-                     const std::shared_ptr<Fence>&                      signal_fence)
+TimelinePoint Backend::submit(QueueType                                          queue,
+                              const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs,
+                              const std::vector<std::shared_ptr<Semaphore>>&     wait_semaphores,
+                              const std::vector<std::shared_ptr<Semaphore>>&     signal_semaphores,
+                              const std::shared_ptr<Fence>&                      signal_fence,
+                              const std::vector<TimelinePoint>&                  wait_points)
 {
-    VkSemaphoreSubmitInfo vk_wait_semaphores[16];
+    VkSemaphoreSubmitInfo vk_wait_semaphores[16 + QUEUE_TYPE_COUNT];
 
     for (int i = 0; i < wait_semaphores.size(); i++)
     {
@@ -3770,6 +5318,33 @@ void Backend::submit(VkQueue                                            queue,
         info.deviceIndex   = 0;
     }
 
+    uint32_t wait_count = wait_semaphores.size();
+
+    // Timeline waits are reduced to the latest point per queue, and points the GPU is known to have reached are dropped.
+    uint64_t              wait_values[QUEUE_TYPE_COUNT] = {};
+    VkPipelineStageFlags2 wait_stages[QUEUE_TYPE_COUNT] = {};
+
+    for (const auto& point : wait_points)
+    {
+        wait_values[point.queue] = std::max(wait_values[point.queue], point.value);
+        wait_stages[point.queue] |= point.stage;
+    }
+
+    for (uint32_t i = 0; i < QUEUE_TYPE_COUNT; i++)
+    {
+        if (wait_values[i] <= m_timeline_completed[i].load(std::memory_order_relaxed))
+            continue;
+
+        VkSemaphoreSubmitInfo& info = vk_wait_semaphores[wait_count++];
+
+        info.sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        info.pNext       = nullptr;
+        info.semaphore   = m_vk_timeline_semaphores[i];
+        info.value       = wait_values[i];
+        info.stageMask   = wait_stages[i];
+        info.deviceIndex = 0;
+    }
+
     VkCommandBufferSubmitInfo vk_cmd_bufs[32];
 
     for (int i = 0; i < cmd_bufs.size(); i++)
@@ -3782,7 +5357,7 @@ void Backend::submit(VkQueue                                            queue,
         info.deviceMask    = 0;
     }
 
-    VkSemaphoreSubmitInfo vk_signal_semaphores[16];
+    VkSemaphoreSubmitInfo vk_signal_semaphores[16 + 1];
 
     for (int i = 0; i < signal_semaphores.size(); i++)
     {
@@ -3796,66 +5371,80 @@ void Backend::submit(VkQueue                                            queue,
         info.deviceIndex = 0;
     }
 
+    std::lock_guard<std::mutex> lock(m_submit_mutex);
+
+    TimelinePoint point;
+
+    point.queue = queue;
+    point.value = m_timeline_submitted[queue].load(std::memory_order_relaxed) + 1;
+
+    VkSemaphoreSubmitInfo& timeline_info = vk_signal_semaphores[signal_semaphores.size()];
+
+    timeline_info.sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.pNext       = nullptr;
+    timeline_info.semaphore   = m_vk_timeline_semaphores[queue];
+    timeline_info.value       = point.value;
+    timeline_info.stageMask   = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    timeline_info.deviceIndex = 0;
+
     VkSubmitInfo2 submit_info = {};
 
     submit_info.sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
     submit_info.pNext                    = nullptr;
     submit_info.flags                    = 0;
-    submit_info.waitSemaphoreInfoCount   = wait_semaphores.size();
+    submit_info.waitSemaphoreInfoCount   = wait_count;
     submit_info.pWaitSemaphoreInfos      = vk_wait_semaphores;
     submit_info.commandBufferInfoCount   = cmd_bufs.size();
     submit_info.pCommandBufferInfos      = vk_cmd_bufs;
-    submit_info.signalSemaphoreInfoCount = signal_semaphores.size();
+    submit_info.signalSemaphoreInfoCount = signal_semaphores.size() + 1;
     submit_info.pSignalSemaphoreInfos    = vk_signal_semaphores;
 
+    VkQueue vk_queue = queue == QUEUE_TYPE_GRAPHICS ? m_vk_graphics_queue : (queue == QUEUE_TYPE_COMPUTE ? m_vk_compute_queue : m_vk_transfer_queue);
+
     // Submit to queue
-    VkResult result = vkQueueSubmit2(queue, 1, &submit_info, signal_fence->handle());
+    VkResult result = vkQueueSubmit2(vk_queue, 1, &submit_info, signal_fence ? signal_fence->handle() : VK_NULL_HANDLE);
 
     if (result != VK_SUCCESS)
     {
         DW_LOG_FATAL("(Vulkan) Failed to submit command buffer!");
         throw std::runtime_error("(Vulkan) Failed to submit command buffer!");
     }
+
+    m_timeline_submitted[queue].store(point.value, std::memory_order_release);
+
+    return point;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
-void Backend::flush(VkQueue queue, const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
+void Backend::flush(QueueType queue, const std::vector<std::shared_ptr<CommandBuffer>>& cmd_bufs)
 {
-    VkCommandBuffer vk_cmd_bufs[32];
-
-    for (int i = 0; i < cmd_bufs.size(); i++)
-        vk_cmd_bufs[i] = cmd_bufs[i]->handle();
-
-    VkSubmitInfo submit_info;
-    DW_ZERO_MEMORY(submit_info);
-
-    submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers    = &vk_cmd_bufs[0];
-
-    // Create fence to ensure that the command buffer has finished executing
-    VkFenceCreateInfo fence_info;
-    DW_ZERO_MEMORY(fence_info);
+    // Wait for the timeline to signal that the command buffers have finished executing
+    wait(submit(queue, cmd_bufs, {}, {}, nullptr, {}));
+}
 
-    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+// -----------------------------------------------------------------------------------------------------------------------------------
 
-    VkFence fence;
-    vkCreateFence(m_vk_device, &fence_info, nullptr, &fence);
+bool Backend::acquire_next_swap_chain_image(const std::shared_ptr<Semaphore>& semaphore)
+{
+    if (!m_window)
+    {
+        m_image_index = m_frame_idx % m_swap_chain_images.size();
 
-    // Submit to the queue
-    vkQueueSubmit(queue, 1, &submit_info, fence);
+        // There is no presentation engine to signal the semaphore, so an empty submission does it instead and the
+        // application's submit can wait on it unchanged.
+        VkSubmitInfo submit_info;
+        DW_ZERO_MEMORY(submit_info);
 
-    // Wait for the fence to signal that command buffer has finished executing
-    vkWaitForFences(m_vk_device, 1, &fence, VK_TRUE, 100000000000);
+        submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores    = &semaphore->handle();
 
-    vkDestroyFence(m_vk_device, fence, nullptr);
-}
+        std::lock_guard<std::mutex> lock(m_submit_mutex);
 
-// -----------------------------------------------------------------------------------------------------------------------------------
+        return vkQueueSubmit(m_vk_graphics_queue, 1, &submit_info, VK_NULL_HANDLE) == VK_SUCCESS;
+    }
 
-bool Backend::acquire_next_swap_chain_image(const std::shared_ptr<Semaphore>& semaphore)
-{
     VkResult result = vkAcquireNextImageKHR(m_vk_device, m_vk_swap_chain, UINT64_MAX, semaphore->handle(), VK_NULL_HANDLE, &m_image_index);
 
     return result == VK_SUCCESS;
@@ -3865,11 +5454,43 @@ bool Backend::acquire_next_swap_chain_image(const std::shared_ptr<Semaphore>& se
 
 void Backend::present(const std::vector<std::shared_ptr<Semaphore>>& semaphores)
 {
+    // The presentation queue may be shared with queues that other threads submit to.
+    std::lock_guard<std::mutex> lock(m_submit_mutex);
+
     VkSemaphore signal_semaphores[16];
 
     for (int i = 0; i < semaphores.size(); i++)
         signal_semaphores[i] = semaphores[i]->handle();
 
+    if (!m_window)
+    {
+        // Consume the render complete semaphores so they can be signaled again by the next use of the image.
+        VkPipelineStageFlags wait_stages[16];
+
+        for (int i = 0; i < semaphores.size(); i++)
+            wait_stages[i] = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+        VkSubmitInfo submit_info;
+        DW_ZERO_MEMORY(submit_info);
+
+        submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.waitSemaphoreCount = semaphores.size();
+        submit_info.pWaitSemaphores    = signal_semaphores;
+        submit_info.pWaitDstStageMask  = wait_stages;
+
+        if (vkQueueSubmit(m_vk_graphics_queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            DW_LOG_FATAL("(Vulkan) Failed to submit headless present!");
+            throw std::runtime_error("(Vulkan) Failed to submit headless present!");
+        }
+
+        m_frame_idx++;
+
+        m_current_frame = m_frame_idx % kMaxFramesInFlight;
+
+        return;
+    }
+
     VkPresentInfoKHR present_info;
     DW_ZERO_MEMORY(present_info);
 
@@ -4127,11 +5748,17 @@ bool Backend::check_validation_layer_support(std::vector<const char*> layers)
 
 std::vector<const char*> Backend::required_extensions(bool enable_validation_layers)
 {
-    uint32_t     glfw_extension_count = 0;
-    const char** glfw_extensions;
-    glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+    std::vector<const char*> extensions;
 
-    std::vector<const char*> extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+    // Surface extensions are only needed when presenting to a window.
+    if (m_window)
+    {
+        uint32_t     glfw_extension_count = 0;
+        const char** glfw_extensions;
+        glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+
+        extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+    }
 
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
 
@@ -4183,33 +5810,24 @@ bool Backend::find_physical_device(std::vector<const char*> extensions, bool req
 
     vkEnumeratePhysicalDevices(m_vk_instance, &device_count, devices.data());
 
-    // Try to find a discrete GPU...
-    for (const auto& device : devices)
-    {
-        QueueInfos              infos;
-        SwapChainSupportDetails details;
-
-        if (is_device_suitable(device, VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, infos, details, extensions, require_ray_tracing))
-        {
-            m_vk_physical_device = device;
-            m_selected_queues    = infos;
-            m_swapchain_details  = details;
-            return true;
-        }
-    }
+    // Try to find a discrete GPU, then an integrated one. Virtual and software devices (such as lavapipe) are only used
+    // as a last resort, which lets CI machines without a GPU run the samples.
+    const VkPhysicalDeviceType types[] = { VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU, VK_PHYSICAL_DEVICE_TYPE_CPU };
 
-    // ...If not, try to find an integrated GPU...
-    for (const auto& device : devices)
+    for (auto type : types)
     {
-        QueueInfos              infos;
-        SwapChainSupportDetails details;
-
-        if (is_device_suitable(device, VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, infos, details, extensions, require_ray_tracing))
+        for (const auto& device : devices)
         {
-            m_vk_physical_device = device;
-            m_selected_queues    = infos;
-            m_swapchain_details  = details;
-            return true;
+            QueueInfos              infos;
+            SwapChainSupportDetails details;
+
+            if (is_device_suitable(device, type, infos, details, extensions, require_ray_tracing))
+            {
+                m_vk_physical_device = device;
+                m_selected_queues    = infos;
+                m_swapchain_details  = details;
+                return true;
+            }
         }
     }
 
@@ -4227,9 +5845,15 @@ bool Backend::is_device_suitable(VkPhysicalDevice device, VkPhysicalDeviceType t
     if (m_device_properties.deviceType == type)
     {
         bool extensions_supported = check_device_extension_support(device, extensions);
-        query_swap_chain_support(device, details);
+        bool swap_chain_supported = true;
 
-        if (details.format.size() > 0 && details.present_modes.size() > 0 && extensions_supported)
+        if (m_vk_surface)
+        {
+            query_swap_chain_support(device, details);
+            swap_chain_supported = details.format.size() > 0 && details.present_modes.size() > 0;
+        }
+
+        if (swap_chain_supported && extensions_supported)
         {
             if (require_ray_tracing)
             {
@@ -4270,7 +5894,12 @@ bool Backend::find_queues(VkPhysicalDevice device, QueueInfos& infos)
         VkQueueFlags bits = families[i].queueFlags;
 
         VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_vk_surface, &present_support);
+
+        // Without a surface, the graphics queue stands in for the presentation queue.
+        if (m_vk_surface)
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_vk_surface, &present_support);
+        else
+            present_support = (bits & VK_QUEUE_GRAPHICS_BIT) != 0;
 
         // Look for Presentation Queue
         if (present_support && infos.presentation_queue_index == -1)
@@ -4531,6 +6160,20 @@ bool Backend::create_logical_device(std::vector<const char*> extensions, bool re
 
     vkGetPhysicalDeviceFeatures2(m_vk_physical_device, &physical_device_features_2);
 
+    // Queue synchronization is built on timeline semaphores, which every Vulkan 1.2 device has to support.
+    if (!features12.timelineSemaphore)
+    {
+        DW_LOG_FATAL("(Vulkan) Timeline semaphores are not supported.");
+        return false;
+    }
+
+    // Cubemap captures render all six faces in a single multiview pass, which every Vulkan 1.1 device has to support.
+    if (!features11.multiview)
+    {
+        DW_LOG_FATAL("(Vulkan) Multiview is not supported.");
+        return false;
+    }
+
     physical_device_features_2.features.robustBufferAccess = VK_FALSE;
 
     VkDeviceCreateInfo device_info;
@@ -4583,18 +6226,22 @@ bool Backend::create_logical_device(std::vector<const char*> extensions, bool re
     else if (m_selected_queues.transfer_queue_index == m_selected_queues.graphics_queue_index)
         m_vk_transfer_queue = m_vk_graphics_queue;
     else if (m_selected_queues.transfer_queue_index == m_selected_queues.compute_queue_index)
-        m_vk_transfer_queue = m_vk_transfer_queue;
+        m_vk_transfer_queue = m_vk_compute_queue;
     else
         vkGetDeviceQueue(m_vk_device, m_selected_queues.transfer_queue_index, 0, &m_vk_transfer_queue);
 
-    return true;
+    return create_timeline_semaphores();
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
 bool Backend::create_swapchain()
 {
-    m_current_frame                   = 0;
+    m_current_frame = 0;
+
+    if (!m_window)
+        return create_offscreen_images();
+
     VkSurfaceFormatKHR surface_format = choose_swap_surface_format(m_swapchain_details.format);
     VkPresentModeKHR   present_mode   = choose_swap_present_mode(m_swapchain_details.present_modes);
     VkExtent2D         extent         = choose_swap_extent(m_swapchain_details.capabilities);
@@ -4616,6 +6263,10 @@ bool Backend::create_swapchain()
     create_info.imageArrayLayers = 1;
     create_info.imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 
+    // Needed to read frames back for captures.
+    if (m_swapchain_details.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
     m_swap_chain_image_format = surface_format.format;
     m_swap_chain_extent       = extent;
 
@@ -4653,6 +6304,57 @@ bool Backend::create_swapchain()
     if (vkGetSwapchainImagesKHR(m_vk_device, m_vk_swap_chain, &swap_image_count, &images[0]) != VK_SUCCESS)
         return false;
 
+    create_swapchain_depth();
+
+    for (int i = 0; i < swap_image_count; i++)
+    {
+        m_swap_chain_images[i] = Image::create_from_swapchain(shared_from_this(), images[i], VK_IMAGE_TYPE_2D, m_swap_chain_extent.width, m_swap_chain_extent.height, 1, 1, 1, m_swap_chain_image_format, VMA_MEMORY_USAGE_UNKNOWN, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_SAMPLE_COUNT_1_BIT);
+
+        m_swap_chain_images[i]->set_name("Swap Chain Image " + std::to_string(i));
+
+        m_swap_chain_image_views[i] = ImageView::create(shared_from_this(), m_swap_chain_images[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        m_swap_chain_image_views[i]->set_name("Swap Chain Image View " + std::to_string(i));
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+bool Backend::create_offscreen_images()
+{
+    // Match the swap chain's triple buffering so per-frame resources rotate the same way in both modes.
+    const uint32_t image_count = kMaxFramesInFlight;
+
+    m_swap_chain_image_format = m_srgb_swapchain ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+
+    m_swap_chain_images.resize(image_count);
+    m_swap_chain_image_views.resize(image_count);
+
+    create_swapchain_depth();
+
+    for (int i = 0; i < image_count; i++)
+    {
+        m_swap_chain_images[i] = Image::create(shared_from_this(), VK_IMAGE_TYPE_2D, m_swap_chain_extent.width, m_swap_chain_extent.height, 1, 1, 1, m_swap_chain_image_format, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_SAMPLE_COUNT_1_BIT);
+
+        if (!m_swap_chain_images[i])
+            return false;
+
+        m_swap_chain_images[i]->set_name("Offscreen Swap Chain Image " + std::to_string(i));
+
+        m_swap_chain_image_views[i] = ImageView::create(shared_from_this(), m_swap_chain_images[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        m_swap_chain_image_views[i]->set_name("Offscreen Swap Chain Image View " + std::to_string(i));
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
+void Backend::create_swapchain_depth()
+{
     m_swap_chain_depth_format = find_depth_format();
 
     m_swap_chain_depth = Image::create(shared_from_this(),
@@ -4672,19 +6374,6 @@ bool Backend::create_swapchain()
     m_swap_chain_depth_view = ImageView::create(shared_from_this(), m_swap_chain_depth, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT);
 
     m_swap_chain_depth_view->set_name("Swap Chain Depth Image View");
-
-    for (int i = 0; i < swap_image_count; i++)
-    {
-        m_swap_chain_images[i] = Image::create_from_swapchain(shared_from_this(), images[i], VK_IMAGE_TYPE_2D, m_swap_chain_extent.width, m_swap_chain_extent.height, 1, 1, 1, m_swap_chain_image_format, VMA_MEMORY_USAGE_UNKNOWN, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_SAMPLE_COUNT_1_BIT);
-
-        m_swap_chain_images[i]->set_name("Swap Chain Image " + std::to_string(i));
-
-        m_swap_chain_image_views[i] = ImageView::create(shared_from_this(), m_swap_chain_images[i], VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-
-        m_swap_chain_image_views[i]->set_name("Swap Chain Image View " + std::to_string(i));
-    }
-
-    return true;
 }
 
 // -----------------------------------------------------------------------------------------------------------------------------------
@@ -4702,7 +6391,11 @@ void Backend::recreate_swapchain(bool vsync)
         m_swap_chain_image_views[i].reset();
     }
 
-    vkDestroySwapchainKHR(m_vk_device, m_vk_swap_chain, nullptr);
+    if (m_vk_swap_chain)
+    {
+        vkDestroySwapchainKHR(m_vk_device, m_vk_swap_chain, nullptr);
+        m_vk_swap_chain = nullptr;
+    }
 
     if (!create_swapchain())
     {
@@ -4713,6 +6406,94 @@ void Backend::recreate_swapchain(bool vsync)
 
 // -----------------------------------------------------------------------------------------------------------------------------------
 
+bool Backend::read_back_swapchain_image(std::vector<uint8_t>& pixels)
+{
+    if (m_window && !(m_swapchain_details.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+    {
+        DW_LOG_ERROR("(Vulkan) Swap chain images of this surface cannot be read back.");
+        return false;
+    }
+
+    Image::Ptr image = m_swap_chain_images[m_image_index];
+
+    auto usage_info = m_image_usage_info.find((uint64_t)image->handle());
+
+    // Swap chain images are treated as discarded once the frame that used them has been presented.
+    if (usage_info == m_image_usage_info.end() || usage_info->second.empty() || usage_info->second[0].last_frame_idx != m_frame_idx)
+    {
+        DW_LOG_ERROR("(Vulkan) The current swap chain image has not been rendered to this frame.");
+        return false;
+    }
+
+    const ImageUsageInfo last_usage = usage_info->second[0];
+    const uint32_t       width      = m_swap_chain_extent.width;
+    const uint32_t       height     = m_swap_chain_extent.height;
+
+    Buffer::Ptr buffer = Buffer::create(shared_from_this(), VK_BUFFER_USAGE_TRANSFER_DST_BIT, width * height * 4, VMA_MEMORY_USAGE_CPU_ONLY, VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+    CommandBuffer::Ptr cmd_buf = CommandBuffer::create(shared_from_this(), graphics_command_pool());
+
+    VkCommandBufferBeginInfo begin_info;
+    DW_ZERO_MEMORY(begin_info);
+
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    vkBeginCommandBuffer(cmd_buf->handle(), &begin_info);
+
+    VkImageSubresourceRange subresource_range;
+    DW_ZERO_MEMORY(subresource_range);
+
+    subresource_range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    subresource_range.levelCount = 1;
+    subresource_range.layerCount = 1;
+
+    use_resource(VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, subresource_range);
+
+    // The last recorded usage is often the present transition, which has no destination stage to chain from.
+    m_image_memory_barriers.back().srcStageMask |= VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    m_image_memory_barriers.back().srcAccessMask |= VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+    flush_barriers(cmd_buf);
+
+    VkBufferImageCopy copy_region;
+    DW_ZERO_MEMORY(copy_region);
+
+    copy_region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy_region.imageSubresource.layerCount = 1;
+    copy_region.imageExtent.width           = width;
+    copy_region.imageExtent.height          = height;
+    copy_region.imageExtent.depth           = 1;
+
+    vkCmdCopyImageToBuffer(cmd_buf->handle(), image->handle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer->handle(), 1, &copy_region);
+
+    // Hand the image back in the state the application left it in.
+    use_resource(last_usage.stage, last_usage.access, last_usage.layout, image, subresource_range);
+
+    flush_barriers(cmd_buf);
+
+    vkEndCommandBuffer(cmd_buf->handle());
+
+    flush_graphics({ cmd_buf });
+
+    const uint8_t* src     = (const uint8_t*)buffer->mapped_ptr();
+    const bool     swizzle = m_swap_chain_image_format == VK_FORMAT_B8G8R8A8_UNORM || m_swap_chain_image_format == VK_FORMAT_B8G8R8A8_SRGB;
+
+    pixels.resize(width * height * 4);
+
+    for (uint32_t i = 0; i < width * height; i++)
+    {
+        pixels[i * 4 + 0] = src[i * 4 + (swizzle ? 2 : 0)];
+        pixels[i * 4 + 1] = src[i * 4 + 1];
+        pixels[i * 4 + 2] = src[i * 4 + (swizzle ? 0 : 2)];
+        pixels[i * 4 + 3] = src[i * 4 + 3];
+    }
+
+    return true;
+}
+
+// -----------------------------------------------------------------------------------------------------------------------------------
+
 VkSurfaceFormatKHR Backend::choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats)
 {
     for (const auto& availableFormat : available_formats)